@@ -479,6 +479,40 @@ gop_op_generic_t *gop_waitany_timed(gop_op_generic_t *g, int dt)
     return(gop);
 }
 
+//*************************************************************
+// gop_waitany_until - Same as gop_waitany but gives up at the deadline.
+//   Returns NULL on a timeout or if nothing is left so use
+//   gop_tasks_left() to tell them apart.
+//*************************************************************
+
+gop_op_generic_t *gop_waitany_until(gop_op_generic_t *g, apr_time_t deadline)
+{
+    gop_op_generic_t *gop = NULL;
+    apr_interval_time_t adt;
+
+    lock_gop(g);
+    _gop_start_execution(g);  //** Make sure things have been submitted
+
+    if (gop_get_type(g) == Q_TYPE_QUE) {
+        while (((gop = (gop_op_generic_t *)tbx_stack_pop(g->q->finished)) == NULL) && (g->q->nleft > 0)) {
+            adt = deadline - apr_time_now();
+            if (adt <= 0) break;
+            apr_thread_cond_timedwait(g->base.ctl->cond, g->base.ctl->lock, adt); //** Sleep until something completes
+        }
+    } else {
+        while (g->base.state == 0) {
+            adt = deadline - apr_time_now();
+            if (adt <= 0) break;
+            apr_thread_cond_timedwait(g->base.ctl->cond, g->base.ctl->lock, adt); //** Sleep until something completes
+        }
+
+        if (g->base.state != 0) gop = g;
+    }
+    unlock_gop(g);
+
+    return(gop);
+}
+
 //*************************************************************
 // gop_timed_waitall - waits until all the tasks are completed
 //    It returns op_status if all the tasks completed without problems or
@@ -99,6 +99,7 @@ GOP_API int gop_tasks_left(gop_op_generic_t *gop);
 GOP_API int gop_waitall(gop_op_generic_t *gop);
 GOP_API gop_op_generic_t *gop_waitany(gop_op_generic_t *gop);
 GOP_API gop_op_generic_t *gop_waitany_timed(gop_op_generic_t *g, int dt);
+GOP_API gop_op_generic_t *gop_waitany_until(gop_op_generic_t *g, apr_time_t deadline);
 GOP_API apr_time_t gop_time_start(gop_op_generic_t *gop);
 GOP_API apr_time_t gop_time_end(gop_op_generic_t *gop);
 GOP_API apr_time_t gop_time_exec(gop_op_generic_t *gop);
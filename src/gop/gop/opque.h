@@ -56,6 +56,7 @@ GOP_API void gop_shutdown();
 #define gop_opque_task_count(q) q->qd.nsubmitted
 #define opque_waitall(q) gop_waitall(opque_get_gop(q))
 #define opque_waitany(q) gop_waitany(opque_get_gop(q))
+#define opque_waitany_until(q, t) gop_waitany_until(opque_get_gop(q), t)
 #define opque_start_execution(q) gop_start_execution(opque_get_gop(q))
 #define opque_finished_submission(q) gop_finished_submission(opque_get_gop(q))
 
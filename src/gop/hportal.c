@@ -24,6 +24,7 @@
 #include <gop/gop.h>
 #include <gop/opque.h>
 #include <gop/portal.h>
+#include <stdint.h>
 #include <tbx/apr_wrapper.h>
 #include <tbx/atomic_counter.h>
 #include <tbx/fmttypes.h>
@@ -33,9 +34,17 @@
 #include <tbx/stack.h>
 #include <tbx/string_token.h>
 #include <tbx/type_malloc.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
 
 typedef struct hconn_t hconn_t;
 typedef struct hportal_t hportal_t;
+typedef struct hp_event_loop_t hp_event_loop_t;
+typedef struct hp_event_engine_t hp_event_engine_t;
 
 //** HPC operations
 #define HPC_CMD_GOP       0    //** Normal GOP command to process
@@ -52,6 +61,27 @@ typedef struct hportal_t hportal_t;
 #define CONN_GOP_RETRY     9   //** GOP should be retried (from conn)
 #define CONN_GOP_DONE     10   //** GOP has been processed (from conn)
 
+//** Event engine jobs
+#define EV_JOB_CONNECT    0    //** Make the connection
+#define EV_JOB_SEND       1    //** Send the queued commands
+#define EV_JOB_RECV       2    //** Process the responses that are ready
+#define EV_JOB_SHUTDOWN   3    //** Worker should exit
+
+//** Event engine receive side states
+#define EV_RECV_IDLE      0    //** Nothing outstanding
+#define EV_RECV_ARMED     1    //** Waiting in the epoll set for a response
+#define EV_RECV_ACTIVE    2    //** Owned by a recv worker
+
+//** Event engine worker pools
+#define EV_SIDE_SEND      0    //** Connect and send workers
+#define EV_SIDE_RECV      1    //** Recv workers
+
+#define HP_LAT_BUCKETS 128   //** Latency histogram buckets.  4 per doubling starting at 1us
+#define HP_LAT_DECAY   256   //** Number of samples before the histogram is aged
+
+#define EV_MAX_EVENTS   256    //** Max events processed per epoll_wait() call
+#define EV_WAIT_MS     1000    //** Loop wakeup interval for timeout/idle sweeps
+
 static char *hc_reasons[4] = { "GOP_ERR  ", "IDLE     ", "CLOSE_REQ", "FAIL_CONN" };
 
 typedef struct {
@@ -109,13 +139,59 @@ struct hconn_t {     //** Host connection structure
     int64_t ntasks;         //** Current # of tasks
     int64_t gop_last_workload; //** Last processed GOP workload
     apr_time_t gop_last_dt;    //** Processing time for last GOP
+    double avg_bw;             //** Running average bandwidth for the connection
     apr_time_t start_time;     //** Connection start time
     apr_time_t last_update_time;     //** Last time the central thread processed a command
     gop_op_status_t last_status;  //** Last commands status
     int state;              //** Connection state 0=startup, 1=ready, 2=closing
     int reason;             //** Reason for closing
+    hp_event_loop_t *loop;  //** Event loop monitoring the connection.  NULL if using the send/recv threads
+    tbx_stack_ele_t *loop_ele; //** My position in the event loop's conn_list
+    tbx_stack_t *send_que;  //** GOPs waiting to be sent.  All the ev_* fields are protected by loop->lock
+    tbx_stack_t *recv_que;  //** GOPs sent and waiting for a response
+    int fd;                 //** Native socket for epoll
+    int ev_registered;      //** The fd is in the epoll set
+    int ev_sending;         //** A send worker owns the connection or it's waiting for room in the socket
+    int ev_send_armed;      //** Waiting in the epoll set for room to send
+    int ev_send_forced;     //** Send even if the socket is full so the send_command can time out
+    apr_time_t ev_send_wait_start; //** When the send started waiting for room
+    int ev_recv;            //** EV_RECV_IDLE, EV_RECV_ARMED, or EV_RECV_ACTIVE
+    int ev_closing;         //** 1=Close requested by the conn, 2=Official CONN_CLOSE from the hportal
+    int ev_failed;          //** The connection had an error and no more commands can be sent
+    hportal_t *ev_close_hp; //** HP that requested the close
+    apr_time_t ev_last_used; //** Last time a command was sent or received
+};
+
+struct hp_event_loop_t {     //** Single epoll set and the thread monitoring it
+    int epfd;                //** epoll handle
+    int shutdown;            //** Loop should exit
+    apr_thread_t *thread;    //** Loop thread
+    apr_thread_mutex_t *lock;  //** Protects the conn_list and the connection's ev_* state
+    tbx_stack_t *conn_list;  //** Connected hconns assigned to the loop
+    hp_event_engine_t *ee;
 };
 
+struct hp_event_engine_t {   //** Shared event loops and worker pools used by all connections
+    gop_portal_context_t *hpc;
+    int n_loops;             //** Number of event loops
+    int n_send;              //** Number of send/connect workers
+    int n_recv;              //** Number of recv workers
+    int next_loop;           //** Round robin loop assignment
+    hp_event_loop_t *loop;   //** Event loops
+    tbx_que_t *send_jobs;    //** Pending connect and send jobs
+    tbx_que_t *recv_jobs;    //** Pending recv jobs
+    int hp_workers;          //** Max workers from each pool a single HP can hold
+    apr_thread_mutex_t *lock;  //** Protects the HP worker counts and waiting jobs
+    apr_thread_t **send_worker;
+    apr_thread_t **recv_worker;
+    apr_pool_t *mpool;
+};
+
+typedef struct {
+    int cmd;
+    hconn_t *hc;
+} ev_job_t;
+
 struct hportal_t {   //** Host portal container
     char *skey;          //** Search key used for lookups its "host:port:type:..." Same as for the op
     char *host;          //** Hostname
@@ -140,6 +216,20 @@ struct hportal_t {   //** Host portal container
     void *connect_context;   //** Private information needed to make a host connection
     gop_portal_context_t *hpc;  //** Specific portal implementaion
     double avg_bw;              //** Avg bandwidth as calculated by determine_bandwidths()
+    int64_t max_workload;       //** Max workload per connection.  Scaled by the depot's bandwidth
+    int max_inflight;           //** Max tasks per connection.  Scaled by the depot's tail latency
+    //** Everything below is protected by hpc->stats_lock so other threads can query it
+    apr_time_t lat_ewma;        //** Running average of the command time
+    apr_time_t lat_p99;         //** 99th percentile of the command time
+    double lat_hist[HP_LAT_BUCKETS]; //** Decaying histogram of the command times
+    double lat_total;           //** Sum of the histogram
+    int lat_count;              //** Samples since the histogram was last aged
+    double stats_bw;            //** Published bandwidth
+    int64_t stats_workload;     //** Published pending+executing workload
+    int stats_conn;             //** Published number of connections
+    int stats_dead;             //** Published dead flag
+    int ev_active[2];           //** Event engine workers held for each side.  Protected by ee->lock
+    tbx_stack_t *ev_waiting[2]; //** Jobs waiting for one of the HP's workers.  Protected by ee->lock
 };
 
 struct gop_portal_context_t {             //** Handle for maintaining all the ecopy connections
@@ -166,11 +256,20 @@ struct gop_portal_context_t {             //** Handle for maintaining all the ec
     apr_time_t dt_dead_check;  //** Check interval between host health checks
     apr_time_t dt_start;       //** Start time for hportal
     int64_t max_workload;      //** Max allowed workload before spawning another connection
+    int64_t min_workload;      //** Smallest per connection workload the latency target can shrink max_workload to
+    apr_time_t latency_target; //** Target time to drain a connection.  Used for the per depot limits.  0 disables
+    int max_inflight;          //** Max tasks per connection for a depot with a light tail
+    apr_thread_mutex_t *stats_lock; //** Protects the hp table and the published hp stats
     tbx_atomic_int_t dump_running; //** Dump stats running if = 1
     int hc_history_size;       //** Size of the connection history
     hc_history_t *hc_history;  //** Connection history
     int retry_history_size;       //** Size of the retry history
     retry_history_t *retry_history;  //** Retry history
+    int event_loops;           //** Number of epoll event loops.  If 0 each connection gets a send and recv thread
+    int event_send_threads;    //** Event engine workers for making connections and sending commands
+    int event_recv_threads;    //** Event engine workers for processing responses
+    int event_hp_workers;      //** Max workers from each event engine pool a single HP can hold
+    hp_event_engine_t *ev;     //** Event engine.  Created with the first connection
     void *arg;
     gop_portal_fn_t *fn;       //** Actual implementaion for application
 };
@@ -188,9 +287,16 @@ static gop_portal_context_t  hpc_default_options = {
     .max_conn = 4,
     .dt_connect = apr_time_from_sec(10),
     .max_workload = 10*1024*1024,
+    .min_workload = 1024*1024,
+    .latency_target = apr_time_from_sec(1),
+    .max_inflight = 256,
     .mix_latest_fraction = 0.5,
     .hc_history_size = 1000,
-    .retry_history_size = 1000
+    .retry_history_size = 1000,
+    .event_loops = 0,
+    .event_send_threads = 16,
+    .event_recv_threads = 16,
+    .event_hp_workers = 4
 };
 
 
@@ -198,6 +304,11 @@ int process_incoming(gop_portal_context_t *hpc);
 hconn_t *hconn_new(hportal_t *hp, tbx_que_t *outgoing, apr_pool_t *mpool);
 void hconn_add(hportal_t *hp, hconn_t *hc);
 void hconn_destroy(hconn_t *hc);
+int hconn_put(hconn_t *hc, hpc_cmd_t *cmd, apr_time_t dt);
+hp_event_engine_t *ev_engine_create(gop_portal_context_t *hpc);
+void ev_engine_destroy(hp_event_engine_t *ee);
+void ev_hconn_start(hp_event_engine_t *ee, hconn_t *hc);
+int ev_hconn_put(hconn_t *hc, hpc_cmd_t *cmd);
 hportal_t *hp_create(gop_portal_context_t *hpc, char *id);
 void hp_destroy(hportal_t *hp);
 
@@ -251,7 +362,7 @@ int submit_shutdown(gop_portal_context_t *hpc)
             if (hc->state == 1) {
                 n++;
                 hc->state = 2;
-                tbx_que_put(hc->incoming, &cmd, dt);
+                hconn_put(hc, &cmd, dt);
             }
         }
     }
@@ -314,7 +425,7 @@ int hpc_close_connections(gop_portal_context_t *hpc, hportal_t *hp, int n_close)
         if (!hc) break;
         hc->state = 2;
         n++;
-        tbx_que_put(hc->incoming, &cmd, dt);
+        hconn_put(hc, &cmd, dt);
     }
 
     return(n);
@@ -569,6 +680,151 @@ double determine_bandwidths(gop_portal_context_t *hpc, int *n_used, hportal_t **
     return(total_avg_bw);
 }
 
+//************************************************************************
+// hp_latency_bucket - Returns the histogram bucket for the time.  There are
+//     4 buckets for each doubling so the error is under 25%.
+//************************************************************************
+
+int hp_latency_bucket(apr_time_t dt)
+{
+    int msb, i;
+    apr_time_t v;
+
+    if (dt < 4) return((dt < 0) ? 0 : dt);
+
+    msb = 0;
+    for (v = dt; v > 1; v >>= 1) msb++;
+    i = 4*(msb-1) + ((dt >> (msb-2)) & 3);
+    return((i < HP_LAT_BUCKETS) ? i : HP_LAT_BUCKETS-1);
+}
+
+//************************************************************************
+// hp_latency_bucket_max - Returns the largest time stored in the bucket
+//************************************************************************
+
+apr_time_t hp_latency_bucket_max(int i)
+{
+    int msb;
+
+    if (i < 4) return(i);
+
+    msb = i/4 + 1;
+    return(((apr_time_t)(5 + i%4) << (msb-2)) - 1);
+}
+
+//************************************************************************
+// hp_latency_quantile - Returns the command time for the given fraction
+//     of the commands.  Returns 0 if there is no history.
+//     NOTE: Should be holding hpc->stats_lock
+//************************************************************************
+
+apr_time_t hp_latency_quantile(hportal_t *hp, double fraction)
+{
+    double sum, target;
+    int i;
+
+    if (hp->lat_total <= 0) return(0);
+
+    target = fraction * hp->lat_total;
+    sum = 0;
+    for (i=0; i<HP_LAT_BUCKETS; i++) {
+        sum += hp->lat_hist[i];
+        if (sum >= target) return(hp_latency_bucket_max(i));
+    }
+
+    return(hp_latency_bucket_max(HP_LAT_BUCKETS-1));
+}
+
+//************************************************************************
+// hp_limits_update - Updates the per connection limits for the HP.
+//     The workload limit is what the depot can move in the latency target
+//     and the task limit shrinks as the tail gets heavier so fewer tasks
+//     are stuck behind a slow command.
+//************************************************************************
+
+void hp_limits_update(gop_portal_context_t *hpc, hportal_t *hp)
+{
+    double n;
+
+    hp->max_workload = hpc->max_workload;
+    hp->max_inflight = hpc->max_inflight;
+    if (hpc->latency_target <= 0) return;
+
+    if (hp->stats_bw > 0) {
+        n = hp->stats_bw * hpc->latency_target / apr_time_from_sec(1);
+        if (n < hp->max_workload) hp->max_workload = (n < hpc->min_workload) ? hpc->min_workload : n;
+    }
+
+    if ((hp->max_inflight > 0) && (hp->lat_ewma > 0) && (hp->lat_p99 > hp->lat_ewma)) {
+        n = (1.0 * hp->max_inflight * hp->lat_ewma) / hp->lat_p99;
+        hp->max_inflight = (n < 1) ? 1 : n;
+    }
+}
+
+//************************************************************************
+// hp_stats_update - Adds the completed command to the HP's stats
+//************************************************************************
+
+void hp_stats_update(gop_portal_context_t *hpc, hportal_t *hp, int64_t workload, apr_time_t dt)
+{
+    int i;
+
+    apr_thread_mutex_lock(hpc->stats_lock);
+    hp->avg_workload = (hp->avg_workload != 0) ? hpc->mix_latest_fraction * workload + (1-hpc->mix_latest_fraction)*hp->avg_workload : workload;
+    hp->avg_dt = (hp->avg_dt != 0) ? hpc->mix_latest_fraction * dt + (1-hpc->mix_latest_fraction)*hp->avg_dt : dt;
+    hp->stats_bw = (hp->avg_dt > 0) ? (1.0*hp->avg_workload * apr_time_from_sec(1)) / hp->avg_dt : 0;
+
+    if (dt > 0) {  //** Failed tasks have no time so skip them
+        hp->lat_ewma = (hp->lat_ewma != 0) ? hpc->mix_latest_fraction * dt + (1-hpc->mix_latest_fraction)*hp->lat_ewma : dt;
+
+        hp->lat_count++;
+        if (hp->lat_count >= HP_LAT_DECAY) {  //** Age the history so it tracks the depot's current state
+            for (i=0; i<HP_LAT_BUCKETS; i++) hp->lat_hist[i] *= 0.5;
+            hp->lat_total *= 0.5;
+            hp->lat_count = 0;
+        }
+        hp->lat_hist[hp_latency_bucket(dt)] += 1;
+        hp->lat_total += 1;
+        hp->lat_p99 = hp_latency_quantile(hp, 0.99);
+    }
+
+    hp_limits_update(hpc, hp);
+    apr_thread_mutex_unlock(hpc->stats_lock);
+}
+
+//************************************************************************
+// hp_stats_reset - Clears the HP's history.  Used when the dead flag is cleared.
+//************************************************************************
+
+void hp_stats_reset(gop_portal_context_t *hpc, hportal_t *hp)
+{
+    apr_thread_mutex_lock(hpc->stats_lock);
+    hp->avg_bw = 0;
+    hp->avg_workload = 0;
+    hp->avg_dt = 0;
+    hp->stats_bw = 0;
+    hp->lat_ewma = 0;
+    hp->lat_p99 = 0;
+    memset(hp->lat_hist, 0, sizeof(hp->lat_hist));
+    hp->lat_total = 0;
+    hp->lat_count = 0;
+    hp_limits_update(hpc, hp);
+    apr_thread_mutex_unlock(hpc->stats_lock);
+}
+
+//************************************************************************
+// hp_stats_publish - Makes the HP's current load visible to other threads
+//************************************************************************
+
+void hp_stats_publish(gop_portal_context_t *hpc, hportal_t *hp)
+{
+    apr_thread_mutex_lock(hpc->stats_lock);
+    hp->stats_workload = hp->workload_pending + hp->workload_executing;
+    hp->stats_conn = tbx_stack_count(hp->conn_list) - hp->limbo_conn;
+    hp->stats_dead = (hp->dead > 0) ? 1 : 0;
+    apr_thread_mutex_unlock(hpc->stats_lock);
+}
+
 //************************************************************************
 // dump_stats - Dumps the stats
 //************************************************************************
@@ -612,6 +868,9 @@ void dump_stats(gop_portal_context_t *hpc, FILE *fd)
             tbx_stack_count(hp->conn_list), hp->stable_conn, hp->pending_conn, hp->limbo_conn, (hp->dead > 0) ? 1 : 0,
             tbx_stk_pretty_print_double_with_scale(1024, hp->avg_workload, ppbuf1), tbx_stk_pretty_print_time(hp->avg_dt, 0, ppbuf2),
             tbx_stk_pretty_print_double_with_scale(1024, hp->avg_bw, ppbuf3));
+        fprintf(fd, "        Latency -- Avg: %s  p99: %s  Max workload/conn: %s  Max tasks/conn: %d\n",
+            tbx_stk_pretty_print_time(hp->lat_ewma, 0, ppbuf1), tbx_stk_pretty_print_time(hp->lat_p99, 0, ppbuf2),
+            tbx_stk_pretty_print_double_with_scale(1024, hp->max_workload, ppbuf3), hp->max_inflight);
 
         n_hp++;
         if ((hp->dead == 0) && (tbx_stack_count(hp->conn_list) > hp->limbo_conn)) {
@@ -673,7 +932,9 @@ void route_gop(gop_portal_context_t *hpc, gop_op_generic_t *gop)
     hp = apr_hash_get(hpc->hp, hop->hostport, APR_HASH_KEY_STRING);
     if (hp == NULL) {
         hp = hp_create(hpc, hop->hostport);
+        apr_thread_mutex_lock(hpc->stats_lock);
         apr_hash_set(hpc->hp, hp->skey, APR_HASH_KEY_STRING, (const void *)hp);
+        apr_thread_mutex_unlock(hpc->stats_lock);
     }
     hp->workload_pending += hop->workload;
     tbx_stack_push(hp->pending, gop);
@@ -821,21 +1082,43 @@ void hp_gop_retry(hconn_t *hc, gop_op_generic_t *gop, int count)
 }
 
 //************************************************************************
-// hconn_least_busy - Returns the least busy connection
+// hconn_has_room - Returns 1 if the connection can take another task
+//************************************************************************
+
+int hconn_has_room(hportal_t *hp, hconn_t *hc)
+{
+    if (hc->workload >= hp->max_workload) return(0);
+    if ((hp->max_inflight > 0) && (hc->ntasks >= hp->max_inflight)) return(0);
+    return(1);
+}
+
+//************************************************************************
+// hconn_least_busy - Returns the connection that should finish its
+//     current work the soonest.  The work is scaled by the connection's
+//     bandwidth so a slow connection isn't favored just because it has
+//     less queued.  Connections without any history use the HP's.
+//     If NULL is returned n_full says how many running connections were
+//     skipped because they were full.
 //************************************************************************
 
-hconn_t *hconn_least_busy(gop_portal_context_t *hpc, hportal_t *hp)
+hconn_t *hconn_least_busy(gop_portal_context_t *hpc, hportal_t *hp, int *n_full)
 {
     hconn_t *hc, *best_hc;
-    int64_t best_load;
+    double best_load, load, bw;
 
-    best_load = hpc->max_workload+1;
+    best_load = -1;
     best_hc = NULL;
+    *n_full = 0;
 log_printf(15, "START hp=%s\n", hp->skey);
     for (hc = tbx_stack_bottom_first(hp->conn_list); hc != NULL; hc = tbx_stack_next_up(hp->conn_list)) {
-        if (hc->state == 1) {
-            if (hc->workload < best_load) {
-                best_load = hc->workload;
+        if (hc->state != 1) continue;
+        if (hconn_has_room(hp, hc) == 0) {
+            (*n_full)++;
+        } else {
+            bw = (hc->avg_bw > 0) ? hc->avg_bw : hp->stats_bw;
+            load = (bw > 0) ? hc->workload / bw : hc->workload;
+            if ((best_hc == NULL) || (load < best_load)) {
+                best_load = load;
                 best_hc = hc;
             }
         }
@@ -847,15 +1130,15 @@ log_printf(15, "END hp=%s c=%p\n", hp->skey, best_hc);
 }
 
 //************************************************************************
-// hp_submit_tasks - Submits the task to the hconn for execution
+// _hp_submit_tasks - Submits the task to the hconn for execution
 //************************************************************************
 
-int hp_submit_tasks(gop_portal_context_t *hpc, hportal_t *hp)
+int _hp_submit_tasks(gop_portal_context_t *hpc, hportal_t *hp)
 {
     gop_op_generic_t *gop;
     hconn_t *c;
     hpc_cmd_t cmd;
-    int np, nc, n, gid;
+    int np, nc, n, gid, n_full;
     int64_t workload;
 
 log_printf(15, "hp=%s pending=%d\n", hp->skey, tbx_stack_count(hp->pending));
@@ -886,9 +1169,11 @@ log_printf(15, "hp=%s pending=%d\n", hp->skey, tbx_stack_count(hp->pending));
     memset(&cmd, 0, sizeof(cmd));
 
     //** submit the tasks
-    c = hconn_least_busy(hpc, hp);
-log_printf(15, "hp=%s c=%p\n", hp->skey, c);
+    c = hconn_least_busy(hpc, hp, &n_full);
+log_printf(15, "hp=%s c=%p n_full=%d\n", hp->skey, c, n_full);
     if (c == NULL) {  //** No connections so see if we fail some ops
+        if (n_full > 0) return(tbx_stack_count(hp->pending));  //** Just busy so leave them queued without charging a retry
+
         if (hp->stable_conn == 0) {  //** Not waiting on any connections and we're completely unstable
             tbx_stack_move_to_bottom(hp->pending);
             gop = tbx_stack_get_current_data(hp->pending);
@@ -909,7 +1194,7 @@ log_printf(15, "hp=%s c=%p\n", hp->skey, c);
     cmd.cmd = CONN_GOP_SUBMIT;
     tbx_stack_move_to_bottom(hp->pending);
     while ((gop = tbx_stack_get_current_data(hp->pending)) != NULL) {
-        if (c->workload < hpc->max_workload) {
+        if (hconn_has_room(hp, c) == 1) {
             //** Check if we need to to some command coalescing
             if (gop->op->cmd.before_exec != NULL) {
                 n = gop->op->cmd.before_exec(gop);
@@ -922,7 +1207,7 @@ log_printf(15, "hp=%s c=%p\n", hp->skey, c);
 log_printf(15, "incoming: hp=%s CONN_GOP_SUBMIT gid=%d\n", hp->skey, gid);
             cmd.ptr = gop;
             workload = gop->op->cmd.workload;  //** Snag this because the gop could complete before we finish using it
-            if (tbx_que_put(c->incoming, &cmd, apr_time_from_sec(1)) != 0) break;
+            if (hconn_put(c, &cmd, apr_time_from_sec(1)) != 0) break;
 
             //** Managed to push the task so update counters
             c->workload += workload;
@@ -933,15 +1218,13 @@ log_printf(15, "incoming: hp=%s CONN_GOP_SUBMIT gid=%d c->workload=" I64T " c->n
             hp->workload_executing += workload;
             tbx_stack_delete_current(hp->pending, 1, 0);
         } else {
-            c = hconn_least_busy(hpc, hp);
+            c = hconn_least_busy(hpc, hp, &n_full);
             if (c) {
-log_printf(15, "hpc=%s hp=%s workload=" I64T " max=" I64T "\n", hpc->name, hp->skey, c->workload, hpc->max_workload);
-
-                if (c->workload > hpc->max_workload) break;
+log_printf(15, "hpc=%s hp=%s workload=" I64T " max=" I64T " ntasks=" I64T " max_inflight=%d\n", hpc->name, hp->skey, c->workload, hp->max_workload, c->ntasks, hp->max_inflight);
             } else {
-log_printf(15, "hpc=%s hp=%s c=NULL\n", hpc->name, hp->skey);
+log_printf(15, "hpc=%s hp=%s c=NULL n_full=%d\n", hpc->name, hp->skey, n_full);
                 //** Check if we have essentially a dead connection and need to start failing GOPs
-                if ((hp->stable_conn == 0) && (tbx_stack_count(hp->conn_list) == 0)) {
+                if ((n_full == 0) && (hp->stable_conn == 0) && (tbx_stack_count(hp->conn_list) == 0)) {
                     gop->op->cmd.retry_count--;
                     if (gop->op->cmd.retry_count <= 0) {  //** No more retries left so fail the gop
                         hp->cmds_submitted++;
@@ -959,6 +1242,19 @@ log_printf(15, "hpc=%s hp=%s c=NULL\n", hpc->name, hp->skey);
     return(tbx_stack_count(hp->pending));
 }
 
+//************************************************************************
+// hp_submit_tasks - Submits the tasks and publishes the HP's load
+//************************************************************************
+
+int hp_submit_tasks(gop_portal_context_t *hpc, hportal_t *hp)
+{
+    int n;
+
+    n = _hp_submit_tasks(hpc, hp);
+    hp_stats_publish(hpc, hp);
+    return(n);
+}
+
 //************************************************************************
 //  handle_closed - Handles closing a connection
 //************************************************************************
@@ -1007,6 +1303,7 @@ int process_incoming(gop_portal_context_t *hpc)
     hpc_cmd_t cmd;
     hportal_t *hp;
     apr_time_t dt;
+    double bw;
 
     dt = apr_time_from_sec(10);  //** We wait for the first round
 
@@ -1034,7 +1331,7 @@ log_printf(15, "CONN_READY hp=%s\n", cmd.hc->hp->skey);
                     cmd.cmd = CONN_CLOSE;
                     cmd.ptr = NULL;
 log_printf(15, "Got a CONN_CLOSE_REQUEST from hp=%s.  Sending official CONN_CLOSE\n", cmd.hc->hp->skey);
-                    tbx_que_put(cmd.hc->incoming, &cmd, apr_time_from_sec(100));
+                    hconn_put(cmd.hc, &cmd, apr_time_from_sec(100));
                 }
                 break;
             case CONN_CLOSED:
@@ -1060,8 +1357,11 @@ log_printf(15, "Got a CONN_CLOSE_REQUEST from hp=%s.  Sending official CONN_CLOS
                 cmd.hc->gop_last_workload = cmd.gop_workload;
                 cmd.hc->gop_last_dt = cmd.gop_dt;
                 cmd.hc->last_update_time = apr_time_now();
-                hp->avg_workload = (hp->avg_workload != 0) ? hpc->mix_latest_fraction * cmd.gop_workload + (1-hpc->mix_latest_fraction)*hp->avg_workload : cmd.gop_workload;
-                hp->avg_dt = (hp->avg_dt != 0) ? hpc->mix_latest_fraction * cmd.gop_dt + (1-hpc->mix_latest_fraction)*hp->avg_dt : cmd.gop_dt;
+                if (cmd.gop_dt > 0) {
+                    bw = (1.0*cmd.gop_workload * apr_time_from_sec(1)) / cmd.gop_dt;
+                    cmd.hc->avg_bw = (cmd.hc->avg_bw > 0) ? hpc->mix_latest_fraction * bw + (1-hpc->mix_latest_fraction)*cmd.hc->avg_bw : bw;
+                }
+                hp_stats_update(hpc, hp, cmd.gop_workload, cmd.gop_dt);
                 cmd.hc->hp->workload_executing -= cmd.gop_workload;
                 cmd.hc->hp->cmds_processed++;
                 cmd.hc->cmds_processed++;
@@ -1096,9 +1396,7 @@ log_printf(15, "SUBMIT hpc=%s hp=%s\n", hpc->name, hp->skey);
             if (apr_time_now() > hp->dead) {
                 log_printf(10, "CLEARING dead flag for hp=%s\n", hp->skey);
                 hp->dead = 0;
-                hp->avg_bw = 0;
-                hp->avg_workload = 0;
-                hp->avg_dt = 0;
+                hp_stats_reset(hpc, hp);
             }
         }
 
@@ -1177,12 +1475,15 @@ void *hportal_thread(apr_thread_t *th, void *arg)
 
     ntodo = submit_shutdown(hpc);
     wait_for_shutdown(hpc, ntodo);
+    if (hpc->ev) ev_engine_destroy(hpc->ev);
 
     //** Now destroy all the hportals
     for (hi=apr_hash_first(hpc->pool, hpc->hp); hi != NULL; hi = apr_hash_next(hi)) {
         apr_hash_this(hi, NULL, NULL, &val);
         hp = (hportal_t *)val;
+        apr_thread_mutex_lock(hpc->stats_lock);
         apr_hash_set(hpc->hp, hp->skey, APR_HASH_KEY_STRING, NULL);
+        apr_thread_mutex_unlock(hpc->stats_lock);
         hp_destroy(hp);
     }
 
@@ -1433,6 +1734,811 @@ failed:
     return(NULL);
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+//************************************************************************
+// Event engine - Instead of a send and recv thread per connection the
+//     connections are spread over a few epoll event loops.  Commands are
+//     sent by a shared pool of send workers, one command per turn.  A send
+//     worker is only handed the connection when the socket has room and a
+//     recv worker only when the response starts arriving.  Until then the
+//     socket waits in its loop.  The send_command/send_phase/recv_phase
+//     callbacks are unchanged so once started they run to completion.  To
+//     keep a lagging depot from tying up every worker a single HP can only
+//     hold event_hp_workers from each pool.  Anything over that waits on
+//     the HP for one of its own jobs to finish.
+//************************************************************************
+
+//************************************************************************
+// ev_update - Sets the events the connection is waiting on in its loop's
+//     epoll set.  EPOLLONESHOT makes sure only a single worker is ever
+//     handed each side of the connection.
+//     NOTE: Should be holding loop->lock
+//************************************************************************
+
+int ev_update(hconn_t *hc)
+{
+    struct epoll_event ev;
+    int err;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLONESHOT;
+    if (hc->ev_recv == EV_RECV_ARMED) ev.events |= EPOLLIN | EPOLLRDHUP;
+    if (hc->ev_send_armed == 1) ev.events |= EPOLLOUT;
+    ev.data.ptr = hc;
+    err = epoll_ctl(hc->loop->epfd, ((hc->ev_registered == 1) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD), hc->fd, &ev);
+    if (err != 0) {
+        log_printf(0, "ERROR epoll_ctl failed! hp=%s ns=%d fd=%d errno=%d\n", hc->hp->skey, tbx_ns_getid(hc->ns), hc->fd, errno);
+        return(1);
+    }
+
+    hc->ev_registered = 1;
+    return(0);
+}
+
+//************************************************************************
+// ev_arm - Waits in the loop for the next response
+//     NOTE: Should be holding loop->lock
+//************************************************************************
+
+int ev_arm(hconn_t *hc)
+{
+    int old = hc->ev_recv;
+
+    hc->ev_recv = EV_RECV_ARMED;
+    if (ev_update(hc) != 0) {
+        hc->ev_recv = old;
+        return(1);
+    }
+
+    return(0);
+}
+
+//************************************************************************
+// ev_send_wait - Waits in the loop for room in the socket to send
+//     NOTE: Should be holding loop->lock
+//************************************************************************
+
+int ev_send_wait(hconn_t *hc)
+{
+    hc->ev_send_armed = 1;
+    hc->ev_send_wait_start = apr_time_now();
+    if (ev_update(hc) != 0) {
+        hc->ev_send_armed = 0;
+        return(1);
+    }
+
+    return(0);
+}
+
+//************************************************************************
+// ev_disarm - Removes the connection from the epoll set.
+//     NOTE: Should be holding loop->lock
+//************************************************************************
+
+void ev_disarm(hconn_t *hc)
+{
+    if (hc->ev_registered == 0) return;
+
+    epoll_ctl(hc->loop->epfd, EPOLL_CTL_DEL, hc->fd, NULL);
+    hc->ev_registered = 0;
+}
+
+//************************************************************************
+// ev_dispatch - Hands the job to a worker pool.  If the HP already holds
+//     hp_workers from the pool the job waits on the HP instead.
+//************************************************************************
+
+void ev_dispatch(hp_event_engine_t *ee, hconn_t *hc, int cmd)
+{
+    hportal_t *hp = hc->hp;
+    int side = (cmd == EV_JOB_RECV) ? EV_SIDE_RECV : EV_SIDE_SEND;
+    ev_job_t *wjob;
+    ev_job_t job;
+
+    job.cmd = cmd;
+    job.hc = hc;
+
+    apr_thread_mutex_lock(ee->lock);
+    if (hp->ev_active[side] >= ee->hp_workers) {  //** At the limit so get in line
+        tbx_type_malloc(wjob, ev_job_t, 1);
+        *wjob = job;
+        tbx_stack_push(hp->ev_waiting[side], wjob);
+        apr_thread_mutex_unlock(ee->lock);
+        log_printf(15, "hp=%s side=%d waiting=%d\n", hp->skey, side, tbx_stack_count(hp->ev_waiting[side]));
+        return;
+    }
+    hp->ev_active[side]++;
+    apr_thread_mutex_unlock(ee->lock);
+
+    tbx_que_put(((side == EV_SIDE_RECV) ? ee->recv_jobs : ee->send_jobs), &job, TBX_QUE_BLOCK);
+}
+
+//************************************************************************
+// ev_job_done - Releases the HP's worker.  If another of the HP's jobs is
+//     waiting it gets the worker instead.
+//************************************************************************
+
+void ev_job_done(hp_event_engine_t *ee, hportal_t *hp, int side)
+{
+    ev_job_t *wjob;
+
+    apr_thread_mutex_lock(ee->lock);
+    wjob = tbx_stack_pop_bottom(hp->ev_waiting[side]);
+    if (wjob == NULL) hp->ev_active[side]--;
+    apr_thread_mutex_unlock(ee->lock);
+
+    if (wjob != NULL) {
+        tbx_que_put(((side == EV_SIDE_RECV) ? ee->recv_jobs : ee->send_jobs), wjob, TBX_QUE_BLOCK);
+        free(wjob);
+    }
+}
+
+//************************************************************************
+// ev_close_ready - Returns 1 if the connection can be torn down.  This is
+//     only the case once the hportal sent the official CONN_CLOSE and no
+//     worker or loop is referencing the connection.
+//     NOTE: Should be holding loop->lock
+//************************************************************************
+
+int ev_close_ready(hconn_t *hc)
+{
+    if ((hc->ev_closing != 2) || (hc->ev_sending != 0) || (hc->ev_recv != EV_RECV_IDLE)) return(0);
+    return((tbx_stack_count(hc->recv_que) == 0) ? 1 : 0);
+}
+
+//************************************************************************
+// ev_hconn_closed - Removes the connection from the loop and notifies the
+//     hportal.  After this the connection is owned by the hportal thread
+//     which destroys it.
+//************************************************************************
+
+void ev_hconn_closed(hconn_t *hc)
+{
+    hp_event_loop_t *loop = hc->loop;
+    hpc_cmd_t cmd;
+
+    apr_thread_mutex_lock(loop->lock);
+    ev_disarm(hc);
+    if (hc->loop_ele != NULL) {
+        tbx_stack_move_to_ptr(loop->conn_list, hc->loop_ele);
+        tbx_stack_delete_current(loop->conn_list, 1, 0);
+        hc->loop_ele = NULL;
+    }
+    apr_thread_mutex_unlock(loop->lock);
+
+    log_printf(15, "hp=%s CONN_CLOSED\n", hc->hp->skey);
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = CONN_CLOSED;
+    cmd.hc = hc;
+    cmd.ptr = hc->ev_close_hp;
+    tbx_que_put(hc->outgoing, &cmd, TBX_QUE_BLOCK);
+}
+
+//************************************************************************
+// ev_close_request - Flags the connection as failed and asks the hportal
+//     to close it.
+//     NOTE: Should be holding loop->lock.  Returns 1 if the caller should
+//           send the CONN_CLOSE_REQUEST after releasing the lock.
+//************************************************************************
+
+int ev_close_request(hconn_t *hc, int reason)
+{
+    hc->ev_failed = 1;
+    if (hc->ev_closing != 0) return(0);
+
+    hc->ev_closing = 1;
+    hc->reason = reason;
+    return(1);
+}
+
+//************************************************************************
+// ev_send_close_request - Sends the CONN_CLOSE_REQUEST to the hportal
+//************************************************************************
+
+void ev_send_close_request(hconn_t *hc)
+{
+    hpc_cmd_t cmd;
+
+    log_printf(15, "hp=%s sending CONN_CLOSE_REQUEST\n", hc->hp->skey);
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = CONN_CLOSE_REQUEST;
+    cmd.hc = hc;
+    tbx_que_put(hc->outgoing, &cmd, TBX_QUE_BLOCK);
+}
+
+//************************************************************************
+// ev_drain - Sends everything still waiting on the stack back to the
+//     hportal for another try.  These didn't cause the problem so their
+//     retry count is left alone.
+//     NOTE: Should be holding loop->lock.  It's cycled while draining.
+//************************************************************************
+
+void ev_drain(hconn_t *hc, tbx_stack_t *que)
+{
+    gop_op_generic_t *gop;
+
+    while ((gop = tbx_stack_pop_bottom(que)) != NULL) {
+        apr_thread_mutex_unlock(hc->loop->lock);
+        hp_gop_retry(hc, gop, 0);
+        apr_thread_mutex_lock(hc->loop->lock);
+    }
+}
+
+//************************************************************************
+// ev_connect - Makes the connection and adds it to the loop
+//************************************************************************
+
+void ev_connect(hconn_t *hc)
+{
+    hportal_t *hp = hc->hp;
+    gop_portal_context_t *hpc = hp->hpc;
+    hp_event_loop_t *loop = hc->loop;
+    hpc_cmd_t cmd;
+    int err;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.hc = hc;
+
+    err = hpc->fn->connect(hc->ns, hp->connect_context, hp->host, hp->port, hpc->dt_connect);
+    if (err == 0) {
+        hc->fd = tbx_ns_native_fd_get(hc->ns);
+        if (hc->fd == -1) {
+            log_printf(0, "ERROR no native fd! hp=%s ns=%d\n", hp->skey, tbx_ns_getid(hc->ns));
+            hpc->fn->close_connection(hc->ns);
+            err = 1;
+        }
+    }
+
+    if (err) {  //** Failed so just let the hportal know
+        log_printf(10, "FAILED hp=%s CONN_CLOSED\n", hp->skey);
+        hc->reason = 3;
+        cmd.cmd = CONN_CLOSED;
+        tbx_que_put(hc->outgoing, &cmd, TBX_QUE_BLOCK);
+        return;
+    }
+
+    apr_thread_mutex_lock(loop->lock);
+    hc->ev_last_used = apr_time_now();
+    tbx_stack_push(loop->conn_list, hc);
+    hc->loop_ele = tbx_stack_get_current_ptr(loop->conn_list);
+    apr_thread_mutex_unlock(loop->lock);
+
+    log_printf(15, "hp=%s CONN_READY\n", hp->skey);
+    cmd.cmd = CONN_READY;
+    tbx_que_put(hc->outgoing, &cmd, TBX_QUE_BLOCK);
+}
+
+//************************************************************************
+// ev_send - Sends the next queued command.  Sent commands are moved to
+//     the recv_que and the connection is armed for the response.  If more
+//     are waiting the connection goes to the back of the line so a single
+//     connection can't hog the worker.  If the socket is full the
+//     connection waits in its loop for room instead of holding the worker.
+//************************************************************************
+
+void ev_send(hconn_t *hc)
+{
+    hp_event_loop_t *loop = hc->loop;
+    gop_op_generic_t *gop;
+    gop_command_op_t *hop;
+    gop_op_status_t status;
+    struct pollfd pfd;
+    int notify, closed, requeue, forced;
+
+    notify = closed = requeue = 0;
+    gop = NULL;
+
+    apr_thread_mutex_lock(loop->lock);
+    forced = hc->ev_send_forced;
+    hc->ev_send_forced = 0;
+    if ((hc->ev_failed == 0) && (hc->ev_closing != 2) && (tbx_stack_count(hc->send_que) > 0)) {
+        if (forced == 0) {  //** Make sure there's room.  If not let the loop tell us when there is
+            pfd.fd = hc->fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 0) == 0) {
+                if (ev_send_wait(hc) == 0) {
+                    apr_thread_mutex_unlock(loop->lock);
+                    return;
+                }
+                notify += ev_close_request(hc, 0);
+            }
+        }
+
+        if (hc->ev_failed == 0) gop = tbx_stack_pop_bottom(hc->send_que);
+    }
+
+    if (gop != NULL) {
+        //** If nothing is ahead of us then we're on top
+        if ((tbx_stack_count(hc->recv_que) == 0) && (hc->ev_recv != EV_RECV_ACTIVE)) tbx_atomic_set(gop->op->cmd.on_top, 1);
+        apr_thread_mutex_unlock(loop->lock);
+
+        log_printf(15, "hp=%s gid=%d\n", hc->hp->skey, gop_id(gop));
+        hop = &(gop->op->cmd);
+        hop->start_time = apr_time_now();  //** This is changed in the recv phase also
+        hop->end_time = hop->start_time + hop->timeout;
+
+        status = (hop->send_command != NULL) ? hop->send_command(gop, hc->ns) : gop_success_status;
+        if (status.op_status == OP_STATE_SUCCESS) {
+            status = (hop->send_phase != NULL) ? hop->send_phase(gop, hc->ns) : gop_success_status;
+        }
+        log_printf(15, "hp=%s gid=%d send status=%d\n", hc->hp->skey, gop_id(gop), status.op_status);
+
+        apr_thread_mutex_lock(loop->lock);
+        hc->ev_last_used = apr_time_now();
+        if (status.op_status != OP_STATE_SUCCESS) {  //** This one caused the problem so it's charged a retry
+            hc->last_status = status;
+            notify += ev_close_request(hc, 0);
+            apr_thread_mutex_unlock(loop->lock);
+            hp_gop_retry(hc, gop, -1);
+            apr_thread_mutex_lock(loop->lock);
+        } else {
+            tbx_stack_move_to_top(hc->recv_que);
+            tbx_stack_insert_above(hc->recv_que, gop);
+            if (hc->ev_recv == EV_RECV_IDLE) {
+                if (ev_arm(hc) != 0) notify += ev_close_request(hc, 0);
+            }
+        }
+    }
+
+    if ((hc->ev_failed == 1) || (hc->ev_closing == 2)) ev_drain(hc, hc->send_que);  //** No more sending so give them back
+    if (tbx_stack_count(hc->send_que) > 0) {
+        requeue = 1;  //** Keep ownership and get back in line
+    } else {
+        hc->ev_sending = 0;
+        if ((hc->ev_failed == 1) && (hc->ev_recv == EV_RECV_IDLE)) ev_drain(hc, hc->recv_que);  //** Nothing will process these
+        closed = ev_close_ready(hc);
+    }
+    apr_thread_mutex_unlock(loop->lock);
+
+    if (notify) ev_send_close_request(hc);
+    if (requeue) ev_dispatch(loop->ee, hc, EV_JOB_SEND);
+    if (closed) ev_hconn_closed(hc);
+}
+
+//************************************************************************
+// ev_recv - Processes the responses.  Keeps going as long as the next
+//     response is already buffered in the ns.  Otherwise the connection
+//     is rearmed.
+//************************************************************************
+
+void ev_recv(hconn_t *hc)
+{
+    hp_event_loop_t *loop = hc->loop;
+    gop_op_generic_t *gop;
+    gop_command_op_t *hop;
+    gop_op_status_t status;
+    hpc_cmd_t cmd;
+    int notify, closed;
+
+    memset(&cmd, 0, sizeof(cmd));
+    notify = 0;
+
+    apr_thread_mutex_lock(loop->lock);
+    while (1) {
+        if (hc->ev_failed == 1) {  //** The connection is hosed so give them back
+            ev_drain(hc, hc->recv_que);
+            hc->ev_recv = EV_RECV_IDLE;
+            break;
+        }
+
+        gop = tbx_stack_pop_bottom(hc->recv_que);
+        if (gop == NULL) {
+            hc->ev_recv = EV_RECV_IDLE;
+            break;
+        }
+        apr_thread_mutex_unlock(loop->lock);
+
+        tbx_atomic_set(gop->op->cmd.on_top, 1);
+        log_printf(15, "hp=%s gid=%d\n", hc->hp->skey, gop_id(gop));
+        hop = &(gop->op->cmd);
+        status = (hop->recv_phase != NULL) ? hop->recv_phase(gop, hc->ns) : gop_success_status;
+        hop->end_time = apr_time_now();
+
+        if (status.op_status == OP_STATE_RETRY) {  //** Kick out and handle the retry
+            apr_thread_mutex_lock(loop->lock);
+            hc->last_status = status;
+            notify += ev_close_request(hc, 0);
+            apr_thread_mutex_unlock(loop->lock);
+            hp_gop_retry(hc, gop, -1);
+            apr_thread_mutex_lock(loop->lock);
+            continue;
+        }
+
+        cmd.gop_workload = hop->workload;
+        cmd.gop_dt = hop->end_time - hop->start_time;
+        cmd.cmd = CONN_GOP_DONE;
+        cmd.hc = hc;
+        cmd.ptr = NULL;
+        log_printf(15, "hp=%s gid=%d status=%d\n", hc->hp->skey, gop_id(gop), status.op_status);
+        hc->last_status = status;
+        gop_mark_completed(gop, status);
+        tbx_que_put(hc->outgoing, &cmd, TBX_QUE_BLOCK);
+
+        apr_thread_mutex_lock(loop->lock);
+        hc->ev_last_used = apr_time_now();
+        if (status.op_status != OP_STATE_SUCCESS) {  //** Same as the recv thread and close the connection
+            notify += ev_close_request(hc, 0);
+            continue;
+        }
+        if (tbx_stack_count(hc->recv_que) == 0) {
+            hc->ev_recv = EV_RECV_IDLE;
+            break;
+        }
+
+        if (tbx_ns_read_pending(hc->ns) > 0) continue;  //** Already have the next response
+
+        //** Let the next one know it's on top and wait for its response
+        tbx_stack_move_to_bottom(hc->recv_que);
+        gop = tbx_stack_get_current_data(hc->recv_que);
+        tbx_atomic_set(gop->op->cmd.on_top, 1);
+        if (ev_arm(hc) != 0) {
+            notify += ev_close_request(hc, 0);
+            continue;
+        }
+        break;
+    }
+
+    closed = ev_close_ready(hc);
+    apr_thread_mutex_unlock(loop->lock);
+
+    if (notify) ev_send_close_request(hc);
+    if (closed) ev_hconn_closed(hc);
+}
+
+//************************************************************************
+// ev_sweep - Hands off connections whose response is overdue so the
+//     recv_phase can time out, forces out sends that have waited too long
+//     for room so the send_command can time out, and requests closing idle
+//     connections.
+//************************************************************************
+
+void ev_sweep(hp_event_loop_t *loop)
+{
+    gop_portal_context_t *hpc = loop->ee->hpc;
+    gop_op_generic_t *gop;
+    hconn_t *hc;
+    tbx_stack_t *idle, *send, *recv;
+    apr_time_t now;
+
+    idle = tbx_stack_new();
+    send = tbx_stack_new();
+    recv = tbx_stack_new();
+    now = apr_time_now();
+
+    apr_thread_mutex_lock(loop->lock);
+    for (hc = tbx_stack_top_first(loop->conn_list); hc != NULL; hc = tbx_stack_next_down(loop->conn_list)) {
+        if (hc->ev_send_armed == 1) {
+            tbx_stack_move_to_bottom(hc->send_que);
+            gop = tbx_stack_get_current_data(hc->send_que);
+            if ((gop == NULL) || (hc->ev_failed == 1) || (hc->ev_closing == 2) || ((now - hc->ev_send_wait_start) > gop->op->cmd.timeout)) {
+                log_printf(10, "Overdue send hp=%s gid=%d\n", hc->hp->skey, ((gop) ? gop_id(gop) : -1));
+                hc->ev_send_armed = 0;
+                hc->ev_send_forced = 1;
+                ev_update(hc);
+                tbx_stack_push(send, hc);
+            }
+        }
+
+        if (hc->ev_recv == EV_RECV_ARMED) {
+            tbx_stack_move_to_bottom(hc->recv_que);
+            gop = tbx_stack_get_current_data(hc->recv_que);
+            if ((gop != NULL) && (gop->op->cmd.end_time < now)) {  //** Overdue so let the recv_phase deal with it
+                log_printf(10, "Overdue response hp=%s gid=%d\n", hc->hp->skey, gop_id(gop));
+                hc->ev_recv = EV_RECV_ACTIVE;
+                ev_update(hc);
+                tbx_stack_push(recv, hc);
+            }
+        } else if ((hc->ev_recv == EV_RECV_IDLE) && (hc->ev_sending == 0) && (hc->ev_closing == 0) &&
+                   (tbx_stack_count(hc->send_que) == 0) && ((now - hc->ev_last_used) > hpc->max_idle)) {
+            ev_close_request(hc, 1);
+            tbx_stack_push(idle, hc);
+        }
+    }
+    apr_thread_mutex_unlock(loop->lock);
+
+    while ((hc = tbx_stack_pop(send)) != NULL) {
+        ev_dispatch(loop->ee, hc, EV_JOB_SEND);
+    }
+    while ((hc = tbx_stack_pop(recv)) != NULL) {
+        ev_dispatch(loop->ee, hc, EV_JOB_RECV);
+    }
+
+    //** The hportal will reply with a CONN_CLOSE so these can't be destroyed yet
+    while ((hc = tbx_stack_pop(idle)) != NULL) {
+        ev_send_close_request(hc);
+    }
+    tbx_stack_free(idle, 0);
+    tbx_stack_free(send, 0);
+    tbx_stack_free(recv, 0);
+}
+
+//************************************************************************
+// ev_loop_thread - Waits for responses and room to send and hands the
+//     connections off to the workers
+//************************************************************************
+
+void *ev_loop_thread(apr_thread_t *th, void *arg)
+{
+    hp_event_loop_t *loop = arg;
+    struct epoll_event events[EV_MAX_EVENTS];
+    hconn_t *hc;
+    apr_time_t next_sweep;
+    int i, n, do_send, do_recv, finished;
+
+    next_sweep = apr_time_now() + apr_time_from_sec(1);
+    do {
+        n = epoll_wait(loop->epfd, events, EV_MAX_EVENTS, EV_WAIT_MS);
+        for (i=0; i<n; i++) {
+            hc = (hconn_t *)events[i].data.ptr;
+
+            apr_thread_mutex_lock(loop->lock);
+            do_send = do_recv = 0;
+            if ((hc->ev_send_armed == 1) && (events[i].events & (EPOLLOUT|EPOLLERR|EPOLLHUP))) {
+                hc->ev_send_armed = 0;
+                do_send = 1;
+            }
+            if ((hc->ev_recv == EV_RECV_ARMED) && (events[i].events & (EPOLLIN|EPOLLRDHUP|EPOLLERR|EPOLLHUP))) {
+                hc->ev_recv = EV_RECV_ACTIVE;
+                do_recv = 1;
+            }
+            if ((hc->ev_send_armed == 1) || (hc->ev_recv == EV_RECV_ARMED)) ev_update(hc);  //** Rearm whatever is still waiting
+            apr_thread_mutex_unlock(loop->lock);
+
+            if (do_send == 1) ev_dispatch(loop->ee, hc, EV_JOB_SEND);
+            if (do_recv == 1) ev_dispatch(loop->ee, hc, EV_JOB_RECV);
+        }
+
+        if (apr_time_now() > next_sweep) {
+            ev_sweep(loop);
+            next_sweep = apr_time_now() + apr_time_from_sec(1);
+        }
+
+        apr_thread_mutex_lock(loop->lock);
+        finished = loop->shutdown;
+        apr_thread_mutex_unlock(loop->lock);
+    } while (finished == 0);
+
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+//************************************************************************
+// ev_worker - Processes jobs from the given que and releases the HP's
+//     worker after each one.  The send and recv sides use separate pools
+//     so a send blocked on a full socket can never keep the responses
+//     from being read.
+//************************************************************************
+
+void ev_worker(hp_event_engine_t *ee, tbx_que_t *que, int side)
+{
+    hportal_t *hp;
+    ev_job_t job;
+
+    while (tbx_que_get(que, &job, TBX_QUE_BLOCK) == 0) {
+        if (job.cmd == EV_JOB_SHUTDOWN) break;
+
+        hp = job.hc->hp;  //** The hconn could be gone once the job completes
+        switch (job.cmd) {
+            case EV_JOB_CONNECT:
+                ev_connect(job.hc);
+                break;
+            case EV_JOB_SEND:
+                ev_send(job.hc);
+                break;
+            case EV_JOB_RECV:
+                ev_recv(job.hc);
+                break;
+        }
+        ev_job_done(ee, hp, side);
+    }
+}
+
+void *ev_send_worker_thread(apr_thread_t *th, void *arg)
+{
+    hp_event_engine_t *ee = arg;
+
+    ev_worker(ee, ee->send_jobs, EV_SIDE_SEND);
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+void *ev_recv_worker_thread(apr_thread_t *th, void *arg)
+{
+    hp_event_engine_t *ee = arg;
+
+    ev_worker(ee, ee->recv_jobs, EV_SIDE_RECV);
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+//************************************************************************
+// ev_hconn_start - Assigns the connection to a loop and queues the connect
+//************************************************************************
+
+void ev_hconn_start(hp_event_engine_t *ee, hconn_t *hc)
+{
+    hc->loop = &(ee->loop[ee->next_loop]);
+    ee->next_loop = (ee->next_loop + 1) % ee->n_loops;
+    hc->send_que = tbx_stack_new();
+    hc->recv_que = tbx_stack_new();
+    hc->fd = -1;
+
+    ev_dispatch(ee, hc, EV_JOB_CONNECT);
+}
+
+//************************************************************************
+// ev_hconn_put - Event engine version of passing a command to the
+//     connection.  Returns 0 if the command was accepted.
+//************************************************************************
+
+int ev_hconn_put(hconn_t *hc, hpc_cmd_t *cmd)
+{
+    hp_event_loop_t *loop = hc->loop;
+    int closed, dispatch;
+
+    closed = dispatch = 0;
+
+    apr_thread_mutex_lock(loop->lock);
+    if (cmd->cmd == CONN_CLOSE) {
+        hc->ev_closing = 2;
+        hc->ev_close_hp = cmd->ptr;
+        if (hc->ev_sending == 0) {
+            if (tbx_stack_count(hc->send_que) > 0) {  //** Let a worker hand these back
+                hc->ev_sending = 1;
+                dispatch = 1;
+            } else {
+                closed = ev_close_ready(hc);
+            }
+        }
+    } else {
+        if ((hc->ev_failed == 1) || (hc->ev_closing != 0)) {  //** Leave it on the HP's pending que
+            apr_thread_mutex_unlock(loop->lock);
+            return(1);
+        }
+
+        tbx_stack_move_to_top(hc->send_que);
+        tbx_stack_insert_above(hc->send_que, cmd->ptr);
+        if (hc->ev_sending == 0) {
+            hc->ev_sending = 1;
+            dispatch = 1;
+        }
+    }
+    apr_thread_mutex_unlock(loop->lock);
+
+    if (dispatch) ev_dispatch(loop->ee, hc, EV_JOB_SEND);
+    if (closed) ev_hconn_closed(hc);
+
+    return(0);
+}
+
+//************************************************************************
+// ev_engine_create - Creates the event loops and worker pools
+//************************************************************************
+
+hp_event_engine_t *ev_engine_create(gop_portal_context_t *hpc)
+{
+    hp_event_engine_t *ee;
+    hp_event_loop_t *loop;
+    int i;
+
+    tbx_type_malloc_clear(ee, hp_event_engine_t, 1);
+    ee->hpc = hpc;
+    ee->n_loops = hpc->event_loops;
+    ee->n_send = (hpc->event_send_threads > 0) ? hpc->event_send_threads : 1;
+    ee->n_recv = (hpc->event_recv_threads > 0) ? hpc->event_recv_threads : 1;
+    ee->hp_workers = (hpc->event_hp_workers > 0) ? hpc->event_hp_workers : 1;
+    assert_result(apr_pool_create(&(ee->mpool), NULL), APR_SUCCESS);
+    apr_thread_mutex_create(&(ee->lock), APR_THREAD_MUTEX_DEFAULT, ee->mpool);
+
+    tbx_type_malloc_clear(ee->loop, hp_event_loop_t, ee->n_loops);
+    for (i=0; i<ee->n_loops; i++) {
+        loop = &(ee->loop[i]);
+        loop->ee = ee;
+        loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (loop->epfd == -1) {
+            log_printf(0, "ERROR creating epoll handle! hpc=%s errno=%d\n", hpc->name, errno);
+            for (i=i-1; i>=0; i--) close(ee->loop[i].epfd);
+            apr_pool_destroy(ee->mpool);
+            free(ee->loop);
+            free(ee);
+            return(NULL);
+        }
+        loop->conn_list = tbx_stack_new();
+        apr_thread_mutex_create(&(loop->lock), APR_THREAD_MUTEX_DEFAULT, ee->mpool);
+    }
+
+    //** The jobs are bounded by the number of connections so make plenty of room
+    ee->send_jobs = tbx_que_create(10000, sizeof(ev_job_t));
+    ee->recv_jobs = tbx_que_create(10000, sizeof(ev_job_t));
+
+    tbx_type_malloc_clear(ee->send_worker, apr_thread_t *, ee->n_send);
+    for (i=0; i<ee->n_send; i++) {
+        tbx_thread_create_assert(&(ee->send_worker[i]), NULL, ev_send_worker_thread, (void *)ee, ee->mpool);
+    }
+    tbx_type_malloc_clear(ee->recv_worker, apr_thread_t *, ee->n_recv);
+    for (i=0; i<ee->n_recv; i++) {
+        tbx_thread_create_assert(&(ee->recv_worker[i]), NULL, ev_recv_worker_thread, (void *)ee, ee->mpool);
+    }
+    for (i=0; i<ee->n_loops; i++) {
+        tbx_thread_create_assert(&(ee->loop[i].thread), NULL, ev_loop_thread, (void *)&(ee->loop[i]), ee->mpool);
+    }
+
+    log_printf(5, "hpc=%s event_loops=%d send_threads=%d recv_threads=%d hp_workers=%d\n", hpc->name, ee->n_loops, ee->n_send, ee->n_recv, ee->hp_workers);
+
+    return(ee);
+}
+
+//************************************************************************
+// ev_engine_destroy - Shuts down the event engine.  All the connections
+//     should already be closed.
+//************************************************************************
+
+void ev_engine_destroy(hp_event_engine_t *ee)
+{
+    apr_status_t dummy;
+    ev_job_t job;
+    int i;
+
+    //** Stop the loops first so no more recv jobs are generated
+    for (i=0; i<ee->n_loops; i++) {
+        apr_thread_mutex_lock(ee->loop[i].lock);
+        ee->loop[i].shutdown = 1;
+        apr_thread_mutex_unlock(ee->loop[i].lock);
+        apr_thread_join(&dummy, ee->loop[i].thread);
+    }
+
+    job.cmd = EV_JOB_SHUTDOWN;
+    job.hc = NULL;
+    for (i=0; i<ee->n_send; i++) tbx_que_put(ee->send_jobs, &job, TBX_QUE_BLOCK);
+    for (i=0; i<ee->n_recv; i++) tbx_que_put(ee->recv_jobs, &job, TBX_QUE_BLOCK);
+    for (i=0; i<ee->n_send; i++) apr_thread_join(&dummy, ee->send_worker[i]);
+    for (i=0; i<ee->n_recv; i++) apr_thread_join(&dummy, ee->recv_worker[i]);
+
+    for (i=0; i<ee->n_loops; i++) {
+        close(ee->loop[i].epfd);
+        tbx_stack_free(ee->loop[i].conn_list, 0);
+        apr_thread_mutex_destroy(ee->loop[i].lock);
+    }
+
+    tbx_que_destroy(ee->send_jobs);
+    tbx_que_destroy(ee->recv_jobs);
+    apr_thread_mutex_destroy(ee->lock);
+    apr_pool_destroy(ee->mpool);
+    free(ee->send_worker);
+    free(ee->recv_worker);
+    free(ee->loop);
+    free(ee);
+}
+
+#else
+
+//** No epoll so the connections always use the send/recv threads
+hp_event_engine_t *ev_engine_create(gop_portal_context_t *hpc)
+{
+    log_printf(0, "hpc=%s epoll not supported.  Using a send/recv thread per connection\n", hpc->name);
+    return(NULL);
+}
+
+void ev_engine_destroy(hp_event_engine_t *ee) { }
+void ev_hconn_start(hp_event_engine_t *ee, hconn_t *hc) { }
+int ev_hconn_put(hconn_t *hc, hpc_cmd_t *cmd) { return(1); }
+
+#endif
+
+//************************************************************************
+// hconn_put - Passes the command to the connection
+//************************************************************************
+
+int hconn_put(hconn_t *hc, hpc_cmd_t *cmd, apr_time_t dt)
+{
+    if (hc->loop != NULL) return(ev_hconn_put(hc, cmd));
+
+    return(tbx_que_put(hc->incoming, cmd, dt));
+}
+
 //************************************************************************
 //  hconn_new - Creates a new Hportal connection
 //************************************************************************
@@ -1445,13 +2551,24 @@ hconn_t *hconn_new(hportal_t *hp, tbx_que_t *outgoing, apr_pool_t *mpool)
 
     hc->hp = hp;
     hp->limbo_conn++;
-    hc->incoming = tbx_que_create(1000, sizeof(hpc_cmd_t));
-    hc->internal = tbx_que_create(10000, sizeof(hpc_cmd_t));
     hc->ns = tbx_ns_new();
     hc->start_time = apr_time_now();
-
     hc->outgoing = hp->hpc->que;
 
+    //** See if we use the event engine
+    if ((hp->hpc->event_loops > 0) && (hp->hpc->ev == NULL)) {
+        hp->hpc->ev = ev_engine_create(hp->hpc);
+        if (hp->hpc->ev == NULL) hp->hpc->event_loops = 0;  //** Fall back to threads
+    }
+    if (hp->hpc->ev != NULL) {
+        log_printf(10, "CREATE hp=%s event\n", hp->skey);
+        ev_hconn_start(hp->hpc->ev, hc);
+        return(hc);
+    }
+
+    hc->incoming = tbx_que_create(1000, sizeof(hpc_cmd_t));
+    hc->internal = tbx_que_create(10000, sizeof(hpc_cmd_t));
+
     log_printf(10, "CREATE hp=%s\n", hp->skey);
     int i = 0;
     do {
@@ -1487,9 +2604,15 @@ void hconn_destroy(hconn_t *hc)
     apr_status_t val;
 
     log_printf(10, "DESTROY\n");
-    apr_thread_join(&val, hc->send_thread);
-    tbx_que_destroy(hc->incoming);
-    tbx_que_destroy(hc->internal);
+    if (hc->loop != NULL) {  //** Event engine connection so just close the socket
+        if (hc->fd != -1) hc->hp->hpc->fn->close_connection(hc->ns);
+        tbx_stack_free(hc->send_que, 0);
+        tbx_stack_free(hc->recv_que, 0);
+    } else {
+        apr_thread_join(&val, hc->send_thread);
+        tbx_que_destroy(hc->incoming);
+        tbx_que_destroy(hc->internal);
+    }
     tbx_ns_destroy(hc->ns);
 
     free(hc);
@@ -1518,9 +2641,12 @@ hportal_t *hp_create(gop_portal_context_t *hpc, char *hostport)
 
     hp->conn_list = tbx_stack_new();
     hp->pending = tbx_stack_new();
+    hp->ev_waiting[EV_SIDE_SEND] = tbx_stack_new();
+    hp->ev_waiting[EV_SIDE_RECV] = tbx_stack_new();
     hp->workload_pending = 0;
     hp->hpc = hpc;
     hp->stable_conn = hpc->max_conn;
+    hp_limits_update(hpc, hp);
 
     return(hp);
 }
@@ -1539,6 +2665,8 @@ void hp_destroy(hportal_t *hp)
     free(hp->host);
     tbx_stack_free(hp->conn_list, 0);
     tbx_stack_free(hp->pending, 0);
+    tbx_stack_free(hp->ev_waiting[EV_SIDE_SEND], 1);
+    tbx_stack_free(hp->ev_waiting[EV_SIDE_RECV], 1);
     free(hp);
 }
 
@@ -1630,6 +2758,60 @@ double gop_hpc_min_bw_fraction_get(gop_portal_context_t *hpc) { return(hpc->min_
 void gop_hpc_mix_latest_fraction_set(gop_portal_context_t *hpc, double d) { hpc->mix_latest_fraction = d; }
 double gop_hpc_mix_latest_fraction_get(gop_portal_context_t *hpc) { return(hpc->mix_latest_fraction); }
 
+//************************************************************************
+// gop_hpc_hostport_estimate - Returns the estimated time for a task with the
+//     given workload to complete on the host.  This includes the work already
+//     queued for the host.  Returns 0 if there is no history for the host and
+//     INT64_MAX if the host is flagged as dead.  Higher layers use this to
+//     pick the fastest source when there is a choice.
+//************************************************************************
+
+apr_time_t gop_hpc_hostport_estimate(gop_portal_context_t *hpc, char *hostport, int64_t workload)
+{
+    hportal_t *hp;
+    apr_time_t dt;
+    double queued;
+
+    if (hpc->stats_lock == NULL) return(0);
+
+    dt = 0;
+    apr_thread_mutex_lock(hpc->stats_lock);
+    hp = apr_hash_get(hpc->hp, hostport, APR_HASH_KEY_STRING);
+    if (hp != NULL) {
+        if (hp->stats_dead == 1) {
+            dt = INT64_MAX;
+        } else if (hp->stats_bw > 0) {  //** The queued work is spread over the connections
+            queued = (hp->stats_conn > 1) ? (1.0*hp->stats_workload) / hp->stats_conn : hp->stats_workload;
+            dt = ((queued + workload) * apr_time_from_sec(1)) / hp->stats_bw;
+        }
+    }
+    apr_thread_mutex_unlock(hpc->stats_lock);
+
+    return(dt);
+}
+
+//************************************************************************
+// gop_hpc_hostport_latency - Returns the command time for the given fraction
+//     of the host's recent commands, ie 0.99 for the 99th percentile.
+//     Returns 0 if there is no history for the host.
+//************************************************************************
+
+apr_time_t gop_hpc_hostport_latency(gop_portal_context_t *hpc, char *hostport, double fraction)
+{
+    hportal_t *hp;
+    apr_time_t dt;
+
+    if (hpc->stats_lock == NULL) return(0);
+
+    dt = 0;
+    apr_thread_mutex_lock(hpc->stats_lock);
+    hp = apr_hash_get(hpc->hp, hostport, APR_HASH_KEY_STRING);
+    if (hp != NULL) dt = hp_latency_quantile(hp, fraction);
+    apr_thread_mutex_unlock(hpc->stats_lock);
+
+    return(dt);
+}
+
 //************************************************************************
 // gop_hpc_print_running_config - Prints the running config
 //************************************************************************
@@ -1651,7 +2833,14 @@ void gop_hpc_print_running_config(gop_portal_context_t *hpc, FILE *fd, int print
     fprintf(fd, "hc_history_size = %d\n", hpc->hc_history_size);
     fprintf(fd, "retry_history_size = %d\n", hpc->retry_history_size);
     fprintf(fd, "max_workload_conn = %s\n", tbx_stk_pretty_print_int_with_scale(hpc->max_workload, text));
+    fprintf(fd, "min_workload_conn = %s\n", tbx_stk_pretty_print_int_with_scale(hpc->min_workload, text));
+    fprintf(fd, "latency_target = %s\n", tbx_stk_pretty_print_time(hpc->latency_target, 0, text));
+    fprintf(fd, "max_inflight_conn = %d\n", hpc->max_inflight);
     fprintf(fd, "mix_latest_fraction = %s\n", tbx_stk_pretty_print_double_with_scale(1000, hpc->mix_latest_fraction, text));
+    fprintf(fd, "event_loops = %d\n", hpc->event_loops);
+    fprintf(fd, "event_send_threads = %d\n", hpc->event_send_threads);
+    fprintf(fd, "event_recv_threads = %d\n", hpc->event_recv_threads);
+    fprintf(fd, "event_hp_workers = %d\n", hpc->event_hp_workers);
     fprintf(fd, "\n");
 }
 
@@ -1673,6 +2862,7 @@ gop_portal_context_t *gop_hp_context_create(gop_portal_fn_t *imp, char *name)
 
     assert_result(apr_pool_create(&(hpc->pool), NULL), APR_SUCCESS);
     hpc->hp = apr_hash_make(hpc->pool); FATAL_UNLESS(hpc->hp != NULL);
+    apr_thread_mutex_create(&(hpc->stats_lock), APR_THREAD_MUTEX_DEFAULT, hpc->pool);
     hpc->que = tbx_que_create(10000, sizeof(hpc_cmd_t));
 
     hpc->dead_disable = hpc_default_options.dead_disable;
@@ -1686,9 +2876,16 @@ gop_portal_context_t *gop_hp_context_create(gop_portal_fn_t *imp, char *name)
     hpc->max_conn = hpc_default_options.max_conn;
     hpc->dt_connect = hpc_default_options.dt_connect;
     hpc->max_workload = hpc_default_options.max_workload;
+    hpc->min_workload = hpc_default_options.min_workload;
+    hpc->latency_target = hpc_default_options.latency_target;
+    hpc->max_inflight = hpc_default_options.max_inflight;
     hpc->hc_history_size = hpc_default_options.hc_history_size;
     hpc->retry_history_size = hpc_default_options.retry_history_size;
     hpc->mix_latest_fraction = hpc_default_options.mix_latest_fraction;
+    hpc->event_loops = hpc_default_options.event_loops;
+    hpc->event_send_threads = hpc_default_options.event_send_threads;
+    hpc->event_recv_threads = hpc_default_options.event_recv_threads;
+    hpc->event_hp_workers = hpc_default_options.event_hp_workers;
     tbx_ns_timeout_set(&(hpc->dt_connect), 1, 0);
 
     tbx_thread_create_warn(err, &(hpc->main_thread), NULL, hportal_thread, (void *)hpc, hpc->pool);
@@ -1717,9 +2914,16 @@ void gop_hpc_load(gop_portal_context_t *hpc, tbx_inip_file_t *fd, char *section)
     hpc->max_conn = tbx_inip_get_integer(fd, section, "max_host_conn", hpc_default_options.max_conn);
     hpc->dt_connect = hpc_default_options.dt_connect;
     hpc->max_workload = tbx_inip_get_integer(fd, section, "max_workload_conn", hpc_default_options.max_workload);
+    hpc->min_workload = tbx_inip_get_integer(fd, section, "min_workload_conn", hpc_default_options.min_workload);
+    hpc->latency_target = tbx_inip_get_time(fd, section, "latency_target", tbx_stk_pretty_print_time(hpc_default_options.latency_target, 0, text));
+    hpc->max_inflight = tbx_inip_get_integer(fd, section, "max_inflight_conn", hpc_default_options.max_inflight);
     hpc->mix_latest_fraction = tbx_inip_get_double(fd, section, "mix_latest_fraction", hpc_default_options.mix_latest_fraction);
     hpc->hc_history_size = tbx_inip_get_integer(fd, section, "hc_history_size", hpc_default_options.hc_history_size);
     hpc->retry_history_size = tbx_inip_get_integer(fd, section, "retry_history_size", hpc_default_options.retry_history_size);
+    hpc->event_loops = tbx_inip_get_integer(fd, section, "event_loops", hpc_default_options.event_loops);
+    hpc->event_send_threads = tbx_inip_get_integer(fd, section, "event_send_threads", hpc_default_options.event_send_threads);
+    hpc->event_recv_threads = tbx_inip_get_integer(fd, section, "event_recv_threads", hpc_default_options.event_recv_threads);
+    hpc->event_hp_workers = tbx_inip_get_integer(fd, section, "event_hp_workers", hpc_default_options.event_hp_workers);
     tbx_ns_timeout_set(&(hpc->dt_connect), 1, 0);
 }
 
@@ -1744,6 +2948,7 @@ void gop_hp_context_destroy(gop_portal_context_t *hpc)
     //** Cleanup
     tbx_que_destroy(hpc->que);
     apr_hash_clear(hpc->hp);
+    apr_thread_mutex_destroy(hpc->stats_lock);
     apr_pool_destroy(hpc->pool);
 
 submit_only:
@@ -25,15 +25,19 @@
 #include <sys/socket.h>
 #include <apr_thread_proc.h>
 #include <apr_thread_mutex.h>
+#include <apr_thread_cond.h>
 #include <apr_time.h>
 #include <apr_pools.h>
 #include <tbx/assert_result.h>
+#include <tbx/atomic_counter.h>
 #include <tbx/fmttypes.h>
 #include <tbx/log.h>
 #include <tbx/network.h>
 #include <tbx/net_sock.h>
+#include <tbx/packer.h>
 #include <tbx/pigeon_coop.h>
 #include <tbx/stack.h>
+#include <tbx/type_malloc.h>
 #include "activity_log.h"
 #include "ibp_server.h"
 #include "subnet.h"
@@ -47,6 +51,11 @@
 #define alog_lock() apr_thread_mutex_lock(_alog_lock)
 #define alog_unlock() apr_thread_mutex_unlock(_alog_lock)
 
+//** Records are built in a per-thread buffer and published to the thread's ring
+#define alog_rec_begin() _alog_rec_begin()
+#define alog_rec_end() _alog_rec_end()
+#define _alog_fd (_alog_ring_get()->fd)
+
 #define alog_mode_check() if (_alog_max_size <= 0) return(0);
 
 //** Macros for reading/writing the log file
@@ -65,17 +74,32 @@
 #define awrite_ul(fd, buffer, nbytes, ...) \
    if ((int)fwrite(buffer, 1, nbytes, fd) != nbytes) { \
       log_printf(0, __VA_ARGS__); \
-      apr_thread_mutex_unlock(_alog_lock); \
+      _alog_rec_abort(); \
       return(1); \
    }
 
-//** Macro for checking alog size and forcing data to be sent
-#define alog_checksize() \
-   if ((int)ftell(_alog->fd) > _alog_max_size) { \
-      _alog_send_data(); \
-   }
+#define ALOG_REC_MAX   4096          //** Largest record a command can generate
+#define ALOG_RING_HDR  (sizeof(uint32_t) + sizeof(uint64_t))   //** Length and sequence number in front of each ring record
+#define ALOG_WBUF_SIZE (1024*1024)   //** Drained records are collected into writes of this size
+
+typedef struct alog_ring_s alog_ring_t;
+struct alog_ring_s {   //** Per-thread record staging area and the ring it's published to
+   FILE *fd;             //** Where records are written.  Either mem_fd or the log itself if direct
+   FILE *mem_fd;         //** Memory stream the current record is built in
+   char rec[ALOG_REC_MAX];
+   char *ring;           //** Committed records.  Only the owning thread adds and only the drain thread removes
+   uint64_t head;        //** Next byte to drain.  Only advanced by the drain thread
+   uint64_t tail;        //** Next byte to fill.  Only advanced by the owning thread
+   int direct;           //** Records go straight to the log.  Used by the drain thread and alog_open
+   int aborted;          //** A write failed so the current record is thrown away
+   int orphaned;         //** Owning thread has exited.  The ring is freed once it's drained
+   alog_ring_t *next;
+};
 
 void _alog_send_data();  
+alog_ring_t *_alog_ring_get();
+void _alog_ring_orphan(void *arg);
+void _alog_rec_abort();
 
 //***** Global variables used by singleton *******
 apr_thread_mutex_t  *_alog_lock = NULL;
@@ -89,6 +113,21 @@ int64_t _alog_max_size;
 size_t _alog_size;
 int    _alog_count = 0;
 tbx_stack_t *_alog_pending_stack = NULL;
+ns_map_t *_alog_ns_map = NULL;    //** Active connections.  Replayed into each new log file
+int (*_alog_append_header)(FILE *fd, int id, int command) = NULL;
+
+apr_threadkey_t    *_alog_ring_key = NULL;
+apr_thread_mutex_t *_alog_ring_lock = NULL;   //** Protects the ring list
+apr_thread_cond_t  *_alog_drain_cond = NULL;
+apr_thread_t       *_alog_drain_thread = NULL;
+alog_ring_t *_alog_rings = NULL;
+uint64_t _alog_ring_size = 0;     //** Always a power of 2
+uint64_t _alog_seq = 0;           //** Next sequence number handed out to a record
+uint64_t _alog_next_seq = 0;      //** Next sequence number the drain thread writes
+tbx_atomic_int_t _alog_dropped = 0;   //** Records dropped because a ring was full
+int _alog_drain_shutdown = 0;
+char *_alog_wbuf = NULL;
+int _alog_wused = 0;
 
 const env_command_t ECMD_ALOG_SEND = {{{0,0,2,0}}}; 
 
@@ -113,6 +152,9 @@ void alog_init()
   apr_pool_create(&_alog_mpool, NULL);
   apr_thread_mutex_create(&_alog_lock, APR_THREAD_MUTEX_DEFAULT,_alog_mpool);
   apr_thread_mutex_create(&_alog_send_lock, APR_THREAD_MUTEX_DEFAULT,_alog_mpool);
+  apr_thread_mutex_create(&_alog_ring_lock, APR_THREAD_MUTEX_DEFAULT,_alog_mpool);
+  apr_thread_cond_create(&_alog_drain_cond, _alog_mpool);
+  apr_threadkey_private_create(&_alog_ring_key, _alog_ring_orphan, _alog_mpool);
 }
 
 //***********************************************************************************
@@ -124,6 +166,248 @@ void alog_destroy()
   apr_pool_destroy(_alog_mpool);
 }
 
+//***********************************************************************************
+// _alog_ring_orphan - Called when a thread exits.  The drain thread frees the
+//    ring once it's empty.
+//***********************************************************************************
+
+void _alog_ring_orphan(void *arg)
+{
+  alog_ring_t *r = (alog_ring_t *)arg;
+
+  __atomic_store_n(&(r->orphaned), 1, __ATOMIC_RELEASE);
+}
+
+//***********************************************************************************
+// _alog_ring_get - Returns the calling thread's ring, creating it if needed
+//***********************************************************************************
+
+alog_ring_t *_alog_ring_get()
+{
+  alog_ring_t *r = NULL;
+
+  apr_threadkey_private_get((void *)&r, _alog_ring_key);
+  if (r != NULL) return(r);
+
+  tbx_type_malloc_clear(r, alog_ring_t, 1);
+  r->mem_fd = fmemopen(r->rec, sizeof(r->rec), "w");
+  assert_result_not_null(r->mem_fd);
+  setvbuf(r->mem_fd, NULL, _IONBF, 0);
+  r->fd = r->mem_fd;
+  apr_threadkey_private_set(r, _alog_ring_key);
+
+  apr_thread_mutex_lock(_alog_ring_lock);
+  r->next = _alog_rings;
+  _alog_rings = r;
+  apr_thread_mutex_unlock(_alog_ring_lock);
+
+  return(r);
+}
+
+//***********************************************************************************
+// _alog_rec_direct - Sends the calling thread's records straight to the log
+//    instead of its ring.  NOTE: alog_lock should be held
+//***********************************************************************************
+
+void _alog_rec_direct(int on)
+{
+  alog_ring_t *r = _alog_ring_get();
+
+  r->direct = on;
+  r->fd = (on == 1) ? _alog->fd : r->mem_fd;
+}
+
+//***********************************************************************************
+// _alog_ring_copy_in/out - Copies data into/out of the ring handling the wrap
+//***********************************************************************************
+
+void _alog_ring_copy_in(alog_ring_t *r, uint64_t pos, void *data, int n)
+{
+  uint64_t off = pos & (_alog_ring_size-1);
+  int n1 = ((off + n) > _alog_ring_size) ? _alog_ring_size - off : n;
+
+  memcpy(r->ring + off, data, n1);
+  if (n1 < n) memcpy(r->ring, (char *)data + n1, n - n1);
+}
+
+void _alog_ring_copy_out(alog_ring_t *r, uint64_t pos, void *data, int n)
+{
+  uint64_t off = pos & (_alog_ring_size-1);
+  int n1 = ((off + n) > _alog_ring_size) ? _alog_ring_size - off : n;
+
+  memcpy(data, r->ring + off, n1);
+  if (n1 < n) memcpy((char *)data + n1, r->ring, n - n1);
+}
+
+//***********************************************************************************
+// _alog_rec_begin - Starts a new record
+//***********************************************************************************
+
+void _alog_rec_begin()
+{
+  alog_ring_t *r = _alog_ring_get();
+
+  r->aborted = 0;
+  if (r->direct == 0) rewind(r->mem_fd);
+}
+
+//***********************************************************************************
+// _alog_rec_abort - Throws away the record being built.  Anything else written
+//    before the next _alog_rec_begin is dropped too.
+//***********************************************************************************
+
+void _alog_rec_abort()
+{
+  alog_ring_t *r = _alog_ring_get();
+
+  r->aborted = 1;
+  if (r->direct == 0) rewind(r->mem_fd);
+}
+
+//***********************************************************************************
+// _alog_rec_end - Publishes the record to the thread's ring.  If the ring is
+//    full the record is dropped instead of making the command wait.
+//***********************************************************************************
+
+void _alog_rec_end()
+{
+  alog_ring_t *r = _alog_ring_get();
+  uint32_t len;
+  uint64_t seq, head, need;
+
+  if (r->aborted == 1) {  //** Partial record so don't publish it
+     r->aborted = 0;
+     return;
+  }
+  if (r->direct == 1) return;
+
+  if (r->ring == NULL) tbx_type_malloc(r->ring, char, _alog_ring_size);
+
+  len = ftell(r->mem_fd);
+  need = ALOG_RING_HDR + len;
+  head = __atomic_load_n(&(r->head), __ATOMIC_ACQUIRE);
+  if ((r->tail - head + need) > _alog_ring_size) {
+     tbx_atomic_inc(_alog_dropped);
+     apr_thread_cond_signal(_alog_drain_cond);
+     return;
+  }
+
+  //** The sequence number is only taken once there's room so the drain thread never sees a gap
+  seq = __atomic_fetch_add(&_alog_seq, 1, __ATOMIC_SEQ_CST);
+  _alog_ring_copy_in(r, r->tail, &len, sizeof(len));
+  _alog_ring_copy_in(r, r->tail + sizeof(len), &seq, sizeof(seq));
+  _alog_ring_copy_in(r, r->tail + ALOG_RING_HDR, r->rec, len);
+  __atomic_store_n(&(r->tail), r->tail + need, __ATOMIC_RELEASE);
+
+  if ((r->tail - head) > (_alog_ring_size/2)) apr_thread_cond_signal(_alog_drain_cond);  //** Getting full so kick the drain thread
+}
+
+//***********************************************************************************
+// _alog_wbuf_flush - Writes the collected records to the log
+//***********************************************************************************
+
+void _alog_wbuf_flush()
+{
+  if (_alog_wused == 0) return;
+
+  if ((int)fwrite(_alog_wbuf, 1, _alog_wused, _alog->fd) != _alog_wused) {
+     log_printf(0, "Error writing %d bytes to the activity log!\n", _alog_wused);
+  }
+  _alog_wused = 0;
+}
+
+//***********************************************************************************
+// _alog_drain - Moves the published records from all the rings into the log
+//    in the order they were generated.  NOTE: alog_lock should be held
+//***********************************************************************************
+
+void _alog_drain()
+{
+  alog_ring_t *r, *best, *prev, *next;
+  uint64_t tail, seq, best_seq;
+  uint32_t len;
+  int64_t dropped;
+  static int64_t last_dropped = 0;
+
+  apr_thread_mutex_lock(_alog_ring_lock);
+  best_seq = 0;
+  do {
+     //** Find the ring holding the oldest record
+     best = NULL;
+     for (r = _alog_rings; r != NULL; r = r->next) {
+        tail = __atomic_load_n(&(r->tail), __ATOMIC_ACQUIRE);
+        if (r->head == tail) continue;
+        _alog_ring_copy_out(r, r->head + sizeof(len), &seq, sizeof(seq));
+        if ((best == NULL) || (seq < best_seq)) { best = r; best_seq = seq; }
+     }
+
+     //** Stop if everything is drained or the next record hasn't been published yet
+     if ((best == NULL) || (best_seq != _alog_next_seq)) break;
+
+     //** Copy out as many consecutive records from the ring as we can
+     tail = __atomic_load_n(&(best->tail), __ATOMIC_ACQUIRE);
+     do {
+        _alog_ring_copy_out(best, best->head, &len, sizeof(len));
+        if ((_alog_wused + (int)len) > ALOG_WBUF_SIZE) _alog_wbuf_flush();
+        _alog_ring_copy_out(best, best->head + ALOG_RING_HDR, _alog_wbuf + _alog_wused, len);
+        _alog_wused += len;
+        __atomic_store_n(&(best->head), best->head + ALOG_RING_HDR + len, __ATOMIC_RELEASE);
+        _alog_next_seq++;
+
+        if (best->head == tail) break;
+        _alog_ring_copy_out(best, best->head + sizeof(len), &seq, sizeof(seq));
+     } while (seq == _alog_next_seq);
+  } while (1);
+
+  //** Clean up after any threads that have exited
+  prev = NULL;
+  for (r = _alog_rings; r != NULL; r = next) {
+     next = r->next;
+     if ((__atomic_load_n(&(r->orphaned), __ATOMIC_ACQUIRE) == 1) && (r->head == __atomic_load_n(&(r->tail), __ATOMIC_ACQUIRE))) {
+        if (prev == NULL) { _alog_rings = next; } else { prev->next = next; }
+        fclose(r->mem_fd);
+        if (r->ring) free(r->ring);
+        free(r);
+     } else {
+        prev = r;
+     }
+  }
+  apr_thread_mutex_unlock(_alog_ring_lock);
+
+  _alog_wbuf_flush();
+  fflush(_alog->fd);
+
+  dropped = tbx_atomic_get(_alog_dropped);
+  if (dropped != last_dropped) {
+     log_printf(1, "Activity log rings full.  " I64T " records dropped so far\n", dropped);
+     last_dropped = dropped;
+  }
+
+  //** Roll the log if needed
+  if ((int64_t)ftell(_alog->fd) > _alog_max_size) {
+     _alog_send_data();
+  }
+}
+
+//***********************************************************************************
+// _alog_drain_thread_fn - Periodically drains the rings into the log file
+//***********************************************************************************
+
+void *_alog_drain_thread_fn(apr_thread_t *th, void *arg)
+{
+  apr_interval_time_t dt = apr_time_from_msec(global_config->server.alog_flush_interval);
+
+  alog_lock();
+  _alog_rec_direct(1);
+  while (_alog_drain_shutdown == 0) {
+     apr_thread_cond_timedwait(_alog_drain_cond, _alog_lock, dt);
+     _alog_drain();
+  }
+  alog_unlock();
+
+  return(NULL);
+}
+
 
 //***********************************************************************************
 //------- Routines below are the "singleton" version for use by ibp_server ----------
@@ -139,12 +423,11 @@ int alog_append_internal_get_config(int tid)
 {
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_INT_GET_CONFIG);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_INT_GET_CONFIG);
    
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -181,13 +464,12 @@ int alog_append_internal_expire_list(int tid, int ri, apr_time_t start_time, int
    a.time = start_time;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_INT_EXPIRE_LIST);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_int_expire_list: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_INT_EXPIRE_LIST);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_int_expire_list: Error with write!\n");
    
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -235,13 +517,12 @@ int alog_append_internal_date_free(int tid, int ri, uint64_t size)
    a.size = size;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_INT_DATE_FREE);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_int_date_free: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_INT_DATE_FREE);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_int_date_free: Error with write!\n");
    
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -286,13 +567,12 @@ int alog_append_validate_get_chksum(int tid, int command, int ri, osd_id_t pid,
    a.ri = ri;
    a.cmd = command;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_VALIDATE_GET_CHKSUM);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_validate_get_chksum: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_VALIDATE_GET_CHKSUM);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_validate_get_chksum: Error with write!\n");
    
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -375,8 +655,8 @@ int _alog_append_string16(int nbytes, char *string)
 {
   uint16_t n = nbytes;
 
-  awrite_ul(_alog->fd, &n, sizeof(n), "alog_append_string16: Error with write!\n");
-  awrite_ul(_alog->fd, string, nbytes, "alog_append_string16: Error with write!\n");
+  awrite_ul(_alog_fd, &n, sizeof(n), "alog_append_string16: Error with write!\n");
+  awrite_ul(_alog_fd, string, nbytes, "alog_append_string16: Error with write!\n");
 
   return(0);
 }
@@ -410,10 +690,10 @@ int _alog_append_cap(int port, int family, const char *address, const char *key,
   a.key_size = strlen(key)+1;
   a.typekey_size = strlen(typekey)+1;
 
-  awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_cap: Error with write!\n");
-  awrite_ul(_alog->fd, address, n, "alog_append_cap: Error with write!\n");
-  awrite_ul(_alog->fd, key, a.key_size, "alog_append_cap: Error with write!\n");
-  awrite_ul(_alog->fd, typekey, a.typekey_size, "alog_append_cap: Error with write!\n");
+  awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_cap: Error with write!\n");
+  awrite_ul(_alog_fd, address, n, "alog_append_cap: Error with write!\n");
+  awrite_ul(_alog_fd, key, a.key_size, "alog_append_cap: Error with write!\n");
+  awrite_ul(_alog_fd, typekey, a.typekey_size, "alog_append_cap: Error with write!\n");
   
   return(0);
 }
@@ -460,17 +740,18 @@ int _alog_append_alias_copy32(int cmd, int tid, int ri, osd_id_t pid, osd_id_t i
    ca.wmode = write_mode;
    ca.ctype = ctype;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_COPY32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_copy32: Error with write!\n");
-   awrite_ul(_alog->fd, &ca, sizeof(ca), "alog_append_alias_copy32: Error with write!\n");
-   awrite_ul(_alog->fd, &offset2, sizeof(offset2), "alog_append_alias_copy32: Error with write!\n");
-   _alog_append_cap(port, family, address, key, typekey);
-   if (ctype != IBP_TCP) _alog_append_string16(strlen(path)+1, path);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_COPY32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_copy32: Error with write!\n");
+   awrite_ul(_alog_fd, &ca, sizeof(ca), "alog_append_alias_copy32: Error with write!\n");
+   awrite_ul(_alog_fd, &offset2, sizeof(offset2), "alog_append_alias_copy32: Error with write!\n");
+   if (_alog_append_cap(port, family, address, key, typekey) != 0) return(1);
+   if (ctype != IBP_TCP) {
+      if (_alog_append_string16(strlen(path)+1, path) != 0) return(1);
+   }
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -529,17 +810,18 @@ int _alog_append_alias_copy64(int cmd, int tid, int ri, osd_id_t pid, osd_id_t i
    ca.wmode = write_mode;
    ca.ctype = ctype;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_COPY64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_copy64: Error with write!\n");
-   awrite_ul(_alog->fd, &ca, sizeof(ca), "alog_append_alias_copy64: Error with write!\n");
-   awrite_ul(_alog->fd, &offset2, sizeof(offset2), "alog_append_alias_copy64: Error with write!\n");
-   _alog_append_cap(port, family, address, key, typekey);
-   if (ctype != IBP_TCP) _alog_append_string16(strlen(path)+1, path);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_COPY64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_copy64: Error with write!\n");
+   awrite_ul(_alog_fd, &ca, sizeof(ca), "alog_append_alias_copy64: Error with write!\n");
+   awrite_ul(_alog_fd, &offset2, sizeof(offset2), "alog_append_alias_copy64: Error with write!\n");
+   if (_alog_append_cap(port, family, address, key, typekey) != 0) return(1);
+   if (ctype != IBP_TCP) {
+      if (_alog_append_string16(strlen(path)+1, path) != 0) return(1);
+   }
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -595,17 +877,18 @@ int _alog_append_copy64(int cmd, int tid, int ri, osd_id_t id, uint64_t size,
    ca.wmode = write_mode;
    ca.ctype = ctype;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_COPY64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_copy64: Error with write!\n");
-   awrite_ul(_alog->fd, &ca, sizeof(ca), "alog_append_copy64: Error with write!\n");
-   awrite_ul(_alog->fd, &offset2, sizeof(offset2), "alog_append_copy64: Error with write!\n");
-   _alog_append_cap(port, family, address, key, typekey);
-   if (ctype != IBP_TCP) _alog_append_string16(strlen(path)+1, path);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_COPY64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_copy64: Error with write!\n");
+   awrite_ul(_alog_fd, &ca, sizeof(ca), "alog_append_copy64: Error with write!\n");
+   awrite_ul(_alog_fd, &offset2, sizeof(offset2), "alog_append_copy64: Error with write!\n");
+   if (_alog_append_cap(port, family, address, key, typekey) != 0) return(1);
+   if (ctype != IBP_TCP) {
+      if (_alog_append_string16(strlen(path)+1, path) != 0) return(1);
+   }
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -663,17 +946,18 @@ int _alog_append_copy32(int cmd, int tid, int ri, osd_id_t id, uint64_t size,
    ca.wmode = write_mode;
    ca.ctype = ctype;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_COPY32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_copy32: Error with write!\n");
-   awrite_ul(_alog->fd, &ca, sizeof(ca), "alog_append_copy32: Error with write!\n");
-   awrite_ul(_alog->fd, &off32, sizeof(off32), "alog_append_copy32: Error with write!\n");
-   _alog_append_cap(port, family, address, key, typekey);
-   if (ctype != IBP_TCP) _alog_append_string16(strlen(path)+1, path);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_COPY32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_copy32: Error with write!\n");
+   awrite_ul(_alog_fd, &ca, sizeof(ca), "alog_append_copy32: Error with write!\n");
+   awrite_ul(_alog_fd, &off32, sizeof(off32), "alog_append_copy32: Error with write!\n");
+   if (_alog_append_cap(port, family, address, key, typekey) != 0) return(1);
+   if (ctype != IBP_TCP) {
+      if (_alog_append_string16(strlen(path)+1, path) != 0) return(1);
+   }
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -790,13 +1074,12 @@ int _alog_append_read32(int tid, int ri, osd_id_t id, uint64_t offset, uint64_t
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_READ32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_READ32: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_READ32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_READ32: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -832,13 +1115,12 @@ int _alog_append_read64(int tid, int ri, osd_id_t id, uint64_t offset, uint64_t
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_READ64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_write64: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_READ64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_write64: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -868,7 +1150,7 @@ int _alog_append_alias_read32(int tid, int ri, osd_id_t pid, osd_id_t id, uint64
 
    alog_mode_check();
 
-//int d = ftell(_alog->fd);
+//int d = ftell(_alog_fd);
 //log_printf(0, "_alog_append_alias_read32:  Start!!!!!!!!!!! fpos=%d\n", d);
    a.id = id;
    a.pid = pid;
@@ -876,17 +1158,16 @@ int _alog_append_alias_read32(int tid, int ri, osd_id_t pid, osd_id_t id, uint64
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_READ32);
-//d = ftell(_alog->fd);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_READ32);
+//d = ftell(_alog_fd);
 //log_printf(0, "_alog_append_alias_read32: after header fpos=%d\n", d);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_read32: Error with write!\n");
-//d = ftell(_alog->fd);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_read32: Error with write!\n");
+//d = ftell(_alog_fd);
 //log_printf(0, "_alog_append_alias_read32: after rec fpos=%d\n", d);
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -925,13 +1206,12 @@ int _alog_append_alias_read64(int tid, int ri, osd_id_t pid, osd_id_t id, uint64
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_READ64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_read32: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_READ64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_read32: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1049,13 +1329,12 @@ int _alog_append_write32(int tid, int cmd, int ri, osd_id_t id, uint64_t offset,
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_WRITE32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_write32: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_WRITE32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_write32: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1091,13 +1370,12 @@ int _alog_append_write64(int tid, int cmd, int ri, osd_id_t id, uint64_t offset,
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_WRITE64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_write64: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_WRITE64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_write64: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1131,13 +1409,12 @@ int _alog_append_write_append32(int tid, int cmd, int ri, osd_id_t id, uint64_t
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_WRITE_APPEND32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_write_append32: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_WRITE_APPEND32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_write_append32: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1172,13 +1449,12 @@ int _alog_append_write_append64(int tid, int cmd, int ri, osd_id_t id, uint64_t
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_WRITE_APPEND64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_write64: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_WRITE_APPEND64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_write64: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1215,13 +1491,12 @@ int _alog_append_alias_write32(int tid, int cmd, int ri, osd_id_t pid, osd_id_t
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_WRITE32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_write32: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_WRITE32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_write32: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1258,13 +1533,12 @@ int _alog_append_alias_write64(int tid, int cmd, int ri, osd_id_t pid, osd_id_t
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_WRITE64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_write64: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_WRITE64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_write64: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1299,13 +1573,12 @@ int _alog_append_alias_write_append32(int tid, int cmd, int ri, osd_id_t pid, os
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_WRITE_APPEND32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_write_append32: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_WRITE_APPEND32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_write_append32: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1341,13 +1614,12 @@ int _alog_append_alias_write_append64(int tid, int cmd, int ri, osd_id_t pid, os
    a.size = size;
    a.ri = ri;
    
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_WRITE_APPEND64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_write64: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_WRITE_APPEND64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_write64: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1427,13 +1699,12 @@ int alog_append_alias_manage_probe(int tid, int ri, osd_id_t pid, osd_id_t id)
    a.id = id;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_MANAGE_PROBE);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_manage_probe: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_MANAGE_PROBE);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_manage_probe: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1473,13 +1744,12 @@ int alog_append_manage_probe(int tid, int ri, osd_id_t id)
    a.id = id;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_MANAGE_PROBE);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_manage_probe: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_MANAGE_PROBE);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_manage_probe: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1524,13 +1794,12 @@ int alog_append_manage_change(int tid, int ri, osd_id_t id, uint64_t size, int r
    a.rel = rel;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_MANAGE_CHANGE);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_manage_change: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_MANAGE_CHANGE);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_manage_change: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 
 }
@@ -1581,13 +1850,12 @@ int alog_append_alias_manage_change(int tid, int ri, osd_id_t id, uint64_t offse
    a.time = t;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_MANAGE_CHANGE);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_manage_change: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_MANAGE_CHANGE);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_manage_change: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 
 }
@@ -1646,8 +1914,8 @@ int _alog_append_pm_incdec(int tid, int cmd, int subcmd, int ri, osd_id_t pid, o
    a.ri = ri;
    a.captype = cap_type;
    a.subcmd = subcmd;
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_MANAGE_INCDEC);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_pm_incdec: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_MANAGE_INCDEC);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_pm_incdec: Error with write!\n");
 
    return(0);
 }
@@ -1682,8 +1950,8 @@ int _alog_append_m_incdec(int tid, int cmd, int subcmd, int ri, osd_id_t id, int
    a.ri = ri;
    a.captype = cap_type;
    a.subcmd = subcmd;
-   _alog->append_header(_alog->fd, tid, ALOG_REC_MANAGE_INCDEC);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_m_incdec: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_MANAGE_INCDEC);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_m_incdec: Error with write!\n");
 
    return(0);
 }
@@ -1710,18 +1978,20 @@ int alog_read_manage_incdec(activity_log_t *alog, int cmd, FILE *outfd)
 
 int alog_append_manage_incdec(int tid, int cmd, int subcmd, int ri, osd_id_t pid, osd_id_t id, int cap_type)
 {
+   int err;
+
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
    if (cmd == IBP_ALIAS_MANAGE) {
-     _alog_append_pm_incdec(tid, cmd, subcmd, ri, pid, id, cap_type);
+     err = _alog_append_pm_incdec(tid, cmd, subcmd, ri, pid, id, cap_type);
    } else {
-     _alog_append_m_incdec(tid, cmd, subcmd, ri, id, cap_type);
+     err = _alog_append_m_incdec(tid, cmd, subcmd, ri, id, cap_type);
    }
+   if (err != 0) return(err);
 
-   alog_unlock();
+   alog_rec_end();
    return(0);    
 }
 
@@ -1741,15 +2011,14 @@ int alog_append_manage_bad(int tid, int command, int subcmd)
 
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
    a.cmd = command;
    a.subcmd = subcmd;
-   _alog->append_header(_alog->fd, tid, ALOG_REC_MANAGE_BAD);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_manage_bad: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_MANAGE_BAD);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_manage_bad: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);    
 }
 
@@ -1783,14 +2052,13 @@ int alog_append_status_inq(int tid, int ri)
 
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
    a = ri;
-   _alog->append_header(_alog->fd, tid, ALOG_REC_STATUS_INQ);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_status_inq: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_STATUS_INQ);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_status_inq: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -1820,14 +2088,13 @@ int alog_append_status_stats(int tid, apr_time_t start_time)
 
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
    a = start_time;
-   _alog->append_header(_alog->fd, tid, ALOG_REC_STATUS_STATS);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_status_stats: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_STATUS_STATS);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_status_stats: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);  
 }
 
@@ -1859,14 +2126,13 @@ int alog_append_subcmd(int tid, int command, int subcmd)
 
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
    a = subcmd;
-   _alog->append_header(_alog->fd, tid, command);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_subcmd: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, command);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_subcmd: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);  
 }
 
@@ -1939,13 +2205,12 @@ int alog_append_res_id(int command, int tid, int rindex, osd_id_t id)
    a.ri = rindex;
    a.id = id;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, command);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_res_id: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, command);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_res_id: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -2001,13 +2266,12 @@ int _alog_append_alias_alloc32(int tid, int ri, osd_id_t id, uint64_t offset, ui
    a.expire = expire;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
    
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_ALLOC32);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_alloc32: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_ALLOC32);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_alloc32: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -2049,13 +2313,12 @@ int _alog_append_alias_alloc64(int tid, int ri, osd_id_t id, uint64_t offset, ui
    a.expire = expire;
    a.ri = ri;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
    
-   _alog->append_header(_alog->fd, tid, ALOG_REC_ALIAS_ALLOC64);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_alias_alloc64: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_ALIAS_ALLOC64);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_alias_alloc64: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -2155,15 +2418,14 @@ int alog_append_ibp_merge(int tid, osd_id_t mid, osd_id_t cid, int rindex)
    a.ri = rindex;
    a.id = mid;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_IBP_MERGE);
-   awrite_ul(_alog->fd, &a, sizeof(a), "alog_append_ibp_merge: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_IBP_MERGE);
+   awrite_ul(_alog_fd, &a, sizeof(a), "alog_append_ibp_merge: Error with write!\n");
 
-   awrite_ul(_alog->fd, &cid, sizeof(cid), "alog_append_ibp_merge: Error with write!\n");
+   awrite_ul(_alog_fd, &cid, sizeof(cid), "alog_append_ibp_merge: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -2196,13 +2458,12 @@ int alog_append_osd_id(int tid, osd_id_t id)
 {
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_OSD_ID);
-   awrite_ul(_alog->fd, &id, sizeof(id), "alog_append_osd_id: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, ALOG_REC_OSD_ID);
+   awrite_ul(_alog_fd, &id, sizeof(id), "alog_append_osd_id: Error with write!\n");
 
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -2252,8 +2513,7 @@ int alog_append_ibp_allocate(int tid, int rindex, uint64_t max_size, int atype,
 
    if (rindex == -1) rindex = 255;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
      
    if (max_size < UINT32_MAX) {
       nbytes = sizeof(a32);
@@ -2267,10 +2527,10 @@ int alog_append_ibp_allocate(int tid, int rindex, uint64_t max_size, int atype,
       a64.ri=rindex; a64.atype=atype; a64.rel=rel; a64.expiration=expiration; a64.size=max_size;
    } 
 
-   _alog->append_header(_alog->fd, tid, cmd);
-   awrite_ul(_alog->fd, d, nbytes, "alog_append_ibp_allocate: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, cmd);
+   awrite_ul(_alog_fd, d, nbytes, "alog_append_ibp_allocate: Error with write!\n");
  
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -2316,8 +2576,7 @@ int alog_append_ibp_split_allocate(int tid, int rindex, osd_id_t mid, uint64_t m
 
    if (rindex == -1) rindex = 255;
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
      
    if (max_size < UINT32_MAX) {
       nbytes = sizeof(a32);
@@ -2331,11 +2590,11 @@ int alog_append_ibp_split_allocate(int tid, int rindex, osd_id_t mid, uint64_t m
       a64.ri=rindex; a64.atype=atype; a64.rel=rel; a64.expiration=expiration; a64.size=max_size;
    } 
 
-   _alog->append_header(_alog->fd, tid, cmd);
-   awrite_ul(_alog->fd, &mid, sizeof(mid), "alog_append_ibp_split_allocate: Error with write!\n");
-   awrite_ul(_alog->fd, d, nbytes, "alog_append_ibp_split_allocate: Error with write!\n");
+   _alog_append_header(_alog_fd, tid, cmd);
+   awrite_ul(_alog_fd, &mid, sizeof(mid), "alog_append_ibp_split_allocate: Error with write!\n");
+   awrite_ul(_alog_fd, d, nbytes, "alog_append_ibp_split_allocate: Error with write!\n");
  
-   alog_unlock();
+   alog_rec_end();
    return(0);
 }
 
@@ -2382,16 +2641,15 @@ int alog_append_cmd_result(int tid, int status)
 
    alog_mode_check();
 
-   alog_lock();
-   alog_checksize();
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_CMD_RESULT);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_CMD_RESULT);
 
    n8 = -status;
    if (status > 0) n8 = 0; // ** IBP_OK = 1 but there is no 0 error
-   awrite_ul(_alog->fd, &n8, sizeof(n8), "alog_append_cmd_result: Error with write!\n");
+   awrite_ul(_alog_fd, &n8, sizeof(n8), "alog_append_cmd_result: Error with write!\n");
    
-   alog_unlock();
+   alog_rec_end();
 
    return(0);
 }
@@ -2422,42 +2680,44 @@ int _alog_append_thread_open(int tid, int ns_id, int family, char *address)
    uint32_t n32;
    uint8_t n8;
    uint16_t n16;
-   ns_map_t *nsmap;
 
    alog_mode_check();
 
-   //** Add the mapping.
-   nsmap = &(_alog->ns_map[tid]);
-   nsmap->id = ns_id;  
-   nsmap->family = family; 
-   nsmap->used = 1;
-   memcpy(nsmap->address, address, sizeof(nsmap->address));
- 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_THREAD_OPEN);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_THREAD_OPEN);
 
-   n16 = tid; awrite_ul(_alog->fd, &n16, sizeof(n16), "alog_append_thread_open: Error with write!\n");
-   n32 = ns_id; awrite_ul(_alog->fd, &n32, sizeof(n32), "alog_append_thread_open: Error with write!\n");
+   n16 = tid; awrite_ul(_alog_fd, &n16, sizeof(n16), "alog_append_thread_open: Error with write!\n");
+   n32 = ns_id; awrite_ul(_alog_fd, &n32, sizeof(n32), "alog_append_thread_open: Error with write!\n");
    
    n8 = 0; n16 = 4; if (family != AF_INET) { n8 = 1; n16 = 16; }
-   awrite_ul(_alog->fd, &n8, sizeof(n8), "alog_append_thread_open: Error with write!\n");
-   awrite_ul(_alog->fd, address, n16, "alog_append_thread_open: Error with write!\n");
+   awrite_ul(_alog_fd, &n8, sizeof(n8), "alog_append_thread_open: Error with write!\n");
+   awrite_ul(_alog_fd, address, n16, "alog_append_thread_open: Error with write!\n");
 
    return(0);   
 }
 
 int alog_append_thread_open(int tid, int ns_id, int family, char *address)
 {
+   ns_map_t *nsmap;
    int n;
 
    alog_mode_check();
 
+   //** Add the mapping.  The drain thread replays it into each new log file
    alog_lock();
-   alog_checksize();
+   nsmap = &(_alog_ns_map[tid]);
+   nsmap->id = ns_id;
+   nsmap->family = family;
+   nsmap->used = 1;
+   memcpy(nsmap->address, address, sizeof(nsmap->address));
+   alog_unlock();
+
+   alog_rec_begin();
 
    n = _alog_append_thread_open(tid, ns_id, family, address);
+   if (n != 0) return(n);
 
-   alog_unlock();
-   return(n);
+   alog_rec_end();
+   return(0);
 }
 
 //--------------------------------------------------------------------------
@@ -2509,15 +2769,16 @@ int alog_append_thread_close(int tid, int ncmds)
    alog_mode_check();
 
    alog_lock();
-   alog_checksize();
+   _alog_ns_map[tid].used = 0;
+   alog_unlock();
 
-   _alog->ns_map[tid].used = 0;
+   alog_rec_begin();
 
-   _alog->append_header(_alog->fd, tid, ALOG_REC_THREAD_CLOSE);
+   _alog_append_header(_alog_fd, tid, ALOG_REC_THREAD_CLOSE);
 
-   awrite_ul(_alog->fd, &n, sizeof(n), "alog_append_thread_close: Error writing rec\n");
+   awrite_ul(_alog_fd, &n, sizeof(n), "alog_append_thread_close: Error writing rec\n");
 
-   alog_unlock();
+   alog_rec_end();
 
    return(0);      
 }
@@ -2555,22 +2816,22 @@ int _alog_config()
 
 //   alog_checksize();
 
-   _alog->append_header(_alog->fd, 0, ALOG_REC_IBP_CONFIG);
+   _alog_append_header(_alog_fd, 0, ALOG_REC_IBP_CONFIG);
 
-   start_pos = ftell(_alog->fd);  //** Keep track of the starting position
+   start_pos = ftell(_alog_fd);  //** Keep track of the starting position
 
    //** Preserve the space for the config length
-   awrite_ul(_alog->fd, &nbytes, sizeof(nbytes), "_alog_config: Error storing placeholder!\n");
+   awrite_ul(_alog_fd, &nbytes, sizeof(nbytes), "_alog_config: Error storing placeholder!\n");
    
    //*** Pring the config **
    print_config(buffer, &used, sizeof(buffer), global_config);
-   fprintf(_alog->fd, "%s", buffer);
+   fprintf(_alog_fd, "%s", buffer);
 
-   end_pos = ftell(_alog->fd);    //*** Keep track of my final position
-   fseek(_alog->fd, start_pos, SEEK_SET);  //** Move back to the length field
+   end_pos = ftell(_alog_fd);    //*** Keep track of my final position
+   fseek(_alog_fd, start_pos, SEEK_SET);  //** Move back to the length field
    nbytes = end_pos - (start_pos + sizeof(nbytes));   //** and write it 
-   awrite_ul(_alog->fd, &nbytes, sizeof(nbytes), "_alog_config: Error storing config size!\n");
-   fseek(_alog->fd, end_pos, SEEK_SET);    //** Move to the end of the record
+   awrite_ul(_alog_fd, &nbytes, sizeof(nbytes), "_alog_config: Error storing config size!\n");
+   fseek(_alog_fd, end_pos, SEEK_SET);    //** Move to the end of the record
 
    return(0);
 }
@@ -2617,10 +2878,10 @@ int _alog_resources()
    
 //   alog_checksize();
 
-   _alog->append_header(_alog->fd, 0, ALOG_REC_RESOURCE_LIST);
+   _alog_append_header(_alog_fd, 0, ALOG_REC_RESOURCE_LIST);
 
    n16 = resource_list_n_used(global_config->rl);
-   awrite_ul(_alog->fd, &n16, sizeof(n16), "_alog_resources: Error storing data!\n");
+   awrite_ul(_alog_fd, &n16, sizeof(n16), "_alog_resources: Error storing data!\n");
 i=n16;
 log_printf(0, "alog_read_res: nres=%d\n", i);
 
@@ -2629,10 +2890,10 @@ log_printf(0, "alog_read_res: nres=%d\n", i);
    while ((r = resource_list_iterator_next(global_config->rl, &it)) != NULL) {
 log_printf(0, "alog_read_res: i=%d rl_index=%d\n", i, r->rl_index);
       n16 = r->rl_index;
-      awrite_ul(_alog->fd, &n16, sizeof(n16), "_alog_resources: Error storing data!\n");
+      awrite_ul(_alog_fd, &n16, sizeof(n16), "_alog_resources: Error storing data!\n");
       n8 = strlen(r->name);
-      awrite_ul(_alog->fd, &n8, sizeof(n8), "_alog_resources: Error storing data!\n");
-      awrite_ul(_alog->fd, r->name, n8, "_alog_resources: Error storing data!\n");           
+      awrite_ul(_alog_fd, &n8, sizeof(n8), "_alog_resources: Error storing data!\n");
+      awrite_ul(_alog_fd, r->name, n8, "_alog_resources: Error storing data!\n");           
       i++;
    }
    resource_list_iterator_destroy(global_config->rl, &it);
@@ -2807,14 +3068,29 @@ void alog_open()
    _alog_name = global_config->server.alog_name;
    _alog_max_size = global_config->server.alog_max_size;
 
-   if (_alog_max_size <= 0) return;
+   if (_alog_max_size <= 0) { alog_unlock(); return; }
+
+   //** Size the rings.  They have to be a power of 2 and hold at least a couple of records
+   _alog_ring_size = 2*ALOG_REC_MAX;
+   while (_alog_ring_size < (uint64_t)global_config->server.alog_ring_size) _alog_ring_size <<= 1;
+   tbx_type_malloc(_alog_wbuf, char, ALOG_WBUF_SIZE);
+   _alog_wused = 0;
 
-   _alog = activity_log_open(_alog_name, 2*global_config->server.max_threads, ALOG_APPEND);
+   _alog = activity_log_open(_alog_name, task_slot_count(global_config), ALOG_APPEND);
 
    assert_result_not_null(_alog);
 
+   _alog_append_header = _alog->append_header;
+   tbx_type_malloc_clear(_alog_ns_map, ns_map_t, task_slot_count(global_config));
+
+   //** The preamble goes straight to the file
+   _alog_rec_direct(1);
    _alog_config();
    _alog_resources();
+   _alog_rec_direct(0);
+
+   _alog_drain_shutdown = 0;
+   apr_thread_create(&_alog_drain_thread, NULL, _alog_drain_thread_fn, NULL, _alog_mpool);
 
    alog_unlock();  
 }
@@ -2825,15 +3101,155 @@ void alog_open()
 
 void alog_close()
 {
+   apr_status_t value;
+
    if (_alog_max_size <= 0) return;
 
+   //** Shut down the drain thread
+   alog_lock();
+   _alog_drain_shutdown = 1;
+   apr_thread_cond_signal(_alog_drain_cond);
+   alog_unlock();
+   apr_thread_join(&value, _alog_drain_thread);
+
    alog_lock();  
 
+   _alog_rec_direct(1);
+   _alog_drain();   //** Flush anything published since the last pass
    activity_log_close(_alog);
+   free(_alog_ns_map);  _alog_ns_map = NULL;
+   free(_alog_wbuf);  _alog_wbuf = NULL;
 
    alog_unlock();  
 }
 
+//************************************************************************
+// _alog_compress_file - Compresses a rolled over alog file in place.  The
+//    file header is left as is except for the ALOG_COMPRESSED flag and
+//    everything after it is a zlib stream.
+//************************************************************************
+
+int _alog_compress_file(char *fname)
+{
+  FILE *fd, *cfd;
+  alog_file_header_t h;
+  tbx_pack_t *pack;
+  unsigned char ibuf[64*1024], obuf[64*1024];
+  char tname[4096];
+  int n, pos, nw, err;
+
+  fd = fopen(fname, "r");
+  if (fd == NULL) {
+     log_printf(0, "_alog_compress_file: Can't open %s for READ!\n", fname);
+     return(1);
+  }
+
+  if ((fread(&h, sizeof(h), 1, fd) != 1) || ((h.version & ALOG_COMPRESSED) != 0)) {  //** Short file or already done
+     fclose(fd);
+     return(0);
+  }
+
+  snprintf(tname, sizeof(tname), "%s.tmp", fname);
+  cfd = fopen(tname, "w");
+  if (cfd == NULL) {
+     log_printf(0, "_alog_compress_file: Can't open %s for WRITE!\n", tname);
+     fclose(fd);
+     return(1);
+  }
+
+  h.version |= ALOG_COMPRESSED;
+  err = (fwrite(&h, sizeof(h), 1, cfd) == 1) ? 0 : 1;
+
+  pack = tbx_pack_create(PACK_COMPRESS, PACK_WRITE, obuf, sizeof(obuf));
+  while ((err == 0) && ((n = fread(ibuf, 1, sizeof(ibuf), fd)) > 0)) {
+     pos = 0;
+     while (pos < n) {
+        nw = tbx_pack_write(pack, ibuf + pos, n - pos);
+        if (nw < 0) { err = 1; break; }
+        pos += nw;
+        if (pos < n) {  //** Output buffer is full so dump it
+           if ((int)fwrite(obuf, 1, tbx_pack_used(pack), cfd) != tbx_pack_used(pack)) { err = 1; break; }
+           tbx_pack_consumed(pack);
+        }
+     }
+  }
+
+  if (err == 0) {
+     do {
+        n = tbx_pack_write_flush(pack);
+        if ((int)fwrite(obuf, 1, tbx_pack_used(pack), cfd) != tbx_pack_used(pack)) err = 1;
+        tbx_pack_consumed(pack);
+     } while ((n == PACK_NONE) && (err == 0));
+     if (n == PACK_ERROR) err = 1;
+  }
+  tbx_pack_destroy(pack);
+
+  fclose(fd);
+  if (fclose(cfd) != 0) err = 1;
+
+  if (err != 0) {
+     log_printf(0, "_alog_compress_file: Error compressing %s.  Leaving it uncompressed\n", fname);
+     remove(tname);
+     return(1);
+  }
+
+  rename(tname, fname);
+  return(0);
+}
+
+//************************************************************************
+// _alog_open_raw - Opens an alog file for reading.  Compressed files are
+//    inflated into a temporary file so the readers never see the
+//    difference.  Returns NULL on error.
+//************************************************************************
+
+FILE *_alog_open_raw(const char *fname)
+{
+  FILE *fd, *tfd;
+  alog_file_header_t h;
+  tbx_pack_t *pack;
+  unsigned char ibuf[64*1024], obuf[64*1024];
+  int n, nout, err;
+
+  fd = fopen(fname, "r");
+  if (fd == NULL) return(NULL);
+
+  if ((fread(&h, sizeof(h), 1, fd) != 1) || ((h.version & ALOG_COMPRESSED) == 0)) {  //** Plain file
+     rewind(fd);
+     return(fd);
+  }
+
+  tfd = tmpfile();
+  if (tfd == NULL) {
+     log_printf(0, "_alog_open_raw: Can't create a temp file to inflate %s!\n", fname);
+     fclose(fd);
+     return(NULL);
+  }
+
+  h.version &= ~ALOG_COMPRESSED;
+  err = (fwrite(&h, sizeof(h), 1, tfd) == 1) ? 0 : 1;
+
+  pack = tbx_pack_create(PACK_COMPRESS, PACK_READ, ibuf, 0);
+  while ((err == 0) && ((n = fread(ibuf, 1, sizeof(ibuf), fd)) > 0)) {
+     tbx_pack_read_new_data(pack, ibuf, n);
+     while ((nout = tbx_pack_read(pack, obuf, sizeof(obuf))) > 0) {
+        if ((int)fwrite(obuf, 1, nout, tfd) != nout) { err = 1; break; }
+     }
+     if (nout < 0) err = 1;
+  }
+  tbx_pack_destroy(pack);
+  fclose(fd);
+
+  if (err != 0) {
+     log_printf(0, "_alog_open_raw: Error inflating %s!\n", fname);
+     fclose(tfd);
+     return(NULL);
+  }
+
+  rewind(tfd);
+  return(tfd);
+}
+
 //************************************************************************
 // _alog_transfer_data - Sends data back
 //************************************************************************
@@ -2866,7 +3282,7 @@ int _alog_transfer_data(char *fname)
   tbx_ns_timeout_set(&dt, 1, 0);
 
   //** Get the info for the command
-  alog.fd = fopen(fname, "r");
+  alog.fd = _alog_open_raw(fname);
   if (alog.fd == NULL) {
      log_printf(0, "_alog_transfer_Data: Can't open %s for READ!\n", fname);
      tbx_ns_destroy(ns);
@@ -2974,14 +3390,15 @@ int _alog_transfer_data(char *fname)
 void *_send_alog_thread(apr_thread_t *th, void *arg)
 {
   char *fname;
-  int err;
+  int err, do_send;
 
   apr_thread_mutex_lock(_alog_send_lock);
 
-  //** Check if we have a valid host/port.  If not dump the stack and exit  
-  if ((global_config->server.alog_port <= 0) && (global_config->server.alog_host == NULL)) {
+  //** Check if we have a valid host/port.  If not and there's nothing to compress dump the stack and exit
+  do_send = ((global_config->server.alog_port <= 0) && (global_config->server.alog_host == NULL)) ? 0 : 1;
+  if (do_send == 0) {
      log_printf(10, "_send_alog_thread: Invalid host/port.  Skipping transfer\n");
-     tbx_stack_empty(_alog_pending_stack, 1);
+     if (global_config->server.alog_compress == 0) tbx_stack_empty(_alog_pending_stack, 1);
   }
 
   while (tbx_stack_count(_alog_pending_stack) > 0) {
@@ -2992,7 +3409,10 @@ void *_send_alog_thread(apr_thread_t *th, void *arg)
      log_printf(10, "_send_alog_thread: fname=%s\n", fname);
 
       err = 0;
-      if (fname != NULL) err = _alog_transfer_data(fname);
+      if (fname != NULL) {
+         if (global_config->server.alog_compress == 1) _alog_compress_file(fname);
+         err = (do_send == 1) ? _alog_transfer_data(fname) : 1;  //** Nowhere to send it so keep the compressed copy
+      }
 
       log_printf(10, "_send_alog_thread: err=%d fname=%s\n", err, fname);
 
@@ -3033,16 +3453,12 @@ void _alog_nsmap(ns_map_t *nsmap, int n)
 void _alog_send_data()
 {
   char fname[1024];
-  ns_map_t *nsmap;
   int new_transfer = 0;
 
   log_printf(15, "_alog_send_data: Start.... Need to send data home\n");
 
 //  alog_lock();
 
-  //** Preserve these pointers for the open;
-  nsmap = _alog->ns_map; _alog->ns_map = NULL;
-    
   activity_log_close(_alog);  //** Close the old activity file
 
   //** Check if we have too much data pending.  If so drop this data
@@ -3110,14 +3526,14 @@ void _alog_send_data()
   apr_thread_mutex_unlock(_alog_send_lock);  
 
   //** Now open the fresh log file
-  _alog = activity_log_open(_alog_name, 2*global_config->server.max_threads, ALOG_APPEND);
+  _alog = activity_log_open(_alog_name, task_slot_count(global_config), ALOG_APPEND);
 
   assert_result_not_null(_alog);
 
+  _alog_rec_direct(1);   //** Only the drain thread and alog_close roll the log and both write directly
   _alog_config();
   _alog_resources();
-  _alog_nsmap(nsmap, 2*global_config->server.max_threads);
-  free(nsmap);
+  _alog_nsmap(_alog_ns_map, task_slot_count(global_config));
 
 //  alog_unlock();
 }
@@ -3547,7 +3963,7 @@ activity_log_t * activity_log_open(const char *logname, int max_id, int mode)
   alog->curr_size = 0;
   
   if (mode == ALOG_READ) {
-     alog->fd = fopen(alog->name, "r");
+     alog->fd = _alog_open_raw(alog->name);
      if (alog->fd == NULL) {
         log_printf(0, "activity_log_open: Can't open %s for READ!\n", alog->name);
         return(NULL);
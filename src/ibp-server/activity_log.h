@@ -22,6 +22,7 @@
 
 #define ALOG_VERSION_1  1
 #define ALOG_VERSION  ALOG_VERSION_1
+#define ALOG_COMPRESSED 0x100000000ULL   //** OR'ed into the header version if the records are zlib compressed
 
 //**** modes for opening an alog file
 #define ALOG_READ   0
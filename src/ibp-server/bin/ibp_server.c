@@ -233,6 +233,8 @@ int parse_config(tbx_inip_file_t *keyfile, Config_t *cfg, int force_rebuild)
   // *** Initialize the data structure to default values ***
   server = &(cfg->server);
   server->max_threads = 64;
+  server->max_connections = 10000;
+  server->epoll_enable = 0;
   server->max_pending = 16;
   server->min_idle = apr_time_make(60, 0);
   server->stats_size = 5000;
@@ -251,11 +253,15 @@ int parse_config(tbx_inip_file_t *keyfile, Config_t *cfg, int force_rebuild)
   server->backoff_max = 30;
   server->big_alloc_enable = (sizeof(off_t) > 4) ? 1 : 0;
   server->splice_enable = 0;
+  server->write_pipeline_depth = 2;
   server->alog_name = "ibp_activity.log";
   server->alog_max_size = 50;
   server->alog_max_history = 1;
   server->alog_host = NULL;
   server->alog_port = 0;
+  server->alog_ring_size = 256*1024;
+  server->alog_flush_interval = 100;
+  server->alog_compress = 1;
   server->port = IBP_PORT;
   server->return_cap_id = 1;
   server->rid_check_interval = 15;
@@ -303,6 +309,8 @@ int parse_config(tbx_inip_file_t *keyfile, Config_t *cfg, int force_rebuild)
   }
 
   server->max_threads = tbx_inip_get_integer(keyfile, "server", "threads", server->max_threads);
+  server->max_connections = tbx_inip_get_integer(keyfile, "server", "max_connections", server->max_connections);
+  server->epoll_enable = tbx_inip_get_integer(keyfile, "server", "epoll_enable", server->epoll_enable);
   server->max_pending = tbx_inip_get_integer(keyfile, "server", "max_pending", server->max_pending);
   t = 0; t = tbx_inip_get_integer(keyfile, "server", "min_idle", t);
   if (t != 0) server->min_idle = apr_time_make(t, 0);
@@ -324,6 +332,7 @@ int parse_config(tbx_inip_file_t *keyfile, Config_t *cfg, int force_rebuild)
   server->lazy_allocate = tbx_inip_get_integer(keyfile, "server", "lazy_allocate", server->lazy_allocate);
   server->big_alloc_enable = tbx_inip_get_integer(keyfile, "server", "big_alloc_enable", server->big_alloc_enable);
   server->splice_enable = tbx_inip_get_integer(keyfile, "server", "splice_enable", server->splice_enable);
+  server->write_pipeline_depth = tbx_inip_get_integer(keyfile, "server", "write_pipeline_depth", server->write_pipeline_depth);
   server->backoff_scale = tbx_inip_get_double(keyfile, "server", "backoff_scale", server->backoff_scale);
   server->backoff_max = tbx_inip_get_double(keyfile, "server", "backoff_max", server->backoff_max);
 
@@ -337,6 +346,9 @@ int parse_config(tbx_inip_file_t *keyfile, Config_t *cfg, int force_rebuild)
   server->alog_max_history = tbx_inip_get_integer(keyfile, "server", "activity_max_history", server->alog_max_history);
   server->alog_host = tbx_inip_get_string(keyfile, "server", "activity_host", server->alog_host);
   server->alog_port = tbx_inip_get_integer(keyfile, "server", "activity_port", server->alog_port);
+  server->alog_ring_size = tbx_inip_get_integer(keyfile, "server", "activity_ring_kb", server->alog_ring_size/1024) * 1024;
+  server->alog_flush_interval = tbx_inip_get_integer(keyfile, "server", "activity_flush_ms", server->alog_flush_interval);
+  server->alog_compress = tbx_inip_get_integer(keyfile, "server", "activity_compress", server->alog_compress);
 
   server->rid_check_interval = tbx_inip_get_integer(keyfile, "server", "rid_check_interval", server->rid_check_interval);
   server->eject_timeout = tbx_inip_get_integer(keyfile, "server", "eject_timeout", server->eject_timeout);
@@ -559,14 +571,21 @@ int main(int argc, const char **argv)
   //** Make sure we have enough fd's
   i = sysconf(_SC_OPEN_MAX);
   j = 3*config.server.max_threads + 2*resource_list_n_used(config.rl) + 64;
-  if (i < j) {
+  if (config.server.epoll_enable == 1) {  //** Idle connections only consume an fd
+     j += config.server.max_connections;
+     if (i < j) {
+        log_printf(0, "ibp_server: ERROR Too many connections!  max_connections=%d, threads=%d, n_resources=%d, and max fd=%d.\n", config.server.max_connections, config.server.max_threads, resource_list_n_used(config.rl), i);
+        log_printf(0, "ibp_server: Either lower max_connections or increase the max fd > %d (ulimit -n %d)\n", j, j);
+        shutdown_now = 1;
+     }
+  } else if (i < j) {
      k = (i - 2*resource_list_n_used(config.rl) - 64) / 3;
      log_printf(0, "ibp_server: ERROR Too many threads!  Current threads=%d, n_resources=%d, and max fd=%d.\n", config.server.max_threads, resource_list_n_used(config.rl), i);
      log_printf(0, "ibp_server: Either make threads < %d or increase the max fd > %d (ulimit -n %d)\n", k, j, j);
      shutdown_now = 1;
   }
 
-  init_thread_slots(2*config.server.max_threads);  //** Make pigeon holes
+  init_thread_slots(task_slot_count(&config));  //** Make pigeon holes
 
   tbx_dnsc_startup_sized(1000);
   init_subnet_list(config.server.iface[0].hostname);
@@ -622,12 +641,13 @@ printf("ibp_server.c: STDOUT=STDERR=LOG_FD() dnoes not work!!!!!!!!!!!!!!!!!!!!!
   initialize_commands();
 
 
-  //** Launch the garbage collection threads ...AFTER fork!!!!!!
+  //** Launch the garbage collection and disk I/O threads ...AFTER fork!!!!!!
   resource_list_iterator_t it;
   Resource_t *r;
   it = resource_list_iterator(global_config->rl);
   while ((r = resource_list_iterator_next(global_config->rl, &it)) != NULL) {
      launch_resource_cleanup_thread(r);
+     launch_resource_io_threads(r);
   }
   resource_list_iterator_destroy(global_config->rl, &it);
 
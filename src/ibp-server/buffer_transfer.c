@@ -22,6 +22,7 @@
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include <string.h>
 #include <limits.h>
@@ -32,9 +33,25 @@
 #include "allocation.h"
 #include "resource.h"
 #include <tbx/network.h>
+#include <tbx/que.h>
+#include <tbx/type_malloc.h>
 #include "ibp_task.h"
 #include "ibp_protocol.h"
 
+#define SENDFILE_MIN_IOVEC 65536   //** Min average iovec size to use sendfile()
+
+typedef struct {        //** Pipelined write buffer
+  res_io_op_t op;       //** I/O thread task
+  Resource_t *res;
+  osd_fd_t *fd;
+  ibp_iovec_t *iovec;
+  char *buffer;
+  ibp_off_t nbytes;     //** Bytes in the buffer
+  int index;            //** iovec position corresponding to the start of the buffer
+  ibp_off_t ioff;
+  ibp_off_t ileft;
+} wpipe_buf_t;
+
 //************************************************************************************
 // iovec_start - Determines the starting position in the iovec list
 //************************************************************************************
@@ -276,6 +293,111 @@ tbx_log_flush();
   return(task_status);
 }
 
+//************************************************************************************
+//  read_from_disk_sendfile - Transfers the data straight from the allocation's file
+//     to the socket using sendfile() so it never crosses user space.  Return values
+//     are the same as read_from_disk_user with the addition of
+//    -2 -- Allocation data can't be sent directly so use the user space routine
+//************************************************************************************
+
+int read_from_disk_sendfile(ibp_task_t *task, Allocation_t *a, ibp_off_t *left, Resource_t *res)
+{
+  tbx_ns_t *ns = task->ns;
+  int chunksize = 16*1048576;
+  osd_fd_t *fd;
+  int afd, sfd;
+  ibp_off_t nwrite, shortwrite, nleft, ioff, ileft, cleft, btotal;
+  struct pollfd pfd;
+  int task_status;
+  int index;
+  Cmd_state_t *cmd = &(task->cmd);
+  Cmd_read_t *r = &(cmd->cargs.read);
+  ibp_iovec_t *iovec = &(r->iovec);
+
+  log_printf(10, "read_from_disk_sendfile: ns=%d id=" LU " a.size=" I64T " a.r_pos=" I64T " len=" I64T "\n", tbx_ns_getid(task->ns), a->id, a->size, a->r_pos, *left);
+  if (*left == 0) return(1);  //** Nothing to do
+
+  sfd = tbx_ns_native_fd_get(ns);
+  if (sfd == -1) return(-2);
+
+  fd = open_allocation(res, a->id, OSD_READ_MODE);
+  if (fd == NULL) {
+     log_printf(0, "read_from_disk_sendfile: Error with open_allocation(-res-, " LU ") = %d\n", a->id,  errno);
+     return(IBP_E_FILE_READ);
+  }
+
+  afd = native_fd_allocation(res, fd);
+  if (afd == -1) {  //** Chksummed allocation so the data has to be massaged
+     close_allocation(res, fd);
+     return(-2);
+  }
+
+  pfd.fd = sfd;
+  pfd.events = POLLOUT;
+
+  iovec_start(&(r->iovec), &index, &ioff, &ileft);
+
+  shortwrite = 0;
+  nwrite = 0;
+  nleft = *left;
+  do {
+     cleft = (ileft > chunksize) ? chunksize : ileft;
+     nwrite = sendfile_allocation(res, afd, sfd, ioff, cleft);
+     if (nwrite > 0) {
+        btotal = nwrite;
+        shortwrite = 0;
+     } else if (nwrite == 0) {  //** Socket is full so wait for it to drain
+        btotal = 0;
+        shortwrite++;
+        if (poll(&pfd, 1, 1000) > 0) {
+           if (pfd.revents & (POLLERR|POLLHUP|POLLNVAL)) shortwrite = 100;  //** closed connection
+        }
+     } else if (nwrite == IBP_E_FILE_READ) {  //** Allocation is short.  The status is already sent so drop the connection
+        char tmp[128];
+        log_printf(0, "read_from_disk_sendfile: Error with sendfile_allocation(%s, " LU ", " I64T ", " I64T ") = " I64T "\n",
+             ibp_rid2str(res->rid, tmp), a->id, ioff, cleft, nwrite);
+        btotal = 0;
+        shortwrite = 100;
+     } else {
+        btotal = 0;
+        shortwrite = 100;  //** closed connection
+     }
+
+     //** Update totals
+     ioff += btotal;
+     ileft -= btotal;
+     nleft -= btotal;
+     *left -= btotal;
+     a->r_pos += btotal;
+     iovec->transfer_total += btotal;
+     task->stat.nbytes += btotal;
+
+     if ((ileft <= 0) && (index < (iovec->n-1))) {
+        index++;
+        ileft = iovec->vec[index].len;
+        ioff = iovec->vec[index].off;
+     }
+
+     log_printf(15, "read_from_disk_sendfile: id=" LU " nleft=" I64T " nwrite=" I64T " off=" I64T " shortwrite=" I64T " ns=%d\n",
+          a->id, nleft, nwrite, ioff, shortwrite, tbx_ns_getid(task->ns));
+  } while ((nleft > 0) && (shortwrite < 3));
+
+  close_allocation(res, fd);
+
+  if ((nwrite < 0) || (shortwrite >= 100)) {        //** Dead connection
+     log_printf(10, "read_from_disk_sendfile: Socket error with ns=%d closing connection\n", tbx_ns_getid(ns));
+     task_status = -1;
+  } else if (*left == 0) {   //** Finished data transfer
+     log_printf(10, "read_from_disk_sendfile: Completed transfer! ns=%d tid=" LU "\n", tbx_ns_getid(task->ns), task->tid);
+     task_status = 1;
+  } else {           //** short write
+     log_printf(10, "read_from_disk_sendfile: returning ns=%d back to caller.  short read.  tid=" LU "\n", tbx_ns_getid(task->ns), task->tid);
+     task_status = 0;
+  }
+
+  return(task_status);
+}
+
 //************************************************************************************
 //  write_to_disk_user - Writes data to the disk buffer and transfers it using
 //     user space buffers.  Return values are
@@ -411,6 +533,215 @@ log_printf(10, "write_to_disk_user: id=" LU " ns=%d after loop ncurrread= " I64T
   return(task_status);
 }
 
+//************************************************************************************
+//  _wpipe_write - Stores a pipelined write buffer.  Executed by one of the
+//     resource's I/O threads.
+//************************************************************************************
+
+ibp_off_t _wpipe_write(res_io_op_t *op)
+{
+  wpipe_buf_t *b = (wpipe_buf_t *)op->arg;
+  ibp_iovec_t *iovec = b->iovec;
+  ibp_off_t bpos, nleft, cleft, ioff, ileft, err;
+  int index;
+
+  index = b->index;
+  ioff = b->ioff;
+  ileft = b->ileft;
+  bpos = 0;
+  nleft = b->nbytes;
+  while (nleft > 0) {
+     cleft = (nleft > ileft) ? ileft : nleft;
+     err = write_allocation(b->res, b->fd, ioff, cleft, &(b->buffer[bpos]));
+     if (err != 0) {
+        char tmp[128];
+        log_printf(0, "_wpipe_write: Error with write_allocation(%s, " I64T ", " I64T ", buffer) = " I64T "\n",
+                ibp_rid2str(b->res->rid, tmp), ioff, cleft, err);
+        return(err);
+     }
+
+     bpos += cleft;
+     nleft -= cleft;
+     ioff += cleft;
+     ileft -= cleft;
+     if ((ileft <= 0) && (index < (iovec->n-1))) {
+        index++;
+        ileft = iovec->vec[index].len;
+        ioff = iovec->vec[index].off;
+     }
+  }
+
+  return(0);
+}
+
+//************************************************************************************
+//  write_to_disk_pipelined - Same as write_to_disk_user but the disk writes are
+//     handed off to the resource's I/O threads so the next buffer can be received
+//     while the previous one is being stored.  Up to write_pipeline_depth buffers
+//     are in flight.  Return values are
+//    -1 -- Dead connection
+//     0 -- Transfered as much as data as possible
+//     1 -- Completed provided task
+//************************************************************************************
+
+int write_to_disk_pipelined(ibp_task_t *task, Allocation_t *a, ibp_off_t *left, Resource_t *res)
+{
+  int bufsize = 2*1048576;
+  int depth = global_config->server.write_pipeline_depth;
+  ibp_off_t nbytes, ntotal, nread, nleft, cleft;
+  Cmd_state_t *cmd = &(task->cmd);
+  Cmd_write_t *w = &(cmd->cargs.write);
+  ibp_iovec_t *iovec = &(w->iovec);
+  char *buffer;
+  wpipe_buf_t *wb, *b;
+  res_io_op_t *op;
+  tbx_que_t *done;
+  tbx_ns_timeout_t dt;
+  int task_status, shortread, index, i, slot, n_pending;
+  osd_fd_t *fd;
+  ibp_off_t bpos, ncurrread, ioff, ileft;
+
+  log_printf(10, "write_to_disk_pipelined: id=" LU " ns=%d depth=%d\n", a->id, tbx_ns_getid(task->ns), depth);
+
+  if (*left == 0) return(1);   //** Nothing to do
+
+  tbx_ns_timeout_set(&dt, 1, 0);  //** set the max time we'll wait for data
+
+  if (a->type == IBP_BYTEARRAY) {
+     nleft = *left;   //** Already validated range in calling routine
+  } else {
+     nleft = (*left > ((ibp_off_t)a->max_size - (ibp_off_t)a->size)) ? ((ibp_off_t)a->max_size - (ibp_off_t)a->size) : *left;
+  }
+
+  if (nleft == 0) {  //** no space to store anything
+     return(0);
+  }
+
+  fd = open_allocation(res, a->id, OSD_WRITE_MODE);
+  if (fd == NULL) {
+     log_printf(0, "write_to_disk_pipelined: Error with open_allocation(-res-, " LU ") = %d\n", a->id,  errno);
+     return(IBP_E_FILE_WRITE);
+  }
+
+  //** Set up the buffers
+  done = tbx_que_create(depth, sizeof(res_io_op_t *));
+  tbx_type_malloc(buffer, char, (ibp_off_t)depth*bufsize);
+  tbx_type_malloc_clear(wb, wpipe_buf_t, depth);
+  for (i=0; i<depth; i++) {
+     wb[i].op.fn = _wpipe_write;
+     wb[i].op.arg = &(wb[i]);
+     wb[i].op.done = done;
+     wb[i].res = res;
+     wb[i].fd = fd;
+     wb[i].iovec = iovec;
+     wb[i].buffer = &(buffer[i*bufsize]);
+  }
+
+  iovec_start(&(w->iovec), &index, &ioff, &ileft);
+
+  ntotal = 0;
+  shortread = 0;
+  slot = 0;
+  n_pending = 0;
+  do {
+     //** If all the buffers are in use wait for the oldest one to be stored
+     if (n_pending == depth) {
+        tbx_que_get(done, &op, TBX_QUE_BLOCK);
+        n_pending--;
+        if (op->err != 0) {
+           shortread = 100;
+           break;
+        }
+     }
+
+     //** Fill the buffer
+     b = &(wb[slot]);
+     bpos = 0;
+     nbytes = (nleft < bufsize) ? nleft : bufsize;
+     do {
+        ncurrread = server_ns_read(task->ns, &(b->buffer[bpos]), nbytes, dt);
+        if (ncurrread > 0) {
+            nbytes -= ncurrread;
+            bpos += ncurrread;
+            task->stat.nbytes += ncurrread;
+        } else if (ncurrread == 0) {
+            shortread++;
+        } else {
+            shortread = 100;
+        }
+     } while ((nbytes > 0) && (shortread < 3));
+     nread = bpos;
+
+     log_printf(10, "write_to_disk_pipelined: id=" LU " ns=%d slot=%d n_pending=%d nread=" I64T " shortread=%d\n", a->id, tbx_ns_getid(task->ns), slot, n_pending, nread, shortread);
+
+     if (nread > 0) {
+        //** Hand it off to be stored
+        b->nbytes = nread;
+        b->index = index;
+        b->ioff = ioff;
+        b->ileft = ileft;
+        resource_io_submit(res, a->id, &(b->op));
+        n_pending++;
+        slot = (slot + 1) % depth;
+
+        //** and advance our position
+        do {
+           cleft = (nread > ileft) ? ileft : nread;
+
+           ileft -= cleft;
+           ioff += cleft;
+           ntotal += cleft;
+           iovec->transfer_total += cleft;
+           nleft -= cleft;
+           nread -= cleft;
+
+           if (a->type == IBP_BYTEARRAY) {  //** Update the size before moving on
+             if (ioff > (ibp_off_t)a->size) a->size = ioff;
+           }
+
+           if ((ileft <= 0) && (index < (iovec->n-1))) {
+              index++;
+              ileft = iovec->vec[index].len;
+              ioff = iovec->vec[index].off;
+           }
+        } while (nread > 0);
+     } else {
+        shortread++;
+     }
+
+     log_printf(15, "write_to_disk_pipelined: id=" LU " left=" I64T " -- pos=" I64T ", nleft=" I64T ", ntotal=" I64T " ns=%d shortread=%d\n",
+              a->id, *left, ioff, nleft, ntotal, tbx_ns_getid(task->ns), shortread);
+  } while ((nleft > 0) && (shortread < 3));
+
+  //** Wait for everything to be stored
+  while (n_pending > 0) {
+     tbx_que_get(done, &op, TBX_QUE_BLOCK);
+     n_pending--;
+     if (op->err != 0) shortread = 100;
+  }
+
+  *left = nleft;
+
+  if (shortread >= 100) {        //** Dead connection or disk error
+     log_printf(10, "write_to_disk_pipelined: network or disk error  ns=%d\n", tbx_ns_getid(task->ns));
+     task_status = -1;
+  } else if (*left == 0) {   //** Finished data transfer
+     log_printf(10, "write_to_disk_pipelined: Completed transfer! ns=%d tid=" LU " a.size=" I64T "\n", tbx_ns_getid(task->ns), task->tid, a->size);
+     task_status = 1;
+  } else {           //** short write
+     log_printf(10, "write_to_disk_pipelined: returning ns=%d back to caller.  a.size=" LU " short read.  tid=" LU "\n", tbx_ns_getid(task->ns), a->size, task->tid);
+     task_status = 0;
+  }
+
+  close_allocation(res, fd);
+
+  tbx_que_destroy(done);
+  free(wb);
+  free(buffer);
+
+  return(task_status);
+}
+
 //************************************************************************************
 // ------------------------------ Wrapper routines------------------------------------
 //************************************************************************************
@@ -426,6 +757,17 @@ log_printf(10, "write_to_disk_user: id=" LU " ns=%d after loop ncurrread= " I64T
 
 int read_from_disk(ibp_task_t *task, Allocation_t *a, ibp_off_t *left, Resource_t *res)
 {
+  Cmd_read_t *r = &(task->cmd.cargs.read);
+  int err;
+
+  //** sendfile() can't be used if the network stream is chksummed and
+  //** isn't worth it if the iovec is lots of small pieces
+  if ((global_config->server.splice_enable == 1) && (task->enable_chksum == 0) && (r->iovec.n > 0) &&
+      ((r->iovec.total_len / r->iovec.n) >= SENDFILE_MIN_IOVEC)) {
+     err = read_from_disk_sendfile(task, a, left, res);
+     if (err != -2) return(err);
+  }
+
   return(read_from_disk_user(task, a, left, res));
 }
 
@@ -439,6 +781,11 @@ int read_from_disk(ibp_task_t *task, Allocation_t *a, ibp_off_t *left, Resource_
 
 int write_to_disk(ibp_task_t *task, Allocation_t *a, ibp_off_t *left, Resource_t *res)
 {
+  //** Only worth pipelining if there's more than a single buffer of data
+  if ((global_config->server.write_pipeline_depth > 1) && (*left > 2*1048576) && (resource_io_enabled(res) == 1)) {
+     return(write_to_disk_pipelined(task, a, left, res));
+  }
+
   return(write_to_disk_user(task, a, left, res));
 }
 
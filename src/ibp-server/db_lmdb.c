@@ -0,0 +1,786 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// db_lmdb - LMDB allocation metadata backend.
+//
+//    The primary table maps the ID to the allocation.  The cap tables
+//    map the cap to the ID and the expire/soft tables use a big endian
+//    (time, id) key so a plain B-tree walk returns the allocations in
+//    expiration order and a range lookup finds the 1st allocation
+//    expiring after a given time.  Every mutation updates the primary
+//    and all the indices in one transaction.
+//
+//    LMDB allows a single writer.  Read-only iterators each use their
+//    own snapshot so long walks don't block writers.  The read-write
+//    iterators opened by a thread share one write transaction and any
+//    other mutations made by that thread while they are open go through
+//    the same transaction.
+//*****************************************************************
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <apr_portable.h>
+#include <apr_thread_mutex.h>
+#include <apr_pools.h>
+#include <tbx/fmttypes.h>
+#include <tbx/log.h>
+#include <tbx/type_malloc.h>
+#include "debug.h"
+#include "db_lmdb.h"
+
+#ifdef HAVE_LMDB_H
+
+#include <lmdb.h>
+
+#define LMDB_FNAME   "md.lmdb"
+#define LMDB_N_INDEX 6          //** One table for each DB_INDEX_*
+#define LMDB_TK_SIZE 12         //** Time key size: 4 byte time + 8 byte ID
+
+typedef struct {
+  MDB_env *env;
+  MDB_dbi dbi[LMDB_N_INDEX];   //** Indexed by DB_INDEX_*
+  apr_thread_mutex_t *lock;    //** Protects the shared iterator transaction
+  apr_pool_t *mpool;
+  MDB_txn *iter_txn;           //** Write transaction used by the open read-write iterators
+  apr_os_thread_t iter_owner;  //** Thread owning iter_txn
+  int n_iter;                  //** Number of open iterators using iter_txn
+  int64_t map_size;
+  int nosync;
+} lmdb_t;
+
+typedef struct {
+  MDB_cursor *cursor;
+  MDB_txn *rd_txn;    //** Private read-only transaction or NULL if using iter_txn
+} lmdb_iter_t;
+
+static const char *_lm_dbi_name[LMDB_N_INDEX] = { "id", "read", "write", "manage", "expire", "soft" };
+
+//*****************************************************************
+// _lm_ret - Maps LMDB errors onto the BDB codes the callers expect
+//*****************************************************************
+
+static int _lm_ret(int err)
+{
+  return((err == MDB_NOTFOUND) ? DB_NOTFOUND : err);
+}
+
+//*****************************************************************
+// _lm_timekey - Encodes the time key in big endian order so
+//    memcmp() sorts by time and then ID
+//*****************************************************************
+
+static void _lm_timekey(unsigned char *k, uint32_t t, osd_id_t id)
+{
+  int i;
+
+  for (i=0; i<4; i++) k[i] = (t >> (24 - 8*i)) & 0xFF;
+  for (i=0; i<8; i++) k[4+i] = (id >> (56 - 8*i)) & 0xFF;
+}
+
+//*****************************************************************
+// _lm_timekey_id - Returns the ID from an encoded time key
+//*****************************************************************
+
+static osd_id_t _lm_timekey_id(const unsigned char *k)
+{
+  osd_id_t id = 0;
+  int i;
+
+  for (i=0; i<8; i++) id = (id << 8) | k[4+i];
+
+  return(id);
+}
+
+//*****************************************************************
+// _lm_key - Fills in the allocation's key for the given index.
+//    Returns 1 if the allocation isn't stored in the index.
+//*****************************************************************
+
+static int _lm_key(Allocation_t *a, int index, MDB_val *key, unsigned char *tk)
+{
+  switch (index) {
+    case DB_INDEX_ID:
+       key->mv_data = &(a->id);
+       key->mv_size = sizeof(osd_id_t);
+       return(0);
+    case DB_INDEX_READ:
+    case DB_INDEX_WRITE:
+    case DB_INDEX_MANAGE:
+       key->mv_data = a->caps[index - DB_INDEX_READ].v;
+       key->mv_size = CAP_SIZE;
+       return(0);
+    case DB_INDEX_EXPIRE:
+       _lm_timekey(tk, a->expirekey.time, a->id);
+       break;
+    case DB_INDEX_SOFT:
+       if (a->reliability != ALLOC_SOFT) return(1);
+       _lm_timekey(tk, a->softkey.time, a->id);
+       break;
+  }
+
+  key->mv_data = tk;
+  key->mv_size = LMDB_TK_SIZE;
+  return(0);
+}
+
+//*****************************************************************
+// _lm_txn_start - Picks the transaction to use for an operation.
+//    If no txn is given and the thread has iterators open their
+//    transaction is used since LMDB only allows a single writer.
+//*****************************************************************
+
+static int _lm_txn_start(lmdb_t *lm, MDB_txn *given, unsigned int flags, MDB_txn **txn, int *owned)
+{
+  *owned = 0;
+  if (given != NULL) {
+     *txn = given;
+     return(0);
+  }
+
+  apr_thread_mutex_lock(lm->lock);
+  if ((lm->n_iter > 0) && apr_os_thread_equal(lm->iter_owner, apr_os_thread_current())) {
+     *txn = lm->iter_txn;
+     apr_thread_mutex_unlock(lm->lock);
+     return(0);
+  }
+  apr_thread_mutex_unlock(lm->lock);
+
+  *owned = 1;
+  return(mdb_txn_begin(lm->env, NULL, flags, txn));
+}
+
+//*****************************************************************
+// _lm_txn_finish - Completes a transaction from _lm_txn_start
+//*****************************************************************
+
+static int _lm_txn_finish(MDB_txn *txn, int owned, int rdonly, int err)
+{
+  if (owned == 0) return(err);
+
+  if ((err == 0) && (rdonly == 0)) return(mdb_txn_commit(txn));
+
+  mdb_txn_abort(txn);
+  return(err);
+}
+
+//*****************************************************************
+// _lm_fetch - Reads the allocation from the primary table
+//*****************************************************************
+
+static int _lm_fetch(lmdb_t *lm, MDB_txn *txn, osd_id_t id, Allocation_t *a)
+{
+  MDB_val key, data;
+  int err;
+
+  key.mv_data = &id;
+  key.mv_size = sizeof(osd_id_t);
+  err = mdb_get(txn, lm->dbi[DB_INDEX_ID], &key, &data);
+  if (err != 0) {
+     log_printf(10, "Unknown ID=" LU " error=%d (%s)\n", id, err, mdb_strerror(err));
+     return(err);
+  }
+
+  memset(a, 0, sizeof(Allocation_t));
+  memcpy(a, data.mv_data, (data.mv_size < sizeof(Allocation_t)) ? data.mv_size : sizeof(Allocation_t));
+
+  return(0);
+}
+
+//*****************************************************************
+// _lm_put - Stores the allocation.  Index entries are only touched
+//    if their key changed so open cursors aren't disturbed.
+//*****************************************************************
+
+static int _lm_put(lmdb_t *lm, MDB_txn *txn, Allocation_t *a)
+{
+  Allocation_t old;
+  MDB_val nkey, okey, data;
+  unsigned char ntk[LMDB_TK_SIZE], otk[LMDB_TK_SIZE];
+  int i, err, found, has_old, has_new, same;
+
+  err = _lm_fetch(lm, txn, a->id, &old);
+  if ((err != 0) && (err != MDB_NOTFOUND)) return(err);
+  found = (err == 0) ? 1 : 0;
+
+  for (i=0; i<LMDB_N_INDEX; i++) {
+     has_new = (_lm_key(a, i, &nkey, ntk) == 0) ? 1 : 0;
+     has_old = ((found == 1) && (_lm_key(&old, i, &okey, otk) == 0)) ? 1 : 0;
+     same = (has_old && has_new && (okey.mv_size == nkey.mv_size) && (memcmp(okey.mv_data, nkey.mv_data, nkey.mv_size) == 0)) ? 1 : 0;
+
+     if ((has_old) && (!same)) {
+        err = mdb_del(txn, lm->dbi[i], &okey, NULL);
+        if ((err != 0) && (err != MDB_NOTFOUND)) {
+           log_printf(0, "Error removing old %s key id=" LU " err=%s\n", _lm_dbi_name[i], a->id, mdb_strerror(err));
+           return(err);
+        }
+     }
+
+     if ((has_new) && ((!same) || (i == DB_INDEX_ID))) {  //** The primary always gets the new record
+        if (i == DB_INDEX_ID) {
+           data.mv_data = a;
+           data.mv_size = sizeof(Allocation_t);
+        } else {
+           data.mv_data = &(a->id);
+           data.mv_size = sizeof(osd_id_t);
+        }
+        err = mdb_put(txn, lm->dbi[i], &nkey, &data, 0);
+        if (err != 0) {
+           log_printf(0, "Error storing %s key id=" LU " err=%s\n", _lm_dbi_name[i], a->id, mdb_strerror(err));
+           return(err);
+        }
+     }
+  }
+
+  return(0);
+}
+
+//*****************************************************************
+// _lm_index_remove - Removes all the allocation's entries except
+//    the skip index which the caller has already handled.
+//*****************************************************************
+
+static int _lm_index_remove(lmdb_t *lm, MDB_txn *txn, Allocation_t *a, int skip)
+{
+  MDB_val key;
+  unsigned char tk[LMDB_TK_SIZE];
+  int i, err;
+
+  for (i=0; i<LMDB_N_INDEX; i++) {
+     if (i == skip) continue;
+     if (_lm_key(a, i, &key, tk) != 0) continue;
+
+     err = mdb_del(txn, lm->dbi[i], &key, NULL);
+     if ((err != 0) && (err != MDB_NOTFOUND)) {
+        log_printf(0, "Error removing %s key id=" LU " err=%s\n", _lm_dbi_name[i], a->id, mdb_strerror(err));
+        return(err);
+     }
+  }
+
+  return(0);
+}
+
+//*****************************************************************
+// lmdb_get_id - Returns the allocation with the given ID
+//*****************************************************************
+
+int lmdb_get_id(DB_resource_t *dbr, osd_id_t id, Allocation_t *a)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  MDB_txn *txn;
+  int err, owned;
+
+  if ((err = _lm_txn_start(lm, NULL, MDB_RDONLY, &txn, &owned)) != 0) return(err);
+  err = _lm_fetch(lm, txn, id, a);
+  return(_lm_ret(_lm_txn_finish(txn, owned, 1, err)));
+}
+
+//*****************************************************************
+// lmdb_get_cap - Returns the allocation with the given cap
+//*****************************************************************
+
+int lmdb_get_cap(DB_resource_t *dbr, int cap_type, Cap_t *cap, Allocation_t *a)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  MDB_txn *txn;
+  MDB_val key, data;
+  osd_id_t id;
+  int err, owned;
+
+  if ((err = _lm_txn_start(lm, NULL, MDB_RDONLY, &txn, &owned)) != 0) return(err);
+
+  key.mv_data = cap->v;
+  key.mv_size = CAP_SIZE;
+  err = mdb_get(txn, lm->dbi[DB_INDEX_READ + cap_type], &key, &data);
+  if (err == 0) {
+     memcpy(&id, data.mv_data, sizeof(osd_id_t));
+     err = _lm_fetch(lm, txn, id, a);
+  }
+
+  return(_lm_ret(_lm_txn_finish(txn, owned, 1, err)));
+}
+
+//*****************************************************************
+// lmdb_put - Stores the allocation and updates the indices
+//*****************************************************************
+
+int lmdb_put(DB_resource_t *dbr, void *given, Allocation_t *a)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  MDB_txn *txn;
+  int err, owned;
+
+  if ((err = _lm_txn_start(lm, (MDB_txn *)given, 0, &txn, &owned)) != 0) return(err);
+  err = _lm_put(lm, txn, a);
+  return(_lm_ret(_lm_txn_finish(txn, owned, 0, err)));
+}
+
+//*****************************************************************
+// lmdb_remove - Removes the allocation from all the tables
+//*****************************************************************
+
+int lmdb_remove(DB_resource_t *dbr, void *given, Allocation_t *a)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  MDB_txn *txn;
+  Allocation_t old;
+  int err, owned;
+
+  if ((err = _lm_txn_start(lm, (MDB_txn *)given, 0, &txn, &owned)) != 0) return(err);
+  err = _lm_fetch(lm, txn, a->id, &old);   //** Use what's stored since the caller's copy may be stale
+  if (err == 0) err = _lm_index_remove(lm, txn, &old, -1);
+  if (err != 0) log_printf(0, "remove_alloc_db: id=" LU " %s\n", a->id, mdb_strerror(err));
+  return(_lm_ret(_lm_txn_finish(txn, owned, 0, err)));
+}
+
+//*****************************************************************
+// lmdb_txn_begin - Starts a write transaction
+//*****************************************************************
+
+int lmdb_txn_begin(DB_resource_t *dbr, void **txn)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  MDB_txn *t = NULL;
+  int err;
+
+  err = mdb_txn_begin(lm->env, NULL, 0, &t);
+  if (err != 0) log_printf(0, "Transaction begin failed with err %s\n", mdb_strerror(err));
+
+  *txn = t;
+  return(err);
+}
+
+//*****************************************************************
+// lmdb_txn_commit - Commits the transaction
+//*****************************************************************
+
+int lmdb_txn_commit(DB_resource_t *dbr, void *txn)
+{
+  return(mdb_txn_commit((MDB_txn *)txn));
+}
+
+//*****************************************************************
+// lmdb_txn_abort - Aborts the transaction
+//*****************************************************************
+
+void lmdb_txn_abort(DB_resource_t *dbr, void *txn)
+{
+  mdb_txn_abort((MDB_txn *)txn);
+}
+
+//*****************************************************************
+// lmdb_count - Returns the number of allocations
+//*****************************************************************
+
+int lmdb_count(DB_resource_t *dbr)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  MDB_txn *txn;
+  MDB_stat st;
+  int err, owned;
+
+  if ((err = _lm_txn_start(lm, NULL, MDB_RDONLY, &txn, &owned)) != 0) return(-1);
+  err = mdb_stat(txn, lm->dbi[DB_INDEX_ID], &st);
+  _lm_txn_finish(txn, owned, 1, err);
+
+  if (err != 0) {
+     log_printf(0, "get_allocations_db:  error=%d  (%s)\n", err, mdb_strerror(err));
+     return(-1);
+  }
+
+  return(st.ms_entries);
+}
+
+//*****************************************************************
+// lmdb_print - Prints the table stats
+//*****************************************************************
+
+int lmdb_print(DB_resource_t *dbr, FILE *fd)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  MDB_envinfo info;
+  MDB_txn *txn;
+  MDB_stat st;
+  int i, err, owned;
+
+  mdb_env_info(lm->env, &info);
+  fprintf(fd, "LMDB map_size=" ST " last_pgno=" ST " last_txnid=" ST " nosync=%d\n", info.me_mapsize, info.me_last_pgno, info.me_last_txnid, lm->nosync);
+
+  if ((err = _lm_txn_start(lm, NULL, MDB_RDONLY, &txn, &owned)) != 0) return(err);
+  for (i=0; i<LMDB_N_INDEX; i++) {
+     if (mdb_stat(txn, lm->dbi[i], &st) != 0) continue;
+     fprintf(fd, "  %-6s entries=" ST " depth=%u branch=" ST " leaf=" ST " overflow=" ST "\n", _lm_dbi_name[i],
+         st.ms_entries, st.ms_depth, st.ms_branch_pages, st.ms_leaf_pages, st.ms_overflow_pages);
+  }
+  _lm_txn_finish(txn, owned, 1, 0);
+
+  return(0);
+}
+
+//*****************************************************************
+// _lm_iter_release - Drops the iterator's reference on the shared
+//    transaction and commits it when the last one is gone
+//*****************************************************************
+
+static int _lm_iter_release(lmdb_t *lm)
+{
+  MDB_txn *txn = NULL;
+  int err;
+
+  apr_thread_mutex_lock(lm->lock);
+  lm->n_iter--;
+  if (lm->n_iter == 0) {
+     txn = lm->iter_txn;
+     lm->iter_txn = NULL;
+  }
+  apr_thread_mutex_unlock(lm->lock);
+
+  if (txn == NULL) return(0);
+
+  err = mdb_txn_commit(txn);
+  if (err != 0) log_printf(0, "db_iterator_end: Transaction commit failed with err %s (%d)\n", mdb_strerror(err), err);
+
+  return(err);
+}
+
+//*****************************************************************
+// lmdb_iter_begin - Returns an iterator over the given index.  Read-only
+//    iterators get their own snapshot so they never hold the single
+//    writer lock.  Read-write iterators share the thread's write
+//    transaction.
+//*****************************************************************
+
+DB_iterator_t *lmdb_iter_begin(DB_resource_t *dbr, int index, int mode)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+  DB_iterator_t *it;
+  lmdb_iter_t *li;
+  MDB_txn *txn;
+  int err;
+
+  tbx_type_malloc_clear(li, lmdb_iter_t, 1);
+
+  apr_thread_mutex_lock(lm->lock);
+  if ((lm->n_iter > 0) && apr_os_thread_equal(lm->iter_owner, apr_os_thread_current())) {
+     lm->n_iter++;   //** Already have a write txn so use it to see our own changes
+     txn = lm->iter_txn;
+     apr_thread_mutex_unlock(lm->lock);
+  } else if (mode == DBR_ITER_RDONLY) {
+     apr_thread_mutex_unlock(lm->lock);
+
+     err = mdb_txn_begin(lm->env, NULL, MDB_RDONLY, &txn);
+     if (err != 0) {
+        log_printf(0, "db_iterator_begin: index=%d Read transaction begin failed with err %s (%d)\n", index, mdb_strerror(err), err);
+        free(li);
+        return(NULL);
+     }
+     li->rd_txn = txn;
+  } else {
+     apr_thread_mutex_unlock(lm->lock);
+
+     err = mdb_txn_begin(lm->env, NULL, 0, &txn);   //** Waits for any other writer
+     if (err != 0) {
+        log_printf(0, "db_iterator_begin: index=%d Transaction begin failed with err %s (%d)\n", index, mdb_strerror(err), err);
+        free(li);
+        return(NULL);
+     }
+
+     apr_thread_mutex_lock(lm->lock);
+     lm->iter_txn = txn;
+     lm->iter_owner = apr_os_thread_current();
+     lm->n_iter = 1;
+     apr_thread_mutex_unlock(lm->lock);
+  }
+
+  err = mdb_cursor_open(txn, lm->dbi[index], &(li->cursor));
+  if (err != 0) {
+     log_printf(0, "db_iterator_begin: index=%d cursor failed with err %s (%d)\n", index, mdb_strerror(err), err);
+     if (li->rd_txn) {
+        mdb_txn_abort(li->rd_txn);
+     } else {
+        _lm_iter_release(lm);
+     }
+     free(li);
+     return(NULL);
+  }
+
+  tbx_type_malloc_clear(it, DB_iterator_t, 1);
+  it->priv = li;
+  it->id = rand();
+  it->db_index = index;
+  it->dbr = dbr;
+
+  debug_printf(10, "db_iterator_begin:  id=%d mode=%d\n", it->id, mode);
+
+  return(it);
+}
+
+//*****************************************************************
+// lmdb_iter_end - Closes the iterator
+//*****************************************************************
+
+int lmdb_iter_end(DB_iterator_t *it)
+{
+  lmdb_iter_t *li = (lmdb_iter_t *)it->priv;
+  int err;
+
+  debug_printf(10, "db_iterator_end:  id=%d\n", it->id);
+
+  mdb_cursor_close(li->cursor);
+  if (li->rd_txn) {
+     mdb_txn_abort(li->rd_txn);   //** Nothing to commit
+     err = 0;
+  } else {
+     err = _lm_iter_release((lmdb_t *)it->dbr->priv);
+  }
+
+  free(li);
+  free(it);
+
+  return(_lm_ret(err));
+}
+
+//*****************************************************************
+// _lm_iter_load - Loads the allocation for the cursor's record
+//*****************************************************************
+
+static int _lm_iter_load(DB_iterator_t *it, MDB_val *key, MDB_val *data, Allocation_t *a)
+{
+  lmdb_iter_t *li = (lmdb_iter_t *)it->priv;
+  osd_id_t id;
+
+  switch (it->db_index) {
+    case DB_INDEX_ID:
+       memset(a, 0, sizeof(Allocation_t));
+       memcpy(a, data->mv_data, (data->mv_size < sizeof(Allocation_t)) ? data->mv_size : sizeof(Allocation_t));
+       return(0);
+    case DB_INDEX_READ:
+    case DB_INDEX_WRITE:
+    case DB_INDEX_MANAGE:
+       memcpy(&id, data->mv_data, sizeof(osd_id_t));
+       break;
+    default:
+       id = _lm_timekey_id(key->mv_data);
+  }
+
+  return(_lm_fetch((lmdb_t *)it->dbr->priv, mdb_cursor_txn(li->cursor), id, a));
+}
+
+//*****************************************************************
+// lmdb_iter_next - Returns the next record in the given direction
+//*****************************************************************
+
+int lmdb_iter_next(DB_iterator_t *it, int direction, Allocation_t *a)
+{
+  lmdb_iter_t *li = (lmdb_iter_t *)it->priv;
+  MDB_val key, data;
+  int err;
+
+  err = mdb_cursor_get(li->cursor, &key, &data, (direction == DBR_PREV) ? MDB_PREV : MDB_NEXT);
+  if (err == 0) err = _lm_iter_load(it, &key, &data, a);
+  if (err != 0) {
+     log_printf(10, "db_iterator_next: key_index=%d err = %s\n", it->db_index, mdb_strerror(err));
+  }
+
+  return(_lm_ret(err));
+}
+
+//*****************************************************************
+// lmdb_iter_set_time - Positions the iterator at the 1st record >= t
+//*****************************************************************
+
+int lmdb_iter_set_time(DB_iterator_t *it, ibp_time_t t, Allocation_t *a)
+{
+  lmdb_iter_t *li = (lmdb_iter_t *)it->priv;
+  unsigned char tk[LMDB_TK_SIZE];
+  MDB_val key, data;
+  int err;
+
+  _lm_timekey(tk, t, 0);
+  key.mv_data = tk;
+  key.mv_size = LMDB_TK_SIZE;
+
+  err = mdb_cursor_get(li->cursor, &key, &data, MDB_SET_RANGE);
+  if (err == 0) err = _lm_iter_load(it, &key, &data, a);
+  if (err != 0) {
+     log_printf(5, "set_expire_iterator: Error with get!  time=" TT " * error=%d\n", ibp2apr_time(t), err);
+     return(_lm_ret(err));
+  }
+
+  log_printf(15, "set_expire_iterator: t=" TT " id=" LU "\n", ibp2apr_time(t), a->id);
+
+  return(0);
+}
+
+//*****************************************************************
+// lmdb_iter_modify - Replaces the allocation under the iterator
+//*****************************************************************
+
+int lmdb_iter_modify(DB_iterator_t *it, Allocation_t *a)
+{
+  lmdb_iter_t *li = (lmdb_iter_t *)it->priv;
+  int err;
+
+  if (li->rd_txn) {
+     log_printf(0, "modify_alloc_iter_db: ERROR iterator is read-only\n");
+     return(EACCES);
+  }
+
+  err = _lm_put((lmdb_t *)it->dbr->priv, mdb_cursor_txn(li->cursor), a);
+  if (err != 0) log_printf(0, "modify_alloc_iter_db: %s\n", mdb_strerror(err));
+
+  return(_lm_ret(err));
+}
+
+//*****************************************************************
+// lmdb_iter_remove - Removes the allocation under the iterator.  The
+//    iterator's own entry goes through the cursor so it stays valid.
+//*****************************************************************
+
+int lmdb_iter_remove(DB_iterator_t *it)
+{
+  lmdb_iter_t *li = (lmdb_iter_t *)it->priv;
+  Allocation_t a;
+  MDB_val key, data;
+  int err;
+
+  if (li->rd_txn) {
+     log_printf(0, "remove_alloc_iter_db: ERROR iterator is read-only\n");
+     return(EACCES);
+  }
+
+  err = mdb_cursor_get(li->cursor, &key, &data, MDB_GET_CURRENT);
+  if (err == 0) err = _lm_iter_load(it, &key, &data, &a);
+  if (err == 0) err = mdb_cursor_del(li->cursor, 0);
+  if (err == 0) err = _lm_index_remove((lmdb_t *)it->dbr->priv, mdb_cursor_txn(li->cursor), &a, it->db_index);
+  if (err != 0) log_printf(0, "remove_alloc_iter_db: %s\n", mdb_strerror(err));
+
+  return(_lm_ret(err));
+}
+
+//*****************************************************************
+// lmdb_umount - Closes the environment
+//*****************************************************************
+
+int lmdb_umount(DB_resource_t *dbr)
+{
+  lmdb_t *lm = (lmdb_t *)dbr->priv;
+
+  if (lm->n_iter > 0) log_printf(0, "ERROR: %s closing with %d iterators open\n", dbr->kgroup, lm->n_iter);
+
+  mdb_env_close(lm->env);
+  apr_thread_mutex_destroy(lm->lock);
+  apr_pool_destroy(lm->mpool);
+  free(lm);
+  dbr->priv = NULL;
+
+  return(0);
+}
+
+static DB_md_fn_t lmdb_fn = {
+  .umount = lmdb_umount,
+  .print = lmdb_print,
+  .count = lmdb_count,
+  .get_id = lmdb_get_id,
+  .get_cap = lmdb_get_cap,
+  .put = lmdb_put,
+  .remove = lmdb_remove,
+  .txn_begin = lmdb_txn_begin,
+  .txn_commit = lmdb_txn_commit,
+  .txn_abort = lmdb_txn_abort,
+  .iter_begin = lmdb_iter_begin,
+  .iter_end = lmdb_iter_end,
+  .iter_next = lmdb_iter_next,
+  .iter_set_time = lmdb_iter_set_time,
+  .iter_modify = lmdb_iter_modify,
+  .iter_remove = lmdb_iter_remove
+};
+
+//*****************************************************************
+// lmdb_mount_db - Opens or creates the LMDB store in the DB location
+//*****************************************************************
+
+int lmdb_mount_db(tbx_inip_file_t *kf, const char *kgroup, DB_resource_t *dbr, int wipe_clean)
+{
+  lmdb_t *lm;
+  MDB_txn *txn;
+  unsigned int flags;
+  char fname[4096], lname[4200];
+  int i, err;
+
+  tbx_type_malloc_clear(lm, lmdb_t, 1);
+  lm->map_size = tbx_inip_get_integer(kf, kgroup, "lmdb_map_size", (int64_t)64*1024*1024*1024);
+  lm->nosync = tbx_inip_get_integer(kf, kgroup, "lmdb_nosync", 0);
+
+  snprintf(fname, sizeof(fname), "%s/" LMDB_FNAME, dbr->loc);
+  snprintf(lname, sizeof(lname), "%s-lock", fname);
+  if (wipe_clean == 2) {
+     remove(fname);
+     remove(lname);
+  }
+
+  flags = MDB_NOSUBDIR | MDB_NOTLS;
+  if (lm->nosync == 1) flags |= MDB_NOSYNC;  //** Survives a process crash but not a power failure
+
+  if ((err = mdb_env_create(&(lm->env))) != 0) goto fail;
+  if ((err = mdb_env_set_maxdbs(lm->env, LMDB_N_INDEX)) != 0) goto fail;
+  if ((err = mdb_env_set_mapsize(lm->env, lm->map_size)) != 0) goto fail;
+  if ((err = mdb_env_open(lm->env, fname, flags, 0600)) != 0) goto fail;
+
+  if ((err = mdb_txn_begin(lm->env, NULL, 0, &txn)) != 0) goto fail;
+  for (i=0; i<LMDB_N_INDEX; i++) {
+     if ((err = mdb_dbi_open(txn, _lm_dbi_name[i], MDB_CREATE, &(lm->dbi[i]))) != 0) {
+        mdb_txn_abort(txn);
+        goto fail;
+     }
+  }
+  if ((err = mdb_txn_commit(txn)) != 0) goto fail;
+
+  apr_pool_create(&(lm->mpool), NULL);
+  apr_thread_mutex_create(&(lm->lock), APR_THREAD_MUTEX_DEFAULT, lm->mpool);
+
+  dbr->env = NULL;
+  dbr->dbenv = NULL;
+  dbr->priv = lm;
+  dbr->fn = &lmdb_fn;
+
+  log_printf(5, "Mounted %s map_size=" I64T " nosync=%d\n", fname, lm->map_size, lm->nosync);
+  return(0);
+
+fail:
+  log_printf(0, "lmdb_mount_db: Can't open %s: %s\n", fname, mdb_strerror(err));
+  printf("lmdb_mount_db: Can't open %s: %s\n", fname, mdb_strerror(err));
+  if (lm->env) mdb_env_close(lm->env);
+  free(lm);
+  return(err);
+}
+
+#else   //** No LMDB support
+
+//*****************************************************************
+// lmdb_mount_db - Always fails since LMDB support wasn't compiled in
+//*****************************************************************
+
+int lmdb_mount_db(tbx_inip_file_t *kf, const char *kgroup, DB_resource_t *dbr, int wipe_clean)
+{
+  log_printf(0, "lmdb_mount_db: %s uses the LMDB backend but the server was built without LMDB support\n", kgroup);
+  printf("lmdb_mount_db: %s uses the LMDB backend but the server was built without LMDB support\n", kgroup);
+  return(1);
+}
+
+#endif
@@ -0,0 +1,32 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// db_lmdb - LMDB allocation metadata backend.  All the indices
+//    live in a single memory mapped file and are updated in the
+//    same transaction as the allocation so the store is always
+//    consistent after a crash.  If LMDB isn't available mounting
+//    fails.
+//*****************************************************************
+
+#ifndef _DB_LMDB_H_
+#define _DB_LMDB_H_
+
+#include "db_resource.h"
+
+int lmdb_mount_db(tbx_inip_file_t *kf, const char *kgroup, DB_resource_t *dbr, int wipe_clean);
+
+#endif
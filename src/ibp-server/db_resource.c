@@ -37,16 +37,12 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <signal.h>
-
-#define DB_INDEX_ID     0
-#define DB_INDEX_READ   1
-#define DB_INDEX_WRITE  2
-#define DB_INDEX_MANAGE 3
-#define DB_INDEX_EXPIRE 4
-#define DB_INDEX_SOFT   5
+#include "db_lmdb.h"
 
 apr_thread_mutex_t *dbr_mutex = NULL;  //** Only used if testing a common lock
 
+static DB_md_fn_t bdb_fn;
+
 #define db_txn(str, err)       \
   DB_TXN  *txn = NULL;                \
   err = dbr->dbenv->txn_begin(dbr->dbenv, NULL, &txn, 0); \
@@ -226,7 +222,10 @@ int print_db_resource(char *buffer, int *used, int nbytes, DB_resource_t *dbr)
 {
   int i;
   tbx_append_printf(buffer, used, nbytes, "[%s]\n", dbr->kgroup);
-  i = tbx_append_printf(buffer, used, nbytes, "loc = %s\n", dbr->loc);
+  tbx_append_printf(buffer, used, nbytes, "loc = %s\n", dbr->loc);
+  tbx_append_printf(buffer, used, nbytes, "backend = %s\n", dbr->backend);
+  tbx_append_printf(buffer, used, nbytes, "group_commit_max_batch = %d\n", dbr->gc.max_batch);
+  i = tbx_append_printf(buffer, used, nbytes, "group_commit_max_latency_us = " TT "\n", dbr->gc.max_latency);
 
   return(i);   
 }
@@ -323,6 +322,10 @@ int mkfs_db(DB_resource_t *dbres, char *loc, const char *kgroup, FILE *fd) {
    //*** Lastly add the group to the Key file ***
    dbres->loc = strdup(loc);
    dbres->kgroup = strdup(kgroup);
+   dbres->backend = strdup(DBR_BACKEND_BDB);
+   dbres->fn = &bdb_fn;
+   dbres->gc.max_batch = DBR_GC_MAX_BATCH;   //** So the defaults land in the key file
+   dbres->gc.max_latency = DBR_GC_MAX_LATENCY;
 
    //** and make the mutex
    apr_pool_create(&(dbres->pool), NULL);
@@ -336,11 +339,199 @@ int mkfs_db(DB_resource_t *dbres, char *loc, const char *kgroup, FILE *fd) {
 }
 
 //***************************************************************************
-// mount_db_generic - Mounts a DB for use using the keyfile for the location
-//    and optionally wipes the data files
+// _gc_apply_batch - Applies the batch of mutations in a single transaction.
+//    The transaction is retried if we get caught in a deadlock.
+//    NOTE: dbr_lock should be held by the calling thread
 //***************************************************************************
 
-int mount_db_generic(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *env, DB_resource_t *dbres, int wipe_clean)
+int _gc_apply_batch(DB_resource_t *dbr, DB_gc_op_t *batch)
+{
+  void *txn;
+  DB_gc_op_t *op;
+  int err, retry;
+
+  for (retry=0; retry<10; retry++) {
+     txn = NULL;
+     err = dbr->fn->txn_begin(dbr, &txn);
+     if (err != 0) {
+        log_printf(0, "Transaction begin failed with err %d\n", err);
+        break;
+     }
+
+     for (op = batch; op != NULL; op = op->next) {
+        if (op->op == DBR_GC_PUT) {
+           op->err = _put_alloc_txn_db(dbr, txn, op->a);
+        } else {
+           op->err = _remove_alloc_txn_db(dbr, txn, op->a);
+        }
+        if (op->err == DB_LOCK_DEADLOCK) break;
+     }
+
+     if (op != NULL) {  //** Deadlocked so abort and try again
+        log_printf(1, "Deadlock applying batch.  retry=%d\n", retry);
+        dbr->fn->txn_abort(dbr, txn);
+        err = DB_LOCK_DEADLOCK;
+        continue;
+     }
+
+     err = dbr->fn->txn_commit(dbr, txn);  //** This is the only log flush for the whole batch
+     if (err != 0) log_printf(0, "Transaction commit failed with err %d\n", err);
+     break;
+  }
+
+  if (err != 0) {
+     for (op = batch; op != NULL; op = op->next) {
+        if (op->err == 0) op->err = err;
+     }
+  }
+
+  return(err);
+}
+
+//***************************************************************************
+// db_group_commit_thread - Collects queued mutations into batches and
+//    commits them
+//***************************************************************************
+
+void *db_group_commit_thread(apr_thread_t *th, void *data)
+{
+  DB_resource_t *dbr = (DB_resource_t *)data;
+  DB_group_commit_t *gc = &(dbr->gc);
+  DB_gc_op_t *batch, *last, *op;
+  apr_time_t start, dt;
+  int n;
+
+  apr_thread_mutex_lock(gc->lock);
+  while ((gc->shutdown == 0) || (gc->head != NULL)) {
+     if (gc->head == NULL) {
+        apr_thread_cond_wait(gc->cond, gc->lock);
+        continue;
+     }
+
+     //** Give the batch a chance to fill up
+     start = apr_time_now();
+     while ((gc->n_queued < gc->max_batch) && (gc->shutdown == 0)) {
+        dt = gc->max_latency - (apr_time_now() - start);
+        if (dt <= 0) break;
+        apr_thread_cond_timedwait(gc->cond, gc->lock, dt);
+     }
+
+     //** Pull off the batch
+     batch = gc->head;
+     last = batch;
+     for (n=1; (n < gc->max_batch) && (last->next != NULL); n++) last = last->next;
+     gc->head = last->next;
+     if (gc->head == NULL) gc->tail = NULL;
+     last->next = NULL;
+     gc->n_queued -= n;
+     apr_thread_mutex_unlock(gc->lock);
+
+     dbr_lock(dbr);
+     _gc_apply_batch(dbr, batch);
+     dbr_unlock(dbr);
+
+     log_printf(10, "committed batch of %d\n", n);
+
+     apr_thread_mutex_lock(gc->lock);
+     for (op = batch; op != NULL; op = op->next) op->done = 1;
+     gc->n_batches++;
+     gc->n_ops += n;
+     apr_thread_cond_broadcast(gc->done_cond);
+  }
+  apr_thread_mutex_unlock(gc->lock);
+
+  return(NULL);
+}
+
+//***************************************************************************
+// _gc_submit_db - Queues the mutation for the next group commit and waits
+//    for it to complete.  Returns the DB error for the mutation.
+//    NOTE: dbr_lock must NOT be held by the calling thread
+//***************************************************************************
+
+int _gc_submit_db(DB_resource_t *dbr, Allocation_t *a, int op_type)
+{
+  DB_group_commit_t *gc = &(dbr->gc);
+  DB_gc_op_t op;
+
+  memset(&op, 0, sizeof(op));
+  op.a = a;
+  op.op = op_type;
+
+  apr_thread_mutex_lock(gc->lock);
+  if (gc->tail == NULL) {
+     gc->head = &op;
+  } else {
+     gc->tail->next = &op;
+  }
+  gc->tail = &op;
+  gc->n_queued++;
+  if ((gc->n_queued == 1) || (gc->n_queued >= gc->max_batch)) apr_thread_cond_signal(gc->cond);
+
+  while (op.done == 0) apr_thread_cond_wait(gc->done_cond, gc->lock);
+  apr_thread_mutex_unlock(gc->lock);
+
+  return(op.err);
+}
+
+//***************************************************************************
+// _gc_start - Loads the group commit config and starts the commit thread.
+//    The DB has to be unmounted before it's mounted again otherwise the
+//    running commit thread would be orphaned.
+//***************************************************************************
+
+void _gc_start(DB_resource_t *dbr, tbx_inip_file_t *kf, const char *kgroup)
+{
+  DB_group_commit_t *gc = &(dbr->gc);
+
+  if (gc->thread != NULL) {
+     log_printf(0, "_gc_start: %s is already mounted with a running group commit thread!\n", kgroup);
+     printf("_gc_start: %s is already mounted with a running group commit thread!\n", kgroup);
+     abort();
+  }
+
+  memset(gc, 0, sizeof(DB_group_commit_t));
+  gc->max_batch = tbx_inip_get_integer(kf, kgroup, "group_commit_max_batch", DBR_GC_MAX_BATCH);
+  gc->max_latency = tbx_inip_get_integer(kf, kgroup, "group_commit_max_latency_us", DBR_GC_MAX_LATENCY);
+  if (gc->max_batch <= 1) {
+     log_printf(5, "Group commit disabled for %s\n", kgroup);
+     return;
+  }
+
+  apr_thread_mutex_create(&(gc->lock), APR_THREAD_MUTEX_DEFAULT, dbr->pool);
+  apr_thread_cond_create(&(gc->cond), dbr->pool);
+  apr_thread_cond_create(&(gc->done_cond), dbr->pool);
+  apr_thread_create(&(gc->thread), NULL, db_group_commit_thread, (void *)dbr, dbr->pool);
+}
+
+//***************************************************************************
+// _gc_stop - Flushes anything queued and shuts down the commit thread
+//***************************************************************************
+
+void _gc_stop(DB_resource_t *dbr)
+{
+  DB_group_commit_t *gc = &(dbr->gc);
+  apr_status_t dummy;
+
+  if (gc->thread == NULL) return;
+
+  apr_thread_mutex_lock(gc->lock);
+  gc->shutdown = 1;
+  apr_thread_cond_signal(gc->cond);
+  apr_thread_mutex_unlock(gc->lock);
+  apr_thread_join(&dummy, gc->thread);
+
+  log_printf(5, "%s: group commit batches=" LU " ops=" LU "\n", dbr->kgroup, gc->n_batches, gc->n_ops);
+  gc->thread = NULL;
+  gc->max_batch = 0;
+}
+
+//***************************************************************************
+// bdb_mount_db - Mounts the Berkeley DB backend and optionally wipes the
+//    data files
+//***************************************************************************
+
+int bdb_mount_db(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *env, DB_resource_t *dbres, int wipe_clean)
 {
    char fname[2048];
    u_int32_t flags, bflags;
@@ -348,11 +539,6 @@ int mount_db_generic(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *env, DB_
    DB *db = NULL;
    DB_env_t *lenv;
 
-   //** Get the directory containing everything **
-   dbres->kgroup = strdup(kgroup);
-   log_printf(10, "mount_db_generic: kgroup=%s\n", kgroup); tbx_log_flush();
-   assert_result_not_null(dbres->loc = tbx_inip_get_string(kf, kgroup, "loc", NULL));
-
    log_printf(15, "mound_db_generic: wipe_clean=%d\n",wipe_clean);
 
    dbres->env = env;
@@ -468,13 +654,71 @@ int mount_db_generic(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *env, DB_
       abort();
    }
 
+   dbres->fn = &bdb_fn;
+
+   return(0);
+}
+
+//***************************************************************************
+// mount_db_generic - Mounts a DB for use using the keyfile for the location
+//     The "backend" key selects the allocation metadata store.
+//***************************************************************************
+
+int mount_db_generic(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *env, DB_resource_t *dbres, int wipe_clean)
+{
+   int err;
+
+   //** Get the directory containing everything **
+   dbres->kgroup = strdup(kgroup);
+   log_printf(10, "mount_db_generic: kgroup=%s\n", kgroup); tbx_log_flush();
+   assert_result_not_null(dbres->loc = tbx_inip_get_string(kf, kgroup, "loc", NULL));
+   dbres->backend = tbx_inip_get_string(kf, kgroup, "backend", DBR_BACKEND_BDB);
+
+   if (strcmp(dbres->backend, DBR_BACKEND_BDB) == 0) {
+      err = bdb_mount_db(kf, kgroup, env, dbres, wipe_clean);
+   } else if (strcmp(dbres->backend, DBR_BACKEND_LMDB) == 0) {
+      err = lmdb_mount_db(kf, kgroup, dbres, wipe_clean);
+   } else {
+      log_printf(0, "mount_db_generic: Unknown backend=%s for %s\n", dbres->backend, kgroup);
+      err = 1;
+   }
+
+   if (err != 0) {
+      printf("mount_db_generic: Can't mount %s with backend=%s\n", kgroup, dbres->backend);
+      return(err);
+   }
+
    //** and make the mutex
    apr_pool_create(&(dbres->pool), NULL);
    apr_thread_mutex_create(&(dbres->mutex), APR_THREAD_MUTEX_DEFAULT,dbres->pool);
 
+   //** Lastly start the group commit thread
+   _gc_start(dbres, kf, kgroup);
+
    return(0);
 }
 
+//***************************************************************************
+// crash_safe_db - Returns 1 if the configured backend keeps its indices
+//     consistent across a crash so no rebuild is needed after an unclean
+//     shutdown
+//***************************************************************************
+
+int crash_safe_db(tbx_inip_file_t *kf, const char *kgroup)
+{
+   char *backend;
+   int safe;
+
+   backend = tbx_inip_get_string(kf, kgroup, "backend", DBR_BACKEND_BDB);
+   safe = (strcmp(backend, DBR_BACKEND_LMDB) == 0) ? 1 : 0;
+   free(backend);
+
+   //** Without the sync a crash can lose committed transactions
+   if ((safe == 1) && (tbx_inip_get_integer(kf, kgroup, "lmdb_nosync", 0) != 0)) safe = 0;
+
+   return(safe);
+}
+
 //***************************************************************************
 // mount_db - Mounts a DB for use using the keyfile for the location
 //***************************************************************************
@@ -485,10 +729,10 @@ int mount_db(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *dbenv, DB_resour
 }
 
 //***************************************************************************
-// umount_db - Unmounts the given DB
+// bdb_umount - Closes the Berkeley DB files
 //***************************************************************************
 
-int umount_db(DB_resource_t *dbres)
+int bdb_umount(DB_resource_t *dbres)
 {
   int i, err, val;
 
@@ -529,11 +773,27 @@ int umount_db(DB_resource_t *dbres)
     }
   }
 
+  return(err);
+}
+
+//***************************************************************************
+// umount_db - Unmounts the given DB
+//***************************************************************************
+
+int umount_db(DB_resource_t *dbres)
+{
+  int err;
+
+  _gc_stop(dbres);  //** Flush any pending mutations before closing
+
+  err = dbres->fn->umount(dbres);
+
   apr_thread_mutex_destroy(dbres->mutex);
   apr_pool_destroy(dbres->pool);
 
   free(dbres->loc);
   free(dbres->kgroup);
+  free(dbres->backend);
 
   return(err);
 }
@@ -653,13 +913,11 @@ int close_db_env(DB_env_t *env)
 }
 
 //***************************************************************************
-// print_db - Prints the DB information out to fd.
+// bdb_print - Dumps the Berkeley DB stats
 //***************************************************************************
 
-int print_db(DB_resource_t *db, FILE *fd)
+int bdb_print(DB_resource_t *db, FILE *fd)
 {
-   fprintf(fd, "DB location: %s\n", db->loc);
-
    db->pdb->stat_print(db->pdb, 0);
    db->dbenv->stat_print(db->dbenv, DB_STAT_ALL);
 
@@ -667,24 +925,32 @@ int print_db(DB_resource_t *db, FILE *fd)
 }
 
 //***************************************************************************
-// get_num_allocations_db - Returns the number of allocations according to
-//    primary DB
+// print_db - Prints the DB information out to fd.
 //***************************************************************************
 
-int get_num_allocations_db(DB_resource_t *db)
+int print_db(DB_resource_t *db, FILE *fd)
+{
+   fprintf(fd, "DB location: %s\n", db->loc);
+   fprintf(fd, "DB backend: %s\n", db->backend);
+
+   return(db->fn->print(db, fd));
+}
+
+//***************************************************************************
+// bdb_count - Returns the number of keys in the primary DB
+//***************************************************************************
+
+int bdb_count(DB_resource_t *db)
 {
   int n, err;
   DB_HASH_STAT *dstat;
 //  u_int32_t flags = DB_FAST_STAT;
   u_int32_t flags = DB_READ_COMMITTED;
 
-  
-  dbr_lock(db);
   err = db->pdb->stat(db->pdb, NULL, (void *)&dstat, flags);   
   if (err != 0) {
      log_printf(0, "get_allocations_db:  error=%d  (%s)\n", err, db_strerror(err));
   }
-  dbr_unlock(db);
 
   n = -1;
   if (err == 0) {
@@ -696,15 +962,30 @@ int get_num_allocations_db(DB_resource_t *db)
   return(n);
 }
 
+//***************************************************************************
+// get_num_allocations_db - Returns the number of allocations according to
+//    primary DB
+//***************************************************************************
+
+int get_num_allocations_db(DB_resource_t *db)
+{
+  int n;
+
+  dbr_lock(db);
+  n = db->fn->count(db);
+  dbr_unlock(db);
+
+  return(n);
+}
+
 
 //---------------------------------------------------------------------------
 
 //***************************************************************************
-// _get_alloc_with_id_db - Returns the alloc with the given ID from the DB
-//      internal version that does no locking
+// bdb_get_id - Returns the alloc with the given ID from the primary DB
 //***************************************************************************
 
-int _get_alloc_with_id_db(DB_resource_t *dbr, osd_id_t id, Allocation_t *alloc)
+int bdb_get_id(DB_resource_t *dbr, osd_id_t id, Allocation_t *alloc)
 {
   DBT key, data;
   int err;
@@ -727,6 +1008,16 @@ int _get_alloc_with_id_db(DB_resource_t *dbr, osd_id_t id, Allocation_t *alloc)
   return(err);
 }
 
+//***************************************************************************
+// _get_alloc_with_id_db - Returns the alloc with the given ID from the DB
+//      internal version that does no locking
+//***************************************************************************
+
+int _get_alloc_with_id_db(DB_resource_t *dbr, osd_id_t id, Allocation_t *alloc)
+{
+  return(dbr->fn->get_id(dbr, id, alloc));
+}
+
 //***************************************************************************
 // get_alloc_with_id_db - Returns the alloc with the given ID from the DB
 //***************************************************************************
@@ -740,19 +1031,15 @@ int get_alloc_with_id_db(DB_resource_t *dbr, osd_id_t id, Allocation_t *alloc)
 }
 
 //***************************************************************************
-// _put_alloc_db - Stores the allocation in the DB
-//    Internal routine that performs no locking
+// bdb_put - Stores the allocation in the primary DB.  The secondaries are
+//    updated by BDB through the associate() callbacks.
 //***************************************************************************
 
-int _put_alloc_db(DB_resource_t *dbr, Allocation_t *a)
+int bdb_put(DB_resource_t *dbr, void *txn, Allocation_t *a)
 {
   int err;
   DBT key, data;
 
-
-  fill_timekey(&(a->expirekey), a->expiration, a->id);
-  if (a->reliability == ALLOC_SOFT) fill_timekey(&(a->softkey), a->expiration, a->id);
-
   memset(&key, 0, sizeof(DBT));
   memset(&data, 0, sizeof(DBT));
 
@@ -762,12 +1049,27 @@ int _put_alloc_db(DB_resource_t *dbr, Allocation_t *a)
   data.data = a;
   data.size = sizeof(Allocation_t);
 
-//db_txn("_put_alloc_db", err);
-  if ((err = dbr->pdb->put(dbr->pdb, NULL, &key, &data, 0)) != 0) {
+  if ((err = dbr->pdb->put(dbr->pdb, (DB_TXN *)txn, &key, &data, 0)) != 0) {
      log_printf(10, "put_alloc_db: Error storing primary key: %d id=" LU "\n", err, a->id);
-     return(err);
   }
-//db_commit("_put_alloc_db", err)
+
+  return(err);
+}
+
+//***************************************************************************
+// _put_alloc_txn_db - Stores the allocation in the DB as part of the given
+//    transaction.  If txn == NULL the write is auto committed.
+//    Internal routine that performs no locking
+//***************************************************************************
+
+int _put_alloc_txn_db(DB_resource_t *dbr, void *txn, Allocation_t *a)
+{
+  int err;
+
+  fill_timekey(&(a->expirekey), a->expiration, a->id);
+  if (a->reliability == ALLOC_SOFT) fill_timekey(&(a->softkey), a->expiration, a->id);
+
+  if ((err = dbr->fn->put(dbr, txn, a)) != 0) return(err);
 
   apr_time_t t = ibp2apr_time(a->expiration);
   log_printf(10, "put_alloc_db: err=%d  id=" LU ", r=%s w=%s m=%s a.size=" LU " a.max_size=" LU " expire=" TT "\n", 
@@ -776,6 +1078,16 @@ int _put_alloc_db(DB_resource_t *dbr, Allocation_t *a)
   return(0);
 }
 
+//***************************************************************************
+// _put_alloc_db - Stores the allocation in the DB
+//    Internal routine that performs no locking
+//***************************************************************************
+
+int _put_alloc_db(DB_resource_t *dbr, Allocation_t *a)
+{
+  return(_put_alloc_txn_db(dbr, NULL, a));
+}
+
 //***************************************************************************
 // put_alloc_db - Stores the allocation in the DB
 //***************************************************************************
@@ -784,6 +1096,8 @@ int put_alloc_db(DB_resource_t *dbr, Allocation_t *a)
 {
   int err;
 
+  if (dbr->gc.max_batch > 1) return(_gc_submit_db(dbr, a, DBR_GC_PUT));
+
   dbr_lock(dbr);
   err = _put_alloc_db(dbr, a);
   dbr_unlock(dbr);
@@ -800,18 +1114,69 @@ int put_alloc_db(DB_resource_t *dbr, Allocation_t *a)
 }
 
 //***************************************************************************
-// modify_alloc_iter_db - Replaces the current allocation pointed top by the iterator
+// _alloc_bulk_db - Applies the same mutation to a list of allocations using a
+//    single transaction.  Returns the 1st error encountered or 0 if all
+//    succeeded.
 //***************************************************************************
 
-int modify_alloc_iter_db(DB_iterator_t *it, Allocation_t *a)
+int _alloc_bulk_db(DB_resource_t *dbr, Allocation_t *a, int n, int op_type)
 {
-  int err;
-  DBT data;
+  DB_gc_op_t *batch;
+  int i, err;
 
-  debug_printf(10, "modify_alloc_iter_db: Start\n");
+  if (n <= 0) return(0);
 
-  fill_timekey(&(a->expirekey), a->expiration, a->id);
-  if (a->reliability == ALLOC_SOFT) fill_timekey(&(a->softkey), a->expiration, a->id);
+  tbx_type_malloc_clear(batch, DB_gc_op_t, n);
+  for (i=0; i<n; i++) {
+     batch[i].a = &(a[i]);
+     batch[i].op = op_type;
+     batch[i].next = (i < n-1) ? &(batch[i+1]) : NULL;
+  }
+
+  dbr_lock(dbr);
+  _gc_apply_batch(dbr, batch);
+  dbr_unlock(dbr);
+
+  err = 0;
+  for (i=0; i<n; i++) {
+     if (batch[i].err != 0) {
+        log_printf(0, "Error with id " LU " op=%d err=%d\n", a[i].id, op_type, batch[i].err);
+        if (err == 0) err = batch[i].err;
+     }
+  }
+
+  free(batch);
+  return(err);
+}
+
+//***************************************************************************
+// put_alloc_bulk_db - Stores a list of allocations using a single transaction.
+//    Used for bulk loading the DB during a rebuild and by the bulk commands.
+//    Returns the 1st error encountered or 0 if all the puts succeeded.
+//***************************************************************************
+
+int put_alloc_bulk_db(DB_resource_t *dbr, Allocation_t *a, int n)
+{
+  return(_alloc_bulk_db(dbr, a, n, DBR_GC_PUT));
+}
+
+//***************************************************************************
+// remove_alloc_bulk_db - Removes a list of allocations using a single transaction
+//***************************************************************************
+
+int remove_alloc_bulk_db(DB_resource_t *dbr, Allocation_t *a, int n)
+{
+  return(_alloc_bulk_db(dbr, a, n, DBR_GC_REMOVE));
+}
+
+//***************************************************************************
+// bdb_iter_modify - Replaces the record under the cursor
+//***************************************************************************
+
+int bdb_iter_modify(DB_iterator_t *it, Allocation_t *a)
+{
+  int err;
+  DBT data;
 
   memset(&data, 0, sizeof(DBT));
   data.data = a;
@@ -826,14 +1191,26 @@ int modify_alloc_iter_db(DB_iterator_t *it, Allocation_t *a)
 }
 
 //***************************************************************************
-// remove_alloc_iter_db - Removes the given key from the DB with an iter
+// modify_alloc_iter_db - Replaces the current allocation pointed top by the iterator
 //***************************************************************************
 
-int remove_alloc_iter_db(DB_iterator_t *it)
+int modify_alloc_iter_db(DB_iterator_t *it, Allocation_t *a)
 {
-  int err;
+  debug_printf(10, "modify_alloc_iter_db: Start\n");
 
-  debug_printf(10, "_remove_alloc_iter_db: Start\n");
+  fill_timekey(&(a->expirekey), a->expiration, a->id);
+  if (a->reliability == ALLOC_SOFT) fill_timekey(&(a->softkey), a->expiration, a->id);
+
+  return(it->dbr->fn->iter_modify(it, a));
+}
+
+//***************************************************************************
+// bdb_iter_remove - Removes the record under the cursor
+//***************************************************************************
+
+int bdb_iter_remove(DB_iterator_t *it)
+{
+  int err;
 
   err = it->cursor->c_del(it->cursor, 0);
   if (err != 0) {
@@ -844,10 +1221,21 @@ int remove_alloc_iter_db(DB_iterator_t *it)
 }
 
 //***************************************************************************
-// _remove_alloc_db - Removes the given key from the DB
+// remove_alloc_iter_db - Removes the given key from the DB with an iter
 //***************************************************************************
 
-int _remove_alloc_db(DB_resource_t *dbr, Allocation_t *alloc)
+int remove_alloc_iter_db(DB_iterator_t *it)
+{
+  debug_printf(10, "_remove_alloc_iter_db: Start\n");
+
+  return(it->dbr->fn->iter_remove(it));
+}
+
+//***************************************************************************
+// bdb_remove - Removes the given key from the primary DB
+//***************************************************************************
+
+int bdb_remove(DB_resource_t *dbr, void *txn, Allocation_t *alloc)
 {
   DBT key;
   int err;
@@ -856,7 +1244,7 @@ int _remove_alloc_db(DB_resource_t *dbr, Allocation_t *alloc)
   key.data = &(alloc->id);
   key.size = sizeof(osd_id_t);
 
-  err = dbr->pdb->del(dbr->pdb, NULL, &key, 0);
+  err = dbr->pdb->del(dbr->pdb, (DB_TXN *)txn, &key, 0);
   if (err != 0) {
      log_printf(0, "remove_alloc_db: %s\n", db_strerror(err));
   }
@@ -864,6 +1252,25 @@ int _remove_alloc_db(DB_resource_t *dbr, Allocation_t *alloc)
   return(err);
 }
 
+//***************************************************************************
+// _remove_alloc_txn_db - Removes the given key from the DB as part of the
+//    given transaction.  If txn == NULL the delete is auto committed.
+//***************************************************************************
+
+int _remove_alloc_txn_db(DB_resource_t *dbr, void *txn, Allocation_t *alloc)
+{
+  return(dbr->fn->remove(dbr, txn, alloc));
+}
+
+//***************************************************************************
+// _remove_alloc_db - Removes the given key from the DB
+//***************************************************************************
+
+int _remove_alloc_db(DB_resource_t *dbr, Allocation_t *alloc)
+{
+  return(_remove_alloc_txn_db(dbr, NULL, alloc));
+}
+
 //***************************************************************************
 // remove_alloc_db - Removes the given key from the DB
 //***************************************************************************
@@ -872,6 +1279,8 @@ int remove_alloc_db(DB_resource_t *dbr, Allocation_t *a)
 {
   int err;
 
+  if (dbr->gc.max_batch > 1) return(_gc_submit_db(dbr, a, DBR_GC_REMOVE));
+
   dbr_lock(dbr);
   err = _remove_alloc_db(dbr, a);
   dbr_unlock(dbr);
@@ -889,13 +1298,12 @@ int modify_alloc_db(DB_resource_t *dbr, Allocation_t *a)
 }
 
 //***************************************************************************
-// _lookup_id_with_cap_db - Looks to see if the cap is stored
+// bdb_get_cap - Returns the allocation with the given cap from the cap index
 //***************************************************************************
 
-int _lookup_id_with_cap_db(DB_resource_t *dbr, Cap_t *cap, int cap_type, osd_id_t *id, int *is_alias)
+int bdb_get_cap(DB_resource_t *dbr, int cap_type, Cap_t *cap, Allocation_t *alloc)
 {
   DBT key, data;
-  Allocation_t a;
 
   memset(&key, 0, sizeof(DBT));
   memset(&data, 0, sizeof(DBT));
@@ -903,11 +1311,22 @@ int _lookup_id_with_cap_db(DB_resource_t *dbr, Cap_t *cap, int cap_type, osd_id_
   key.data = cap->v;
   key.size = CAP_SIZE+1;
 
-  data.data = &a;
+  data.data = alloc;
   data.ulen = sizeof(Allocation_t);
   data.flags = DB_DBT_USERMEM;
 
-  int err = dbr->cap[cap_type]->get(dbr->cap[cap_type], NULL, &key, &data, 0);
+  return(dbr->cap[cap_type]->get(dbr->cap[cap_type], NULL, &key, &data, 0));
+}
+
+//***************************************************************************
+// _lookup_id_with_cap_db - Looks to see if the cap is stored
+//***************************************************************************
+
+int _lookup_id_with_cap_db(DB_resource_t *dbr, Cap_t *cap, int cap_type, osd_id_t *id, int *is_alias)
+{
+  Allocation_t a;
+
+  int err = dbr->fn->get_cap(dbr, cap_type, cap, &a);
   if (err != 0) {
      log_printf(10, "lookup_id_with_cap_db: cap=%s err = %s\n", cap->v, db_strerror(err));
      if (err != DB_NOTFOUND) {
@@ -929,24 +1348,12 @@ int _lookup_id_with_cap_db(DB_resource_t *dbr, Cap_t *cap, int cap_type, osd_id_
 
 int get_alloc_with_cap_db(DB_resource_t *dbr, int cap_type, Cap_t *cap, Allocation_t *alloc)
 {
-  DBT key, data;
-
-  memset(&key, 0, sizeof(DBT));
-  memset(&data, 0, sizeof(DBT));
-
   log_printf(10, "get_alloc_with_cap_db: cap_type=%d cap=%s\n", cap_type, cap->v);
 
-  key.data = cap->v;
-  key.size = CAP_SIZE+1;
-
-  data.data = alloc;
-  data.ulen = sizeof(Allocation_t);
-  data.flags = DB_DBT_USERMEM;
-
   dbr_lock(dbr); 
 
   log_printf(10, "get_alloc_with_cap_db:  After lock\n"); 
-  int err = dbr->cap[cap_type]->get(dbr->cap[cap_type], NULL, &key, &data, 0);
+  int err = dbr->fn->get_cap(dbr, cap_type, cap, alloc);
   if (err != 0) {
      log_printf(0, "get_alloc_with_cap_db: cap=%s err = %s\n", cap->v, db_strerror(err));
      dbr_unlock(dbr); 
@@ -963,23 +1370,20 @@ int get_alloc_with_cap_db(DB_resource_t *dbr, int cap_type, Cap_t *cap, Allocati
 }
 
 //***************************************************************************
-// create_alloc_db - Creates the different unique caps and uses the existing
-//      info already stored in the prefilled allocation to add an entry into
-//      the DB for the resource
+// _create_caps_db - Generates the different unique caps for the allocation
+//    NOTE: dbr_lock should be held by the calling thread
 //***************************************************************************
 
-int create_alloc_db(DB_resource_t *dbr, Allocation_t *a)
+void _create_caps_db(DB_resource_t *dbr, Allocation_t *a)
 {
-   int i, j, err;
+   int i, j;
    char key[CAP_SIZE], b64[CAP_SIZE+1];
 //   osd_id_t id;
 
-   dbr_lock(dbr); 
-
    for (i=0; i<3; i++) {   //** Get the differnt caps
 //==      do {
          tbx_random_get_bytes((void *)key, CAP_BITS/8);
-         err = apr_base64_encode(b64, key, CAP_BITS/8);
+         apr_base64_encode(b64, key, CAP_BITS/8);
 //         debug_printf(10, "create_alloc_db: i=%d b64 cap=%s len=" ST "\n",i, b64, strlen(b64));
          for (j=0; j<CAP_SIZE; j++) {
              if (b64[j] == '/') {
@@ -992,27 +1396,69 @@ int create_alloc_db(DB_resource_t *dbr, Allocation_t *a)
 //         free(b64);
 //===      } while (_lookup_id_with_cap_db(dbr, &(a->caps[i]), i, &id) != DB_NOTFOUND);
    }
+}
 
+//***************************************************************************
+// create_alloc_db - Creates the different unique caps and uses the existing
+//      info already stored in the prefilled allocation to add an entry into
+//      the DB for the resource
+//***************************************************************************
 
-//printf("create_alloc_db: Before put\n");
-   if ((err = _put_alloc_db(dbr, a)) != 0) {   //** Now store it in the DB
-      log_printf(0, "create_alloc_db:  Error in DB put - %s\n",db_strerror(err));
+int create_alloc_db(DB_resource_t *dbr, Allocation_t *a)
+{
+   int err;
+
+   dbr_lock(dbr); 
+
+   _create_caps_db(dbr, a);
+
+   if (dbr->gc.max_batch > 1) {  //** Don't hold the lock while waiting on the batch
+      dbr_unlock(dbr);
+      err = _gc_submit_db(dbr, a, DBR_GC_PUT);
+   } else {
+      err = _put_alloc_db(dbr, a);
+      dbr_unlock(dbr);
    }
 
-   dbr_unlock(dbr); 
+   if (err != 0) {
+      log_printf(0, "create_alloc_db:  Error in DB put - %s\n",db_strerror(err));
+   }
 
    return(err);
 }
 
 //***************************************************************************
-// db_iterator_begin - Returns an iterator to cycle through the DB
+// create_caps_db - Generates the caps for the allocation but does NOT store it.
+//      The caller is responsible for adding the allocation to the DB, normally
+//      via put_alloc_bulk_db().
+//***************************************************************************
+
+void create_caps_db(DB_resource_t *dbr, Allocation_t *a)
+{
+   dbr_lock(dbr);
+   _create_caps_db(dbr, a);
+   dbr_unlock(dbr);
+}
+
+//***************************************************************************
+// bdb_iter_begin - Returns an iterator to cycle through the given index.
+//    BDB uses page locks so the mode isn't needed.
 //***************************************************************************
 
-DB_iterator_t *db_iterator_begin(DB_resource_t *dbr, DB *db, DB_ENV *dbenv, int index)
+DB_iterator_t *bdb_iter_begin(DB_resource_t *dbr, int index, int mode)
 {
    DB_iterator_t *it;
+   DB_ENV *dbenv = dbr->dbenv;
+   DB *db;
    int err;
 
+   switch (index) {
+     case DB_INDEX_ID:     db = dbr->pdb; break;
+     case DB_INDEX_EXPIRE: db = dbr->expire; break;
+     case DB_INDEX_SOFT:   db = dbr->soft; break;
+     default:              db = dbr->cap[index - DB_INDEX_READ];
+   }
+
 //   dbr_lock(dbr);
 
    tbx_type_malloc_clear(it, DB_iterator_t, 1);
@@ -1039,10 +1485,10 @@ DB_iterator_t *db_iterator_begin(DB_resource_t *dbr, DB *db, DB_ENV *dbenv, int
 }
 
 //***************************************************************************
-// db_iterator_end - Closes an iterator
+// bdb_iter_end - Closes the cursor and commits its transaction
 //***************************************************************************
 
-int db_iterator_end(DB_iterator_t *it)
+int bdb_iter_end(DB_iterator_t *it)
 {
   int err;
 
@@ -1064,7 +1510,16 @@ int db_iterator_end(DB_iterator_t *it)
 }
 
 //***************************************************************************
-// db_iterator_next - Returns the next record from the DB in the given direction
+// db_iterator_end - Closes an iterator
+//***************************************************************************
+
+int db_iterator_end(DB_iterator_t *it)
+{
+  return(it->dbr->fn->iter_end(it));
+}
+
+//***************************************************************************
+// bdb_iter_next - Returns the next record from the DB in the given direction
 //
 //  NOTE: This actually buffers a response to get around a deadlock with the
 //        c_* commands and the normal commands which occurs if the cursor
@@ -1074,7 +1529,7 @@ int db_iterator_end(DB_iterator_t *it)
 // 
 //***************************************************************************
 
-int db_iterator_next(DB_iterator_t *it, int direction, Allocation_t *a)
+int bdb_iter_next(DB_iterator_t *it, int direction, Allocation_t *a)
 {
   DBT key, data;
   int err;
@@ -1135,15 +1590,24 @@ int db_iterator_next(DB_iterator_t *it, int direction, Allocation_t *a)
   return(0);   
 }
 
+//***************************************************************************
+// db_iterator_next - Returns the next record from the DB in the given direction
+//***************************************************************************
+
+int db_iterator_next(DB_iterator_t *it, int direction, Allocation_t *a)
+{
+  return(it->dbr->fn->iter_next(it, direction, a));
+}
+
 
 //***************************************************************************
 // expire_iterator - Returns a handle to iterate through the expire DB from
 //     oldest to newest times 
 //***************************************************************************
 
-DB_iterator_t *expire_iterator(DB_resource_t *dbr)
+DB_iterator_t *expire_iterator(DB_resource_t *dbr, int mode)
 {
-   return(db_iterator_begin(dbr, dbr->expire, dbr->dbenv, DB_INDEX_EXPIRE));
+   return(dbr->fn->iter_begin(dbr, DB_INDEX_EXPIRE, mode));
 }
 
 //***************************************************************************
@@ -1151,34 +1615,34 @@ DB_iterator_t *expire_iterator(DB_resource_t *dbr)
 //     oldest to newest times 
 //***************************************************************************
 
-DB_iterator_t *soft_iterator(DB_resource_t *dbr)
+DB_iterator_t *soft_iterator(DB_resource_t *dbr, int mode)
 {
-   return(db_iterator_begin(dbr, dbr->soft, dbr->dbenv, DB_INDEX_SOFT));
+   return(dbr->fn->iter_begin(dbr, DB_INDEX_SOFT, mode));
 }
 
 //***************************************************************************
 // id_iterator - Returns a handle to iterate through all the id's 
 //***************************************************************************
 
-DB_iterator_t *id_iterator(DB_resource_t *dbr)
+DB_iterator_t *id_iterator(DB_resource_t *dbr, int mode)
 {
-   return(db_iterator_begin(dbr, dbr->pdb, dbr->dbenv, DB_INDEX_ID));
+   return(dbr->fn->iter_begin(dbr, DB_INDEX_ID, mode));
 }
 
 //***************************************************************************
 // cap_iterator - Returns a handle to iterate through the given cp index 
 //***************************************************************************
 
-DB_iterator_t *cap_iterator(DB_resource_t *dbr, int cap_type)
+DB_iterator_t *cap_iterator(DB_resource_t *dbr, int cap_type, int mode)
 {
-   return(db_iterator_begin(dbr, dbr->cap[cap_type], dbr->dbenv, DB_INDEX_READ+cap_type));
+   return(dbr->fn->iter_begin(dbr, DB_INDEX_READ+cap_type, mode));
 }
 
 //***************************************************************************
-// set_expire_iterator - Sets the position for the hard iterator
+// bdb_iter_set_time - Positions the cursor at the 1st record >= t
 //***************************************************************************
 
-int set_expire_iterator(DB_iterator_t *dbi, ibp_time_t t, Allocation_t *a)
+int bdb_iter_set_time(DB_iterator_t *dbi, ibp_time_t t, Allocation_t *a)
 {
   int err;
   DB_timekey_t tk;
@@ -1205,4 +1669,72 @@ int set_expire_iterator(DB_iterator_t *dbi, ibp_time_t t, Allocation_t *a)
   return(0);
 }
 
+//***************************************************************************
+// set_expire_iterator - Sets the position for the hard iterator
+//***************************************************************************
+
+int set_expire_iterator(DB_iterator_t *dbi, ibp_time_t t, Allocation_t *a)
+{
+  return(dbi->dbr->fn->iter_set_time(dbi, t, a));
+}
+
+//***************************************************************************
+// bdb_txn_begin - Starts a transaction
+//***************************************************************************
+
+int bdb_txn_begin(DB_resource_t *dbr, void **txn)
+{
+  DB_TXN *t = NULL;
+  int err;
+
+  err = dbr->dbenv->txn_begin(dbr->dbenv, NULL, &t, 0);
+  if (err != 0) {
+     log_printf(0, "Transaction begin failed with err %d\n", err);
+  }
+
+  *txn = t;
+  return(err);
+}
+
+//***************************************************************************
+// bdb_txn_commit - Commits the transaction
+//***************************************************************************
+
+int bdb_txn_commit(DB_resource_t *dbr, void *txn)
+{
+  DB_TXN *t = (DB_TXN *)txn;
+
+  return(t->commit(t, 0));
+}
+
+//***************************************************************************
+// bdb_txn_abort - Aborts the transaction
+//***************************************************************************
+
+void bdb_txn_abort(DB_resource_t *dbr, void *txn)
+{
+  DB_TXN *t = (DB_TXN *)txn;
+
+  t->abort(t);
+}
+
+static DB_md_fn_t bdb_fn = {
+  .umount = bdb_umount,
+  .print = bdb_print,
+  .count = bdb_count,
+  .get_id = bdb_get_id,
+  .get_cap = bdb_get_cap,
+  .put = bdb_put,
+  .remove = bdb_remove,
+  .txn_begin = bdb_txn_begin,
+  .txn_commit = bdb_txn_commit,
+  .txn_abort = bdb_txn_abort,
+  .iter_begin = bdb_iter_begin,
+  .iter_end = bdb_iter_end,
+  .iter_next = bdb_iter_next,
+  .iter_set_time = bdb_iter_set_time,
+  .iter_modify = bdb_iter_modify,
+  .iter_remove = bdb_iter_remove
+};
+
 
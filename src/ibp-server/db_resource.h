@@ -23,7 +23,10 @@
 #include "visibility.h"
 #include <db.h>
 #include <apr_thread_mutex.h>
+#include <apr_thread_cond.h>
+#include <apr_thread_proc.h>
 #include <apr_pools.h>
+#include <stdint.h>
 #include "allocation.h"
 #include <tbx/iniparse.h>
 #include "ibp_time.h"
@@ -32,6 +35,22 @@
 #define DBR_NEXT DB_NEXT
 #define DBR_PREV DB_PREV
 
+   //** Allocation metadata backends
+#define DBR_BACKEND_BDB  "bdb"
+#define DBR_BACKEND_LMDB "lmdb"
+
+   //** Index used by an iterator
+#define DB_INDEX_ID     0
+#define DB_INDEX_READ   1
+#define DB_INDEX_WRITE  2
+#define DB_INDEX_MANAGE 3
+#define DB_INDEX_EXPIRE 4
+#define DB_INDEX_SOFT   5
+
+   //** Iterator access modes
+#define DBR_ITER_RDONLY 0   //** Walk only.  Doesn't block writers
+#define DBR_ITER_RDWR   1   //** The walk modifies or removes records
+
 #define DBR_ITER_INIT   0
 #define DBR_ITER_BUFFER 1
 #define DBR_ITER_EMPTY  2
@@ -43,9 +62,64 @@ typedef struct {
 } DB_env_t;
 
 
-typedef struct {  //Resource DB interface
+#define DBR_GC_PUT    0
+#define DBR_GC_REMOVE 1
+
+#define DBR_GC_MAX_BATCH   64   //** Default group commit batch size
+#define DBR_GC_MAX_LATENCY 0    //** Default time to wait for a batch to fill in us
+
+typedef struct DB_gc_op_s DB_gc_op_t;
+struct DB_gc_op_s {   //** Allocation mutation waiting on a group commit
+  Allocation_t *a;
+  int op;
+  int err;
+  int done;
+  DB_gc_op_t *next;
+};
+
+typedef struct {      //** Group commit state.  Mutations are batched into a single transaction
+  apr_thread_mutex_t *lock;
+  apr_thread_cond_t *cond;        //** Wakes up the commit thread
+  apr_thread_cond_t *done_cond;   //** Broadcast each time a batch completes
+  apr_thread_t *thread;
+  DB_gc_op_t *head;
+  DB_gc_op_t *tail;
+  int n_queued;
+  int max_batch;                  //** Max mutations in a single transaction.  <=1 disables batching
+  apr_interval_time_t max_latency; //** Max time to wait for a batch to fill
+  int shutdown;
+  uint64_t n_batches;
+  uint64_t n_ops;
+} DB_group_commit_t;
+
+typedef struct DB_resource_s DB_resource_t;
+typedef struct DB_iterator_s DB_iterator_t;
+
+typedef struct {  //** Allocation metadata backend.  None of these do any locking.
+    int (*umount)(DB_resource_t *dbr);
+    int (*print)(DB_resource_t *dbr, FILE *fd);
+    int (*count)(DB_resource_t *dbr);   //** Number of allocations or -1 on error
+    int (*get_id)(DB_resource_t *dbr, osd_id_t id, Allocation_t *a);
+    int (*get_cap)(DB_resource_t *dbr, int cap_type, Cap_t *cap, Allocation_t *a);
+    int (*put)(DB_resource_t *dbr, void *txn, Allocation_t *a);   //** txn == NULL means auto commit
+    int (*remove)(DB_resource_t *dbr, void *txn, Allocation_t *a);
+    int (*txn_begin)(DB_resource_t *dbr, void **txn);
+    int (*txn_commit)(DB_resource_t *dbr, void *txn);
+    void (*txn_abort)(DB_resource_t *dbr, void *txn);
+    DB_iterator_t *(*iter_begin)(DB_resource_t *dbr, int index, int mode);
+    int (*iter_end)(DB_iterator_t *it);
+    int (*iter_next)(DB_iterator_t *it, int direction, Allocation_t *a);
+    int (*iter_set_time)(DB_iterator_t *it, ibp_time_t t, Allocation_t *a);
+    int (*iter_modify)(DB_iterator_t *it, Allocation_t *a);
+    int (*iter_remove)(DB_iterator_t *it);
+} DB_md_fn_t;
+
+struct DB_resource_s {  //Resource DB interface
     char *kgroup;          //Ini file group
     char *loc;             //Directory with all the DB's in it
+    char *backend;         //Metadata backend type
+    DB_md_fn_t *fn;        //Backend implementation
+    void *priv;            //Backend private data for non-BDB backends
     DB *pdb;               //Primary DB (key=object id)
     DB *cap[3];            //Array of secondary DB holding caps
     DB *expire;            //DB with expiration as the key
@@ -54,15 +128,17 @@ typedef struct {  //Resource DB interface
     DB_ENV *dbenv;         //Common DB enviroment to use
     apr_thread_mutex_t *mutex;  // Lock used for creates
     apr_pool_t *pool;      //** Memory pool
-} DB_resource_t;
+    DB_group_commit_t gc;  //** Group commit for allocation mutations
+};
 
-typedef struct {    //Container for cursor
+struct DB_iterator_s {    //Container for cursor
     DBC *cursor;
     DB_TXN *transaction;
+    void *priv;            //Backend private cursor for non-BDB backends
     DB_resource_t *dbr;
     int db_index;
     int id;
-} DB_iterator_t;
+};
 
 void dbr_lock(DB_resource_t *dbr);
 void dbr_unlock(DB_resource_t *dbr);
@@ -71,6 +147,7 @@ int mkfs_db(DB_resource_t *dbr, char *loc, const char *kgroup, FILE *fd);
 int mount_db(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *dbenv, DB_resource_t *dbres);
 int mount_db_generic(tbx_inip_file_t *kf, const char *kgroup, DB_env_t *dbenv, DB_resource_t *dbres, int wipe_clean);
 int umount_db(DB_resource_t *dbres);
+int crash_safe_db(tbx_inip_file_t *kf, const char *kgroup);
 IBPS_API DB_env_t *create_db_env(const char *loc, int db_mem, int run_recover);
 IBPS_API int close_db_env(DB_env_t *env);
 int print_db(DB_resource_t *db, FILE *fd);
@@ -79,23 +156,31 @@ int get_alloc_with_id_db(DB_resource_t *dbr, osd_id_t id, Allocation_t *alloc);
 int _get_alloc_with_id_db(DB_resource_t *dbr, osd_id_t id, Allocation_t *alloc);
 int get_alloc_with_cap_db(DB_resource_t *dbr, int cap_type, Cap_t *cap, Allocation_t *alloc);
 int _put_alloc_db(DB_resource_t *dbr, Allocation_t *a);
+int _put_alloc_txn_db(DB_resource_t *dbr, void *txn, Allocation_t *a);
 int put_alloc_db(DB_resource_t *dbr, Allocation_t *alloc);
+int put_alloc_bulk_db(DB_resource_t *dbr, Allocation_t *a, int n);
+int remove_alloc_bulk_db(DB_resource_t *dbr, Allocation_t *a, int n);
 int remove_id_only_db(DB_resource_t *dbr, osd_id_t id);
 int remove_alloc_db(DB_resource_t *dbr, Allocation_t *alloc);
+int _remove_alloc_db(DB_resource_t *dbr, Allocation_t *alloc);
+int _remove_alloc_txn_db(DB_resource_t *dbr, void *txn, Allocation_t *alloc);
+int _gc_submit_db(DB_resource_t *dbr, Allocation_t *a, int op_type);
 int remove_alloc_iter_db(DB_iterator_t *it);
 int modify_alloc_iter_db(DB_iterator_t *it, Allocation_t *a);
 int modify_alloc_db(DB_resource_t *dbr, Allocation_t *a);
 int create_alloc_db(DB_resource_t *dbr, Allocation_t *alloc);
+void create_caps_db(DB_resource_t *dbr, Allocation_t *a);
 
 //DB_iterator_t *db_iterator_begin(DB *db);
 int _id_iter_put_alloc_db(DB_iterator_t *it, Allocation_t *a);
 int db_iterator_end(DB_iterator_t *it);
 int db_iterator_next(DB_iterator_t *it, int direction, Allocation_t *a);
-DB_iterator_t *expire_iterator(DB_resource_t *dbr);
-DB_iterator_t *soft_iterator(DB_resource_t *dbr);
-DB_iterator_t *id_iterator(DB_resource_t *dbr);
-DB_iterator_t *cap_iterator(DB_resource_t *dbr, int cap_type);
+DB_iterator_t *expire_iterator(DB_resource_t *dbr, int mode);
+DB_iterator_t *soft_iterator(DB_resource_t *dbr, int mode);
+DB_iterator_t *id_iterator(DB_resource_t *dbr, int mode);
+DB_iterator_t *cap_iterator(DB_resource_t *dbr, int cap_type, int mode);
 int set_expire_iterator(DB_iterator_t *dbi, ibp_time_t t, Allocation_t *a);
+DB_timekey_t *fill_timekey(DB_timekey_t *tk, ibp_time_t t, osd_id_t id);
 
 #endif
 
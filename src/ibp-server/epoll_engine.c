@@ -0,0 +1,458 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// epoll_engine - Event driven connection handling.  Instead of a
+//    thread per connection idle connections are parked in an epoll
+//    set monitored by a single poller thread.  When a command arrives
+//    the connection is handed to a fixed pool of worker threads which
+//    parse and execute it, including any bulk transfer, and then
+//    park the connection again.
+//*****************************************************************
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <apr_time.h>
+#include <apr_thread_proc.h>
+#include <apr_thread_mutex.h>
+#include <tbx/log.h>
+#include <tbx/network.h>
+#include <tbx/que.h>
+#include <tbx/stack.h>
+#include <tbx/type_malloc.h>
+#include "ibp_server.h"
+#include "debug.h"
+#include "activity_log.h"
+#include "subnet.h"
+
+#define EE_MAX_EVENTS 256      //** Max events processed per epoll_wait() call
+#define EE_WAIT_MS    1000     //** Poller wakeup interval for idle sweeps and shutdown checks
+
+#define EC_PARKED 0   //** Idle connection monitored by the poller
+#define EC_ACTIVE 1   //** Connection owned by a worker thread
+
+#define EE_RUNNING   0   //** Normal operation
+#define EE_STOPPING  1   //** No more connections can be parked
+#define EE_DRAINING  2   //** Poller has exited. Workers exit once the ready queue is empty
+
+typedef struct {         //** Per connection state.  Kept small since there can be 10k's of them
+  tbx_ns_t *ns;          //** Network connection
+  int fd;                //** Native socket used for epoll
+  int myid;              //** Thread slot.  Also the index in the connection table
+  int state;             //** EC_PARKED or EC_ACTIVE
+  int registered;        //** Set once the fd has been added to the epoll set
+  int ncommands;         //** Number of commands processed
+  apr_time_t last_used;  //** When the connection was last parked
+  Allocation_address_t ipadd;  //** Used for updating allocations
+  int command_acl[COMMAND_TABLE_MAX+1];  //** ACL's for commands based on ns
+} econn_t;
+
+typedef struct {
+  int epfd;                  //** epoll handle
+  int n_workers;             //** Number of worker threads
+  int n_slots;               //** Size of the connection table
+  int n_parked;              //** Number of idle connections being monitored
+  int state;                 //** EE_RUNNING, EE_STOPPING, or EE_DRAINING
+  econn_t **conn;            //** Connection table indexed by thread slot
+  tbx_que_t *ready;          //** Connections with a pending command
+  apr_thread_t *poller;      //** Poller thread
+  apr_thread_t **worker;     //** Worker threads
+  apr_thread_mutex_t *lock;  //** Protects the connection table and states
+  apr_pool_t *mpool;
+} epoll_engine_t;
+
+epoll_engine_t *_ee = NULL;
+
+//*****************************************************************
+// _ee_close - Closes the connection and releases its resources
+//*****************************************************************
+
+void _ee_close(econn_t *c)
+{
+  log_printf(10, "_ee_close: ns=%d myid=%d ncommands=%d\n", tbx_ns_getid(c->ns), c->myid, c->ncommands);
+
+  if (c->registered == 1) epoll_ctl(_ee->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+
+  alog_append_thread_close(c->myid, c->ncommands);
+
+  apr_thread_mutex_lock(_ee->lock);
+  _ee->conn[c->myid] = NULL;
+  apr_thread_mutex_unlock(_ee->lock);
+
+  release_thread_slot(c->myid);
+
+  //** Notify the client why I'm closing.  IF already closed this just returns
+  //** A binary protocol client can't parse it and the executors may still be sending replies
+  if (proto_v2_active(c->ns) == 0) reject_close(c->ns);
+
+  tbx_ns_close(c->ns);
+  tbx_ns_destroy(c->ns);
+  free(c);
+
+  release_connection();
+}
+
+//*****************************************************************
+// _ee_park - Adds the connection back to the epoll set to wait for
+//    the next command.  EPOLLONESHOT guarantees only a single worker
+//    is ever handed the connection.
+//*****************************************************************
+
+void _ee_park(econn_t *c)
+{
+  struct epoll_event ev;
+  int err;
+
+  apr_thread_mutex_lock(_ee->lock);
+  if (_ee->state != EE_RUNNING) {  //** Shutting down so just close it
+     apr_thread_mutex_unlock(_ee->lock);
+     _ee_close(c);
+     return;
+  }
+
+  c->state = EC_PARKED;
+  c->last_used = apr_time_now();
+  _ee->n_parked++;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+  ev.data.ptr = c;
+  err = epoll_ctl(_ee->epfd, ((c->registered == 1) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD), c->fd, &ev);
+  if (err != 0) {
+     c->state = EC_ACTIVE;
+     _ee->n_parked--;
+  } else {
+     c->registered = 1;
+  }
+  apr_thread_mutex_unlock(_ee->lock);
+
+  if (err != 0) {
+     log_printf(0, "_ee_park: ERROR epoll_ctl failed! ns=%d fd=%d errno=%d\n", tbx_ns_getid(c->ns), c->fd, errno);
+     _ee_close(c);
+  }
+}
+
+//*****************************************************************
+// _ee_process - Processes all the commands currently available on
+//    the connection and then parks it or closes it.  Connections using
+//    the binary protocol just have their requests handed off to the
+//    protocol's executors.
+//*****************************************************************
+
+void _ee_process(econn_t *c)
+{
+  ibp_task_t task;
+  int closed, status;
+
+  task.tid = 0;
+  task.ns = c->ns;
+  task.net = global_network;
+  task.myid = c->myid;
+  task.ipadd = c->ipadd;
+  memcpy(task.command_acl, c->command_acl, sizeof(task.command_acl));
+
+  //** Keep going as long as the client has pipelined commands in the ns buffer since epoll
+  //** only knows about data still sitting in the socket
+  closed = 0;
+  if (proto_v2_active(c->ns) == 1) {
+     closed = proto_v2_process(c->ns);
+  } else {
+     do {
+        tbx_ns_chksum_read_clear(task.ns);
+        tbx_ns_chksum_write_clear(task.ns);
+
+        status = read_command(&task);
+        if (status == 0) {
+           c->ncommands++;
+           closed = handle_task(&task);
+        } else if (status == -1) {
+           closed = 1;
+        }
+     } while ((closed == 0) && (proto_v2_active(c->ns) == 0) && (tbx_ns_read_pending(c->ns) > 0) && (shutdown_request() == 0));
+  }
+
+  log_printf(10, "_ee_process: ns=%d myid=%d ncommands=%d closed=%d\n", tbx_ns_getid(c->ns), c->myid, c->ncommands, closed);
+
+  if ((closed != 0) || (shutdown_request() != 0)) {
+     _ee_close(c);
+  } else {
+     _ee_park(c);
+  }
+}
+
+//*****************************************************************
+// _ee_sweep - Closes idle connections that have exceeded min_idle.
+//    If close_all=1 then all parked connections are closed.  If the
+//    depot is rejecting connections the longest idle one is also
+//    dropped to make room.  Binary protocol connections with requests
+//    still executing aren't idle.
+//*****************************************************************
+
+void _ee_sweep(int close_all)
+{
+  tbx_stack_t *stack;
+  econn_t *c, *oldest;
+  apr_time_t cutoff;
+  int i;
+
+  stack = tbx_stack_new();
+  cutoff = apr_time_now() - global_config->server.min_idle;
+  oldest = NULL;
+
+  apr_thread_mutex_lock(_ee->lock);
+  for (i=0; i<_ee->n_slots; i++) {
+     c = _ee->conn[i];
+     if ((c == NULL) || (c->state != EC_PARKED)) continue;
+     if ((close_all == 0) && (proto_v2_busy(c->ns) == 1)) continue;
+
+     if ((close_all == 1) || (c->last_used < cutoff)) {
+        c->state = EC_ACTIVE;
+        _ee->n_parked--;
+        tbx_stack_push(stack, c);
+     } else if ((oldest == NULL) || (c->last_used < oldest->last_used)) {
+        oldest = c;
+     }
+  }
+
+  if ((oldest != NULL) && (request_task_close() == 1)) {
+     oldest->state = EC_ACTIVE;
+     _ee->n_parked--;
+     tbx_stack_push(stack, oldest);
+  }
+  apr_thread_mutex_unlock(_ee->lock);
+
+  log_printf(10, "_ee_sweep: close_all=%d nclosing=%d\n", close_all, tbx_stack_count(stack));
+
+  while ((c = tbx_stack_pop(stack)) != NULL) {
+     _ee_close(c);
+  }
+
+  tbx_stack_free(stack, 0);
+}
+
+//*****************************************************************
+// _ee_poller_thread - Waits for activity on the parked connections
+//    and hands them off to the workers
+//*****************************************************************
+
+void *_ee_poller_thread(apr_thread_t *th, void *arg)
+{
+  struct epoll_event events[EE_MAX_EVENTS];
+  econn_t *c;
+  apr_time_t next_sweep;
+  int i, n, dispatch, state;
+
+  next_sweep = apr_time_now() + apr_time_from_sec(1);
+
+  do {
+     n = epoll_wait(_ee->epfd, events, EE_MAX_EVENTS, EE_WAIT_MS);
+     for (i=0; i<n; i++) {
+        c = (econn_t *)events[i].data.ptr;
+
+        apr_thread_mutex_lock(_ee->lock);
+        dispatch = 0;
+        if (c->state == EC_PARKED) {
+           c->state = EC_ACTIVE;
+           _ee->n_parked--;
+           dispatch = 1;
+        }
+        apr_thread_mutex_unlock(_ee->lock);
+
+        if (dispatch == 1) tbx_que_put(_ee->ready, &c, TBX_QUE_BLOCK);
+     }
+
+     if (apr_time_now() > next_sweep) {
+        _ee_sweep(0);
+        next_sweep = apr_time_now() + apr_time_from_sec(1);
+     }
+
+     apr_thread_mutex_lock(_ee->lock);
+     state = _ee->state;
+     apr_thread_mutex_unlock(_ee->lock);
+  } while (state == EE_RUNNING);
+
+  _ee_sweep(1);  //** Close everything still parked
+
+  apr_thread_exit(th, 0);
+  return(NULL);
+}
+
+//*****************************************************************
+// _ee_worker_thread - Processes connections with pending commands
+//*****************************************************************
+
+void *_ee_worker_thread(apr_thread_t *th, void *arg)
+{
+  econn_t *c;
+  int state;
+
+  while (1) {
+     if (tbx_que_get(_ee->ready, &c, apr_time_from_sec(1)) == 0) {
+        _ee_process(c);
+        continue;
+     }
+
+     apr_thread_mutex_lock(_ee->lock);
+     state = _ee->state;
+     apr_thread_mutex_unlock(_ee->lock);
+     if (state == EE_DRAINING) break;
+  }
+
+  apr_thread_exit(th, 0);
+  return(NULL);
+}
+
+//*****************************************************************
+// epoll_engine_add - Adds a newly accepted connection to the engine
+//*****************************************************************
+
+void epoll_engine_add(tbx_ns_t *ns, int reject_connection)
+{
+  econn_t *c;
+  int myid;
+
+  if (reject_connection > 0) {  //** Rejecting the connection
+     reject_task(ns, 1);
+     return;
+  }
+
+  myid = reserve_thread_slot();
+  if (myid == -1) {
+     log_printf(0, "epoll_engine_add: ERROR no free thread slots! ns=%d\n", tbx_ns_getid(ns));
+     reject_task(ns, 1);
+     return;
+  }
+
+  tbx_type_malloc_clear(c, econn_t, 1);
+  c->ns = ns;
+  c->fd = tbx_ns_native_fd_get(ns);
+  c->myid = myid;
+  c->state = EC_ACTIVE;
+  c->ipadd.atype = AF_INET;
+  ipdecstr2address(tbx_ns_peer_address_get(ns), c->ipadd.ip);
+  generate_command_acl(tbx_ns_peer_address_get(ns), c->command_acl);
+
+  reserve_connection();
+
+  log_printf(10, "epoll_engine_add: ns=%d myid=%d fd=%d\n", tbx_ns_getid(ns), myid, c->fd);
+  alog_append_thread_open(myid, tbx_ns_getid(ns), c->ipadd.atype, c->ipadd.ip);
+
+  apr_thread_mutex_lock(_ee->lock);
+  _ee->conn[myid] = c;
+  apr_thread_mutex_unlock(_ee->lock);
+
+  if (c->fd == -1) {  //** Can't be monitored with epoll
+     log_printf(0, "epoll_engine_add: ERROR no native fd! ns=%d\n", tbx_ns_getid(ns));
+     _ee_close(c);
+     return;
+  }
+
+  _ee_park(c);
+}
+
+//*****************************************************************
+// epoll_engine_parked - Returns the number of idle connections
+//*****************************************************************
+
+int epoll_engine_parked()
+{
+  int n;
+
+  if (_ee == NULL) return(0);
+
+  apr_thread_mutex_lock(_ee->lock);
+  n = _ee->n_parked;
+  apr_thread_mutex_unlock(_ee->lock);
+
+  return(n);
+}
+
+//*****************************************************************
+// epoll_engine_start - Creates the epoll set and launches the poller
+//    and worker threads
+//*****************************************************************
+
+void epoll_engine_start(Config_t *cfg)
+{
+  apr_threadattr_t *attr;
+  int i;
+
+  tbx_type_malloc_clear(_ee, epoll_engine_t, 1);
+
+  _ee->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (_ee->epfd == -1) {
+     log_printf(0, "epoll_engine_start: ERROR creating epoll handle! errno=%d\n", errno);
+     abort();
+  }
+
+  _ee->n_workers = cfg->server.max_threads;
+  _ee->n_slots = task_slot_count(cfg);
+  _ee->state = EE_RUNNING;
+  tbx_type_malloc_clear(_ee->conn, econn_t *, _ee->n_slots);
+  tbx_type_malloc_clear(_ee->worker, apr_thread_t *, _ee->n_workers);
+  _ee->ready = tbx_que_create(_ee->n_slots, sizeof(econn_t *));
+
+  apr_pool_create(&(_ee->mpool), NULL);
+  apr_thread_mutex_create(&(_ee->lock), APR_THREAD_MUTEX_DEFAULT, _ee->mpool);
+
+  //** Workers run the commands so they get the same stack as the per connection threads
+  apr_threadattr_create(&attr, _ee->mpool);
+  apr_threadattr_stacksize_set(attr, 4*1024*1024);
+
+  log_printf(0, "epoll_engine_start: n_workers=%d max_connections=%d\n", _ee->n_workers, cfg->server.max_connections);
+
+  for (i=0; i<_ee->n_workers; i++) {
+     apr_thread_create(&(_ee->worker[i]), attr, _ee_worker_thread, NULL, _ee->mpool);
+  }
+  apr_thread_create(&(_ee->poller), NULL, _ee_poller_thread, NULL, _ee->mpool);
+}
+
+//*****************************************************************
+// epoll_engine_stop - Shuts down the engine.  Parked connections are
+//    closed and active ones are closed once their command completes.
+//*****************************************************************
+
+void epoll_engine_stop()
+{
+  apr_status_t dummy;
+  int i;
+
+  apr_thread_mutex_lock(_ee->lock);
+  _ee->state = EE_STOPPING;
+  apr_thread_mutex_unlock(_ee->lock);
+
+  apr_thread_join(&dummy, _ee->poller);
+
+  apr_thread_mutex_lock(_ee->lock);
+  _ee->state = EE_DRAINING;
+  apr_thread_mutex_unlock(_ee->lock);
+
+  for (i=0; i<_ee->n_workers; i++) {
+     apr_thread_join(&dummy, _ee->worker[i]);
+  }
+
+  close(_ee->epfd);
+  tbx_que_destroy(_ee->ready);
+  apr_thread_mutex_destroy(_ee->lock);
+  apr_pool_destroy(_ee->mpool);
+  free(_ee->worker);
+  free(_ee->conn);
+  free(_ee);
+  _ee = NULL;
+}
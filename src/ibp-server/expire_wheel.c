@@ -0,0 +1,234 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// expire_wheel - Hierarchical timing wheel with 1 second resolution.
+//
+//    Each level has EW_SLOTS slots covering EW_SLOTS times the span of
+//    the level below.  An entry is placed in the lowest level that can
+//    reach it and is moved down a level each time the level above
+//    rolls over onto its slot.  Entries whose time has passed sit on
+//    the due list until the caller picks them up so the work done per
+//    call is bounded regardless of how many come due at once.
+//*****************************************************************
+
+#include <string.h>
+#include <stdlib.h>
+#include <apr_thread_mutex.h>
+#include <apr_pools.h>
+#include <tbx/assert_result.h>
+#include <tbx/type_malloc.h>
+#include "expire_wheel.h"
+
+#define EW_BITS   8
+#define EW_SLOTS  (1<<EW_BITS)
+#define EW_MASK   (EW_SLOTS-1)
+#define EW_LEVELS 4
+
+typedef struct {
+   expire_wheel_entry_t *e;
+   int n;
+   int max;
+} ew_slot_t;
+
+struct expire_wheel_s {
+   apr_pool_t *mpool;
+   apr_thread_mutex_t *lock;
+   ibp_time_t now;                          //** Time the wheel has been advanced to
+   ew_slot_t level[EW_LEVELS][EW_SLOTS];
+   ew_slot_t due;                           //** Entries that have come due
+   int due_start;                           //** 1st due entry not handed out yet
+   int64_t n;                               //** Total number of entries
+};
+
+//*****************************************************************
+// _ew_push - Appends an entry to the slot
+//*****************************************************************
+
+void _ew_push(ew_slot_t *s, expire_wheel_entry_t *e)
+{
+   if (s->n == s->max) {
+      s->max = (s->max == 0) ? 16 : 2*s->max;
+      s->e = realloc(s->e, sizeof(expire_wheel_entry_t)*s->max);
+      assert_result_not_null(s->e);
+   }
+
+   s->e[s->n] = *e;
+   s->n++;
+}
+
+//*****************************************************************
+// _ew_insert - Places the entry in the right level and slot
+//*****************************************************************
+
+void _ew_insert(expire_wheel_t *w, expire_wheel_entry_t *e)
+{
+   ibp_time_t delta;
+   int l;
+
+   if (e->when <= w->now) {
+      _ew_push(&(w->due), e);
+      return;
+   }
+
+   delta = e->when - w->now;
+   for (l=0; l<EW_LEVELS-1; l++) {
+      if (delta < ((ibp_time_t)1 << (EW_BITS*(l+1)))) break;
+   }
+
+   _ew_push(&(w->level[l][(e->when >> (EW_BITS*l)) & EW_MASK]), e);
+}
+
+//*****************************************************************
+// _ew_cascade - Redistributes a slot's entries to the lower levels
+//*****************************************************************
+
+void _ew_cascade(expire_wheel_t *w, int l, int slot)
+{
+   ew_slot_t s;
+   int i;
+
+   s = w->level[l][slot];
+   memset(&(w->level[l][slot]), 0, sizeof(ew_slot_t));
+
+   for (i=0; i<s.n; i++) {
+      _ew_insert(w, &(s.e[i]));
+   }
+
+   if (s.e != NULL) free(s.e);
+}
+
+//*****************************************************************
+// _ew_advance - Moves the wheel forward to the given time
+//*****************************************************************
+
+void _ew_advance(expire_wheel_t *w, ibp_time_t now)
+{
+   ibp_time_t t;
+   int l;
+
+   while (w->now < now) {
+      w->now++;
+      t = w->now;
+
+      //** Cascade the higher levels first so their entries land in the right spot below
+      for (l=EW_LEVELS-1; l>0; l--) {
+         if ((t & (((ibp_time_t)1 << (EW_BITS*l)) - 1)) == 0) _ew_cascade(w, l, (t >> (EW_BITS*l)) & EW_MASK);
+      }
+
+      _ew_cascade(w, 0, t & EW_MASK);
+   }
+}
+
+//*****************************************************************
+// expire_wheel_add - Adds an entry to the wheel
+//*****************************************************************
+
+void expire_wheel_add(expire_wheel_t *w, expire_wheel_entry_t *e)
+{
+   apr_thread_mutex_lock(w->lock);
+   _ew_insert(w, e);
+   w->n++;
+   apr_thread_mutex_unlock(w->lock);
+}
+
+//*****************************************************************
+// expire_wheel_due - Returns up to max_entries entries that are due as
+//     of now.  If lag is provided it's set to how long the oldest
+//     entry still waiting on the due list has been due.
+//*****************************************************************
+
+int expire_wheel_due(expire_wheel_t *w, ibp_time_t now, expire_wheel_entry_t *e, int max_entries, ibp_time_t *lag)
+{
+   int n;
+
+   apr_thread_mutex_lock(w->lock);
+
+   _ew_advance(w, now);
+
+   n = w->due.n - w->due_start;
+   if (n > max_entries) n = max_entries;
+   if (n > 0) memcpy(e, &(w->due.e[w->due_start]), sizeof(expire_wheel_entry_t)*n);
+   w->due_start += n;
+   w->n -= n;
+
+   if (lag != NULL) *lag = (w->due_start < w->due.n) ? now - w->due.e[w->due_start].when : 0;
+
+   //** Reclaim the space once everything has been handed out
+   if (w->due_start == w->due.n) {
+      w->due.n = 0;
+      w->due_start = 0;
+   } else if (w->due_start > (w->due.n/2)) {
+      memmove(w->due.e, &(w->due.e[w->due_start]), sizeof(expire_wheel_entry_t)*(w->due.n - w->due_start));
+      w->due.n -= w->due_start;
+      w->due_start = 0;
+   }
+
+   apr_thread_mutex_unlock(w->lock);
+
+   return(n);
+}
+
+//*****************************************************************
+// expire_wheel_count - Returns the number of entries in the wheel
+//*****************************************************************
+
+int64_t expire_wheel_count(expire_wheel_t *w)
+{
+   int64_t n;
+
+   apr_thread_mutex_lock(w->lock);
+   n = w->n;
+   apr_thread_mutex_unlock(w->lock);
+
+   return(n);
+}
+
+//*****************************************************************
+// expire_wheel_create - Creates an empty wheel starting at the given time
+//*****************************************************************
+
+expire_wheel_t *expire_wheel_create(ibp_time_t now)
+{
+   expire_wheel_t *w;
+
+   tbx_type_malloc_clear(w, expire_wheel_t, 1);
+   apr_pool_create(&(w->mpool), NULL);
+   apr_thread_mutex_create(&(w->lock), APR_THREAD_MUTEX_DEFAULT, w->mpool);
+   w->now = now;
+
+   return(w);
+}
+
+//*****************************************************************
+// expire_wheel_destroy - Destroys the wheel
+//*****************************************************************
+
+void expire_wheel_destroy(expire_wheel_t *w)
+{
+   int l, i;
+
+   for (l=0; l<EW_LEVELS; l++) {
+      for (i=0; i<EW_SLOTS; i++) {
+         if (w->level[l][i].e != NULL) free(w->level[l][i].e);
+      }
+   }
+   if (w->due.e != NULL) free(w->due.e);
+
+   apr_thread_mutex_destroy(w->lock);
+   apr_pool_destroy(w->mpool);
+   free(w);
+}
@@ -0,0 +1,50 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// expire_wheel - Hierarchical timing wheel used to drive allocation
+//    expiration and trash purging incrementally instead of walking
+//    the expire index and trash directories.  Entries aren't indexed
+//    so a change in expiration just adds another entry.  The caller
+//    is expected to validate each entry as it comes due.
+//*****************************************************************
+
+#ifndef _EXPIRE_WHEEL_H_
+#define _EXPIRE_WHEEL_H_
+
+#include "osd_abstract.h"
+#include "ibp_time.h"
+
+#define EW_ALLOC        0     //** Allocation expiration
+#define EW_TRASH_DELETE 1     //** Purge from the deleted trash
+#define EW_TRASH_EXPIRE 2     //** Purge from the expired trash
+
+typedef struct {
+   osd_id_t id;
+   ibp_time_t when;     //** Time the entry comes due
+   ibp_time_t stamp;    //** Time it was moved to the trash.  Unused for allocations
+   int kind;            //** One of EW_*
+} expire_wheel_entry_t;
+
+typedef struct expire_wheel_s expire_wheel_t;
+
+expire_wheel_t *expire_wheel_create(ibp_time_t now);
+void expire_wheel_destroy(expire_wheel_t *w);
+void expire_wheel_add(expire_wheel_t *w, expire_wheel_entry_t *e);
+int expire_wheel_due(expire_wheel_t *w, ibp_time_t now, expire_wheel_entry_t *e, int max_entries, ibp_time_t *lag);
+int64_t expire_wheel_count(expire_wheel_t *w);
+
+#endif
@@ -190,6 +190,105 @@ int handle_allocate(ibp_task_t *task)
    return(err);
 }
 
+//*****************************************************************
+// handle_bulk_allocate - Processes the bulk allocate command.  All the
+//    allocations are added to the DB using a single transaction and
+//    either all of them are created or none are.
+//
+// Results:
+//    status n
+//    readCap writeCap manageCap     (Repeated n times)
+//*****************************************************************
+
+int handle_bulk_allocate(ibp_task_t *task)
+{
+   int i, d, err, len, used, max_used;
+   osd_id_t cid = 3862277;
+   Resource_t *res;
+   char token[4096];
+   char *buffer;
+   Allocation_t *a;
+   Cmd_state_t *cmd = &(task->cmd);
+   Cmd_allocate_t *ca = &(cmd->cargs.allocate);
+   Allocation_t *alloc = &(ca->a);
+   rid_t *rid = &(ca->rid);
+
+   debug_printf(1, "handle_bulk_allocate: Starting to process command n=%d\n", ca->n);
+
+   if (ibp_rid_is_empty(*rid)) { //** Pick a random resource to use
+       resource_pick(global_config->rl, rid);
+       log_printf(10, "handle_bulk_allocate: Picking random resource %s\n", ibp_rid2str(*rid, token));
+   }
+
+      //** Check the resource **
+   res = resource_lookup(global_config->rl, ibp_rid2str(*rid, token));
+   if (res == NULL) {    //**Can't find the resource
+      log_printf(1, "handle_bulk_allocate: Invalid resource: %s\n", ibp_rid2str(*rid, token));
+      alog_append_ibp_allocate(task->myid, -1, alloc->max_size, alloc->type, alloc->reliability, alloc->expiration);
+      send_cmd_result(task, IBP_E_INVALID_RID);
+      return(global_config->soft_fail);
+   }
+
+   //** Check the duration **
+   if (alloc->expiration == INT_MAX) {
+     alloc->expiration = res->max_duration + ibp_time_now();
+   }
+
+   d = alloc->expiration - ibp_time_now();
+   if (res->max_duration < d) {
+       log_printf(1, "handle_bulk_allocate: Duration(%d sec) exceeds that for RID %s of %d sec\n", d, res->name, res->max_duration);
+       send_cmd_result(task, IBP_E_LONG_DURATION);
+       return(global_config->soft_fail);
+   }
+
+   //** Perform the allocations.  The timestamps are set up front so only a single DB put is needed
+   tbx_type_malloc_clear(a, Allocation_t, ca->n);
+   for (i=0; i<ca->n; i++) set_alloc_timestamp(&(a[i].creation_ts), &(task->ipadd));
+
+   d = (global_config->server.lazy_allocate == 1) ? 0 : 1;
+   if ((err = create_allocation_bulk_resource(res, a, ca->n, alloc->max_size, alloc->type, alloc->reliability, alloc->expiration, d, ca->cs_type, ca->cs_blocksize)) != 0) {
+      log_printf(1, "handle_bulk_allocate: create_allocation_bulk_resource failed on RID %s!  n=%d Error=%d\n", res->name, ca->n, err);
+      alog_append_ibp_allocate(task->myid, res->rl_index, alloc->max_size, alloc->type, alloc->reliability, alloc->expiration);
+      free(a);
+      send_cmd_result(task, IBP_E_WOULD_EXCEED_LIMIT);
+      return(global_config->soft_fail);
+   }
+
+   //** Format the results.  Everything is sent with a single write
+   if (global_config->server.return_cap_id == 1) cid = 0;
+   tbx_ns_monitor_t *nm = tbx_ns_monitor_get(task->ns);
+   max_used = 1024 * (ca->n + 1);
+   tbx_type_malloc(buffer, char, max_used);
+   used = snprintf(buffer, max_used, "%d %d \n", IBP_OK, ca->n);
+   for (i=0; i<ca->n; i++) {
+      if (global_config->server.return_cap_id == 1) cid = a[i].id;
+      len = snprintf(token, sizeof(token), "ibp://%s:%d/%s#%s/" LU "/READ "
+          "ibp://%s:%d/%s#%s/" LU "/WRITE "
+          "ibp://%s:%d/%s#%s/" LU "/MANAGE \n",
+          tbx_nm_host_get(nm), tbx_nm_port_get(nm), res->name, a[i].caps[READ_CAP].v, cid,
+          tbx_nm_host_get(nm), tbx_nm_port_get(nm), res->name, a[i].caps[WRITE_CAP].v, cid,
+          tbx_nm_host_get(nm), tbx_nm_port_get(nm), res->name, a[i].caps[MANAGE_CAP].v, cid);
+      if ((used + len + 1) > max_used) {
+         max_used = 2*max_used + len;
+         tbx_type_realloc(buffer, char, max_used);
+      }
+      memcpy(buffer + used, token, len+1);
+      used += len;
+
+      alog_append_ibp_allocate(task->myid, res->rl_index, alloc->max_size, alloc->type, alloc->reliability, alloc->expiration);
+      alog_append_osd_id(task->myid, a[i].id);
+   }
+
+   err = server_ns_write_block(task->ns, task->cmd_timeout, buffer, used);
+
+   debug_printf(1, "handle_bulk_allocate: Created %d allocations on RID %s\n", ca->n, res->name);
+
+   free(buffer);
+   free(a);
+
+   return(err);
+}
+
 //*****************************************************************
 //  handle_merge - Merges 2 allocations
 //*****************************************************************
@@ -793,7 +892,11 @@ int handle_status(ibp_task_t *task)
      snprintf(buffer, sizeof(buffer)-1, "Total Commands: " LU "  Connections: %d\n", task->tid,
            tbx_network_counter(global_network));
      strncat(result, buffer, sizeof(result)-1 - strlen(result));
-     snprintf(buffer, sizeof(buffer)-1, "Active Threads: %d\n", currently_running_tasks());
+     if (global_config->server.epoll_enable == 1) {
+        snprintf(buffer, sizeof(buffer)-1, "Open Connections: %d  Idle: %d\n", currently_running_tasks(), epoll_engine_parked());
+     } else {
+        snprintf(buffer, sizeof(buffer)-1, "Active Threads: %d\n", currently_running_tasks());
+     }
      strncat(result, buffer, sizeof(result)-1 - strlen(result));
      reject_count(&i, &total);
      snprintf(buffer, sizeof(buffer)-1, "Reject stats --- Current: %d  Total: " LU "\n", i, total);
@@ -1365,6 +1468,189 @@ int handle_manage(ibp_task_t *task)
   return(0);
 }
 
+//*****************************************************************
+// handle_bulk_manage - Processes the bulk manage command.  Each key gets
+//    its own status so a missing cap doesn't fail the whole batch.  All the
+//    DB updates are done using a single transaction.  Alias caps aren't
+//    supported.  The activity log and history entries are recorded as
+//    IBP_MANAGE so they look the same as the single cap commands.
+//
+// Results:
+//    status n
+//    status [read_refcount write_refcount size max_size duration reliability type]   (Repeated n times)
+//
+//    The bracketed fields are only returned for IBP_PROBE
+//*****************************************************************
+
+int handle_bulk_manage(ibp_task_t *task)
+{
+  Cmd_state_t *cmd = &(task->cmd);
+  Cmd_bulk_manage_t *bm = &(cmd->cargs.bulk_manage);
+  Allocation_t *a, *ma, *ra;
+  osd_id_t *id;
+  int *status, *mindex;
+  int i, j, n_id, n_mod, n_rm, rel, err, len, used, max_used;
+  char token[256];
+  char *buffer;
+
+  debug_printf(1, "handle_bulk_manage: Starting to process command subcmd=%d n=%d ns=%d\n", bm->subcmd, bm->n, tbx_ns_getid(task->ns));
+
+  Resource_t *r = resource_lookup(global_config->rl, bm->crid);
+  if (r == NULL) {
+     log_printf(10, "handle_bulk_manage:  Invalid RID :%s\n",bm->crid);
+     alog_append_manage_bad(task->myid, IBP_MANAGE, bm->subcmd);
+     send_cmd_result(task, IBP_E_INVALID_RID);
+     free(bm->cap);
+     bm->cap = NULL;
+     return(global_config->soft_fail);
+  }
+
+  //** Resource is not mounted with manage access
+  if ((resource_get_mode(r) & RES_MODE_MANAGE) == 0) {
+     log_printf(10, "handle_bulk_manage: Manage access is disabled RID=%s\n", r->name);
+     alog_append_manage_bad(task->myid, IBP_MANAGE, bm->subcmd);
+     send_cmd_result(task, IBP_E_FILE_ACCESS);
+     free(bm->cap);
+     bm->cap = NULL;
+     return(0);
+  }
+
+  tbx_type_malloc_clear(a, Allocation_t, bm->n);
+  tbx_type_malloc_clear(ma, Allocation_t, bm->n);
+  tbx_type_malloc_clear(ra, Allocation_t, bm->n);
+  tbx_type_malloc_clear(id, osd_id_t, bm->n);
+  tbx_type_malloc_clear(status, int, bm->n);
+  tbx_type_malloc_clear(mindex, int, bm->n);
+
+  //** Look up all the caps
+  n_id = 0;
+  for (i=0; i<bm->n; i++) {
+     status[i] = IBP_OK;
+     if ((err = get_allocation_by_cap_resource(r, MANAGE_CAP, &(bm->cap[i]), &(a[i]))) != 0) {
+        log_printf(10, "handle_bulk_manage: Invalid cap: %s rid=%s\n", bm->cap[i].v, r->name);
+        alog_append_manage_bad(task->myid, IBP_MANAGE, bm->subcmd);
+        status[i] = IBP_E_CAP_NOT_FOUND;
+     } else if (a[i].is_alias == 1) {
+        log_printf(10, "handle_bulk_manage: Alias cap not supported: %s rid=%s\n", bm->cap[i].v, r->name);
+        alog_append_manage_bad(task->myid, IBP_MANAGE, bm->subcmd);
+        status[i] = IBP_E_INVALID_CMD;
+     } else {
+        for (j=0; j<n_id; j++) {  //** Each allocation can only be in the list once
+           if (id[j] == a[i].id) break;
+        }
+        if (j < n_id) {
+           log_printf(10, "handle_bulk_manage: Duplicate cap: %s rid=%s\n", bm->cap[i].v, r->name);
+           status[i] = IBP_E_INVALID_PARAMETER;
+           continue;
+        }
+        id[n_id] = a[i].id;
+        n_id++;
+     }
+  }
+
+  lock_osd_id_set(id, n_id);  //** Lock them so we don't get race updates
+
+  n_mod = n_rm = 0;
+  for (i=0; i<bm->n; i++) {
+     if (status[i] != IBP_OK) continue;
+
+     //** Re-read the data with the lock enabled
+     if ((err = get_allocation_resource(r, a[i].id, &(a[i]))) != 0) {
+        log_printf(10, "handle_bulk_manage: Error reading id after lock_osd_id_set  id: " LU " rid=%s\n", a[i].id, r->name);
+        alog_append_manage_bad(task->myid, IBP_MANAGE, bm->subcmd);
+        status[i] = IBP_E_CAP_NOT_FOUND;
+        continue;
+     }
+
+     switch (bm->subcmd) {
+        case IBP_DECR:
+           alog_append_manage_incdec(task->myid, IBP_MANAGE, IBP_DECR, r->rl_index, a[i].id, a[i].id, READ_CAP);
+           a[i].read_refcount--;
+           if (a[i].read_refcount < 0) a[i].read_refcount = 0;
+
+           update_manage_history(r, a[i].id, a[i].is_alias, &(task->ipadd), IBP_MANAGE, IBP_DECR, a[i].read_refcount, a[i].write_refcount, a[i].max_size, a[i].id);
+
+           if ((a[i].read_refcount == 0) && (a[i].write_refcount == 0)) {
+              ra[n_rm] = a[i];
+              n_rm++;
+           } else {
+              ma[n_mod] = a[i];
+              mindex[n_mod] = i;
+              n_mod++;
+           }
+           break;
+        case IBP_CHNG:
+           if (bm->new_duration == INT_MAX) {
+              a[i].expiration = ibp_time_now() + r->max_duration;
+           } else if (bm->new_duration > (ibp_time_now()+r->max_duration)) {
+              log_printf(10, "handle_bulk_manage: Duration >max_duration  id: " LU " rid=%s\n", a[i].id, r->name);
+              status[i] = IBP_E_WOULD_EXCEED_POLICY;
+              break;
+           } else {
+              a[i].expiration = bm->new_duration;
+           }
+
+           alog_append_manage_change(task->myid, r->rl_index, a[i].id, a[i].max_size, a[i].reliability, a[i].expiration);
+           update_manage_history(r, a[i].id, a[i].is_alias, &(task->ipadd), IBP_MANAGE, IBP_CHNG, a[i].reliability, a[i].expiration, a[i].max_size, a[i].id);
+
+           ma[n_mod] = a[i];
+           mindex[n_mod] = i;
+           n_mod++;
+           break;
+        case IBP_PROBE:  //** Nothing in the allocation changes so no DB update is needed
+           alog_append_manage_probe(task->myid, r->rl_index, a[i].id);
+           update_manage_history(r, a[i].id, a[i].is_alias, &(task->ipadd), IBP_MANAGE, IBP_PROBE, a[i].reliability, a[i].expiration, a[i].max_size, a[i].id);
+           break;
+     }
+  }
+
+  //** Store all the changes
+  if (n_mod > 0) {
+     if ((err = modify_allocation_bulk_resource(r, ma, n_mod)) != 0) {
+        log_printf(0, "handle_bulk_manage:  Error with modify_allocation_bulk_resource! n=%d err=%d\n", n_mod, err);
+        for (i=0; i<n_mod; i++) status[mindex[i]] = IBP_E_INTERNAL;  //** DB failure not a policy problem
+     }
+  }
+  if (n_rm > 0) remove_allocation_bulk_resource(r, OSD_DELETE_ID, ra, n_rm);
+
+  unlock_osd_id_set(id, n_id);
+
+  //** Format the results.  Everything is sent with a single write
+  max_used = sizeof(token) * (bm->n + 1);
+  tbx_type_malloc(buffer, char, max_used);
+  used = snprintf(buffer, max_used, "%d %d \n", IBP_OK, bm->n);
+  for (i=0; i<bm->n; i++) {
+     if ((bm->subcmd == IBP_PROBE) && (status[i] == IBP_OK)) {
+        rel = (a[i].reliability == ALLOC_HARD) ? IBP_HARD : IBP_SOFT;
+        len = snprintf(token, sizeof(token), "%d %d %d " LU " " LU " %ld %d %d \n",
+                  IBP_OK, a[i].read_refcount, a[i].write_refcount, a[i].size, a[i].max_size, a[i].expiration - ibp_time_now(),
+                  rel, a[i].type);
+     } else {
+        len = snprintf(token, sizeof(token), "%d \n", status[i]);
+     }
+     memcpy(buffer + used, token, len+1);
+     used += len;
+  }
+
+  err = server_ns_write_block(task->ns, task->cmd_timeout, buffer, used);
+  alog_append_cmd_result(task->myid, IBP_OK);
+
+  free(buffer);
+  free(mindex);
+  free(status);
+  free(id);
+  free(ra);
+  free(ma);
+  free(a);
+  free(bm->cap);
+  bm->cap = NULL;
+
+  cmd->state = CMD_STATE_FINISHED;
+  log_printf(10, "handle_bulk_manage: Processed %d keys\n", bm->n);
+
+  return(0);
+}
+
 //*****************************************************************
 // handle_validate_chksum  - Handles the IBP_VALIDATE_CHKSUM commands
 //
@@ -3049,6 +3335,7 @@ int handle_internal_mount(ibp_task_t *task)
 
   //** Launch the garbage collection threads
   launch_resource_cleanup_thread(r);
+  launch_resource_io_threads(r);
 
   log_printf(5, "handle_internal_mount: End of routine.  ns=%d\n",tbx_ns_getid(task->ns));
 
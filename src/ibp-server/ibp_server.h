@@ -83,6 +83,8 @@ typedef struct {       // Structure containg the overall server config
    int n_iface;          //Number of bound interfaces
    int port;             //Default Port to listen on
    int max_threads;      //Max number of threads for pool
+   int max_connections;  //Max open connections when using the epoll engine
+   int epoll_enable;     //Multiplex idle connections with epoll instead of a thread per connection
    int max_pending;      //Max pending connections
    int timestamp_interval;  //Log timestamp interval in sec
    int stats_size;       //Max size of statistics to keep
@@ -93,6 +95,7 @@ typedef struct {       // Structure containg the overall server config
    int backoff_max;       //MAx backoff time in sec
    int big_alloc_enable;  //Enable 2G+ allocations
    int splice_enable;     //Enable use of splice if available
+   int write_pipeline_depth;  //Number of write buffers in flight to the disk I/O threads.  <2 disables pipelining
    int lazy_allocate;    //If 1 don't create the physical file just make the DB entry
    char *logfile;        //Log file
    int log_maxsize;      //Max size of logs to keep before rolling over
@@ -105,6 +108,9 @@ typedef struct {       // Structure containg the overall server config
    char *alog_host;      //** Host to send alog info
    int   alog_max_history;     //** How many alog files to keep before dropping them
    int   alog_port;            //** alog host's port to use
+   int   alog_ring_size;       //** Size of each thread's record ring in bytes
+   int   alog_flush_interval;  //** How often the rings are drained in ms
+   int   alog_compress;        //** Compress rolled over alog files
    int   return_cap_id;    //** Returns the cap id in the capability if set
    int   rid_check_interval;  //** DRive check interval
    int   eject_timeout;   //** How long to wait for RID check failures before ejecting a drive
@@ -187,6 +193,7 @@ IBPS_API void free_command(Cmd_state_t *cmd);
 IBPS_API void *worker_task(apr_thread_t *ath, void *arg);
 IBPS_API void server_loop(Config_t *config);
 IBPS_API void signal_shutdown(int sig);
+IBPS_API int shutdown_request();
 IBPS_API int to_many_connections();
 IBPS_API void reject_close(tbx_ns_t *ns);
 IBPS_API void reject_task(tbx_ns_t *ns, int destroy_ns);
@@ -194,9 +201,30 @@ IBPS_API int request_task_close();
 IBPS_API int currently_running_tasks();
 IBPS_API void reject_count(int *curr, uint64_t *total);
 IBPS_API void release_task(Thread_task_t *t);
+IBPS_API void reserve_connection();
+IBPS_API void release_connection();
+IBPS_API int task_slot_count(Config_t *cfg);
+IBPS_API int handle_task(ibp_task_t *task);
 IBPS_API void wait_all_tasks();
 IBPS_API void signal_taskmgr();
 
+//*** Functions in epoll_engine.c ***
+IBPS_API void epoll_engine_start(Config_t *cfg);
+IBPS_API void epoll_engine_stop();
+IBPS_API void epoll_engine_add(tbx_ns_t *ns, int reject_connection);
+IBPS_API int epoll_engine_parked();
+
+//*** Functions in proto_v2.c ***
+IBPS_API void proto_v2_load_config(tbx_inip_file_t *kf);
+IBPS_API void proto_v2_init();
+IBPS_API void proto_v2_destroy();
+IBPS_API int proto_v2_print(char *buffer, int *used, int nbytes);
+IBPS_API int read_protocol(ibp_task_t *task, char **bstate);
+IBPS_API int handle_protocol(ibp_task_t *task);
+IBPS_API int proto_v2_active(tbx_ns_t *ns);
+IBPS_API int proto_v2_busy(tbx_ns_t *ns);
+IBPS_API int proto_v2_process(tbx_ns_t *ns);
+
 //*** Functions in parse_commands.c ***
 IBPS_API int read_rename(ibp_task_t *task, char **bstate);
 IBPS_API int read_allocate(ibp_task_t *task, char **bstate);
@@ -205,6 +233,8 @@ IBPS_API int read_merge_allocate(ibp_task_t *task, char **bstate);
 IBPS_API int read_alias_allocate(ibp_task_t *task, char **bstate);
 IBPS_API int read_status(ibp_task_t *task, char **bstate);
 IBPS_API int read_manage(ibp_task_t *task, char **bstate);
+IBPS_API int read_bulk_allocate(ibp_task_t *task, char **bstate);
+IBPS_API int read_bulk_manage(ibp_task_t *task, char **bstate);
 IBPS_API int read_write(ibp_task_t *task, char **bstate);
 IBPS_API int read_read(ibp_task_t *task, char **bstate);
 IBPS_API int read_internal_get_alloc(ibp_task_t *task, char **bstate);
@@ -227,6 +257,8 @@ IBPS_API int handle_alias_allocate(ibp_task_t *task);
 IBPS_API int handle_rename(ibp_task_t *task);
 IBPS_API int handle_status(ibp_task_t *task);
 IBPS_API int handle_manage(ibp_task_t *task);
+IBPS_API int handle_bulk_allocate(ibp_task_t *task);
+IBPS_API int handle_bulk_manage(ibp_task_t *task);
 IBPS_API int handle_write(ibp_task_t *task);
 IBPS_API int handle_read(ibp_task_t *task);
 IBPS_API int handle_copy(ibp_task_t *task);
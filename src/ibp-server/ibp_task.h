@@ -24,6 +24,7 @@
 #include <apr_thread_mutex.h>
 #include <tbx/network.h>
 #include "allocation.h"
+#include "ibp_protocol.h"
 #include "resource.h"
 #include "transfer_stats.h"
 
@@ -83,6 +84,7 @@ typedef struct {          //**Allocate args
    char      crid[128];      //** Character version of the RID for querying
    int       cs_type;        //** disk Chksum type 
    ibp_off_t cs_blocksize;   //** disk Chksum blocksize
+   int       n;              //** Number of allocations for IBP_BULK_ALLOCATE
    Allocation_t a;           //Allocation being created
 } Cmd_allocate_t;
 
@@ -129,6 +131,15 @@ typedef struct {
   Allocation_t a;          //** Allocation for command
 } Cmd_manage_t;
 
+typedef struct {
+  rid_t rid;               //** RID for querying
+  char    crid[128];       //** Character version of the RID for querying
+  int   subcmd;            //** Subcommand: IBP_PROBE, IBP_CHNG, or IBP_DECR
+  int   n;                 //** Number of keys
+  long int new_duration;   //** New expiration for IBP_CHNG
+  Cap_t   *cap;            //** Manage keys.  Allocated by read_bulk_manage() and freed by handle_bulk_manage()
+} Cmd_bulk_manage_t;
+
 typedef struct {
   int      sending;        //** Write state
   rid_t rid;               //** RID for querying
@@ -211,11 +222,16 @@ typedef struct {
   int   mode;               //** New RWM mode
 } Cmd_internal_mode_t;
 
+typedef struct {
+  int version;              //** Highest wire protocol version the client supports
+} Cmd_protocol_t;
+
 
 typedef union {            //** Union of command args
     Cmd_allocate_t allocate;
     Cmd_status_t   status;
     Cmd_manage_t   manage;
+    Cmd_bulk_manage_t bulk_manage;
     Cmd_merge_t    merge;
     Cmd_write_t    write;
     Cmd_read_t     read;
@@ -227,6 +243,7 @@ typedef union {            //** Union of command args
     Cmd_internal_rescan_t   rescan;
     Cmd_internal_mount_t   mount;
     Cmd_internal_mode_t   mode;
+    Cmd_protocol_t   protocol;
 } Cmd_args_t;
 
 typedef struct {           //** Stores the state of the command
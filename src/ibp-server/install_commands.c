@@ -43,6 +43,9 @@ void install_commands(tbx_inip_file_t *kf) {
   add_command(IBP_PULL, "ibp_pull", kf, NULL, NULL, NULL, NULL, read_read, handle_copy);
   add_command(IBP_VEC_WRITE, "ibp_write", kf, NULL, NULL, NULL, NULL, read_write, handle_write);
   add_command(IBP_VEC_READ, "ibp_load", kf, NULL, NULL, NULL, NULL, read_read, handle_read);
+  add_command(IBP_PROTOCOL, "ibp_protocol", kf, proto_v2_load_config, proto_v2_init, proto_v2_destroy, proto_v2_print, read_protocol, handle_protocol);
+  add_command(IBP_BULK_ALLOCATE, "ibp_allocate", kf, NULL, NULL, NULL, NULL, read_bulk_allocate, handle_bulk_allocate);
+  add_command(IBP_BULK_MANAGE, "ibp_manage", kf, NULL, NULL, NULL, NULL, read_bulk_manage, handle_bulk_manage);
 
   //** Chksum version of commands
   add_command(IBP_ALLOCATE_CHKSUM, "ibp_allocate", kf, NULL, NULL, NULL, NULL, read_allocate, handle_allocate);
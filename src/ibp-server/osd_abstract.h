@@ -79,6 +79,7 @@ typedef struct {
 #define osd_native_open_id(d, id, offset, mode) (d)->native_open(d, id, offset, mode)
 #define osd_native_enabled(d) (d)->native_open
 #define osd_native_close_id(d, fd) (d)->native_close(d, fd)
+#define osd_native_fd(d, fd) (d)->native_fd(d, fd)
 #define osd_validate_chksum(d, id, correct_errors) (d)->validate_chksum(d, id, correct_errors)
 #define osd_get_chksum(d, id, disk_buffer, calc_buffer, bsize, block_len, good_block, start_block, end_block) (d)->get_chksum(d, id, disk_buffer, calc_buffer, bsize, block_len, good_block, start_block, end_block)
 #define osd_chksum_info(d, id, cs_type, hbs, bs) (d)->chksum_info(d, id, cs_type, hbs, bs)
@@ -88,6 +89,7 @@ typedef struct {
 #define osd_corrupt_iterator_next(iter, id) (iter)->d->corrupt_iterator_next(iter, id)
 #define osd_reserve(d, id, len) (d)->reserve(d, id, len)
 #define osd_remove(d, rmode, id) (d)->remove(d, rmode, id)
+#define osd_stamped_remove(d, rmode, id, move_time) (d)->stamped_remove(d, rmode, id, move_time)
 #define osd_delete_remove(d, id) (d)->delete_remove(d, id)
 #define osd_expire_remove(d, id) (d)->expire_remove(d, id)
 #define osd_physical_remove(d, id) (d)->physical_remove(d, id)
@@ -105,6 +107,8 @@ typedef struct {
 #define osd_id_exists(d, id) (d)->id_exists(d, id)
 #define osd_statfs(d, buf) (d)->statfs(d, buf)
 #define osd_new_iterator(d) (d)->new_iterator(d)
+#define osd_n_partitions(d) (d)->n_partitions(d)
+#define osd_new_partition_iterator(d, first, last) (d)->new_partition_iterator(d, first, last)
 #define osd_new_trash_iterator(d, trash_type) (d)->new_trash_iterator(d, trash_type)
 #define osd_destroy_iterator(oi) (oi)->d->destroy_iterator(oi)
 #define osd_iterator_next(oi, id) (oi)->d->iterator_next(oi, id)
@@ -116,6 +120,7 @@ struct osd_s {
     osd_id_t (*create_id)(osd_t *d, int chksum_type, int header_size, int block_size, osd_id_t id);    // Returns an OSD object.  Think of it as a filename
     osd_native_fd_t (*native_open)(osd_t *d, osd_id_t id, osd_off_t offset, int mode);   //Native open 
     int (*native_close)(osd_t *d, osd_native_fd_t fd);   //Native close
+    osd_native_fd_t (*native_fd)(osd_t *d, osd_fd_t *fd);   //Raw fd of an open object for zero-copy reads or -1 if the data isn't stored verbatim
     int (*validate_chksum)(osd_t *d, osd_id_t id, int correct_errors);
     osd_off_t (*get_chksum)(osd_t *d, osd_id_t id, char *disk_buffer, char *calc_buffer, osd_off_t buffer_size, osd_off_t *block_len, char *good_block, osd_off_t start_block, osd_off_t end_block);
     int (*chksum_info)(osd_t *d, osd_id_t id, int *cs_type, osd_off_t *header_blocksize, osd_off_t *blocksize);
@@ -125,6 +130,7 @@ struct osd_s {
     int (*corrupt_iterator_next)(osd_iter_t *iter, osd_id_t *id);    // Corrupt iterator next
     int (*reserve)(osd_t *d, osd_id_t id, osd_off_t len);  // Reserve space for the file
     int (*remove)(osd_t *d, int rmode, osd_id_t id);  //** Wrapper for delete/expire/physical_remove
+    int (*stamped_remove)(osd_t *d, int rmode, osd_id_t id, ibp_time_t move_time);  //** Same as remove but the trash entry uses move_time
     int (*delete_remove)(osd_t *d, osd_id_t id);  // Move an object from valid->deleted bin
     int (*expire_remove)(osd_t *d, osd_id_t id);  // Move an object from valid->expired bin
     int (*physical_remove)(osd_t *d, osd_id_t id);  // Remove the valid object completely.. non-recoverable
@@ -142,6 +148,8 @@ struct osd_s {
     int (*id_exists)(osd_t *d, osd_id_t id);   //Determine if the id currently exists
     int (*statfs)(osd_t *d, struct statfs *buf);    // Get File system stats
     osd_iter_t *(*new_iterator)(osd_t *d);
+    int (*n_partitions)(osd_t *d);       // Number of independent slices the ID space is split into
+    osd_iter_t *(*new_partition_iterator)(osd_t *d, int first, int last);   // Only walks partitions [first, last)
     osd_iter_t *(*new_trash_iterator)(osd_t *d, int trash_type);
     void (*destroy_iterator)(osd_iter_t *oi);
     int (*iterator_next)(osd_iter_t *oi, osd_id_t *id);
@@ -465,6 +465,23 @@ int fs_associate_id(osd_t *d, int id, char *name)
   return(0);
 }
 
+//******************************************************************************
+// osd_fs_io_set - Selects how normal object data is accessed.  io_engine is
+//    FS_IO_STDIO or FS_IO_URING.  If direct_io=1 aligned requests bypass the
+//    page cache using O_DIRECT.  Should be called right after mounting.
+//******************************************************************************
+
+void osd_fs_io_set(osd_t *d, int io_engine, int uring_depth, int direct_io)
+{
+  osd_fs_t *fs = (osd_fs_t *)(d->private);
+
+  fs->io_engine = io_engine;
+  fs->uring_depth = uring_depth;
+  fs->direct_io = direct_io;
+
+  log_printf(5, "osd_fs_io_set: %s io_engine=%d uring_depth=%d direct_io=%d\n", fs->devicename, io_engine, uring_depth, direct_io);
+}
+
 //******************************************************************************
 // fs_corrupt_count - Returns the number of corrupt objects encountered during
 //    execution
@@ -958,47 +975,47 @@ int fs_trash_physical_remove(osd_t *d, int trash_type, const char *trash_id) {
 }
 
 //**************************************************
-//  delete_remove - Moved the ID to the deleted_trash dir
+//  trash_move - Moves the ID to the given trash dir using move_time
+//     for the trash id stamp
 //**************************************************
 
-int fs_delete_remove(osd_t *d, osd_id_t id) {
-//log_printf(10,"delete_remove(" LU ")\n", id);
+int _fs_trash_move(osd_t *d, const char *bin, osd_id_t id, ibp_time_t move_time) {
    osd_fs_t *fs = (osd_fs_t *)(d->private);
 
    char fname[fs->pathlen], tname[fs->pathlen];
-   apr_time_t now = apr_time_now();
-   now = apr_time_sec(now);
-   snprintf(tname, sizeof(tname), "%s/deleted_trash/" TT "_" LU, fs->devicename, now, id);
+   snprintf(tname, sizeof(tname), "%s/%s/" TT "_" LU, fs->devicename, bin, move_time, id);
 
    return(rename(_id2fname(fs, id, fname, sizeof(fname)), tname));
 }
 
+//**************************************************
+//  delete_remove - Moved the ID to the deleted_trash dir
+//**************************************************
+
+int fs_delete_remove(osd_t *d, osd_id_t id) {
+//log_printf(10,"delete_remove(" LU ")\n", id);
+   return(_fs_trash_move(d, "deleted_trash", id, ibp_time_now()));
+}
+
 //**************************************************
 //  expire_remove - Moved the ID to the expired_trash dir
 //**************************************************
 
 int fs_expire_remove(osd_t *d, osd_id_t id) {
 //log_printf(10,"expire_remove(" LU ")\n", id);
-   osd_fs_t *fs = (osd_fs_t *)(d->private);
-
-   char fname[fs->pathlen], tname[fs->pathlen];
-   apr_time_t now = apr_time_now();
-   now = apr_time_sec(now);
-
-   snprintf(tname, sizeof(tname), "%s/expired_trash/" TT "_" LU, fs->devicename, now, id);
-
-   return(rename(_id2fname(fs, id, fname, sizeof(fname)), tname));
+   return(_fs_trash_move(d, "expired_trash", id, ibp_time_now()));
 }
 
 //**************************************************
-//  remove - Wrapper for physical/expire/delete remove
+//  stamped_remove - Same as remove but the caller supplies the trash
+//     stamp so it can track the trash id without rescanning the bin
 //**************************************************
 
-int fs_remove(osd_t *d, int rmode, osd_id_t id) {
+int fs_stamped_remove(osd_t *d, int rmode, osd_id_t id, ibp_time_t move_time) {
    if (rmode == OSD_DELETE_ID) {
-      return(fs_delete_remove(d, id));
+      return(_fs_trash_move(d, "deleted_trash", id, move_time));
    } else if (rmode == OSD_EXPIRE_ID) {
-      return(fs_expire_remove(d, id));
+      return(_fs_trash_move(d, "expired_trash", id, move_time));
    } else if (rmode == OSD_PHYSICAL_ID) {
       return(fs_physical_remove(d, id));
    }
@@ -1006,6 +1023,14 @@ int fs_remove(osd_t *d, int rmode, osd_id_t id) {
    return(-1);
 }
 
+//**************************************************
+//  remove - Wrapper for physical/expire/delete remove
+//**************************************************
+
+int fs_remove(osd_t *d, int rmode, osd_id_t id) {
+   return(fs_stamped_remove(d, rmode, id, ibp_time_now()));
+}
+
 //**************************************************
 // trash_undelete - Undeletes a trashed id
 //**************************************************
@@ -1549,6 +1574,7 @@ osd_fd_t *fs_open(osd_t *d, osd_id_t id, int mode)
    osd_fs_fd_t *fsfd = fsfd_get(fs, id, mode);
    if (fsfd == NULL) return(NULL);
 
+   fsfd->direct_fd = -1;
    fsfd->fd = fopen(_id2fname(fs, id, fname, sizeof(fname)), "r+");
    if (fsfd->fd == NULL) {
       if (mode == OSD_WRITE_MODE) {
@@ -1566,6 +1592,12 @@ osd_fd_t *fs_open(osd_t *d, osd_id_t id, int mode)
       }
    }
 
+   //** Normal objects can also bypass the page cache for aligned I/O
+   if ((fs->direct_io == 1) && (fsfd->obj->fd_chksum.is_valid == 0)) {
+      fsfd->direct_fd = open(fname, O_RDWR|O_DIRECT);
+      if (fsfd->direct_fd == -1) log_printf(1, "fs_open(" LU ", %d) O_DIRECT open failed errno=%d\n", id, mode, errno);
+   }
+
    log_printf(10, "fs_open(" LU ", %d)=%p success\n", id, mode, fsfd->fd);
 
    return((osd_fd_t *)fsfd);
@@ -1589,6 +1621,11 @@ int fs_close(osd_t *d, osd_fd_t *ofd)
       fsfd->fd = NULL;
    }
 
+   if (fsfd->direct_fd != -1) {
+      close(fsfd->direct_fd);
+      fsfd->direct_fd = -1;
+   }
+
    return(fsfd_remove(fs, fsfd));
 }
 
@@ -1632,6 +1669,23 @@ int fs_native_close(osd_t *d, int fd)
   return(close(fd));
 }
 
+//*************************************************************
+//  fs_native_fd - Returns the underlying fd for an open object
+//     so data can be sent with sendfile().  Only normal objects
+//     qualify since chksummed objects interleave the chksums
+//     with the data.  Returns -1 if not available.
+//*************************************************************
+
+int fs_native_fd(osd_t *d, osd_fd_t *ofd)
+{
+   osd_fs_fd_t *fsfd = (osd_fs_fd_t *)ofd;
+
+   if (fsfd == NULL) return(-1);
+   if (fsfd->obj->fd_chksum.is_valid != 0) return(-1);
+
+   return(fileno(fsfd->fd));
+}
+
 //**************************************************************************************
 // _chksum_buffered_read - Reads len bytes of data from fsfd and accumulates
 //     the chksum information in cs1 and optionally cs2
@@ -1906,6 +1960,53 @@ osd_off_t fs_chksum_write(osd_fs_t *fs, osd_fs_fd_t *fsfd, osd_off_t offset, osd
    return(err);
 }
 
+//*************************************************************
+//  _fs_uring_get - Returns the ring, creating it on first use
+//*************************************************************
+
+osd_uring_t *_fs_uring_get(osd_fs_t *fs)
+{
+   if (fs->io_engine != FS_IO_URING) return(NULL);
+
+   apr_thread_mutex_lock(fs->lock);
+   if (fs->uring == NULL) {
+      fs->uring = osd_uring_create(fs->uring_depth);
+      if (fs->uring == NULL) {  //** Not supported so fall back to pread/pwrite
+         log_printf(0, "_fs_uring_get: %s Unable to create io_uring.  Using pread/pwrite\n", fs->devicename);
+         fs->io_engine = FS_IO_STDIO;
+      }
+   }
+   apr_thread_mutex_unlock(fs->lock);
+
+   return(fs->uring);
+}
+
+//*************************************************************
+//  _fs_normal_rw - Reads/writes normal object data with io_uring
+//     or pread/pwrite instead of stdio.  Requests that meet the
+//     O_DIRECT alignment use the direct fd if available.
+//*************************************************************
+
+osd_off_t _fs_normal_rw(osd_fs_t *fs, osd_fs_fd_t *fsfd, int mode, osd_off_t offset, osd_off_t len, buffer_t buffer)
+{
+   osd_off_t n;
+   int fd;
+
+   fd = fileno(fsfd->fd);
+   if ((fsfd->direct_fd != -1) && (((offset | len | (osd_off_t)(intptr_t)buffer) & (FS_DIRECT_ALIGN-1)) == 0)) fd = fsfd->direct_fd;
+
+   n = osd_uring_rw(((fs->uring != NULL) ? fs->uring : _fs_uring_get(fs)), mode, fd, buffer, len, offset);
+
+   log_printf(15, "_fs_normal_rw(%s, %p, mode=%d, fd=%d, " I64T ", " I64T ")=" I64T "\n", fs->devicename, fsfd, mode, fd, offset, len, n);
+
+   if (n != len) {
+      log_printf(0, "_fs_normal_rw(%p, mode=%d, " I64T ", " I64T ") error = %d n=" I64T "\n", fsfd, mode, offset, len, errno, n);
+      return(1);
+   }
+
+   return(0);
+}
+
 //*************************************************************
 //  fs_normal_write - Stores data to an id given the offset and length (no chksum)
 //*************************************************************
@@ -1913,6 +2014,8 @@ osd_off_t fs_chksum_write(osd_fs_t *fs, osd_fs_fd_t *fsfd, osd_off_t offset, osd
 osd_off_t fs_normal_write(osd_fs_t *fs, osd_fs_fd_t *fsfd, osd_off_t offset, osd_off_t len, buffer_t buffer) 
 {
    osd_off_t n, err;
+
+   if ((fs->io_engine == FS_IO_URING) || (fsfd->direct_fd != -1)) return(_fs_normal_rw(fs, fsfd, OSD_URING_WRITE, offset, len, buffer));
  
 //   apr_thread_mutex_lock(fsfd->lock);
 
@@ -2159,6 +2262,8 @@ log_printf(0, "chksum_full_read: block=" I64T " fpos=" I64T "\n", block, obj_off
 osd_off_t fs_normal_read(osd_fs_t *fs, osd_fs_fd_t *fsfd, osd_off_t offset, osd_off_t len, buffer_t buffer) 
 {
    osd_off_t n, err;
+
+   if ((fs->io_engine == FS_IO_URING) || (fsfd->direct_fd != -1)) return(_fs_normal_rw(fs, fsfd, OSD_URING_READ, offset, len, buffer));
  
 //   apr_thread_mutex_lock(fsfd->lock);
 
@@ -2698,13 +2803,31 @@ int fs_opendir(osd_fs_iter_t *iter)
 }
 
 //*************************************************************
-//  new_iterator - Creates a new iterator to walk through the files
+//  fs_n_partitions - Returns the number of partitions the ID space is
+//     split into.  Each partition is a bucket directory.
 //*************************************************************
 
-osd_iter_t *fs_new_iterator(osd_t *d)
+int fs_n_partitions(osd_t *d)
 {
-   osd_iter_t *oi = (osd_iter_t *)malloc(sizeof(osd_iter_t));
-   osd_fs_iter_t *iter = (osd_fs_iter_t *)malloc(sizeof(osd_fs_iter_t));
+   return(DIR_MAX);
+}
+
+//*************************************************************
+//  new_partition_iterator - Creates an iterator to walk through the files
+//     stored in partitions [first, last)
+//*************************************************************
+
+osd_iter_t *fs_new_partition_iterator(osd_t *d, int first, int last)
+{
+   osd_iter_t *oi;
+   osd_fs_iter_t *iter;
+
+   if (first < 0) first = 0;
+   if (last > DIR_MAX) last = DIR_MAX;
+   if (first >= last) return(NULL);
+
+   oi = (osd_iter_t *)malloc(sizeof(osd_iter_t));
+   iter = (osd_fs_iter_t *)malloc(sizeof(osd_fs_iter_t));
 
    if (oi == NULL) return(NULL);
    if (iter == NULL) return(NULL);
@@ -2712,7 +2835,8 @@ osd_iter_t *fs_new_iterator(osd_t *d)
    oi->d = d;
    oi->arg = (void *)iter;
 
-   iter->n = 0;
+   iter->n = first;
+   iter->n_end = last;
    iter->fs = (osd_fs_t *)(d->private);
 
    if (fs_opendir(iter) != 0) { free(iter); free(oi); return(NULL); }
@@ -2720,6 +2844,15 @@ osd_iter_t *fs_new_iterator(osd_t *d)
    return(oi);
 }
 
+//*************************************************************
+//  new_iterator - Creates a new iterator to walk through the files
+//*************************************************************
+
+osd_iter_t *fs_new_iterator(osd_t *d)
+{
+   return(fs_new_partition_iterator(d, 0, DIR_MAX));
+}
+
 //*************************************************************
 //  destroy_iterator - Destroys an iterator
 //*************************************************************
@@ -2752,7 +2885,7 @@ int fs_iterator_next(osd_iter_t *oi, osd_id_t *id)
   if (oi == NULL) return(1);
   iter = (osd_fs_iter_t *)oi->arg;
 
-  if (iter->n >= DIR_MAX) return(1);
+  if (iter->n >= iter->n_end) return(1);
 
   finished = 0;
   do {
@@ -2760,7 +2893,7 @@ int fs_iterator_next(osd_iter_t *oi, osd_id_t *id)
 
     if ((result == NULL) || (n != 0)) {   //** Change dir or we're finished
        iter->n++;
-       if (iter->n == DIR_MAX) return(1);   //** Finished
+       if (iter->n == iter->n_end) return(1);   //** Finished
        closedir(iter->cdir);
        if (fs_opendir(iter) != 0) return(1);   //*** Error opening the directory
     } else if ((strcmp(result->d_name, ".") != 0) && (strcmp(result->d_name, "..") != 0)) {
@@ -2807,6 +2940,7 @@ osd_iter_t *fs_new_trash_iterator(osd_t *d, int trash_type)
    iter->fs = fs;
    iter->cdir = opendir(dname);
    iter->n = -1;
+   iter->n_end = 0;
 
    if (iter->cdir == NULL) {
       log_printf(0, "new_iterator: error with opendir(%s)\n", dname);
@@ -2873,6 +3007,8 @@ log_printf(15, "fs_umount fs=%p rid=%s\n",fs, fs->devicename);
 
   fs_cache_destroy(fs->cache);
 
+  if (fs->uring != NULL) osd_uring_destroy(fs->uring);
+
   //**NOTE: there is no apr_hash_destroy function:(  so it gets removed when the pool is destroyed
   apr_thread_mutex_destroy(fs->lock);
   apr_thread_mutex_destroy(fs->obj_lock);
@@ -3092,8 +3228,10 @@ osd_t *osd_mount_fs(const char *device, int n_cache, apr_time_t expire_time)
    d->create_id = fs_create_id;
    d->native_open = fs_native_open;
    d->native_close = fs_native_close;
+   d->native_fd = fs_native_fd;
    d->reserve = fs_reserve;
    d->remove = fs_remove;
+   d->stamped_remove = fs_stamped_remove;
    d->chksum_info = fs_chksum_info;
    d->get_chksum = fs_get_chksum;
    d->validate_chksum = fs_validate_chksum;
@@ -3118,6 +3256,8 @@ osd_t *osd_mount_fs(const char *device, int n_cache, apr_time_t expire_time)
    d->destroy_corrupt_iterator = fs_destroy_corrupt_iterator;
    d->corrupt_iterator_next = fs_corrupt_iterator_next;
    d->new_iterator = fs_new_iterator;
+   d->n_partitions = fs_n_partitions;
+   d->new_partition_iterator = fs_new_partition_iterator;
    d->new_trash_iterator = fs_new_trash_iterator;
    d->destroy_iterator = fs_destroy_iterator;
    d->iterator_next = fs_iterator_next;
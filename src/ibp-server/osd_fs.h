@@ -39,6 +39,7 @@
 #include "statfs.h"
 #include <tbx/chksum.h>
 #include "pigeon_coop.h"
+#include "osd_uring.h"
 
 //******** These are for the directory splitting ****
 #define DIR_BITS    8
@@ -52,6 +53,11 @@
 
 #define XFS_MOUNT 1
 
+#define FS_IO_STDIO 0   //** Object data is accessed with stdio
+#define FS_IO_URING 1   //** Normal object data goes through io_uring
+
+#define FS_DIRECT_ALIGN 4096   //** Alignment required for O_DIRECT requests
+
 typedef struct { 
   osd_id_t id;
   int      block;
@@ -114,6 +120,7 @@ struct osd_fs_fd_s {
   tbx_pch_t my_range_slot;
   tbx_pch_t my_slot;
   int timestamp;
+  int direct_fd;             //** O_DIRECT fd for normal objects or -1
 };
 
 struct osd_fs_object_s {
@@ -155,6 +162,10 @@ struct osd_fs_s {
     apr_thread_mutex_t *lock;
     apr_thread_mutex_t *obj_lock;
     apr_pool_t *pool;
+    int io_engine;             //** FS_IO_STDIO or FS_IO_URING
+    int uring_depth;           //** Queue depth for the ring
+    int direct_io;             //** Use O_DIRECT for aligned I/O on normal objects
+    osd_uring_t *uring;        //** Created on first use so it's after the fork
     char *id_map[FS_MAX_LOOPBACK];
     char *(*id2fname)(struct osd_fs_s *fs, osd_id_t id, char *fname, int len);
     char *(*trashid2fname)(struct osd_fs_s *fs, int trash_type, const char *trash_id, char *fname, int len);
@@ -164,6 +175,7 @@ typedef struct {
    osd_fs_t *fs;         //** Device pointer
    DIR *cdir;            //** DIR handle
    int  n;               //** Directory number
+   int  n_end;           //** Stop once this directory is reached
    struct dirent entry;  //** Used by readdir_r
 } osd_fs_iter_t;
 
@@ -176,6 +188,7 @@ typedef struct {
 
 IBPS_API osd_t *osd_mount_fs(const char *device, int n_cache, apr_time_t expire_time);
 IBPS_API int fs_associate_id(osd_t *d, int id, char *fname);
+IBPS_API void osd_fs_io_set(osd_t *d, int io_engine, int uring_depth, int direct_io);
 
 #endif
 
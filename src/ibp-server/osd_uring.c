@@ -0,0 +1,421 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// osd_uring - io_uring submission layer.  The ring is driven directly
+//    with the raw syscalls so there's no dependency on liburing.
+//
+//    Each outstanding request owns a slot which bounds the queue depth
+//    and provides the condition the caller sleeps on.  Callers place
+//    their SQE on the ring and whoever isn't already inside
+//    io_uring_enter() flushes everything pending in a single call.
+//    The reaper thread blocks in the kernel waiting for completions.
+//*****************************************************************
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <apr_thread_proc.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_cond.h>
+#include <apr_pools.h>
+#include <tbx/log.h>
+#include <tbx/type_malloc.h>
+#include "osd_uring.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#define URING_MAX_IO    (1024*1024*1024)  //** Max size of a single request
+#define URING_SHUTDOWN  0xFFFFFFFFFFFFFFFFULL  //** user_data used to stop the reaper
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+typedef struct {
+  struct iovec iov;          //** Buffer for the request
+  int done;                  //** Set by the reaper on completion
+  int res;                   //** cqe->res
+  apr_thread_cond_t *cond;   //** Caller waits here for the completion
+} uring_slot_t;
+
+struct osd_uring_s {
+  int fd;                    //** io_uring handle
+  int depth;                 //** Number of slots
+  int n_free;                //** Number of free slots
+  int *free;                 //** Free slot stack
+  int n_waiting;             //** Number of threads waiting on a free slot
+  int n_unsubmitted;         //** SQEs on the ring not yet handed to the kernel
+  int submitting;            //** Set when a thread is inside io_uring_enter() submitting
+  uring_slot_t *slot;
+  unsigned *sq_head;         //** Submission ring
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head;         //** Completion ring
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ptr;
+  void *cq_ptr;
+  size_t sq_size;
+  size_t cq_size;
+  size_t sqes_size;
+  apr_thread_t *reaper;
+  apr_thread_mutex_t *lock;
+  apr_thread_cond_t *free_cond;
+  apr_pool_t *mpool;
+};
+
+//*****************************************************************
+// Raw syscall wrappers
+//*****************************************************************
+
+int _uring_setup(unsigned entries, struct io_uring_params *p)
+{
+  return(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int _uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  return(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+//*****************************************************************
+// _uring_flush - Hands all the pending SQEs to the kernel.  If another
+//    thread is already submitting it will pick up ours as well.
+//    NOTE: Assumes u->lock is held
+//*****************************************************************
+
+void _uring_flush(osd_uring_t *u)
+{
+  int n, err;
+
+  if (u->submitting == 1) return;
+
+  u->submitting = 1;
+  while (u->n_unsubmitted > 0) {
+     n = u->n_unsubmitted;
+     u->n_unsubmitted = 0;
+     apr_thread_mutex_unlock(u->lock);
+
+     while (n > 0) {
+        err = _uring_enter(u->fd, n, 0, 0);
+        if (err > 0) {
+           n -= err;
+        } else if ((err < 0) && (errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+           log_printf(0, "_uring_flush: ERROR io_uring_enter failed! fd=%d n=%d errno=%d\n", u->fd, n, errno);
+           abort();
+        }
+     }
+
+     apr_thread_mutex_lock(u->lock);
+  }
+  u->submitting = 0;
+}
+
+//*****************************************************************
+// _uring_queue - Places a request on the submission ring and flushes it
+//    NOTE: Assumes u->lock is held
+//*****************************************************************
+
+void _uring_queue(osd_uring_t *u, int opcode, int fd, osd_off_t offset, int slot, uint64_t user_data)
+{
+  struct io_uring_sqe *sqe;
+  unsigned tail, index;
+
+  tail = *(u->sq_tail);
+  index = tail & *(u->sq_mask);
+  sqe = &(u->sqes[index]);
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->off = offset;
+  if (slot >= 0) {
+     sqe->addr = (unsigned long)&(u->slot[slot].iov);
+     sqe->len = 1;
+  }
+  sqe->user_data = user_data;
+  u->sq_array[index] = index;
+
+  __atomic_store_n(u->sq_tail, tail+1, __ATOMIC_RELEASE);
+  u->n_unsubmitted++;
+
+  _uring_flush(u);
+}
+
+//*****************************************************************
+// _uring_reaper_thread - Waits for completions and wakes up the callers
+//*****************************************************************
+
+void *_uring_reaper_thread(apr_thread_t *th, void *data)
+{
+  osd_uring_t *u = (osd_uring_t *)data;
+  struct io_uring_cqe *cqe;
+  uring_slot_t *s;
+  unsigned head, tail;
+  int shutdown;
+
+  shutdown = 0;
+  do {
+     head = *(u->cq_head);
+     tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+     if (head == tail) {
+        _uring_enter(u->fd, 0, 1, IORING_ENTER_GETEVENTS);
+        continue;
+     }
+
+     apr_thread_mutex_lock(u->lock);
+     while (head != tail) {
+        cqe = &(u->cqes[head & *(u->cq_mask)]);
+        if (cqe->user_data == URING_SHUTDOWN) {
+           shutdown = 1;
+        } else {
+           s = &(u->slot[cqe->user_data]);
+           s->res = cqe->res;
+           s->done = 1;
+           apr_thread_cond_signal(s->cond);
+        }
+        head++;
+     }
+     __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+     apr_thread_mutex_unlock(u->lock);
+  } while (shutdown == 0);
+
+  apr_thread_exit(th, 0);
+  return(NULL);
+}
+
+//*****************************************************************
+// _uring_io - Performs a single read or write and returns the result
+//    using the same conventions as pread/pwrite
+//*****************************************************************
+
+osd_off_t _uring_io(osd_uring_t *u, int mode, int fd, void *buffer, osd_off_t len, osd_off_t offset)
+{
+  uring_slot_t *s;
+  int slot, n;
+
+  apr_thread_mutex_lock(u->lock);
+
+  //** Wait for a free slot
+  while (u->n_free == 0) {
+     u->n_waiting++;
+     apr_thread_cond_wait(u->free_cond, u->lock);
+     u->n_waiting--;
+  }
+  u->n_free--;
+  slot = u->free[u->n_free];
+
+  s = &(u->slot[slot]);
+  s->done = 0;
+  s->iov.iov_base = buffer;
+  s->iov.iov_len = len;
+
+  _uring_queue(u, ((mode == OSD_URING_READ) ? IORING_OP_READV : IORING_OP_WRITEV), fd, offset, slot, slot);
+
+  //** Wait for it to complete
+  while (s->done == 0) {
+     apr_thread_cond_wait(s->cond, u->lock);
+  }
+  n = s->res;
+
+  //** Release the slot
+  u->free[u->n_free] = slot;
+  u->n_free++;
+  if (u->n_waiting > 0) apr_thread_cond_signal(u->free_cond);
+
+  apr_thread_mutex_unlock(u->lock);
+
+  if (n < 0) {
+     errno = -n;
+     return(-1);
+  }
+
+  return(n);
+}
+
+//*****************************************************************
+// osd_uring_create - Creates the ring with the given queue depth and
+//    launches the reaper.  Returns NULL if io_uring isn't supported.
+//*****************************************************************
+
+osd_uring_t *osd_uring_create(int depth)
+{
+  osd_uring_t *u;
+  struct io_uring_params p;
+  int i;
+
+  memset(&p, 0, sizeof(p));
+  i = _uring_setup(depth, &p);
+  if (i < 0) {
+     log_printf(0, "osd_uring_create: io_uring_setup failed! depth=%d errno=%d\n", depth, errno);
+     return(NULL);
+  }
+
+  tbx_type_malloc_clear(u, osd_uring_t, 1);
+  u->fd = i;
+  u->depth = p.sq_entries;
+
+  //** Map the rings
+  u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+     if (u->cq_size > u->sq_size) u->sq_size = u->cq_size;
+     u->cq_size = u->sq_size;
+  }
+  u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+  u->sq_ptr = mmap(NULL, u->sq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+     u->cq_ptr = u->sq_ptr;
+  } else {
+     u->cq_ptr = mmap(NULL, u->cq_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+  }
+  u->sqes = mmap(NULL, u->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if ((u->sq_ptr == MAP_FAILED) || (u->cq_ptr == MAP_FAILED) || (u->sqes == MAP_FAILED)) {
+     log_printf(0, "osd_uring_create: mmap failed! errno=%d\n", errno);
+     if (u->sq_ptr != MAP_FAILED) munmap(u->sq_ptr, u->sq_size);
+     if ((u->cq_ptr != MAP_FAILED) && (u->cq_ptr != u->sq_ptr)) munmap(u->cq_ptr, u->cq_size);
+     if (u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+     close(u->fd);
+     free(u);
+     return(NULL);
+  }
+
+  u->sq_head = (unsigned *)((char *)u->sq_ptr + p.sq_off.head);
+  u->sq_tail = (unsigned *)((char *)u->sq_ptr + p.sq_off.tail);
+  u->sq_mask = (unsigned *)((char *)u->sq_ptr + p.sq_off.ring_mask);
+  u->sq_array = (unsigned *)((char *)u->sq_ptr + p.sq_off.array);
+  u->cq_head = (unsigned *)((char *)u->cq_ptr + p.cq_off.head);
+  u->cq_tail = (unsigned *)((char *)u->cq_ptr + p.cq_off.tail);
+  u->cq_mask = (unsigned *)((char *)u->cq_ptr + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)((char *)u->cq_ptr + p.cq_off.cqes);
+
+  //** Set up the slots.  There are never more requests in flight than SQ entries.
+  apr_pool_create(&(u->mpool), NULL);
+  apr_thread_mutex_create(&(u->lock), APR_THREAD_MUTEX_DEFAULT, u->mpool);
+  apr_thread_cond_create(&(u->free_cond), u->mpool);
+  tbx_type_malloc_clear(u->slot, uring_slot_t, u->depth);
+  tbx_type_malloc_clear(u->free, int, u->depth);
+  for (i=0; i<u->depth; i++) {
+     apr_thread_cond_create(&(u->slot[i].cond), u->mpool);
+     u->free[i] = i;
+  }
+  u->n_free = u->depth;
+
+  apr_thread_create(&(u->reaper), NULL, _uring_reaper_thread, (void *)u, u->mpool);
+
+  log_printf(5, "osd_uring_create: fd=%d depth=%d features=%u\n", u->fd, u->depth, p.features);
+
+  return(u);
+}
+
+//*****************************************************************
+// osd_uring_destroy - Stops the reaper and tears down the ring.  There
+//    should be no I/O in flight.
+//*****************************************************************
+
+void osd_uring_destroy(osd_uring_t *u)
+{
+  apr_status_t dummy;
+
+  if (u == NULL) return;
+
+  apr_thread_mutex_lock(u->lock);
+  _uring_queue(u, IORING_OP_NOP, -1, 0, -1, URING_SHUTDOWN);
+  apr_thread_mutex_unlock(u->lock);
+  apr_thread_join(&dummy, u->reaper);
+
+  munmap(u->sqes, u->sqes_size);
+  if (u->cq_ptr != u->sq_ptr) munmap(u->cq_ptr, u->cq_size);
+  munmap(u->sq_ptr, u->sq_size);
+  close(u->fd);
+
+  apr_pool_destroy(u->mpool);
+  free(u->slot);
+  free(u->free);
+  free(u);
+}
+
+#else  //** No io_uring support so everything goes through pread/pwrite
+
+struct osd_uring_s {
+  int dummy;
+};
+
+osd_uring_t *osd_uring_create(int depth)
+{
+  log_printf(0, "osd_uring_create: io_uring support not compiled in!\n");
+  return(NULL);
+}
+
+void osd_uring_destroy(osd_uring_t *u)
+{
+  return;
+}
+
+osd_off_t _uring_io(osd_uring_t *u, int mode, int fd, void *buffer, osd_off_t len, osd_off_t offset)
+{
+  return(-1);
+}
+
+#endif
+
+//*****************************************************************
+// osd_uring_rw - Reads or writes len bytes at offset.  Short transfers
+//    are retried so the full length is returned unless there's an error
+//    or EOF.  If u is NULL pread/pwrite are used.
+//*****************************************************************
+
+osd_off_t osd_uring_rw(osd_uring_t *u, int mode, int fd, void *buffer, osd_off_t len, osd_off_t offset)
+{
+  char *buf = (char *)buffer;
+  osd_off_t pos, n, nleft, chunk;
+
+  pos = 0;
+  nleft = len;
+  while (nleft > 0) {
+     chunk = (nleft > URING_MAX_IO) ? URING_MAX_IO : nleft;
+     if (u != NULL) {
+        n = _uring_io(u, mode, fd, &(buf[pos]), chunk, offset+pos);
+     } else if (mode == OSD_URING_READ) {
+        n = pread(fd, &(buf[pos]), chunk, offset+pos);
+     } else {
+        n = pwrite(fd, &(buf[pos]), chunk, offset+pos);
+     }
+
+     if (n < 0) {
+        if (errno == EINTR) continue;
+        return((pos > 0) ? pos : -1);
+     } else if (n == 0) {  //** EOF
+        break;
+     }
+
+     pos += n;
+     nleft -= n;
+  }
+
+  return(pos);
+}
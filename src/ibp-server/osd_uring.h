@@ -0,0 +1,41 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// osd_uring - io_uring submission layer used by the osd drivers.
+//    Requests from any number of threads are batched into the
+//    submission ring and a single reaper thread wakes the callers
+//    as their completions arrive.  If io_uring isn't available
+//    osd_uring_create() returns NULL and osd_uring_rw() falls back
+//    to pread/pwrite.
+//*****************************************************************
+
+#ifndef _OSD_URING_H
+#define _OSD_URING_H
+
+#include "visibility.h"
+#include "osd_abstract.h"
+
+#define OSD_URING_READ  0
+#define OSD_URING_WRITE 1
+
+typedef struct osd_uring_s osd_uring_t;
+
+IBPS_API osd_uring_t *osd_uring_create(int depth);
+IBPS_API void osd_uring_destroy(osd_uring_t *u);
+IBPS_API osd_off_t osd_uring_rw(osd_uring_t *u, int mode, int fd, void *buffer, osd_off_t len, osd_off_t offset);
+
+#endif
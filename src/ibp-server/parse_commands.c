@@ -17,6 +17,7 @@
 //*****************************************************************
 //*****************************************************************
 
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <apr_time.h>
@@ -32,6 +33,7 @@
 #include "ibp_time.h"
 #include <tbx/network.h>
 #include <tbx/chksum.h>
+#include <tbx/type_malloc.h>
 
 //*****************************************************************
 // get_command_timeout - Gets the command timeout from the NS
@@ -159,10 +161,11 @@ int read_allocate(ibp_task_t *task, char **bstate)
 
    //** Parse the chksumming options if applicable
    if (cmd->version > IBPv031) {
-      if ((cmd->command == IBP_ALLOCATE_CHKSUM) || (cmd->command == IBP_SPLIT_ALLOCATE_CHKSUM)) {
+      if ((cmd->command == IBP_ALLOCATE_CHKSUM) || (cmd->command == IBP_SPLIT_ALLOCATE_CHKSUM) || (cmd->command == IBP_BULK_ALLOCATE)) {
          d = -1; sscanf(tbx_stk_string_token(NULL, " ", bstate, &fin), "%d", &d);
          ca->cs_type = d;
-         if ((tbx_chksum_type_valid(d) == 0) && (d!=CHKSUM_NONE)) {
+         if ((tbx_chksum_type_valid(d) == 0) && (d!=CHKSUM_NONE) &&
+             !((cmd->command == IBP_BULK_ALLOCATE) && (d == -1))) {  //** Bulk allocations can use the resource default
             log_printf(10, "read_allocate: bad chksum_type=%d\n", d);
             send_cmd_result(task, IBP_E_CHKSUM_TYPE);
             return(-1);
@@ -170,7 +173,7 @@ int read_allocate(ibp_task_t *task, char **bstate)
 
          len = 0; sscanf(tbx_stk_string_token(NULL, " ", bstate, &fin),  I64T, &len);
          ca->cs_blocksize = len;
-         if ((len > (int64_t)2147483648) || ((len <= 0) && (d!= CHKSUM_NONE))) {
+         if ((len > (int64_t)2147483648) || ((len <= 0) && (d > CHKSUM_NONE))) {
             log_printf(10, "read_allocate: bad chksum blocksize =" I64T "\n", len);
             send_cmd_result(task, IBP_E_CHKSUM_BLOCKSIZE);
             return(-1);
@@ -272,6 +275,39 @@ log_printf(1, "read_allocate: size : " I64T "\n", len);
    return(0);
 }
 
+//*****************************************************************
+// read_bulk_allocate - Reads a bulk allocate command.  The fields after
+//    the count are the same as for IBP_ALLOCATE_CHKSUM and every
+//    allocation gets the same attributes.
+//
+//    version IBP_BULK_ALLOCATE n chksum_type blocksize RID IBP_SOFT|IBP_HARD TYPE DURATION SIZE TIMEOUT \n
+//      %d             %d       %d      %d      int32   %d      %d         %d     %ll   %llu   %d
+//
+//    The chksum_type can be CHKSUM_NONE or -1 to use the resource default
+//*****************************************************************
+
+int read_bulk_allocate(ibp_task_t *task, char **bstate)
+{
+   int n, fin;
+   Cmd_allocate_t *ca = &(task->cmd.cargs.allocate);
+
+   fin = 0;
+
+   debug_printf(1, "read_bulk_allocate:  Starting to process buffer\n");
+
+   n = -1; sscanf(tbx_stk_string_token(NULL, " ", bstate, &fin), "%d", &n);
+   if ((n <= 0) || (n > IBP_MAX_BULK)) {
+      log_printf(10, "read_bulk_allocate: Bad allocation count n=%d\n", n);
+      send_cmd_result(task, IBP_E_INVALID_PARAMETER);
+      return(-1);
+   }
+
+   if (read_allocate(task, bstate) != 0) return(-1);
+
+   ca->n = n;
+   return(0);
+}
+
 //*****************************************************************
 // read_merge_allocate - Merges 2 allocations if possible. The child
 //    allocation is removed if successful.
@@ -652,6 +688,88 @@ int read_manage(ibp_task_t *task, char **bstate)
 }
 
 
+//*****************************************************************
+//  read_bulk_manage - Reads an ibp_bulk_manage command.  All the keys
+//     must be on the same RID and are sent without the RID prefix or
+//     the typekey.
+//
+//    version IBP_BULK_MANAGE RID IBP_PROBE|IBP_CHNG|IBP_DECR n duration key_1 ... key_n timeout \n
+//
+//    The duration is only used by IBP_CHNG.  -1 requests the maximum allowed.
+//*****************************************************************
+
+int read_bulk_manage(ibp_task_t *task, char **bstate)
+{
+   int d, i, finished;
+   Cmd_bulk_manage_t *bm = &(task->cmd.cargs.bulk_manage);
+
+   finished = 0;
+
+   debug_printf(1, "read_bulk_manage:  Starting to process buffer\n");
+
+   //** Get the RID
+   bm->crid[sizeof(bm->crid)-1] = '\0';
+   strncpy(bm->crid, tbx_stk_string_token(NULL, " ", bstate, &finished), sizeof(bm->crid)-1);
+   if (ibp_str2rid(bm->crid, &(bm->rid)) != 0) {
+      log_printf(1, "read_bulk_manage: Bad RID: %s\n", bm->crid);
+      send_cmd_result(task, IBP_E_INVALID_RID);
+      return(-1);
+   }
+
+   //*** Get the subcommand ***
+   d = -1; sscanf(tbx_stk_string_token(NULL, " ", bstate, &finished), "%d", &d);
+   if ((d != IBP_DECR) && (d != IBP_CHNG) && (d != IBP_PROBE)) {
+      log_printf(1, "read_bulk_manage: Unknown sub-command %d\n", d);
+      send_cmd_result(task, IBP_E_BAD_FORMAT);
+      return(-1);
+   }
+   bm->subcmd = d;
+
+   //** and the number of keys
+   d = -1; sscanf(tbx_stk_string_token(NULL, " ", bstate, &finished), "%d", &d);
+   if ((d <= 0) || (d > IBP_MAX_BULK)) {
+      log_printf(1, "read_bulk_manage: Bad key count n=%d\n", d);
+      send_cmd_result(task, IBP_E_INVALID_PARAMETER);
+      return(-1);
+   }
+   bm->n = d;
+
+   //**Read the new duration
+   d = 0; sscanf(tbx_stk_string_token(NULL, " ", bstate, &finished), "%d", &d);
+   bm->new_duration = -1;
+   if (bm->subcmd == IBP_CHNG) {
+      if (d == 0) {
+         log_printf(1, "read_bulk_manage: Bad duration: %d\n", d);
+         send_cmd_result(task, IBP_E_INVALID_PARAMETER);
+         return(-1);
+      } else if (d == -1) {  //** Max duration is requested
+         bm->new_duration = INT_MAX;
+      } else {
+         bm->new_duration = ibp_time_now() + d;
+      }
+   }
+
+   //** Get the keys
+   tbx_type_malloc(bm->cap, Cap_t, bm->n);
+   for (i=0; i<bm->n; i++) {
+      bm->cap[i].v[sizeof(bm->cap[i].v)-1] = '\0';
+      strncpy(bm->cap[i].v, tbx_stk_string_token(NULL, " ", bstate, &finished), sizeof(bm->cap[i].v)-1);
+      if (finished == 1) {
+         log_printf(1, "read_bulk_manage: Ran out of keys! got=%d n=%d\n", i, bm->n);
+         send_cmd_result(task, IBP_E_BAD_FORMAT);
+         free(bm->cap);
+         bm->cap = NULL;
+         return(-1);
+      }
+   }
+
+   get_command_timeout(task, bstate);
+
+   debug_printf(1, "read_bulk_manage: Successfully parsed command.  subcmd=%d n=%d\n", bm->subcmd, bm->n);
+   return(0);
+}
+
+
 //*****************************************************************
 //  read_rename - Reads an ibp_rename command
 //
@@ -0,0 +1,759 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// proto_v2 - Binary framed wire protocol.  A client switches a
+//    connection over with the text command
+//
+//        version IBP_PROTOCOL max_version timeout \n
+//
+//    and the depot replies with "IBP_OK version \n".  If version 2 is
+//    chosen the rest of the connection uses frames.  Each request
+//    carries an ID and requests are executed by a pool of threads
+//    shared by all the connections so replies can go back in a
+//    different order than the requests arrived.  Requests for the
+//    same cap are always executed in the order they arrived.  All
+//    integers are little endian.
+//
+//    Request: u32 id, u16 command, u16 key_len, u32 n_iovec,
+//             u32 timeout, u64 total_len
+//             key[key_len] (RID#key), n_iovec * (u64 offset, u64 len)
+//             total_len bytes of data for IBP_WRITE
+//    Reply:   u32 id, i32 status, u64 nbytes
+//             nbytes of data for a successful IBP_LOAD
+//
+//    Only IBP_LOAD and IBP_WRITE are supported.  Both accept an
+//    I/O vector so they also cover the vec read/write commands.
+//*****************************************************************
+
+#include <stdlib.h>
+#include <string.h>
+#include <apr_thread_mutex.h>
+#include <tbx/fmttypes.h>
+#include <tbx/log.h>
+#include <tbx/network.h>
+#include <tbx/string_token.h>
+#include <tbx/type_malloc.h>
+#include "ibp_server.h"
+#include "ibp_task.h"
+#include "ibp_protocol.h"
+#include "debug.h"
+#include "allocation.h"
+#include "resource.h"
+#include "lock_alloc.h"
+#include "activity_log.h"
+#include "proto_v2_exec.h"
+
+#define V2_MAX_KEY 1024
+
+typedef struct {
+  int max_version;     //** Highest protocol version offered.  1 disables the binary protocol
+  int threads;         //** Executor threads shared by all the connections
+  int max_pending;     //** Max requests queued per connection before the reader blocks
+  int64_t buffer_size; //** Largest transfer handled from memory.  Larger ones are streamed inline
+} v2_config_t;
+
+static v2_config_t v2_cfg = { IBP_PROTO_V2, 16, 64, 4*1048576 };
+static v2_exec_t *v2_pool = NULL;
+
+typedef struct {
+  ibp_off_t off;
+  ibp_off_t len;
+} v2_iov_t;
+
+typedef struct v2_session_s v2_session_t;
+
+typedef struct {
+  v2_session_t *s;     //** Connection the request came in on
+  uint32_t id;         //** Client's request ID
+  int command;         //** IBP_LOAD or IBP_WRITE
+  int n_iov;           //** Number of I/O vec entries
+  ibp_off_t total;     //** Total bytes transferred
+  apr_time_t expire;   //** When the request times out
+  char key[V2_MAX_KEY+1];  //** RID#key
+  v2_iov_t *iov;
+  char *data;          //** Write data if it was buffered
+} v2_request_t;
+
+struct v2_session_s {        //** Attached to the connection as its app data
+  ibp_task_t task;           //** Copy of the connection's task.  Under epoll the original goes away when the connection is parked
+  v2_exec_group_t *group;    //** Requests waiting on or running in the shared executors
+  apr_thread_mutex_t *lock;  //** Serializes reply frames
+  apr_pool_t *mpool;
+  int n_requests;            //** Requests read so far
+  int dead;                  //** Set once the connection has failed
+};
+
+//*****************************************************************
+// Little endian helpers
+//*****************************************************************
+
+static void v2_put32(unsigned char *b, uint32_t n) { b[0] = n; b[1] = n>>8; b[2] = n>>16; b[3] = n>>24; }
+static void v2_put64(unsigned char *b, uint64_t n) { v2_put32(b, n); v2_put32(b+4, n>>32); }
+static uint16_t v2_get16(const unsigned char *b) { return(b[0] | (b[1]<<8)); }
+static uint32_t v2_get32(const unsigned char *b) { return(b[0] | (b[1]<<8) | (b[2]<<16) | ((uint32_t)b[3]<<24)); }
+static uint64_t v2_get64(const unsigned char *b) { return(v2_get32(b) | ((uint64_t)v2_get32(b+4) << 32)); }
+
+//*****************************************************************
+// proto_v2_load_config - Loads the [ibp_protocol] section
+//*****************************************************************
+
+void proto_v2_load_config(tbx_inip_file_t *kf)
+{
+  v2_cfg.max_version = tbx_inip_get_integer(kf, "ibp_protocol", "max_version", v2_cfg.max_version);
+  v2_cfg.threads = tbx_inip_get_integer(kf, "ibp_protocol", "threads", v2_cfg.threads);
+  v2_cfg.max_pending = tbx_inip_get_integer(kf, "ibp_protocol", "max_pending", v2_cfg.max_pending);
+  v2_cfg.buffer_size = tbx_inip_get_integer(kf, "ibp_protocol", "buffer_size", v2_cfg.buffer_size);
+
+  if (v2_cfg.max_version > IBP_PROTO_V2) v2_cfg.max_version = IBP_PROTO_V2;
+  if (v2_cfg.threads < 1) v2_cfg.threads = 1;
+  if (v2_cfg.max_pending < 1) v2_cfg.max_pending = 1;
+  if (v2_cfg.buffer_size < 65536) v2_cfg.buffer_size = 65536;
+}
+
+//*****************************************************************
+// proto_v2_init - Launches the shared executors
+//*****************************************************************
+
+void proto_v2_init()
+{
+  if (v2_cfg.max_version < IBP_PROTO_V2) return;  //** Binary protocol is disabled
+
+  v2_pool = v2_exec_create(v2_cfg.threads);
+}
+
+//*****************************************************************
+// proto_v2_destroy - Shuts down the shared executors
+//*****************************************************************
+
+void proto_v2_destroy()
+{
+  if (v2_pool == NULL) return;
+
+  v2_exec_destroy(v2_pool);
+  v2_pool = NULL;
+}
+
+//*****************************************************************
+// proto_v2_print - Prints the [ibp_protocol] section
+//*****************************************************************
+
+int proto_v2_print(char *buffer, int *used, int nbytes)
+{
+  tbx_append_printf(buffer, used, nbytes, "[ibp_protocol]\n");
+  tbx_append_printf(buffer, used, nbytes, "max_version = %d\n", v2_cfg.max_version);
+  tbx_append_printf(buffer, used, nbytes, "threads = %d\n", v2_cfg.threads);
+  tbx_append_printf(buffer, used, nbytes, "max_pending = %d\n", v2_cfg.max_pending);
+  return(tbx_append_printf(buffer, used, nbytes, "buffer_size = " I64T "\n\n", v2_cfg.buffer_size));
+}
+
+//*****************************************************************
+// read_protocol - Parses the IBP_PROTOCOL command
+//*****************************************************************
+
+int read_protocol(ibp_task_t *task, char **bstate)
+{
+  Cmd_state_t *cmd = &(task->cmd);
+  int finished, version;
+
+  version = 0;
+  sscanf(tbx_stk_string_token(NULL, " ", bstate, &finished), "%d", &version);
+  if (version < IBP_PROTO_V1) {
+     log_printf(10, "read_protocol: Invalid version (%d)!\n", version);
+     send_cmd_result(task, IBP_E_INVALID_PARAMETER);
+     return(-1);
+  }
+  cmd->cargs.protocol.version = version;
+
+  get_command_timeout(task, bstate);
+
+  return(0);
+}
+
+//*****************************************************************
+// v2_send_reply - Sends a reply frame header.  The caller must hold
+//    the session lock if anything else is appended to the frame.
+//*****************************************************************
+
+int v2_send_reply(v2_session_t *s, v2_request_t *req, int status, ibp_off_t nbytes)
+{
+  unsigned char hdr[IBP_V2_RESP_HEADER];
+
+  v2_put32(hdr, req->id);
+  v2_put32(hdr+4, (uint32_t)status);
+  v2_put64(hdr+8, nbytes);
+
+  if (server_ns_write_block(s->task.ns, req->expire, (char *)hdr, IBP_V2_RESP_HEADER) != NS_OK) {
+     log_printf(10, "v2_send_reply: ns=%d id=%u Dead connection!\n", tbx_ns_getid(s->task.ns), req->id);
+     s->dead = 1;
+     return(-1);
+  }
+
+  return(0);
+}
+
+//*****************************************************************
+// v2_open - Validates the request and opens the allocation.  This
+//    mirrors the checks done by handle_read()/handle_write().
+//*****************************************************************
+
+int v2_open(v2_session_t *s, v2_request_t *req, Resource_t **rp, Allocation_t *a, osd_fd_t **fdp, osd_id_t *pidp)
+{
+  int cap_type = (req->command == IBP_WRITE) ? WRITE_CAP : READ_CAP;
+  int mode = (req->command == IBP_WRITE) ? RES_MODE_WRITE : RES_MODE_READ;
+  char *bstate;
+  char crid[128];
+  int fin, i;
+  rid_t rid;
+  Cap_t cap;
+  Resource_t *r;
+  osd_fd_t *fd;
+  ibp_off_t alias_offset, alias_len;
+
+  *fdp = NULL;
+  *rp = NULL;
+
+  if (s->task.command_acl[req->command] == 0) return(IBP_E_UNKNOWN_FUNCTION);
+
+  if (ibp_str2rid(tbx_stk_string_token(req->key, "#", &bstate, &fin), &rid) != 0) return(IBP_E_INVALID_RID);
+  cap.v[sizeof(cap.v)-1] = '\0';
+  strncpy(cap.v, tbx_stk_string_token(NULL, " ", &bstate, &fin), sizeof(cap.v)-1);
+
+  r = resource_lookup(global_config->rl, ibp_rid2str(rid, crid));
+  if (r == NULL) return(IBP_E_INVALID_RID);
+  if ((resource_get_mode(r) & mode) == 0) return((req->command == IBP_WRITE) ? IBP_E_FILE_WRITE : IBP_E_FILE_READ);
+  if (get_allocation_by_cap_resource(r, cap_type, &cap, a) != 0) return(IBP_E_CAP_NOT_FOUND);
+
+  *pidp = a->id;
+  alias_offset = 0;
+  alias_len = a->max_size;
+  if (a->is_alias == 1) {  //** Load the actual allocation
+     alias_offset = a->alias_offset;
+     alias_len = a->alias_size;
+     if (get_allocation_resource(r, a->alias_id, a) != 0) return(IBP_E_CAP_NOT_FOUND);
+     if (alias_len == 0) alias_len = a->max_size - alias_offset;
+  }
+
+  if (a->type != IBP_BYTEARRAY) return(IBP_E_TYPE_NOT_SUPPORTED);
+
+  //** Validate the range.  Checked against the alias 1st so the shifted offset can't overflow
+  for (i=0; i<req->n_iov; i++) {
+     if (v2_range_check(req->iov[i].off, req->iov[i].len, alias_len) != 0) return(IBP_E_WOULD_EXCEED_LIMIT);
+     req->iov[i].off += alias_offset;
+     if (v2_range_check(req->iov[i].off, req->iov[i].len, a->max_size) != 0) return(IBP_E_WOULD_EXCEED_LIMIT);
+     if ((req->command == IBP_LOAD) && (v2_range_check(req->iov[i].off, req->iov[i].len, a->size) != 0)) return(IBP_E_WOULD_EXCEED_LIMIT);
+  }
+
+  fd = open_allocation(r, a->id, (req->command == IBP_WRITE) ? OSD_WRITE_MODE : OSD_READ_MODE);
+  if (fd == NULL) return((req->command == IBP_WRITE) ? IBP_E_FILE_WRITE : IBP_E_FILE_READ);
+  if (get_allocation_state(r, fd) != OSD_STATE_GOOD) {
+     close_allocation(r, fd);
+     return(IBP_E_CHKSUM);
+  }
+
+  *rp = r;
+  *fdp = fd;
+  return(IBP_OK);
+}
+
+//*****************************************************************
+// v2_iov_io - Reads or writes a slice of the request's I/O vector.
+//    pos is the logical position in the request's data stream.
+//*****************************************************************
+
+int v2_iov_io(v2_request_t *req, Resource_t *r, osd_fd_t *fd, ibp_off_t pos, ibp_off_t len, char *buffer)
+{
+  int i;
+  ibp_off_t start, n, bpos, err;
+
+  start = 0;
+  bpos = 0;
+  for (i=0; (i<req->n_iov) && (len > 0); i++) {
+     if (pos < start + req->iov[i].len) {
+        n = start + req->iov[i].len - pos;
+        if (n > len) n = len;
+        if (req->command == IBP_WRITE) {
+           err = write_allocation(r, fd, req->iov[i].off + pos - start, n, buffer + bpos);
+        } else {
+           err = read_allocation(r, fd, req->iov[i].off + pos - start, n, buffer + bpos);
+        }
+        if (err != 0) return(-1);
+        pos += n;
+        bpos += n;
+        len -= n;
+     }
+     start += req->iov[i].len;
+  }
+
+  return(0);
+}
+
+//*****************************************************************
+// v2_load - Executes an IBP_LOAD request.  Small transfers are read
+//    before taking the reply lock so other replies can go out while
+//    the disk is busy.  Larger ones are streamed under the lock.
+//*****************************************************************
+
+void v2_load(v2_session_t *s, v2_request_t *req)
+{
+  ibp_task_t *task = &(s->task);
+  Resource_t *r;
+  Allocation_t a;
+  osd_fd_t *fd;
+  osd_id_t pid;
+  Transfer_stat_t stat;
+  char *buffer;
+  ibp_off_t pos, n, bsize;
+  int status, err;
+
+  clear_stat(&stat);
+  stat.start = ibp_time_now();
+  stat.dir = DIR_OUT;
+  stat.id = req->id;
+  strncpy(stat.address, tbx_ns_peer_address_get(task->ns), sizeof(stat.address)-1);
+
+  status = v2_open(s, req, &r, &a, &fd, &pid);
+  if (status != IBP_OK) {
+     log_printf(10, "v2_load: ns=%d id=%u key=%s status=%d\n", tbx_ns_getid(task->ns), req->id, req->key, status);
+     apr_thread_mutex_lock(s->lock);
+     v2_send_reply(s, req, status, 0);
+     apr_thread_mutex_unlock(s->lock);
+     return;
+  }
+
+  alog_append_read(task->myid, r->rl_index, ((pid == a.id) ? 0 : pid), a.id, req->iov[0].off, req->iov[0].len);
+
+  bsize = (req->total < v2_cfg.buffer_size) ? req->total : v2_cfg.buffer_size;
+  tbx_type_malloc(buffer, char, bsize);
+
+  err = 0;
+  if (req->total <= bsize) {  //** Fits in memory
+     if (v2_iov_io(req, r, fd, 0, req->total, buffer) != 0) status = IBP_E_FILE_READ;
+     apr_thread_mutex_lock(s->lock);
+     if (v2_send_reply(s, req, status, ((status == IBP_OK) ? req->total : 0)) == 0) {
+        if (status == IBP_OK) err = server_ns_write_block(task->ns, req->expire, buffer, req->total);
+     }
+     apr_thread_mutex_unlock(s->lock);
+  } else {
+     apr_thread_mutex_lock(s->lock);
+     if (v2_send_reply(s, req, status, req->total) == 0) {
+        for (pos=0; (pos<req->total) && (err == 0); pos += n) {
+           n = req->total - pos;
+           if (n > bsize) n = bsize;
+           err = v2_iov_io(req, r, fd, pos, n, buffer);
+           if (err == 0) err = server_ns_write_block(task->ns, req->expire, buffer, n);
+        }
+     }
+     apr_thread_mutex_unlock(s->lock);
+  }
+
+  free(buffer);
+
+  if (err != 0) {  //** The frame is incomplete so the connection has to go
+     log_printf(10, "v2_load: ns=%d id=%u Error sending data!\n", tbx_ns_getid(task->ns), req->id);
+     alog_append_cmd_result(task->myid, IBP_E_SOCK_WRITE);
+     s->dead = 1;
+  } else {
+     alog_append_cmd_result(task->myid, status);
+     stat.nbytes = req->total;
+     add_stat(&stat);
+  }
+
+  lock_osd_id(a.id);
+  update_read_history(r, a.id, a.is_alias, &(task->ipadd), req->iov[0].off, req->iov[0].len, pid);
+  unlock_osd_id(a.id);
+
+  close_allocation(r, fd);
+}
+
+//*****************************************************************
+// v2_write - Executes an IBP_WRITE request.  If the data wasn't
+//    buffered by the reader it's pulled off the connection here.
+//*****************************************************************
+
+void v2_write(v2_session_t *s, v2_request_t *req)
+{
+  ibp_task_t *task = &(s->task);
+  Resource_t *r;
+  Allocation_t a, a_final;
+  osd_fd_t *fd;
+  osd_id_t pid;
+  Transfer_stat_t stat;
+  char *buffer;
+  ibp_off_t pos, n, bsize, end;
+  int status, err, i;
+
+  clear_stat(&stat);
+  stat.start = ibp_time_now();
+  stat.dir = DIR_IN;
+  stat.id = req->id;
+  strncpy(stat.address, tbx_ns_peer_address_get(task->ns), sizeof(stat.address)-1);
+
+  status = v2_open(s, req, &r, &a, &fd, &pid);
+  if (status == IBP_OK) {
+     alog_append_write(task->myid, IBP_WRITE, r->rl_index, ((pid == a.id) ? 0 : pid), a.id, req->iov[0].off, req->iov[0].len);
+  } else {
+     log_printf(10, "v2_write: ns=%d id=%u key=%s status=%d\n", tbx_ns_getid(task->ns), req->id, req->key, status);
+  }
+
+  err = 0;
+  if (req->data != NULL) {
+     if ((status == IBP_OK) && (v2_iov_io(req, r, fd, 0, req->total, req->data) != 0)) status = IBP_E_FILE_WRITE;
+  } else {  //** Stream it.  The data has to be drained even on an error to keep the frames in sync
+     bsize = v2_cfg.buffer_size;
+     tbx_type_malloc(buffer, char, bsize);
+     for (pos=0; (pos<req->total) && (err == 0); pos += n) {
+        n = req->total - pos;
+        if (n > bsize) n = bsize;
+        err = server_ns_read_block(task->ns, req->expire, buffer, n);
+        if ((err == 0) && (status == IBP_OK) && (v2_iov_io(req, r, fd, pos, n, buffer) != 0)) status = IBP_E_FILE_WRITE;
+     }
+     free(buffer);
+  }
+
+  if (err != 0) {
+     log_printf(10, "v2_write: ns=%d id=%u Error reading data!\n", tbx_ns_getid(task->ns), req->id);
+     s->dead = 1;
+     status = IBP_E_SOCK_READ;
+  } else if (status == IBP_OK) {  //** Update the size if needed
+     end = 0;
+     for (i=0; i<req->n_iov; i++) {
+        if (end < (req->iov[i].off + req->iov[i].len)) end = req->iov[i].off + req->iov[i].len;
+     }
+
+     lock_osd_id(a.id);
+     update_write_history(r, a.id, a.is_alias, &(task->ipadd), req->iov[0].off, req->iov[0].len, pid);
+     if (get_allocation_resource(r, a.id, &a_final) == 0) {
+        if (end > (ibp_off_t)a_final.size) {
+           a_final.size = end;
+           if (modify_allocation_resource(r, a.id, &a_final) != 0) status = IBP_E_INTERNAL;
+        }
+     } else {
+        status = IBP_E_INTERNAL;
+     }
+     unlock_osd_id(a.id);
+
+     if ((status == IBP_OK) && (get_allocation_state(r, fd) != OSD_STATE_GOOD)) status = IBP_E_CHKSUM;
+
+     stat.nbytes = req->total;
+     add_stat(&stat);
+  }
+
+  if (fd != NULL) close_allocation(r, fd);
+
+  if (status == IBP_OK) alog_append_cmd_result(task->myid, status);
+
+  if (s->dead == 0) {  //** On an error nothing is reported as committed even if some of it made it to disk
+     apr_thread_mutex_lock(s->lock);
+     v2_send_reply(s, req, status, ((status == IBP_OK) ? req->total : 0));
+     apr_thread_mutex_unlock(s->lock);
+  }
+}
+
+//*****************************************************************
+// v2_execute - Runs a request and frees it
+//*****************************************************************
+
+void v2_execute(v2_session_t *s, v2_request_t *req)
+{
+  if (s->dead == 0) {
+     if (req->command == IBP_WRITE) {
+        v2_write(s, req);
+     } else {
+        v2_load(s, req);
+     }
+  }
+
+  if (req->data != NULL) free(req->data);
+  free(req->iov);
+  free(req);
+}
+
+//*****************************************************************
+// v2_exec_request - Runs a request on one of the shared executors
+//*****************************************************************
+
+void v2_exec_request(void *arg)
+{
+  v2_request_t *req = (v2_request_t *)arg;
+
+  v2_execute(req->s, req);
+}
+
+//*****************************************************************
+// v2_read_request - Reads the next request off the connection.
+//    Returns 1 if there isn't a request waiting, -1 on a protocol or
+//    connection error, and 0 on success.  If park=1 it only checks
+//    for a request that's already arrived so the connection can be
+//    handed back to the epoll engine.  Otherwise it waits until the
+//    connection has been idle too long.
+//*****************************************************************
+
+int v2_read_request(v2_session_t *s, v2_request_t **req_out, int park)
+{
+  tbx_ns_t *ns = s->task.ns;
+  unsigned char hdr[IBP_V2_REQ_HEADER];
+  unsigned char *iov;
+  v2_request_t *req;
+  tbx_ns_timeout_t dt;
+  apr_time_t idle, expire;
+  ibp_off_t total;
+  int n, nbytes, key_len, i;
+
+  *req_out = NULL;
+
+  //** Wait for the start of a frame
+  if (park == 1) {
+     tbx_ns_timeout_set(&dt, 0, 1000);
+  } else {
+     tbx_ns_timeout_set(&dt, 1, 0);
+  }
+  idle = apr_time_now() + global_config->server.min_idle;
+  n = 0;
+  do {
+     nbytes = server_ns_read(ns, (char *)hdr, IBP_V2_REQ_HEADER, dt);
+     if (nbytes < 0) return(-1);
+     n = nbytes;
+     if ((n == 0) && ((park == 1) || (apr_time_now() > idle) || (shutdown_request() == 1) || (request_task_close() == 1))) return(1);
+  } while (n == 0);
+
+  expire = apr_time_now() + global_config->server.timeout;
+  if (n < IBP_V2_REQ_HEADER) {
+     if (server_ns_read_block(ns, expire, (char *)hdr + n, IBP_V2_REQ_HEADER - n) != NS_OK) return(-1);
+  }
+
+  tbx_type_malloc_clear(req, v2_request_t, 1);
+  req->s = s;
+  req->id = v2_get32(hdr);
+  req->command = v2_get16(hdr+4);
+  key_len = v2_get16(hdr+6);
+  req->n_iov = v2_get32(hdr+8);
+  req->expire = apr_time_now() + apr_time_from_sec(v2_get32(hdr+12));
+  req->total = v2_get64(hdr+16);
+
+  if (((req->command != IBP_LOAD) && (req->command != IBP_WRITE)) || (key_len > V2_MAX_KEY) ||
+      (req->n_iov < 1) || (req->n_iov > IOVEC_MAX) || (req->total < 0)) {
+     log_printf(1, "v2_read_request: ns=%d Bad frame! id=%u command=%d key_len=%d n_iov=%d\n", tbx_ns_getid(ns), req->id, req->command, key_len, req->n_iov);
+     free(req);
+     return(-1);
+  }
+
+  //** Get the key and I/O vec
+  n = 16*req->n_iov;
+  tbx_type_malloc(iov, unsigned char, n);
+  tbx_type_malloc(req->iov, v2_iov_t, req->n_iov);
+  if ((server_ns_read_block(ns, expire, req->key, key_len) != NS_OK) ||
+      (server_ns_read_block(ns, expire, (char *)iov, n) != NS_OK)) {
+     free(iov);
+     free(req->iov);
+     free(req);
+     return(-1);
+  }
+  req->key[key_len] = '\0';
+
+  nbytes = 0;
+  total = 0;
+  for (i=0; i<req->n_iov; i++) {
+     req->iov[i].off = v2_get64(iov + 16*i);
+     req->iov[i].len = v2_get64(iov + 16*i + 8);
+     if ((req->iov[i].len < 1) || (v2_range_check(req->iov[i].off, req->iov[i].len, INT64_MAX) != 0) ||
+         (v2_range_check(total, req->iov[i].len, INT64_MAX) != 0)) {
+        nbytes = 1;
+        break;
+     }
+     total += req->iov[i].len;
+  }
+  free(iov);
+
+  if ((nbytes != 0) || (total != req->total)) {  //** The lengths don't add up
+     log_printf(1, "v2_read_request: ns=%d id=%u Bad I/O vec!\n", tbx_ns_getid(ns), req->id);
+     free(req->iov);
+     free(req);
+     return(-1);
+  }
+
+  //** Buffer the write data if it's small enough
+  if ((req->command == IBP_WRITE) && (req->total <= v2_cfg.buffer_size)) {
+     tbx_type_malloc(req->data, char, req->total);
+     if (server_ns_read_block(ns, req->expire, req->data, req->total) != NS_OK) {
+        free(req->data);
+        free(req->iov);
+        free(req);
+        return(-1);
+     }
+  }
+
+  *req_out = req;
+  return(0);
+}
+
+//*****************************************************************
+// v2_dispatch - Hands the request off to the executors.  Requests for
+//    the same cap are run in the order they arrived.
+//*****************************************************************
+
+void v2_dispatch(v2_session_t *s, v2_request_t *req)
+{
+  s->n_requests++;
+
+  if ((req->command == IBP_WRITE) && (req->data == NULL)) {
+     //** The data is still on the wire so do it here once the cap's earlier requests are done
+     v2_exec_wait_key(s->group, req->key);
+     v2_execute(s, req);
+  } else {
+     v2_exec_submit(s->group, req->key, v2_exec_request, req);
+  }
+}
+
+//*****************************************************************
+// v2_session_destroy - Called when the connection is closed.  Waits
+//    for the requests still on the executors since they reference it.
+//*****************************************************************
+
+void v2_session_destroy(void *arg)
+{
+  v2_session_t *s = (v2_session_t *)arg;
+
+  v2_exec_group_destroy(s->group);
+
+  log_printf(5, "v2_session_destroy: ns=%d n_requests=%d dead=%d\n", tbx_ns_getid(s->task.ns), s->n_requests, s->dead);
+
+  apr_thread_mutex_destroy(s->lock);
+  apr_pool_destroy(s->mpool);
+  free(s);
+}
+
+//*****************************************************************
+// v2_session_create - Creates the session and attaches it to the
+//    task's connection
+//*****************************************************************
+
+v2_session_t *v2_session_create(ibp_task_t *task)
+{
+  v2_session_t *s;
+
+  tbx_type_malloc_clear(s, v2_session_t, 1);
+  s->task.ns = task->ns;
+  s->task.net = task->net;
+  s->task.myid = task->myid;
+  s->task.ipadd = task->ipadd;
+  memcpy(s->task.command_acl, task->command_acl, sizeof(s->task.command_acl));
+  apr_pool_create(&(s->mpool), NULL);
+  apr_thread_mutex_create(&(s->lock), APR_THREAD_MUTEX_DEFAULT, s->mpool);
+  s->group = v2_exec_group_create(v2_pool, v2_cfg.max_pending);
+
+  tbx_ns_app_data_set(task->ns, s, v2_session_destroy);
+
+  log_printf(5, "v2_session_create: ns=%d max_pending=%d\n", tbx_ns_getid(task->ns), v2_cfg.max_pending);
+
+  return(s);
+}
+
+//*****************************************************************
+// proto_v2_active - Returns 1 if the connection has been switched to
+//    the binary protocol.  The depot only uses the ns app data for it.
+//*****************************************************************
+
+int proto_v2_active(tbx_ns_t *ns)
+{
+  return((tbx_ns_app_data_get(ns) == NULL) ? 0 : 1);
+}
+
+//*****************************************************************
+// proto_v2_busy - Returns 1 if the connection still has requests on
+//    the executors.  These connections aren't idle even if parked.
+//*****************************************************************
+
+int proto_v2_busy(tbx_ns_t *ns)
+{
+  v2_session_t *s = (v2_session_t *)tbx_ns_app_data_get(ns);
+
+  if (s == NULL) return(0);
+  return((v2_exec_pending(s->group) > 0) ? 1 : 0);
+}
+
+//*****************************************************************
+// proto_v2_process - Used by the epoll engine.  Dispatches the requests
+//    that have already arrived.  Returns 0 if the connection should be
+//    parked until more arrive and -1 if it should be closed.
+//*****************************************************************
+
+int proto_v2_process(tbx_ns_t *ns)
+{
+  v2_session_t *s = (v2_session_t *)tbx_ns_app_data_get(ns);
+  v2_request_t *req;
+  int err;
+
+  while ((s->dead == 0) && (shutdown_request() == 0)) {
+     err = v2_read_request(s, &req, 1);
+     if (err == 1) return(0);
+     if (err != 0) break;
+     v2_dispatch(s, req);
+  }
+
+  return(-1);
+}
+
+//*****************************************************************
+// proto_v2_session - Runs the binary protocol on the task's thread
+//    until the connection is closed or goes idle.  Used when the
+//    epoll engine is disabled.
+//*****************************************************************
+
+void proto_v2_session(v2_session_t *s)
+{
+  v2_request_t *req;
+
+  while ((s->dead == 0) && (shutdown_request() == 0)) {
+     if (v2_read_request(s, &req, 0) != 0) break;
+     v2_dispatch(s, req);
+  }
+
+  //** Let the executors finish what's queued so the replies go out before the connection is closed
+  v2_exec_drain(s->group);
+}
+
+//*****************************************************************
+// handle_protocol - Negotiates the wire protocol.  If the binary
+//    protocol is chosen the connection is handed to the epoll engine
+//    between requests or, without it, handled here until it's closed.
+//*****************************************************************
+
+int handle_protocol(ibp_task_t *task)
+{
+  Cmd_state_t *cmd = &(task->cmd);
+  v2_session_t *s;
+  char buffer[128];
+  int version;
+
+  version = cmd->cargs.protocol.version;
+  if (version > v2_cfg.max_version) version = v2_cfg.max_version;
+  if (version < IBP_PROTO_V1) version = IBP_PROTO_V1;
+
+  snprintf(buffer, sizeof(buffer), "%d %d \n", IBP_OK, version);
+  log_printf(10, "handle_protocol: ns=%d requested=%d response=%s", tbx_ns_getid(task->ns), cmd->cargs.protocol.version, buffer);
+  if (server_ns_write_block(task->ns, task->cmd_timeout, buffer, strlen(buffer)) != NS_OK) return(-1);
+
+  alog_append_cmd_result(task->myid, IBP_OK);
+
+  if (version < IBP_PROTO_V2) return(0);  //** Stay with the text protocol
+
+  s = v2_session_create(task);
+  if (global_config->server.epoll_enable == 1) return(proto_v2_process(task->ns));
+
+  proto_v2_session(s);
+  return(-1);  //** The connection is done
+}
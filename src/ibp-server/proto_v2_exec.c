@@ -0,0 +1,312 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// proto_v2_exec - Executor pool shared by all the binary protocol
+//    connections.  A group's tasks for a key are kept on a chain.
+//    Only the chain is placed on the pool's ready list, never the
+//    individual tasks, so a key only ever has a single task running.
+//    Once that task completes the chain goes to the back of the
+//    ready list if more tasks are waiting.
+//*****************************************************************
+
+#include <string.h>
+#include <stdlib.h>
+#include <apr_hash.h>
+#include <apr_pools.h>
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_proc.h>
+#include <tbx/assert_result.h>
+#include <tbx/type_malloc.h>
+#include "proto_v2_exec.h"
+
+typedef struct v2_exec_task_s {
+   v2_exec_fn_t *fn;
+   void *arg;
+   struct v2_exec_task_s *next;
+} v2_exec_task_t;
+
+typedef struct v2_exec_chain_s {   //** Tasks for a single key.  The head is running or next to run
+   char *key;
+   v2_exec_group_t *g;
+   v2_exec_task_t *head;
+   v2_exec_task_t *tail;
+   struct v2_exec_chain_s *next;   //** Next chain on the ready list
+} v2_exec_chain_t;
+
+struct v2_exec_group_s {
+   v2_exec_t *ex;
+   apr_pool_t *mpool;
+   apr_hash_t *chains;    //** Active chains indexed by key
+   int n_pending;         //** Tasks queued or running
+   int max_pending;       //** Submitters block once this many are pending
+};
+
+struct v2_exec_s {
+   apr_pool_t *mpool;
+   apr_thread_mutex_t *lock;      //** Protects everything including the groups
+   apr_thread_cond_t *ready_cond; //** Signaled when a chain is added to the ready list
+   apr_thread_cond_t *done_cond;  //** Broadcast when a task completes
+   v2_exec_chain_t *ready_head;
+   v2_exec_chain_t *ready_tail;
+   apr_thread_t **worker;
+   int n_threads;
+   int shutdown;
+};
+
+//*****************************************************************
+// _v2_exec_ready - Appends the chain to the ready list
+//   NOTE: Assumes the lock is held
+//*****************************************************************
+
+void _v2_exec_ready(v2_exec_t *ex, v2_exec_chain_t *c)
+{
+   c->next = NULL;
+   if (ex->ready_tail == NULL) {
+      ex->ready_head = c;
+   } else {
+      ex->ready_tail->next = c;
+   }
+   ex->ready_tail = c;
+
+   apr_thread_cond_signal(ex->ready_cond);
+}
+
+//*****************************************************************
+// _v2_exec_worker - Runs the head task of each ready chain
+//*****************************************************************
+
+void *_v2_exec_worker(apr_thread_t *th, void *arg)
+{
+   v2_exec_t *ex = (v2_exec_t *)arg;
+   v2_exec_chain_t *c;
+   v2_exec_task_t *t;
+   v2_exec_group_t *g;
+
+   apr_thread_mutex_lock(ex->lock);
+   while (1) {
+      while ((ex->ready_head == NULL) && (ex->shutdown == 0)) {
+         apr_thread_cond_wait(ex->ready_cond, ex->lock);
+      }
+      if (ex->ready_head == NULL) break;  //** Shutting down and nothing left to do
+
+      c = ex->ready_head;
+      ex->ready_head = c->next;
+      if (ex->ready_head == NULL) ex->ready_tail = NULL;
+      t = c->head;
+
+      apr_thread_mutex_unlock(ex->lock);
+      t->fn(t->arg);
+      apr_thread_mutex_lock(ex->lock);
+
+      g = c->g;
+      c->head = t->next;
+      free(t);
+      g->n_pending--;
+      if (c->head == NULL) {  //** Nothing else for the key so retire the chain
+         apr_hash_set(g->chains, c->key, APR_HASH_KEY_STRING, NULL);
+         free(c->key);
+         free(c);
+      } else {
+         _v2_exec_ready(ex, c);
+      }
+      apr_thread_cond_broadcast(ex->done_cond);
+   }
+   apr_thread_mutex_unlock(ex->lock);
+
+   apr_thread_exit(th, 0);
+   return(NULL);
+}
+
+//*****************************************************************
+// v2_exec_create - Launches the executor pool
+//*****************************************************************
+
+v2_exec_t *v2_exec_create(int n_threads)
+{
+   v2_exec_t *ex;
+   int i;
+
+   if (n_threads < 1) n_threads = 1;
+
+   tbx_type_malloc_clear(ex, v2_exec_t, 1);
+   ex->n_threads = n_threads;
+   assert_result(apr_pool_create(&(ex->mpool), NULL), APR_SUCCESS);
+   apr_thread_mutex_create(&(ex->lock), APR_THREAD_MUTEX_DEFAULT, ex->mpool);
+   apr_thread_cond_create(&(ex->ready_cond), ex->mpool);
+   apr_thread_cond_create(&(ex->done_cond), ex->mpool);
+
+   tbx_type_malloc_clear(ex->worker, apr_thread_t *, n_threads);
+   for (i=0; i<n_threads; i++) {
+      apr_thread_create(&(ex->worker[i]), NULL, _v2_exec_worker, (void *)ex, ex->mpool);
+   }
+
+   return(ex);
+}
+
+//*****************************************************************
+// v2_exec_destroy - Shuts down the pool.  Anything already submitted
+//    is run first.
+//*****************************************************************
+
+void v2_exec_destroy(v2_exec_t *ex)
+{
+   apr_status_t value;
+   int i;
+
+   apr_thread_mutex_lock(ex->lock);
+   ex->shutdown = 1;
+   apr_thread_cond_broadcast(ex->ready_cond);
+   apr_thread_mutex_unlock(ex->lock);
+
+   for (i=0; i<ex->n_threads; i++) apr_thread_join(&value, ex->worker[i]);
+
+   free(ex->worker);
+   apr_thread_cond_destroy(ex->done_cond);
+   apr_thread_cond_destroy(ex->ready_cond);
+   apr_thread_mutex_destroy(ex->lock);
+   apr_pool_destroy(ex->mpool);
+   free(ex);
+}
+
+//*****************************************************************
+// v2_exec_group_create - Creates a group for a connection.  At most
+//    max_pending tasks can be queued or running at once.
+//*****************************************************************
+
+v2_exec_group_t *v2_exec_group_create(v2_exec_t *ex, int max_pending)
+{
+   v2_exec_group_t *g;
+
+   tbx_type_malloc_clear(g, v2_exec_group_t, 1);
+   g->ex = ex;
+   g->max_pending = (max_pending < 1) ? 1 : max_pending;
+   assert_result(apr_pool_create(&(g->mpool), NULL), APR_SUCCESS);
+   g->chains = apr_hash_make(g->mpool);
+
+   return(g);
+}
+
+//*****************************************************************
+// v2_exec_group_destroy - Waits for the group's tasks to complete
+//    and destroys it
+//*****************************************************************
+
+void v2_exec_group_destroy(v2_exec_group_t *g)
+{
+   v2_exec_drain(g);
+
+   apr_pool_destroy(g->mpool);
+   free(g);
+}
+
+//*****************************************************************
+// v2_exec_submit - Queues a task.  It runs after every task submitted
+//    earlier with the same key has completed.  Blocks if the group
+//    already has max_pending tasks so it can't be called from a task.
+//*****************************************************************
+
+void v2_exec_submit(v2_exec_group_t *g, const char *key, v2_exec_fn_t *fn, void *arg)
+{
+   v2_exec_t *ex = g->ex;
+   v2_exec_chain_t *c;
+   v2_exec_task_t *t;
+
+   tbx_type_malloc_clear(t, v2_exec_task_t, 1);
+   t->fn = fn;
+   t->arg = arg;
+
+   apr_thread_mutex_lock(ex->lock);
+   while (g->n_pending >= g->max_pending) {
+      apr_thread_cond_wait(ex->done_cond, ex->lock);
+   }
+
+   g->n_pending++;
+   c = apr_hash_get(g->chains, key, APR_HASH_KEY_STRING);
+   if (c == NULL) {  //** Nothing running for the key so it's ready to go
+      tbx_type_malloc_clear(c, v2_exec_chain_t, 1);
+      c->key = strdup(key);
+      c->g = g;
+      c->head = c->tail = t;
+      apr_hash_set(g->chains, c->key, APR_HASH_KEY_STRING, c);
+      _v2_exec_ready(ex, c);
+   } else {  //** Get in line behind the others
+      c->tail->next = t;
+      c->tail = t;
+   }
+   apr_thread_mutex_unlock(ex->lock);
+}
+
+//*****************************************************************
+// v2_exec_wait_key - Waits until the group has nothing queued or
+//    running for the key
+//*****************************************************************
+
+void v2_exec_wait_key(v2_exec_group_t *g, const char *key)
+{
+   v2_exec_t *ex = g->ex;
+
+   apr_thread_mutex_lock(ex->lock);
+   while (apr_hash_get(g->chains, key, APR_HASH_KEY_STRING) != NULL) {
+      apr_thread_cond_wait(ex->done_cond, ex->lock);
+   }
+   apr_thread_mutex_unlock(ex->lock);
+}
+
+//*****************************************************************
+// v2_exec_drain - Waits for all the group's tasks to complete
+//*****************************************************************
+
+void v2_exec_drain(v2_exec_group_t *g)
+{
+   v2_exec_t *ex = g->ex;
+
+   apr_thread_mutex_lock(ex->lock);
+   while (g->n_pending > 0) {
+      apr_thread_cond_wait(ex->done_cond, ex->lock);
+   }
+   apr_thread_mutex_unlock(ex->lock);
+}
+
+//*****************************************************************
+// v2_exec_pending - Returns the number of tasks queued or running
+//*****************************************************************
+
+int v2_exec_pending(v2_exec_group_t *g)
+{
+   int n;
+
+   apr_thread_mutex_lock(g->ex->lock);
+   n = g->n_pending;
+   apr_thread_mutex_unlock(g->ex->lock);
+
+   return(n);
+}
+
+//*****************************************************************
+// v2_range_check - Returns 0 if [off, off+len) is inside [0, max_size)
+//    and -1 otherwise.  The end is never computed so a bogus offset or
+//    length from the wire can't overflow.
+//*****************************************************************
+
+int v2_range_check(int64_t off, int64_t len, int64_t max_size)
+{
+   if ((off < 0) || (len < 0) || (max_size < 0)) return(-1);
+   if (off > max_size - len) return(-1);
+
+   return(0);
+}
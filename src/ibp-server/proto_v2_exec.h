@@ -0,0 +1,45 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// proto_v2_exec - Executor pool shared by all the binary protocol
+//    connections.  Each connection gets a group and every task is
+//    tagged with a key, the cap.  Tasks with the same key in a group
+//    run one at a time in the order they were submitted.  Different
+//    keys run in parallel.
+//*****************************************************************
+
+#ifndef _PROTO_V2_EXEC_H_
+#define _PROTO_V2_EXEC_H_
+
+#include <stdint.h>
+
+typedef void (v2_exec_fn_t)(void *arg);
+
+typedef struct v2_exec_s v2_exec_t;
+typedef struct v2_exec_group_s v2_exec_group_t;
+
+v2_exec_t *v2_exec_create(int n_threads);
+void v2_exec_destroy(v2_exec_t *ex);
+v2_exec_group_t *v2_exec_group_create(v2_exec_t *ex, int max_pending);
+void v2_exec_group_destroy(v2_exec_group_t *g);
+void v2_exec_submit(v2_exec_group_t *g, const char *key, v2_exec_fn_t *fn, void *arg);
+void v2_exec_wait_key(v2_exec_group_t *g, const char *key);
+void v2_exec_drain(v2_exec_group_t *g);
+int v2_exec_pending(v2_exec_group_t *g);
+int v2_range_check(int64_t off, int64_t len, int64_t max_size);
+
+#endif
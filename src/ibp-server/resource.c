@@ -22,6 +22,8 @@
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -50,13 +52,36 @@ char _blanks[_RESOURCE_BUF_SIZE];
 
 const char *_res_types[] = {DEVICE_UNKNOWN, DEVICE_DIR};
 
-typedef struct {  //** Internal resource iterator
-  int mode;
-  DB_iterator_t *dbi;
-  osd_iter_t *fsi;
+#define _RES_REBUILD_ID 2         //** Rebuild checkpoint
+#define _RES_REBUILD_VERSION 1
+#define _REBUILD_BUF_SIZE 1024    //** Allocations buffered by each rebuild worker before a bulk DB put
+#define _EXPIRE_BATCH_MAX 100000  //** Upper bound on expire_batch since the tick buffers a batch of wheel entries
+
+typedef struct {  //** Rebuild checkpoint.  The per-partition done flags are stored right after it
+  int version;
+  int wipe_clean;
+  int n_parts;
+  int n_done;
+  ibp_off_t used_space[2];
+  ibp_off_t n_allocs;
+  ibp_off_t n_alias;
+  ibp_off_t n_removed;
+}  resource_rebuild_ckpt_t;
+
+struct res_rebuild_s {  //** Shared state for the threads walking the device during a rebuild
   Resource_t *r;
-  Allocation_t a;
-}  res_iterator_t;
+  int remove_expired;
+  int wipe_clean;
+  int truncate_expiration;
+  ibp_time_t remove_before;     //** Expired allocations older than this are removed
+  ibp_time_t max_expiration;
+  int next_part;                //** Next partition to hand out
+  int since_ckpt;               //** Partitions completed since the last checkpoint
+  char *done;                   //** Flags the completed partitions
+  resource_rebuild_ckpt_t ckpt; //** Running totals.  Only updated as partitions complete
+  apr_thread_mutex_t *lock;
+  apr_pool_t *pool;
+};
 
 void *resource_cleanup_thread(apr_thread_t *th, void *data);
 int _remove_allocation_for_make_free(Resource_t *r, int rmode, Allocation_t *alloc, DB_iterator_t *it);
@@ -104,11 +129,58 @@ char *fname2dev(char *fname)
 
 
 //***************************************************************************
-// trash_adjust - Adjusts the trash space
+// _expire_wheel_alloc - Schedules the allocation's removal on the wheel
+//***************************************************************************
+
+void _expire_wheel_alloc(Resource_t *r, osd_id_t id, ibp_time_t expiration)
+{
+   expire_wheel_entry_t e;
+   ibp_time_t grace_over;
+
+   if (r->expire_wheel == NULL) return;
+
+   e.kind = EW_ALLOC;
+   e.id = id;
+   e.stamp = 0;
+   e.when = expiration + r->preexpire_grace_period;
+
+   //** Anything that expired while we were down is left alone until the grace period is over
+   grace_over = r->start_time + r->preexpire_grace_period;
+   if (e.when < grace_over) e.when = grace_over;
+
+   expire_wheel_add(r->expire_wheel, &e);
+}
+
+//***************************************************************************
+// _expire_wheel_trash - Schedules the trashed allocation's purge on the wheel
+//***************************************************************************
+
+void _expire_wheel_trash(Resource_t *r, int rmode, osd_id_t id, ibp_time_t move_time)
+{
+   expire_wheel_entry_t e;
+
+   if ((r->expire_wheel == NULL) || (rmode == OSD_PHYSICAL_ID)) return;
+
+   e.id = id;
+   e.stamp = move_time;
+   if (rmode == OSD_EXPIRE_ID) {
+      e.kind = EW_TRASH_EXPIRE;
+      e.when = move_time + r->trash_grace_period[RES_EXPIRE_INDEX];
+   } else {
+      e.kind = EW_TRASH_DELETE;
+      e.when = move_time + r->trash_grace_period[RES_DELETE_INDEX];
+   }
+
+   expire_wheel_add(r->expire_wheel, &e);
+}
+
+//***************************************************************************
+// trash_adjust - Adjusts the trash space.  move_time must be the stamp
+//     passed to osd_stamped_remove() so the wheel gets the real trash id.
 //     NOTE: No Locking is performed.
 //***************************************************************************
 
-void _trash_adjust(Resource_t *r, int rmode, osd_id_t id)
+void _trash_adjust(Resource_t *r, int rmode, osd_id_t id, ibp_time_t move_time)
 {
    int64_t fsize;
    int ind = 0;
@@ -119,6 +191,7 @@ void _trash_adjust(Resource_t *r, int rmode, osd_id_t id)
          ind = (rmode == OSD_EXPIRE_ID) ? RES_EXPIRE_INDEX : RES_DELETE_INDEX;
          r->trash_size[ind] += fsize;
          r->n_trash[ind]++;
+         _expire_wheel_trash(r, rmode, id, move_time);
       }
 if (fsize< 0) fsize = 0;
 ibp_off_t dummy = fsize;
@@ -352,167 +425,338 @@ int mkfs_resource(rid_t rid, char *dev_type, char *device_name, char *db_locatio
 }
 
 //***************************************************************************
-// rebuild_remove_iter - Removes the current record
+// _rebuild_ckpt_write - Stores the rebuild progress so an interrupted rebuild
+//    can pick up where it left off.
+//    NOTE: rb->lock should be held by the calling thread
 //***************************************************************************
 
-int rebuild_remove_iter(res_iterator_t *ri)
+int _rebuild_ckpt_write(res_rebuild_t *rb)
 {
-  int err = 0;
+   Resource_t *r = rb->r;
+   osd_fd_t *fd;
+   osd_id_t id = _RES_REBUILD_ID;
 
-  if (ri->mode == 1) {
-     err = remove_alloc_iter_db(ri->dbi);
-  }
+   fd = osd_open(r->dev, id, OSD_WRITE_MODE);
+   if (fd == NULL) {  //** Checkpoint doesn't exist so create it
+      osd_create_id(r->dev, CHKSUM_NONE, 0, 0, id);
 
-  if (err == 0) {
-     _trash_adjust(ri->r, RES_EXPIRE_INDEX, ri->a.id);
+      fd = osd_open(r->dev, id, OSD_WRITE_MODE);
+      if (fd == NULL) {
+         log_printf(0, "ERROR:  Can't open rebuild checkpoint! rid=%s\n", r->name);
+         return(1);
+      }
+   }
+   osd_write(r->dev, fd, 0, sizeof(rb->ckpt), &(rb->ckpt));
+   osd_write(r->dev, fd, sizeof(rb->ckpt), rb->ckpt.n_parts, rb->done);
+   osd_close(r->dev, fd);
 
-     err = osd_expire_remove(ri->r->dev, ri->a.id);
-//log_printf(10, "rebuild_put_iter: id=" LU " is_alias=%d\n", ri->a.id, ri->a.is_alias);
-//     if (ri->a.is_alias == 0) err = ri->r->dev->expire_remove(ri->r->dev, ri->a.id);
-  }
+   log_printf(5, "rid=%s n_done=%d n_parts=%d n_allocs=" LU "\n", r->name, rb->ckpt.n_done, rb->ckpt.n_parts, rb->ckpt.n_allocs);
 
-  return(err);
+   return(0);
 }
 
 //***************************************************************************
-// rebuild_modify_iter - Modifies the current record
-//    IF the mode == 2 then the rebuild app buffers the allocations and writes
-//    them in bulk using rebuild_put_alloc.  In this case I do nothing
+// _rebuild_ckpt_read - Loads the rebuild checkpoint.  Returns 0 if a
+//    checkpoint exists and was made with the same rebuild mode and number
+//    of partitions.  Otherwise 1 is returned.
 //***************************************************************************
 
-int rebuild_modify_iter(res_iterator_t *ri, Allocation_t *a)
+int _rebuild_ckpt_read(Resource_t *r, int wipe_clean, resource_rebuild_ckpt_t *ckpt, char *done)
 {
-  int err = 0;
+   osd_fd_t *fd;
+   resource_rebuild_ckpt_t c;
+   int n_parts = ckpt->n_parts;
+   int err = 1;
+
+   fd = osd_open(r->dev, _RES_REBUILD_ID, OSD_READ_MODE);
+   if (fd == NULL) return(1);   //** No checkpoint
+
+   if (osd_read(r->dev, fd, 0, sizeof(c), &c) == sizeof(c)) {
+      if ((c.version == _RES_REBUILD_VERSION) && (c.wipe_clean == wipe_clean) && (c.n_parts == n_parts)) {
+         if (osd_read(r->dev, fd, sizeof(c), n_parts, done) == n_parts) {
+            *ckpt = c;
+            err = 0;
+         }
+      }
+   }
+   osd_close(r->dev, fd);
 
-  if (ri->mode == 1) {
-     err = modify_alloc_iter_db(ri->dbi, a);
-  }
+   if (err != 0) log_printf(0, "rid=%s Ignoring unusable rebuild checkpoint\n", r->name);
 
-  return(err);
+   return(err);
 }
 
-
 //***************************************************************************
-// rebuild_put_iter - Stores the current record
-//    If mode == 1 then nothing needs to be done.  Otherwise if mode == 2/3 then
-//    I need to 1st set the a.size to the size of the file minus the header
-//    before storing it in the DB
+// _rebuild_ckpt_pending - Returns the wipe_clean mode of an interrupted
+//    rebuild or 0 if there isn't one.
 //***************************************************************************
 
-int rebuild_put_iter(res_iterator_t *ri, Allocation_t *a)
+int _rebuild_ckpt_pending(Resource_t *r)
 {
-  int err = 0;
+   osd_fd_t *fd;
+   resource_rebuild_ckpt_t c;
+   int mode = 0;
 
-  if (ri->mode != 1) {
-     a->size = osd_size(ri->r->dev, a->id) - ALLOC_HEADER;
-log_printf(10, "rebuild_put_iter: id=" LU " size=" LU "\n", a->id, a->size);
-     err = _put_alloc_db(&(ri->r->db), a);
-  }
+   fd = osd_open(r->dev, _RES_REBUILD_ID, OSD_READ_MODE);
+   if (fd == NULL) return(0);   //** No checkpoint
 
-  return(err);
+   if (osd_read(r->dev, fd, 0, sizeof(c), &c) == sizeof(c)) {
+      if ((c.version == _RES_REBUILD_VERSION) && (c.wipe_clean > 1)) mode = c.wipe_clean;
+   }
+   osd_close(r->dev, fd);
+
+   return(mode);
 }
 
+//***************************************************************************
+// _rebuild_ckpt_remove - Removes the rebuild checkpoint if it exists
+//***************************************************************************
+
+void _rebuild_ckpt_remove(Resource_t *r)
+{
+   if (osd_id_exists(r->dev, _RES_REBUILD_ID)) osd_physical_remove(r->dev, _RES_REBUILD_ID);
+}
 
 //***************************************************************************
-// rebuild_begin - Creates the rebuild iterator
+// _rebuild_read_header - Reads the allocation header for the given ID.
+//    Returns 0 if it's a valid allocation and 1 if it should be skipped.
 //***************************************************************************
 
-res_iterator_t *rebuild_begin(Resource_t *r, int wipe_clean)
+int _rebuild_read_header(Resource_t *r, osd_id_t id, Allocation_t *a)
 {
-   res_iterator_t *ri;
-   tbx_type_malloc_clear(ri, res_iterator_t, 1);
+   osd_fd_t *fd;
+   int n;
 
-   dbr_lock(&(r->db));
+   if ((id == _RES_USAGE_ID) || (id == _RES_REBUILD_ID)) {  //** SKip the special files
+      log_printf(0, "rid=%s skipping special ID!!!! fs entry id=" LU "\n", r->name, id);
+      return(1);
+   }
 
-   ri->mode = wipe_clean;
-   ri->fsi = NULL;
-   ri->dbi = NULL;
-   ri->r = r;
+   fd = osd_open(r->dev, id, OSD_READ_MODE);
+   if (fd == NULL) {
+      log_printf(0, "ERROR:  Can't open id=" LU "! rid=%s.  SKIPPING\n", id, r->name);
+      return(1);
+   }
+   n = osd_read(r->dev, fd, 0, sizeof(Allocation_t), a);
+   osd_close(r->dev, fd);
 
-   if (wipe_clean == 1) {
-      ri->dbi = id_iterator(&(r->db));
-      assert_result_not_null(ri->dbi);
-   } else {
-      ri->fsi = osd_new_iterator(r->dev);
-      assert_result_not_null(ri->fsi);
+   if (n == 0) { //** Nothing there so delete the filename
+      log_printf(0, "rid=%s Empty allocation id=" LU ".  Removing it....\n", r->name, id);
+      osd_expire_remove(r->dev, id);
+      return(1);
+   } else if (n != sizeof(Allocation_t)) {
+      log_printf(0, "rid=%s Can't read id=" LU ".  Skipping...nbytes=%d\n", r->name, id, n);
+      return(1);
+   } else if (id != a->id) {  //** ID mismatch.. throw warning and skip
+      log_printf(0, "rid=%s ID mismatch so skipping!!!! fs entry id=" LU ".  a.id=" LU "\n", r->name, id, a->id);
+      return(1);
    }
 
-   return(ri);
+   return(0);
 }
 
 //***************************************************************************
-// rebuild_end - Destroys the rebuild iterator
+// _rebuild_partition - Walks a single OSD partition adding the allocations
+//    to the DB in bulk.  The partition's totals are returned in tally.
+//    Returns 0 if the partition was completed and 1 if the walk was
+//    interrupted.
 //***************************************************************************
 
-void rebuild_end(res_iterator_t *ri)
+int _rebuild_partition(res_rebuild_t *rb, int part, Allocation_t *alist, int a_size, resource_rebuild_ckpt_t *tally)
 {
-   if (ri->mode == 1) {
-      db_iterator_end(ri->dbi);
-   } else {
-      osd_destroy_iterator(ri->fsi);
+   Resource_t *r = rb->r;
+   osd_iter_t *it;
+   osd_id_t id;
+   Allocation_t *a;
+   ibp_time_t t1, t2, move_time;
+   int nbuff, estate;
+
+   memset(tally, 0, sizeof(resource_rebuild_ckpt_t));
+
+   it = osd_new_partition_iterator(r->dev, part, part+1);
+   if (it == NULL) {
+      log_printf(0, "rid=%s Can't walk partition %d.  Skipping\n", r->name, part);
+      return(0);
    }
 
-   dbr_unlock(&(ri->r->db));
+   nbuff = 0;
+   while ((r->rebuild_shutdown == 0) && (osd_iterator_next(it, &id) == 0)) {
+      a = &(alist[nbuff]);
+      if (_rebuild_read_header(r, id, a) != 0) continue;
 
-   free(ri);
+      if (a->expiration < ibp_time_now()) {
+         estate = -1;
+      } else {
+         estate = (a->expiration > rb->max_expiration) ? 1 : 0;
+      }
+
+      if ((a->expiration < rb->remove_before) && (rb->remove_expired == 1)) {
+         tally->n_removed++;
+         log_printf(1, "rid=%s Removing expired record with id: " LU " * estate: %d\n", r->name, id, estate);
+         move_time = ibp_time_now();
+         apr_thread_mutex_lock(r->mutex);
+         _trash_adjust(r, OSD_EXPIRE_ID, id, move_time);
+         apr_thread_mutex_unlock(r->mutex);
+         if (osd_stamped_remove(r->dev, OSD_EXPIRE_ID, id, move_time) != 0) {
+            log_printf(0, "rid=%s Error Removing id " LU "\n", r->name, id);
+         }
+         continue;
+      }
+
+      //*** Adding the record
+      if (((a->expiration > rb->max_expiration) && (rb->truncate_expiration == 1)) || (rb->wipe_clean == 3)) {
+         t1 = a->expiration; t2 = rb->max_expiration;
+         log_printf(1, "rid=%s wc=%d Adding id: " LU " but truncating expiration curr:" TT " * new:" TT " * estate: %d\n", r->name, rb->wipe_clean, id, ibp2apr_time(t1), ibp2apr_time(t2), estate);
+         a->expiration = rb->max_expiration;
+      } else {
+         log_printf(1, "rid=%s Adding id: " LU " * estate: %d\n", r->name, id, estate);
+      }
+
+      a->size = osd_size(r->dev, id) - ALLOC_HEADER;
+      tally->used_space[a->reliability] += a->max_size;
+      tally->n_allocs++;
+      if (a->is_alias) tally->n_alias++;
+
+      //**** Buffer is full so update the DB ****
+      nbuff++;
+      if (nbuff >= a_size) {
+         put_alloc_bulk_db(&(r->db), alist, nbuff);
+         nbuff = 0;
+      }
+   }
+   osd_destroy_iterator(it);
+
+   //**** Push whatever is left into the DB ****
+   if (nbuff > 0) put_alloc_bulk_db(&(r->db), alist, nbuff);
+
+   return((r->rebuild_shutdown == 0) ? 0 : 1);
 }
 
 //***************************************************************************
-// rebuild_get_next - Retreives the next record for rebuilding
+// rebuild_worker_thread - Pulls partitions off the rebuild and walks them
+//    until everything is done or we're told to stop.
 //***************************************************************************
 
-int rebuild_get_next(res_iterator_t *ri, Allocation_t *a)
+void *rebuild_worker_thread(apr_thread_t *th, void *data)
 {
-  int err;
-  osd_id_t id;
-  osd_fd_t *fd;
-  osd_t *d = ri->r->dev;
-
-  if (ri->mode != 1) {
-      err = osd_iterator_next(ri->fsi, &id);
-      while (err == 0) {
-//         log_printf(15, "rebuild_get_next: r=%s id=" LU " err=%d\n", ri->r->name, id, err);
-         if (id == _RES_USAGE_ID) {  //** SKip the special files
-            log_printf(0, "rebuild_get_next: rid=%s skipping special ID!!!! fs entry id=" LU "\n", ri->r->name, id);
-            tbx_log_flush();
-            err = osd_iterator_next(ri->fsi, &id);
-         } else {
-
-           fd = osd_open(d, id, OSD_READ_MODE);
-           if (fd == NULL) {
-              log_printf(0, "ERROR:  Can't open id=" LU "! rid=%s.  SKIPPING\n", id, ri->r->name);
-              err = 1;
-           } else {
-              err = osd_read(d, fd, 0, sizeof(Allocation_t), a);
-              osd_close(d, fd);
-           }
+   res_rebuild_t *rb = (res_rebuild_t *)data;
+   Resource_t *r = rb->r;
+   resource_rebuild_ckpt_t tally;
+   Allocation_t *alist;
+   int part;
+
+   tbx_type_malloc(alist, Allocation_t, _REBUILD_BUF_SIZE);
+
+   apr_thread_mutex_lock(rb->lock);
+   while (r->rebuild_shutdown == 0) {
+      while ((rb->next_part < rb->ckpt.n_parts) && (rb->done[rb->next_part] == 1)) rb->next_part++;  //** Skip what's already checkpointed
+      if (rb->next_part >= rb->ckpt.n_parts) break;
+      part = rb->next_part;
+      rb->next_part++;
+      apr_thread_mutex_unlock(rb->lock);
+
+      if (_rebuild_partition(rb, part, alist, _REBUILD_BUF_SIZE, &tally) != 0) {
+         apr_thread_mutex_lock(rb->lock);
+         break;   //** Interrupted so the partition gets walked again on the next mount
+      }
 
-//         log_printf(15, "rebuild_get_next: r=%s id=" LU " read err=%d sizeof(a)=%d\n", ri->r->name, id, err, sizeof(Allocation_t));
-           if (err == 0) { //** Nothing there so delete the filename
-              log_printf(0, "rebuild_get_next: rid=%s Empty allocation id=" LU ".  Removing it....\n", ri->r->name, id);
-              tbx_log_flush();
-              err = osd_expire_remove(d, id);
-              err = osd_iterator_next(ri->fsi, &id);
-           } else if (err != sizeof(Allocation_t)) {
-              log_printf(0, "rebuild_get_next: rid=%s Can't read id=" LU ".  Skipping...nbytes=%d\n", ri->r->name, id, err);
-              tbx_log_flush();
-              err = osd_iterator_next(ri->fsi, &id);
-           } else if (id != a->id) {  //** ID mismatch.. throw warning and skip
-              log_printf(0, "rebuild_get_next: rid=%s ID mismatch so skipping!!!! fs entry id=" LU ".  a.id=" LU "\n", ri->r->name, id,a->id);
-              tbx_log_flush();
-              err = osd_iterator_next(ri->fsi, &id);
-           }
-         }
+      apr_thread_mutex_lock(rb->lock);
+      rb->done[part] = 1;
+      rb->ckpt.n_done++;
+      rb->ckpt.used_space[0] += tally.used_space[0];
+      rb->ckpt.used_space[1] += tally.used_space[1];
+      rb->ckpt.n_allocs += tally.n_allocs;
+      rb->ckpt.n_alias += tally.n_alias;
+      rb->ckpt.n_removed += tally.n_removed;
+
+      rb->since_ckpt++;
+      if (rb->since_ckpt >= r->rebuild_checkpoint_interval) {
+         _rebuild_ckpt_write(rb);
+         rb->since_ckpt = 0;
       }
-  } else {
-     err = db_iterator_next(ri->dbi, DB_NEXT, a);
-//     log_printf(15, "rebuild_get_next: DB r=%s id=" LU " err=%d\n", ri->r->name, a->id, err);
-  }
+   }
+   apr_thread_mutex_unlock(rb->lock);
 
-  ri->a = *a;  //** Keep my copy for mods
+   free(alist);
 
-  if (err == sizeof(Allocation_t)) err = 0;
-  return(err);
+   apr_thread_exit(th, 0);
+   return(NULL);
+}
+
+//***************************************************************************
+// _rebuild_walk - Walks the device using rebuild_threads workers and then
+//    publishes the totals.  Returns 0 if the whole device was walked and 1
+//    if the rebuild was interrupted.
+//***************************************************************************
+
+int _rebuild_walk(res_rebuild_t *rb)
+{
+   Resource_t *r = rb->r;
+   apr_thread_t **worker;
+   apr_status_t value;
+   char print_time[128];
+   ibp_off_t mb;
+   int i, n, err;
+
+   n = (r->rebuild_threads > 0) ? r->rebuild_threads : 1;
+   tbx_type_malloc_clear(worker, apr_thread_t *, n);
+   for (i=0; i<n; i++) {
+      apr_thread_create(&(worker[i]), NULL, rebuild_worker_thread, (void *)rb, rb->pool);
+   }
+   for (i=0; i<n; i++) {
+      apr_thread_join(&value, worker[i]);
+   }
+   free(worker);
+
+   apr_thread_mutex_lock(r->mutex);
+   r->used_space[0] = rb->ckpt.used_space[0]; r->used_space[1] = rb->ckpt.used_space[1];
+   r->n_allocs = rb->ckpt.n_allocs;  r->n_alias = rb->ckpt.n_alias;
+   apr_thread_mutex_unlock(r->mutex);
+
+   if (rb->ckpt.n_done == rb->ckpt.n_parts) {
+      _rebuild_ckpt_remove(r);
+      err = 0;
+   } else {
+      _rebuild_ckpt_write(rb);  //** Interrupted so record where we stopped
+      log_printf(0, "rebuild_resource(rid=%s): Interrupted after %d of %d partitions\n", r->name, rb->ckpt.n_done, rb->ckpt.n_parts);
+      err = 1;
+   }
+
+   log_printf(0, "\nrebuild_resource(rid=%s): " LU " allocations added\n", r->name, rb->ckpt.n_allocs);
+   log_printf(0, "rebuild_resource(rid=%s): " LU " alias allocations added\n", r->name, rb->ckpt.n_alias);
+   log_printf(0, "rebuild_resource(rid=%s): " LU " allocations removed\n", r->name, rb->ckpt.n_removed);
+   mb = r->used_space[ALLOC_SOFT]/1024/1024; log_printf(0, "#(rid=%s) soft_used = " LU "\n", r->name, mb);
+   mb = r->used_space[ALLOC_HARD]/1024/1024; log_printf(0, "#(rid=%s) hard_used = " LU "\n", r->name, mb);
+   apr_ctime(print_time, apr_time_now());
+   log_printf(0, "\nrebuild_resource(rid=%s): Finished Rebuilding RID %s at %s\n", r->name, r->name, print_time);
+   tbx_log_flush();
+
+   apr_pool_destroy(rb->pool);
+   free(rb->done);
+   free(rb);
+
+   return(err);
+}
+
+//***************************************************************************
+// rebuild_background_thread - Runs the rebuild while the resource is
+//    serving reads.  Writes are enabled again once the rebuild completes.
+//***************************************************************************
+
+void *rebuild_background_thread(apr_thread_t *th, void *data)
+{
+   res_rebuild_t *rb = (res_rebuild_t *)data;
+   Resource_t *r = rb->r;
+
+   if (_rebuild_walk(rb) == 0) {
+      apr_thread_mutex_lock(r->mutex);
+      r->rebuild_active = 0;
+      apr_thread_mutex_unlock(r->mutex);
+      log_printf(0, "rid=%s Background rebuild complete.  Leaving degraded mode\n", r->name);
+   }
+
+   apr_thread_exit(th, 0);
+   return(NULL);
 }
 
 //***************************************************************************
@@ -527,6 +771,12 @@ int rebuild_get_next(res_iterator_t *ri, Allocation_t *a)
 //  if wipe_clean=3 the resource is walked to generate the new DB and all
 //    allocations duration are extended to the max.  Even for expired allocations.
 //
+//  The walk is split across rebuild_threads workers with each handling one
+//  OSD partition at a time.  Progress is checkpointed every
+//  rebuild_checkpoint_interval partitions so an interrupted rebuild resumes
+//  instead of starting over.  If rebuild_background is set the walk runs in
+//  the background and the resource is read-only until it completes.
+//
 //    --NOTE:  Any blank allocations will be lost!!! --
 //***************************************************************************
 
@@ -534,17 +784,11 @@ int rebuild_resource(Resource_t *r, DB_env_t *env, tbx_inip_file_t *kfd, int rem
      int truncate_expiration)
 {
    char db_group[2048];
-   int i, nbuff, cnt, ecnt, pcnt, err, estate;
-   res_iterator_t *iter;
-   Allocation_t *a;
-   const int a_size = 1024;
-   Allocation_t alist[a_size];
-   ibp_time_t t, max_expiration, t1, t2;
-   osd_id_t id;
+   res_rebuild_t *rb;
+   int i;
    char print_time[128];
 
-   t = apr_time_now();
-   apr_ctime(print_time, t);
+   apr_ctime(print_time, apr_time_now());
    log_printf(0, "rebuild_resource(rid=%s):  Rebuilding Resource rid=%s.  Starting at %s  remove_expired=%d wipe_clean=%d truncate_expiration=%d\n", 
         r->name, r->name, print_time, remove_expired, wipe_clean, truncate_expiration);
 
@@ -554,98 +798,44 @@ int rebuild_resource(Resource_t *r, DB_env_t *env, tbx_inip_file_t *kfd, int rem
       return(0);
    }
 
+   tbx_type_malloc_clear(rb, res_rebuild_t, 1);
+   rb->r = r;
+   rb->remove_expired = remove_expired;
+   rb->wipe_clean = wipe_clean;
+   rb->truncate_expiration = truncate_expiration;
+   rb->remove_before = (wipe_clean == 3) ? 0 : ibp_time_now();  //** Nothing gets deleted in mode 3
+   rb->max_expiration = ibp_time_now() + r->max_duration;
+   rb->ckpt.n_parts = osd_n_partitions(r->dev);
+   tbx_type_malloc_clear(rb->done, char, rb->ckpt.n_parts);
+   apr_pool_create(&(rb->pool), NULL);
+   apr_thread_mutex_create(&(rb->lock), APR_THREAD_MUTEX_DEFAULT, rb->pool);
+
+   //** See if we're resuming an interrupted rebuild.  If so keep what's already been loaded
+   i = (wipe_clean == 3) ? 2 : wipe_clean;
+   if (_rebuild_ckpt_read(r, wipe_clean, &(rb->ckpt), rb->done) == 0) {
+      log_printf(0, "rebuild_resource(rid=%s): Resuming rebuild.  %d of %d partitions already done\n", r->name, rb->ckpt.n_done, rb->ckpt.n_parts);
+      i = 0;
+   } else {
+      rb->ckpt.version = _RES_REBUILD_VERSION;
+      rb->ckpt.wipe_clean = wipe_clean;
+   }
+
    //** Mount it
-   i = wipe_clean;
-   if (wipe_clean == 3) i = 2;
    snprintf(db_group, sizeof(db_group), "db %s", r->name);
    mount_db_generic(kfd, db_group, env, &(r->db), i);   //**Mount the DBes
 
-   //*** Now we have to fill it ***
-   r->used_space[0] = 0; r->used_space[1] = 0;
-   r->n_allocs = 0;  r->n_alias = 0;
-
-   t = ibp_time_now();
-   if (wipe_clean == 3) t = 0;  //** Nothing gets deleted in this mode
-
-   cnt = 0; pcnt = 0;
-   ecnt = 0;
-   nbuff = 0;
-
-   max_expiration = ibp_time_now() + r->max_duration;
-
-   a = &(alist[nbuff]);
-
-   iter = rebuild_begin(r, wipe_clean);
-   err = rebuild_get_next(iter, a);
-   while (err == 0) {
-      id = a->id;
-      if (a->expiration < ibp_time_now()) {
-         estate = -1;
-      } else {
-         estate = (a->expiration > max_expiration) ? 1 : 0;
-      }
-
-      if ((a->expiration < t) && (remove_expired == 1)) {
-         ecnt++;
-         log_printf(1, "rebuild_resource(rid=%s): Removing expired record with id: " LU " * estate: %d (remove count:%d)\n", r->name, id, estate, ecnt);
-         if ((err = rebuild_remove_iter(iter)) != 0) {
-            log_printf(0, "rebuild_resource(rid=%s): Error Removing id " LU "  from DB Error=%d\n", r->name, id, err);
-         }
-      } else {         //*** Adding the record
-         if (((a->expiration > max_expiration) && (truncate_expiration == 1)) || (wipe_clean == 3)) {
-            t1 = a->expiration; t2 = max_expiration;
-            log_printf(1, "rebuild_resource(rid=%s, wc=%d): Adding record %d with id: " LU " but truncating expiration curr:" TT " * new:" TT " * estate: %d\n",r->name, wipe_clean, cnt, id, ibp2apr_time(t1), ibp2apr_time(t2), estate);
-            a->expiration = max_expiration;
-            if ((err = rebuild_modify_iter(iter, a)) != 0) {
-                  log_printf(0, "rebuild_resource(rid=%s): Error Adding id " LU " to primary DB Error=%d\n", r->name, a->id, err);
-            }
-         } else {
-           log_printf(1, "rebuild_resource(rid=%s): Adding record %d with id: " LU " * estate: %d\n",r->name, cnt, id, estate);
-         }
-
-         r->used_space[a->reliability] += a->max_size;
+   r->used_space[0] = rb->ckpt.used_space[0]; r->used_space[1] = rb->ckpt.used_space[1];
+   r->n_allocs = rb->ckpt.n_allocs;  r->n_alias = rb->ckpt.n_alias;
+   r->rebuild_shutdown = 0;
 
-         nbuff++;
-         cnt++;
-         if (a->is_alias) pcnt++;
-     }
-
-     //**** Buffer is full so update the DB ****
-     if (nbuff >= a_size) {
-        for (i=0; i<nbuff; i++) {
-           if ((err = rebuild_put_iter(iter, &(alist[i]))) != 0) {
-              log_printf(0, "rebuild_resource(rid=%s): Error Adding id " LU " to DB Error=%d\n", r->name, alist[i].id, err);
-           }
-        }
-
-        nbuff = 0;
-     }
-
-     a = &(alist[nbuff]);
-     err = rebuild_get_next(iter, a);  //** Get the next record
-   }
-
-   //**** Push whatever is left into the DB ****
-   for (i=0; i<nbuff; i++) {
-     if ((err = rebuild_put_iter(iter, &(alist[i]))) != 0) {
-           log_printf(0, "rebuild_resource(rid=%s): Error Adding id " LU " to DB Error=%d\n", r->name, alist[i].id, err);
-     }
+   if (r->rebuild_background == 1) {
+      log_printf(0, "rebuild_resource(rid=%s): Rebuilding in the background.  Read-only until it completes\n", r->name);
+      r->rebuild_active = 1;
+      apr_thread_create(&(r->rebuild_thread), NULL, rebuild_background_thread, (void *)rb, r->pool);
+      return(0);
    }
 
-   rebuild_end(iter);
-
-   r->n_allocs = cnt;
-   r->n_alias = pcnt;
-
-   log_printf(0, "\nrebuild_resource(rid=%s): %d allocations added\n", r->name, cnt);
-   log_printf(0, "rebuild_resource(rid=%s): %d alias allocations added\n", r->name, pcnt);
-   log_printf(0, "rebuild_resource(rid=%s): %d allocations removed\n", r->name, ecnt);
-   ibp_off_t mb;
-   mb = r->used_space[ALLOC_SOFT]/1024/1024; log_printf(0, "#(rid=%s) soft_used = " LU "\n", r->name, mb);
-   mb = r->used_space[ALLOC_HARD]/1024/1024; log_printf(0, "#(rid=%s) hard_used = " LU "\n", r->name, mb);
-   apr_ctime(print_time, apr_time_now());
-   log_printf(0, "\nrebuild_resource(rid=%s): Finished Rebuilding RID %s at %s\n", r->name, r->name, print_time);
-   tbx_log_flush();
+   _rebuild_walk(rb);
 
    return(0);
 }
@@ -668,7 +858,7 @@ int calc_usage(Resource_t *r)
   r->used_space[0] = 0; r->used_space[1] = 0;
   r->n_allocs = 0;  r->n_alias = 0;
 
-  dbi = id_iterator(&(r->db));
+  dbi = id_iterator(&(r->db), DBR_ITER_RDONLY);
   while (db_iterator_next(dbi, DB_NEXT, &a) == 0) {
      log_printf(10, "calc_usage(rid=%s): n=" LU " ------------- id=" LU "\n", r->name, r->n_allocs, a.id);
 //print_allocation_resource(r, stdout, &a);
@@ -703,7 +893,7 @@ int perform_truncate(Resource_t *r)
   max_expiration = ibp_time_now() + r->max_duration;
 
   cnt = 0; ecnt = 0; nbuff = 0;
-  dbi = id_iterator(&(r->db));
+  dbi = id_iterator(&(r->db), DBR_ITER_RDWR);
   a = &(alist[nbuff]);
   while (db_iterator_next(dbi, DB_NEXT, a) == 0) {
       if (a->expiration < ibp_time_now()) {
@@ -813,6 +1003,7 @@ int parse_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group)
 
    res->rescan_interval = tbx_inip_get_integer(keyfile, group, "rescan_interval", 86400);
    res->cleanup_interval = tbx_inip_get_integer(keyfile, group, "cleanup_interval", 500);
+   res->n_io_threads = tbx_inip_get_integer(keyfile, group, "io_threads", 2);
 
    res->trash_grace_period[RES_DELETE_INDEX] = tbx_inip_get_integer(keyfile, group, "delete_grace_period", 3600);
    res->trash_grace_period[RES_EXPIRE_INDEX] = tbx_inip_get_integer(keyfile, group, "expire_grace_period", 7*24*3600);
@@ -887,10 +1078,36 @@ int parse_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group)
       tbx_chksum_set(&(res->chksum), i);
       if (i == CHKSUM_NONE) res->enable_chksum = 0;  //** If none disable disk chskum check
    } else {
-      log_printf(0, "parse_resource(%s): Invalid chksum type.  Got %s should be SHA1, SHA256, SHA512, or MD5\n", group, str);
+      log_printf(0, "parse_resource(%s): Invalid chksum type.  Got %s should be SHA1, SHA256, SHA512, MD5, CRC32C, or XXH64\n", group, str);
+      abort();
+   }
+   free(str);
+
+   //** and how the data is accessed
+   str = tbx_inip_get_string(keyfile, group, "io_engine", "stdio");
+   if (strcasecmp(str, "uring") == 0) {
+      res->io_engine = FS_IO_URING;
+   } else if (strcasecmp(str, "stdio") == 0) {
+      res->io_engine = FS_IO_STDIO;
+   } else {
+      log_printf(0, "parse_resource(%s): Invalid io_engine.  Got %s should be stdio or uring\n", group, str);
       abort();
    }
    free(str);
+   res->uring_depth = tbx_inip_get_integer(keyfile, group, "uring_depth", 128);
+   res->direct_io = tbx_inip_get_integer(keyfile, group, "direct_io", 0);
+
+   //** How rebuilds are performed
+   res->rebuild_threads = tbx_inip_get_integer(keyfile, group, "rebuild_threads", 4);
+   if (res->rebuild_threads < 1) res->rebuild_threads = 1;
+   res->rebuild_background = tbx_inip_get_integer(keyfile, group, "rebuild_background", 0);
+   res->rebuild_checkpoint_interval = tbx_inip_get_integer(keyfile, group, "rebuild_checkpoint_interval", 16);
+   if (res->rebuild_checkpoint_interval < 1) res->rebuild_checkpoint_interval = 1;
+
+   //** Max number of expirations/trash purges done per cleanup pass.  0 falls back to walking the expire index
+   res->expire_batch = tbx_inip_get_integer(keyfile, group, "expire_batch", 1000);
+   if (res->expire_batch < 0) res->expire_batch = 0;
+   if (res->expire_batch > _EXPIRE_BATCH_MAX) res->expire_batch = _EXPIRE_BATCH_MAX;
 
    //** Get the cache information
    res->n_cache = tbx_inip_get_integer(keyfile, group, "n_cache", 100000);
@@ -926,7 +1143,7 @@ int parse_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group)
 int mount_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group, DB_env_t *dbenv,
    int force_rebuild, int lazy_allocate, int truncate_expiration)
 {
-   int err, wipe_expired;
+   int err, wipe_expired, rebuild_mode;
    char db_group[1024];
 
    memset(_blanks, 0, _RESOURCE_BUF_SIZE*sizeof(char));  //** This is done multiple times and it doesn't have to be but is trivial
@@ -954,6 +1171,7 @@ int mount_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group, DB_en
 
       res->res_type = RES_TYPE_DIR;
       assert_result_not_null(res->dev = osd_mount_fs(res->device, res->n_cache, res->cache_expire));
+      osd_fs_io_set(res->dev, res->io_engine, res->uring_depth, res->direct_io);
    }
 
    //** Init the lock **
@@ -964,6 +1182,9 @@ int mount_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group, DB_en
 
    res->cleanup_shutdown = -1;
 
+   //** The wheel is seeded by the cleanup thread once the DB is usable.  Until then it just collects changes
+   if (res->expire_batch > 0) res->expire_wheel = expire_wheel_create(ibp_time_now());
+
    //** Rebuild the DB or mount it here **
    snprintf(db_group, sizeof(db_group), "db %s", res->name);
 
@@ -979,12 +1200,22 @@ int mount_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group, DB_en
          default:
             err = rebuild_resource(res, dbenv, keyfile, wipe_expired, force_rebuild, truncate_expiration);
       }
+   } else if ((rebuild_mode = _rebuild_ckpt_pending(res)) > 0) {
+      //** The DB only holds what the interrupted rebuild loaded so finish it
+      log_printf(0, "RID %s has an interrupted rebuild!  Resuming it\n", res->name);
+      printf("RID %s has an interrupted rebuild!  Resuming it\n", res->name);
+      err = rebuild_resource(res, dbenv, keyfile, wipe_expired, rebuild_mode, truncate_expiration);
    } else if (read_usage_file(res, NULL) == 1) {
-      log_printf(0, "RID %s not cleanly unmounted!  Forcing a rebuild!\n", res->name);
-      printf("RID %s not cleanly unmounted!  Forcing a rebuild!\n", res->name);
-      err = mount_db_generic(keyfile, db_group, dbenv, &(res->db), 1);
-//      calc_usage(res);
-      err = rebuild_resource(res, dbenv, keyfile, wipe_expired, 2, truncate_expiration);
+      if (crash_safe_db(keyfile, db_group) == 1) {  //** The DB is still good so just redo the usage
+         log_printf(0, "RID %s not cleanly unmounted!  DB is crash safe so only recalculating usage\n", res->name);
+         printf("RID %s not cleanly unmounted!  DB is crash safe so only recalculating usage\n", res->name);
+         err = mount_db_generic(keyfile, db_group, dbenv, &(res->db), 0);
+         if (err == 0) calc_usage(res);
+      } else {
+         log_printf(0, "RID %s not cleanly unmounted!  Forcing a rebuild!\n", res->name);
+         printf("RID %s not cleanly unmounted!  Forcing a rebuild!\n", res->name);
+         err = rebuild_resource(res, dbenv, keyfile, wipe_expired, 2, truncate_expiration);
+      }
    } else {
       err = mount_db_generic(keyfile, db_group, dbenv, &(res->db), 0);
    }
@@ -1016,9 +1247,17 @@ int mount_resource(Resource_t *res, tbx_inip_file_t *keyfile, char *group, DB_en
 int umount_resource(Resource_t *res)
 {
   apr_status_t dummy;
-  int err;
+  res_io_op_t *op;
+  int err, i;
   log_printf(15, "umount_resource:  Unmounting resource %s cleanup_shutdown=%d\n", res->name, res->cleanup_shutdown); tbx_log_flush();
 
+  //** Stop any background rebuild.  It checkpoints so the next mount resumes it
+  if (res->rebuild_thread != NULL) {
+     res->rebuild_shutdown = 1;
+     apr_thread_join(&dummy, res->rebuild_thread);
+     res->rebuild_thread = NULL;
+  }
+
   //** Kill the cleanup thread
   if (res->cleanup_shutdown == 0) {
      apr_thread_mutex_lock(res->cleanup_lock);
@@ -1028,15 +1267,30 @@ int umount_resource(Resource_t *res)
      apr_thread_join(&dummy, res->cleanup_thread);
   }
 
+  //** and the I/O threads.  A NULL op tells them to exit
+  if (res->io_thread != NULL) {
+     for (i=0; i<res->n_io_threads; i++) {
+        op = NULL;
+        tbx_que_put(res->io_que[i], &op, TBX_QUE_BLOCK);
+        apr_thread_join(&dummy, res->io_thread[i]);
+        tbx_que_destroy(res->io_que[i]);
+     }
+     free(res->io_thread);
+     free(res->io_que);
+     res->io_thread = NULL;
+  }
+
   err = umount_db(&(res->db));
   umount_history_table(res);
 
-  //** Only update the usage file if the DB closed properly.
-  if (err == 0) write_usage_file(res, _RESOURCE_STATE_GOOD);
+  //** Only update the usage file if the DB closed properly and isn't half built
+  if ((err == 0) && (res->rebuild_active == 0)) write_usage_file(res, _RESOURCE_STATE_GOOD);
 
 
   osd_umount(res->dev);
 
+  if (res->expire_wheel != NULL) expire_wheel_destroy(res->expire_wheel);
+
   apr_thread_mutex_destroy(res->cleanup_lock);
   apr_thread_mutex_destroy(res->mutex);
   apr_thread_cond_destroy(res->cleanup_cond);
@@ -1097,10 +1351,12 @@ int print_resource(char *buffer, int *used, int nbytes, Resource_t *res)
    tbx_append_printf(buffer, used, nbytes, "enable_manage_history = %d\n", res->enable_manage_history);
    tbx_append_printf(buffer, used, nbytes, "enable_alias_history = %d\n", res->enable_alias_history);
    tbx_append_printf(buffer, used, nbytes, "cleanup_interval = %d\n", res->cleanup_interval);
+   tbx_append_printf(buffer, used, nbytes, "io_threads = %d\n", res->n_io_threads);
    tbx_append_printf(buffer, used, nbytes, "rescan_interval = %d\n", res->rescan_interval);
    tbx_append_printf(buffer, used, nbytes, "delete_grace_period = %d\n", res->trash_grace_period[RES_DELETE_INDEX]);
    tbx_append_printf(buffer, used, nbytes, "expire_grace_period = %d\n", res->trash_grace_period[RES_EXPIRE_INDEX]);
    tbx_append_printf(buffer, used, nbytes, "preexpire_grace_period = %d\n", res->preexpire_grace_period);
+   tbx_append_printf(buffer, used, nbytes, "expire_batch = %d\n", res->expire_batch);
 
    n = res->max_size[ALLOC_TOTAL]/1024/1024; tbx_append_printf(buffer, used, nbytes, "max_size = " I64T "\n", n);
    n = res->max_size[ALLOC_SOFT]/1024/1024; tbx_append_printf(buffer, used, nbytes, "soft_size = " I64T "\n", n);
@@ -1112,6 +1368,10 @@ int print_resource(char *buffer, int *used, int nbytes, Resource_t *res)
    tbx_append_printf(buffer, used, nbytes, "chksum_type = %s\n", tbx_chksum_name(&(res->chksum)));
    n = res->chksum_blocksize / 1024; tbx_append_printf(buffer, used, nbytes, "chksum_blocksize_kb = " I64T "\n", n);
 
+   tbx_append_printf(buffer, used, nbytes, "io_engine = %s\n", ((res->io_engine == FS_IO_URING) ? "uring" : "stdio"));
+   tbx_append_printf(buffer, used, nbytes, "uring_depth = %d\n", res->uring_depth);
+   tbx_append_printf(buffer, used, nbytes, "direct_io = %d\n", res->direct_io);
+
    n = apr_time_sec(res->cache_expire);
    tbx_append_printf(buffer, used, nbytes, "n_cache = %d\n", res->n_cache);
    tbx_append_printf(buffer, used, nbytes, "cache_expire = %d\n", n);
@@ -1128,6 +1388,10 @@ int print_resource(char *buffer, int *used, int nbytes, Resource_t *res)
 
    tbx_append_printf(buffer, used, nbytes, "#n_allocations = " LU "\n", res->n_allocs);
    tbx_append_printf(buffer, used, nbytes, "#n_alias = " LU "\n", res->n_alias);
+   if (res->expire_wheel != NULL) {
+      n = expire_wheel_count(res->expire_wheel); tbx_append_printf(buffer, used, nbytes, "#expire_wheel_entries = " I64T "\n", n);
+      n = res->expire_lag; tbx_append_printf(buffer, used, nbytes, "#expire_lag = " I64T " s\n", n);
+   }
    i = tbx_append_printf(buffer, used, nbytes, "\n");
    return(i);
 }
@@ -1144,6 +1408,7 @@ int resource_get_mode(Resource_t *r)
 
   apr_thread_mutex_lock(r->mutex);
   mode = r->rwm_mode;
+  if (r->rebuild_active == 1) mode &= RES_MODE_READ;  //** Only reads until the background rebuild completes
   apr_thread_mutex_unlock(r->mutex);
 
   return(mode);
@@ -1209,32 +1474,24 @@ int close_allocation(Resource_t *r, osd_fd_t *fd)
 }
 
 //***************************************************************************
-// _remove_allocation - Removes the given allocation without locking!
+// _remove_allocation_osd - Removes the physical allocation and adjusts the
+//    space.  The DB entry should already be removed.  NO LOCKING IS DONE!
 //***************************************************************************
 
-int _remove_allocation(Resource_t *r, int rmode, Allocation_t *alloc, int dolock)
+void _remove_allocation_osd(Resource_t *r, int rmode, Allocation_t *alloc)
 {
+   ibp_time_t move_time;
    int err;
 
-   log_printf(10, "_remove_allocation:  Removing " LU "\n", alloc->id);
-
-   //** EVen if this fails we want to try and remove the physical allocation
-   if ((err = remove_alloc_db(&(r->db), alloc)) != 0) {
-      debug_printf(1, "_remove_allocation:  Error with remove_alloc_db!  Error=%d\n", err);
-//      return(err);
-   }
-   log_printf(10, "_remove_allocation:  Removed db entry\n");
-
-   if (dolock) apr_thread_mutex_lock(r->mutex);
-
-   _trash_adjust(r, rmode, alloc->id);
+   move_time = ibp_time_now();
+   _trash_adjust(r, rmode, alloc->id, move_time);
 
    if (r->enable_alias_history == 1) {
-      if ((err = osd_remove(r->dev, rmode, alloc->id)) != 0) {
+      if ((err = osd_stamped_remove(r->dev, rmode, alloc->id, move_time)) != 0) {
          debug_printf(1, "_remove_allocation:  Error with fs->remove!  Error=%d\n", err);
       }
    } else if (alloc->is_alias == 0) {
-      if ((err = osd_remove(r->dev, rmode, alloc->id)) != 0) {
+      if ((err = osd_stamped_remove(r->dev, rmode, alloc->id, move_time)) != 0) {
          debug_printf(1, "_remove_allocation:  Error with fs->remove!  Error=%d\n", err);
       }
    } else {
@@ -1255,6 +1512,28 @@ log_printf(15, "_remove_allocation: start rel=%d used=" LU " a.max_size=" LU "\n
 
 log_printf(15, "_remove_allocation: end rel=%d used=" LU " a.max_size=" LU "\n", alloc->reliability,
    r->used_space[alloc->reliability], alloc->max_size);
+}
+
+//***************************************************************************
+// _remove_allocation - Removes the given allocation without locking!
+//***************************************************************************
+
+int _remove_allocation(Resource_t *r, int rmode, Allocation_t *alloc, int dolock)
+{
+   int err;
+
+   log_printf(10, "_remove_allocation:  Removing " LU "\n", alloc->id);
+
+   //** EVen if this fails we want to try and remove the physical allocation
+   if ((err = remove_alloc_db(&(r->db), alloc)) != 0) {
+      debug_printf(1, "_remove_allocation:  Error with remove_alloc_db!  Error=%d\n", err);
+//      return(err);
+   }
+   log_printf(10, "_remove_allocation:  Removed db entry\n");
+
+   if (dolock) apr_thread_mutex_lock(r->mutex);
+
+   _remove_allocation_osd(r, rmode, alloc);
 
    if (dolock) apr_thread_mutex_unlock(r->mutex);
 
@@ -1275,6 +1554,29 @@ int remove_allocation_resource(Resource_t *r, int rmode, Allocation_t *alloc)
   return(_remove_allocation(r, rmode, alloc, 1));
 }
 
+//***************************************************************************
+// remove_allocation_bulk_resource - Removes a list of allocations.  The DB
+//       entries are removed using a single transaction.
+//***************************************************************************
+
+int remove_allocation_bulk_resource(Resource_t *r, int rmode, Allocation_t *a, int n)
+{
+  int i, err;
+
+  tbx_atomic_inc(r->counter);
+
+  //** EVen if this fails we want to try and remove the physical allocations
+  if ((err = remove_alloc_bulk_db(&(r->db), a, n)) != 0) {
+     debug_printf(1, "remove_allocation_bulk_resource:  Error with remove_alloc_bulk_db!  Error=%d\n", err);
+  }
+
+  apr_thread_mutex_lock(r->mutex);
+  for (i=0; i<n; i++) _remove_allocation_osd(r, rmode, &(a[i]));
+  apr_thread_mutex_unlock(r->mutex);
+
+  return(0);
+}
+
 //***************************************************************************
 // merge_allocation_resource - Merges the space for the child allocation, a,
 //    into the master(ma).  THe child allocations data is NOT merged and is lost.
@@ -1307,6 +1609,7 @@ int merge_allocation_resource(Resource_t *r, Allocation_t *ma, Allocation_t *a)
 
 int _remove_allocation_for_make_free(Resource_t *r, int rmode, Allocation_t *alloc, DB_iterator_t *it)
 {
+   ibp_time_t move_time;
    int err;
 
    log_printf(10, "_remove_allocation_for_make_free:  Removing " LU " with space " LU "\n", alloc->id, alloc->max_size);
@@ -1319,14 +1622,15 @@ int _remove_allocation_for_make_free(Resource_t *r, int rmode, Allocation_t *all
 
    log_printf(10, "_remove_allocation_for_make_free:  Removed db entry\n");
 
-   _trash_adjust(r, rmode, alloc->id);
+   move_time = ibp_time_now();
+   _trash_adjust(r, rmode, alloc->id, move_time);
 
    if (r->enable_alias_history) {
-      if ((err = osd_remove(r->dev, rmode, alloc->id)) != 0) {
+      if ((err = osd_stamped_remove(r->dev, rmode, alloc->id, move_time)) != 0) {
          debug_printf(1, "_remove_allocation_for_make_free:  Error with fs->remove!  Error=%d\n", err);
       }
    } else if (alloc->is_alias == 0) {
-      if ((err = osd_remove(r->dev, rmode, alloc->id)) != 0) {
+      if ((err = osd_stamped_remove(r->dev, rmode, alloc->id, move_time)) != 0) {
          debug_printf(1, "_remove_allocation_for_make_free:  Error with fs->remove!  Error=%d\n", err);
       }
    } else {
@@ -1521,7 +1825,7 @@ int make_space(Resource_t *r, ibp_off_t size, int atype)
   if (nleft > 0)  err = _trash_free_space(r, RES_EXPIRE_INDEX, &nleft);
 
   dbr_lock(&(r->db));
-  dbi = expire_iterator(&(r->db));
+  dbi = expire_iterator(&(r->db), DBR_ITER_RDWR);
 
   err = make_free_space_iterator(r, dbi, &nleft, now);
 
@@ -1532,7 +1836,7 @@ int make_space(Resource_t *r, ibp_off_t size, int atype)
   if ((nleft > 0) && (err == 0)) {
     now = 0;  //** We can delete everything here if needed
     dbr_lock(&(r->db));
-    dbi = soft_iterator(&(r->db));
+    dbi = soft_iterator(&(r->db), DBR_ITER_RDWR);
     err = make_free_space_iterator(r, dbi, &nleft, now);
     db_iterator_end(dbi);
     dbr_unlock(&(r->db));
@@ -1556,6 +1860,11 @@ void free_expired_allocations(Resource_t *r)
 
    tbx_atomic_inc(r->counter);
 
+   if (r->expire_wheel_loaded == 1) {  //** Just work off whatever has come due
+      expire_wheel_tick(r);
+      return;
+   }
+
    apr_thread_mutex_lock(r->mutex);
    size = r->max_size[ALLOC_HARD];
    make_space(r, size, ALLOC_HARD);
@@ -1596,18 +1905,12 @@ log_printf(10, "resource_allocatble: diff=" I64T " fsdiff=" I64T "\n", diff, fsd
 
 
 //***************************************************************************
-// _new_allocation_resource - Creates and returns a uniqe allocation
-//        for the resource.
-//
-//  **NOTE: NO LOCKING IS DONE.  THE ALLOCATION IS NOT BLANKED!  *****
+// _init_allocation_resource - Fills in the allocation's fields for a new
+//        allocation
 //***************************************************************************
 
-int _new_allocation_resource(Resource_t *r, Allocation_t *a, ibp_off_t size, int type,
-    int reliability, ibp_time_t length, int is_alias, int cs_type, ibp_off_t blocksize)
+void _init_allocation_resource(Allocation_t *a, ibp_off_t size, int type, int reliability, ibp_time_t length, int is_alias)
 {
-   int err = 0;
-   ibp_off_t total_size = ALLOC_HEADER + size;
-
    a->max_size = size;
    a->size = 0;
    a->type = type;
@@ -1618,15 +1921,17 @@ int _new_allocation_resource(Resource_t *r, Allocation_t *a, ibp_off_t size, int
    a->r_pos = 0;
    a->w_pos = 0;
    a->is_alias = is_alias;
+}
 
-   //**Make sure we have enough space if this is a real allocation and record it
-   if (a->is_alias == 0) {
-      err = make_space(r, total_size, reliability);
-      if (r->preallocate) r->pending += size;
-   }
-
-   if (err != 0) return(err);  //** Exit if not enough space
+//***************************************************************************
+// _create_allocation_files - Creates the allocation's file and caps and
+//        writes the header and history.  If store_db=0 only the caps are
+//        generated and the caller is responsible for adding the allocation
+//        to the DB.  Nothing here needs r->mutex.
+//***************************************************************************
 
+int _create_allocation_files(Resource_t *r, Allocation_t *a, int cs_type, ibp_off_t blocksize, int store_db)
+{
    //** Munge the disk chksum type and blocksize
    if (cs_type == -1) {
       if (r->enable_chksum == 0) {
@@ -1649,7 +1954,11 @@ int _new_allocation_resource(Resource_t *r, Allocation_t *a, ibp_off_t size, int
       return(1);;
    }
 
-   create_alloc_db(&(r->db), a);
+   if (store_db) {
+      create_alloc_db(&(r->db), a);
+   } else {
+      create_caps_db(&(r->db), a);
+   }
 
    //** Always store the initial alloc in the file header
    if (a->is_alias == 0) {
@@ -1660,6 +1969,42 @@ int _new_allocation_resource(Resource_t *r, Allocation_t *a, ibp_off_t size, int
       blank_history(r, a->id);  //** Also store the history
    }
 
+   return(0);
+}
+
+//***************************************************************************
+// _new_allocation_resource - Creates and returns a uniqe allocation
+//        for the resource.
+//
+//  **NOTE: NO LOCKING IS DONE.  THE ALLOCATION IS NOT BLANKED!  *****
+//***************************************************************************
+
+int _new_allocation_resource(Resource_t *r, Allocation_t *a, ibp_off_t size, int type,
+    int reliability, ibp_time_t length, int is_alias, int cs_type, ibp_off_t blocksize)
+{
+   int err = 0;
+   ibp_off_t total_size = ALLOC_HEADER + size;
+
+   if (r->rebuild_active == 1) {  //** Usage isn't known until the rebuild finishes
+      log_printf(1, "rid=%s Background rebuild in progress.  Rejecting allocation\n", r->name);
+      return(1);
+   }
+
+   _init_allocation_resource(a, size, type, reliability, length, is_alias);
+
+   //**Make sure we have enough space if this is a real allocation and record it
+   if (a->is_alias == 0) {
+      err = make_space(r, total_size, reliability);
+      if (r->preallocate) r->pending += size;
+   }
+
+   if (err != 0) return(err);  //** Exit if not enough space
+
+   err = _create_allocation_files(r, a, cs_type, blocksize, 1);
+   if (err != 0) return(err);
+
+   _expire_wheel_alloc(r, a->id, a->expiration);
+
    r->n_allocs++;
    if (is_alias == 0) {
       r->used_space[a->reliability] += a->max_size;
@@ -1708,6 +2053,89 @@ int create_allocation_resource(Resource_t *r, Allocation_t *a, ibp_off_t size, i
    return(err);
 }
 
+//***************************************************************************
+// create_allocation_bulk_resource - Creates n allocations with the same
+//        attributes.  All the DB entries are added using a single transaction.
+//        Either all the allocations are created or none are.  The space is
+//        reserved up front so r->mutex is only held for the accounting and
+//        not while the files and DB entries are created.  The expirations
+//        are only scheduled once everything is committed so a rollback
+//        leaves nothing behind on the expire wheel.
+//
+//  **NOTE: The allocations are NOT cleared so the caller should blank them
+//          and fill in any creation timestamps beforehand.
+//***************************************************************************
+
+int create_allocation_bulk_resource(Resource_t *r, Allocation_t *a, int n, ibp_off_t size, int type,
+    int reliability, ibp_time_t length, int preallocate_space, int cs_type, ibp_off_t blocksize)
+{
+   int i, j, err;
+   ibp_off_t total_size;
+
+   tbx_atomic_inc(r->counter);
+
+   total_size = ALLOC_HEADER + size;
+
+   //** Reserve the space for all of them
+   apr_thread_mutex_lock(r->mutex);
+   if (r->rebuild_active == 1) {  //** Usage isn't known until the rebuild finishes
+      log_printf(1, "rid=%s Background rebuild in progress.  Rejecting allocation\n", r->name);
+      err = 1;
+   } else {
+      err = make_space(r, n*total_size, reliability);
+   }
+   if (err == 0) {
+      r->n_allocs += n;
+      r->used_space[reliability] += n*size;
+      if (r->preallocate) r->pending += n*size;
+   }
+   apr_thread_mutex_unlock(r->mutex);
+
+   if (err != 0) return(err);
+
+   //** Create the files and store them in the DB
+   for (i=0; i<n; i++) {
+      _init_allocation_resource(&(a[i]), size, type, reliability, length, 0);
+      err = _create_allocation_files(r, &(a[i]), cs_type, blocksize, 0);
+      if (err != 0) break;
+   }
+
+   if (err == 0) {
+      err = put_alloc_bulk_db(&(r->db), a, n);
+      if (err != 0) remove_alloc_bulk_db(&(r->db), a, n);  //** Clean out any partial puts
+   }
+
+   if (err != 0) {  //** Undo the allocations that were created and release the space
+      log_printf(1, "rid=%s Failed creating allocation %d of %d err=%d.  Rolling back\n", r->name, i, n, err);
+      for (j=0; j<i; j++) {
+         osd_remove(r->dev, OSD_PHYSICAL_ID, a[j].id);
+      }
+
+      apr_thread_mutex_lock(r->mutex);
+      r->n_allocs -= n;
+      r->used_space[reliability] -= n*size;
+      if (r->preallocate) r->pending -= n*size;
+      apr_thread_mutex_unlock(r->mutex);
+
+      return(err);
+   }
+
+   for (i=0; i<n; i++) _expire_wheel_alloc(r, a[i].id, a[i].expiration);
+
+   for (i=0; i<n; i++) {
+      if ((preallocate_space & RES_RESERVE_FALLOCATE) > 0) osd_reserve(r->dev, a[i].id, total_size);
+      if ((preallocate_space & RES_RESERVE_BLANK) > 0) blank_space(r, a[i].id, 0, total_size);
+   }
+
+   if (r->preallocate) {
+      apr_thread_mutex_lock(r->mutex);
+      r->pending -= n*size;
+      apr_thread_mutex_unlock(r->mutex);
+   }
+
+   return(0);
+}
+
 //***************************************************************************
 //  resource_undelete - Undeletes a resource from the specificed trash bin
 //    The recovered allocation is returned via recovered_a if the field is non-NULL
@@ -1772,6 +2200,7 @@ int resource_undelete(Resource_t *r, int trash_type, const char *trash_id, ibp_t
 
   //** Add it to the DB
   err = _put_alloc_db(&(r->db), &a);
+  _expire_wheel_alloc(r, a.id, a.expiration);
 
   //** Adjust the space
   r->n_allocs++;
@@ -1958,7 +2387,37 @@ int modify_allocation_resource(Resource_t *r, osd_id_t id, Allocation_t *a)
   }
 
 
-  return(modify_alloc_db(&(r->db), a));
+  err = modify_alloc_db(&(r->db), a);
+  if ((err == 0) && (old_a.expiration != a->expiration)) _expire_wheel_alloc(r, a->id, a->expiration);  //** The old entry is skipped when it comes due
+
+  return(err);
+}
+
+//***************************************************************************
+// modify_allocation_bulk_resource - Stores a list of allocation data structures
+//    using a single DB transaction.  Only the expiration or refcounts should
+//    have changed since no space accounting is done.  The expire wheel is
+//    updated for every allocation.
+//***************************************************************************
+
+int modify_allocation_bulk_resource(Resource_t *r, Allocation_t *a, int n)
+{
+  int i, err;
+
+  tbx_atomic_inc(r->counter);
+
+  if (r->update_alloc == 1) {
+     for (i=0; i<n; i++) {
+        if ((a[i].is_alias == 0) || (r->enable_alias_history)) write_allocation_header(r, &(a[i]), 0);
+     }
+  }
+
+  err = put_alloc_bulk_db(&(r->db), a, n);
+  if (err == 0) {
+     for (i=0; i<n; i++) _expire_wheel_alloc(r, a[i].id, a[i].expiration);  //** The old entries are skipped when they come due
+  }
+
+  return(err);
 }
 
 //---------------------------------------------------------------------------
@@ -2113,6 +2572,46 @@ ibp_off_t read_allocation(Resource_t *r, osd_fd_t *fd, ibp_off_t offset, ibp_off
    return(n);
 }
 
+//***************************************************************************
+// native_fd_allocation - Returns the raw fd for the allocation if the data
+//    can be sent directly from the file or -1 otherwise
+//***************************************************************************
+
+int native_fd_allocation(Resource_t *r, osd_fd_t *fd)
+{
+   if ((fd == NULL) || (r->dev->native_fd == NULL)) return(-1);
+
+   return(osd_native_fd(r->dev, fd));
+}
+
+//***************************************************************************
+// sendfile_allocation - Sends the allocation data directly from the file
+//    descriptor, afd, to the socket, sfd, without copying it through user space.
+//    Returns the number of bytes sent, 0 if the socket is full, IBP_E_FILE_READ
+//    if the file ends early, or -1 on a socket error.
+//***************************************************************************
+
+ibp_off_t sendfile_allocation(Resource_t *r, int afd, int sfd, ibp_off_t offset, ibp_off_t len)
+{
+   off_t off;
+   ssize_t n;
+
+   tbx_atomic_inc(r->counter);
+
+   off = offset + ALLOC_HEADER;
+   n = sendfile(sfd, afd, &off, len);
+   if (n < 0) {
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) return(0);
+      log_printf(5, "sendfile_allocation: Error with sendfile(%d, %d, " I64T ", " I64T ") errno=%d\n", sfd, afd, offset, len, errno);
+      return(-1);
+   } else if ((n == 0) && (len > 0)) {  //** EOF so the allocation file is shorter than it should be
+      log_printf(0, "sendfile_allocation: EOF with sendfile(%d, %d, " I64T ", " I64T ")\n", sfd, afd, offset, len);
+      return(IBP_E_FILE_READ);
+   }
+
+   return(n);
+}
+
 //***************************************************************************
 // print_allocation_resource - Prints the allocation info to the fd
 //***************************************************************************
@@ -2156,13 +2655,13 @@ walk_expire_iterator_t *walk_expire_iterator_begin(Resource_t *r)
 
   dbr_lock(&(r->db));
 
-  wei->hard = expire_iterator(&(r->db));
+  wei->hard = expire_iterator(&(r->db), DBR_ITER_RDONLY);
   if (wei->hard == NULL) {
      log_printf(10, "walk_expire_hard_iterator: wei->hard = NULL! r=%s\n", r->name);
      return(NULL);
   }
 
-  wei->soft = soft_iterator(&(r->db));
+  wei->soft = soft_iterator(&(r->db), DBR_ITER_RDONLY);
   if (wei->hard == NULL) {
      log_printf(10, "walk_expire_hard_iterator: wei->soft = NULL! r=%s\n", r->name);
      return(NULL);
@@ -2471,6 +2970,11 @@ void resource_cleanup(Resource_t *r, ibp_time_t start_grace_time)
      return;
   }
 
+  if (r->rebuild_active == 1) {  //** The rebuild could add back anything we expire
+     log_printf(1, "END.  Skipping.  Background rebuild in progress. rid=%s\n",r->name);
+     return;
+  }
+
   n = max_alloc;
   while (n == max_alloc) {
     //** Perform the walk
@@ -2522,6 +3026,104 @@ fail:
   return;
 }
 
+//*****************************************************************
+// expire_wheel_load - Seeds the expiration wheel from the DB and the trash bins
+//*****************************************************************
+
+void expire_wheel_load(Resource_t *r)
+{
+  walk_expire_iterator_t *wei;
+  osd_iter_t *iter;
+  Allocation_t a;
+  osd_id_t id;
+  ibp_time_t move_time;
+  char trash_id[1024];
+  int64_t n;
+  int i, rmode;
+
+  log_printf(5, "START rid=%s\n", r->name);
+
+  n = 0;
+  wei = walk_expire_iterator_begin(r);
+  if (wei != NULL) {
+     while (get_next_walk_expire_iterator(wei, DBR_NEXT, &a) == 0) {
+        _expire_wheel_alloc(r, a.id, a.expiration);
+        n++;
+        if ((n % 1000) == 0) tbx_atomic_inc(r->counter);
+     }
+     walk_expire_iterator_end(wei);
+  }
+
+  for (i=0; i<2; i++) {
+     rmode = (i == RES_DELETE_INDEX) ? OSD_DELETE_ID : OSD_EXPIRE_ID;
+     iter = osd_new_trash_iterator(r->dev, rmode);
+     if (iter == NULL) continue;
+     while (osd_trash_iterator_next(iter, &id, &move_time, trash_id) == 0) {
+        _expire_wheel_trash(r, rmode, id, move_time);
+        n++;
+        if ((n % 1000) == 0) tbx_atomic_inc(r->counter);
+     }
+     osd_destroy_iterator(iter);
+  }
+
+  r->expire_wheel_loaded = 1;
+
+  log_printf(5, "END rid=%s n=" I64T "\n", r->name, n);
+}
+
+//*****************************************************************
+// expire_wheel_tick - Expires allocations and purges trash that has come
+//    due on the wheel.  At most expire_batch entries are handled.
+//    Returns the number of entries processed.
+//*****************************************************************
+
+int expire_wheel_tick(Resource_t *r)
+{
+  expire_wheel_entry_t *e;
+  Allocation_t a;
+  ibp_time_t now;
+  ibp_off_t nbytes;
+  char trash_id[1024];
+  int i, n, tmode, rmode;
+
+  if (r->rebuild_active == 1) return(0);  //** The rebuild could add back anything we expire
+
+  tbx_type_malloc(e, expire_wheel_entry_t, r->expire_batch);
+  now = ibp_time_now();
+  n = expire_wheel_due(r->expire_wheel, now, e, r->expire_batch, &(r->expire_lag));
+
+  for (i=0; i<n; i++) {
+     if (e[i].kind == EW_ALLOC) {
+        //** The wheel isn't updated on removal or when the expiration changes so recheck it
+        if (get_alloc_with_id_db(&(r->db), e[i].id, &a) != 0) continue;
+        if ((a.expiration + r->preexpire_grace_period) > now) continue;
+        log_printf(10, "rid=%s expiring " LU "\n", r->name, a.id);
+        _remove_allocation(r, OSD_EXPIRE_ID, &a, 1);
+     } else {
+        tmode = (e[i].kind == EW_TRASH_EXPIRE) ? RES_EXPIRE_INDEX : RES_DELETE_INDEX;
+        rmode = (e[i].kind == EW_TRASH_EXPIRE) ? OSD_EXPIRE_ID : OSD_DELETE_ID;
+        snprintf(trash_id, sizeof(trash_id), TT "_" LU, e[i].stamp, e[i].id);
+        nbytes = osd_trash_size(r->dev, rmode, trash_id);
+        if (osd_trash_physical_remove(r->dev, rmode, trash_id) == 0) {  //** Already gone if it was undeleted or wiped
+           log_printf(10, "rid=%s purged tmode=%d trash_id=%s\n", r->name, tmode, trash_id);
+           apr_thread_mutex_lock(r->mutex);
+           if (nbytes < 0) nbytes = 0;
+           r->trash_size[tmode] = (r->trash_size[tmode] > nbytes) ? r->trash_size[tmode] - nbytes : 0;
+           if (r->n_trash[tmode] > 0) r->n_trash[tmode]--;
+           apr_thread_mutex_unlock(r->mutex);
+        }
+     }
+
+     if ((i % 100) == 0) tbx_atomic_inc(r->counter);
+  }
+
+  free(e);
+
+  if (n > 0) log_printf(5, "rid=%s n=%d lag=" TT "\n", r->name, n, r->expire_lag);
+
+  return(n);
+}
+
 //*****************************************************************
 // resource_cleanup_thread - Thread for doing background cleanups
 //*****************************************************************
@@ -2531,7 +3133,8 @@ void *resource_cleanup_thread(apr_thread_t *th, void *data)
   Resource_t *r = (Resource_t *)data;
   ibp_time_t delete_oldest, expire_oldest, wipe_start, start_time;
   apr_interval_time_t t;
-  int count;
+  struct statfs stat;
+  int count, n;
 
   log_printf(5, "resource_cleanup_thread: Start.  rid=%s time= " TT "\n",r->name, apr_time_now());
 
@@ -2555,25 +3158,47 @@ void *resource_cleanup_thread(apr_thread_t *th, void *data)
         delete_oldest = trash_rescan(r, RES_DELETE_INDEX);
         expire_oldest = trash_rescan(r, RES_EXPIRE_INDEX);
 
+        if (r->expire_wheel != NULL) {  //** Pick up anything the wheel missed
+           delete_oldest = trash_cleanup(r, RES_DELETE_INDEX, ibp_time_now() - r->trash_grace_period[RES_DELETE_INDEX], 1);
+           expire_oldest = trash_cleanup(r, RES_EXPIRE_INDEX, ibp_time_now() - r->trash_grace_period[RES_EXPIRE_INDEX], 1);
+        }
+
         apr_thread_mutex_lock(r->cleanup_lock);
         r->next_rescan = ibp_time_now() + r->rescan_interval;
      }
      apr_thread_mutex_unlock(r->cleanup_lock);
 
-     wipe_start = ibp_time_now() - r->trash_grace_period[RES_DELETE_INDEX];
-     log_printf(10, "resource_cleanup_thread: rid=%s wipe_start_delete=" TT " oldest=" TT " now=" TT " grace=" TT "\n", r->name, ibp2apr_time(wipe_start), ibp2apr_time(delete_oldest), ibp2apr_time(ibp_time_now()), ibp2apr_time(r->trash_grace_period[RES_DELETE_INDEX]));
-     if (wipe_start >= delete_oldest) delete_oldest = trash_cleanup(r, RES_DELETE_INDEX, wipe_start, 1);
+     if (r->expire_wheel != NULL) {
+        //** Seed the wheel once the DB is complete
+        if ((r->expire_wheel_loaded == 0) && (r->rebuild_active == 0)) expire_wheel_load(r);
 
-     wipe_start = ibp_time_now() - r->trash_grace_period[RES_EXPIRE_INDEX];
-     log_printf(10, "resource_cleanup_thread: rid=%s wipe_start_expire=" TT " oldest=" TT " now=" TT " grace=" TT "\n", r->name, ibp2apr_time(wipe_start), ibp2apr_time(expire_oldest), ibp2apr_time(ibp_time_now()), ibp2apr_time(r->trash_grace_period[RES_EXPIRE_INDEX]));
-     if (wipe_start >= expire_oldest) expire_oldest = trash_cleanup(r, RES_EXPIRE_INDEX, wipe_start, 1);
+        n = (r->expire_wheel_loaded == 1) ? expire_wheel_tick(r) : 0;
+
+        //** The wheel only purges trash by age so fall back to a walk if we're short on space
+        osd_statfs(r->dev, &stat);
+        if (((ibp_off_t)stat.f_bavail*(ibp_off_t)stat.f_bsize) < r->minfree) {
+           delete_oldest = trash_cleanup(r, RES_DELETE_INDEX, ibp_time_now() - r->trash_grace_period[RES_DELETE_INDEX], 1);
+           expire_oldest = trash_cleanup(r, RES_EXPIRE_INDEX, ibp_time_now() - r->trash_grace_period[RES_EXPIRE_INDEX], 1);
+        }
+
+        t = (n == r->expire_batch) ? 0 : apr_time_from_sec(1);  //** Keep going if there's a backlog
+     } else {
+        wipe_start = ibp_time_now() - r->trash_grace_period[RES_DELETE_INDEX];
+        log_printf(10, "resource_cleanup_thread: rid=%s wipe_start_delete=" TT " oldest=" TT " now=" TT " grace=" TT "\n", r->name, ibp2apr_time(wipe_start), ibp2apr_time(delete_oldest), ibp2apr_time(ibp_time_now()), ibp2apr_time(r->trash_grace_period[RES_DELETE_INDEX]));
+        if (wipe_start >= delete_oldest) delete_oldest = trash_cleanup(r, RES_DELETE_INDEX, wipe_start, 1);
 
-     log_printf(10, "resource_cleanup_thread: rid=%s expire_oldest=" TT " delete_oldest=" TT "\n", r->name, ibp2apr_time(expire_oldest), ibp2apr_time(delete_oldest));
-     resource_cleanup(r, start_time);
+        wipe_start = ibp_time_now() - r->trash_grace_period[RES_EXPIRE_INDEX];
+        log_printf(10, "resource_cleanup_thread: rid=%s wipe_start_expire=" TT " oldest=" TT " now=" TT " grace=" TT "\n", r->name, ibp2apr_time(wipe_start), ibp2apr_time(expire_oldest), ibp2apr_time(ibp_time_now()), ibp2apr_time(r->trash_grace_period[RES_EXPIRE_INDEX]));
+        if (wipe_start >= expire_oldest) expire_oldest = trash_cleanup(r, RES_EXPIRE_INDEX, wipe_start, 1);
+
+        log_printf(10, "resource_cleanup_thread: rid=%s expire_oldest=" TT " delete_oldest=" TT "\n", r->name, ibp2apr_time(expire_oldest), ibp2apr_time(delete_oldest));
+        resource_cleanup(r, start_time);
+
+        t = 1000000 * r->cleanup_interval;    //Cleanup interval in us
+     }
 
-     t = 1000000 * r->cleanup_interval;    //Cleanup interval in us
      apr_thread_mutex_lock(r->cleanup_lock);
-     if (r->cleanup_shutdown == 0) {
+     if ((r->cleanup_shutdown == 0) && (t > 0)) {
         log_printf(5, "resource_cleanup_thread: Sleeping rid=%s time= " TT " shutdown=%d\n",r->name, apr_time_now(), r->cleanup_shutdown);
         apr_thread_cond_timedwait(r->cleanup_cond, r->cleanup_lock, t);
      }
@@ -2608,3 +3233,64 @@ void launch_resource_cleanup_thread(Resource_t *r)
   apr_thread_create(&(r->cleanup_thread), r->cleanup_attr, resource_cleanup_thread, (void *)r, r->pool);
 }
 
+//*****************************************************************
+// resource_io_thread - Executes disk tasks submitted to the que
+//*****************************************************************
+
+void *resource_io_thread(apr_thread_t *th, void *data)
+{
+  tbx_que_t *que = (tbx_que_t *)data;
+  res_io_op_t *op;
+
+  while (1) {
+     tbx_que_get(que, &op, TBX_QUE_BLOCK);
+     if (op == NULL) break;  //** Shutdown
+
+     op->err = op->fn(op);
+     tbx_que_put(op->done, &op, TBX_QUE_BLOCK);
+  }
+
+  apr_thread_exit(th, 0);
+  return(NULL);
+}
+
+//*****************************************************************
+// launch_resource_io_threads - Launches the disk I/O threads.  Each
+//    thread has its own que so all the tasks for an object are
+//    executed in order.
+//*****************************************************************
+
+void launch_resource_io_threads(Resource_t *r)
+{
+  int i;
+
+  if (r->n_io_threads <= 0) return;
+
+  tbx_type_malloc_clear(r->io_thread, apr_thread_t *, r->n_io_threads);
+  tbx_type_malloc_clear(r->io_que, tbx_que_t *, r->n_io_threads);
+
+  for (i=0; i<r->n_io_threads; i++) {
+     r->io_que[i] = tbx_que_create(1024, sizeof(res_io_op_t *));
+     apr_thread_create(&(r->io_thread[i]), r->cleanup_attr, resource_io_thread, (void *)r->io_que[i], r->pool);
+  }
+}
+
+//*****************************************************************
+// resource_io_enabled - Returns 1 if the I/O threads are running
+//*****************************************************************
+
+int resource_io_enabled(Resource_t *r)
+{
+  return((r->io_thread == NULL) ? 0 : 1);
+}
+
+//*****************************************************************
+// resource_io_submit - Hands the op off to the I/O thread for the object.
+//    On completion the op is placed on op->done.
+//*****************************************************************
+
+void resource_io_submit(Resource_t *r, osd_id_t id, res_io_op_t *op)
+{
+  tbx_que_put(r->io_que[id % r->n_io_threads], &op, TBX_QUE_BLOCK);
+}
+
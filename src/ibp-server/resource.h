@@ -24,6 +24,7 @@
 #include "rid.h"
 #include "db_resource.h"
 #include "osd.h"
+#include "expire_wheel.h"
 #include <tbx/chksum.h>
 #include "ibp_time.h"
 #include <apr_thread_proc.h>
@@ -32,6 +33,7 @@
 #include <apr_pools.h>
 #include <tbx/atomic_counter.h>
 #include <tbx/iniparse.h>
+#include <tbx/que.h>
 
 #define _RESOURCE_VERSION 100000
 
@@ -65,6 +67,16 @@ extern const char *_res_types[];
 
 //typedef uint64_t ibp_off_t;    //Resource size
 
+typedef struct res_io_op_s res_io_op_t;
+typedef struct res_rebuild_s res_rebuild_t;
+
+struct res_io_op_s {   //** Disk task handed off to one of the resource's I/O threads
+   ibp_off_t (*fn)(res_io_op_t *op);  //** Routine to execute
+   void *arg;                         //** Private data for fn
+   ibp_off_t err;                     //** Return value of fn
+   tbx_que_t *done;                   //** The op is placed here once fn completes
+};
+
 typedef struct {       //Resource structure
    char *keygroup;         //Keyfile group name
    char *name;             //Descriptive resource name
@@ -112,6 +124,22 @@ typedef struct {       //Resource structure
    apr_thread_cond_t  *cleanup_cond;  //Used to shutdown the cleanup thread
    apr_threadattr_t   *cleanup_attr;  //Used for setting the thread stack size
    apr_thread_t       *cleanup_thread;
+   int                io_engine;      //How normal allocation data is accessed.  FS_IO_STDIO or FS_IO_URING
+   int                uring_depth;    //io_uring queue depth
+   int                direct_io;      //Use O_DIRECT for aligned I/O
+   int                n_io_threads;   //Number of disk I/O threads
+   apr_thread_t       **io_thread;    //Disk I/O threads used for pipelining transfers
+   tbx_que_t          **io_que;       //Task que for each I/O thread
+   int                rebuild_threads;     //Number of threads walking the device during a rebuild
+   int                rebuild_background;  //If 1 the rebuild runs in the background and the resource is read-only until it completes
+   int                rebuild_checkpoint_interval; //Number of partitions walked between rebuild checkpoints
+   int                rebuild_active;      //Set while a background rebuild is running
+   int                rebuild_shutdown;    //Tells the rebuild threads to stop
+   apr_thread_t       *rebuild_thread;     //Background rebuild thread
+   int                expire_batch;        //Max number of wheel entries processed per cleanup pass.  0 disables the wheel
+   expire_wheel_t     *expire_wheel;       //Drives expiration and trash purging.  NULL if disabled
+   int                expire_wheel_loaded; //Set once the wheel has been seeded from the DB and trash
+   ibp_time_t         expire_lag;          //How far behind the wheel is in seconds
    apr_pool_t         *pool;
 } Resource_t;
 
@@ -150,10 +178,13 @@ IBPS_API int get_allocation_state(Resource_t *r, osd_fd_t *fd);
 IBPS_API osd_fd_t *open_allocation(Resource_t *r, osd_id_t id, int mode);
 IBPS_API int close_allocation(Resource_t *r, osd_fd_t *fd);
 IBPS_API int remove_allocation_resource(Resource_t *r, int rmode, Allocation_t *alloc);
+IBPS_API int remove_allocation_bulk_resource(Resource_t *r, int rmode, Allocation_t *a, int n);
 IBPS_API void free_expired_allocations(Resource_t *r);
 IBPS_API uint64_t resource_allocable(Resource_t *r, int free_space);
 IBPS_API int create_allocation_resource(Resource_t *r, Allocation_t *a, ibp_off_t size, int type,
     int reliability, ibp_time_t length, int is_alias, int preallocate_space, int cs_type, ibp_off_t blocksize);
+IBPS_API int create_allocation_bulk_resource(Resource_t *r, Allocation_t *a, int n, ibp_off_t size, int type,
+    int reliability, ibp_time_t length, int preallocate_space, int cs_type, ibp_off_t blocksize);
 IBPS_API int resource_undelete(Resource_t *r, int trash_type, const char *trash_id, time_t expiration, Allocation_t *recovered_a);
 IBPS_API int split_allocation_resource(Resource_t *r, Allocation_t *ma, Allocation_t *a, ibp_off_t size, int type,
     int reliability, ibp_time_t length, int is_alias, int preallocate_space, int cs_type, ibp_off_t cs_blocksize);
@@ -166,11 +197,14 @@ IBPS_API int merge_allocation_resource(Resource_t *r, Allocation_t *ma, Allocati
 IBPS_API int get_allocation_by_cap_resource(Resource_t *r, int cap_type, Cap_t *cap, Allocation_t *a);
 IBPS_API int get_allocation_resource(Resource_t *r, osd_id_t id, Allocation_t *a);
 IBPS_API int modify_allocation_resource(Resource_t *r, osd_id_t id, Allocation_t *a);
+IBPS_API int modify_allocation_bulk_resource(Resource_t *r, Allocation_t *a, int n);
 IBPS_API int get_manage_allocation_resource(Resource_t *r, Cap_t *mcap, Allocation_t *a);
 IBPS_API int write_allocation_header(Resource_t *r, Allocation_t *a, int do_blank);
 IBPS_API int read_allocation_header(Resource_t *r, osd_id_t id, Allocation_t *a);
 IBPS_API ibp_off_t write_allocation(Resource_t *r, osd_fd_t *fd, ibp_off_t offset, ibp_off_t len, void *buffer);
 IBPS_API ibp_off_t read_allocation(Resource_t *r, osd_fd_t *fd, ibp_off_t offset, ibp_off_t len, void *buffer);
+IBPS_API int native_fd_allocation(Resource_t *r, osd_fd_t *fd);
+IBPS_API ibp_off_t sendfile_allocation(Resource_t *r, int afd, int sfd, ibp_off_t offset, ibp_off_t len);
 IBPS_API int print_allocation_resource(Resource_t *r, FILE *fd, Allocation_t *a);
 IBPS_API int calc_expired_space(Resource_t *r, time_t timestamp, ibp_off_t *nbytes);
 IBPS_API walk_expire_iterator_t *walk_expire_iterator_begin(Resource_t *r);
@@ -178,7 +212,11 @@ IBPS_API void walk_expire_iterator_end(walk_expire_iterator_t *wei);
 IBPS_API int set_walk_expire_iterator(walk_expire_iterator_t *wei, time_t t);
 IBPS_API int get_next_walk_expire_iterator(walk_expire_iterator_t *wei, int direction, Allocation_t *a);
 IBPS_API void resource_rescan(Resource_t *r);
+IBPS_API int expire_wheel_tick(Resource_t *r);
 IBPS_API void launch_resource_cleanup_thread(Resource_t *r);
+IBPS_API void launch_resource_io_threads(Resource_t *r);
+IBPS_API int resource_io_enabled(Resource_t *r);
+IBPS_API void resource_io_submit(Resource_t *r, osd_id_t id, res_io_op_t *op);
 
 IBPS_API int resource_get_mode(Resource_t *r);
 IBPS_API int resource_set_mode(Resource_t *r, int mode);
@@ -272,7 +272,8 @@ int print_config(char *buffer, int *used, int nbytes, Config_t *cfg)
 
   tbx_append_printf(buffer, used, nbytes, "threads = %d\n", server->max_threads);
   tbx_append_printf(buffer, used, nbytes, "max_pending = %d\n", server->max_pending);
-//  tbx_append_printf(buffer, used, nbytes, "max_connections = %d\n", server->max_connections);
+  tbx_append_printf(buffer, used, nbytes, "epoll_enable = %d\n", server->epoll_enable);
+  tbx_append_printf(buffer, used, nbytes, "max_connections = %d\n", server->max_connections);
   tbx_append_printf(buffer, used, nbytes, "min_idle = " TT "\n", apr_time_sec(server->min_idle));
   tbx_ns_timeout_get(server->timeout, &d, &k);
 //log_printf(0, "print_timeout: s=%d ms=%d\n",d, k); 
@@ -283,6 +284,7 @@ int print_config(char *buffer, int *used, int nbytes, Config_t *cfg)
   tbx_append_printf(buffer, used, nbytes, "lazy_allocate = %d\n", server->lazy_allocate);
   tbx_append_printf(buffer, used, nbytes, "big_alloc_enable = %d\n", server->big_alloc_enable);
   tbx_append_printf(buffer, used, nbytes, "splice_enable = %d\n", server->splice_enable);
+  tbx_append_printf(buffer, used, nbytes, "write_pipeline_depth = %d\n", server->write_pipeline_depth);
   tbx_append_printf(buffer, used, nbytes, "db_env_loc = %s\n", cfg->dbenv_loc);
   tbx_append_printf(buffer, used, nbytes, "db_mem = %d\n", cfg->db_mem);
   tbx_append_printf(buffer, used, nbytes, "log_file = %s\n", server->logfile);
@@ -300,6 +302,9 @@ int print_config(char *buffer, int *used, int nbytes, Config_t *cfg)
   tbx_append_printf(buffer, used, nbytes, "activity_max_history = %d\n", server->alog_max_history);
   tbx_append_printf(buffer, used, nbytes, "activity_host = %s\n", server->alog_host);
   tbx_append_printf(buffer, used, nbytes, "activity_port = %d\n", server->alog_port);
+  tbx_append_printf(buffer, used, nbytes, "activity_ring_kb = %d\n", server->alog_ring_size/1024);
+  tbx_append_printf(buffer, used, nbytes, "activity_flush_ms = %d\n", server->alog_flush_interval);
+  tbx_append_printf(buffer, used, nbytes, "activity_compress = %d\n", server->alog_compress);
   tbx_append_printf(buffer, used, nbytes, "\n");
   tbx_append_printf(buffer, used, nbytes, "force_resource_rebuild = %d\n", cfg->force_resource_rebuild);
   tbx_append_printf(buffer, used, nbytes, "truncate_duration = %d\n", cfg->truncate_expiration);
@@ -340,7 +345,7 @@ int read_command(ibp_task_t *task)
    int bufsize = 200*1024;
    char buffer[bufsize];
    char *bstate;
-   int  nbytes, status, offset, count, close_request;
+   int  nbytes, status, offset, count, close_request, wait_secs;
    int err, fin;
    apr_time_t endtime;
    command_t *mycmd;
@@ -361,7 +366,15 @@ int read_command(ibp_task_t *task)
    tbx_ns_timeout_set(&dt, 1, 0);
    offset = 0;
    count = sizeof(buffer);
-   endtime = apr_time_now() + global_config->server.min_idle; //** Wait for the min_idle time
+   if (global_config->server.epoll_enable == 1) {
+      //** The connection was only handed to us because it's readable so the whole
+      //** command gets the network timeout.  Idle waiting is done by the poller.
+      wait_secs = (global_config->server.timeout_secs > 0) ? global_config->server.timeout_secs : 1;
+      endtime = apr_time_now() + apr_time_from_sec(wait_secs);
+      dt = global_config->server.timeout;
+   } else {
+      endtime = apr_time_now() + global_config->server.min_idle; //** Wait for the min_idle time
+   }
    close_request = 0;
    do {
      nbytes = server_ns_readline_raw(ns, &(buffer[offset]), count - offset, dt, &status);
@@ -571,7 +584,8 @@ void *worker_task(apr_thread_t *ath, void *arg)
    release_thread_slot(myid);
 
    //** Notify the client why I'm closing.  IF already closed this just returns
-   reject_close(task.ns);
+   //** A binary protocol client can't parse it and the executors may still be sending replies
+   if (proto_v2_active(task.ns) == 0) reject_close(task.ns);
 
    tbx_ns_close(task.ns);
    release_task(th);
@@ -665,6 +679,44 @@ void spawn_new_task(tbx_ns_t *ns, int reject_connection)
   apr_thread_create(&(t->thread), t->attr, worker_task, (void *)t, t->pool);
 }
 
+//*****************************************************************
+// reserve_connection - Accounts for a new connection handled by the
+//     epoll engine.  No thread is associated with it.
+//*****************************************************************
+
+void reserve_connection()
+{
+  apr_thread_mutex_lock(taskmgr.lock);
+  taskmgr.curr_threads++;
+  apr_thread_mutex_unlock(taskmgr.lock);
+}
+
+//*****************************************************************
+// release_connection - Releases an epoll engine connection
+//*****************************************************************
+
+void release_connection()
+{
+  apr_thread_mutex_lock(taskmgr.lock);
+  taskmgr.curr_threads--;
+  apr_thread_cond_signal(taskmgr.cond);
+  apr_thread_mutex_unlock(taskmgr.lock);
+}
+
+//*****************************************************************
+// task_slot_count - Returns the number of thread slots needed.  With
+//     the epoll engine each open connection holds a slot.
+//*****************************************************************
+
+int task_slot_count(Config_t *cfg)
+{
+  if (cfg->server.epoll_enable == 1) {
+     return(cfg->server.max_connections + 2*cfg->server.max_threads);
+  }
+
+  return(2*cfg->server.max_threads);
+}
+
 //*****************************************************************
 // release_task - Releases the current task back for respawning
 //*****************************************************************
@@ -859,7 +911,9 @@ void wait_all_tasks()
 
 void init_tasks()
 {
-  taskmgr.max_threads = global_config->server.max_threads;
+  //** With the epoll engine the limit is on open connections not threads
+  taskmgr.max_threads = (global_config->server.epoll_enable == 1) ?
+        global_config->server.max_connections : global_config->server.max_threads;
   taskmgr.curr_threads = 0;
   taskmgr.request_thread = 0;
   taskmgr.reject_count = 0;
@@ -924,6 +978,7 @@ log_printf(0, "shutdown_now=%d\n", shutdown_now);
   }
 
   init_tasks();
+  if (config->server.epoll_enable == 1) epoll_engine_start(config);
 
   //*** Main processing loop ***
   while (shutdown_request() == 0) {
@@ -934,7 +989,11 @@ log_printf(0, "shutdown_now=%d\n", shutdown_now);
 //        wait_for_free_task();
         ns = tbx_ns_new();
         if (tbx_network_accept_pending_connection(network, ns) == 0) {
-           spawn_new_task(ns, to_many_connections());
+           if (config->server.epoll_enable == 1) {
+              epoll_engine_add(ns, to_many_connections());
+           } else {
+              spawn_new_task(ns, to_many_connections());
+           }
         } else {
            tbx_ns_destroy(ns);
         }
@@ -954,6 +1013,8 @@ log_printf(0, "shutdown_now=%d\n", shutdown_now);
 
   tbx_network_close(network);  //** Stop accepting connections
 
+  if (config->server.epoll_enable == 1) epoll_engine_stop();  //** Closes all the idle connections
+
   close_tasks();
 
   log_printf(15, "before tbx_network_close\n"); tbx_log_flush();
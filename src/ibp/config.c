@@ -16,6 +16,7 @@
 
 #define _log_module_index 129
 
+#include <apr_hash.h>
 #include <apr_pools.h>
 #include <apr_thread_mutex.h>
 #include <apr_thread_proc.h>
@@ -81,6 +82,7 @@ static ibp_context_t ibp_default_options = {
     .max_retry = 2,
     .transfer_rate = 0,
     .rr_size = 4,
+    .proto_version = IBP_PROTO_V1,
     .connection_mode = IBP_CMODE_HOST
 };
 
@@ -495,6 +497,15 @@ int _ibp_connect(tbx_ns_t *ns, void *connect_context, char *host, int port, tbx_
         i=-i;
     }
     n = tbx_ns_connect(ns, host, port, timeout);
+
+    //** Switch over to the binary protocol if requested.  The RID is left off so all RIDs share the depot status
+    if ((n == 0) && (cc != NULL) && (cc->proto >= IBP_PROTO_V2)) {
+        n = ibp_v2_negotiate(ns, cc, host, port, timeout);
+        if (n == 2) {  //** Old depot so reconnect using text
+            tbx_ns_close(ns);
+            n = _ibp_connect(ns, connect_context, host, port, timeout);
+        }
+    }
     if (i<0) host[-i] = '#';
 
     return(n);
@@ -628,6 +639,7 @@ void ibp_print_running_config( ibp_context_t *ic, FILE *fd, int print_section_he
     fprintf(fd, "rr_size = %d\n", ic->rr_size);
     fprintf(fd, "connection_mode = %d\n", ic->connection_mode);
     fprintf(fd, "transfer_rate = %s\n", tbx_stk_pretty_print_int_with_scale(ic->transfer_rate, text));
+    fprintf(fd, "protocol_version = %d\n", ic->proto_version);
     fprintf(fd, "\n");
 
     fprintf(fd, "ibp_allocate = %s\n", cc_type2str(ic->cc[IBP_ALLOCATE].type));
@@ -643,10 +655,24 @@ void ibp_print_running_config( ibp_context_t *ic, FILE *fd, int print_section_he
     fprintf(fd, "ibp_phoebus_send = %s\n", cc_type2str(ic->cc[IBP_PHOEBUS_SEND].type));
     fprintf(fd, "ibp_push = %s\n", cc_type2str(ic->cc[IBP_PUSH].type));
     fprintf(fd, "ibp_pull = %s\n", cc_type2str(ic->cc[IBP_PULL].type));
+    fprintf(fd, "ibp_protocol = %s\n", cc_type2str(ic->cc[IBP_PROTOCOL].type));
+    fprintf(fd, "ibp_bulk_allocate = %s\n", cc_type2str(ic->cc[IBP_BULK_ALLOCATE].type));
+    fprintf(fd, "ibp_bulk_manage = %s\n", cc_type2str(ic->cc[IBP_BULK_MANAGE].type));
     fprintf(fd, "\n");
 
 }
 
+//**********************************************************
+// ibp_proto_cc_set - Flags the IBP_PROTOCOL CC for negotiation if the
+//     binary protocol is enabled
+//**********************************************************
+
+void ibp_proto_cc_set(ibp_context_t *ic)
+{
+    ic->cc[IBP_PROTOCOL].proto = (ic->proto_version >= IBP_PROTO_V2) ? IBP_PROTO_V2 : 0;
+    ic->cc[IBP_PROTOCOL].data = ic;
+}
+
 //**********************************************************
 // cc_load - Stores a CC from the given keyfile
 //**********************************************************
@@ -682,6 +708,8 @@ void ibp_cc_load(tbx_inip_file_t *kf, ibp_context_t *cfg)
     //** Set everything to the default **
     cc.type = NS_TYPE_SOCK;
     cc.tcpsize = 0;
+    cc.proto = 0;
+    cc.data = NULL;
     cc_load(kf, "default", &cc);
     for (i=0; i<=IBP_MAX_NUM_CMDS; i++) cfg->cc[i] = cc;
 
@@ -699,6 +727,12 @@ void ibp_cc_load(tbx_inip_file_t *kf, ibp_context_t *cfg)
     cc_load(kf, "ibp_phoebus_send", &(cfg->cc[IBP_PHOEBUS_SEND]));
     cc_load(kf, "ibp_push", &(cfg->cc[IBP_PUSH]));
     cc_load(kf, "ibp_pull", &(cfg->cc[IBP_PULL]));
+    cc_load(kf, "ibp_protocol", &(cfg->cc[IBP_PROTOCOL]));
+    cc_load(kf, "ibp_bulk_allocate", &(cfg->cc[IBP_BULK_ALLOCATE]));
+    cc_load(kf, "ibp_bulk_manage", &(cfg->cc[IBP_BULK_MANAGE]));
+
+    //** R/W ops using the binary protocol go through this CC
+    ibp_proto_cc_set(cfg);
 }
 
 
@@ -720,6 +754,7 @@ int ibp_config_load(ibp_context_t *ic, tbx_inip_file_t *keyfile, char *section)
     ic->connection_mode = tbx_inip_get_integer(keyfile, section, "connection_mode", ic->connection_mode);
     ic->transfer_rate = tbx_inip_get_double(keyfile, section, "transfer_rate", ic->transfer_rate);
     ic->rr_size = tbx_inip_get_integer(keyfile, section, "rr_size", ic->rr_size);
+    ic->proto_version = tbx_inip_get_integer(keyfile, section, "protocol_version", ic->proto_version);
 
     ibp_cc_load(keyfile, ic);
 
@@ -771,10 +806,13 @@ void default_ibp_config(ibp_context_t *ic)
     ic->transfer_rate = ibp_default_options.transfer_rate;
     ic->rr_size = ibp_default_options.rr_size;
     ic->connection_mode = ibp_default_options.connection_mode;
+    ic->proto_version = ibp_default_options.proto_version;
 
     for (i=0; i<=IBP_MAX_NUM_CMDS; i++) {
         ic->cc[i].type = NS_TYPE_SOCK;
+        ic->cc[i].proto = 0;
     }
+    ibp_proto_cc_set(ic);
 }
 
 
@@ -799,6 +837,7 @@ ibp_context_t *ibp_context_create()
     default_ibp_config(ic);
 
     apr_pool_create(&(ic->mpool), NULL);
+    ic->v1_depots = apr_hash_make(ic->mpool);
 
     if (_ibp_context_count == 0) {
         ibp_errno_init();
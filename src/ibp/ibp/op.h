@@ -33,6 +33,8 @@ extern "C" {
 // Typedefs
 typedef struct ibp_context_t ibp_context_t;
 typedef struct ibp_op_alloc_t ibp_op_alloc_t;
+typedef struct ibp_op_bulk_alloc_t ibp_op_bulk_alloc_t;
+typedef struct ibp_op_bulk_manage_t ibp_op_bulk_manage_t;
 typedef struct ibp_op_copy_t ibp_op_copy_t;
 typedef struct ibp_op_depot_inq_t ibp_op_depot_inq_t;
 typedef struct ibp_op_depot_modify_t ibp_op_depot_modify_t;
@@ -59,6 +61,10 @@ IBP_API gop_op_generic_t *ibp_proxy_remove_gop(ibp_context_t *ic, ibp_cap_t *cap
 IBP_API gop_op_generic_t *ibp_proxy_probe_gop(ibp_context_t *ic, ibp_cap_t *cap, ibp_proxy_capstatus_t *probe, int timeout);
 IBP_API gop_op_generic_t *ibp_alloc_gop(ibp_context_t *ic, ibp_capset_t *caps, ibp_off_t size, ibp_depot_t *depot, ibp_attributes_t *attr, int disk_cs_type, ibp_off_t disk_blocksize, int timeout);
 IBP_API gop_op_generic_t *ibp_append_gop(ibp_context_t *ic, ibp_cap_t *cap, tbx_tbuf_t *buffer, ibp_off_t boff, ibp_off_t len, int timeout);
+IBP_API gop_op_generic_t *ibp_bulk_alloc_gop(ibp_context_t *ic, ibp_capset_t **caps, int n, ibp_off_t size, ibp_depot_t *depot, ibp_attributes_t *attr, int disk_cs_type, ibp_off_t disk_blocksize, int timeout);
+IBP_API gop_op_generic_t *ibp_bulk_probe_gop(ibp_context_t *ic, ibp_cap_t **caps, int n, ibp_capstatus_t **probe, int *status, int timeout);
+IBP_API gop_op_generic_t *ibp_bulk_modify_duration_gop(ibp_context_t *ic, ibp_cap_t **caps, int n, int duration, int *status, int timeout);
+IBP_API gop_op_generic_t *ibp_bulk_remove_gop(ibp_context_t *ic, ibp_cap_t **caps, int n, int *status, int timeout);
 IBP_API int ibp_cc_type(ibp_connect_context_t *cc);
 IBP_API int ibp_chksum_set(ibp_context_t *ic, tbx_ns_chksum_t *ncs);
 IBP_API int ibp_config_load(ibp_context_t *ic, tbx_inip_file_t *ifd, char *section);
@@ -79,7 +85,9 @@ IBP_API gop_op_generic_t *ibp_query_resources_gop(ibp_context_t *ic, ibp_depot_t
 IBP_API void ibp_read_cc_set(ibp_context_t *ic, ibp_connect_context_t *cc);
 IBP_API gop_op_generic_t *ibp_read_gop(ibp_context_t *ic, ibp_cap_t *cap, ibp_off_t offset, tbx_tbuf_t *buffer, ibp_off_t boff, ibp_off_t len, int timeout);
 IBP_API gop_op_generic_t *ibp_remove_gop(ibp_context_t *ic, ibp_cap_t *cap, int timeout);
+IBP_API apr_time_t ibp_rw_estimate(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, ibp_off_t len);
 IBP_API gop_op_generic_t *ibp_rw_gop(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, ibp_off_t offset, tbx_tbuf_t *buffer, ibp_off_t boff, ibp_off_t len, int timeout);
+IBP_API apr_time_t ibp_rw_latency(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, double fraction);
 IBP_API void ibp_tcpsize_set(ibp_context_t *ic, int n);
 IBP_API gop_op_generic_t *ibp_truncate_gop(ibp_context_t *ic, ibp_cap_t *cap, ibp_off_t size, int timeout);
 IBP_API gop_op_generic_t *ibp_validate_chksum_gop(ibp_context_t *ic, ibp_cap_t *mcap, int correct_errors, int *n_bad_blocks, int timeout);
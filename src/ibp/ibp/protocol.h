@@ -73,8 +73,20 @@
 #define   IBP_VEC_WRITE_CHKSUM  34
 #define   IBP_VEC_READ          35
 #define   IBP_VEC_READ_CHKSUM   36
+#define   IBP_PROTOCOL          37
+#define   IBP_BULK_ALLOCATE     38
+#define   IBP_BULK_MANAGE       39
 
-#define   IBP_MAX_NUM_CMDS      36
+#define   IBP_MAX_NUM_CMDS      39
+
+#define   IBP_MAX_BULK          1024  //** Max number of allocations or caps in a single bulk command
+
+//** Wire protocol versions negotiated with IBP_PROTOCOL
+#define   IBP_PROTO_V1          1   //** Line based text protocol
+#define   IBP_PROTO_V2          2   //** Binary frames with request IDs and out of order replies
+
+#define   IBP_V2_REQ_HEADER     24  //** Request frame header size
+#define   IBP_V2_RESP_HEADER    16  //** Response frame header size
 
 #define   IBP_TCP          1
 #define  IBP_PHOEBUS      2
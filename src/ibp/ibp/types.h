@@ -148,6 +148,7 @@ struct ibp_timer_t {
 struct ibp_connect_context_t {
     int type;           //** Type of connection as defined in network.h
     int tcpsize;        //** All types have this parameter
+    int proto;          //** Wire protocol to negotiate after connecting.  0 means stay with text
     void *data;         //** Generic container for context data
 };
 
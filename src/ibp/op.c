@@ -70,6 +70,10 @@ gop_op_status_t proxy_probe_recv(gop_op_generic_t *gop, tbx_ns_t *ns);
 gop_op_status_t allocate_command(gop_op_generic_t *gop, tbx_ns_t *ns);
 gop_op_status_t allocate_recv(gop_op_generic_t *gop, tbx_ns_t *ns);
 gop_op_status_t append_command(gop_op_generic_t *gop, tbx_ns_t *ns);
+gop_op_status_t bulk_allocate_command(gop_op_generic_t *gop, tbx_ns_t *ns);
+gop_op_status_t bulk_allocate_recv(gop_op_generic_t *gop, tbx_ns_t *ns);
+gop_op_status_t bulk_manage_command(gop_op_generic_t *gop, tbx_ns_t *ns);
+gop_op_status_t bulk_manage_recv(gop_op_generic_t *gop, tbx_ns_t *ns);
 gop_op_status_t copy_recv(gop_op_generic_t *gop, tbx_ns_t *ns);
 gop_op_status_t copyappend_command(gop_op_generic_t *gop, tbx_ns_t *ns);
 gop_op_status_t depot_inq_command(gop_op_generic_t *gop, tbx_ns_t *ns);
@@ -159,9 +163,10 @@ void set_hostport(char *hostport, int max_size, char *host, int port, ibp_connec
 {
     char in_addr[DNS_ADDR_MAX];
     char ip[64];
-    int type, i;
+    int type, proto, i;
 
     type = (cc == NULL) ? NS_TYPE_SOCK : cc->type;
+    proto = (cc == NULL) ? 0 : cc->proto;
 
     i = 0;
     while ((host[i] != 0) && (host[i] != '#')) i++;
@@ -174,7 +179,7 @@ void set_hostport(char *hostport, int max_size, char *host, int port, ibp_connec
         if (i<0) host[-i] = '#';
         log_printf(1, "set_hostport:  Failed to lookup host: %s\n", host);
         hostport[max_size-1] = '\0';
-        snprintf(hostport, max_size-1, "%s:%d:%d:0", host, port, type);
+        snprintf(hostport, max_size-1, "%s:%d:%d:%d", host, port, type, proto);
         return;
     }
     if (i<0) host[-i] = '#';
@@ -182,8 +187,8 @@ void set_hostport(char *hostport, int max_size, char *host, int port, ibp_connec
     ip[63] = '\0';
 
     hostport[max_size-1] = '\0';
-    snprintf(hostport, max_size-1, "%s" HP_HOSTPORT_SEPARATOR "%d" HP_HOSTPORT_SEPARATOR "%d" HP_HOSTPORT_SEPARATOR "0",
-                 host, port, type);
+    snprintf(hostport, max_size-1, "%s" HP_HOSTPORT_SEPARATOR "%d" HP_HOSTPORT_SEPARATOR "%d" HP_HOSTPORT_SEPARATOR "%d",
+                 host, port, type, proto);
 }
 
 char *change_hostport_cc(char *old_hostport, ibp_connect_context_t *cc)
@@ -299,6 +304,11 @@ void ibp_op_ncs_set(gop_op_generic_t *gop, tbx_ns_chksum_t *ncs)
 
     ibp_op_t *op = ibp_get_iop(gop);
     op->ncs = *ncs;
+
+    //** Chksummed transfers aren't supported by the binary protocol so move it back to text
+    if ((tbx_ns_chksum_is_valid(ncs) == 1) && (op->dop.cmd.connect_context == &(op->ic->cc[IBP_PROTOCOL]))) {
+        ibp_op_cc_set(gop, &(op->ic->cc[op->primary_cmd]));
+    }
 }
 
 int ibp_cc_type(ibp_connect_context_t *cc)
@@ -398,6 +408,7 @@ gop_op_generic_t *ibp_append_gop(ibp_context_t *ic, ibp_cap_t *cap, tbx_tbuf_t *
     if (gop == NULL) return(NULL);
 
     gop->op->cmd.send_command = append_command;
+    ibp_op_cc_set(gop, &(ic->cc[IBP_WRITE]));  //** Appends are text only
     return(gop);
 }
 
@@ -408,6 +419,7 @@ void set_ibp_rw_gop(ibp_op_t *op, int rw_type, ibp_cap_t *cap, ibp_off_t offset,
     char host[MAX_HOST_SIZE];
     ibp_op_rw_t *cmd;
     ibp_rw_buf_t *rwbuf;
+    ibp_connect_context_t *cc;
 
     cmd = &(op->ops.rw_op);
 
@@ -415,9 +427,11 @@ void set_ibp_rw_gop(ibp_op_t *op, int rw_type, ibp_cap_t *cap, ibp_off_t offset,
     gop_op_generic_t *gop = ibp_get_gop(op);
 
 
+    cc = ibp_rw_cc(op->ic, rw_type, &(op->ic->ncs));
     parse_cap(op->ic, cap, host, &port, cmd->key, cmd->typekey);
-    set_hostport(hoststr, sizeof(hoststr), host, port, &(op->ic->cc[rw_type]));
+    set_hostport(hoststr, sizeof(hoststr), host, port, cc);
     op->dop.cmd.hostport = strdup(hoststr);
+    op->dop.cmd.connect_context = cc;
 
     cmd->cap = cap;
     cmd->size = len; //** This is the total size
@@ -465,6 +479,60 @@ gop_op_generic_t *ibp_rw_gop(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, ibp
     return(ibp_get_gop(op));
 }
 
+//*************************************************************
+// ibp_rw_cc - Returns the connect context a R/W op should use.  If the
+//     binary protocol is enabled ops go over it unless they need a network
+//     chksum which is only supported by the text protocol.
+//*************************************************************
+
+ibp_connect_context_t *ibp_rw_cc(ibp_context_t *ic, int rw_type, tbx_ns_chksum_t *ncs)
+{
+    if ((ic->proto_version >= IBP_PROTO_V2) && (tbx_ns_chksum_is_valid(ncs) == 0)) return(&(ic->cc[IBP_PROTOCOL]));
+
+    return(&(ic->cc[rw_type]));
+}
+
+//*************************************************************
+// ibp_rw_hostport - Fills in the hportal key the R/W op would use
+//*************************************************************
+
+void ibp_rw_hostport(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, char *hoststr, int max_size)
+{
+    char host[MAX_HOST_SIZE];
+    char key[MAX_KEY_SIZE], typekey[MAX_KEY_SIZE];
+    int port;
+
+    parse_cap(ic, cap, host, &port, key, typekey);
+    set_hostport(hoststr, max_size, host, port, ibp_rw_cc(ic, rw_type, &(ic->ncs)));
+}
+
+//*************************************************************
+// ibp_rw_estimate - Returns the estimated time to read or write len bytes
+//     using the cap.  This includes any work already queued for the depot.
+//     Returns 0 if nothing is known about the depot.
+//*************************************************************
+
+apr_time_t ibp_rw_estimate(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, ibp_off_t len)
+{
+    char hoststr[MAX_HOST_SIZE];
+
+    ibp_rw_hostport(ic, rw_type, cap, hoststr, sizeof(hoststr));
+    return(gop_hpc_hostport_estimate(ic->pc, hoststr, ic->rw_new_command + len));
+}
+
+//*************************************************************
+// ibp_rw_latency - Returns the depot's command time for the given fraction
+//     of its recent commands.  Returns 0 if nothing is known about the depot.
+//*************************************************************
+
+apr_time_t ibp_rw_latency(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, double fraction)
+{
+    char hoststr[MAX_HOST_SIZE];
+
+    ibp_rw_hostport(ic, rw_type, cap, hoststr, sizeof(hoststr));
+    return(gop_hpc_hostport_latency(ic->pc, hoststr, fraction));
+}
+
 gop_op_generic_t *ibp_validate_chksum_gop(ibp_context_t *ic, ibp_cap_t *mcap, int correct_errors, int *n_bad_blocks,
         int timeout)
 {
@@ -565,6 +633,47 @@ gop_op_generic_t *ibp_alloc_gop(ibp_context_t *ic, ibp_capset_t *caps, ibp_off_t
     return(ibp_get_gop(op));
 }
 
+//*************************************************************
+// ibp_bulk_alloc_gop - Creates n allocations with the same attributes
+//    on the depot using a single IBP_BULK_ALLOCATE command.  Either all
+//    the allocations are created or none are.  n must be <= IBP_MAX_BULK.
+//*************************************************************
+
+gop_op_generic_t *ibp_bulk_alloc_gop(ibp_context_t *ic, ibp_capset_t **caps, int n, ibp_off_t size, ibp_depot_t *depot, ibp_attributes_t *attr,
+                               int disk_cs_type, ibp_off_t disk_blocksize, int timeout)
+{
+    ibp_op_t *op = new_ibp_op(ic);
+
+    char hoststr[MAX_HOST_SIZE];
+    char pchost[MAX_HOST_SIZE];
+    ibp_op_bulk_alloc_t *cmd;
+
+    ibppc_form_host(op->ic, pchost, sizeof(pchost), depot->host, depot->rid);
+    set_hostport(hoststr, sizeof(hoststr), pchost, depot->port, &(op->ic->cc[IBP_BULK_ALLOCATE]));
+
+    init_ibp_base_op(op, "bulk_alloc", timeout, op->ic->other_new_command, strdup(hoststr), 1, IBP_BULK_ALLOCATE, IBP_NOP);
+
+    cmd = &(op->ops.bulk_alloc_op);
+    cmd->caps = caps;
+    cmd->n = n;
+    cmd->depot = depot;
+    cmd->attr = attr;
+
+    cmd->duration = cmd->attr->duration - time(NULL);  //** This is in sec NOT APR time
+    if (cmd->duration < 0) cmd->duration = cmd->attr->duration;
+
+    cmd->size = size;
+    cmd->disk_chksum_type = disk_cs_type;
+    cmd->disk_blocksize = disk_blocksize;
+
+    gop_op_generic_t *gop = ibp_get_gop(op);
+    gop->op->cmd.send_command = bulk_allocate_command;
+    gop->op->cmd.send_phase = NULL;
+    gop->op->cmd.recv_phase = bulk_allocate_recv;
+
+    return(ibp_get_gop(op));
+}
+
 gop_op_generic_t *ibp_split_alloc_gop(ibp_context_t *ic, ibp_cap_t *mcap, ibp_capset_t *caps, ibp_off_t size,
                                      ibp_attributes_t *attr, int disk_cs_type, ibp_off_t disk_blocksize, int timeout)
 {
@@ -887,6 +996,68 @@ gop_op_generic_t *ibp_probe_gop(ibp_context_t *ic, ibp_cap_t *cap, ibp_capstatus
     return(ibp_get_gop(op));
 }
 
+//*************************************************************
+// _ibp_bulk_manage_gop - Generates an IBP_BULK_MANAGE op.  All the caps
+//    must be manage caps for the same depot RID.
+//*************************************************************
+
+gop_op_generic_t *_ibp_bulk_manage_gop(ibp_context_t *ic, int subcmd, ibp_cap_t **caps, int n, int duration, ibp_capstatus_t **probe, int *status, int timeout)
+{
+    ibp_op_t *op = new_ibp_op(ic);
+    char hoststr[MAX_HOST_SIZE];
+    int port, i;
+    char host[MAX_HOST_SIZE];
+    char key[MAX_KEY_SIZE], typekey[MAX_KEY_SIZE];
+    ibp_op_bulk_manage_t *cmd;
+
+    init_ibp_base_op(op, "bulk_manage", timeout, op->ic->other_new_command, NULL, 1, IBP_BULK_MANAGE, subcmd);
+
+    cmd = &(op->ops.bulk_manage_op);
+
+    parse_cap(op->ic, caps[0], host, &port, key, typekey);
+    set_hostport(hoststr, sizeof(hoststr), host, port, &(op->ic->cc[IBP_BULK_MANAGE]));
+    op->dop.cmd.hostport = strdup(hoststr);
+
+    //** The key is RID#key so peel off the RID
+    for (i=0; (key[i] != '#') && (key[i] != '\0'); i++) cmd->rid[i] = key[i];
+    cmd->rid[i] = '\0';
+
+    cmd->subcmd = subcmd;
+    cmd->caps = caps;
+    cmd->n = n;
+    cmd->duration = duration;
+    cmd->probe = probe;
+    cmd->status = status;
+
+    gop_op_generic_t *gop = ibp_get_gop(op);
+    gop->op->cmd.send_command = bulk_manage_command;
+    gop->op->cmd.send_phase = NULL;
+    gop->op->cmd.recv_phase = bulk_manage_recv;
+
+    return(ibp_get_gop(op));
+}
+
+//*************************************************************
+//  The bulk manage ops all act on up to IBP_MAX_BULK manage caps on a single
+//  depot RID.  If status is non-NULL it gets the IBP status for each cap.
+//  The op fails with the first bad cap status if any cap fails.
+//*************************************************************
+
+gop_op_generic_t *ibp_bulk_probe_gop(ibp_context_t *ic, ibp_cap_t **caps, int n, ibp_capstatus_t **probe, int *status, int timeout)
+{
+    return(_ibp_bulk_manage_gop(ic, IBP_PROBE, caps, n, 0, probe, status, timeout));
+}
+
+gop_op_generic_t *ibp_bulk_modify_duration_gop(ibp_context_t *ic, ibp_cap_t **caps, int n, int duration, int *status, int timeout)
+{
+    return(_ibp_bulk_manage_gop(ic, IBP_CHNG, caps, n, duration, NULL, status, timeout));
+}
+
+gop_op_generic_t *ibp_bulk_remove_gop(ibp_context_t *ic, ibp_cap_t **caps, int n, int *status, int timeout)
+{
+    return(_ibp_bulk_manage_gop(ic, IBP_DECR, caps, n, 0, NULL, status, timeout));
+}
+
 gop_op_generic_t *ibp_proxy_probe_gop(ibp_context_t *ic, ibp_cap_t *cap, ibp_proxy_capstatus_t *probe, int timeout)
 {
     ibp_op_t *op = new_ibp_op(ic);
@@ -20,6 +20,7 @@
 #ifndef __IBP_OP_H_
 #define __IBP_OP_H_
 
+#include <apr_hash.h>
 #include <apr_pools.h>
 #include <apr_thread_mutex.h>
 #include <apr_time.h>
@@ -68,6 +69,8 @@ struct ibp_context_t {
     int connection_mode;  //** Connection mode
     int rr_size;          //** Round robin connection count. Only used ir cmode = RR
     double transfer_rate; //** Transfer rate in bytes/sec used for calculating timeouts.  Set to 0 to disable function
+    int proto_version;    //** Highest wire protocol to use for R/W ops.  1 keeps everything on the text protocol
+    apr_hash_t *v1_depots; //** Depots that don't support the binary protocol.  Protected by lock
     tbx_atomic_int_t rr_count; //** RR counter
     ibp_connect_context_t cc[IBP_MAX_NUM_CMDS+1];  //** Default connection contexts for EACH command
     tbx_ns_chksum_t ncs;
@@ -113,11 +116,13 @@ ibp_op_t *new_ibp_op(ibp_context_t *ic);
 
 void init_ibp_base_op(ibp_op_t *op, char *logstr, int timeout, int workload, char *hostport, int cmp_size, int primary_cmd, int sub_cmd);
 void set_ibp_rw_gop(ibp_op_t *op, int rw_type, ibp_cap_t *cap, ibp_off_t offset, tbx_tbuf_t *buffer, ibp_off_t boff, ibp_off_t len, int timeout);
+void ibp_rw_hostport(ibp_context_t *ic, int rw_type, ibp_cap_t *cap, char *hoststr, int max_size);
 void set_ibp_truncate_gop(ibp_op_t *op, ibp_cap_t *cap, ibp_off_t size, int timeout);
 void free_ibp_op(ibp_op_t *iop);
 void finalize_ibp_op(ibp_op_t *iop);
 int ibp_op_status(ibp_op_t *op);
 int ibp_op_id(ibp_op_t *op);
+ibp_connect_context_t *ibp_rw_cc(ibp_context_t *ic, int rw_type, tbx_ns_chksum_t *ncs);
 
 //** IBP_VALDIATE_CHKSUM
 
@@ -135,6 +140,11 @@ void default_ibp_config(ibp_context_t *ic);
 
 void destroy_ibp_sync_context();
 
+//** proto_v2.c **
+int ibp_v2_negotiate(tbx_ns_t *ns, ibp_connect_context_t *cc, char *host, int port, tbx_ns_timeout_t timeout);
+gop_op_status_t ibp_v2_send_command(gop_op_generic_t *gop, tbx_ns_t *ns);
+gop_op_status_t ibp_v2_recv(gop_op_generic_t *gop, tbx_ns_t *ns);
+
 //**** ibp_version.c *******
 
 //******* ibp_errno.c ********
@@ -230,6 +240,27 @@ struct ibp_op_modify_alloc_t {  //** modify Allocation operation
     int        duration;
     int        reliability;
 };
+struct ibp_op_bulk_alloc_t {  //** IBP_BULK_ALLOCATE operation
+    ibp_off_t size;
+    int   duration;
+    int   disk_chksum_type;
+    ibp_off_t  disk_blocksize;
+    int n;                    //** Number of allocations
+    ibp_capset_t **caps;      //** Where to store the caps for each allocation
+    ibp_depot_t *depot;
+    ibp_attributes_t *attr;
+};
+
+struct ibp_op_bulk_manage_t {  //** IBP_BULK_MANAGE operation
+    int        subcmd;        //** IBP_PROBE, IBP_CHNG, or IBP_DECR
+    char       rid[MAX_KEY_SIZE];
+    int        n;             //** Number of caps
+    ibp_cap_t **caps;         //** Manage caps.  All must be on the same depot RID
+    int        duration;      //** IBP_CHNG only
+    ibp_capstatus_t **probe;  //** IBP_PROBE only
+    int       *status;        //** Optional per cap IBP status
+};
+
 struct ibp_op_copy_t {  //** depot depot copy operations
     char      *path;       //** Phoebus path or NULL for default
     ibp_cap_t *srccap;
@@ -278,6 +309,9 @@ struct ibp_op_t { //** Individual IO operation
     int primary_cmd;//** Primary sync IBP command family
     int sub_cmd;    //** sub command, if applicable
     tbx_ns_chksum_t ncs;  //** chksum associated with the command
+    uint32_t v2_id;       //** Request ID when sent over the binary protocol
+    int v2_done;          //** Set once the reply was read while handling another op
+    gop_op_status_t v2_status;  //** Status of the reply if v2_done is set
     union {         //** Holds the individual commands options
         ibp_op_validate_chksum_t validate_op;
         ibp_op_get_chksum_t      get_chksum_op;
@@ -291,6 +325,8 @@ struct ibp_op_t { //** Individual IO operation
         ibp_op_modify_alloc_t mod_alloc_op;
         ibp_op_rid_inq_t   rid_op;
         ibp_op_version_t   ver_op;
+        ibp_op_bulk_alloc_t  bulk_alloc_op;
+        ibp_op_bulk_manage_t bulk_manage_op;
     } ops;
 };
 
@@ -33,6 +33,7 @@
 #include <tbx/stack.h>
 #include <tbx/string_token.h>
 #include <tbx/transfer_buffer.h>
+#include <tbx/type_malloc.h>
 #include <time.h>
 
 #include "op.h"
@@ -167,6 +168,8 @@ gop_op_status_t vec_read_command(gop_op_generic_t *gop, tbx_ns_t *ns)
     ibp_rw_buf_t *rwbuf;
     gop_op_status_t err;
 
+    if (tbx_ns_app_data_get(ns) != NULL) return(ibp_v2_send_command(gop, ns));  //** Binary protocol connection
+
     cmd = &(op->ops.rw_op);
 
     used = 0;
@@ -220,6 +223,8 @@ gop_op_status_t read_command(gop_op_generic_t *gop, tbx_ns_t *ns)
     gop_op_status_t err;
     ibp_op_rw_t *cmd;
 
+    if (tbx_ns_app_data_get(ns) != NULL) return(ibp_v2_send_command(gop, ns));  //** Binary protocol connection
+
     cmd = &(op->ops.rw_op);
 
     if (tbx_ns_chksum_is_valid(&(op->ncs)) == 0) {
@@ -292,6 +297,8 @@ gop_op_status_t read_recv(gop_op_generic_t *gop, tbx_ns_t *ns)
     double swait;
     ibp_rw_buf_t *rwbuf;
 
+    if (tbx_ns_app_data_get(ns) != NULL) return(ibp_v2_recv(gop, ns));  //** Binary protocol connection
+
     cmd = &(op->ops.rw_op);
 
     //** Need to read the depot status info
@@ -365,6 +372,8 @@ gop_op_status_t vec_write_command(gop_op_generic_t *gop, tbx_ns_t *ns)
     ibp_op_rw_t *cmd;
     ibp_rw_buf_t *rwbuf;
 
+    if (tbx_ns_app_data_get(ns) != NULL) return(ibp_v2_send_command(gop, ns));  //** Binary protocol connection
+
     cmd = &(op->ops.rw_op);
 
     used = 0;
@@ -422,6 +431,8 @@ gop_op_status_t write_command(gop_op_generic_t *gop, tbx_ns_t *ns)
     gop_op_status_t err;
     ibp_op_rw_t *cmd;
 
+    if (tbx_ns_app_data_get(ns) != NULL) return(ibp_v2_send_command(gop, ns));  //** Binary protocol connection
+
     cmd = &(op->ops.rw_op);
 
     if (tbx_ns_chksum_is_valid(&(op->ncs)) == 0) {
@@ -539,6 +550,8 @@ gop_op_status_t write_recv(gop_op_generic_t *gop, tbx_ns_t *ns)
     ibp_op_rw_t *cmd;
     char *bstate;
 
+    if (tbx_ns_app_data_get(ns) != NULL) return(ibp_v2_recv(gop, ns));  //** Binary protocol connection
+
     log_printf(15, "write_recv: Start!!! ns=%d\n", tbx_ns_getid(ns));
 
     cmd = &(op->ops.rw_op);
@@ -865,6 +878,96 @@ gop_op_status_t allocate_recv(gop_op_generic_t *gop, tbx_ns_t *ns)
     return(ibp_success_status);
 }
 
+gop_op_status_t bulk_allocate_command(gop_op_generic_t *gop, tbx_ns_t *ns)
+{
+    ibp_op_t *op = ibp_get_iop(gop);
+    char buffer[1024];
+    gop_op_status_t err;
+    ibp_op_bulk_alloc_t *cmd = &(op->ops.bulk_alloc_op);
+
+    if ((cmd->disk_chksum_type != CHKSUM_DEFAULT) && (cmd->disk_chksum_type != CHKSUM_NONE) && (tbx_chksum_type_valid(cmd->disk_chksum_type) == 0)) {
+        log_printf(10, "bulk_allocate_command: Invalid chksum type! type=%d ns=%d\n", cmd->disk_chksum_type, tbx_ns_getid(ns));
+        _op_set_status(err, OP_STATE_FAILURE, IBP_E_CHKSUM_TYPE);
+        return(err);
+    }
+
+    //** A CHKSUM_DEFAULT(-1) type tells the depot to use the resource default
+    snprintf(buffer, sizeof(buffer), "%d %d %d %d " I64T " %s %d %d %d " I64T " %d\n",
+             IBPv040, IBP_BULK_ALLOCATE, cmd->n, cmd->disk_chksum_type, cmd->disk_blocksize, cmd->depot->rid.name, cmd->attr->reliability, cmd->attr->type,
+             cmd->duration, cmd->size, (int)apr_time_sec(gop->op->cmd.timeout));
+
+    tbx_ns_chksum_write_clear(ns);
+
+    err = send_command(gop, ns, buffer);
+    if (err.op_status != OP_STATE_SUCCESS) {
+        log_printf(10, "bulk_allocate_command: Error with send_command()! ns=%d\n", tbx_ns_getid(ns));
+    }
+
+    return(err);
+}
+
+gop_op_status_t bulk_allocate_recv(gop_op_generic_t *gop, tbx_ns_t *ns)
+{
+    ibp_op_t *op = ibp_get_iop(gop);
+    int status, fin, i, n;
+    char buffer[3*1025];
+    char *rcap, *wcap, *mcap;
+    char *bstate;
+    gop_op_status_t err;
+    ibp_op_bulk_alloc_t *cmd = &(op->ops.bulk_alloc_op);
+
+    tbx_ns_chksum_read_clear(ns);
+
+    err = gop_readline_with_timeout(ns, buffer, sizeof(buffer), gop);
+    if (err.op_status != OP_STATE_SUCCESS) return(err);
+
+    log_printf(15, "bulk_allocate_recv: after readline ns=%d buffer=%s\n", tbx_ns_getid(ns), buffer);
+
+    status = atoi(tbx_stk_string_token(buffer, " ", &bstate, &fin));
+    if (status != IBP_OK) {
+        log_printf(1, "bulk_allocate_recv: ns=%d Error! status=%d\n", tbx_ns_getid(ns), status);
+        return(process_error(gop, &err, status, -1, &bstate));
+    }
+
+    n = atoi(tbx_stk_string_token(NULL, " ", &bstate, &fin));
+    if (n != cmd->n) {
+        log_printf(0, "bulk_allocate_recv: ns=%d Count mismatch! n=%d got=%d\n", tbx_ns_getid(ns), cmd->n, n);
+        _op_set_status(err, OP_STATE_FAILURE, IBP_E_GENERIC);
+        return(err);
+    }
+
+    //** Now get the caps.  One line per allocation
+    for (i=0; i<n; i++) {
+        err = gop_readline_with_timeout(ns, buffer, sizeof(buffer), gop);
+        if (err.op_status != OP_STATE_SUCCESS) break;
+
+        rcap = tbx_stk_string_token(buffer, " ", &bstate, &fin);
+        wcap = tbx_stk_string_token(NULL, " ", &bstate, &fin);
+        mcap = tbx_stk_string_token(NULL, " ", &bstate, &fin);
+        if ((strlen(rcap) == 0) || (strlen(wcap) == 0) || (strlen(mcap) == 0)) {
+            log_printf(0, "bulk_allocate_recv: ns=%d Error reading caps! i=%d buffer=%s\n", tbx_ns_getid(ns), i, buffer);
+            _op_set_status(err, OP_STATE_FAILURE, IBP_E_GENERIC);
+            break;
+        }
+
+        cmd->caps[i]->readCap = strdup(rcap);
+        cmd->caps[i]->writeCap = strdup(wcap);
+        cmd->caps[i]->manageCap = strdup(mcap);
+    }
+
+    if (i < n) {  //** Had an error so clean up what we got
+        for (n=0; n<i; n++) {
+            free(cmd->caps[n]->readCap);
+            free(cmd->caps[n]->writeCap);
+            free(cmd->caps[n]->manageCap);
+            cmd->caps[n]->readCap = cmd->caps[n]->writeCap = cmd->caps[n]->manageCap = NULL;
+        }
+        return(err);
+    }
+
+    return(ibp_success_status);
+}
+
 gop_op_status_t rename_command(gop_op_generic_t *gop, tbx_ns_t *ns)
 {
     ibp_op_t *op = ibp_get_iop(gop);
@@ -1125,6 +1228,121 @@ gop_op_status_t probe_recv(gop_op_generic_t *gop, tbx_ns_t *ns)
     return(err);
 }
 
+gop_op_status_t bulk_manage_command(gop_op_generic_t *gop, tbx_ns_t *ns)
+{
+    ibp_op_t *op = ibp_get_iop(gop);
+    char *buffer, *key, *end;
+    int i, nbytes, pos, plen, atime;
+    gop_op_status_t err;
+    ibp_op_bulk_manage_t *cmd = &(op->ops.bulk_manage_op);
+
+    //** The caps all share the ibp://host:port/RID# prefix.  Only the key after it is sent
+    key = strchr(cmd->caps[0], '#');
+    if (key == NULL) {
+        log_printf(0, "bulk_manage_command: Bad cap! cap=%s\n", cmd->caps[0]);
+        _op_set_status(err, OP_STATE_FAILURE, IBP_E_INVALID_MANAGE_CAP);
+        return(err);
+    }
+    plen = key - cmd->caps[0] + 1;
+
+    atime = 0;
+    if (cmd->subcmd == IBP_CHNG) {
+        atime = cmd->duration - time(NULL); //** This is in sec NOT APR time
+        if (atime < 0) atime = cmd->duration;
+    }
+
+    nbytes = 128 + cmd->n * (MAX_KEY_SIZE+1);
+    tbx_type_malloc(buffer, char, nbytes);
+    pos = snprintf(buffer, nbytes, "%d %d %s %d %d %d",
+                   IBPv040, IBP_BULK_MANAGE, cmd->rid, cmd->subcmd, cmd->n, atime);
+
+    for (i=0; i<cmd->n; i++) {
+        end = ((strncmp(cmd->caps[i], cmd->caps[0], plen) == 0)) ? strchr(cmd->caps[i] + plen, '/') : NULL;
+        if ((end == NULL) || ((end - cmd->caps[i] - plen) >= MAX_KEY_SIZE)) {
+            log_printf(0, "bulk_manage_command: Cap not on the same depot RID! i=%d cap=%s cap[0]=%s\n", i, cmd->caps[i], cmd->caps[0]);
+            free(buffer);
+            _op_set_status(err, OP_STATE_FAILURE, IBP_E_INVALID_PARAMETER);
+            return(err);
+        }
+        buffer[pos] = ' ';
+        pos++;
+        memcpy(buffer + pos, cmd->caps[i] + plen, end - cmd->caps[i] - plen);
+        pos += end - cmd->caps[i] - plen;
+    }
+    snprintf(buffer + pos, nbytes - pos, " %d\n", (int)apr_time_sec(gop->op->cmd.timeout));
+
+    tbx_ns_chksum_write_clear(ns);
+
+    err = send_command(gop, ns, buffer);
+    if (err.op_status != OP_STATE_SUCCESS) {
+        log_printf(10, "bulk_manage_command: Error with send_command()! ns=%d\n", tbx_ns_getid(ns));
+    }
+
+    free(buffer);
+    return(err);
+}
+
+gop_op_status_t bulk_manage_recv(gop_op_generic_t *gop, tbx_ns_t *ns)
+{
+    ibp_op_t *op = ibp_get_iop(gop);
+    int status, fin, i, n, bad;
+    char buffer[1025];
+    gop_op_status_t err;
+    char *bstate;
+    ibp_capstatus_t *p;
+    ibp_op_bulk_manage_t *cmd = &(op->ops.bulk_manage_op);
+
+    tbx_ns_chksum_read_clear(ns);
+
+    err = gop_readline_with_timeout(ns, buffer, sizeof(buffer), gop);
+    if (err.op_status != OP_STATE_SUCCESS) return(err);
+
+    log_printf(15, "bulk_manage_recv: after readline ns=%d buffer=%s\n", tbx_ns_getid(ns), buffer);
+
+    status = atoi(tbx_stk_string_token(buffer, " ", &bstate, &fin));
+    if (status != IBP_OK) return(process_error(gop, &err, status, -1, &bstate));
+
+    n = atoi(tbx_stk_string_token(NULL, " ", &bstate, &fin));
+    if (n != cmd->n) {
+        log_printf(0, "bulk_manage_recv: ns=%d Count mismatch! n=%d got=%d\n", tbx_ns_getid(ns), cmd->n, n);
+        _op_set_status(err, OP_STATE_FAILURE, IBP_E_GENERIC);
+        return(err);
+    }
+
+    //** Each cap gets it's own status line
+    bad = IBP_OK;
+    for (i=0; i<n; i++) {
+        err = gop_readline_with_timeout(ns, buffer, sizeof(buffer), gop);
+        if (err.op_status != OP_STATE_SUCCESS) return(err);
+
+        status = atoi(tbx_stk_string_token(buffer, " ", &bstate, &fin));
+        if (cmd->status != NULL) cmd->status[i] = status;
+        if (status != IBP_OK) {
+            if (bad == IBP_OK) bad = status;
+            continue;
+        }
+
+        if (cmd->subcmd == IBP_PROBE) {
+            p = cmd->probe[i];
+            p->readRefCount = atoi(tbx_stk_string_token(NULL, " ", &bstate, &fin));
+            p->writeRefCount = atoi(tbx_stk_string_token(NULL, " ", &bstate, &fin));
+            sscanf(tbx_stk_string_token(NULL, " ", &bstate, &fin), I64T, &(p->currentSize));
+            sscanf(tbx_stk_string_token(NULL, " ", &bstate, &fin), I64T, &(p->maxSize));
+            p->attrib.duration = atol(tbx_stk_string_token(NULL, " ", &bstate, &fin)) + time(NULL); //** This is in sec NOT APR time
+            p->attrib.reliability = atoi(tbx_stk_string_token(NULL, " ", &bstate, &fin));
+            p->attrib.type = atoi(tbx_stk_string_token(NULL, " ", &bstate, &fin));
+        }
+    }
+
+    if (bad != IBP_OK) {
+        log_printf(5, "bulk_manage_recv: ns=%d subcmd=%d n=%d first error=%d\n", tbx_ns_getid(ns), cmd->subcmd, n, bad);
+        _op_set_status(err, OP_STATE_FAILURE, bad);
+        return(err);
+    }
+
+    return(ibp_success_status);
+}
+
 gop_op_status_t proxy_probe_command(gop_op_generic_t *gop, tbx_ns_t *ns)
 {
     ibp_op_t *op = ibp_get_iop(gop);
@@ -0,0 +1,342 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************
+// proto_v2 - Client side of the binary framed IBP protocol.  The
+//    connection is switched over right after connecting if the depot
+//    supports it.  Requests carry an ID and the depot can reply out of
+//    order so the recv side demultiplexes the replies.  Replies for ops
+//    further back in the queue are read straight into their buffers
+//    and their status is parked on the op until its recv_phase runs.
+//
+//    See ibp-server/proto_v2.c for the frame layout.
+//*************************************************************
+
+#define _log_module_index 133
+
+#include <apr_hash.h>
+#include <apr_pools.h>
+#include <apr_thread_mutex.h>
+#include <apr_time.h>
+#include <gop/gop.h>
+#include <gop/types.h>
+#include <ibp/protocol.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/fmttypes.h>
+#include <tbx/log.h>
+#include <tbx/network.h>
+#include <tbx/transfer_buffer.h>
+#include <tbx/type_malloc.h>
+
+#include "op.h"
+#include "types.h"
+
+gop_op_status_t gop_write_block(tbx_ns_t *ns, gop_op_generic_t *gop, tbx_tbuf_t *buffer, ibp_off_t pos, ibp_off_t size);
+gop_op_status_t gop_read_block(tbx_ns_t *ns, gop_op_generic_t *gop, tbx_tbuf_t *buffer, ibp_off_t pos, ibp_off_t size);
+gop_op_status_t process_error(gop_op_generic_t *gop, gop_op_status_t *err, int status, double wait_time, char **bstate);
+
+typedef struct {
+    apr_thread_mutex_t *lock;
+    apr_pool_t *mpool;
+    apr_hash_t *pending;   //** Ops sent and waiting on a reply keyed by request ID
+    uint32_t next_id;
+} ibp_v2_conn_t;
+
+//*************************************************************
+// Little endian helpers
+//*************************************************************
+
+static void v2_put16(unsigned char *b, uint16_t n) { b[0] = n; b[1] = n>>8; }
+static void v2_put32(unsigned char *b, uint32_t n) { b[0] = n; b[1] = n>>8; b[2] = n>>16; b[3] = n>>24; }
+static void v2_put64(unsigned char *b, uint64_t n) { v2_put32(b, n); v2_put32(b+4, n>>32); }
+static uint32_t v2_get32(const unsigned char *b) { return(b[0] | (b[1]<<8) | (b[2]<<16) | ((uint32_t)b[3]<<24)); }
+static uint64_t v2_get64(const unsigned char *b) { return(v2_get32(b) | ((uint64_t)v2_get32(b+4) << 32)); }
+
+//*************************************************************
+// v2_conn_free - Destroys the connection state.  Called when the
+//    connection is closed.
+//*************************************************************
+
+void v2_conn_free(void *data)
+{
+    ibp_v2_conn_t *conn = (ibp_v2_conn_t *)data;
+
+    apr_thread_mutex_destroy(conn->lock);
+    apr_pool_destroy(conn->mpool);
+    free(conn);
+}
+
+//*************************************************************
+// v2_conn_new - Creates the connection state
+//*************************************************************
+
+ibp_v2_conn_t *v2_conn_new()
+{
+    ibp_v2_conn_t *conn;
+
+    tbx_type_malloc_clear(conn, ibp_v2_conn_t, 1);
+    apr_pool_create(&(conn->mpool), NULL);
+    apr_thread_mutex_create(&(conn->lock), APR_THREAD_MUTEX_DEFAULT, conn->mpool);
+    conn->pending = apr_hash_make(conn->mpool);
+
+    return(conn);
+}
+
+//*************************************************************
+// v2_readline - Reads the negotiation reply
+//*************************************************************
+
+int v2_readline(tbx_ns_t *ns, char *buffer, int size, apr_time_t end_time)
+{
+    tbx_tbuf_t tbuf;
+    tbx_ns_timeout_t dt;
+    int n, pos, err;
+
+    tbx_tbuf_single(&tbuf, size, buffer);
+    tbx_ns_timeout_set(&dt, 1, 0);
+    pos = 0;
+    err = 0;
+    while ((err == 0) && (pos < size) && (apr_time_now() < end_time)) {
+        n = tbx_ns_readline_raw(ns, &tbuf, pos, size-pos, dt, &err);
+        pos += n;
+    }
+
+    return((err > 0) ? 0 : 1);
+}
+
+//*************************************************************
+// ibp_v2_negotiate - Asks the depot to switch the freshly made
+//    connection over to the binary protocol.  Depots that answer with
+//    an error don't know the command and are remembered so future
+//    connections skip the negotiation.
+//
+//    Returns 0 if the connection is usable, 1 if it failed, and 2 if
+//    the depot rejected the command and a new text connection is needed.
+//*************************************************************
+
+int ibp_v2_negotiate(tbx_ns_t *ns, ibp_connect_context_t *cc, char *host, int port, tbx_ns_timeout_t timeout)
+{
+    ibp_context_t *ic = (ibp_context_t *)cc->data;
+    char key[MAX_HOST_SIZE], buffer[256];
+    tbx_tbuf_t tbuf;
+    apr_time_t end_time;
+    int n, status, version;
+
+    snprintf(key, sizeof(key), "%s:%d", host, port);
+
+    apr_thread_mutex_lock(ic->lock);
+    n = (apr_hash_get(ic->v1_depots, key, APR_HASH_KEY_STRING) == NULL) ? 0 : 1;
+    apr_thread_mutex_unlock(ic->lock);
+    if (n == 1) return(0);  //** Known text only depot
+
+    end_time = apr_time_now() + ((timeout > apr_time_from_sec(5)) ? timeout : apr_time_from_sec(5));
+    snprintf(buffer, sizeof(buffer), "%d %d %d %d\n", IBPv040, IBP_PROTOCOL, cc->proto, (int)apr_time_sec(end_time - apr_time_now()));
+    n = strlen(buffer);
+    tbx_tbuf_single(&tbuf, n, buffer);
+    if (tbx_ns_write_block(ns, end_time, &tbuf, 0, n) != NS_OK) return(1);
+
+    if (v2_readline(ns, buffer, sizeof(buffer), end_time) != 0) {
+        log_printf(5, "ns=%d depot=%s No reply to protocol negotiation\n", tbx_ns_getid(ns), key);
+        return(1);
+    }
+
+    status = IBP_E_GENERIC;
+    version = IBP_PROTO_V1;
+    sscanf(buffer, "%d %d", &status, &version);
+    log_printf(5, "ns=%d depot=%s status=%d version=%d\n", tbx_ns_getid(ns), key, status, version);
+
+    if ((status != IBP_OK) || (version < IBP_PROTO_V2)) {  //** Old depot or binary protocol disabled
+        apr_thread_mutex_lock(ic->lock);
+        apr_hash_set(ic->v1_depots, apr_pstrdup(ic->mpool, key), APR_HASH_KEY_STRING, ic);
+        apr_thread_mutex_unlock(ic->lock);
+
+        return((status == IBP_OK) ? 0 : 2);  //** An error reply means the depot closed the connection
+    }
+
+    tbx_ns_app_data_set(ns, v2_conn_new(), v2_conn_free);
+    return(0);
+}
+
+//*************************************************************
+// ibp_v2_send_command - Sends the request frame for a R/W op.  Any
+//    write data is sent by the normal send_phase.
+//*************************************************************
+
+gop_op_status_t ibp_v2_send_command(gop_op_generic_t *gop, tbx_ns_t *ns)
+{
+    ibp_op_t *op = ibp_get_iop(gop);
+    ibp_v2_conn_t *conn = (ibp_v2_conn_t *)tbx_ns_app_data_get(ns);
+    ibp_op_rw_t *cmd = &(op->ops.rw_op);
+    ibp_rw_buf_t *rwbuf;
+    unsigned char stackbuffer[4096];
+    unsigned char *buffer = stackbuffer;
+    unsigned char *iov;
+    tbx_tbuf_t tbuf;
+    gop_op_status_t err;
+    int i, j, key_len, len;
+
+    key_len = strlen(cmd->key);
+    len = IBP_V2_REQ_HEADER + key_len + 16*cmd->n_tbx_iovec_total;
+    if (len > (int)sizeof(stackbuffer)) tbx_type_malloc(buffer, unsigned char, len);
+
+    //** Register the op before sending so the reply can always be matched
+    apr_thread_mutex_lock(conn->lock);
+    op->v2_id = conn->next_id++;
+    op->v2_done = 0;
+    apr_hash_set(conn->pending, &(op->v2_id), sizeof(uint32_t), op);
+    apr_thread_mutex_unlock(conn->lock);
+
+    v2_put32(buffer, op->v2_id);
+    v2_put16(buffer+4, (cmd->rw_mode == IBP_WRITE) ? IBP_WRITE : IBP_LOAD);
+    v2_put16(buffer+6, key_len);
+    v2_put32(buffer+8, cmd->n_tbx_iovec_total);
+    v2_put32(buffer+12, apr_time_sec(gop->op->cmd.timeout));
+    v2_put64(buffer+16, cmd->size);
+    memcpy(buffer + IBP_V2_REQ_HEADER, cmd->key, key_len);
+
+    iov = buffer + IBP_V2_REQ_HEADER + key_len;
+    for (j=0; j<cmd->n_ops; j++) {
+        rwbuf = cmd->rwbuf[j];
+        for (i=0; i<rwbuf->n_iovec; i++) {
+            v2_put64(iov, rwbuf->iovec[i].offset);
+            v2_put64(iov+8, rwbuf->iovec[i].len);
+            iov += 16;
+        }
+    }
+
+    log_printf(5, "ns=%d gid=%d id=%u rw_mode=%d n_iovec=%d size=" I64T "\n", tbx_ns_getid(ns), gop_id(gop), op->v2_id, cmd->rw_mode, cmd->n_tbx_iovec_total, cmd->size);
+
+    tbx_tbuf_single(&tbuf, len, (char *)buffer);
+    err = gop_write_block(ns, gop, &tbuf, 0, len);
+    if (err.op_status != OP_STATE_SUCCESS) {
+        log_printf(10, "Error sending frame! ns=%d gid=%d\n", tbx_ns_getid(ns), gop_id(gop));
+        apr_thread_mutex_lock(conn->lock);
+        apr_hash_set(conn->pending, &(op->v2_id), sizeof(uint32_t), NULL);
+        apr_thread_mutex_unlock(conn->lock);
+        err = ibp_retry_status;
+    }
+
+    if (buffer != stackbuffer) free(buffer);
+
+    return(err);
+}
+
+//*************************************************************
+// v2_reply - Handles the body of a reply for the target op.  The read
+//    is timed against gop which is the op on top of the connection.
+//    On a connection error *dead is set.
+//*************************************************************
+
+gop_op_status_t v2_reply(gop_op_generic_t *gop, tbx_ns_t *ns, ibp_op_t *target, int status, ibp_off_t nbytes, int *dead)
+{
+    ibp_op_rw_t *cmd = &(target->ops.rw_op);
+    ibp_rw_buf_t *rwbuf;
+    gop_op_status_t err;
+    int i;
+
+    *dead = 0;
+    if (status != IBP_OK) {
+        if ((cmd->rw_mode != IBP_WRITE) && (nbytes != 0)) {  //** Can't resync if the depot sent read data with an error
+            *dead = 1;
+            return(ibp_retry_status);
+        }
+        return(process_error(ibp_get_gop(target), &err, status, -1, NULL));
+    }
+
+    if (nbytes != cmd->size) {
+        log_printf(1, "ns=%d id=%u size mismatch! got=" I64T " expected=" I64T "\n", tbx_ns_getid(ns), target->v2_id, nbytes, cmd->size);
+        if (cmd->rw_mode != IBP_WRITE) *dead = 1;  //** Read data is in the pipe that doesn't match our buffers
+        err.op_status = OP_STATE_FAILURE;
+        err.error_code = IBP_E_GENERIC;
+        return((*dead) ? ibp_retry_status : err);
+    }
+
+    if (cmd->rw_mode == IBP_WRITE) return(ibp_success_status);
+
+    for (i=0; i<cmd->n_ops; i++) {
+        rwbuf = cmd->rwbuf[i];
+        err = gop_read_block(ns, gop, rwbuf->buffer, rwbuf->boff, rwbuf->size);
+        if (err.op_status != OP_STATE_SUCCESS) {
+            log_printf(1, "ns=%d id=%u Error reading data! i=%d size=" I64T "\n", tbx_ns_getid(ns), target->v2_id, i, rwbuf->size);
+            *dead = 1;
+            return(err);
+        }
+    }
+
+    return(ibp_success_status);
+}
+
+//*************************************************************
+// ibp_v2_recv - recv_phase for R/W ops on a binary connection.  Replies
+//    are processed as they arrive until the one for this op shows up.
+//*************************************************************
+
+gop_op_status_t ibp_v2_recv(gop_op_generic_t *gop, tbx_ns_t *ns)
+{
+    ibp_op_t *op = ibp_get_iop(gop);
+    ibp_v2_conn_t *conn = (ibp_v2_conn_t *)tbx_ns_app_data_get(ns);
+    unsigned char hdr[IBP_V2_RESP_HEADER];
+    ibp_op_t *target;
+    tbx_tbuf_t tbuf;
+    gop_op_status_t err;
+    uint32_t id;
+    ibp_off_t nbytes;
+    int status, dead;
+
+    tbx_tbuf_single(&tbuf, IBP_V2_RESP_HEADER, (char *)hdr);
+
+    for (;;) {
+        apr_thread_mutex_lock(conn->lock);
+        if (op->v2_done == 1) {  //** Already handled while waiting on another op
+            apr_thread_mutex_unlock(conn->lock);
+            return(op->v2_status);
+        }
+        apr_thread_mutex_unlock(conn->lock);
+
+        err = gop_read_block(ns, gop, &tbuf, 0, IBP_V2_RESP_HEADER);
+        if (err.op_status != OP_STATE_SUCCESS) return(err);
+
+        id = v2_get32(hdr);
+        status = (int32_t)v2_get32(hdr+4);
+        nbytes = v2_get64(hdr+8);
+
+        apr_thread_mutex_lock(conn->lock);
+        target = apr_hash_get(conn->pending, &id, sizeof(uint32_t));
+        if (target != NULL) apr_hash_set(conn->pending, &id, sizeof(uint32_t), NULL);
+        apr_thread_mutex_unlock(conn->lock);
+
+        log_printf(5, "ns=%d gid=%d my_id=%u id=%u status=%d nbytes=" I64T "\n", tbx_ns_getid(ns), gop_id(gop), op->v2_id, id, status, nbytes);
+
+        if (target == NULL) {  //** Out of sync so drop the connection and retry
+            log_printf(0, "ns=%d Reply for unknown id=%u!\n", tbx_ns_getid(ns), id);
+            return(ibp_retry_status);
+        }
+
+        err = v2_reply(gop, ns, target, status, nbytes, &dead);
+        if (target == op) return(err);
+        if (dead == 1) return(ibp_retry_status);  //** Everything on the connection gets retried
+
+        apr_thread_mutex_lock(conn->lock);
+        target->v2_status = err;
+        target->v2_done = 1;
+        apr_thread_mutex_unlock(conn->lock);
+    }
+
+    return(ibp_retry_status);
+}
@@ -57,6 +57,7 @@ typedef struct {
 typedef struct {
    char *cap;
    ex_off_t nbytes;
+   warm_hash_entry_t *wrid;
 } warm_cap_info_t;
 
 typedef struct {
@@ -127,6 +128,28 @@ void parse_tag_file(char *fname)
     }
 }
 
+//*************************************************************************
+//  warm_cap_done - Updates the RID stats for a warmed cap and returns 1 if it failed
+//*************************************************************************
+
+int warm_cap_done(warm_t *w, int i, int op_status, ex_off_t dtime)
+{
+    warm_hash_entry_t *wrid = w->cap[i].wrid;
+    int nfailed = 0;
+
+    wrid->dtime += dtime;
+    if (op_status == OP_STATE_SUCCESS) {
+        wrid->good++;
+    } else {
+        nfailed = 1;
+        wrid->bad++;
+        info_printf(lio_ifd, 1, "ERROR: %s  cap=%s\n", w->tuple.path, w->cap[i].cap);
+    }
+    warm_put_rid(db_rid, wrid->rid_key, w->inode, w->cap[i].nbytes, 0);
+
+    return(nfailed);
+}
+
 //*************************************************************************
 //  gen_warm_task
 //*************************************************************************
@@ -139,6 +162,9 @@ gop_op_status_t gen_warm_task(void *arg, int id)
     tbx_inip_file_t *fd;
     int i, nfailed, state;
     warm_hash_entry_t *wrid = NULL;
+    lio_data_service_fn_t *ds = w->tuple.lc->ds;
+    char **mcap;
+    int *cap_status;
     char *etext;
     gop_opque_t *q;
 
@@ -174,13 +200,15 @@ gop_op_status_t gen_warm_task(void *arg, int id)
             //** Get the manage cap
             etext = tbx_inip_get_string(fd, tbx_inip_group_get(g), "manage_cap", "");
             w->cap[w->n].cap = tbx_stk_unescape_text('\\', etext);
+            w->cap[w->n].wrid = wrid;
             free(etext);
 
-            //** Add the task
-            gop = ibp_modify_alloc_gop(w->ic, w->cap[w->n].cap, -1, dt, -1, lio_gc->timeout);
-            gop_set_myid(gop, w->n);
-            gop_set_private(gop, wrid);
-            gop_opque_add(q, gop);
+            //** Add the task unless we can do them all at once below
+            if (ds->bulk_warm == NULL) {
+                gop = ibp_modify_alloc_gop(w->ic, w->cap[w->n].cap, -1, dt, -1, lio_gc->timeout);
+                gop_set_myid(gop, w->n);
+                gop_opque_add(q, gop);
+            }
             w->n++;
 
             //** Check if it was tagged
@@ -196,21 +224,26 @@ gop_op_status_t gen_warm_task(void *arg, int id)
     tbx_inip_destroy(fd);
 
     nfailed = 0;
+    if ((ds->bulk_warm != NULL) && (w->n > 0)) {  //** Warm them a depot at a time
+        tbx_type_malloc(mcap, char *, w->n);
+        tbx_type_malloc(cap_status, int, w->n);
+        for (i=0; i<w->n; i++) mcap[i] = w->cap[i].cap;
+
+        gop = ds->bulk_warm(ds, NULL, (data_cap_t **)mcap, dt, cap_status, w->n, lio_gc->timeout);
+        gop_waitall(gop);
+        for (i=0; i<w->n; i++) {
+            nfailed += warm_cap_done(w, i, cap_status[i], gop_time_exec(gop) / w->n);
+        }
+        gop_free(gop, OP_DESTROY);
+
+        free(cap_status);
+        free(mcap);
+    }
+
     while ((gop = opque_waitany(q)) != NULL) {
         status = gop_get_status(gop);
-        wrid = gop_get_private(gop);
         i = gop_get_myid(gop);
-
-        wrid->dtime += gop_time_exec(gop);
-        if (status.op_status == OP_STATE_SUCCESS) {
-            wrid->good++;
-         } else {
-            nfailed++;
-            wrid->bad++;
-            info_printf(lio_ifd, 1, "ERROR: %s  cap=%s\n", w->tuple.path, w->cap[i].cap);
-        }
-        warm_put_rid(db_rid, wrid->rid_key, w->inode, w->cap[i].nbytes, 0);
-
+        nfailed += warm_cap_done(w, i, status.op_status, gop_time_exec(gop));
         gop_free(gop, OP_DESTROY);
     }
 
@@ -0,0 +1,242 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************************
+// os_attr_pack - Converts an os_file namespace between the attribute per
+//    file layout and packed attribute records.  This works directly on the
+//    files so the object server should be stopped while it runs.
+//*************************************************************************
+
+#include <apr_general.h>
+#include <apr_hash.h>
+#include <apr_pools.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <tbx/assert_result.h>
+#include <tbx/string_token.h>
+#include <unistd.h>
+
+#include "os/file.h"
+
+static char *file_path = NULL;
+static apr_pool_t *mpool = NULL;
+static apr_hash_t *pinned = NULL;
+static int max_size = 1024;
+static int unpack = 0;
+static int do_sync = 0;
+static int n_dirs = 0;
+static int n_attrs = 0;
+static int n_failed = 0;
+
+//*************************************************************************
+// is_attr_dir - Returns 1 if the path is an object's attribute directory.
+//    These are either <dir>/PREFIX for a directory or
+//    <dir>/PREFIX/PREFIX<name> for a file.
+//*************************************************************************
+
+int is_attr_dir(const char *fpath, int base)
+{
+    int n;
+
+    if (strcmp(fpath + base, FILE_ATTR_PREFIX) == 0) return(1);
+    if (strncmp(fpath + base, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX_LEN) != 0) return(0);
+
+    //** Make sure the parent is PREFIX as well
+    n = base - 1 - FILE_ATTR_PREFIX_LEN;
+    if (n < 1) return(0);
+    return(((fpath[n-1] == '/') && (strncmp(fpath + n, FILE_ATTR_PREFIX "/", FILE_ATTR_PREFIX_LEN+1) == 0)) ? 1 : 0);
+}
+
+//*************************************************************************
+// pin_target - Adds the target of the attribute symlink to the pinned table.
+//    The link is resolved the same way the os_file service does it.
+//*************************************************************************
+
+void pin_target(const char *attr_dir, const char *link)
+{
+    char target[PATH_MAX], fname[PATH_MAX], real[PATH_MAX];
+    char *dir, *key, *tdir, *tbase, *owner, *fa, *tmp;
+    struct stat s;
+    int n;
+
+    n = readlink(link, target, sizeof(target)-1);
+    if (n <= 0) return;
+    target[n] = 0;
+
+    lio_os_path_split(target, &dir, &key);
+
+    //** Relative links are relative to the dir holding the PREFIX directory
+    lio_os_path_split(attr_dir, &owner, &fa);
+    if (strcmp(fa, FILE_ATTR_PREFIX) != 0) {  //** File attr dir so peel off another level
+        tmp = owner;
+        free(fa);
+        lio_os_path_split(tmp, &owner, &fa);
+        free(tmp);
+    }
+    free(fa);
+
+    if (dir[0] == '/') {
+        snprintf(fname, sizeof(fname), "%s%s", file_path, dir);
+    } else {
+        snprintf(fname, sizeof(fname), "%s/%s", owner, dir);
+    }
+
+    if (stat(fname, &s) != 0) goto finished;
+
+    if (S_ISDIR(s.st_mode)) {
+        snprintf(target, sizeof(target), "%s/%s", fname, FILE_ATTR_PREFIX);
+    } else {
+        lio_os_path_split(fname, &tdir, &tbase);
+        snprintf(target, sizeof(target), "%s/%s/%s%s", tdir, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX, tbase);
+        free(tdir);
+        free(tbase);
+    }
+
+    if (realpath(target, real) == NULL) goto finished;
+    snprintf(fname, sizeof(fname), "%s/%s", real, key);
+    apr_hash_set(pinned, apr_pstrdup(mpool, fname), APR_HASH_KEY_STRING, (void *)1);
+
+finished:
+    free(owner);
+    free(dir);
+    free(key);
+}
+
+//*************************************************************************
+// pin_walk - Records all the attribute symlink targets
+//*************************************************************************
+
+int pin_walk(const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+    char *dir, *base, *p;
+
+    if (typeflag != FTW_SL) return(0);
+
+    lio_os_path_split(fpath, &dir, &base);
+    p = strrchr(dir, '/');
+    if ((p != NULL) && (is_attr_dir(dir, p - dir + 1) == 1)) pin_target(dir, fpath);
+    free(dir);
+    free(base);
+
+    return(0);
+}
+
+//*************************************************************************
+// pack_walk - Packs or unpacks each attribute directory
+//*************************************************************************
+
+int pack_walk(const char *fpath, const struct stat *sb, int typeflag, struct FTW *ftwbuf)
+{
+    char real[PATH_MAX];
+    int n;
+
+    if (typeflag != FTW_D) return(0);
+    if (is_attr_dir(fpath, ftwbuf->base) == 0) return(0);
+    if (realpath(fpath, real) == NULL) return(0);
+
+    n = osf_packed_dir(real, max_size, unpack, do_sync, pinned);
+    if (n < 0) {
+        fprintf(stderr, "ERROR: Failed converting %s\n", real);
+        n_failed++;
+    } else {
+        n_dirs++;
+        n_attrs += n;
+    }
+
+    return(0);
+}
+
+//*************************************************************************
+//*************************************************************************
+
+int main(int argc, char **argv)
+{
+    int i, start_option;
+    char *base_path;
+    char path[PATH_MAX];
+
+    if (argc < 2) {
+        printf("\n");
+        printf("os_attr_pack [-unpack] [-max_size size] [-sync] base_path\n");
+        printf("    -unpack        - Convert packed records back to one file per attribute\n");
+        printf("    -max_size size - Largest attribute to pack (units accepted). Default is %d\n", max_size);
+        printf("    -sync          - Fsync each record before removing the old files\n");
+        printf("    base_path      - os_file base_path. Both the file and hardlink trees are converted.\n");
+        printf("\n");
+        printf("NOTE: The object server using base_path should be stopped while this runs.\n");
+        printf("\n");
+        return(1);
+    }
+
+    //*** Parse the args
+    i=1;
+    do {
+        start_option = i;
+
+        if (strcmp(argv[i], "-unpack") == 0) {
+            i++;
+            unpack = 1;
+        } else if (strcmp(argv[i], "-max_size") == 0) {
+            i++;
+            max_size = tbx_stk_string_get_integer(argv[i]);
+            i++;
+        } else if (strcmp(argv[i], "-sync") == 0) {
+            i++;
+            do_sync = 1;
+        }
+    } while ((start_option < i) && (i<argc));
+
+    if (i >= argc) {
+        printf("Missing base_path!\n");
+        return(1);
+    }
+    base_path = argv[i];
+
+    apr_initialize();
+    assert_result(apr_pool_create(&mpool, NULL), APR_SUCCESS);
+    pinned = apr_hash_make(mpool);
+
+    snprintf(path, sizeof(path), "%s/file", base_path);
+    file_path = realpath(path, NULL);
+    if (file_path == NULL) {
+        printf("Can't find the namespace! path=%s\n", path);
+        return(1);
+    }
+
+    //** Attributes that are symlink targets have to stay as files
+    if (unpack == 0) {
+        nftw(file_path, pin_walk, 64, FTW_PHYS);
+        snprintf(path, sizeof(path), "%s/hardlink", base_path);
+        nftw(path, pin_walk, 64, FTW_PHYS);
+    }
+
+    nftw(file_path, pack_walk, 64, FTW_PHYS);
+    snprintf(path, sizeof(path), "%s/hardlink", base_path);
+    nftw(path, pack_walk, 64, FTW_PHYS);
+
+    printf("%s %d attributes in %d objects.  Pinned: %d  Failed: %d\n", ((unpack == 1) ? "Unpacked" : "Packed"),
+           n_attrs, n_dirs, (int)apr_hash_count(pinned), n_failed);
+
+    free(file_path);
+    apr_pool_destroy(mpool);
+    apr_terminate();
+
+    return((n_failed == 0) ? 0 : 1);
+}
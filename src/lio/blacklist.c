@@ -142,6 +142,13 @@ lio_blacklist_t *blacklist_load(tbx_inip_file_t *ifd, char *section)
     bl->timeout = tbx_inip_get_integer(ifd, section, "timeout", apr_time_from_sec(120));
     bl->min_bandwidth = tbx_inip_get_integer(ifd, section, "min_bandwidth", 5*1024*1024);  //** default ro 5MB
     bl->min_io_time = tbx_inip_get_integer(ifd, section, "min_io_time", apr_time_from_sec(1));  //** default ro 5MB
+    bl->slow_ratio = tbx_inip_get_double(ifd, section, "slow_ratio", 0);  //** default is disabled
+    bl->hedge_percentile = tbx_inip_get_double(ifd, section, "hedge_percentile", 0);  //** default is disabled
+    bl->hedge_min_time = tbx_inip_get_integer(ifd, section, "hedge_min_time", apr_time_from_msec(20));
+    bl->hedge_defer = tbx_inip_get_integer(ifd, section, "hedge_defer", 0);
+    bl->hedge_budget = tbx_inip_get_double(ifd, section, "hedge_budget", 0.05);
+    bl->hedge_burst = tbx_inip_get_double(ifd, section, "hedge_burst", 10);
+    bl->hedge_credit = bl->hedge_burst;
 
     return(bl);
 }
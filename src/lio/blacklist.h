@@ -47,6 +47,13 @@ struct lio_blacklist_t {
     ex_off_t  min_bandwidth;
     apr_time_t min_io_time;
     apr_time_t timeout;
+    double slow_ratio;           //** Skip reads from depots estimated to be this much slower than the median.  0 disables
+    double hedge_percentile;     //** Latency quantile, ie 0.95, a read can run before the held back devices are tried.  0 disables
+    apr_time_t hedge_min_time;   //** Never hedge sooner than this
+    int hedge_defer;             //** Devices per row held back and only read if the row runs long
+    double hedge_budget;         //** Fraction of rows allowed to issue hedge reads
+    double hedge_burst;          //** Max hedge credit that can accumulate
+    double hedge_credit;         //** Current hedge credit.  Protected by lock
 };
 
 void blacklist_remove_rs_added(lio_blacklist_t *bl);
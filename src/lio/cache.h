@@ -22,6 +22,7 @@
 #include <tbx/list.h>
 #include <tbx/pigeon_coop.h>
 
+#include "cache/page_arena.h"
 #include "ex3.h"
 
 #ifdef __cplusplus
@@ -73,6 +74,7 @@ struct lio_cache_stats_get_t {
     ex_off_t hit_bytes;
     ex_off_t miss_bytes;
     ex_off_t unused_bytes;
+    ex_off_t ghost_hit_bytes;
     apr_time_t hit_time;
     apr_time_t miss_time;
 };
@@ -171,7 +173,7 @@ struct lio_cache_fn_t {
     void (*cache_miss_tag)(lio_cache_t *c, lio_segment_t *seg, int rw_mode, ex_off_t lo, ex_off_t hi, ex_off_t missing_offset, void **miss);
     int (*s_page_access)(lio_cache_t *c, lio_cache_page_t *p, int rw_mode, ex_off_t request_len);
     int (*s_pages_release)(lio_cache_t *c, lio_cache_page_t **p, int n_pages);
-    lio_cache_t *(*get_handle)(lio_cache_t *);
+    lio_cache_t *(*get_handle)(lio_cache_t *c, lio_segment_t *seg);
     int (*destroy)(lio_cache_t *c);
 };
 
@@ -182,6 +184,7 @@ struct lio_cache_t {
     tbx_list_t *segments;
     tbx_pc_t *cond_coop;
     data_attr_t *da;
+    lio_page_arena_t *arena;    //** Optional preallocated page data arena.  NULL means use malloc
     char *type;
     ex_off_t default_page_size;
     lio_cache_stats_get_t stats;
@@ -202,11 +205,11 @@ extern tbx_atomic_int_t _cache_count;
 #define unique_cache_id() tbx_atomic_inc(_cache_count);
 #define cache_lock(c) apr_thread_mutex_lock((c)->lock)
 #define cache_unlock(c) apr_thread_mutex_unlock((c)->lock)
-#define cache_get_handle(c) (c)->fn.get_handle(c)
+#define cache_get_handle(c, seg) (c)->fn.get_handle(c, seg)
 #define cache_destroy(c) (c)->fn.destroy(c)
 #define cache_print_running_config(c, fd, psh) (c)->fn.print_running_config(c, fd, psh)
 
-lio_cache_t *cache_base_handle(lio_cache_t *);
+lio_cache_t *cache_base_handle(lio_cache_t *c, lio_segment_t *seg);
 void cache_base_destroy(lio_cache_t *c);
 void cache_base_create(lio_cache_t *c, data_attr_t *da, int timeout);
 void *cache_cond_new(void *arg, int size);
@@ -29,6 +29,7 @@
 #include <gop/types.h>
 #include <sys/mman.h>
 #include <stdlib.h>
+#include <string.h>
 #include <tbx/apr_wrapper.h>
 #include <tbx/atomic_counter.h>
 #include <tbx/iniparse.h>
@@ -68,6 +69,8 @@ static lio_cache_amp_t amp_default_options = {
     .dirty_fraction = 0.1,
     .async_prefetch_threshold = 256*1024,
     .min_prefetch_size = 1024*1024,
+    .a1in_fraction = 0.25,
+    .ghost_fraction = 0.5,
     .dirty_max_wait = apr_time_from_sec(30)
 };
 
@@ -99,12 +102,17 @@ void amp_cache_info_fn(void *arg, FILE *fd)
 
     fprintf(fd, "Cache Usage------------------------\n");
     cache_lock(c);
-    n = tbx_stack_count(cp->stack);
+    n = tbx_stack_count(cp->stack) + tbx_stack_count(cp->a1in);
     d = cp->bytes_used;
     if (n>0) d /= n;
     fprintf(fd, "n_pages: %d\n", n);
+    if (cp->policy == AMP_POLICY_2Q) {
+        fprintf(fd, "2Q Am pages: %d  A1in pages: %d  A1in bytes: " XOT "  A1out ghosts: %d\n", tbx_stack_count(cp->stack), tbx_stack_count(cp->a1in), cp->a1in_bytes, tbx_stack_count(cp->ghosts));
+        fprintf(fd, "Ghost hits: %s\n", tbx_stk_pretty_print_double_with_scale(1024, c->stats.ghost_hit_bytes, ppbuf));
+    }
     fprintf(fd, "Used bytes: %s (" XOT ")\n", tbx_stk_pretty_print_double_with_scale(1024, cp->bytes_used, ppbuf), cp->bytes_used);
     fprintf(fd, "Average page size: %s (%lf)\n", tbx_stk_pretty_print_double_with_scale(1024, d, ppbuf), d);
+    page_arena_info(c->arena, fd);
     fprintf(fd, "\n");
     cache_unlock(c);
 }
@@ -219,8 +227,8 @@ void _amp_free_page_list_destroy(lio_cache_t *c)
 
     while ((p = tbx_stack_pop(cp->free_pages)) != NULL) {
         lp = (lio_page_amp_t *)p->priv;
-        if (p->data[0].ptr) free(p->data[0].ptr);
-        if (p->data[1].ptr) free(p->data[1].ptr);
+        page_arena_free(c->arena, p->data[0].ptr);
+        page_arena_free(c->arena, p->data[1].ptr);
         free(lp);
     }
     
@@ -239,6 +247,139 @@ ex_off_t _amp_max_bytes(lio_cache_t *c)
     return(cp->max_bytes);
 }
 
+//*************************************************************************
+// _amp_2q_limits_set - Recalculates the 2Q queue limits from max_bytes
+//*************************************************************************
+
+void _amp_2q_limits_set(lio_cache_t *c)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+
+    cp->a1in_max_bytes = cp->a1in_fraction * cp->max_bytes;
+    cp->max_ghosts = cp->ghost_fraction * cp->max_bytes / c->default_page_size;
+}
+
+//*************************************************************************
+// _amp_page_stack - Returns the stack the page is linked on
+//*************************************************************************
+
+tbx_stack_t *_amp_page_stack(lio_cache_amp_t *cp, lio_page_amp_t *lp)
+{
+    return(((lp->bit_fields & CAMP_A1IN) > 0) ? cp->a1in : cp->stack);
+}
+
+//*************************************************************************
+// _amp_evict_stack - Returns the stack to evict from on the given pass or
+//     NULL if there isn't one.  For 2Q pages come off of A1in as long as
+//     it is over its limit.
+//*************************************************************************
+
+tbx_stack_t *_amp_evict_stack(lio_cache_t *c, int pass)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+    int a1in_first;
+
+    if (cp->policy != AMP_POLICY_2Q) return((pass == 0) ? cp->stack : NULL);
+
+    a1in_first = ((cp->a1in_bytes > cp->a1in_max_bytes) || (tbx_stack_count(cp->stack) == 0)) ? 1 : 0;
+    if (pass == 0) return((a1in_first) ? cp->a1in : cp->stack);
+    if (pass == 1) return((a1in_first) ? cp->stack : cp->a1in);
+    return(NULL);
+}
+
+//*************************************************************************
+// _amp_page_unlink - Removes the page from whichever stack it's on
+//*************************************************************************
+
+void _amp_page_unlink(lio_cache_t *c, lio_cache_page_t *p)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+    lio_page_amp_t *lp = (lio_page_amp_t *)p->priv;
+    tbx_stack_t *stack = _amp_page_stack(cp, lp);
+
+    tbx_stack_move_to_ptr(stack, lp->ele);
+    tbx_stack_delete_current(stack, 0, 0);
+    lp->ele = NULL;
+    if ((lp->bit_fields & CAMP_A1IN) > 0) {
+        lp->bit_fields ^= CAMP_A1IN;
+        cp->a1in_bytes -= ((lio_cache_segment_t *)p->seg->priv)->page_size;
+    }
+}
+
+//*************************************************************************
+// _amp_ghost_add - Remembers a page evicted from A1in.  The oldest ghost
+//     is dropped if the table is full.
+//*************************************************************************
+
+void _amp_ghost_add(lio_cache_t *c, lio_cache_page_t *p)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+    lio_amp_ghost_t *g;
+
+    if (cp->max_ghosts <= 0) return;
+
+    tbx_type_malloc_clear(g, lio_amp_ghost_t, 1);
+    g->key.sid = segment_id(p->seg);
+    g->key.offset = p->offset;
+    if (apr_hash_get(cp->ghost_table, &(g->key), sizeof(lio_amp_ghost_key_t)) != NULL) {
+        free(g);  //** Already have it
+        return;
+    }
+
+    tbx_stack_push(cp->ghosts, g);
+    g->ele = tbx_stack_get_current_ptr(cp->ghosts);
+    apr_hash_set(cp->ghost_table, &(g->key), sizeof(lio_amp_ghost_key_t), g);
+
+    while (tbx_stack_count(cp->ghosts) > cp->max_ghosts) {
+        g = tbx_stack_pop_bottom(cp->ghosts);
+        apr_hash_set(cp->ghost_table, &(g->key), sizeof(lio_amp_ghost_key_t), NULL);
+        free(g);
+    }
+}
+
+//*************************************************************************
+// _amp_ghost_hit - Checks if the page was recently evicted from A1in.
+//     If so the ghost is removed and 1 is returned.  Otherwise 0 is returned.
+//*************************************************************************
+
+int _amp_ghost_hit(lio_cache_t *c, lio_cache_page_t *p)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+    lio_amp_ghost_key_t key;
+    lio_amp_ghost_t *g;
+
+    memset(&key, 0, sizeof(key));
+    key.sid = segment_id(p->seg);
+    key.offset = p->offset;
+    g = apr_hash_get(cp->ghost_table, &key, sizeof(lio_amp_ghost_key_t));
+    if (g == NULL) return(0);
+
+    apr_hash_set(cp->ghost_table, &(g->key), sizeof(lio_amp_ghost_key_t), NULL);
+    tbx_stack_move_to_ptr(cp->ghosts, g->ele);
+    tbx_stack_delete_current(cp->ghosts, 0, 0);
+    free(g);
+
+    return(1);
+}
+
+//*************************************************************************
+// _amp_page_evicted - Called when a linked page is pushed out of the cache.
+//     A1in pages leave a ghost behind.  NOTE: The page must already be
+//     unlinked from its stack.
+//*************************************************************************
+
+void _amp_page_evicted(lio_cache_t *c, lio_cache_page_t *p)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+    lio_page_amp_t *lp = (lio_page_amp_t *)p->priv;
+
+    if ((lp->bit_fields & CAMP_A1IN) == 0) return;
+
+    lp->bit_fields ^= CAMP_A1IN;
+    cp->a1in_bytes -= ((lio_cache_segment_t *)p->seg->priv)->page_size;
+    if (p->offset > -1) _amp_ghost_add(c, p);
+}
+
 //*************************************************************************
 //  _amp_stream_get - returns the *nearest* stream ot the offset if nbytes<=0.
 //      Otherwise it will create a blank new page stream with the offset and return it.
@@ -416,6 +557,21 @@ void _amp_adjust_dirty(lio_cache_t *c, ex_off_t tweak)
     }
 }
 
+//*************************************************************************
+// _amp_page_data_resize - Changes the size of a recycled page's buffer.
+//     The contents are not preserved.
+//*************************************************************************
+
+void _amp_page_data_resize(lio_cache_t *c, lio_cache_page_t *p, ex_off_t page_size)
+{
+    if (c->arena) {
+        page_arena_free(c->arena, p->data[0].ptr);
+        p->data[0].ptr = page_arena_alloc(c->arena, page_size);
+    } else {
+        p->data[0].ptr = realloc(p->data[0].ptr, page_size);
+    }
+}
+
 //*************************************************************************
 // _amp_free_page_fetch - Returns a page from the free list or NULL
 //   if none are available
@@ -435,16 +591,16 @@ lio_cache_page_t *_amp_free_page_fetch(lio_cache_t *c, ex_off_t page_size)
         } else if (p->offset < page_size) {
             left -= p->offset;
             if (left < 0) {
-                p->data[0].ptr = realloc(p->data[0].ptr, page_size);
+                _amp_page_data_resize(c, p, page_size);
                 return(p);
             } else {
                 lp = (lio_page_amp_t *)p->priv;
-                if (p->data[0].ptr) free(p->data[0].ptr);
-                if (p->data[1].ptr) free(p->data[1].ptr);
+                page_arena_free(c->arena, p->data[0].ptr);
+                page_arena_free(c->arena, p->data[1].ptr);
                 free(lp);
             }
         } else if (p->offset > page_size) {
-            p->data[0].ptr = realloc(p->data[0].ptr, page_size);
+            _amp_page_data_resize(c, p, page_size);
             return(p);
         }
     }
@@ -472,21 +628,34 @@ lio_cache_page_t *_amp_new_page(lio_cache_t *c, lio_segment_t *seg)
         p = &(lp->page);
         p->curr_data = &(p->data[0]);
         p->current_index = 0;
-        tbx_type_malloc_clear(p->curr_data->ptr, char, s->page_size);
-        if (c->coredump_pages == 0) madvise(p->curr_data->ptr, s->page_size, MADV_DONTDUMP);
+        if (c->arena) {
+            p->curr_data->ptr = page_arena_alloc(c->arena, s->page_size);
+        } else {
+            tbx_type_malloc_clear(p->curr_data->ptr, char, s->page_size);
+            if (c->coredump_pages == 0) madvise(p->curr_data->ptr, s->page_size, MADV_DONTDUMP);
+        }
     }
 
     cp->bytes_used += s->page_size;
+    cp->bytes_created += s->page_size;
 
     p->priv = (void *)lp;
     p->seg = seg;
     p->offset = tbx_atomic_dec(amp_dummy);
     p->bit_fields = C_EMPTY;  //** This way it's not accidentally deleted
     lp->stream_offset = -1;
-
-    //** Store my position
-    tbx_stack_push(cp->stack, p);
-    lp->ele = tbx_stack_get_current_ptr(cp->stack);
+    lp->bit_fields = 0;
+
+    //** Store my position.  With 2Q new pages have to earn their way onto the LRU
+    if (cp->policy == AMP_POLICY_2Q) {
+        lp->bit_fields = CAMP_A1IN;
+        cp->a1in_bytes += s->page_size;
+        tbx_stack_push(cp->a1in, p);
+        lp->ele = tbx_stack_get_current_ptr(cp->a1in);
+    } else {
+        tbx_stack_push(cp->stack, p);
+        lp->ele = tbx_stack_get_current_ptr(cp->stack);
+    }
 
     log_printf(_amp_logging, " seg=" XIDT " MRU page created initial->offset=" XOT " page_size=" XOT " bytes_used=" XOT " stack_size=%d\n", segment_id(seg), p->offset, s->page_size, cp->bytes_used, tbx_stack_count(cp->stack));
     return(p);
@@ -753,8 +922,7 @@ int _amp_pages_release(lio_cache_t *c, lio_cache_page_t **page, int n_pages)
 
             cp->bytes_used -= s->page_size;
             if (lp->ele != NULL) {
-                tbx_stack_move_to_ptr(cp->stack, lp->ele);
-                tbx_stack_delete_current(cp->stack, 0, 0);
+                _amp_page_unlink(c, p);
             } else {
                 cp->limbo_pages--;
                 log_printf(15, "seg=" XIDT " limbo page p->offset=" XOT " limbo=%d\n", segment_id(p->seg), p->offset, cp->limbo_pages);
@@ -803,10 +971,7 @@ void _amp_pages_destroy(lio_cache_t *c, lio_cache_page_t **page, int n_pages, in
             cp->bytes_used -= s->page_size;
             lp = (lio_page_amp_t *)p->priv;
 
-            if (lp->ele != NULL) {
-                tbx_stack_move_to_ptr(cp->stack, lp->ele);
-                tbx_stack_delete_current(cp->stack, 0, 0);
-            }
+            if (lp->ele != NULL) _amp_page_unlink(c, p);
 
             if (remove_from_segment == 1) {
                 s = (lio_cache_segment_t *)p->seg->priv;
@@ -844,8 +1009,19 @@ int _amp_page_access(lio_cache_t *c, lio_cache_page_t *p, int rw_mode, ex_off_t
     //** Only update the position if the page is linked.
     //** Otherwise the page is destined to be dropped
     if (lp->ele != NULL) {
-        //** Move to the MRU position
-        if ((lp->bit_fields & CAMP_ACCESSED) > 0) {
+        if ((lp->bit_fields & CAMP_A1IN) > 0) {
+            //** A1in is a FIFO so repeat hits don't move the page.  But if it was
+            //** recently evicted from A1in it's part of the working set so promote it.
+            if (((lp->bit_fields & CAMP_ACCESSED) == 0) && (_amp_ghost_hit(c, p) == 1)) {
+                log_printf(_amp_logging, "seg=" XIDT " GHOST_HIT offset=" XOT "\n", segment_id(p->seg), p->offset);
+                c->stats.ghost_hit_bytes += s->page_size;
+                tbx_stack_move_to_ptr(cp->a1in, lp->ele);
+                tbx_stack_unlink_current(cp->a1in, 1);
+                tbx_stack_link_push(cp->stack, lp->ele);
+                lp->bit_fields ^= CAMP_A1IN;
+                cp->a1in_bytes -= s->page_size;
+            }
+        } else if ((lp->bit_fields & CAMP_ACCESSED) > 0) {  //** Move to the MRU position
             log_printf(_amp_logging, "seg=" XIDT " MRU offset=" XOT "\n", segment_id(p->seg), p->offset);
             tbx_stack_move_to_ptr(cp->stack, lp->ele);
             tbx_stack_unlink_current(cp->stack, 1);
@@ -912,46 +1088,50 @@ int _amp_free_mem(lio_cache_t *c, lio_segment_t *pseg, ex_off_t bytes_to_free)
     lio_cache_segment_t *s;
     lio_cache_page_t *p;
     lio_page_amp_t *lp;
+    tbx_stack_t *stack;
     tbx_stack_ele_t *ele;
     ex_off_t total_bytes, pending_bytes;
-    int count, err;
+    int count, err, pass;
 
     total_bytes = 0;
-    err = 0;
 
-    log_printf(_amp_logging, "START seg=" XIDT " bytes_to_free=" XOT " bytes_used=" XOT " stack_size=%d\n", segment_id(pseg), bytes_to_free, cp->bytes_used, tbx_stack_count(cp->stack));
+    log_printf(_amp_logging, "START seg=" XIDT " bytes_to_free=" XOT " bytes_used=" XOT " stack_size=%d\n", (pseg) ? segment_id(pseg) : 0, bytes_to_free, cp->bytes_used, tbx_stack_count(cp->stack));
 
-    tbx_stack_move_to_bottom(cp->stack);
-    ele = tbx_stack_get_current_ptr(cp->stack);
-    while ((total_bytes < bytes_to_free) && (ele != NULL) && (err == 0)) {
-        p = (lio_cache_page_t *)tbx_stack_ele_get_data(ele);
-        lp = (lio_page_amp_t *)p->priv;
-        if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
-            count = p->access_pending[CACHE_READ] + p->access_pending[CACHE_WRITE] + p->access_pending[CACHE_FLUSH];
-            if (count == 0) { //** No one is using it
-                if (((p->bit_fields & C_ISDIRTY) == 0) && ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0)) {  //** Don't have to flush it
-                    s = (lio_cache_segment_t *)p->seg->priv;
-                    total_bytes += s->page_size;
-                    log_printf(_amp_logging, "amp_free_mem: freeing page seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
-                    tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
-                    tbx_stack_delete_current(cp->stack, 1, 0);
-                    _amp_free_page_push(c, p);
-                } else {         //** Got to flush the page first
+    for (pass=0; (total_bytes < bytes_to_free) && ((stack = _amp_evict_stack(c, pass)) != NULL); pass++) {
+        err = 0;
+        tbx_stack_move_to_bottom(stack);
+        ele = tbx_stack_get_current_ptr(stack);
+        while ((total_bytes < bytes_to_free) && (ele != NULL) && (err == 0)) {
+            p = (lio_cache_page_t *)tbx_stack_ele_get_data(ele);
+            lp = (lio_page_amp_t *)p->priv;
+            if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
+                count = p->access_pending[CACHE_READ] + p->access_pending[CACHE_WRITE] + p->access_pending[CACHE_FLUSH];
+                if (count == 0) { //** No one is using it
+                    if (((p->bit_fields & C_ISDIRTY) == 0) && ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0)) {  //** Don't have to flush it
+                        s = (lio_cache_segment_t *)p->seg->priv;
+                        total_bytes += s->page_size;
+                        log_printf(_amp_logging, "amp_free_mem: freeing page seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+                        tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
+                        tbx_stack_delete_current(stack, 1, 0);
+                        _amp_page_evicted(c, p);
+                        _amp_free_page_push(c, p);
+                    } else {         //** Got to flush the page first
+                        err = 1;
+                    }
+                } else {
                     err = 1;
                 }
             } else {
-                err = 1;
+                tbx_stack_move_up(stack);
             }
-        } else {
-            tbx_stack_move_up(cp->stack);
-        }
 
-        ele = tbx_stack_get_current_ptr(cp->stack);
+            ele = tbx_stack_get_current_ptr(stack);
+        }
     }
 
     cp->bytes_used -= total_bytes;
     pending_bytes = bytes_to_free - total_bytes;
-    log_printf(_amp_logging, "END seg=" XIDT " bytes_to_free=" XOT " pending_bytes=" XOT " bytes_used=" XOT "\n", segment_id(pseg), bytes_to_free, pending_bytes, cp->bytes_used);
+    log_printf(_amp_logging, "END seg=" XIDT " bytes_to_free=" XOT " pending_bytes=" XOT " bytes_used=" XOT "\n", (pseg) ? segment_id(pseg) : 0, bytes_to_free, pending_bytes, cp->bytes_used);
 
     return(pending_bytes);
 }
@@ -967,6 +1147,7 @@ ex_off_t _amp_attempt_free_mem(lio_cache_t *c, lio_segment_t *page_seg, ex_off_t
     lio_cache_segment_t *s = NULL;
     lio_cache_page_t *p;
     lio_page_amp_t *lp;
+    tbx_stack_t *stack;
     tbx_stack_ele_t *ele, *curr_ele;
     gop_op_generic_t *gop;
     gop_opque_t *q;
@@ -974,7 +1155,7 @@ ex_off_t _amp_attempt_free_mem(lio_cache_t *c, lio_segment_t *page_seg, ex_off_t
     ex_off_t total_bytes, freed_bytes, pending_bytes;
     ex_id_t *segid;
     tbx_list_iter_t sit;
-    int count, n;
+    int count, n, pass;
     tbx_list_t *table;
     lio_page_table_t *ptable;
     tbx_pch_t pch, pt_pch;
@@ -991,86 +1172,90 @@ ex_off_t _amp_attempt_free_mem(lio_cache_t *c, lio_segment_t *page_seg, ex_off_t
     table = *(tbx_list_t **)tbx_pch_data(&pch);
 
     //** Get the list of pages to free
-    tbx_stack_move_to_bottom(cp->stack);
-    ele = tbx_stack_get_current_ptr(cp->stack);
-    while ((total_bytes < bytes_to_free) && (ele != NULL)) {
-        p = (lio_cache_page_t *)tbx_stack_ele_get_data(ele);
-        lp = (lio_page_amp_t *)p->priv;
-        s = (lio_cache_segment_t *)p->seg->priv;
-
-        log_printf(15, "checking page for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
-        tbx_log_flush();
+    for (pass=0; (total_bytes < bytes_to_free) && ((stack = _amp_evict_stack(c, pass)) != NULL); pass++) {
+        tbx_stack_move_to_bottom(stack);
+        ele = tbx_stack_get_current_ptr(stack);
+        while ((total_bytes < bytes_to_free) && (ele != NULL)) {
+            p = (lio_cache_page_t *)tbx_stack_ele_get_data(ele);
+            lp = (lio_page_amp_t *)p->priv;
+            s = (lio_cache_segment_t *)p->seg->priv;
 
-        if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
-            if ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0) {  //** Already used once or cycled so ok to evict
-                if ((lp->bit_fields & CAMP_ACCESSED) == 0) c->stats.unused_bytes += s->page_size;
+            log_printf(15, "checking page for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+            tbx_log_flush();
 
-                n = 0;
-                count = p->access_pending[CACHE_READ] + p->access_pending[CACHE_WRITE] + p->access_pending[CACHE_FLUSH];
-                if (count == 0) { //** No one is using it
-                    if (((p->bit_fields & C_ISDIRTY) == 0) && ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0)) {  //** Don't have to flush it
-                        freed_bytes += s->page_size;
-                        log_printf(_amp_logging, "freeing page seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
-                        tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
-                        tbx_stack_delete_current(cp->stack, 1, 0);
-                        _amp_free_page_push(c, p);
-                        n = 1;
+            if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
+                if ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0) {  //** Already used once or cycled so ok to evict
+                    if ((lp->bit_fields & CAMP_ACCESSED) == 0) c->stats.unused_bytes += s->page_size;
+
+                    n = 0;
+                    count = p->access_pending[CACHE_READ] + p->access_pending[CACHE_WRITE] + p->access_pending[CACHE_FLUSH];
+                    if (count == 0) { //** No one is using it
+                        if (((p->bit_fields & C_ISDIRTY) == 0) && ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0)) {  //** Don't have to flush it
+                            freed_bytes += s->page_size;
+                            log_printf(_amp_logging, "freeing page seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+                            tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
+                            tbx_stack_delete_current(stack, 1, 0);
+                            _amp_page_evicted(c, p);
+                            _amp_free_page_push(c, p);
+                            n = 1;
+                        }
                     }
-                }
 
-                if (n == 0) { //** Couldn't perform an immediate release
-                    if ((p->access_pending[CACHE_FLUSH] == 0) && ((p->bit_fields & C_ISDIRTY) != 0)) {  //** Make sure it's not already being flushed and it's dirty
-                        ptable = (lio_page_table_t *)tbx_list_search(table, (tbx_list_key_t *)&(segment_id(p->seg)));
-                        if (ptable == NULL) {  //** Have to make a new segment entry
-                            pt_pch = tbx_pch_reserve(cp->free_page_tables);
-                            ptable = (lio_page_table_t *)tbx_pch_data(&pt_pch);
-                            ptable->seg = p->seg;
-                            ptable->id = segment_id(p->seg);
-                            ptable->pch = pt_pch;
-                            tbx_list_insert(table, &(ptable->id), ptable);
-                            ptable->lo = p->offset;
-                            ptable->hi = p->offset;
-                        } else {
-                            if (ptable->lo > p->offset) ptable->lo = p->offset;
-                            if (ptable->hi < p->offset) ptable->hi = p->offset;
+                    if (n == 0) { //** Couldn't perform an immediate release
+                        if ((p->access_pending[CACHE_FLUSH] == 0) && ((p->bit_fields & C_ISDIRTY) != 0)) {  //** Make sure it's not already being flushed and it's dirty
+                            ptable = (lio_page_table_t *)tbx_list_search(table, (tbx_list_key_t *)&(segment_id(p->seg)));
+                            if (ptable == NULL) {  //** Have to make a new segment entry
+                                pt_pch = tbx_pch_reserve(cp->free_page_tables);
+                                ptable = (lio_page_table_t *)tbx_pch_data(&pt_pch);
+                                ptable->seg = p->seg;
+                                ptable->id = segment_id(p->seg);
+                                ptable->pch = pt_pch;
+                                tbx_list_insert(table, &(ptable->id), ptable);
+                                ptable->lo = p->offset;
+                                ptable->hi = p->offset;
+                            } else {
+                                if (ptable->lo > p->offset) ptable->lo = p->offset;
+                                if (ptable->hi < p->offset) ptable->hi = p->offset;
+                            }
                         }
-                    }
-                    p->bit_fields |= C_TORELEASE;
+                        p->bit_fields |= C_TORELEASE;
 
-                    log_printf(_amp_logging, "in use marking for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+                        log_printf(_amp_logging, "in use marking for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
 
-                    pending_bytes += s->page_size;
-                    tbx_stack_unlink_current(cp->stack, 1);  //** Unlink it.  This is ele
-                    free(lp->ele);
-                    lp->ele = NULL;  //** Mark it as removed from the list so a page_release doesn't free also
-                    cp->limbo_pages++;
-                    log_printf(15, "UNLINKING seg=" XIDT " p->offset=" XOT " bits=%d limbo=%d\n", segment_id(p->seg), p->offset, p->bit_fields, cp->limbo_pages);
+                        pending_bytes += s->page_size;
+                        tbx_stack_unlink_current(stack, 1);  //** Unlink it.  This is ele
+                        free(lp->ele);
+                        lp->ele = NULL;  //** Mark it as removed from the list so a page_release doesn't free also
+                        _amp_page_evicted(c, p);
+                        cp->limbo_pages++;
+                        log_printf(15, "UNLINKING seg=" XIDT " p->offset=" XOT " bits=%d limbo=%d\n", segment_id(p->seg), p->offset, p->bit_fields, cp->limbo_pages);
+                    }
+                } else {
+                    lp->bit_fields |= CAMP_OLD;  //** Flag it as old
+
+                    log_printf(_amp_logging, "seg=" XIDT " MRU retry offset=" XOT "\n", segment_id(p->seg), p->offset);
+
+                    tbx_stack_unlink_current(stack, 1);  //** and move it to the MRU slot.  This is ele
+                    curr_ele = tbx_stack_get_current_ptr(stack);
+                    tbx_stack_move_to_top(stack);
+                    tbx_stack_link_insert_above(stack, lp->ele);
+                    tbx_stack_move_to_ptr(stack, curr_ele);
+
+                    //** Tweak the stream info
+                    _amp_stream_get(c, p->seg, p->offset, -1, &ps);  //** Don't care about the initial element in the chaing.  Just the last
+                    if (ps != NULL) {
+                        if (ps->prefetch_size > 0) ps->prefetch_size--;
+                        if (ps->trigger_distance > 0) ps->trigger_distance--;
+                        if ((ps->prefetch_size-1) < ps->trigger_distance) ps->trigger_distance = ps->prefetch_size - 1;
+                    }
                 }
             } else {
-                lp->bit_fields |= CAMP_OLD;  //** Flag it as old
-
-                log_printf(_amp_logging, "seg=" XIDT " MRU retry offset=" XOT "\n", segment_id(p->seg), p->offset);
-
-                tbx_stack_unlink_current(cp->stack, 1);  //** and move it to the MRU slot.  This is ele
-                curr_ele = tbx_stack_get_current_ptr(cp->stack);
-                tbx_stack_move_to_top(cp->stack);
-                tbx_stack_link_insert_above(cp->stack, lp->ele);
-                tbx_stack_move_to_ptr(cp->stack, curr_ele);
-
-                //** Tweak the stream info
-                _amp_stream_get(c, p->seg, p->offset, -1, &ps);  //** Don't care about the initial element in the chaing.  Just the last
-                if (ps != NULL) {
-                    if (ps->prefetch_size > 0) ps->prefetch_size--;
-                    if (ps->trigger_distance > 0) ps->trigger_distance--;
-                    if ((ps->prefetch_size-1) < ps->trigger_distance) ps->trigger_distance = ps->prefetch_size - 1;
-                }
+                tbx_stack_move_up(stack);  //** Marked for release so move to the next page
             }
-        } else {
-            tbx_stack_move_up(cp->stack);  //** Marked for release so move to the next page
-        }
 
-        total_bytes = freed_bytes + pending_bytes;
-        if (total_bytes < bytes_to_free) ele = tbx_stack_get_current_ptr(cp->stack);
+            total_bytes = freed_bytes + pending_bytes;
+            if (total_bytes < bytes_to_free) ele = tbx_stack_get_current_ptr(stack);
+        }
     }
 
 
@@ -1423,8 +1608,12 @@ void amp_print_running_config(lio_cache_t *c, FILE *fd, int print_section_headin
     char text[1024];
 
     if (print_section_heading) fprintf(fd, "[%s]\n", cp->section);;
-    fprintf(fd, "type = %s\n", CACHE_TYPE_AMP);
+    fprintf(fd, "type = %s\n", c->type);
     fprintf(fd, "max_bytes = %s\n", tbx_stk_pretty_print_int_with_scale(cp->max_bytes, text));
+    if (cp->policy == AMP_POLICY_2Q) {
+        fprintf(fd, "a1in_fraction = %lf\n", cp->a1in_fraction);
+        fprintf(fd, "ghost_fraction = %lf\n", cp->ghost_fraction);
+    }
     fprintf(fd, "max_streams = %d\n", cp->max_streams);
     fprintf(fd, "dirty_frarction = %lf\n", cp->dirty_fraction);
     fprintf(fd, "default_page_size = %s\n", tbx_stk_pretty_print_int_with_scale(c->default_page_size, text));
@@ -1435,9 +1624,52 @@ void amp_print_running_config(lio_cache_t *c, FILE *fd, int print_section_headin
     fprintf(fd, "ppages = %d\n", c->n_ppages);
     fprintf(fd, "min_direct = %s\n", tbx_stk_pretty_print_int_with_scale(c->min_direct, text));
     fprintf(fd, "coredump_pages = %d\n", c->coredump_pages);
+    page_arena_print_running_config(c->arena, fd);
     fprintf(fd, "\n");
 }
 
+//*************************************************************************
+// amp_cache_usage_get - Returns a snapshot of the cache memory usage
+//*************************************************************************
+
+void amp_cache_usage_get(lio_cache_t *c, ex_off_t *max_bytes, ex_off_t *bytes_used, ex_off_t *bytes_created, int *n_waiting)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+
+    cache_lock(c);
+    *max_bytes = cp->max_bytes;
+    *bytes_used = cp->bytes_used;
+    *bytes_created = cp->bytes_created;
+    *n_waiting = tbx_stack_count(cp->waiting_stack);
+    cache_unlock(c);
+}
+
+//*************************************************************************
+// amp_cache_max_bytes_set - Changes the cache size on the fly.  If the cache
+//     shrinks any clean idle pages over the new limit are released now and
+//     the rest is reclaimed as new pages are requested.
+//*************************************************************************
+
+void amp_cache_max_bytes_set(lio_cache_t *c, ex_off_t max_bytes)
+{
+    lio_cache_amp_t *cp = (lio_cache_amp_t *)c->fn.priv;
+    ex_off_t old;
+
+    cache_lock(c);
+    old = cp->max_bytes;
+    cp->max_bytes = max_bytes;
+    cp->dirty_bytes_trigger = cp->dirty_fraction * cp->max_bytes;
+    c->max_fetch_size = c->max_fetch_fraction * cp->max_bytes;
+    c->write_temp_overflow_size = c->write_temp_overflow_fraction * cp->max_bytes;
+    _amp_2q_limits_set(c);
+    if (max_bytes > old) {
+        _amp_process_waiters(c);  //** Got more room so wake anyone waiting for space
+    } else if (cp->bytes_used > max_bytes) {
+        _amp_free_mem(c, NULL, cp->bytes_used - max_bytes);
+    }
+    cache_unlock(c);
+}
+
 //*************************************************************************
 // amp_cache_destroy - Destroys the cache structure.
 //     NOTE: Data is not flushed!
@@ -1471,6 +1703,10 @@ int amp_cache_destroy(lio_cache_t *c)
 
     cache_base_destroy(c);
 
+    if (tbx_stack_count(cp->a1in) > 0) {
+        log_printf(0, "ERROR a1in_size=%d\n", tbx_stack_count(cp->a1in)); tbx_log_flush();
+    }
+
     if (tbx_stack_count(cp->stack) > 0) {
         log_printf(0, "cache_stack_size=%d\n", tbx_stack_count(cp->stack)); tbx_log_flush();
 
@@ -1488,12 +1724,15 @@ int amp_cache_destroy(lio_cache_t *c)
     }
 
     tbx_stack_free(cp->stack, 1);
+    tbx_stack_free(cp->a1in, 1);
+    tbx_stack_free(cp->ghosts, 1);
     _amp_free_page_list_destroy(c);
     tbx_stack_free(cp->waiting_stack, 0);
     tbx_stack_free(cp->pending_free_tasks, 0);
 
     tbx_pc_destroy(cp->free_pending_tables);
     tbx_pc_destroy(cp->free_page_tables);
+    page_arena_destroy(c->arena);
 
     free(cp->section);
     free(cp);
@@ -1522,6 +1761,10 @@ lio_cache_t *amp_cache_create(void *arg, data_attr_t *da, int timeout)
 
     cache->shutdown_request = 0;
     c->stack = tbx_stack_new();
+    c->a1in = tbx_stack_new();
+    c->ghosts = tbx_stack_new();
+    c->ghost_table = apr_hash_make(cache->mpool);
+    c->policy = AMP_POLICY_LRU;
     c->free_pages = tbx_stack_new();
     c->waiting_stack = tbx_stack_new();
     c->pending_free_tasks = tbx_stack_new();
@@ -1532,6 +1775,8 @@ lio_cache_t *amp_cache_create(void *arg, data_attr_t *da, int timeout)
     c->dirty_fraction = amp_default_options.dirty_fraction;
     c->async_prefetch_threshold = amp_default_options.async_prefetch_threshold;
     c->min_prefetch_size = amp_default_options.min_prefetch_size;
+    c->a1in_fraction = amp_default_options.a1in_fraction;
+    c->ghost_fraction = amp_default_options.ghost_fraction;
     cache->n_ppages = cache_default_options.n_ppages;
     cache->max_fetch_fraction = cache_default_options.max_fetch_fraction;
     cache->max_fetch_size = cache->max_fetch_fraction * c->max_bytes;
@@ -1609,6 +1854,9 @@ lio_cache_t *amp_cache_load(void *arg, tbx_inip_file_t *fd, char *grp, data_attr
     c->n_ppages = tbx_inip_get_integer(fd, cp->section, "ppages", c->n_ppages);
     c->min_direct = tbx_inip_get_integer(fd, cp->section, "min_direct", -1);
     c->coredump_pages = tbx_inip_get_integer(fd, cp->section, "coredump_pages", 0);
+    cp->a1in_fraction = tbx_inip_get_double(fd, cp->section, "a1in_fraction", cp->a1in_fraction);
+    cp->ghost_fraction = tbx_inip_get_double(fd, cp->section, "ghost_fraction", cp->ghost_fraction);
+    _amp_2q_limits_set(c);
 
     v = getenv("COREDUMP_PAGES");
     if (v) {
@@ -1619,6 +1867,51 @@ lio_cache_t *amp_cache_load(void *arg, tbx_inip_file_t *fd, char *grp, data_attr
         }
     }
 
+    c->arena = page_arena_load(fd, cp->section, (c->coredump_pages == 0) ? 1 : 0);
+
+    cache_unlock(c);
+
+    return(c);
+}
+
+//*************************************************************************
+// amp_2q_cache_create - Creates an empty amp cache using the 2Q replacement
+//     policy.  Pages referenced once sit on a small FIFO so large sequential
+//     scans can't flush the hot pages on the LRU.
+//*************************************************************************
+
+lio_cache_t *amp_2q_cache_create(void *arg, data_attr_t *da, int timeout)
+{
+    lio_cache_t *c;
+    lio_cache_amp_t *cp;
+
+    c = amp_cache_create(arg, da, timeout);
+    cp = (lio_cache_amp_t *)c->fn.priv;
+
+    cache_lock(c);
+    c->type = CACHE_TYPE_2Q;
+    cp->policy = AMP_POLICY_2Q;
+    _amp_2q_limits_set(c);
+    cache_unlock(c);
+
+    return(c);
+}
+
+//*************************************************************************
+// amp_2q_cache_load - Creates and configures an amp cache using 2Q
+//*************************************************************************
+
+lio_cache_t *amp_2q_cache_load(void *arg, tbx_inip_file_t *fd, char *grp, data_attr_t *da, int timeout)
+{
+    lio_cache_t *c;
+    lio_cache_amp_t *cp;
+
+    c = amp_cache_load(arg, fd, grp, da, timeout);
+    cp = (lio_cache_amp_t *)c->fn.priv;
+
+    cache_lock(c);
+    c->type = CACHE_TYPE_2Q;
+    cp->policy = AMP_POLICY_2Q;
     cache_unlock(c);
 
     return(c);
@@ -17,6 +17,7 @@
 #ifndef __CACHE_AMP_H_
 #define __CACHE_AMP_H_
 
+#include <apr_hash.h>
 #include <apr_thread_proc.h>
 #include <lio/cache.h>
 #include <lio/segment.h>
@@ -30,8 +31,14 @@ extern "C" {
 #endif
 
 #define CACHE_TYPE_AMP "amp"
+#define CACHE_TYPE_2Q  "2q"
+
+#define AMP_POLICY_LRU 0  //** Single LRU stack with a second chance for unused pages
+#define AMP_POLICY_2Q  1  //** 2Q: New pages go on an A1in FIFO and only move to the LRU on a ghost hit
 
 typedef struct lio_amp_page_stream_t lio_amp_page_stream_t;
+typedef struct lio_amp_ghost_t lio_amp_ghost_t;
+typedef struct lio_amp_ghost_key_t lio_amp_ghost_key_t;
 typedef struct lio_amp_page_wait_t lio_amp_page_wait_t;
 typedef struct lio_amp_stream_table_t lio_amp_stream_table_t;
 typedef struct lio_cache_amp_t lio_cache_amp_t;
@@ -39,10 +46,15 @@ typedef struct lio_page_amp_t lio_page_amp_t;
 
 lio_cache_t *amp_cache_create(void *arg, data_attr_t *da, int timeout);
 lio_cache_t *amp_cache_load(void *arg, tbx_inip_file_t *ifd, char *section, data_attr_t *da, int timeout);
+lio_cache_t *amp_2q_cache_create(void *arg, data_attr_t *da, int timeout);
+lio_cache_t *amp_2q_cache_load(void *arg, tbx_inip_file_t *ifd, char *section, data_attr_t *da, int timeout);
+void amp_cache_usage_get(lio_cache_t *c, ex_off_t *max_bytes, ex_off_t *bytes_used, ex_off_t *bytes_created, int *n_waiting);
+void amp_cache_max_bytes_set(lio_cache_t *c, ex_off_t max_bytes);
 
 #define CAMP_ACCESSED 1  //** Page has been accessed
 #define CAMP_TAG      2  //** Tag page for pretech
 #define CAMP_OLD      4  //** Page has been recycled without a hit
+#define CAMP_A1IN     8  //** Page is on the 2Q A1in FIFO instead of the main LRU stack
 
 struct lio_page_amp_t {
     lio_cache_page_t page;  //** Actual page
@@ -66,9 +78,22 @@ struct lio_amp_stream_table_t {
     int start_apt_pages;
 };
 
+struct lio_amp_ghost_key_t {
+    ex_id_t sid;
+    ex_off_t offset;
+};
+
+struct lio_amp_ghost_t {      //** 2Q A1out entry.  Just remembers the page location
+    lio_amp_ghost_key_t key;
+    tbx_stack_ele_t *ele;
+};
+
 struct lio_cache_amp_t {
     char *section;
     tbx_stack_t *stack;
+    tbx_stack_t *a1in;          //** 2Q FIFO for pages only referenced once
+    tbx_stack_t *ghosts;        //** 2Q A1out FIFO of pages recently evicted from A1in
+    apr_hash_t *ghost_table;    //** Lookup table for the ghosts
     tbx_stack_t *free_pages;
     tbx_stack_t *waiting_stack;
     tbx_stack_t *pending_free_tasks;
@@ -79,11 +104,18 @@ struct lio_cache_amp_t {
     apr_time_t dirty_max_wait;
     ex_off_t max_bytes;
     ex_off_t bytes_used;
+    ex_off_t bytes_created;     //** Running total of page bytes allocated.  Used for balancing shards
     ex_off_t dirty_bytes_trigger;
     ex_off_t prefetch_in_process;
     ex_off_t async_prefetch_threshold;
     ex_off_t min_prefetch_size;
+    ex_off_t a1in_bytes;
+    ex_off_t a1in_max_bytes;
     double   dirty_fraction;
+    double   a1in_fraction;
+    double   ghost_fraction;
+    int      max_ghosts;
+    int      policy;
     int      max_streams;
     int      flush_in_progress;
     int      limbo_pages;
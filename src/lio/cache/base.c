@@ -38,7 +38,7 @@
 //  cache_base_handle  - Simple get_handle method
 //*************************************************************************
 
-lio_cache_t *cache_base_handle(lio_cache_t *c)
+lio_cache_t *cache_base_handle(lio_cache_t *c, lio_segment_t *seg)
 {
     return(c);
 }
@@ -0,0 +1,415 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************************
+// Page arena for the cache page data.  A single region is mmap'ed up front,
+// optionally backed by huge pages and bound to a NUMA node, and split into
+// fixed size slabs.  Each slab is dedicated to a single buffer size the
+// first time it's needed.  Freed buffers go back on their size class's
+// free list so recycling a page is a couple of pointer moves.  If the arena
+// is full or the size is larger than a slab we fall back to malloc().
+//*************************************************************************
+
+#define _log_module_index 226
+
+#include <apr_pools.h>
+#include <apr_thread_mutex.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <tbx/iniparse.h>
+#include <tbx/log.h>
+#include <tbx/string_token.h>
+#include <tbx/type_malloc.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "cache/page_arena.h"
+#include "ex3/fmttypes.h"
+
+#define PAGE_ARENA_MAX_CLASS 16
+#define PAGE_ARENA_2M (2*1024*1024)
+#define PAGE_ARENA_1G (1024*1024*1024)
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE 2
+#endif
+
+static char *_huge_mode_name[] = { "none", "thp", "2m", "1g" };
+
+//*************************************************************************
+// _page_arena_huge_size - Returns the alignment needed for the huge page mode
+//*************************************************************************
+
+ex_off_t _page_arena_huge_size(int huge_mode)
+{
+    switch (huge_mode) {
+    case PAGE_ARENA_HUGE_THP:
+    case PAGE_ARENA_HUGE_2M:
+        return(PAGE_ARENA_2M);
+    case PAGE_ARENA_HUGE_1G:
+        return(PAGE_ARENA_1G);
+    }
+
+    return(sysconf(_SC_PAGESIZE));
+}
+
+//*************************************************************************
+// _page_arena_map - Maps the arena region.  Explicit huge pages are tried
+//     1st and if they aren't available we fall back to transparent huge pages.
+//*************************************************************************
+
+char *_page_arena_map(lio_page_arena_t *a, int huge_mode)
+{
+    char *ptr, *start;
+    ex_off_t align, lead, tail;
+    int flags;
+
+#ifdef MAP_HUGETLB
+    if ((huge_mode == PAGE_ARENA_HUGE_2M) || (huge_mode == PAGE_ARENA_HUGE_1G)) {
+        //** No MAP_NORESERVE here.  We want the mmap to fail now if the huge page pool is short rather than SIGBUS later
+        flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+        flags |= ((huge_mode == PAGE_ARENA_HUGE_2M) ? 21 : 30) << MAP_HUGE_SHIFT;
+        ptr = mmap(NULL, a->bytes, PROT_READ|PROT_WRITE, flags, -1, 0);
+        if (ptr != MAP_FAILED) {
+            a->huge_mode = huge_mode;
+            return(ptr);
+        }
+
+        log_printf(0, "WARNING: Unable to map " XOT " bytes of %s huge pages.  Falling back to THP\n", a->bytes, _huge_mode_name[huge_mode]);
+        huge_mode = PAGE_ARENA_HUGE_THP;
+    }
+#else
+    if (huge_mode > PAGE_ARENA_HUGE_THP) huge_mode = PAGE_ARENA_HUGE_THP;
+#endif
+
+    //** Over allocate so we can align the start on a huge page boundary
+    align = (huge_mode == PAGE_ARENA_HUGE_THP) ? PAGE_ARENA_2M : 0;
+    flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    ptr = mmap(NULL, a->bytes + align, PROT_READ|PROT_WRITE, flags, -1, 0);
+    if (ptr == MAP_FAILED) return(NULL);
+
+    start = ptr;
+    if (align > 0) {
+        lead = (align - ((uintptr_t)ptr % align)) % align;
+        tail = align - lead;
+        start = ptr + lead;
+        if (lead > 0) munmap(ptr, lead);
+        if (tail > 0) munmap(start + a->bytes, tail);
+#ifdef MADV_HUGEPAGE
+        madvise(start, a->bytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    a->huge_mode = huge_mode;
+    return(start);
+}
+
+//*************************************************************************
+// page_arena_numa_bind - Binds the arena memory to the NUMA node.  Any pages
+//     already touched are migrated.  Returns 0 on success.
+//*************************************************************************
+
+int page_arena_numa_bind(lio_page_arena_t *a, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    unsigned long mask;
+    int err;
+#endif
+
+    if ((a == NULL) || (node < 0)) return(0);
+
+    if (node >= (int)(8*sizeof(unsigned long))) {
+        log_printf(0, "ERROR: NUMA node %d is out of range\n", node);
+        return(-1);
+    }
+
+#if defined(__linux__) && defined(SYS_mbind)
+    mask = 1UL << node;
+    err = syscall(SYS_mbind, a->base, a->bytes, MPOL_BIND, &mask, 8*sizeof(mask), MPOL_MF_MOVE);
+    if (err != 0) {
+        log_printf(0, "WARNING: mbind() to NUMA node %d failed.  errno=%d\n", node, errno);
+        return(-1);
+    }
+    a->numa_node = node;
+#else
+    log_printf(0, "WARNING: NUMA binding isn't supported on this platform. node=%d\n", node);
+    return(-1);
+#endif
+
+    return(0);
+}
+
+//*************************************************************************
+// page_arena_create - Creates the arena.  Returns NULL if the region can't
+//     be mapped.
+//*************************************************************************
+
+lio_page_arena_t *page_arena_create(ex_off_t bytes, ex_off_t slab_size, int huge_mode, int numa_node, int prefault, int dontdump)
+{
+    lio_page_arena_t *a;
+    ex_off_t align, off, psize;
+    int i;
+
+    if (bytes <= 0) return(NULL);
+
+    tbx_type_malloc_clear(a, lio_page_arena_t, 1);
+
+    //** The region has to be a multiple of the huge page size and slabs a multiple of the base page
+    align = _page_arena_huge_size(huge_mode);
+    psize = sysconf(_SC_PAGESIZE);
+    if (slab_size <= 0) slab_size = PAGE_ARENA_2M;
+    a->slab_size = psize * ((slab_size + psize - 1) / psize);
+    if (bytes < a->slab_size) bytes = a->slab_size;
+    a->bytes = align * ((bytes + align - 1) / align);
+    a->numa_node = -1;
+    a->prefault = prefault;
+    a->dontdump = dontdump;
+
+    a->base = _page_arena_map(a, huge_mode);
+    if (a->base == NULL) {
+        log_printf(0, "ERROR: Unable to map the page arena! bytes=" XOT "\n", a->bytes);
+        free(a);
+        return(NULL);
+    }
+
+    a->n_slabs = a->bytes / a->slab_size;
+    tbx_type_malloc(a->slab_class, int, a->n_slabs);
+    for (i=0; i<a->n_slabs; i++) a->slab_class[i] = -1;
+    a->max_class = PAGE_ARENA_MAX_CLASS;
+    tbx_type_malloc_clear(a->klass, lio_page_arena_class_t, a->max_class);
+
+    apr_pool_create(&(a->mpool), NULL);
+    apr_thread_mutex_create(&(a->lock), APR_THREAD_MUTEX_DEFAULT, a->mpool);
+
+#ifdef MADV_DONTDUMP
+    if (dontdump) madvise(a->base, a->bytes, MADV_DONTDUMP);
+#endif
+
+    if (numa_node >= 0) page_arena_numa_bind(a, numa_node);
+
+    //** Touch everything now so cold fills don't take the page faults
+    if (prefault) {
+        for (off=0; off<a->bytes; off += psize) a->base[off] = 0;
+    }
+
+    log_printf(1, "bytes=" XOT " slab_size=" XOT " n_slabs=%d huge=%s numa_node=%d\n", a->bytes, a->slab_size, a->n_slabs, _huge_mode_name[a->huge_mode], a->numa_node);
+    return(a);
+}
+
+//*************************************************************************
+// page_arena_destroy - Destroys the arena.  Any outstanding buffers are lost.
+//*************************************************************************
+
+void page_arena_destroy(lio_page_arena_t *a)
+{
+    if (a == NULL) return;
+
+    munmap(a->base, a->bytes);
+    apr_thread_mutex_destroy(a->lock);
+    apr_pool_destroy(a->mpool);
+    free(a->slab_class);
+    free(a->klass);
+    free(a);
+}
+
+//*************************************************************************
+// _page_arena_slab_carve - Dedicates a new slab to the class and puts all
+//     its buffers on the free list.  Returns 0 if no slabs are left.
+//     NOTE: Arena lock must be held
+//*************************************************************************
+
+int _page_arena_slab_carve(lio_page_arena_t *a, int k)
+{
+    lio_page_arena_class_t *pc = &(a->klass[k]);
+    char *slab, *buf;
+    ex_off_t i, n;
+
+    if (a->next_slab >= a->n_slabs) return(0);
+
+    slab = a->base + a->next_slab * a->slab_size;
+    a->slab_class[a->next_slab] = k;
+    a->next_slab++;
+
+    n = a->slab_size / pc->size;
+    for (i=n-1; i>=0; i--) {
+        buf = slab + i*pc->size;
+        *(void **)buf = pc->free_list;
+        pc->free_list = buf;
+    }
+    pc->n_free += n;
+
+    return(1);
+}
+
+//*************************************************************************
+// page_arena_alloc - Returns a buffer of the given size.  The arena is
+//     used if possible otherwise the buffer comes from malloc().
+//*************************************************************************
+
+void *page_arena_alloc(lio_page_arena_t *a, ex_off_t size)
+{
+    lio_page_arena_class_t *pc;
+    void *ptr;
+    int k;
+
+    if ((a == NULL) || (size > a->slab_size) || (size < (ex_off_t)sizeof(void *))) goto fallback;
+
+    apr_thread_mutex_lock(a->lock);
+
+    //** Find the size class.  There are only a handful so a linear search is fine
+    for (k=0; k<a->n_class; k++) {
+        if (a->klass[k].size == size) break;
+    }
+    if (k == a->n_class) {
+        if (a->n_class == a->max_class) {
+            apr_thread_mutex_unlock(a->lock);
+            goto fallback;
+        }
+        a->klass[k].size = size;
+        a->n_class++;
+    }
+
+    pc = &(a->klass[k]);
+    if ((pc->free_list == NULL) && (_page_arena_slab_carve(a, k) == 0)) {
+        a->fallback_count++;
+        apr_thread_mutex_unlock(a->lock);
+        goto fallback;
+    }
+
+    ptr = pc->free_list;
+    pc->free_list = *(void **)ptr;
+    pc->n_free--;
+    pc->n_used++;
+    apr_thread_mutex_unlock(a->lock);
+
+    return(ptr);
+
+fallback:
+    tbx_type_malloc_clear(ptr, char, size);
+#ifdef MADV_DONTDUMP
+    if ((a != NULL) && (a->dontdump)) madvise(ptr, size, MADV_DONTDUMP);
+#endif
+    return(ptr);
+}
+
+//*************************************************************************
+// page_arena_free - Releases a buffer returned by page_arena_alloc()
+//*************************************************************************
+
+void page_arena_free(lio_page_arena_t *a, void *ptr)
+{
+    lio_page_arena_class_t *pc;
+    int slab;
+
+    if (ptr == NULL) return;
+
+    if ((a == NULL) || ((char *)ptr < a->base) || ((char *)ptr >= (a->base + a->bytes))) {
+        free(ptr);
+        return;
+    }
+
+    slab = ((char *)ptr - a->base) / a->slab_size;
+
+    apr_thread_mutex_lock(a->lock);
+    pc = &(a->klass[a->slab_class[slab]]);
+    *(void **)ptr = pc->free_list;
+    pc->free_list = ptr;
+    pc->n_free++;
+    pc->n_used--;
+    apr_thread_mutex_unlock(a->lock);
+}
+
+//*************************************************************************
+// page_arena_load - Creates the arena from the cache config section.
+//     Returns NULL if no arena is configured.
+//*************************************************************************
+
+lio_page_arena_t *page_arena_load(tbx_inip_file_t *fd, char *section, int dontdump)
+{
+    ex_off_t bytes, slab_size;
+    int huge_mode, numa_node, prefault, i;
+    char *huge;
+
+    bytes = tbx_inip_get_integer(fd, section, "arena_bytes", 0);
+    if (bytes <= 0) return(NULL);
+
+    slab_size = tbx_inip_get_integer(fd, section, "arena_slab_size", PAGE_ARENA_2M);
+    numa_node = tbx_inip_get_integer(fd, section, "arena_numa_node", -1);
+    prefault = tbx_inip_get_integer(fd, section, "arena_prefault", 0);
+
+    huge_mode = PAGE_ARENA_HUGE_THP;
+    huge = tbx_inip_get_string(fd, section, "arena_hugepages", _huge_mode_name[huge_mode]);
+    for (i=0; i<=PAGE_ARENA_HUGE_1G; i++) {
+        if (strcasecmp(huge, _huge_mode_name[i]) == 0) break;
+    }
+    if (i > PAGE_ARENA_HUGE_1G) {
+        log_printf(0, "ERROR: Unknown arena_hugepages=%s in section %s.  Using %s\n", huge, section, _huge_mode_name[huge_mode]);
+    } else {
+        huge_mode = i;
+    }
+    free(huge);
+
+    return(page_arena_create(bytes, slab_size, huge_mode, numa_node, prefault, dontdump));
+}
+
+//*************************************************************************
+// page_arena_print_running_config - Prints the arena config options
+//*************************************************************************
+
+void page_arena_print_running_config(lio_page_arena_t *a, FILE *fd)
+{
+    char text[1024];
+
+    if (a == NULL) return;
+
+    fprintf(fd, "arena_bytes = %s\n", tbx_stk_pretty_print_int_with_scale(a->bytes, text));
+    fprintf(fd, "arena_slab_size = %s\n", tbx_stk_pretty_print_int_with_scale(a->slab_size, text));
+    fprintf(fd, "arena_hugepages = %s\n", _huge_mode_name[a->huge_mode]);
+    fprintf(fd, "arena_numa_node = %d\n", a->numa_node);
+    fprintf(fd, "arena_prefault = %d\n", a->prefault);
+}
+
+//*************************************************************************
+// page_arena_info - Dumps the arena usage
+//*************************************************************************
+
+void page_arena_info(lio_page_arena_t *a, FILE *fd)
+{
+    char ppbuf[100];
+    int k;
+
+    if (a == NULL) return;
+
+    apr_thread_mutex_lock(a->lock);
+    fprintf(fd, "Page arena: %s  huge=%s  slabs used: %d/%d  malloc fallbacks: " XOT "\n", tbx_stk_pretty_print_int_with_scale(a->bytes, ppbuf),
+            _huge_mode_name[a->huge_mode], a->next_slab, a->n_slabs, a->fallback_count);
+    for (k=0; k<a->n_class; k++) {
+        fprintf(fd, "    size=%s used=%d free=%d\n", tbx_stk_pretty_print_int_with_scale(a->klass[k].size, ppbuf), a->klass[k].n_used, a->klass[k].n_free);
+    }
+    apr_thread_mutex_unlock(a->lock);
+}
@@ -0,0 +1,81 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************************
+// Preallocated arena for cache page data.  The arena is carved into slabs
+// and each slab holds buffers of a single size.
+//*************************************************************************
+
+#ifndef __CACHE_PAGE_ARENA_H_
+#define __CACHE_PAGE_ARENA_H_
+
+#include <apr_thread_mutex.h>
+#include <lio/ex3_fwd.h>
+#include <stdio.h>
+#include <tbx/iniparse.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PAGE_ARENA_HUGE_NONE 0  //** Normal pages
+#define PAGE_ARENA_HUGE_THP  1  //** Transparent huge pages via madvise()
+#define PAGE_ARENA_HUGE_2M   2  //** Explicit 2MB hugetlb pages
+#define PAGE_ARENA_HUGE_1G   3  //** Explicit 1GB hugetlb pages
+
+typedef struct lio_page_arena_t lio_page_arena_t;
+typedef struct lio_page_arena_class_t lio_page_arena_class_t;
+
+struct lio_page_arena_class_t {
+    ex_off_t size;       //** Buffer size for the class
+    void *free_list;     //** Free buffers are chained through their 1st word
+    int n_free;
+    int n_used;
+};
+
+struct lio_page_arena_t {
+    apr_pool_t *mpool;
+    apr_thread_mutex_t *lock;
+    char *base;
+    ex_off_t bytes;
+    ex_off_t slab_size;
+    int n_slabs;
+    int next_slab;          //** Next never used slab
+    int *slab_class;        //** Class index for each slab or -1 if unused
+    lio_page_arena_class_t *klass;
+    int n_class;
+    int max_class;
+    int huge_mode;          //** What we actually got which may be less than what was requested
+    int numa_node;
+    int prefault;
+    int dontdump;
+    ex_off_t fallback_count; //** Allocations that went to malloc because the arena was full
+};
+
+lio_page_arena_t *page_arena_create(ex_off_t bytes, ex_off_t slab_size, int huge_mode, int numa_node, int prefault, int dontdump);
+lio_page_arena_t *page_arena_load(tbx_inip_file_t *fd, char *section, int dontdump);
+void page_arena_destroy(lio_page_arena_t *a);
+void *page_arena_alloc(lio_page_arena_t *a, ex_off_t size);
+void page_arena_free(lio_page_arena_t *a, void *ptr);
+int page_arena_numa_bind(lio_page_arena_t *a, int node);
+void page_arena_print_running_config(lio_page_arena_t *a, FILE *fd);
+void page_arena_info(lio_page_arena_t *a, FILE *fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
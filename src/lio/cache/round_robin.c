@@ -50,7 +50,7 @@ static cache_rr_t rr_default_options = {
 // rr_get_handle - Does a round robin handleing of the underlying cache structures
 //*************************************************************************
 
-lio_cache_t *rr_get_handle(lio_cache_t *c)
+lio_cache_t *rr_get_handle(lio_cache_t *c, lio_segment_t *seg)
 {
     cache_rr_t *cp = (cache_rr_t *)c->fn.priv;
     int slot = tbx_atomic_inc(cp->count) % cp->n_cache;
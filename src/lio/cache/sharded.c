@@ -0,0 +1,313 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************************
+// Sharded cache.  Segments are hashed onto N independent child AMP caches
+// so each shard has its own lock, LRU, free list and waiters.  The total
+// memory budget is split across the shards and a balancer thread
+// periodically moves budget towards the shards allocating the most pages.
+//*************************************************************************
+
+#define _log_module_index 225
+
+#include <apr_thread_cond.h>
+#include <apr_thread_proc.h>
+#include <apr_time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/apr_wrapper.h>
+#include <tbx/assert_result.h>
+#include <tbx/iniparse.h>
+#include <tbx/log.h>
+#include <tbx/string_token.h>
+#include <tbx/type_malloc.h>
+
+#include "cache.h"
+#include "cache/amp.h"
+#include "ds.h"
+#include "ex3.h"
+#include "service_manager.h"
+#include "sharded.h"
+
+typedef struct {
+    char *section;
+    char *child_section;
+    int n_shards;
+    int balance;                //** Only enabled if the children are AMP caches
+    int numa_nodes;             //** If >0 each shard's page arena is bound to node (shard % numa_nodes)
+    lio_cache_t **child;
+    ex_off_t max_bytes;         //** Total budget across all shards
+    double min_shard_fraction;  //** Each shard always gets at least this fraction of an even split
+    double demand_weight;       //** Weight of the newest interval in the demand EWMA
+    apr_time_t balance_interval;
+    ex_off_t *last_created;
+    double *demand;
+    apr_thread_cond_t *cond;
+    apr_thread_t *balance_thread;
+} cache_sharded_t;
+
+static cache_sharded_t sharded_default_options = {
+    .section = "cache-sharded",
+    .child_section = "cache-amp",
+    .n_shards = 16,
+    .max_bytes = 1024*1024*1024,
+    .min_shard_fraction = 0.25,
+    .demand_weight = 0.5,
+    .balance_interval = apr_time_from_sec(1)
+};
+
+//*************************************************************************
+// sharded_get_handle - Hashes the segment onto a shard
+//*************************************************************************
+
+lio_cache_t *sharded_get_handle(lio_cache_t *c, lio_segment_t *seg)
+{
+    cache_sharded_t *cp = (cache_sharded_t *)c->fn.priv;
+    uint64_t h = segment_id(seg);
+    int slot;
+
+    //** Mix the bits since IDs aren't guaranteed to be uniform in the low bits
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    slot = h % cp->n_shards;
+
+    log_printf(15, "seg=" XIDT " n_shards=%d slot=%d\n", segment_id(seg), cp->n_shards, slot);
+    return(cp->child[slot]);
+}
+
+//*************************************************************************
+// _sharded_balance - Redistributes the memory budget between shards based
+//     on how many bytes each has been allocating recently.
+//*************************************************************************
+
+void _sharded_balance(lio_cache_t *c)
+{
+    cache_sharded_t *cp = (cache_sharded_t *)c->fn.priv;
+    ex_off_t max_bytes, used, created, min_bytes, spare, target;
+    double total_demand, d;
+    int i, n_waiting;
+
+    min_bytes = cp->min_shard_fraction * cp->max_bytes / cp->n_shards;
+    spare = cp->max_bytes - min_bytes * cp->n_shards;
+
+    total_demand = 0;
+    for (i=0; i<cp->n_shards; i++) {
+        amp_cache_usage_get(cp->child[i], &max_bytes, &used, &created, &n_waiting);
+        d = created - cp->last_created[i];
+        cp->last_created[i] = created;
+        if (n_waiting > 0) d += n_waiting * cp->child[i]->default_page_size;  //** Blocked threads are demand too
+
+        cp->demand[i] = (1.0 - cp->demand_weight) * cp->demand[i] + cp->demand_weight * d;
+        total_demand += cp->demand[i];
+    }
+
+    if (total_demand <= 0) return;  //** Everything is idle so leave the split as is
+
+    for (i=0; i<cp->n_shards; i++) {
+        target = min_bytes + spare * (cp->demand[i] / total_demand);
+        log_printf(5, "shard=%d demand=%lf target=" XOT "\n", i, cp->demand[i], target);
+        amp_cache_max_bytes_set(cp->child[i], target);
+    }
+}
+
+//*************************************************************************
+// sharded_balance_thread - Periodically rebalances the shards
+//*************************************************************************
+
+void *sharded_balance_thread(apr_thread_t *th, void *data)
+{
+    lio_cache_t *c = (lio_cache_t *)data;
+    cache_sharded_t *cp = (cache_sharded_t *)c->fn.priv;
+
+    cache_lock(c);
+    while (c->shutdown_request == 0) {
+        apr_thread_cond_timedwait(cp->cond, c->lock, cp->balance_interval);
+        if (c->shutdown_request != 0) break;
+
+        cache_unlock(c);  //** The children have their own locks
+        _sharded_balance(c);
+        cache_lock(c);
+    }
+    cache_unlock(c);
+
+    return(NULL);
+}
+
+//*************************************************************************
+// sharded_print_running_config - Prints the running config
+//*************************************************************************
+
+void sharded_print_running_config(lio_cache_t *c, FILE *fd, int print_section_heading)
+{
+    cache_sharded_t *cp = (cache_sharded_t *)c->fn.priv;
+    char text[1024];
+
+    if (print_section_heading) fprintf(fd, "[%s]\n", cp->section);
+    fprintf(fd, "type = %s\n", CACHE_TYPE_SHARDED);
+    fprintf(fd, "n_shards = %d\n", cp->n_shards);
+    fprintf(fd, "child = %s\n", cp->child_section);
+    fprintf(fd, "max_bytes = %s\n", tbx_stk_pretty_print_int_with_scale(cp->max_bytes, text));
+    fprintf(fd, "min_shard_fraction = %lf\n", cp->min_shard_fraction);
+    fprintf(fd, "demand_weight = %lf\n", cp->demand_weight);
+    fprintf(fd, "balance_interval_ms = %ld\n", (long)apr_time_as_msec(cp->balance_interval));
+    fprintf(fd, "numa_nodes = %d\n", cp->numa_nodes);
+    fprintf(fd, "\n");
+
+    cache_print_running_config(cp->child[0], fd, 1);
+}
+
+//*************************************************************************
+// sharded_cache_destroy - Destroys the cache structure.
+//     NOTE: Data is not flushed!
+//*************************************************************************
+
+int sharded_cache_destroy(lio_cache_t *c)
+{
+    apr_status_t value;
+    int i;
+
+    cache_sharded_t *cp = (cache_sharded_t *)c->fn.priv;
+
+    log_printf(15, "Shutting down\n");
+    tbx_log_flush();
+
+    if (cp->balance_thread) {
+        cache_lock(c);
+        c->shutdown_request = 1;
+        apr_thread_cond_signal(cp->cond);
+        cache_unlock(c);
+        apr_thread_join(&value, cp->balance_thread);
+    }
+
+    for (i=0; i<cp->n_shards; i++) {
+        cache_destroy(cp->child[i]);
+    }
+
+    cache_base_destroy(c);
+
+    if (cp->section) free(cp->section);
+    if (cp->child_section) free(cp->child_section);
+    if (cp->child) free(cp->child);
+    if (cp->last_created) free(cp->last_created);
+    if (cp->demand) free(cp->demand);
+    free(cp);
+    free(c);
+
+    return(0);
+}
+
+//*************************************************************************
+// sharded_cache_create - Creates an empty sharded cache structure
+//*************************************************************************
+
+lio_cache_t *sharded_cache_create(void *arg, data_attr_t *da, int timeout)
+{
+    lio_cache_t *cache;
+    cache_sharded_t *c;
+
+    tbx_type_malloc_clear(cache, lio_cache_t, 1);
+    tbx_type_malloc_clear(c, cache_sharded_t, 1);
+    cache->type = CACHE_TYPE_SHARDED;
+    cache->fn.priv = c;
+
+    cache_base_create(cache, da, timeout);
+
+    cache->fn.destroy = sharded_cache_destroy;
+    cache->fn.get_handle = sharded_get_handle;
+    cache->fn.print_running_config = sharded_print_running_config;
+    c->section = strdup(sharded_default_options.section);
+    c->child_section = strdup(sharded_default_options.child_section);
+    c->n_shards = sharded_default_options.n_shards;
+    c->max_bytes = sharded_default_options.max_bytes;
+    c->min_shard_fraction = sharded_default_options.min_shard_fraction;
+    c->demand_weight = sharded_default_options.demand_weight;
+    c->balance_interval = sharded_default_options.balance_interval;
+
+    return(cache);
+}
+
+
+//*************************************************************************
+// sharded_cache_load - Creates and configures a sharded cache structure
+//*************************************************************************
+
+lio_cache_t *sharded_cache_load(void *arg, tbx_inip_file_t *fd, char *grp, data_attr_t *da, int timeout)
+{
+    lio_cache_t *c;
+    cache_sharded_t *cp;
+    cache_load_t *cache_create;
+    char *ctype, *cs;
+    int i, ms;
+
+    //** Create the default structure
+    c = sharded_cache_create(arg, da, timeout);
+    cp = (cache_sharded_t *)c->fn.priv;
+
+    if (grp != NULL) {
+        free(cp->section);
+        cp->section = strdup(grp);
+    }
+
+    cache_lock(c);
+    cp->n_shards = tbx_inip_get_integer(fd, cp->section, "n_shards", cp->n_shards);
+    if (cp->n_shards < 1) cp->n_shards = 1;
+    cp->max_bytes = tbx_inip_get_integer(fd, cp->section, "max_bytes", cp->max_bytes);
+    cp->min_shard_fraction = tbx_inip_get_double(fd, cp->section, "min_shard_fraction", cp->min_shard_fraction);
+    if (cp->min_shard_fraction > 1) cp->min_shard_fraction = 1;
+    cp->demand_weight = tbx_inip_get_double(fd, cp->section, "demand_weight", cp->demand_weight);
+    ms = tbx_inip_get_integer(fd, cp->section, "balance_interval_ms", apr_time_as_msec(cp->balance_interval));
+    cp->balance_interval = apr_time_from_msec(ms);
+    cp->numa_nodes = tbx_inip_get_integer(fd, cp->section, "numa_nodes", 0);
+    cs = cp->child_section;
+    cp->child_section = tbx_inip_get_string(fd, cp->section, "child", cs);
+    if (cs) free(cs);
+    ctype = tbx_inip_get_string(fd, cp->child_section, "type", NULL);
+    if (ctype == NULL) {
+        log_printf(0, "ERROR: Missing type for child section %s\n", cp->child_section);
+        fprintf(stderr, "ERROR: Missing type for child section %s\n", cp->child_section);
+    }
+    FATAL_UNLESS(ctype != NULL);
+
+    tbx_type_malloc(cp->child, lio_cache_t *, cp->n_shards);
+    tbx_type_malloc_clear(cp->last_created, ex_off_t, cp->n_shards);
+    tbx_type_malloc_clear(cp->demand, double, cp->n_shards);
+    for (i=0; i<cp->n_shards; i++) {
+        cache_create = lio_lookup_service(arg, CACHE_LOAD_AVAILABLE, ctype); FATAL_UNLESS(cache_create != NULL);
+        cp->child[i] = (*cache_create)(arg, fd, cp->child_section, da, timeout); FATAL_UNLESS(cp->child[i] != NULL);
+        if (cp->numa_nodes > 0) page_arena_numa_bind(cp->child[i]->arena, i % cp->numa_nodes);
+    }
+
+    //** The budget is only managed for AMP (and 2Q) children.  Anything else just gets hashed.
+    cp->balance = ((ctype != NULL) && ((strcmp(ctype, CACHE_TYPE_AMP) == 0) || (strcmp(ctype, CACHE_TYPE_2Q) == 0))) ? 1 : 0;
+    if (cp->balance) {
+        for (i=0; i<cp->n_shards; i++) {
+            amp_cache_max_bytes_set(cp->child[i], cp->max_bytes / cp->n_shards);
+        }
+
+        apr_thread_cond_create(&(cp->cond), c->mpool);
+        tbx_thread_create_assert(&(cp->balance_thread), NULL, sharded_balance_thread, (void *)c, c->mpool);
+    } else {
+        log_printf(0, "Child type %s isn't %s.  Shard balancing disabled\n", (ctype) ? ctype : "(null)", CACHE_TYPE_AMP);
+    }
+
+    if (ctype) free(ctype);
+
+    cache_unlock(c);
+
+    return(c);
+}
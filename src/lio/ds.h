@@ -90,6 +90,12 @@ extern "C" {
 #define ds_readv(ds, attr, rcap, n_vec, iov, readfn, boff, len, to) (ds)->readv(ds, attr, rcap, n_vec, iov, readfn, boff, len, to)
 #define ds_writev(ds, attr, wcap, n_vec, iov, writefn, boff, len, to) (ds)->writev(ds, attr, wcap, n_vec, iov, writefn, boff, len, to)
 #define ds_append(ds, attr, wcap, writefn, boff, len, to) (ds)->append(ds, attr, wcap, writefn, boff, len, to)
+#define ds_read_estimate(ds, rcap, len) (ds)->read_estimate(ds, rcap, len)
+#define ds_read_latency(ds, rcap, fraction) (ds)->read_latency(ds, rcap, fraction)
+#define ds_bulk_allocate(ds, res, attr, size, cs, n, to) (ds)->bulk_allocate(ds, res, attr, size, cs, n, to)
+#define ds_bulk_remove(ds, attr, mcap, status, n, to) (ds)->bulk_remove(ds, attr, mcap, status, n, to)
+#define ds_bulk_probe(ds, attr, mcap, p, status, n, to) (ds)->bulk_probe(ds, attr, mcap, p, status, n, to)
+#define ds_bulk_warm(ds, attr, mcap, duration, status, n, to) (ds)->bulk_warm(ds, attr, mcap, duration, status, n, to)
 #define ds_copy(ds, attr, mode, ns_type, ppath, src_cap, src_off, dest_cap, dest_off, len, to) \
               (ds)->copy(ds, attr, mode, ns_type, ppath, src_cap, src_off, dest_cap, dest_off, len, to)
 
@@ -31,6 +31,7 @@
 #include <assert.h>
 #include <gop/gop.h>
 #include <gop/opque.h>
+#include <gop/tp.h>
 #include <gop/types.h>
 #include <ibp/op.h>
 #include <ibp/protocol.h>
@@ -51,7 +52,9 @@
 
 #include "ds.h"
 #include "ds/ibp.h"
+#include "ex3/system.h"
 #include "ex3/types.h"
+#include "service_manager.h"
 
 int _ds_ibp_do_init = 1;
 
@@ -762,6 +765,360 @@ gop_op_generic_t *ds_ibp_probe(lio_data_service_fn_t *dsf, data_attr_t *dattr, d
     return(iop->gop);
 }
 
+//***********************************************************************
+// The bulk ops group the caps by depot RID and send up to IBP_MAX_BULK
+// of them in a single IBP_BULK_* command.  Depots that reject the bulk
+// commands are remembered and get the normal single cap commands instead.
+//***********************************************************************
+
+typedef struct {
+    ibp_cap_t *cap;
+    int plen;       //** Length of the ibp://host:port/RID# prefix
+    int index;
+} ds_ibp_bulk_sort_t;
+
+typedef struct {
+    int start;
+    int n;
+    char *key;      //** Depot key for tracking bulk support
+} ds_ibp_bulk_chunk_t;
+
+//***********************************************************************
+// _ds_ibp_bulk_compare - Sorts the caps by their depot RID prefix
+//***********************************************************************
+
+static int _ds_ibp_bulk_compare(const void *arg1, const void *arg2)
+{
+    const ds_ibp_bulk_sort_t *a = (const ds_ibp_bulk_sort_t *)arg1;
+    const ds_ibp_bulk_sort_t *b = (const ds_ibp_bulk_sort_t *)arg2;
+    int n;
+
+    n = strncmp(a->cap, b->cap, (a->plen < b->plen) ? a->plen : b->plen);
+    if (n != 0) return(n);
+    if (a->plen != b->plen) return(a->plen - b->plen);
+    return(a->index - b->index);
+}
+
+//***********************************************************************
+// _ds_ibp_bulk_key - Returns the depot key, ibp://host:port, for the cap
+//***********************************************************************
+
+char *_ds_ibp_bulk_key(ibp_cap_t *cap, int plen)
+{
+    char *key;
+    int i, nslash;
+
+    nslash = 0;
+    for (i=0; i<plen; i++) {
+        if (cap[i] == '/') {
+            nslash++;
+            if (nslash == 3) break;
+        }
+    }
+
+    tbx_type_malloc(key, char, i+1);
+    memcpy(key, cap, i);
+    key[i] = '\0';
+    return(key);
+}
+
+//***********************************************************************
+// _ds_ibp_bulk_supported - Returns 1 if the depot handles bulk commands
+//***********************************************************************
+
+int _ds_ibp_bulk_supported(lio_ds_ibp_priv_t *ds, char *key)
+{
+    int n;
+
+    apr_thread_mutex_lock(ds->bulk_lock);
+    n = (apr_hash_get(ds->bulk_unsupported, key, APR_HASH_KEY_STRING) == NULL) ? 1 : 0;
+    apr_thread_mutex_unlock(ds->bulk_lock);
+
+    return(n);
+}
+
+//***********************************************************************
+// _ds_ibp_bulk_gop - Makes the IBP op for a chunk or, if n == 1, a single cap
+//***********************************************************************
+
+gop_op_generic_t *_ds_ibp_bulk_gop(lio_ds_ibp_bulk_op_t *op, ibp_capset_t **caps, ibp_cap_t **mcap, ibp_capstatus_t **probe, int *status, int n, int single)
+{
+    lio_ds_ibp_priv_t *ds = op->ds;
+    lio_ds_ibp_attr_t *attr = op->attr;
+    gop_op_generic_t *gop = NULL;
+
+    if (op->cmd == IBP_BULK_ALLOCATE) {
+        if (single) {
+            gop = ibp_alloc_gop(ds->ic, caps[0], op->size, &(op->depot), &(attr->attr), attr->disk_cs_type, attr->disk_cs_blocksize, op->timeout);
+        } else {
+            gop = ibp_bulk_alloc_gop(ds->ic, caps, n, op->size, &(op->depot), &(attr->attr), attr->disk_cs_type, attr->disk_cs_blocksize, op->timeout);
+        }
+    } else if (op->cmd == IBP_PROBE) {
+        gop = (single) ? ibp_probe_gop(ds->ic, mcap[0], probe[0], op->timeout) : ibp_bulk_probe_gop(ds->ic, mcap, n, probe, status, op->timeout);
+    } else if (op->cmd == IBP_CHNG) {
+        gop = (single) ? ibp_modify_alloc_gop(ds->ic, mcap[0], -1, op->duration, -1, op->timeout) : ibp_bulk_modify_duration_gop(ds->ic, mcap, n, op->duration, status, op->timeout);
+    } else {
+        gop = (single) ? ibp_remove_gop(ds->ic, mcap[0], op->timeout) : ibp_bulk_remove_gop(ds->ic, mcap, n, status, op->timeout);
+    }
+
+    if (ibp_cc_type(&(attr->cc)) != NS_TYPE_UNKNOWN) ibp_op_cc_set(gop, &(attr->cc));
+
+    return(gop);
+}
+
+//***********************************************************************
+// _ds_ibp_bulk_single_gop - Makes the single cap op for slot j
+//***********************************************************************
+
+gop_op_generic_t *_ds_ibp_bulk_single_gop(lio_ds_ibp_bulk_op_t *op, int j, ibp_cap_t **mcap, ibp_capstatus_t **probe)
+{
+    gop_op_generic_t *gop;
+
+    gop = _ds_ibp_bulk_gop(op, (op->caps) ? op->caps + j : NULL, mcap + j, probe + j, NULL, 1, 1);
+    gop_set_myid(gop, -(j+1));
+    return(gop);
+}
+
+//***********************************************************************
+// _ds_ibp_bulk_exec - Executes the bulk op and returns the number of failed caps
+//***********************************************************************
+
+int _ds_ibp_bulk_exec(lio_ds_ibp_bulk_op_t *op)
+{
+    lio_ds_ibp_priv_t *ds = op->ds;
+    ds_ibp_bulk_sort_t *srt;
+    ds_ibp_bulk_chunk_t *chunk;
+    ibp_cap_t **mcap;
+    ibp_capstatus_t **probe;
+    int *status;
+    char *p, *key;
+    gop_opque_t *q;
+    gop_op_generic_t *gop;
+    gop_op_status_t gs;
+    int i, j, k, n_chunks, nfailed, id;
+
+    if (op->n <= 0) return(0);
+
+    //** Sort the caps so each depot RID is contiguous.  Allocations are all on the same RID
+    tbx_type_malloc_clear(srt, ds_ibp_bulk_sort_t, op->n);
+    for (i=0; i<op->n; i++) {
+        srt[i].index = i;
+        if (op->cmd == IBP_BULK_ALLOCATE) continue;
+        srt[i].cap = op->mcap[i];
+        p = strchr(op->mcap[i], '#');
+        srt[i].plen = (p == NULL) ? strlen(op->mcap[i]) : p - op->mcap[i] + 1;
+    }
+    if (op->cmd != IBP_BULK_ALLOCATE) qsort(srt, op->n, sizeof(ds_ibp_bulk_sort_t), _ds_ibp_bulk_compare);
+
+    tbx_type_malloc_clear(mcap, ibp_cap_t *, op->n);
+    tbx_type_malloc_clear(probe, ibp_capstatus_t *, op->n);
+    tbx_type_malloc(status, int, op->n);
+    for (i=0; i<op->n; i++) {
+        if (op->mcap) mcap[i] = op->mcap[srt[i].index];
+        if (op->probe) probe[i] = op->probe[srt[i].index];
+        status[i] = IBP_E_GENERIC;
+    }
+
+    //** Split them into chunks
+    tbx_type_malloc_clear(chunk, ds_ibp_bulk_chunk_t, op->n);
+    n_chunks = 0;
+    for (i=0; i<op->n; i = j) {
+        for (j=i+1; (j<op->n) && (j-i < IBP_MAX_BULK); j++) {
+            if (op->cmd == IBP_BULK_ALLOCATE) continue;
+            if ((srt[j].plen != srt[i].plen) || (strncmp(srt[j].cap, srt[i].cap, srt[i].plen) != 0)) break;
+        }
+        chunk[n_chunks].start = i;
+        chunk[n_chunks].n = j - i;
+        if (op->cmd == IBP_BULK_ALLOCATE) {
+            tbx_type_malloc(key, char, strlen(op->depot.host) + 32);
+            sprintf(key, "ibp://%s:%d", op->depot.host, op->depot.port);
+            chunk[n_chunks].key = key;
+        } else {
+            chunk[n_chunks].key = _ds_ibp_bulk_key(srt[i].cap, srt[i].plen);
+        }
+        n_chunks++;
+    }
+
+    //** Submit them.  Chunk ops have id >= 0 and single cap ops use -(slot+1)
+    q = gop_opque_new();
+    opque_start_execution(q);
+    for (i=0; i<n_chunks; i++) {
+        k = chunk[i].start;
+        if ((chunk[i].n > 1) && (_ds_ibp_bulk_supported(ds, chunk[i].key) == 1)) {
+            gop = _ds_ibp_bulk_gop(op, op->caps + k, mcap + k, probe + k, status + k, chunk[i].n, 0);
+            gop_set_myid(gop, i);
+            gop_opque_add(q, gop);
+        } else {
+            for (j=k; j<k+chunk[i].n; j++) {
+                gop_opque_add(q, _ds_ibp_bulk_single_gop(op, j, mcap, probe));
+            }
+        }
+    }
+
+    while ((gop = opque_waitany(q)) != NULL) {
+        id = gop_get_myid(gop);
+        gs = gop_get_status(gop);
+        if (id < 0) {
+            status[-id-1] = (gs.op_status == OP_STATE_SUCCESS) ? IBP_OK : ((gs.error_code != 0) ? gs.error_code : IBP_E_GENERIC);
+        } else if ((gs.op_status != OP_STATE_SUCCESS) && (gs.error_code == IBP_E_UNKNOWN_FUNCTION)) {
+            //** Old depot so remember it and redo the chunk the old way
+            log_printf(5, "Depot doesn't support bulk commands.  depot=%s\n", chunk[id].key);
+            apr_thread_mutex_lock(ds->bulk_lock);
+            if (apr_hash_get(ds->bulk_unsupported, chunk[id].key, APR_HASH_KEY_STRING) == NULL) {
+                apr_hash_set(ds->bulk_unsupported, apr_pstrdup(ds->pool, chunk[id].key), APR_HASH_KEY_STRING, ds);
+            }
+            apr_thread_mutex_unlock(ds->bulk_lock);
+
+            gop_free(gop, OP_DESTROY);
+            gop = NULL;
+            k = chunk[id].start;
+            for (j=k; j<k+chunk[id].n; j++) {
+                gop_opque_add(q, _ds_ibp_bulk_single_gop(op, j, mcap, probe));
+            }
+        } else if ((gs.op_status != OP_STATE_SUCCESS) && (op->cmd == IBP_BULK_ALLOCATE)) {
+            k = chunk[id].start;
+            for (j=k; j<k+chunk[id].n; j++) status[j] = gs.error_code;
+        } else if (op->cmd == IBP_BULK_ALLOCATE) {
+            k = chunk[id].start;
+            for (j=k; j<k+chunk[id].n; j++) status[j] = IBP_OK;
+        }
+
+        if (gop) gop_free(gop, OP_DESTROY);
+    }
+    gop_opque_free(q, OP_DESTROY);
+
+    //** Map the status back
+    nfailed = 0;
+    for (i=0; i<op->n; i++) {
+        if (status[i] != IBP_OK) nfailed++;
+        if (op->status) op->status[srt[i].index] = (status[i] == IBP_OK) ? OP_STATE_SUCCESS : OP_STATE_FAILURE;
+    }
+
+    log_printf(5, "cmd=%d n=%d n_chunks=%d nfailed=%d\n", op->cmd, op->n, n_chunks, nfailed);
+
+    for (i=0; i<n_chunks; i++) free(chunk[i].key);
+    free(chunk);
+    free(status);
+    free(probe);
+    free(mcap);
+    free(srt);
+
+    return(nfailed);
+}
+
+//***********************************************************************
+// _ds_ibp_bulk_fn - Thread pool task for the bulk ops
+//***********************************************************************
+
+gop_op_status_t _ds_ibp_bulk_fn(void *arg, int id)
+{
+    lio_ds_ibp_bulk_op_t *op = (lio_ds_ibp_bulk_op_t *)arg;
+
+    return((_ds_ibp_bulk_exec(op) == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// _ds_ibp_bulk_op_free - Frees a bulk op
+//***********************************************************************
+
+void _ds_ibp_bulk_op_free(void *arg)
+{
+    lio_ds_ibp_bulk_op_t *op = (lio_ds_ibp_bulk_op_t *)arg;
+
+    if (op->caps) free(op->caps);
+    if (op->mcap) free(op->mcap);
+    if (op->probe) free(op->probe);
+    free(op);
+}
+
+//***********************************************************************
+// ds_ibp_bulk_op_create - Creates a bulk op.  The cap and probe arrays are
+//    copied so the caller can release theirs once the op is created.
+//***********************************************************************
+
+lio_ds_ibp_bulk_op_t *ds_ibp_bulk_op_create(lio_data_service_fn_t *dsf, data_attr_t *dattr, int cmd, int n, int *status, int timeout)
+{
+    lio_ds_ibp_priv_t *ds = (lio_ds_ibp_priv_t *)(dsf->priv);
+    lio_ds_ibp_attr_t *attr = (lio_ds_ibp_attr_t *)dattr;
+    lio_ds_ibp_bulk_op_t *op;
+
+    tbx_type_malloc_clear(op, lio_ds_ibp_bulk_op_t, 1);
+    op->ds = ds;
+    op->attr = (attr == NULL) ? &(ds->attr_default) : attr;
+    op->cmd = cmd;
+    op->n = n;
+    op->status = status;
+    op->timeout = timeout;
+
+    return(op);
+}
+
+//***********************************************************************
+// ds_ibp_bulk_allocate - Allocates n caps on the same resource using as
+//    few IBP commands as possible
+//***********************************************************************
+
+gop_op_generic_t *ds_ibp_bulk_allocate(lio_data_service_fn_t *dsf, char *res, data_attr_t *dattr, ds_int_t size, data_cap_set_t **caps, int n, int timeout)
+{
+    lio_ds_ibp_priv_t *ds = (lio_ds_ibp_priv_t *)(dsf->priv);
+    lio_ds_ibp_bulk_op_t *op = ds_ibp_bulk_op_create(dsf, dattr, IBP_BULK_ALLOCATE, n, NULL, timeout);
+
+    res2ibp(res, &(op->depot));
+    op->size = size;
+    tbx_type_malloc(op->caps, ibp_capset_t *, n);
+    memcpy(op->caps, caps, n*sizeof(ibp_capset_t *));
+
+    return(gop_tp_op_new(ds->tpc, NULL, _ds_ibp_bulk_fn, (void *)op, _ds_ibp_bulk_op_free, 1));
+}
+
+//***********************************************************************
+// ds_ibp_bulk_remove - Removes n allocations
+//***********************************************************************
+
+gop_op_generic_t *ds_ibp_bulk_remove(lio_data_service_fn_t *dsf, data_attr_t *dattr, data_cap_t **mcap, int *status, int n, int timeout)
+{
+    lio_ds_ibp_priv_t *ds = (lio_ds_ibp_priv_t *)(dsf->priv);
+    lio_ds_ibp_bulk_op_t *op = ds_ibp_bulk_op_create(dsf, dattr, IBP_DECR, n, status, timeout);
+
+    tbx_type_malloc(op->mcap, ibp_cap_t *, n);
+    memcpy(op->mcap, mcap, n*sizeof(ibp_cap_t *));
+
+    return(gop_tp_op_new(ds->tpc, NULL, _ds_ibp_bulk_fn, (void *)op, _ds_ibp_bulk_op_free, 1));
+}
+
+//***********************************************************************
+// ds_ibp_bulk_probe - Probes n allocations
+//***********************************************************************
+
+gop_op_generic_t *ds_ibp_bulk_probe(lio_data_service_fn_t *dsf, data_attr_t *dattr, data_cap_t **mcap, data_probe_t **probe, int *status, int n, int timeout)
+{
+    lio_ds_ibp_priv_t *ds = (lio_ds_ibp_priv_t *)(dsf->priv);
+    lio_ds_ibp_bulk_op_t *op = ds_ibp_bulk_op_create(dsf, dattr, IBP_PROBE, n, status, timeout);
+
+    tbx_type_malloc(op->mcap, ibp_cap_t *, n);
+    memcpy(op->mcap, mcap, n*sizeof(ibp_cap_t *));
+    tbx_type_malloc(op->probe, ibp_capstatus_t *, n);
+    memcpy(op->probe, probe, n*sizeof(ibp_capstatus_t *));
+
+    return(gop_tp_op_new(ds->tpc, NULL, _ds_ibp_bulk_fn, (void *)op, _ds_ibp_bulk_op_free, 1));
+}
+
+//***********************************************************************
+// ds_ibp_bulk_warm - Extends the duration of n allocations
+//***********************************************************************
+
+gop_op_generic_t *ds_ibp_bulk_warm(lio_data_service_fn_t *dsf, data_attr_t *dattr, data_cap_t **mcap, int duration, int *status, int n, int timeout)
+{
+    lio_ds_ibp_priv_t *ds = (lio_ds_ibp_priv_t *)(dsf->priv);
+    lio_ds_ibp_bulk_op_t *op = ds_ibp_bulk_op_create(dsf, dattr, IBP_CHNG, n, status, timeout);
+
+    tbx_type_malloc(op->mcap, ibp_cap_t *, n);
+    memcpy(op->mcap, mcap, n*sizeof(ibp_cap_t *));
+    op->duration = duration;
+
+    return(gop_tp_op_new(ds->tpc, NULL, _ds_ibp_bulk_fn, (void *)op, _ds_ibp_bulk_op_free, 1));
+}
+
 //***********************************************************************
 // ds_ibp_read - Generates a read operation
 //***********************************************************************
@@ -819,6 +1176,31 @@ gop_op_generic_t *ds_ibp_readv(lio_data_service_fn_t *dsf, data_attr_t *dattr, d
     return(iop->gop);
 }
 
+//***********************************************************************
+// ds_ibp_read_estimate - Returns the estimated time to read len bytes from
+//     the cap including any work already queued for the depot.  Returns 0
+//     if the depot hasn't been used yet.
+//***********************************************************************
+
+apr_time_t ds_ibp_read_estimate(lio_data_service_fn_t *dsf, data_cap_t *rcap, ex_off_t len)
+{
+    lio_ds_ibp_priv_t *ds = (lio_ds_ibp_priv_t *)(dsf->priv);
+
+    return(ibp_rw_estimate(ds->ic, IBP_LOAD, rcap, len));
+}
+
+//***********************************************************************
+// ds_ibp_read_latency - Returns the given latency quantile, ie 0.95, of the
+//     recent commands sent to the cap's depot.  Returns 0 if unknown.
+//***********************************************************************
+
+apr_time_t ds_ibp_read_latency(lio_data_service_fn_t *dsf, data_cap_t *rcap, double fraction)
+{
+    lio_ds_ibp_priv_t *ds = (lio_ds_ibp_priv_t *)(dsf->priv);
+
+    return(ibp_rw_latency(ds->ic, IBP_LOAD, rcap, fraction));
+}
+
 //***********************************************************************
 // ds_ibp_writev - Generates a Vec write operation
 //***********************************************************************
@@ -920,29 +1302,38 @@ void *ds_ibp_warm_thread(apr_thread_t *th, void *data)
     apr_ssize_t hlen;
     apr_hash_index_t *hi;
     ibp_capset_t *w;
-    gop_opque_t *q;
-    int dt, err;
+    lio_ds_ibp_bulk_op_t op;
+    int n, err;
+
+    memset(&op, 0, sizeof(op));
+    op.ds = ds;
+    op.attr = &(ds->attr_default);
+    op.cmd = IBP_CHNG;
+    op.timeout = 60;
 
-    dt = 60;
     max_wait = apr_time_make(ds->warm_interval, 0);
     apr_thread_mutex_lock(ds->lock);
     while (ds->warm_stop == 0) {
         //** Generate all the tasks
         log_printf(10, "Starting auto-warming run\n");
 
-        q = gop_opque_new();
+        //** Collect the caps so they can be warmed a depot RID at a time
+        n = apr_hash_count(ds->warm_table);
+        tbx_type_malloc_clear(op.mcap, ibp_cap_t *, n+1);
+        n = 0;
         for (hi=apr_hash_first(NULL, ds->warm_table); hi != NULL; hi = apr_hash_next(hi)) {
             apr_hash_this(hi, (const void **)&mcap, &hlen, (void **)&w);
-            gop_opque_add(q, ibp_modify_alloc_gop(ds->ic, mcap, -1, ds->warm_duration, -1, dt));
+            op.mcap[n] = mcap;
+            n++;
             log_printf(15, " warming: %s\n", mcap);
-
         }
+        op.n = n;
+        op.duration = ds->warm_duration;
 
-        //** Wait until they all complete
-        err = opque_waitall(q);
-        log_printf(10, "opque_waitall=%d\n", err);
-
-        gop_opque_free(q, OP_DESTROY);  //** Clean up.  Don;t care if we are successfull or not:)
+        //** Don't care if we are successfull or not:)
+        err = _ds_ibp_bulk_exec(&op);
+        log_printf(10, "n=%d nfailed=%d\n", n, err);
+        free(op.mcap);
 
         //** Sleep until the next time or we get an exit request
         apr_thread_cond_timedwait(ds->cond, ds->lock, max_wait);
@@ -972,6 +1363,7 @@ void ds_ibp_destroy(lio_data_service_fn_t *dsf)
 
     //** Now we can clean up
     apr_thread_mutex_destroy(ds->lock);
+    apr_thread_mutex_destroy(ds->bulk_lock);
     apr_thread_cond_destroy(ds->cond);
     apr_pool_destroy(ds->pool);
 
@@ -1080,11 +1472,22 @@ lio_data_service_fn_t *ds_ibp_create(void *arg, tbx_inip_file_t *ifd, char *sect
     dsf->writev = ds_ibp_writev;
     dsf->append = ds_ibp_append;
     dsf->copy = ds_ibp_copy;
+    dsf->read_estimate = ds_ibp_read_estimate;
+    dsf->read_latency = ds_ibp_read_latency;
     dsf->probe = ds_ibp_probe;
     dsf->truncate = ds_ibp_truncate;
+    dsf->bulk_allocate = ds_ibp_bulk_allocate;
+    dsf->bulk_remove = ds_ibp_bulk_remove;
+    dsf->bulk_probe = ds_ibp_bulk_probe;
+    dsf->bulk_warm = ds_ibp_bulk_warm;
+
+    //** The bulk ops run in the thread pool
+    ds->tpc = lio_lookup_service(arg, ESS_RUNNING, ESS_TPC_UNLIMITED); FATAL_UNLESS(ds->tpc != NULL);
 
     //** Launch the warmer
     assert_result(apr_pool_create(&(ds->pool), NULL), APR_SUCCESS);
+    apr_thread_mutex_create(&(ds->bulk_lock), APR_THREAD_MUTEX_DEFAULT, ds->pool);
+    ds->bulk_unsupported = apr_hash_make(ds->pool);
     apr_thread_mutex_create(&(ds->lock), APR_THREAD_MUTEX_DEFAULT, ds->pool);
     apr_thread_cond_create(&(ds->cond), ds->pool);
     ds->warm_table = apr_hash_make(ds->pool);
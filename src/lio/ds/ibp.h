@@ -21,6 +21,7 @@
 #ifndef _DS_IBP_H_
 #define _DS_IBP_H_
 
+#include <gop/tp.h>
 #include <ibp/ibp.h>
 #include <tbx/iniparse.h>
 #include <tbx/network.h>
@@ -73,6 +74,11 @@ struct lio_ds_ibp_priv_t {
     int warm_interval;
     int warm_duration;
     int warm_stop;
+
+    //** Bulk command support
+    gop_thread_pool_context_t *tpc;
+    apr_hash_t *bulk_unsupported;  //** Depots that don't know the bulk commands
+    apr_thread_mutex_t *bulk_lock;
 };
 
 struct lio_ds_ibp_truncate_op_t {
@@ -87,6 +93,21 @@ struct lio_ds_ibp_truncate_op_t {
     ibp_cap_t *mcap;
 };
 
+struct lio_ds_ibp_bulk_op_t {
+    lio_ds_ibp_priv_t *ds;
+    lio_ds_ibp_attr_t *attr;
+    int cmd;                  //** IBP_BULK_ALLOCATE or the IBP_BULK_MANAGE sub command
+    ibp_depot_t depot;        //** IBP_BULK_ALLOCATE only
+    ibp_off_t size;           //** IBP_BULK_ALLOCATE only
+    ibp_capset_t **caps;      //** IBP_BULK_ALLOCATE only
+    ibp_cap_t **mcap;         //** Manage caps for the other commands
+    ibp_capstatus_t **probe;  //** IBP_PROBE only
+    int duration;             //** IBP_CHNG only
+    int *status;              //** Optional per cap OP_STATE_* status
+    int n;
+    int timeout;
+};
+
 struct lio_ds_ibp_op_t {
     void *sf_ptr;
     lio_ds_ibp_attr_t *attr;
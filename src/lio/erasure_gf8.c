@@ -0,0 +1,634 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***************************************************************************
+// erasure_gf8 - Vectorized erasure engine.
+//
+//   GF(2^8) matrix codes use the same primitive polynomial as jerasure's
+//   galois.c (0x11D).  A product c*b is split into two 16 entry nibble
+//   lookups, c*(b&0xF) ^ c*(b>>4 << 4), which map directly onto PSHUFB/TBL.
+//
+//   Bitmatrix codes are done by XORing every source packet for an output
+//   packet in one pass using the raid4_xor() kernels.  This is the same
+//   result jerasure's XOR schedule produces, just without the intermediate
+//   stores.
+//***************************************************************************
+
+#include <jerasure/jerasure.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__)
+#  include <immintrin.h>
+#elif defined(__aarch64__)
+#  include <arm_neon.h>
+#endif
+
+#include "erasure_gf8.h"
+#include "raid4.h"
+
+#define GF8_PRIM_POLY 0x11D
+
+typedef void (*gf8_dotprod_fn_t)(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes);
+
+typedef struct {
+    const char *name;
+    gf8_dotprod_fn_t fn;
+    int (*supported)();
+} gf8_kernel_t;
+
+uint8_t _gf8_log[256];
+uint8_t _gf8_exp[512];
+uint8_t _gf8_mul[256][256];
+uint8_t _gf8_nib[256][32];    //** [c][0..15] = c*x and [c][16..31] = c*(x<<4)
+
+void _gf8_init();
+pthread_once_t _gf8_once = PTHREAD_ONCE_INIT;
+
+//***************************************************************************
+// _gf8_tables_init - Builds the log/exp, full multiply and nibble tables
+//***************************************************************************
+
+void _gf8_tables_init()
+{
+    int i, j, x;
+
+    x = 1;
+    for (i=0; i<255; i++) {
+        _gf8_exp[i] = x;
+        _gf8_exp[i+255] = x;
+        _gf8_log[x] = i;
+        x <<= 1;
+        if (x & 0x100) x ^= GF8_PRIM_POLY;
+    }
+    _gf8_exp[510] = _gf8_exp[0];
+    _gf8_exp[511] = _gf8_exp[1];
+    _gf8_log[0] = 0;
+
+    for (i=0; i<256; i++) {
+        _gf8_mul[0][i] = 0;
+        _gf8_mul[i][0] = 0;
+    }
+    for (i=1; i<256; i++) {
+        for (j=1; j<256; j++) {
+            _gf8_mul[i][j] = _gf8_exp[_gf8_log[i] + _gf8_log[j]];
+        }
+    }
+
+    for (i=0; i<256; i++) {
+        for (j=0; j<16; j++) {
+            _gf8_nib[i][j] = _gf8_mul[i][j];
+            _gf8_nib[i][16+j] = _gf8_mul[i][j<<4];
+        }
+    }
+}
+
+//***************************************************************************
+// gf8_mul - Single GF(2^8) multiply
+//***************************************************************************
+
+uint8_t gf8_mul(uint8_t a, uint8_t b)
+{
+    pthread_once(&_gf8_once, _gf8_init);
+    return(_gf8_mul[a][b]);
+}
+
+//***************************************************************************
+// _gf8_dotprod_tail - Handles the bytes left over after the vector loop
+//***************************************************************************
+
+void _gf8_dotprod_tail(int n_src, const uint8_t *coef, char **src, char *dst, int start, int nbytes)
+{
+    int i, j;
+    uint8_t c;
+
+    for (i=start; i<nbytes; i++) {
+        c = 0;
+        for (j=0; j<n_src; j++) c ^= _gf8_mul[coef[j]][(uint8_t)src[j][i]];
+        dst[i] = c;
+    }
+}
+
+//***************************************************************************
+// _gf8_dotprod_scalar - Portable full table kernel
+//***************************************************************************
+
+void _gf8_dotprod_scalar(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes)
+{
+    _gf8_dotprod_tail(n_src, coef, src, dst, 0, nbytes);
+}
+
+int _gf8_scalar_supported() { return(1); }
+
+#if defined(__x86_64__)
+
+//***************************************************************************
+// _gf8_dotprod_ssse3 - 128-bit PSHUFB kernel
+//***************************************************************************
+
+__attribute__((target("ssse3")))
+void _gf8_dotprod_ssse3(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    __m128i mask, acc, v, tlo[n_src], thi[n_src];
+
+    mask = _mm_set1_epi8(0x0F);
+    for (j=0; j<n_src; j++) {
+        tlo[j] = _mm_loadu_si128((const __m128i *)_gf8_nib[coef[j]]);
+        thi[j] = _mm_loadu_si128((const __m128i *)(_gf8_nib[coef[j]]+16));
+    }
+
+    for (i=0; i+16 <= nbytes; i+=16) {
+        acc = _mm_setzero_si128();
+        for (j=0; j<n_src; j++) {
+            v = _mm_loadu_si128((const __m128i *)(src[j]+i));
+            acc = _mm_xor_si128(acc, _mm_shuffle_epi8(tlo[j], _mm_and_si128(v, mask)));
+            acc = _mm_xor_si128(acc, _mm_shuffle_epi8(thi[j], _mm_and_si128(_mm_srli_epi64(v, 4), mask)));
+        }
+        _mm_storeu_si128((__m128i *)(dst+i), acc);
+    }
+
+    _gf8_dotprod_tail(n_src, coef, src, dst, i, nbytes);
+}
+
+int _gf8_ssse3_supported() { return(__builtin_cpu_supports("ssse3")); }
+
+//***************************************************************************
+// _gf8_dotprod_avx2 - 256-bit VPSHUFB kernel
+//***************************************************************************
+
+__attribute__((target("avx2")))
+void _gf8_dotprod_avx2(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    __m256i mask, a0, a1, v0, v1, tlo[n_src], thi[n_src];
+
+    mask = _mm256_set1_epi8(0x0F);
+    for (j=0; j<n_src; j++) {
+        tlo[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)_gf8_nib[coef[j]]));
+        thi[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(_gf8_nib[coef[j]]+16)));
+    }
+
+    for (i=0; i+64 <= nbytes; i+=64) {
+        a0 = _mm256_setzero_si256();
+        a1 = _mm256_setzero_si256();
+        for (j=0; j<n_src; j++) {
+            v0 = _mm256_loadu_si256((const __m256i *)(src[j]+i));
+            v1 = _mm256_loadu_si256((const __m256i *)(src[j]+i+32));
+            a0 = _mm256_xor_si256(a0, _mm256_shuffle_epi8(tlo[j], _mm256_and_si256(v0, mask)));
+            a1 = _mm256_xor_si256(a1, _mm256_shuffle_epi8(tlo[j], _mm256_and_si256(v1, mask)));
+            a0 = _mm256_xor_si256(a0, _mm256_shuffle_epi8(thi[j], _mm256_and_si256(_mm256_srli_epi64(v0, 4), mask)));
+            a1 = _mm256_xor_si256(a1, _mm256_shuffle_epi8(thi[j], _mm256_and_si256(_mm256_srli_epi64(v1, 4), mask)));
+        }
+        _mm256_storeu_si256((__m256i *)(dst+i), a0);
+        _mm256_storeu_si256((__m256i *)(dst+i+32), a1);
+    }
+
+    _gf8_dotprod_tail(n_src, coef, src, dst, i, nbytes);
+}
+
+int _gf8_avx2_supported() { return(__builtin_cpu_supports("avx2")); }
+
+//***************************************************************************
+// _gf8_dotprod_avx512 - 512-bit VPSHUFB kernel.  Needs AVX512BW for the
+//     byte shuffle.
+//***************************************************************************
+
+__attribute__((target("avx512f,avx512bw")))
+void _gf8_dotprod_avx512(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    __m512i mask, acc, v, tlo[n_src], thi[n_src];
+
+    mask = _mm512_set1_epi8(0x0F);
+    for (j=0; j<n_src; j++) {
+        tlo[j] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)_gf8_nib[coef[j]]));
+        thi[j] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)(_gf8_nib[coef[j]]+16)));
+    }
+
+    for (i=0; i+64 <= nbytes; i+=64) {
+        acc = _mm512_setzero_si512();
+        for (j=0; j<n_src; j++) {
+            v = _mm512_loadu_si512((const void *)(src[j]+i));
+            acc = _mm512_xor_si512(acc, _mm512_shuffle_epi8(tlo[j], _mm512_and_si512(v, mask)));
+            acc = _mm512_xor_si512(acc, _mm512_shuffle_epi8(thi[j], _mm512_and_si512(_mm512_srli_epi64(v, 4), mask)));
+        }
+        _mm512_storeu_si512((void *)(dst+i), acc);
+    }
+
+    _gf8_dotprod_tail(n_src, coef, src, dst, i, nbytes);
+}
+
+int _gf8_avx512_supported() { return(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")); }
+
+#elif defined(__aarch64__)
+
+//***************************************************************************
+// _gf8_dotprod_neon - 128-bit TBL kernel
+//***************************************************************************
+
+void _gf8_dotprod_neon(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    uint8x16_t mask, acc, v, tlo[n_src], thi[n_src];
+
+    mask = vdupq_n_u8(0x0F);
+    for (j=0; j<n_src; j++) {
+        tlo[j] = vld1q_u8(_gf8_nib[coef[j]]);
+        thi[j] = vld1q_u8(_gf8_nib[coef[j]]+16);
+    }
+
+    for (i=0; i+16 <= nbytes; i+=16) {
+        acc = vdupq_n_u8(0);
+        for (j=0; j<n_src; j++) {
+            v = vld1q_u8((const uint8_t *)(src[j]+i));
+            acc = veorq_u8(acc, vqtbl1q_u8(tlo[j], vandq_u8(v, mask)));
+            acc = veorq_u8(acc, vqtbl1q_u8(thi[j], vshrq_n_u8(v, 4)));
+        }
+        vst1q_u8((uint8_t *)(dst+i), acc);
+    }
+
+    _gf8_dotprod_tail(n_src, coef, src, dst, i, nbytes);
+}
+
+int _gf8_neon_supported() { return(1); }
+
+#endif
+
+//** Kernels in order of preference
+gf8_kernel_t _gf8_kernels[] = {
+#if defined(__x86_64__)
+    { "avx512", _gf8_dotprod_avx512, _gf8_avx512_supported },
+    { "avx2", _gf8_dotprod_avx2, _gf8_avx2_supported },
+    { "ssse3", _gf8_dotprod_ssse3, _gf8_ssse3_supported },
+#elif defined(__aarch64__)
+    { "neon", _gf8_dotprod_neon, _gf8_neon_supported },
+#endif
+    { "scalar", _gf8_dotprod_scalar, _gf8_scalar_supported },
+    { NULL, NULL, NULL }
+};
+
+gf8_kernel_t *_gf8_kernel = NULL;
+
+//***************************************************************************
+// _gf8_init - Builds the tables and picks the best kernel the CPU supports
+//***************************************************************************
+
+void _gf8_init()
+{
+    int i;
+
+    _gf8_tables_init();
+
+    for (i=0; _gf8_kernels[i].name != NULL; i++) {
+        if (_gf8_kernels[i].supported()) {
+            _gf8_kernel = &(_gf8_kernels[i]);
+            return;
+        }
+    }
+}
+
+//***************************************************************************
+// gf8_kernel_name - Returns the name of the kernel in use
+//***************************************************************************
+
+const char *gf8_kernel_name()
+{
+    pthread_once(&_gf8_once, _gf8_init);
+    return(_gf8_kernel->name);
+}
+
+//***************************************************************************
+// gf8_kernel_set - Forces a specific kernel.  Returns 0 on success or -1 if
+//     the kernel is unknown or unsupported on this CPU.
+//***************************************************************************
+
+int gf8_kernel_set(const char *name)
+{
+    int i;
+
+    pthread_once(&_gf8_once, _gf8_init);
+
+    for (i=0; _gf8_kernels[i].name != NULL; i++) {
+        if (strcmp(name, _gf8_kernels[i].name) == 0) {
+            if (!_gf8_kernels[i].supported()) return(-1);
+            _gf8_kernel = &(_gf8_kernels[i]);
+            return(0);
+        }
+    }
+
+    return(-1);
+}
+
+//***************************************************************************
+// gf8_dotprod - Stores sum(coef[j]*src[j]) in dst.  dst must not be one
+//     of the sources.
+//***************************************************************************
+
+void gf8_dotprod(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes)
+{
+    pthread_once(&_gf8_once, _gf8_init);
+
+    if (n_src <= 0) {
+        memset(dst, 0, nbytes);
+        return;
+    }
+
+    _gf8_kernel->fn(n_src, coef, src, dst, nbytes);
+}
+
+//***************************************************************************
+// gf8_invert_matrix - Inverts the rows x rows GF(2^8) matrix.  mat is
+//     destroyed.  Returns 0 on success or -1 if the matrix is singular.
+//***************************************************************************
+
+int gf8_invert_matrix(int *mat, int *inv, int rows)
+{
+    int i, j, k, tmp;
+    uint8_t c;
+
+    pthread_once(&_gf8_once, _gf8_init);
+
+    for (i=0; i<rows; i++) {
+        for (j=0; j<rows; j++) inv[i*rows+j] = (i == j) ? 1 : 0;
+    }
+
+    for (i=0; i<rows; i++) {
+        //** Find a pivot and swap it into place
+        if (mat[i*rows+i] == 0) {
+            for (k=i+1; (k<rows) && (mat[k*rows+i] == 0); k++) ;
+            if (k == rows) return(-1);
+            for (j=0; j<rows; j++) {
+                tmp = mat[i*rows+j];  mat[i*rows+j] = mat[k*rows+j];  mat[k*rows+j] = tmp;
+                tmp = inv[i*rows+j];  inv[i*rows+j] = inv[k*rows+j];  inv[k*rows+j] = tmp;
+            }
+        }
+
+        //** Scale the row so the pivot is 1
+        c = mat[i*rows+i];
+        if (c != 1) {
+            c = _gf8_exp[255 - _gf8_log[c]];
+            for (j=0; j<rows; j++) {
+                mat[i*rows+j] = _gf8_mul[c][mat[i*rows+j]];
+                inv[i*rows+j] = _gf8_mul[c][inv[i*rows+j]];
+            }
+        }
+
+        //** Eliminate the column from every other row
+        for (k=0; k<rows; k++) {
+            if ((k == i) || (mat[k*rows+i] == 0)) continue;
+            c = mat[k*rows+i];
+            for (j=0; j<rows; j++) {
+                mat[k*rows+j] ^= _gf8_mul[c][mat[i*rows+j]];
+                inv[k*rows+j] ^= _gf8_mul[c][inv[i*rows+j]];
+            }
+        }
+    }
+
+    return(0);
+}
+
+//***************************************************************************
+// _gf8_erased_map - Converts the -1 terminated erasure list into a flag
+//     array.  Returns the number of erasures or -1 if there are too many.
+//***************************************************************************
+
+int _gf8_erased_map(lio_erasure_plan_t *plan, int *erasures, int *erased)
+{
+    int i, n;
+
+    memset(erased, 0, sizeof(int)*(plan->data_strips+plan->parity_strips));
+    n = 0;
+    for (i=0; erasures[i] != -1; i++) {
+        if (erased[erasures[i]] == 0) n++;
+        erased[erasures[i]] = 1;
+    }
+
+    return((n > plan->parity_strips) ? -1 : n);
+}
+
+//***************************************************************************
+//===========================================================================
+// GF(2^8) matrix codes: reed_sol_van and reed_sol_r6_op with w=8
+//===========================================================================
+//***************************************************************************
+
+void gf8_matrix_encode_block(lio_erasure_plan_t *plan, char **ptr, int block_size)
+{
+    int i, j, k;
+    uint8_t coef[plan->data_strips];
+
+    k = plan->data_strips;
+    for (i=0; i<plan->parity_strips; i++) {
+        for (j=0; j<k; j++) coef[j] = plan->encode_matrix[i*k+j];
+        gf8_dotprod(k, coef, ptr, ptr[k+i], block_size);
+    }
+}
+
+//***************************************************************************
+
+int gf8_matrix_decode_block(lio_erasure_plan_t *plan, char **ptr, int block_size, int *erasures)
+{
+    int i, j, k, m, n, d;
+    int erased[plan->data_strips+plan->parity_strips];
+    int survivor[plan->data_strips];
+    int *mat, *inv;
+    uint8_t coef[plan->data_strips];
+    char *src[plan->data_strips];
+
+    k = plan->data_strips;
+    m = plan->parity_strips;
+    if (_gf8_erased_map(plan, erasures, erased) < 0) return(-1);
+
+    //** Recover any missing data strips
+    for (i=0; (i<k) && (erased[i] == 0); i++) ;
+    if (i < k) {
+        //** Use the first k survivors, data first then parity
+        n = 0;
+        for (i=0; (i<k+m) && (n<k); i++) {
+            if (erased[i] == 0) survivor[n++] = i;
+        }
+        if (n < k) return(-1);
+
+        mat = (int *)malloc(sizeof(int)*k*k*2);
+        if (mat == NULL) return(-1);
+        inv = mat + k*k;
+        for (i=0; i<k; i++) {
+            d = survivor[i];
+            src[i] = ptr[d];
+            for (j=0; j<k; j++) {
+                mat[i*k+j] = (d < k) ? (d == j) : plan->encode_matrix[(d-k)*k+j];
+            }
+        }
+
+        if (gf8_invert_matrix(mat, inv, k) != 0) {
+            free(mat);
+            return(-1);
+        }
+
+        for (i=0; i<k; i++) {
+            if (erased[i] == 0) continue;
+            for (j=0; j<k; j++) coef[j] = inv[i*k+j];
+            gf8_dotprod(k, coef, src, ptr[i], block_size);
+        }
+        free(mat);
+    }
+
+    //** Now regenerate the missing parity
+    for (i=0; i<m; i++) {
+        if (erased[k+i] == 0) continue;
+        for (j=0; j<k; j++) coef[j] = plan->encode_matrix[i*k+j];
+        gf8_dotprod(k, coef, ptr, ptr[k+i], block_size);
+    }
+
+    return(0);
+}
+
+//***************************************************************************
+//===========================================================================
+// Bitmatrix codes: cauchy_orig, cauchy_good, blaum_roth, liberation,
+// and liber8tion.  Any w works here since everything is plain XOR.
+//
+// Each block is a series of w*packet_size chunks.  Packet b of device d in
+// a chunk starts at ptr[d] + offset + b*packet_size.
+//===========================================================================
+//***************************************************************************
+
+//***************************************************************************
+// _gf8_bitmatrix_apply - For each output packet row r in [0, n_rows) sets
+//     dst[r] = XOR of the src packets with a 1 in the matching bitmatrix row.
+//     The bitmatrix has n_cols = n_src*w columns.
+//***************************************************************************
+
+void _gf8_bitmatrix_apply(lio_erasure_plan_t *plan, int *bitmatrix, int n_rows, int *row_dev, int *row_bit,
+                          int n_src, char **src, char **ptr, int block_size)
+{
+    int r, c, n, off, w, ps;
+    int n_cols = n_src*plan->w;
+    char *xsrc[n_cols];
+
+    w = plan->w;
+    ps = plan->packet_size;
+
+    for (off=0; off<block_size; off += w*ps) {
+        for (r=0; r<n_rows; r++) {
+            n = 0;
+            for (c=0; c<n_cols; c++) {
+                if (bitmatrix[r*n_cols + c]) xsrc[n++] = src[c/w] + off + (c%w)*ps;
+            }
+            if (n == 0) {
+                memset(ptr[row_dev[r]] + off + row_bit[r]*ps, 0, ps);
+            } else {
+                raid4_xor(n, xsrc, ptr[row_dev[r]] + off + row_bit[r]*ps, ps);
+            }
+        }
+    }
+}
+
+//***************************************************************************
+
+void gf8_schedule_encode_block(lio_erasure_plan_t *plan, char **ptr, int block_size)
+{
+    int i, k, w, n_rows;
+    int row_dev[plan->parity_strips*plan->w], row_bit[plan->parity_strips*plan->w];
+
+    k = plan->data_strips;
+    w = plan->w;
+    n_rows = plan->parity_strips*w;
+    for (i=0; i<n_rows; i++) {
+        row_dev[i] = k + i/w;
+        row_bit[i] = i%w;
+    }
+
+    _gf8_bitmatrix_apply(plan, plan->encode_bitmatrix, n_rows, row_dev, row_bit, k, ptr, ptr, block_size);
+}
+
+//***************************************************************************
+
+int gf8_bitmatrix_decode_block(lio_erasure_plan_t *plan, char **ptr, int block_size, int *erasures)
+{
+    int i, j, b, k, m, w, n, d, kw, n_rows;
+    int erased[plan->data_strips+plan->parity_strips];
+    int survivor[plan->data_strips];
+    int row_dev[plan->data_strips*plan->w], row_bit[plan->data_strips*plan->w];
+    int *mat, *inv, *dec;
+    char *src[plan->data_strips];
+
+    k = plan->data_strips;
+    m = plan->parity_strips;
+    w = plan->w;
+    kw = k*w;
+    if (_gf8_erased_map(plan, erasures, erased) < 0) return(-1);
+
+    //** Recover any missing data strips
+    for (i=0; (i<k) && (erased[i] == 0); i++) ;
+    if (i < k) {
+        n = 0;
+        for (i=0; (i<k+m) && (n<k); i++) {
+            if (erased[i] == 0) survivor[n++] = i;
+        }
+        if (n < k) return(-1);
+
+        mat = (int *)malloc(sizeof(int)*kw*kw*3);
+        if (mat == NULL) return(-1);
+        inv = mat + kw*kw;
+        dec = inv + kw*kw;
+
+        //** Form the bitmatrix for the survivors and invert it
+        for (i=0; i<k; i++) {
+            d = survivor[i];
+            src[i] = ptr[d];
+            for (b=0; b<w; b++) {
+                for (j=0; j<kw; j++) {
+                    mat[(i*w+b)*kw + j] = (d < k) ? (j == d*w+b) : plan->encode_bitmatrix[((d-k)*w+b)*kw + j];
+                }
+            }
+        }
+
+        if (jerasure_invert_bitmatrix(mat, inv, kw) != 0) {
+            free(mat);
+            return(-1);
+        }
+
+        //** Only keep the rows for the missing data packets
+        n_rows = 0;
+        for (i=0; i<k; i++) {
+            if (erased[i] == 0) continue;
+            for (b=0; b<w; b++) {
+                memcpy(dec + n_rows*kw, inv + (i*w+b)*kw, sizeof(int)*kw);
+                row_dev[n_rows] = i;
+                row_bit[n_rows] = b;
+                n_rows++;
+            }
+        }
+
+        _gf8_bitmatrix_apply(plan, dec, n_rows, row_dev, row_bit, k, src, ptr, block_size);
+        free(mat);
+    }
+
+    //** Now regenerate the missing parity
+    for (i=0; i<m; i++) {
+        if (erased[k+i] == 0) continue;
+        for (b=0; b<w; b++) {
+            row_dev[b] = k+i;
+            row_bit[b] = b;
+        }
+        _gf8_bitmatrix_apply(plan, plan->encode_bitmatrix + i*w*kw, w, row_dev, row_bit, k, ptr, ptr, block_size);
+    }
+
+    return(0);
+}
@@ -0,0 +1,51 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***************************************************************************
+// erasure_gf8 - Vectorized erasure engine.  Matrix codes with w=8 are done
+//    with PSHUFB style GF(2^8) table lookups.  Bitmatrix codes (cauchy,
+//    liberation, etc) run the same XOR schedule as jerasure but fuse all
+//    the XORs into a packet into a single SIMD pass.  The output is byte
+//    for byte identical to jerasure so existing exnodes decode unchanged.
+//***************************************************************************
+
+#ifndef __ERASURE_GF8_H_
+#define __ERASURE_GF8_H_
+
+#include <stdint.h>
+#include <lio/visibility.h>
+#include "erasure_tools.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+LIO_API void gf8_dotprod(int n_src, const uint8_t *coef, char **src, char *dst, int nbytes);
+LIO_API uint8_t gf8_mul(uint8_t a, uint8_t b);
+LIO_API int gf8_invert_matrix(int *mat, int *inv, int rows);
+LIO_API const char *gf8_kernel_name();
+LIO_API int gf8_kernel_set(const char *name);
+
+void gf8_matrix_encode_block(lio_erasure_plan_t *plan, char **ptr, int block_size);
+int gf8_matrix_decode_block(lio_erasure_plan_t *plan, char **ptr, int block_size, int *erasures);
+void gf8_schedule_encode_block(lio_erasure_plan_t *plan, char **ptr, int block_size);
+int gf8_bitmatrix_decode_block(lio_erasure_plan_t *plan, char **ptr, int block_size, int *erasures);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,11 +28,15 @@
 #include <tbx/assert_result.h>
 #include <tbx/log.h>
 
+#include "erasure_gf8.h"
 #include "erasure_tools.h"
 #include "raid4.h"
 
 
 const char *JE_method[N_JE_METHODS] = {"reed_sol_van", "reed_sol_r6_op", "cauchy_orig", "cauchy_good", "blaum_roth", "liberation", "liber8tion", "raid4"};
+const char *ET_engine[N_ET_ENGINES] = {"jerasure", "gf8"};
+
+int _et_default_engine = ET_ENGINE_GF8;
 
 #define BLANK_CHAR '0'
 
@@ -625,6 +629,7 @@ lio_erasure_plan_t *et_new_plan(int method, long long int strip_size,
     plan->encode_matrix = NULL;
     plan->encode_bitmatrix = NULL;
     plan->encode_schedule = NULL;
+    plan->engine = ET_ENGINE_JERASURE;
 
     switch(method) {
     case REED_SOL_R6_OP:
@@ -681,9 +686,83 @@ lio_erasure_plan_t *et_new_plan(int method, long long int strip_size,
         return(NULL);
     }
 
+    et_plan_set_engine(plan, _et_default_engine);
+
     return(plan);
 }
 
+//***************************************************************************
+// et_plan_set_engine - Switches the routines doing the block encode/decode.
+//     Both engines produce identical parity so this can be changed at any
+//     time.  Methods the engine can't handle stay with jerasure.  Returns the
+//     engine actually in use.
+//***************************************************************************
+
+int et_plan_set_engine(lio_erasure_plan_t *plan, int engine)
+{
+    plan->engine = ET_ENGINE_JERASURE;
+
+    switch(plan->method) {
+    case REED_SOL_R6_OP:
+    case REED_SOL_VAN:
+        if ((engine == ET_ENGINE_GF8) && (plan->w == 8)) {
+            plan->encode_block = gf8_matrix_encode_block;
+            plan->decode_block = gf8_matrix_decode_block;
+            plan->engine = ET_ENGINE_GF8;
+        } else {
+            plan->encode_block = (plan->method == REED_SOL_VAN) ? matrix_encode_block : reed_sol_r6_op_encode_block;
+            plan->decode_block = matrix_decode_block;
+        }
+        break;
+    case CAUCHY_ORIG:
+    case CAUCHY_GOOD:
+    case BLAUM_ROTH:
+    case LIBERATION:
+    case LIBER8TION:
+        if (engine == ET_ENGINE_GF8) {
+            plan->encode_block = gf8_schedule_encode_block;
+            plan->decode_block = gf8_bitmatrix_decode_block;
+            plan->engine = ET_ENGINE_GF8;
+        } else {
+            plan->encode_block = schedule_encode_block;
+            plan->decode_block = schedule_decode_block;
+        }
+        break;
+    }
+
+    return(plan->engine);
+}
+
+//***************************************************************************
+// et_engine_type - Determines the engine type for the string or -1
+//***************************************************************************
+
+int et_engine_type(const char *name)
+{
+    int i;
+
+    for (i=0; i<N_ET_ENGINES; i++) {
+        if (strcasecmp(name, ET_engine[i]) == 0) return(i);
+    }
+
+    return(-1);
+}
+
+//***************************************************************************
+// et_engine_default/et_engine_set_default - Engine used for new plans
+//***************************************************************************
+
+int et_engine_default()
+{
+    return(_et_default_engine);
+}
+
+void et_engine_set_default(int engine)
+{
+    if ((engine < 0) || (engine >= N_ET_ENGINES)) return;
+    _et_default_engine = engine;
+}
+
 //***************************************************************************
 // et_destroy_plan - Destroys an erasure plan
 //***************************************************************************
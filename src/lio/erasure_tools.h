@@ -46,6 +46,12 @@ extern int _debug;
 
 extern const char *JE_method[N_JE_METHODS];
 
+#define ET_ENGINE_JERASURE 0   //** Vendored scalar jerasure routines
+#define ET_ENGINE_GF8      1   //** Vectorized engine in erasure_gf8.c
+#define N_ET_ENGINES       2
+
+extern const char *ET_engine[N_ET_ENGINES];
+
 
 struct lio_erasure_plan_t {    //** Contains the erasure parameters
     long long int strip_size;   //** Size of each data strip
@@ -55,6 +61,7 @@ struct lio_erasure_plan_t {    //** Contains the erasure parameters
     int w;                      //** Word size
     int packet_size;            //** Chunk size for operations
     int base_unit;              //** Typically the register size in bytes
+    int engine;                 //** Engine doing the encode/decode_block work
     int *encode_matrix;         //** Encoding Matrix
     int *encode_bitmatrix;      //** Encoding bit Matrix
     int **encode_schedule;      //** Encoding Schedule
@@ -68,9 +75,13 @@ int nearest_prime(int w, int which);
 int et_method_type(char *meth);
 lio_erasure_plan_t *et_new_plan(int method, long long int strip_size,
                             int data_strips, int parity_strips, int w, int packet_size, int base_unit);
-lio_erasure_plan_t *et_generate_plan(long long int file_size, int method,
+LIO_API lio_erasure_plan_t *et_generate_plan(long long int file_size, int method,
                                  int data_strips, int parity_strips, int w, int packet_low, int packet_high);
-void et_destroy_plan(lio_erasure_plan_t *plan);
+LIO_API void et_destroy_plan(lio_erasure_plan_t *plan);
+LIO_API int et_engine_type(const char *name);
+LIO_API int et_engine_default();
+LIO_API void et_engine_set_default(int engine);
+LIO_API int et_plan_set_engine(lio_erasure_plan_t *plan, int engine);
 int et_encode(lio_erasure_plan_t *plan, const char *fname, long long int foffset, const char *pname, long long int poffset, int buffer_size);
 int et_decode(lio_erasure_plan_t *plan, long long int fsize, const char *fname, long long int foffset, const char *pname, long long int poffset, int buffer_size, int *erasures);
 
@@ -30,12 +30,14 @@
 #include "cache/amp.h"
 #include "cache/direct.h"
 #include "cache/round_robin.h"
+#include "cache/sharded.h"
 #include "ds.h"
 #include "ds/ibp.h"
 #include "ex3.h"
 #include "ex3/system.h"
 #include "os.h"
 #include "os/file.h"
+#include "os/kv.h"
 #include "os/remote.h"
 #include "os/timecache.h"
 #include "osaz/fake.h"
@@ -83,6 +85,7 @@ lio_service_manager_t *lio_exnode_service_set_create()
     add_service(ess, DS_SM_AVAILABLE, DS_TYPE_IBP, ds_ibp_create);
 
     add_service(ess, OS_AVAILABLE, OS_TYPE_FILE, object_service_file_create);
+    add_service(ess, OS_AVAILABLE, OS_TYPE_KV, object_service_kv_create);
     add_service(ess, OS_AVAILABLE, OS_TYPE_REMOTE_CLIENT, object_service_remote_client_create);
     add_service(ess, OS_AVAILABLE, OS_TYPE_REMOTE_SERVER, object_service_remote_server_create);
     add_service(ess, OS_AVAILABLE, OS_TYPE_TIMECACHE, object_service_timecache_create);
@@ -93,8 +96,12 @@ lio_service_manager_t *lio_exnode_service_set_create()
 
     add_service(ess, CACHE_LOAD_AVAILABLE, CACHE_TYPE_AMP, amp_cache_load);
     add_service(ess, CACHE_CREATE_AVAILABLE, CACHE_TYPE_AMP, amp_cache_create);
+    add_service(ess, CACHE_LOAD_AVAILABLE, CACHE_TYPE_2Q, amp_2q_cache_load);
+    add_service(ess, CACHE_CREATE_AVAILABLE, CACHE_TYPE_2Q, amp_2q_cache_create);
     add_service(ess, CACHE_LOAD_AVAILABLE, CACHE_TYPE_ROUND_ROBIN, round_robin_cache_load);
     add_service(ess, CACHE_CREATE_AVAILABLE, CACHE_TYPE_ROUND_ROBIN, round_robin_cache_create);
+    add_service(ess, CACHE_LOAD_AVAILABLE, CACHE_TYPE_SHARDED, sharded_cache_load);
+    add_service(ess, CACHE_CREATE_AVAILABLE, CACHE_TYPE_SHARDED, sharded_cache_create);
     add_service(ess, CACHE_LOAD_AVAILABLE, CACHE_TYPE_DIRECT, direct_cache_load);
     add_service(ess, CACHE_CREATE_AVAILABLE, CACHE_TYPE_DIRECT, direct_cache_create);
 
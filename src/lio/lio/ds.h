@@ -75,10 +75,17 @@ typedef gop_op_generic_t *(*lio_ds_readv_fn_t)(lio_data_service_fn_t *, data_att
 typedef gop_op_generic_t *(*lio_ds_writev_fn_t)(lio_data_service_fn_t *, data_attr_t *attr, data_cap_t *wcap, int n_iov, ex_tbx_iovec_t *iov, tbx_tbuf_t *write, ex_off_t boff, ex_off_t len, int timeout);
 typedef gop_op_generic_t *(*lio_ds_append_fn_t)(lio_data_service_fn_t *, data_attr_t *attr, data_cap_t *wcap, tbx_tbuf_t *write, ex_off_t boff, ex_off_t len, int timeout);
 typedef gop_op_generic_t *(*lio_ds_copy_fn_t)(lio_data_service_fn_t *, data_attr_t *attr, int mode, int ns_type, char *ppath, data_cap_t *src_cap, ds_int_t src_off, data_cap_t *dest_cap, ds_int_t dest_off, ds_int_t len, int timeout);
+typedef apr_time_t (*lio_ds_read_estimate_fn_t)(lio_data_service_fn_t *, data_cap_t *rcap, ex_off_t len);
+typedef apr_time_t (*lio_ds_read_latency_fn_t)(lio_data_service_fn_t *, data_cap_t *rcap, double fraction);
+typedef gop_op_generic_t *(*lio_ds_bulk_allocate_fn_t)(lio_data_service_fn_t *, char *res, data_attr_t *attr, ds_int_t size, data_cap_set_t **caps, int n, int timeout);
+typedef gop_op_generic_t *(*lio_ds_bulk_remove_fn_t)(lio_data_service_fn_t *, data_attr_t *dattr, data_cap_t **mcap, int *status, int n, int timeout);
+typedef gop_op_generic_t *(*lio_ds_bulk_probe_fn_t)(lio_data_service_fn_t *, data_attr_t *dattr, data_cap_t **mcap, data_probe_t **probe, int *status, int n, int timeout);
+typedef gop_op_generic_t *(*lio_ds_bulk_warm_fn_t)(lio_data_service_fn_t *, data_attr_t *dattr, data_cap_t **mcap, int duration, int *status, int n, int timeout);
 
 //* FIXME: leaky
 typedef struct lio_ds_ibp_attr_t lio_ds_ibp_attr_t;
 typedef struct lio_ds_ibp_alloc_op_t lio_ds_ibp_alloc_op_t;
+typedef struct lio_ds_ibp_bulk_op_t lio_ds_ibp_bulk_op_t;
 typedef struct lio_ds_ibp_op_t lio_ds_ibp_op_t;
 typedef struct lio_ds_ibp_priv_t lio_ds_ibp_priv_t;
 typedef struct lio_ds_ibp_truncate_op_t lio_ds_ibp_truncate_op_t;
@@ -125,6 +132,12 @@ struct lio_data_service_fn_t {
     lio_ds_writev_fn_t writev;
     lio_ds_append_fn_t append;
     lio_ds_copy_fn_t copy;
+    lio_ds_read_estimate_fn_t read_estimate;
+    lio_ds_read_latency_fn_t read_latency;
+    lio_ds_bulk_allocate_fn_t bulk_allocate;
+    lio_ds_bulk_remove_fn_t bulk_remove;
+    lio_ds_bulk_probe_fn_t bulk_probe;
+    lio_ds_bulk_warm_fn_t bulk_warm;
 };
 
 // Preprocessor functions
@@ -0,0 +1,23 @@
+/*
+ * DO NOT MODIFY version.h! It is autogenerated by CMake from version.h.in
+ */
+#ifndef ACCRE_LSTORE_LIO_VERSION_H
+#define ACCRE_LSTORE_LIO_VERSION_H
+
+/*
+ * Version string from the "distributed" version. E.G. from a tarball. This
+ * version is what is used if CMake can't extract a version from git. It is
+ * set from VERSION in the source base.
+ */
+#define LSTORE_DISTRIBUTION_VERSION "0.5.1"
+
+/*
+ * The CMake-computed version string and its subparts
+ */
+#define LSTORE_VERSION "0.5.1"
+#define LSTORE_VERSION_MAJOR "0"
+#define LSTORE_VERSION_MINOR "5"
+#define LSTORE_VERSION_PATCH "1"
+#define LSTORE_GITVERSION 0
+
+#define ACCRE_LSTORE_LIO_VERSION_H
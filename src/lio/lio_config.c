@@ -52,6 +52,7 @@
 #include "cache/amp.h"
 #include "ds.h"
 #include "ds/ibp.h"
+#include "erasure_tools.h"
 #include "ex3.h"
 #include "ex3/system.h"
 #include "lio.h"
@@ -176,6 +177,7 @@ void lio_print_running_config(FILE *fd, lio_config_t *lio)
     fprintf(fd, "readahead_trigger = %s\n", tbx_stk_pretty_print_int_with_scale(lio->readahead_trigger, text));
     fprintf(fd, "jerase_paranoid = %d\n", lio->jerase_paranoid);
     fprintf(fd, "jerase_max_parity_on_stack = %s\n", tbx_stk_pretty_print_int_with_scale(lio->jerase_max_parity_on_stack, text));
+    fprintf(fd, "jerase_engine = %s\n", ET_engine[et_engine_default()]);
     fprintf(fd, "tpc_unlimited = %d\n", lio->tpc_unlimited_count);
     fprintf(fd, "tpc_max_recursion = %d\n", lio->tpc_max_recursion);
     fprintf(fd, "tpc_cache = %d\n", lio->tpc_cache_count);
@@ -1107,6 +1109,16 @@ lio_config_t *lio_create_nl(tbx_inip_file_t *ifd, char *section, char *user, cha
     add_service(lio->ess, ESS_RUNNING, "jerase_max_parity_on_stack", eval);
     lio->jerase_max_parity_on_stack = *eval;
 
+    //** Erasure engine.  Both produce the same parity so this is purely a speed choice
+    stype = tbx_inip_get_string(lio->ifd, section, "jerase_engine", (char *)ET_engine[et_engine_default()]);
+    n = et_engine_type(stype);
+    if (n < 0) {
+        log_printf(0, "Unknown jerase_engine=%s! Using %s\n", stype, ET_engine[et_engine_default()]);
+    } else {
+        et_engine_set_default(n);
+    }
+    free(stype);
+
     cores = tbx_inip_get_integer(lio->ifd, section, "tpc_unlimited", lio_default_options.tpc_unlimited_count);
     lio->tpc_unlimited_count = cores;
     max_recursion = tbx_inip_get_integer(lio->ifd, section, "tpc_max_recursion", lio_default_options.tpc_max_recursion);
@@ -29,6 +29,8 @@
 #include <apr_thread_mutex.h>
 #include <apr_time.h>
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <gop/gop.h>
 #include <gop/tp.h>
 #include <gop/types.h>
@@ -52,7 +54,9 @@
 #include <tbx/stack.h>
 #include <tbx/transfer_buffer.h>
 #include <tbx/type_malloc.h>
+#include <tbx/varint.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "authn.h"
 #include "authn/fake.h"
@@ -68,6 +72,9 @@ static lio_osfile_priv_t osf_default_options = {
     .internal_lock_size = 200,
     .max_copy = 1024*1024,
     .hardlink_dir_size = 256,
+    .packed_attrs = 0,
+    .packed_max_size = 1024,
+    .packed_fsync = 0,
     .authz_section = NULL,
     .authn_section = NULL,
 };
@@ -117,6 +124,32 @@ typedef struct {
 } osfile_attr_op_t;
 
 
+#define OSF_PACKED_MAGIC "LPA1"
+#define OSF_PACKED_MAGIC_LEN 4
+#define OSF_PACKED_COMPLETE 1   //** Every attribute is listed in the record
+
+#define OSF_PACKED_INLINE 0     //** Value is stored in the record
+#define OSF_PACKED_FILE   1     //** Value is a separate file or symlink in the attribute dir
+#define OSF_PACKED_PINNED 2     //** Target of an attribute symlink so it's always a file, even if it doesn't exist yet
+
+typedef struct {
+    char *key;
+    char *val;
+    int v_size;
+    int kind;
+} osf_packed_entry_t;
+
+typedef struct {
+    char *attr_dir;
+    osf_packed_entry_t *entry;
+    apr_thread_mutex_t *lock;
+    int n;
+    int max;
+    int flags;
+    int exists;
+    int dirty;
+} osf_packed_t;
+
 typedef struct {
     lio_object_service_fn_t *os;
     osfile_fd_t *fd;
@@ -125,6 +158,8 @@ typedef struct {
     apr_pool_t       *mpool;  //** Needa separate pool for making the va_index. Only way to do this since no apr_hash_iter_destroy fn exists
     apr_hash_index_t *va_index;
     lio_os_regex_table_t *regex;
+    osf_packed_t pk;
+    int pk_slot;
     char *key;
     void *value;
     int v_max;
@@ -261,6 +296,8 @@ char *resolve_hardlink(lio_object_service_fn_t *os, char *src_path, int add_pref
 apr_thread_mutex_t *osf_retrieve_lock(lio_object_service_fn_t *os, char *path, int *table_slot);
 int osf_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val);
 int osf_get_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype);
+int osf_set_attr_pk(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val, osf_packed_t *pk);
+int osf_get_attr_pk(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype, osf_packed_t *pk);
 gop_op_generic_t *osfile_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *fd, char *key, void *val, int v_size);
 os_attr_iter_t *osfile_create_attr_iter(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, lio_os_regex_table_t *attr, int v_max);
 void osfile_destroy_attr_iter(os_attr_iter_t *oit);
@@ -275,6 +312,9 @@ void osfile_destroy_object_iter(os_object_iter_t *it);
 gop_op_status_t osf_set_multiple_attr_fn(void *arg, int id);
 int lowlevel_set_attr(lio_object_service_fn_t *os, char *attr_dir, char *attr, void *val, int v_size);
 char *object_attr_dir(lio_object_service_fn_t *os, char *prefix, char *path, int ftype);
+void osf_packed_open(lio_object_service_fn_t *os, char *attr_dir, osf_packed_t *pk, int do_lock);
+int osf_packed_close(lio_object_service_fn_t *os, osf_packed_t *pk);
+int osf_packed_find(osf_packed_t *pk, char *key);
 
 
 //*************************************************************
@@ -1028,6 +1068,7 @@ int va_attr_type_get_attr(lio_os_virtual_attr_t *myva, lio_object_service_fn_t *
     osfile_fd_t *fd = (osfile_fd_t *)ofd;
     lio_osfile_priv_t *osf = (lio_osfile_priv_t *)fd->os->priv;
     lio_os_virtual_attr_t *va;
+    osf_packed_t pk;
     int ftype, bufsize, n;
     char *key;
     char buffer[32];
@@ -1046,6 +1087,12 @@ int va_attr_type_get_attr(lio_os_virtual_attr_t *myva, lio_object_service_fn_t *
         snprintf(fullname, OS_PATH_MAX, "%s/%s", fd->attr_dir, key);
         ftype = lio_os_local_filetype(fullname);
         if (ftype & OS_OBJECT_BROKEN_LINK_FLAG) ftype = ftype ^ OS_OBJECT_BROKEN_LINK_FLAG;
+        if (ftype == 0) {  //** See if it's in the packed record
+            osf_packed_open(os, fd->attr_dir, &pk, 0);
+            n = osf_packed_find(&pk, key);
+            if (n >= 0) ftype = OS_OBJECT_FILE_FLAG;
+            osf_packed_close(os, &pk);
+        }
     }
 
     snprintf(buffer, sizeof(buffer), "%d", ftype);
@@ -1414,6 +1461,655 @@ int osf_is_empty(char *path)
     return(0);
 }
 
+//***********************************************************************
+// Packed attribute records
+//
+//   The small attributes for an object can be kept together in a single
+//   record, FILE_ATTR_PACKED, in the object's attribute directory instead
+//   of a file per key.  Large values and attribute symlinks are still
+//   separate files and are just listed in the record.  If the record is
+//   flagged as complete every attribute is listed so misses don't need to
+//   touch the directory at all.  The record is always written to a temp
+//   file and renamed into place so after a crash it's either the old or
+//   new version.
+//
+//   Layout: magic flags n [klen key kind vlen val]*n adler32
+//     The integers are zigzag encoded and the adler32 is 4 bytes, MSB first.
+//***********************************************************************
+
+//***********************************************************************
+// osf_packed_init - Initializes an empty record for the attribute dir
+//***********************************************************************
+
+void osf_packed_init(osf_packed_t *pk, char *attr_dir)
+{
+    memset(pk, 0, sizeof(osf_packed_t));
+    pk->attr_dir = attr_dir;
+}
+
+//***********************************************************************
+// osf_packed_clear - Frees all the entries
+//***********************************************************************
+
+void osf_packed_clear(osf_packed_t *pk)
+{
+    int i;
+
+    for (i=0; i<pk->n; i++) {
+        free(pk->entry[i].key);
+        if (pk->entry[i].val != NULL) free(pk->entry[i].val);
+    }
+
+    if (pk->entry != NULL) free(pk->entry);
+    pk->entry = NULL;
+    pk->n = pk->max = 0;
+    pk->flags = 0;
+    pk->exists = 0;
+    pk->dirty = 0;
+}
+
+//***********************************************************************
+// osf_packed_find - Returns the slot for the key or -1 if it's not listed
+//***********************************************************************
+
+int osf_packed_find(osf_packed_t *pk, char *key)
+{
+    int i;
+
+    for (i=0; i<pk->n; i++) {
+        if (strcmp(pk->entry[i].key, key) == 0) return(i);
+    }
+
+    return(-1);
+}
+
+//***********************************************************************
+// osf_packed_append - Adds a new entry without checking for duplicates
+//***********************************************************************
+
+void osf_packed_append(osf_packed_t *pk, char *key, int klen, void *val, int v_size, int kind)
+{
+    osf_packed_entry_t *e;
+
+    if (pk->n == pk->max) {
+        pk->max = (pk->max == 0) ? 16 : 2*pk->max;
+        tbx_type_realloc(pk->entry, osf_packed_entry_t, pk->max);
+    }
+
+    e = &(pk->entry[pk->n]);
+    pk->n++;
+    e->key = strndup(key, klen);
+    e->kind = kind;
+    e->v_size = v_size;
+    e->val = NULL;
+    if (v_size > 0) {
+        tbx_type_malloc(e->val, char, v_size);
+        memcpy(e->val, val, v_size);
+    }
+}
+
+//***********************************************************************
+// osf_packed_put - Adds or replaces the key.  The record is only flagged
+//     as dirty if something actually changed.
+//***********************************************************************
+
+void osf_packed_put(osf_packed_t *pk, char *key, void *val, int v_size, int kind)
+{
+    osf_packed_entry_t *e;
+    int i;
+
+    if (v_size < 0) v_size = 0;
+
+    i = osf_packed_find(pk, key);
+    if (i < 0) {
+        osf_packed_append(pk, key, strlen(key), val, v_size, kind);
+        pk->dirty = 1;
+        return;
+    }
+
+    e = &(pk->entry[i]);
+    if ((e->kind == kind) && (e->v_size == v_size) && ((v_size == 0) || (memcmp(e->val, val, v_size) == 0))) return;
+
+    if (e->val != NULL) free(e->val);
+    e->kind = kind;
+    e->v_size = v_size;
+    e->val = NULL;
+    if (v_size > 0) {
+        tbx_type_malloc(e->val, char, v_size);
+        memcpy(e->val, val, v_size);
+    }
+    pk->dirty = 1;
+}
+
+//***********************************************************************
+// osf_packed_del - Removes the entry in the given slot
+//***********************************************************************
+
+void osf_packed_del(osf_packed_t *pk, int slot)
+{
+    free(pk->entry[slot].key);
+    if (pk->entry[slot].val != NULL) free(pk->entry[slot].val);
+
+    pk->n--;
+    if (slot != pk->n) pk->entry[slot] = pk->entry[pk->n];
+    pk->dirty = 1;
+}
+
+//***********************************************************************
+// osf_packed_rename - Renames the entry in the given slot.  Any existing
+//     entry with the new name is dropped.
+//***********************************************************************
+
+void osf_packed_rename(osf_packed_t *pk, int slot, char *key)
+{
+    int i;
+
+    i = osf_packed_find(pk, key);
+    if (i == slot) return;
+    if (i >= 0) {
+        osf_packed_del(pk, i);
+        if (slot == pk->n) slot = i;  //** It was moved into the hole
+    }
+
+    free(pk->entry[slot].key);
+    pk->entry[slot].key = strdup(key);
+    pk->dirty = 1;
+}
+
+//***********************************************************************
+// osf_packed_decode - Parses the record.  Returns 0 on success
+//***********************************************************************
+
+int osf_packed_decode(osf_packed_t *pk, unsigned char *buf, int nbytes)
+{
+    int64_t flags, n, klen, kind, vlen;
+    uint32_t chksum;
+    int i, bpos, used;
+    char *key;
+
+    if (nbytes < OSF_PACKED_MAGIC_LEN + 4) return(1);
+    if (memcmp(buf, OSF_PACKED_MAGIC, OSF_PACKED_MAGIC_LEN) != 0) return(1);
+
+    nbytes -= 4;
+    chksum = ((uint32_t)buf[nbytes] << 24) | ((uint32_t)buf[nbytes+1] << 16) | ((uint32_t)buf[nbytes+2] << 8) | (uint32_t)buf[nbytes+3];
+    if (chksum != (uint32_t)adler32(adler32(0L, Z_NULL, 0), buf, nbytes)) return(1);
+
+    bpos = OSF_PACKED_MAGIC_LEN;
+    used = tbx_zigzag_decode(&(buf[bpos]), nbytes-bpos, &flags);
+    if (used <= 0) return(1);
+    bpos += used;
+    used = tbx_zigzag_decode(&(buf[bpos]), nbytes-bpos, &n);
+    if ((used <= 0) || (n < 0)) return(1);
+    bpos += used;
+
+    for (i=0; i<n; i++) {
+        used = tbx_zigzag_decode(&(buf[bpos]), nbytes-bpos, &klen);
+        if ((used <= 0) || (klen <= 0) || (klen > nbytes-bpos-used)) return(1);
+        bpos += used;
+        key = (char *)&(buf[bpos]);
+        bpos += klen;
+
+        used = tbx_zigzag_decode(&(buf[bpos]), nbytes-bpos, &kind);
+        if ((used <= 0) || (kind < OSF_PACKED_INLINE) || (kind > OSF_PACKED_PINNED)) return(1);
+        bpos += used;
+
+        used = tbx_zigzag_decode(&(buf[bpos]), nbytes-bpos, &vlen);
+        if ((used <= 0) || (vlen < 0) || (vlen > nbytes-bpos-used)) return(1);
+        bpos += used;
+
+        osf_packed_append(pk, key, klen, &(buf[bpos]), vlen, kind);
+        bpos += vlen;
+    }
+
+    if (bpos != nbytes) return(1);
+
+    pk->flags = flags;
+    return(0);
+}
+
+//***********************************************************************
+// osf_packed_encode - Serializes the record and returns the buffer
+//***********************************************************************
+
+unsigned char *osf_packed_encode(osf_packed_t *pk, int *nbytes)
+{
+    unsigned char *buf;
+    uLong chksum;
+    int i, bpos, klen, bufsize;
+
+    bufsize = OSF_PACKED_MAGIC_LEN + 2*10 + 4;
+    for (i=0; i<pk->n; i++) {
+        bufsize += 3*10 + strlen(pk->entry[i].key) + pk->entry[i].v_size;
+    }
+    tbx_type_malloc(buf, unsigned char, bufsize);
+
+    memcpy(buf, OSF_PACKED_MAGIC, OSF_PACKED_MAGIC_LEN);
+    bpos = OSF_PACKED_MAGIC_LEN;
+    bpos += tbx_zigzag_encode(pk->flags, &(buf[bpos]));
+    bpos += tbx_zigzag_encode(pk->n, &(buf[bpos]));
+    for (i=0; i<pk->n; i++) {
+        klen = strlen(pk->entry[i].key);
+        bpos += tbx_zigzag_encode(klen, &(buf[bpos]));
+        memcpy(&(buf[bpos]), pk->entry[i].key, klen);
+        bpos += klen;
+        bpos += tbx_zigzag_encode(pk->entry[i].kind, &(buf[bpos]));
+        bpos += tbx_zigzag_encode(pk->entry[i].v_size, &(buf[bpos]));
+        if (pk->entry[i].v_size > 0) memcpy(&(buf[bpos]), pk->entry[i].val, pk->entry[i].v_size);
+        bpos += pk->entry[i].v_size;
+    }
+
+    chksum = adler32(adler32(0L, Z_NULL, 0), buf, bpos);
+    buf[bpos] = (chksum >> 24) & 0xFF;
+    buf[bpos+1] = (chksum >> 16) & 0xFF;
+    buf[bpos+2] = (chksum >> 8) & 0xFF;
+    buf[bpos+3] = chksum & 0xFF;
+    *nbytes = bpos + 4;
+
+    return(buf);
+}
+
+//***********************************************************************
+// osf_packed_read - Loads the record from disk.  A missing record is just
+//     an empty one.  A corrupt record is logged and treated as missing
+//     so everything falls back to the individual attribute files.
+//***********************************************************************
+
+int osf_packed_read(osf_packed_t *pk)
+{
+    char fname[OS_PATH_MAX];
+    struct stat s;
+    unsigned char *buf;
+    int fd, n, nbytes, err;
+
+    osf_packed_clear(pk);
+
+    snprintf(fname, OS_PATH_MAX, "%s/%s", pk->attr_dir, FILE_ATTR_PACKED);
+    fd = open(fname, O_RDONLY);
+    if (fd == -1) return((errno == ENOENT) ? 0 : 1);
+
+    if ((fstat(fd, &s) != 0) || (s.st_size > INT32_MAX)) {
+        close(fd);
+        log_printf(0, "ERROR: Can't stat packed attribute record! fname=%s\n", fname);
+        return(1);
+    }
+
+    nbytes = s.st_size;
+    tbx_type_malloc(buf, unsigned char, nbytes+1);
+    n = 0;
+    while (n < nbytes) {
+        err = read(fd, &(buf[n]), nbytes-n);
+        if (err <= 0) break;
+        n += err;
+    }
+    close(fd);
+
+    err = 0;
+    if ((n != nbytes) || (osf_packed_decode(pk, buf, nbytes) != 0)) {
+        log_printf(0, "ERROR: Corrupt packed attribute record! Ignoring it. fname=%s nbytes=%d\n", fname, nbytes);
+        osf_packed_clear(pk);
+        err = 1;
+    } else {
+        pk->exists = 1;
+    }
+
+    free(buf);
+    return(err);
+}
+
+//***********************************************************************
+// osf_packed_write_file - Atomically replaces the file in the attribute dir
+//     by writing a hidden temp file and renaming it into place
+//***********************************************************************
+
+int osf_packed_write_file(char *attr_dir, char *name, void *val, int v_size, int do_sync)
+{
+    static tbx_atomic_int_t tmp_count = 0;
+    char fname[OS_PATH_MAX];
+    char tname[OS_PATH_MAX];
+    char *buf = (char *)val;
+    int fd, n, err;
+
+    snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, name);
+    snprintf(tname, OS_PATH_MAX, "%s/%s.%d." I64T, attr_dir, FILE_ATTR_PACKED, getpid(), (int64_t)tbx_atomic_inc(tmp_count));
+
+    fd = open(tname, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
+    if (fd == -1) {
+        log_printf(0, "ERROR: Can't create temp file! fname=%s errno=%d\n", tname, errno);
+        return(1);
+    }
+
+    n = 0;
+    while (n < v_size) {
+        err = write(fd, &(buf[n]), v_size-n);
+        if (err <= 0) break;
+        n += err;
+    }
+
+    err = (n == v_size) ? 0 : 1;
+    if ((err == 0) && (do_sync == 1)) err = fsync(fd);
+    if (close(fd) != 0) err = 1;
+    if (err == 0) err = rename(tname, fname);
+
+    if (err != 0) {
+        log_printf(0, "ERROR: Failed storing fname=%s errno=%d\n", fname, errno);
+        unlink(tname);
+    }
+
+    return(err);
+}
+
+//***********************************************************************
+// osf_packed_write - Stores the record if it's been changed
+//***********************************************************************
+
+int osf_packed_write(osf_packed_t *pk, int do_sync)
+{
+    unsigned char *buf;
+    int nbytes, err;
+
+    if (pk->dirty == 0) return(0);
+
+    buf = osf_packed_encode(pk, &nbytes);
+    err = osf_packed_write_file(pk->attr_dir, FILE_ATTR_PACKED, buf, nbytes, do_sync);
+    free(buf);
+
+    if (err == 0) {
+        pk->dirty = 0;
+        pk->exists = 1;
+    }
+
+    return(err);
+}
+
+//***********************************************************************
+// osf_packed_open - Loads the record for the attribute dir.  If it's going
+//     to be modified do_lock should be set.  This locks the record based
+//     on the dir's inode so all the hardlinks of an object share the lock.
+//***********************************************************************
+
+void osf_packed_open(lio_object_service_fn_t *os, char *attr_dir, osf_packed_t *pk, int do_lock)
+{
+    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
+    struct stat s;
+    int slot;
+
+    osf_packed_init(pk, attr_dir);
+
+    if (do_lock == 1) {
+        slot = 0;
+        if (stat(attr_dir, &s) == 0) slot = s.st_ino % osf->internal_lock_size;
+        pk->lock = osf->packed_lock[slot];
+        apr_thread_mutex_lock(pk->lock);
+    }
+
+    osf_packed_read(pk);
+}
+
+//***********************************************************************
+// osf_packed_flush - Stores any pending changes to a locked record
+//***********************************************************************
+
+int osf_packed_flush(lio_object_service_fn_t *os, osf_packed_t *pk)
+{
+    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
+
+    if (pk->lock == NULL) return(0);
+    return(osf_packed_write(pk, osf->packed_fsync));
+}
+
+//***********************************************************************
+// osf_packed_close - Stores any changes, releases the lock, and frees the record
+//***********************************************************************
+
+int osf_packed_close(lio_object_service_fn_t *os, osf_packed_t *pk)
+{
+    int err;
+
+    err = osf_packed_flush(os, pk);
+    if (pk->lock != NULL) apr_thread_mutex_unlock(pk->lock);
+    osf_packed_clear(pk);
+
+    return(err);
+}
+
+//***********************************************************************
+// osf_packed_value - Returns the packed value using the same size semantics
+//     as reading the attribute file directly
+//***********************************************************************
+
+int osf_packed_value(osf_packed_entry_t *e, void **val, int *v_size)
+{
+    int n, bsize;
+    char *ca;
+
+    if (*v_size < 0) {
+        if (e->v_size < 1) {
+            *v_size = 0;
+            *val = NULL;
+            return(0);
+        }
+        n = (e->v_size > -*v_size) ? -*v_size : e->v_size;
+        bsize = n + 1;
+        *val = malloc(bsize);
+    } else {
+        bsize = *v_size;
+        n = (e->v_size > *v_size) ? *v_size : e->v_size;
+    }
+
+    if (n > 0) memcpy(*val, e->val, n);
+    if (bsize > n) {
+        ca = (char *)(*val);  //** Add a NULL terminator in case it may be a string
+        ca[n] = 0;
+    }
+    *v_size = n;
+
+    return(0);
+}
+
+//***********************************************************************
+// osf_packed_spill - Moves an inline value out to its own attribute file.
+//     Used when a value outgrows the record or it's the target of an
+//     attribute symlink.
+//***********************************************************************
+
+int osf_packed_spill(lio_object_service_fn_t *os, osf_packed_t *pk, int slot)
+{
+    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
+    osf_packed_entry_t *e = &(pk->entry[slot]);
+
+    if (osf_packed_write_file(pk->attr_dir, e->key, e->val, e->v_size, osf->packed_fsync) != 0) return(1);
+
+    if (e->val != NULL) free(e->val);
+    e->val = NULL;
+    e->v_size = 0;
+    e->kind = OSF_PACKED_FILE;
+    pk->dirty = 1;
+
+    return(0);
+}
+
+//***********************************************************************
+// osf_packed_unpin - Makes sure the attribute isn't packed so it can be
+//     the target of an attribute symlink.  The key is pinned in the record
+//     so it stays a file if it's later removed and set again.  The source
+//     path is resolved relative to the object getting the link like
+//     osf_resolve_attr_path().
+//***********************************************************************
+
+void osf_packed_unpin(lio_object_service_fn_t *os, osfile_fd_t *fd, char *src_path, char *key)
+{
+    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
+    osf_packed_t pk;
+    char fullname[OS_PATH_MAX];
+    char *attr, *pdir, *pfile;
+    int slot, ftype;
+
+    if (src_path[0] == '/') {
+        snprintf(fullname, OS_PATH_MAX, "%s%s", osf->file_path, src_path);
+    } else if ((fd->ftype & OS_OBJECT_DIR_FLAG) && ((fd->ftype & OS_OBJECT_SYMLINK_FLAG) == 0)) {
+        snprintf(fullname, OS_PATH_MAX, "%s%s/%s", osf->file_path, fd->object_name, src_path);
+    } else {
+        lio_os_path_split(fd->object_name, &pdir, &pfile);
+        snprintf(fullname, OS_PATH_MAX, "%s%s/%s", osf->file_path, pdir, src_path);
+        free(pdir);
+        free(pfile);
+    }
+
+    ftype = lio_os_local_filetype(fullname);
+    if (ftype == 0) return;
+    attr = object_attr_dir(os, "", fullname, ftype);
+    if (attr == NULL) return;
+
+    osf_packed_open(os, attr, &pk, 1);
+    if ((pk.exists == 1) || (osf->packed_attrs == 1)) {  //** Without a record nothing gets packed unless packing is enabled
+        slot = osf_packed_find(&pk, key);
+        if ((slot >= 0) && (pk.entry[slot].kind == OSF_PACKED_INLINE)) osf_packed_spill(os, &pk, slot);
+        osf_packed_put(&pk, key, NULL, 0, OSF_PACKED_PINNED);
+    }
+    osf_packed_close(os, &pk);
+
+    free(attr);
+}
+
+//***********************************************************************
+// osf_packed_init_dir - Stores an empty, complete, record for a new object
+//***********************************************************************
+
+int osf_packed_init_dir(lio_object_service_fn_t *os, char *attr_dir)
+{
+    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
+    osf_packed_t pk;
+    int err;
+
+    osf_packed_init(&pk, attr_dir);
+    pk.flags = OSF_PACKED_COMPLETE;
+    pk.dirty = 1;
+    err = osf_packed_write(&pk, osf->packed_fsync);
+    osf_packed_clear(&pk);
+
+    return(err);
+}
+
+//***********************************************************************
+// osf_packed_dir - Converts an attribute dir to/from a packed record.
+//     When packing, regular files up to max_size bytes are moved into the
+//     record and everything else is listed so the record is complete.
+//     Files in the pinned hash, keyed by full path, are the targets of
+//     attribute symlinks and are left alone.  The record is stored before
+//     the files are removed and vice versa when unpacking so a crash only
+//     leaves duplicate copies behind.  No locking is done so this should
+//     only be used on a quiescent namespace.
+//     Returns the number of attributes converted or -1 on error.
+//***********************************************************************
+
+int osf_packed_dir(char *attr_dir, int max_size, int unpack, int do_sync, apr_hash_t *pinned)
+{
+    osf_packed_t pk;
+    DIR *d;
+    struct dirent *entry;
+    struct stat s;
+    tbx_stack_t *moved;
+    char fname[OS_PATH_MAX];
+    char *buf;
+    int i, fd, n, err, count, is_pinned;
+
+    osf_packed_init(&pk, attr_dir);
+    if (osf_packed_read(&pk) != 0) return(-1);
+
+    count = 0;
+    err = 0;
+
+    if (unpack == 1) {
+        if (pk.exists == 0) return(0);
+
+        for (i=0; i<pk.n; i++) {
+            if (pk.entry[i].kind != OSF_PACKED_INLINE) continue;
+            if (osf_packed_write_file(attr_dir, pk.entry[i].key, pk.entry[i].val, pk.entry[i].v_size, do_sync) != 0) {
+                err = 1;
+                break;
+            }
+            count++;
+        }
+
+        if (err == 0) {
+            snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, FILE_ATTR_PACKED);
+            err = unlink(fname);
+        }
+        osf_packed_clear(&pk);
+        return((err == 0) ? count : -1);
+    }
+
+    d = opendir(attr_dir);
+    if (d == NULL) {
+        osf_packed_clear(&pk);
+        return(-1);
+    }
+
+    //** The FILE entries are rebuilt from the directory
+    for (i=pk.n-1; i>=0; i--) {
+        if (pk.entry[i].kind == OSF_PACKED_FILE) osf_packed_del(&pk, i);
+    }
+
+    moved = tbx_stack_new();
+    while ((entry = readdir(d)) != NULL) {
+        if ((strncmp(entry->d_name, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX_LEN) == 0) ||
+                (strncmp(entry->d_name, FILE_ATTR_PACKED, FILE_ATTR_PACKED_LEN) == 0) ||
+                (strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) continue;
+
+        snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, entry->d_name);
+        if (lstat(fname, &s) != 0) continue;
+
+        i = osf_packed_find(&pk, entry->d_name);
+        if ((i >= 0) && (pk.entry[i].kind == OSF_PACKED_INLINE)) {  //** Left over from an interrupted run
+            tbx_stack_push(moved, strdup(fname));
+            continue;
+        }
+
+        is_pinned = ((i >= 0) && (pk.entry[i].kind == OSF_PACKED_PINNED)) ? 1 : 0;
+        if ((pinned != NULL) && (apr_hash_get(pinned, fname, APR_HASH_KEY_STRING) != NULL)) is_pinned = 1;
+        if (S_ISREG(s.st_mode) && (s.st_size <= max_size) && (is_pinned == 0)) {
+            fd = open(fname, O_RDONLY);
+            if (fd == -1) {
+                err = 1;
+                break;
+            }
+            tbx_type_malloc(buf, char, s.st_size + 1);
+            n = (s.st_size > 0) ? read(fd, buf, s.st_size) : 0;
+            close(fd);
+            if (n != s.st_size) {
+                free(buf);
+                err = 1;
+                break;
+            }
+            osf_packed_put(&pk, entry->d_name, buf, n, OSF_PACKED_INLINE);
+            free(buf);
+            tbx_stack_push(moved, strdup(fname));
+            count++;
+        } else {
+            osf_packed_put(&pk, entry->d_name, NULL, 0, ((is_pinned == 1) ? OSF_PACKED_PINNED : OSF_PACKED_FILE));
+        }
+    }
+    closedir(d);
+
+    if (err == 0) {
+        if (pk.flags != OSF_PACKED_COMPLETE) {
+            pk.flags = OSF_PACKED_COMPLETE;
+            pk.dirty = 1;
+        }
+        err = osf_packed_write(&pk, do_sync);
+    }
+
+    //** Only remove the old files once the record is safely stored
+    while ((buf = tbx_stack_pop(moved)) != NULL) {
+        if (err == 0) unlink(buf);
+        free(buf);
+    }
+    tbx_stack_free(moved, 0);
+    osf_packed_clear(&pk);
+
+    return((err == 0) ? count : -1);
+}
+
 //***********************************************************************
 
 char *my_readdir(osf_dir_t *d)
@@ -2167,6 +2863,7 @@ gop_op_status_t osfile_create_object_fn(void *arg, int id)
             free(dir);
             free(base);
         }
+        if (osf->packed_attrs == 1) osf_packed_init_dir(op->os, fattr);
     } else {  //** Directory object
         err = mkdir(fname, DIR_PERMS);
         if (err != 0) {
@@ -2183,6 +2880,7 @@ gop_op_status_t osfile_create_object_fn(void *arg, int id)
             osf_obj_unlock(lock);
             return(gop_failure_status);
         }
+        if (osf->packed_attrs == 1) osf_packed_init_dir(op->os, fattr);
     }
 
     osf_obj_unlock(lock);
@@ -2656,10 +3354,11 @@ gop_op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
     lio_osfile_priv_t *osf = (lio_osfile_priv_t *)op->os->priv;
     gop_op_status_t status;
     apr_thread_mutex_t *lock_src, *lock_dest;
+    osf_packed_t pk;
     void *val;
     int v_size;
     int slot_src, slot_dest;
-    int i, err, atype;
+    int i, err, atype, same_dir;
 
     //** Lock the individual objects based on their slot positions to avoid a deadlock
     lock_src = osf_retrieve_lock(op->os, op->fd_src->object_name, &slot_src);
@@ -2675,6 +3374,9 @@ gop_op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
         osf_obj_lock(lock_src);
     }
 
+    //** If the source shares the destination's attribute dir it has to see the pending changes
+    osf_packed_open(op->os, op->fd_dest->attr_dir, &pk, 1);
+    same_dir = (strcmp(op->fd_src->attr_dir, op->fd_dest->attr_dir) == 0) ? 1 : 0;
 
     status = gop_success_status;
     for (i=0; i<op->n; i++) {
@@ -2684,9 +3386,9 @@ gop_op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
 
             v_size = -osf->max_copy;
             val = NULL;
-            err = osf_get_attr(op->os, op->creds, op->fd_src, op->key_src[i], &val, &v_size, &atype);
+            err = osf_get_attr_pk(op->os, op->creds, op->fd_src, op->key_src[i], &val, &v_size, &atype, ((same_dir == 1) ? &pk : NULL));
             if (err == 0) {
-                err = osf_set_attr(op->os, op->creds, op->fd_dest, op->key_dest[i], val, v_size, &atype, 0);
+                err = osf_set_attr_pk(op->os, op->creds, op->fd_dest, op->key_dest[i], val, v_size, &atype, 0, &pk);
                 free(val);
                 if (err != 0) {
                     status.op_status = OP_STATE_FAILURE;
@@ -2702,6 +3404,11 @@ gop_op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
         }
     }
 
+    if (osf_packed_close(op->os, &pk) != 0) {
+        status.op_status = OP_STATE_FAILURE;
+        status.error_code++;
+    }
+
     osf_obj_unlock(lock_src);
     if (lock_dest != NULL) osf_obj_unlock(lock_dest);
 
@@ -2766,14 +3473,22 @@ gop_op_status_t osfile_symlink_multiple_attrs_fn(void *arg, int id)
     lio_osfile_priv_t *osf = (lio_osfile_priv_t *)op->os->priv;
     gop_op_status_t status;
     apr_thread_mutex_t *lock_dest;
+    osf_packed_t pk;
     char sfname[OS_PATH_MAX];
     char dfname[OS_PATH_MAX];
-    int slot_dest;
+    int slot_dest, slot;
     int i, err;
 
+    //** Make sure all the targets are real files.  This is done before locking
+    //** the destination since it touches the other objects' packed records
+    for (i=0; i<op->n; i++) {
+        osf_packed_unpin(op->os, op->fd_dest, op->src_path[i], op->key_src[i]);
+    }
+
     //** Lock the source
     lock_dest = osf_retrieve_lock(op->os, op->fd_dest->object_name, &slot_dest);
     osf_obj_lock(lock_dest);
+    osf_packed_open(op->os, op->fd_dest->attr_dir, &pk, 1);
 
     log_printf(15, " fsrc[0]=%s fdest=%s (lock=%d)   n=%d key_src[0]=%s key_dest[0]=%s\n", op->src_path[0], op->fd_dest->object_name, slot_dest, op->n, op->key_src[0], op->key_dest[0]);
 
@@ -2786,11 +3501,15 @@ gop_op_status_t osfile_symlink_multiple_attrs_fn(void *arg, int id)
 
             log_printf(15, "sfname=%s dfname=%s\n", sfname, dfname);
 
-            err = symlink(sfname, dfname);
+            slot = osf_packed_find(&pk, op->key_dest[i]);
+            err = ((slot >= 0) && (pk.entry[slot].kind == OSF_PACKED_INLINE)) ? 1 : 0;  //** Packed key already exists
+            if (err == 0) err = symlink(sfname, dfname);
             if (err != 0) {
                 log_printf(15, "Failed making symlink %s -> %s  err=%d\n", sfname, dfname, err);
                 status.op_status = OP_STATE_FAILURE;
                 status.error_code++;
+            } else if ((slot < 0) && (pk.flags & OSF_PACKED_COMPLETE)) {
+                osf_packed_put(&pk, op->key_dest[i], NULL, 0, OSF_PACKED_FILE);
             }
 
         } else {
@@ -2799,6 +3518,10 @@ gop_op_status_t osfile_symlink_multiple_attrs_fn(void *arg, int id)
         }
     }
 
+    if (osf_packed_close(op->os, &pk) != 0) {
+        status.op_status = OP_STATE_FAILURE;
+        status.error_code++;
+    }
     osf_obj_unlock(lock_dest);
 
     log_printf(15, "fsrc[0]=%s fdest=%s err=%d\n", op->src_path[0], op->fd_dest->object_name, status.error_code);
@@ -2865,12 +3588,14 @@ gop_op_status_t osfile_move_multiple_attrs_fn(void *arg, int id)
     lio_os_virtual_attr_t *va1, *va2;
     gop_op_status_t status;
     apr_thread_mutex_t *lock;
-    int i, err;
+    osf_packed_t pk;
+    int i, err, slot, dslot;
     char sfname[OS_PATH_MAX];
     char dfname[OS_PATH_MAX];
 
     lock = osf_retrieve_lock(op->os, op->fd->object_name, NULL);
     osf_obj_lock(lock);
+    osf_packed_open(op->os, op->fd->attr_dir, &pk, 1);
 
     status = gop_success_status;
     for (i=0; i<op->n; i++) {
@@ -2885,7 +3610,26 @@ gop_op_status_t osfile_move_multiple_attrs_fn(void *arg, int id)
             } else {
                 snprintf(sfname, OS_PATH_MAX, "%s/%s", op->fd->attr_dir, op->key_old[i]);
                 snprintf(dfname, OS_PATH_MAX, "%s/%s", op->fd->attr_dir, op->key_new[i]);
-                err = rename(sfname, dfname);
+                slot = osf_packed_find(&pk, op->key_old[i]);
+                dslot = osf_packed_find(&pk, op->key_new[i]);
+                if ((slot >= 0) && (pk.entry[slot].kind == OSF_PACKED_INLINE)) {
+                    if ((dslot >= 0) && (pk.entry[dslot].kind == OSF_PACKED_PINNED)) {  //** A link points at the new name so store it as a file
+                        err = osf_packed_write_file(op->fd->attr_dir, op->key_new[i], pk.entry[slot].val, pk.entry[slot].v_size, osf->packed_fsync);
+                        if (err == 0) osf_packed_del(&pk, slot);
+                    } else {  //** Just rename the packed entry
+                        safe_remove(op->os, dfname);  //** Replaces any existing attribute file
+                        osf_packed_rename(&pk, slot, op->key_new[i]);
+                        err = 0;
+                    }
+                } else {
+                    err = rename(sfname, dfname);
+                    if (err == 0) {
+                        if ((slot >= 0) && (pk.entry[slot].kind == OSF_PACKED_FILE)) osf_packed_del(&pk, slot);  //** A pin stays with the old name
+                        dslot = osf_packed_find(&pk, op->key_new[i]);
+                        if ((dslot >= 0) && (pk.entry[dslot].kind == OSF_PACKED_INLINE)) osf_packed_del(&pk, dslot);  //** The file replaced it
+                        if ((pk.flags & OSF_PACKED_COMPLETE) && (osf_packed_find(&pk, op->key_new[i]) < 0)) osf_packed_put(&pk, op->key_new[i], NULL, 0, OSF_PACKED_FILE);
+                    }
+                }
             }
 
             if (err != 0) {
@@ -2898,6 +3642,10 @@ gop_op_status_t osfile_move_multiple_attrs_fn(void *arg, int id)
         }
     }
 
+    if (osf_packed_close(op->os, &pk) != 0) {
+        status.op_status = OP_STATE_FAILURE;
+        status.error_code++;
+    }
     osf_obj_unlock(lock);
 
     return(status);
@@ -2948,44 +3696,31 @@ gop_op_generic_t *osfile_move_attr(lio_object_service_fn_t *os, lio_creds_t *cre
 }
 
 //***********************************************************************
-// osf_get_attr - Gets the attribute given the name and base directory
+// osf_get_real_attr - Gets a normal, non-virtual, attribute.  The packed
+//     record is checked first and then the attribute files.
 //***********************************************************************
 
-int osf_get_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype)
+int osf_get_real_attr(lio_object_service_fn_t *os, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype, osf_packed_t *pk)
 {
-    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
-    lio_os_virtual_attr_t *va;
-    tbx_list_iter_t it;
     char *ca;
     FILE *fd;
     char fname[OS_PATH_MAX];
     int n, bsize;
 
-    if (osaz_attr_access(osf->osaz, creds, ofd->object_name, attr, OS_MODE_READ_BLOCKING) == 0) {
+    n = osf_packed_find(pk, attr);
+    if (n >= 0) {
+        if (pk->entry[n].kind == OSF_PACKED_INLINE) {
+            *atype = OS_OBJECT_FILE_FLAG;
+            return(osf_packed_value(&(pk->entry[n]), val, v_size));
+        }
+    } else if (pk->flags & OSF_PACKED_COMPLETE) {  //** Not listed so it doesn't exist
         *atype = 0;
+        if (*v_size < 0) *val = NULL;
+        *v_size = -1;
         return(1);
     }
 
-    //** Do a Virtual Attr check
-    //** Check the prefix VA's first
-    it = tbx_list_iter_search(osf->vattr_prefix, attr, -1);
-    tbx_list_next(&it, (tbx_list_key_t **)&ca, (tbx_list_data_t **)&va);
-
-    if (va != NULL) {
-        n = (int)(long)va->priv;  //*** HACKERY **** to get the attribute length
-        if (strncmp(attr, va->attribute, n) == 0) {  //** Prefix matches
-            return(va->get(va, os, creds, ofd, attr, val, v_size, atype));
-        }
-    }
-
-    //** Now check the normal VA's
-    va = apr_hash_get(osf->vattr_hash, attr, APR_HASH_KEY_STRING);
-    if (va != NULL) {
-        return(va->get(va, os, creds, ofd, attr, val, v_size, atype));
-    }
-
-
-    //** Lastly look at the actual attributes
+    //** Look at the actual attribute file
     n = osf_resolve_attr_path(os, fname, ofd->object_name, attr, ofd->ftype, atype, 20);
     log_printf(15, "fname=%s *v_size=%d resolve=%d\n", fname, *v_size, n);
     if (n != 0) {
@@ -3035,6 +3770,64 @@ int osf_get_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *o
     return(0);
 }
 
+//***********************************************************************
+// osf_get_attr_pk - Gets the attribute given the name and base directory.
+//     If pk is NULL the object's packed record is loaded if needed.
+//***********************************************************************
+
+int osf_get_attr_pk(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype, osf_packed_t *pk)
+{
+    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
+    lio_os_virtual_attr_t *va;
+    tbx_list_iter_t it;
+    osf_packed_t local;
+    char *ca;
+    int n;
+
+    if (osaz_attr_access(osf->osaz, creds, ofd->object_name, attr, OS_MODE_READ_BLOCKING) == 0) {
+        *atype = 0;
+        return(1);
+    }
+
+    //** Do a Virtual Attr check
+    //** Check the prefix VA's first
+    it = tbx_list_iter_search(osf->vattr_prefix, attr, -1);
+    tbx_list_next(&it, (tbx_list_key_t **)&ca, (tbx_list_data_t **)&va);
+
+    if (va != NULL) {
+        n = (int)(long)va->priv;  //*** HACKERY **** to get the attribute length
+        if (strncmp(attr, va->attribute, n) == 0) {  //** Prefix matches
+            if (pk != NULL) osf_packed_flush(os, pk);  //** VA's go straight to disk so push any pending changes
+            return(va->get(va, os, creds, ofd, attr, val, v_size, atype));
+        }
+    }
+
+    //** Now check the normal VA's
+    va = apr_hash_get(osf->vattr_hash, attr, APR_HASH_KEY_STRING);
+    if (va != NULL) {
+        if (pk != NULL) osf_packed_flush(os, pk);
+        return(va->get(va, os, creds, ofd, attr, val, v_size, atype));
+    }
+
+    //** Lastly look at the actual attributes
+    if (pk != NULL) return(osf_get_real_attr(os, ofd, attr, val, v_size, atype, pk));
+
+    osf_packed_open(os, ofd->attr_dir, &local, 0);
+    n = osf_get_real_attr(os, ofd, attr, val, v_size, atype, &local);
+    osf_packed_close(os, &local);
+
+    return(n);
+}
+
+//***********************************************************************
+// osf_get_attr - Gets the attribute given the name and base directory
+//***********************************************************************
+
+int osf_get_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype)
+{
+    return(osf_get_attr_pk(os, creds, ofd, attr, val, v_size, atype, NULL));
+}
+
 //***********************************************************************
 // osf_get_ma_links - Does the actual attribute retreival when links are
 //       encountered
@@ -3045,15 +3838,17 @@ gop_op_status_t osf_get_ma_links(void *arg, int id, int first_link)
     osfile_attr_op_t *op = (osfile_attr_op_t *)arg;
     int err, i, atype, n_locks;
     apr_thread_mutex_t *lock_table[op->n+1];
+    osf_packed_t pk;
     gop_op_status_t status;
 
     status = gop_success_status;
 
     osf_multi_lock(op->os, op->creds, op->fd, op->key, op->n, first_link, lock_table, &n_locks);
+    osf_packed_open(op->os, op->fd->attr_dir, &pk, 0);
 
     err = 0;
     for (i=0; i<op->n; i++) {
-        err += osf_get_attr(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype);
+        err += osf_get_attr_pk(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype, &pk);
         if (op->v_size[i] > 0) {
             log_printf(15, "PTR i=%d key=%s val=%s v_size=%d\n", i, op->key[i], (char *)op->val[i], op->v_size[i]);
         } else {
@@ -3061,6 +3856,7 @@ gop_op_status_t osf_get_ma_links(void *arg, int id, int first_link)
         }
     }
 
+    osf_packed_close(op->os, &pk);
     osf_multi_unlock(lock_table, n_locks);
 
     if (err != 0) status = gop_failure_status;
@@ -3079,17 +3875,21 @@ gop_op_status_t osf_get_multiple_attr_fn(void *arg, int id)
     int err, i, j, atype, v_start[op->n], oops;
     gop_op_status_t status;
     apr_thread_mutex_t *lock;
+    osf_packed_t pk;
 
     status = gop_success_status;
 
     lock = osf_retrieve_lock(op->os, op->fd->object_name, NULL);
     osf_obj_lock(lock);
 
+    //** Load the packed record once for all the keys
+    osf_packed_open(op->os, op->fd->attr_dir, &pk, 0);
+
     err = 0;
     oops = 0;
     for (i=0; i<op->n; i++) {
         v_start[i] = op->v_size[i];
-        err += osf_get_attr(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype);
+        err += osf_get_attr_pk(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype, &pk);
         if (op->v_size[i] != 0) {
             log_printf(15, "PTR i=%d key=%s val=%s v_size=%d atype=%d err=%d\n", i, op->key[i], (char *)op->val[i], op->v_size[i], atype, err);
         } else {
@@ -3102,6 +3902,7 @@ gop_op_status_t osf_get_multiple_attr_fn(void *arg, int id)
     }
 
     //** Update the access time attribute
+    osf_packed_close(op->os, &pk);
     osf_obj_unlock(lock);
 
     if (oops == 1) { //** Multi object locking required
@@ -3196,48 +3997,71 @@ int lowlevel_set_attr(lio_object_service_fn_t *os, char *attr_dir, char *attr, v
 }
 
 //***********************************************************************
-// osf_set_attr - Sets the attribute given the name and base directory
+// osf_set_real_attr - Sets a normal, non-virtual, attribute.  New small
+//     values go in the packed record if the object has one or packing is
+//     enabled.  Everything else, including pinned link targets, uses the
+//     attribute files.
 //***********************************************************************
 
-int osf_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val)
+int osf_set_real_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val, osf_packed_t *pk)
 {
     lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
-    tbx_list_iter_t it;
+    osf_packed_entry_t *e;
     FILE *fd;
-    lio_os_virtual_attr_t *va;
-    int n;
-    char *ca;
+    char *buf;
+    int n, slot, kind;
     char fname[OS_PATH_MAX];
 
-    if (osaz_attr_access(osf->osaz, creds, ofd->object_name, attr, OS_MODE_READ_BLOCKING) == 0) {
-        *atype = 0;
-        return(1);
-    }
-
-    //** Do a Virtual Attr check
-    //** Check the prefix VA's first
-    it = tbx_list_iter_search(osf->vattr_prefix, attr, -1);
-    tbx_list_next(&it, (tbx_list_key_t **)&ca, (tbx_list_data_t **)&va);
-    if (va != NULL) {
-        n = (int)(long)va->priv;  //*** HACKERY **** to get the attribute length
-        if (strncmp(attr, va->attribute, n) == 0) {  //** Prefix matches
-            return(va->set(va, os, creds, ofd, attr, val, v_size, atype));
-        }
-    }
-
-    //** Now check the normal VA's
-    va = apr_hash_get(osf->vattr_hash, attr, APR_HASH_KEY_STRING);
-    if (va != NULL) {
-        return(va->set(va, os, creds, ofd, attr, val, v_size, atype));
-    }
+    slot = osf_packed_find(pk, attr);
+    kind = (slot >= 0) ? pk->entry[slot].kind : -1;
 
     if (v_size < 0) { //** Want to remove the attribute
         if (osaz_attr_remove(osf->osaz, creds, ofd->object_name, attr) == 0) return(1);
+        if ((slot >= 0) && (kind != OSF_PACKED_PINNED)) osf_packed_del(pk, slot);  //** Keep the pin so it comes back as a file
         snprintf(fname, OS_PATH_MAX, "%s/%s", ofd->attr_dir, attr);
         safe_remove(os, fname);
         return(0);
     }
 
+    if (kind == OSF_PACKED_INLINE) {  //** Update the packed value
+        e = &(pk->entry[slot]);
+        buf = val;
+        n = v_size;
+        if (append_val == 1) {
+            n = e->v_size + v_size;
+            tbx_type_malloc(buf, char, n+1);
+            if (e->v_size > 0) memcpy(buf, e->val, e->v_size);
+            if (v_size > 0) memcpy(&(buf[e->v_size]), val, v_size);
+        }
+
+        *atype = OS_OBJECT_FILE_FLAG;
+        if (n <= osf->packed_max_size) {
+            osf_packed_put(pk, attr, buf, n, OSF_PACKED_INLINE);
+            n = 0;
+        } else {  //** Outgrew the record so give it it's own file
+            n = osf_packed_write_file(pk->attr_dir, attr, buf, n, osf->packed_fsync);
+            if (n == 0) osf_packed_put(pk, attr, NULL, 0, OSF_PACKED_FILE);
+        }
+
+        if (append_val == 1) free(buf);
+        return(n);
+    }
+
+    if ((kind == -1) && ((pk->exists == 1) || (osf->packed_attrs == 1)) && (v_size <= osf->packed_max_size)) {
+        n = 0;
+        if ((pk->flags & OSF_PACKED_COMPLETE) == 0) {  //** Have to make sure there isn't an attribute file
+            snprintf(fname, OS_PATH_MAX, "%s/%s", ofd->attr_dir, attr);
+            n = lio_os_local_filetype(fname);
+        }
+
+        if (n == 0) {  //** New attribute so pack it
+            if (osaz_attr_create(osf->osaz, creds, ofd->object_name, attr) == 0) return(1);
+            osf_packed_put(pk, attr, val, v_size, OSF_PACKED_INLINE);
+            *atype = OS_OBJECT_FILE_FLAG;
+            return(0);
+        }
+    }
+
     n = osf_resolve_attr_path(os, fname, ofd->object_name, attr, ofd->ftype, atype, 20);
     if (n != 0) {
         log_printf(15, "ERROR resolving path: fname=%s object_name=%s attr=%s\n", fname, ofd->object_name, attr);
@@ -3256,9 +4080,77 @@ int osf_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *o
     if (v_size > 0) fwrite(val, v_size, 1, fd);
     fclose(fd);
 
+    //** Keep a complete record complete
+    if ((kind == -1) && (pk->flags & OSF_PACKED_COMPLETE)) osf_packed_put(pk, attr, NULL, 0, OSF_PACKED_FILE);
+
     return(0);
 }
 
+//***********************************************************************
+// osf_set_attr_pk - Sets the attribute given the name and base directory.
+//     If pk is NULL the object's packed record is locked and loaded if needed.
+//***********************************************************************
+
+int osf_set_attr_pk(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val, osf_packed_t *pk)
+{
+    lio_osfile_priv_t *osf = (lio_osfile_priv_t *)os->priv;
+    tbx_list_iter_t it;
+    lio_os_virtual_attr_t *va;
+    osf_packed_t local;
+    int n;
+    char *ca;
+
+    if (osaz_attr_access(osf->osaz, creds, ofd->object_name, attr, OS_MODE_READ_BLOCKING) == 0) {
+        *atype = 0;
+        return(1);
+    }
+
+    //** Do a Virtual Attr check
+    //** Check the prefix VA's first
+    it = tbx_list_iter_search(osf->vattr_prefix, attr, -1);
+    tbx_list_next(&it, (tbx_list_key_t **)&ca, (tbx_list_data_t **)&va);
+    if (va != NULL) {
+        n = (int)(long)va->priv;  //*** HACKERY **** to get the attribute length
+        if (strncmp(attr, va->attribute, n) == 0) {  //** Prefix matches
+            if (pk == NULL) return(va->set(va, os, creds, ofd, attr, val, v_size, atype));
+
+            //** The VA updates the record on it's own so sync up around it
+            osf_packed_flush(os, pk);
+            n = va->set(va, os, creds, ofd, attr, val, v_size, atype);
+            osf_packed_read(pk);
+            return(n);
+        }
+    }
+
+    //** Now check the normal VA's
+    va = apr_hash_get(osf->vattr_hash, attr, APR_HASH_KEY_STRING);
+    if (va != NULL) {
+        if (pk == NULL) return(va->set(va, os, creds, ofd, attr, val, v_size, atype));
+
+        osf_packed_flush(os, pk);
+        n = va->set(va, os, creds, ofd, attr, val, v_size, atype);
+        osf_packed_read(pk);
+        return(n);
+    }
+
+    if (pk != NULL) return(osf_set_real_attr(os, creds, ofd, attr, val, v_size, atype, append_val, pk));
+
+    osf_packed_open(os, ofd->attr_dir, &local, 1);
+    n = osf_set_real_attr(os, creds, ofd, attr, val, v_size, atype, append_val, &local);
+    if (osf_packed_close(os, &local) != 0) n = 1;
+
+    return(n);
+}
+
+//***********************************************************************
+// osf_set_attr - Sets the attribute given the name and base directory
+//***********************************************************************
+
+int osf_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val)
+{
+    return(osf_set_attr_pk(os, creds, ofd, attr, val, v_size, atype, append_val, NULL));
+}
+
 //***********************************************************************
 // osf_set_ma_links - Does the actual attribute setting when links are
 //       encountered
@@ -3270,17 +4162,22 @@ gop_op_status_t osf_set_multiple_attr_fn(void *arg, int id)
     osfile_attr_op_t *op = (osfile_attr_op_t *)arg;
     int err, i, atype, n_locks;
     apr_thread_mutex_t *lock_table[op->n+1];
+    osf_packed_t pk;
     gop_op_status_t status;
 
     status = gop_success_status;
 
     osf_multi_lock(op->os, op->creds, op->fd, op->key, op->n, 0, lock_table, &n_locks);
 
+    //** All the changes to the packed record are stored with a single write
+    osf_packed_open(op->os, op->fd->attr_dir, &pk, 1);
+
     err = 0;
     for (i=0; i<op->n; i++) {
-        err += osf_set_attr(op->os, op->creds, op->fd, op->key[i], op->val[i], op->v_size[i], &atype, 0);
+        err += osf_set_attr_pk(op->os, op->creds, op->fd, op->key[i], op->val[i], op->v_size[i], &atype, 0, &pk);
     }
 
+    if (osf_packed_close(op->os, &pk) != 0) err++;
     osf_multi_unlock(lock_table, n_locks);
 
     if (err != 0) status = gop_failure_status;
@@ -3345,9 +4242,10 @@ int osfile_next_attr(os_attr_iter_t *oit, char **key, void **val, int *v_size)
 {
     osfile_attr_iter_t *it = (osfile_attr_iter_t *)oit;
     lio_osfile_priv_t *osf = (lio_osfile_priv_t *)it->os->priv;
-    int i, n, atype;
+    int i, n, atype, slot;
     apr_ssize_t klen;
     lio_os_virtual_attr_t *va;
+    osf_packed_entry_t *e;
     struct dirent *entry;
     lio_os_regex_table_t *rex = it->regex;
 
@@ -3368,6 +4266,25 @@ int osfile_next_attr(os_attr_iter_t *oit, char **key, void **val, int *v_size)
         }
     }
 
+    //** Then the packed attributes.  Anything stored as a file is picked up from the directory
+    while (it->pk_slot < it->pk.n) {
+        e = &(it->pk.entry[it->pk_slot]);
+        it->pk_slot++;
+        if (e->kind != OSF_PACKED_INLINE) continue;
+
+        for (i=0; i<rex->n; i++) {
+            n = (rex->regex_entry[i].fixed == 1) ? strcmp(rex->regex_entry[i].expression, e->key) : regexec(&(rex->regex_entry[i].compiled), e->key, 0, NULL, 0);
+            if (n == 0) { //** got a match
+                if (osaz_attr_access(osf->osaz, it->creds, it->fd->object_name, e->key, OS_MODE_READ_BLOCKING) == 1) {
+                    *v_size = it->v_max;
+                    osf_get_attr_pk(it->fd->os, it->creds, it->fd, e->key, val, v_size, &atype, &(it->pk));
+                    *key = strdup(e->key);
+                    return(0);
+                }
+            }
+        }
+    }
+
     if (it->d == NULL) {
         log_printf(0, "ERROR: it->d=NULL\n");
         return(-1);
@@ -3379,13 +4296,19 @@ int osfile_next_attr(os_attr_iter_t *oit, char **key, void **val, int *v_size)
             log_printf(15, "key=%s match=%d\n", entry->d_name, n);
             if (n == 0) {
                 if ((strncmp(entry->d_name, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX_LEN) == 0) ||
+                        (strncmp(entry->d_name, FILE_ATTR_PACKED, FILE_ATTR_PACKED_LEN) == 0) ||
                         (strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) n = 1;
             }
 
+            if (n == 0) {  //** Skip anything already returned from the packed record
+                slot = osf_packed_find(&(it->pk), entry->d_name);
+                if ((slot >= 0) && (it->pk.entry[slot].kind == OSF_PACKED_INLINE)) n = 1;
+            }
+
             if (n == 0) { //** got a match
                 if (osaz_attr_access(osf->osaz, it->creds, it->fd->object_name, entry->d_name, OS_MODE_READ_BLOCKING) == 1) {
                     *v_size = it->v_max;
-                    osf_get_attr(it->fd->os, it->creds, it->fd, entry->d_name, val, v_size, &atype);
+                    osf_get_attr_pk(it->fd->os, it->creds, it->fd, entry->d_name, val, v_size, &atype, &(it->pk));
                     *key = strdup(entry->d_name);
                     log_printf(15, "key=%s val=%s\n", *key, (char *)(*val));
                     return(0);
@@ -3421,6 +4344,7 @@ os_attr_iter_t *osfile_create_attr_iter(lio_object_service_fn_t *os, lio_creds_t
     it->va_index = apr_hash_first(it->mpool, osf->vattr_hash);
 
     it->d = opendir(fd->attr_dir);
+    osf_packed_open(os, fd->attr_dir, &(it->pk), 0);
     it->regex = attr;
     it->fd = fd;
     it->creds = creds;
@@ -3437,6 +4361,7 @@ void osfile_destroy_attr_iter(os_attr_iter_t *oit)
 {
     osfile_attr_iter_t *it = (osfile_attr_iter_t *)oit;
     if (it->d != NULL) closedir(it->d);
+    osf_packed_close(it->os, &(it->pk));
 
     apr_pool_destroy(it->mpool);
     free(it);
@@ -4181,6 +5106,9 @@ void osfile_print_running_config(lio_object_service_fn_t *os, FILE *fd, int prin
     fprintf(fd, "lock_table_size = %d\n", osf->internal_lock_size);
     fprintf(fd, "max_copy = %d\n", osf->max_copy);
     fprintf(fd, "hardlink_dir_size = %d\n", osf->hardlink_dir_size);
+    fprintf(fd, "packed_attrs = %d\n", osf->packed_attrs);
+    fprintf(fd, "packed_max_size = %d\n", osf->packed_max_size);
+    fprintf(fd, "packed_fsync = %d\n", osf->packed_fsync);
     fprintf(fd, "authz = %s\n", osf->authz_section);
     fprintf(fd, "authn = %s\n", osf->authn_section);
     fprintf(fd, "\n");
@@ -4197,8 +5125,10 @@ void osfile_destroy(lio_object_service_fn_t *os)
 
     for (i=0; i<osf->internal_lock_size; i++) {
         apr_thread_mutex_destroy(osf->internal_lock[i]);
+        apr_thread_mutex_destroy(osf->packed_lock[i]);
     }
     free(osf->internal_lock);
+    free(osf->packed_lock);
 
     apr_thread_mutex_destroy(osf->fobj_lock);
     tbx_list_destroy(osf->fobj_table);
@@ -4255,11 +5185,17 @@ lio_object_service_fn_t *object_service_file_create(lio_service_manager_t *ess,
         osf->internal_lock_size = 200;
         osf->max_copy = 1024*1024;
         osf->hardlink_dir_size = 256;
+        osf->packed_attrs = osf_default_options.packed_attrs;
+        osf->packed_max_size = osf_default_options.packed_max_size;
+        osf->packed_fsync = osf_default_options.packed_fsync;
     } else {
         osf->base_path = tbx_inip_get_string(fd, section, "base_path", osf_default_options.base_path);
         osf->internal_lock_size = tbx_inip_get_integer(fd, section, "lock_table_size", osf_default_options.internal_lock_size);
         osf->max_copy = tbx_inip_get_integer(fd, section, "max_copy", osf_default_options.max_copy);
         osf->hardlink_dir_size = tbx_inip_get_integer(fd, section, "hardlink_dir_size", osf_default_options.hardlink_dir_size);
+        osf->packed_attrs = tbx_inip_get_integer(fd, section, "packed_attrs", osf_default_options.packed_attrs);
+        osf->packed_max_size = tbx_inip_get_integer(fd, section, "packed_max_size", osf_default_options.packed_max_size);
+        osf->packed_fsync = tbx_inip_get_integer(fd, section, "packed_fsync", osf_default_options.packed_fsync);
         asection = tbx_inip_get_string(fd, section, "authz", osf_default_options.authn_section);
         osf->authz_section = asection;
         atype = (asection == NULL) ? strdup(OSAZ_TYPE_FAKE) : tbx_inip_get_string(fd, asection, "type", OSAZ_TYPE_FAKE);
@@ -4297,8 +5233,10 @@ lio_object_service_fn_t *object_service_file_create(lio_service_manager_t *ess,
 
     apr_pool_create(&osf->mpool, NULL);
     tbx_type_malloc_clear(osf->internal_lock, apr_thread_mutex_t *, osf->internal_lock_size);
+    tbx_type_malloc_clear(osf->packed_lock, apr_thread_mutex_t *, osf->internal_lock_size);
     for (i=0; i<osf->internal_lock_size; i++) {
         apr_thread_mutex_create(&(osf->internal_lock[i]), APR_THREAD_MUTEX_DEFAULT, osf->mpool);
+        apr_thread_mutex_create(&(osf->packed_lock[i]), APR_THREAD_MUTEX_NESTED, osf->mpool);  //** VA's can re-enter
     }
 
     apr_thread_mutex_create(&(osf->fobj_lock), APR_THREAD_MUTEX_DEFAULT, osf->mpool);
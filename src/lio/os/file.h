@@ -47,12 +47,16 @@ void destroy_local_object_iter(local_object_iter_t *it);
 
 lio_object_service_fn_t *object_service_file_create(lio_service_manager_t *ess, tbx_inip_file_t *ifd, char *section);
 int osf_store_val(void *src, int src_size, void **dest, int *v_size);
+LIO_API int osf_packed_dir(char *attr_dir, int max_size, int unpack, int do_sync, apr_hash_t *pinned);
 
 #define SAFE_MIN_LEN 2
 
 #define FILE_ATTR_PREFIX "_^FA^_"
 #define FILE_ATTR_PREFIX_LEN 6
 
+#define FILE_ATTR_PACKED "_^FP^_"    //** Packed attribute record stored in the attribute dir
+#define FILE_ATTR_PACKED_LEN 6
+
 #define DIR_PERMS S_IRWXU|S_IRGRP|S_IXGRP|S_IROTH|S_IXOTH
 #define OSF_LOCK_CHKSUM CHKSUM_MD5
 #define OSF_LOCK_CHKSUM_SIZE MD5_DIGEST_LENGTH
@@ -92,6 +96,10 @@ struct lio_osfile_priv_t {
     lio_os_virtual_attr_t timestamp_pva;
     lio_os_virtual_attr_t append_pva;
     int max_copy;
+    int packed_attrs;
+    int packed_max_size;
+    int packed_fsync;
+    apr_thread_mutex_t **packed_lock;
 };
 
 
@@ -0,0 +1,4414 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// Object service backed by an embedded ordered key/value store (LevelDB)
+//
+//   The namespace is stored as inodes, directory entries, and attributes
+//   instead of files and directories.  All the keys start with a table
+//   byte and an 8 byte big endian inode so everything for an object sorts
+//   together and a directory listing or attribute scan is a single prefix
+//   iteration.
+//
+//     i<ino>            -> type nlink ctime parent link_len link  (zigzag)
+//     d<parent><name>   -> <ino><type>
+//     a<ino><key>       -> <kind><value>
+//
+//   Attribute links store "path/key" as the value with kind KV_ATTR_LINK.
+//   Hardlinks are just multiple dentries pointing to the same inode.  All
+//   the changes for an operation are applied with a single write batch.
+//   Namespace changes are serialized with ns_lock and attribute changes
+//   use a striped lock on the inode.  Reads don't lock.
+//***********************************************************************
+
+#define _log_module_index 156
+
+#include <apr.h>
+#include <apr_errno.h>
+#include <apr_hash.h>
+#include <apr_network_io.h>
+#include <apr_pools.h>
+#include <apr_strings.h>
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_time.h>
+#include <gop/gop.h>
+#include <gop/tp.h>
+#include <gop/types.h>
+#include <leveldb/c.h>
+#include <regex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/append_printf.h>
+#include <tbx/assert_result.h>
+#include <tbx/atomic_counter.h>
+#include <tbx/fmttypes.h>
+#include <tbx/list.h>
+#include <tbx/log.h>
+#include <tbx/pigeon_coop.h>
+#include <tbx/random.h>
+#include <tbx/stack.h>
+#include <tbx/string_token.h>
+#include <tbx/type_malloc.h>
+#include <tbx/varint.h>
+#include <unistd.h>
+
+#include "authn.h"
+#include "authn/fake.h"
+#include "ex3/system.h"
+#include "ex3/types.h"
+#include "os.h"
+#include "os/file.h"
+#include "os/kv.h"
+#include "osaz/fake.h"
+
+#define KV_ROOT_INO     1
+#define KV_MAX_RECURSE  20     //** Max symlinks followed resolving a path or attribute
+#define KV_PREFIX_LEN   9      //** Table byte + inode
+#define KV_KEY_MAX      (OS_PATH_MAX + KV_PREFIX_LEN)
+
+#define KV_INODE  'i'
+#define KV_DENTRY 'd'
+#define KV_ATTR   'a'
+
+#define KV_ATTR_VALUE 'v'     //** Normal attribute value
+#define KV_ATTR_LINK  'l'     //** Attribute link.  The value is "path/key"
+
+typedef struct {
+    char *section;
+    char *base_path;
+    char *host_id;
+    char *authn_section;
+    char *authz_section;
+    int lock_table_size;
+    int max_copy;
+    int sync_writes;
+    int bloom_bits;
+    int64_t cache_size;
+    int64_t write_buffer_size;
+    tbx_atomic_int_t next_ino;
+    leveldb_t *db;
+    leveldb_options_t *opts;
+    leveldb_cache_t *cache;
+    leveldb_filterpolicy_t *filter;
+    leveldb_readoptions_t *ropt;
+    leveldb_writeoptions_t *wopt;
+    gop_thread_pool_context_t *tpc;
+    apr_thread_mutex_t *ns_lock;
+    apr_thread_mutex_t **attr_lock;
+    lio_os_authz_t *osaz;
+    lio_authn_t *authn;
+    apr_pool_t *mpool;
+    tbx_list_t *fobj_table;
+    apr_hash_t *vattr_hash;
+    tbx_list_t *vattr_prefix;
+    apr_thread_mutex_t *fobj_lock;
+    tbx_pc_t *fobj_pc;
+    tbx_pc_t *task_pc;
+    lio_os_virtual_attr_t lock_va;
+    lio_os_virtual_attr_t link_va;
+    lio_os_virtual_attr_t link_count_va;
+    lio_os_virtual_attr_t type_va;
+    lio_os_virtual_attr_t create_va;
+    lio_os_virtual_attr_t attr_link_pva;
+    lio_os_virtual_attr_t attr_type_pva;
+    lio_os_virtual_attr_t timestamp_pva;
+    lio_os_virtual_attr_t append_pva;
+} oskv_priv_t;
+
+static oskv_priv_t oskv_default_options = {
+    .section = "os_kv",
+    .base_path = "/lio/oskv",
+    .lock_table_size = 1024,
+    .max_copy = 1024*1024,
+    .sync_writes = 0,
+    .bloom_bits = 10,
+    .cache_size = 256*1024*1024,
+    .write_buffer_size = 64*1024*1024,
+    .authz_section = NULL,
+    .authn_section = NULL,
+};
+
+typedef struct {
+    uint64_t parent;   //** Only tracked for directories
+    int64_t ctime;
+    int type;
+    int nlink;
+    char *link;        //** Symlink target
+} kv_inode_t;
+
+typedef struct {
+    int vlen;          //** -1 if the key is being removed
+    char *val;
+} kv_pending_t;
+
+typedef struct {
+    leveldb_writebatch_t *wb;
+    apr_pool_t *mpool;      //** Created on demand for the pending table
+    apr_hash_t *pending;    //** Changes in the batch so later reads in the same op see them
+    int lock_slot;          //** Attribute lock held until the batch is written.  See kv_batch_hold_lock()
+    int n_locks;
+    int n;
+} kv_batch_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    char *object_name;
+    char *id;
+    uint64_t ino;
+    int ftype;
+    int mode;
+    uint64_t uuid;
+} oskv_fd_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    char *path;
+    int mode;
+    char *id;
+    lio_creds_t *creds;
+    oskv_fd_t **fd;
+    oskv_fd_t *cfd;
+    uint64_t uuid;
+    int max_wait;
+} oskv_open_op_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    oskv_fd_t *fd;
+    lio_creds_t *creds;
+    char **key;
+    void **val;
+    char *key_tmp;
+    void *val_tmp;
+    int *v_size;
+    int v_tmp;
+    int n;
+} oskv_attr_op_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    oskv_fd_t *fd;
+    lio_creds_t *creds;
+    apr_pool_t       *mpool;  //** Separate pool for the va_index since there's no apr_hash_iter_destroy fn
+    apr_hash_index_t *va_index;
+    lio_os_regex_table_t *regex;
+    leveldb_iterator_t *it;
+    char prefix[KV_PREFIX_LEN];
+    int v_max;
+} oskv_attr_iter_t;
+
+typedef struct {
+    leveldb_iterator_t *it;
+    regex_t *preg;
+    char *fragment;
+    char *pending;        //** Directory to return once it's contents are done
+    char prefix[KV_PREFIX_LEN];
+    uint64_t ino;
+    int frag_done;
+    int pending_type;
+    char path[OS_PATH_MAX];
+} kv_obj_level_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    lio_os_regex_table_t *table;
+    lio_os_regex_table_t *attr;
+    lio_os_regex_table_t *object_regex;
+    regex_t *object_preg;
+    char *obj_fixed;
+    lio_creds_t *creds;
+    os_attr_iter_t **it_attr;
+    os_fd_t *fd;
+    kv_obj_level_t *level_info;
+    tbx_stack_t *recurse_stack;
+    apr_pool_t *mpool;
+    apr_hash_t *symlink_loop;
+    char **key;
+    void **val;
+    int *v_size;
+    int *v_size_user;
+    int n_list;
+    int v_fixed;
+    int recurse_depth;
+    int max_level;
+    int curr_level;
+    int v_max;
+    int object_types;
+    int tweak;
+    int finished;
+} oskv_object_iter_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    lio_creds_t *creds;
+    lio_os_regex_table_t *rpath;
+    lio_os_regex_table_t *object_regex;
+    tbx_atomic_int_t abort;
+    int obj_types;
+    int recurse_depth;
+} oskv_remove_regex_op_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    lio_creds_t *creds;
+    lio_os_regex_table_t *rpath;
+    lio_os_regex_table_t *object_regex;
+    int recurse_depth;
+    int object_types;
+    char **key;
+    void **val;
+    char *id;
+    int *v_size;
+    int n_keys;
+    tbx_atomic_int_t abort;
+} oskv_regex_object_attr_op_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    lio_creds_t *creds;
+    char *src_path;
+    char *dest_path;
+    char *id;
+    int type;
+} oskv_mk_mv_rm_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    lio_creds_t *creds;
+    oskv_fd_t *fd;
+    char **key_old;
+    char **key_new;
+    char *single_old;
+    char *single_new;
+    int n;
+} oskv_move_attr_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    lio_creds_t *creds;
+    oskv_fd_t *fd_src;
+    oskv_fd_t *fd_dest;
+    char **key_src;
+    char **key_dest;
+    char *single_path;
+    char *single_src;
+    char *single_dest;
+    char **src_path;
+    int n;
+} oskv_copy_attr_t;
+
+typedef struct {
+    tbx_stack_t *stack;
+    tbx_stack_t *active_stack;
+    int read_count;
+    int write_count;
+    tbx_pch_t pch;
+} kv_fobj_lock_t;
+
+typedef struct {
+    apr_thread_cond_t *cond;
+    oskv_fd_t *fd;
+    int abort;
+} kv_fobj_lock_task_t;
+
+typedef struct {
+    lio_object_service_fn_t *os;
+    lio_creds_t *creds;
+    char *path;
+    lio_os_regex_table_t *regex;
+    os_object_iter_t *it;
+    int mode;
+} oskv_fsck_iter_t;
+
+int kv_lock_slot(oskv_priv_t *kv, uint64_t ino);
+int kv_multi_lock(oskv_priv_t *kv, uint64_t *ino, int n, int *slot);
+void kv_multi_unlock(oskv_priv_t *kv, int *slot, int n);
+int kv_get_attr(lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *attr, void **val, int *v_size, int *atype);
+int kv_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *attr, void *val, int v_size, int *atype, int append_val, kv_batch_t *b);
+int kv_va_timestamp_set(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *fullkey, void *val, int v_size, int *atype, kv_batch_t *b);
+int kv_va_append_set(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *fullkey, void *val, int v_size, int *atype, kv_batch_t *b);
+gop_op_status_t oskv_open_object_fn(void *arg, int id);
+gop_op_status_t oskv_close_object_fn(void *arg, int id);
+gop_op_status_t kv_get_multiple_attr_fn(void *arg, int id);
+gop_op_status_t kv_set_multiple_attr_fn(void *arg, int id);
+os_attr_iter_t *oskv_create_attr_iter(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, lio_os_regex_table_t *attr, int v_max);
+void oskv_destroy_attr_iter(os_attr_iter_t *oit);
+os_object_iter_t *oskv_create_object_iter(lio_object_service_fn_t *os, lio_creds_t *creds, lio_os_regex_table_t *path, lio_os_regex_table_t *object_regex, int object_types,
+        lio_os_regex_table_t *attr,  int recurse_depth, os_attr_iter_t **it_attr, int v_max);
+int oskv_next_object(os_object_iter_t *oit, char **fname, int *prefix_len);
+void oskv_destroy_object_iter(os_object_iter_t *it);
+
+//***********************************************************************
+// kv_key_make - Makes a table key for the inode and optional name.
+//     Returns the key length or -1 if the name is too long
+//***********************************************************************
+
+int kv_key_make(char *key, char table, uint64_t ino, const char *name, int nlen)
+{
+    int i;
+
+    key[0] = table;
+    for (i=8; i>0; i--) {
+        key[i] = ino & 0xFF;
+        ino = ino >> 8;
+    }
+
+    if (name == NULL) return(KV_PREFIX_LEN);
+    if (nlen < 0) nlen = strlen(name);
+    if (nlen + KV_PREFIX_LEN > KV_KEY_MAX) return(-1);
+
+    memcpy(key + KV_PREFIX_LEN, name, nlen);
+    return(KV_PREFIX_LEN + nlen);
+}
+
+//***********************************************************************
+// kv_ino_decode - Decodes a big endian inode
+//***********************************************************************
+
+uint64_t kv_ino_decode(const char *buf)
+{
+    const unsigned char *b = (const unsigned char *)buf;
+    uint64_t ino = 0;
+    int i;
+
+    for (i=0; i<8; i++) {
+        ino = (ino << 8) | b[i];
+    }
+
+    return(ino);
+}
+
+//***********************************************************************
+// kv_has_prefix - Returns 1 if the iterator is on a key with the prefix
+//***********************************************************************
+
+int kv_has_prefix(leveldb_iterator_t *it, const char *prefix, int plen)
+{
+    const char *key;
+    size_t klen;
+
+    if (!leveldb_iter_valid(it)) return(0);
+    key = leveldb_iter_key(it, &klen);
+    if ((int)klen < plen) return(0);
+    return((memcmp(key, prefix, plen) == 0) ? 1 : 0);
+}
+
+//***********************************************************************
+// kv_batch_* - Write batch helpers.  Everything added to the batch is also
+//     tracked in a pending table so an operation can read it's own changes
+//     with kv_batch_get() without writing the batch early.
+//***********************************************************************
+
+void kv_batch_init(kv_batch_t *b)
+{
+    b->wb = leveldb_writebatch_create();
+    b->mpool = NULL;
+    b->pending = NULL;
+    b->n_locks = 0;
+    b->n = 0;
+}
+
+//***********************************************************************
+
+void kv_batch_pending_set(kv_batch_t *b, const char *key, int klen, const char *val, int vlen)
+{
+    kv_pending_t *p;
+
+    if (b->mpool == NULL) {
+        apr_pool_create(&(b->mpool), NULL);
+        b->pending = apr_hash_make(b->mpool);
+    }
+
+    p = apr_hash_get(b->pending, key, klen);
+    if (p == NULL) {
+        p = apr_palloc(b->mpool, sizeof(kv_pending_t));
+        apr_hash_set(b->pending, apr_pmemdup(b->mpool, key, klen), klen, p);
+    }
+
+    p->vlen = vlen;
+    p->val = (vlen > 0) ? apr_pmemdup(b->mpool, val, vlen) : NULL;
+}
+
+//***********************************************************************
+
+void kv_batch_put(kv_batch_t *b, const char *key, int klen, const char *val, int vlen)
+{
+    leveldb_writebatch_put(b->wb, key, klen, val, vlen);
+    kv_batch_pending_set(b, key, klen, val, vlen);
+    b->n++;
+}
+
+//***********************************************************************
+
+void kv_batch_del(kv_batch_t *b, const char *key, int klen)
+{
+    leveldb_writebatch_delete(b->wb, key, klen);
+    kv_batch_pending_set(b, key, klen, NULL, -1);
+    b->n++;
+}
+
+//***********************************************************************
+// kv_batch_get - Reads the key as it will be once the batch is written.
+//     The batch can be NULL.  On success *val is NULL if the key doesn't
+//     exist.  *from_db is set if *val must be released with leveldb_free().
+//     Returns 0 on success and 1 on a DB error.
+//***********************************************************************
+
+int kv_batch_get(oskv_priv_t *kv, const leveldb_readoptions_t *ropt, kv_batch_t *b, const char *key, int klen, char **val, size_t *nbytes, int *from_db)
+{
+    kv_pending_t *p;
+    char *errstr = NULL;
+
+    *from_db = 0;
+    p = ((b != NULL) && (b->pending != NULL)) ? apr_hash_get(b->pending, key, klen) : NULL;
+    if (p != NULL) {
+        *val = (p->vlen < 0) ? NULL : ((p->val != NULL) ? p->val : "");
+        *nbytes = (p->vlen < 0) ? 0 : p->vlen;
+        return(0);
+    }
+
+    *val = leveldb_get(kv->db, ropt, key, klen, nbytes, &errstr);
+    if (errstr != NULL) {
+        log_printf(0, "ERROR: read failed! error=%s\n", errstr);
+        leveldb_free(errstr);
+        *val = NULL;
+        return(1);
+    }
+
+    if (*val != NULL) *from_db = 1;
+    return(0);
+}
+
+//***********************************************************************
+// kv_batch_hold_lock - Takes the inode's attribute lock and keeps it until
+//     the batch is written or aborted.  Only one lock can be held.
+//***********************************************************************
+
+void kv_batch_hold_lock(oskv_priv_t *kv, kv_batch_t *b, uint64_t ino)
+{
+    int slot[1];
+
+    if (b->n_locks > 0) {
+        if (b->lock_slot == kv_lock_slot(kv, ino)) return;
+        log_printf(0, "ERROR: Batch already holds a lock! ino=" LU "\n", ino);
+        return;
+    }
+
+    b->n_locks = kv_multi_lock(kv, &ino, 1, slot);
+    b->lock_slot = slot[0];
+}
+
+//***********************************************************************
+
+int kv_batch_flush(oskv_priv_t *kv, kv_batch_t *b)
+{
+    char *errstr = NULL;
+
+    if (b->n == 0) return(0);
+
+    leveldb_write(kv->db, kv->wopt, b->wb, &errstr);
+    leveldb_writebatch_clear(b->wb);
+    b->n = 0;
+
+    if (errstr != NULL) {
+        log_printf(0, "ERROR: write failed! error=%s\n", errstr);
+        leveldb_free(errstr);
+        return(1);
+    }
+
+    return(0);
+}
+
+//***********************************************************************
+// kv_batch_abort - Discards the batch without writing it
+//***********************************************************************
+
+void kv_batch_abort(oskv_priv_t *kv, kv_batch_t *b)
+{
+    if (b->n_locks > 0) kv_multi_unlock(kv, &(b->lock_slot), b->n_locks);
+    b->n_locks = 0;
+    leveldb_writebatch_destroy(b->wb);
+    if (b->mpool != NULL) apr_pool_destroy(b->mpool);
+}
+
+//***********************************************************************
+
+int kv_batch_destroy(oskv_priv_t *kv, kv_batch_t *b)
+{
+    int err;
+
+    err = kv_batch_flush(kv, b);
+    kv_batch_abort(kv, b);
+    return(err);
+}
+
+//***********************************************************************
+// kv_inode_get - Loads the inode.  Returns 0 on success
+//***********************************************************************
+
+int kv_inode_get(oskv_priv_t *kv, const leveldb_readoptions_t *ropt, uint64_t ino, kv_inode_t *inode)
+{
+    char key[KV_PREFIX_LEN];
+    char *val, *errstr = NULL;
+    size_t nbytes;
+    int64_t v[5];
+    int i, n, used;
+
+    memset(inode, 0, sizeof(kv_inode_t));
+
+    kv_key_make(key, KV_INODE, ino, NULL, 0);
+    val = leveldb_get(kv->db, ropt, key, KV_PREFIX_LEN, &nbytes, &errstr);
+    if (errstr != NULL) {
+        log_printf(0, "ERROR: ino=" LU " error=%s\n", ino, errstr);
+        leveldb_free(errstr);
+        return(1);
+    }
+    if (val == NULL) return(1);
+
+    used = 0;
+    for (i=0; i<5; i++) {
+        n = tbx_zigzag_decode((uint8_t *)val + used, nbytes - used, &(v[i]));
+        if (n < 0) goto corrupt;
+        used += n;
+    }
+
+    if ((v[4] < 0) || (used + v[4] > (int64_t)nbytes)) goto corrupt;
+
+    inode->type = v[0];
+    inode->nlink = v[1];
+    inode->ctime = v[2];
+    inode->parent = v[3];
+    if (v[4] > 0) {
+        tbx_type_malloc(inode->link, char, v[4]+1);
+        memcpy(inode->link, val + used, v[4]);
+        inode->link[v[4]] = 0;
+    }
+
+    leveldb_free(val);
+    return(0);
+
+corrupt:
+    log_printf(0, "ERROR: Corrupt inode! ino=" LU "\n", ino);
+    leveldb_free(val);
+    return(1);
+}
+
+//***********************************************************************
+// kv_inode_put - Adds the inode to the batch
+//***********************************************************************
+
+void kv_inode_put(kv_batch_t *b, uint64_t ino, kv_inode_t *inode)
+{
+    char key[KV_PREFIX_LEN];
+    uint8_t *buf;
+    int n, len;
+
+    len = (inode->link == NULL) ? 0 : strlen(inode->link);
+    tbx_type_malloc(buf, uint8_t, 5*10 + len);
+    n = tbx_zigzag_encode(inode->type, buf);
+    n += tbx_zigzag_encode(inode->nlink, buf + n);
+    n += tbx_zigzag_encode(inode->ctime, buf + n);
+    n += tbx_zigzag_encode(inode->parent, buf + n);
+    n += tbx_zigzag_encode(len, buf + n);
+    if (len > 0) memcpy(buf + n, inode->link, len);
+    n += len;
+
+    kv_key_make(key, KV_INODE, ino, NULL, 0);
+    kv_batch_put(b, key, KV_PREFIX_LEN, (char *)buf, n);
+    free(buf);
+}
+
+//***********************************************************************
+// kv_inode_clear - Releases the inode contents
+//***********************************************************************
+
+void kv_inode_clear(kv_inode_t *inode)
+{
+    if (inode->link != NULL) free(inode->link);
+    inode->link = NULL;
+}
+
+//***********************************************************************
+// kv_dentry_get - Looks up a name in the directory.  Returns 0 if found
+//***********************************************************************
+
+int kv_dentry_get(oskv_priv_t *kv, const leveldb_readoptions_t *ropt, uint64_t parent, const char *name, int nlen, uint64_t *ino, int *ftype)
+{
+    char key[KV_KEY_MAX];
+    char *val, *errstr = NULL;
+    size_t nbytes;
+    int klen;
+
+    klen = kv_key_make(key, KV_DENTRY, parent, name, nlen);
+    if (klen < 0) return(1);
+
+    val = leveldb_get(kv->db, ropt, key, klen, &nbytes, &errstr);
+    if (errstr != NULL) {
+        log_printf(0, "ERROR: parent=" LU " error=%s\n", parent, errstr);
+        leveldb_free(errstr);
+        return(1);
+    }
+    if (val == NULL) return(1);
+
+    if (nbytes != 9) {
+        log_printf(0, "ERROR: Corrupt dentry! parent=" LU "\n", parent);
+        leveldb_free(val);
+        return(1);
+    }
+
+    *ino = kv_ino_decode(val);
+    *ftype = (unsigned char)val[8];
+    leveldb_free(val);
+    return(0);
+}
+
+//***********************************************************************
+// kv_dentry_put - Adds the directory entry to the batch
+//***********************************************************************
+
+void kv_dentry_put(kv_batch_t *b, uint64_t parent, const char *name, uint64_t ino, int ftype)
+{
+    char key[KV_KEY_MAX];
+    char val[9];
+    int klen;
+
+    klen = kv_key_make(key, KV_DENTRY, parent, name, -1);
+    kv_key_make(val, KV_DENTRY, ino, NULL, 0);  //** Just used to encode the inode
+    memmove(val, val+1, 8);
+    val[8] = ftype;
+    kv_batch_put(b, key, klen, val, 9);
+}
+
+//***********************************************************************
+// kv_dentry_del - Removes the directory entry
+//***********************************************************************
+
+void kv_dentry_del(kv_batch_t *b, uint64_t parent, const char *name)
+{
+    char key[KV_KEY_MAX];
+    int klen;
+
+    klen = kv_key_make(key, KV_DENTRY, parent, name, -1);
+    kv_batch_del(b, key, klen);
+}
+
+//***********************************************************************
+// kv_dir_is_empty - Returns 1 if the directory has no entries
+//***********************************************************************
+
+int kv_dir_is_empty(oskv_priv_t *kv, uint64_t ino)
+{
+    leveldb_iterator_t *it;
+    char prefix[KV_PREFIX_LEN];
+    int empty;
+
+    kv_key_make(prefix, KV_DENTRY, ino, NULL, 0);
+    it = leveldb_create_iterator(kv->db, kv->ropt);
+    leveldb_iter_seek(it, prefix, KV_PREFIX_LEN);
+    empty = (kv_has_prefix(it, prefix, KV_PREFIX_LEN) == 1) ? 0 : 1;
+    leveldb_iter_destroy(it);
+
+    return(empty);
+}
+
+//***********************************************************************
+// kv_purge_attrs - Adds all the objects attributes to the batch for removal
+//***********************************************************************
+
+void kv_purge_attrs(oskv_priv_t *kv, kv_batch_t *b, uint64_t ino)
+{
+    leveldb_iterator_t *it;
+    char prefix[KV_PREFIX_LEN];
+    const char *key;
+    size_t klen;
+
+    kv_key_make(prefix, KV_ATTR, ino, NULL, 0);
+    it = leveldb_create_iterator(kv->db, kv->ropt);
+    for (leveldb_iter_seek(it, prefix, KV_PREFIX_LEN); kv_has_prefix(it, prefix, KV_PREFIX_LEN) == 1; leveldb_iter_next(it)) {
+        key = leveldb_iter_key(it, &klen);
+        kv_batch_del(b, key, klen);
+    }
+    leveldb_iter_destroy(it);
+}
+
+//***********************************************************************
+// kv_path_split - Splits the path into the parent directory and name.
+//     Trailing /'s are ignored.  Returns 1 if there is no name, ie "/".
+//***********************************************************************
+
+int kv_path_split(const char *path, char *dir, char *base)
+{
+    int n, i;
+
+    n = strlen(path);
+    if (n >= OS_PATH_MAX) return(1);
+    while ((n > 0) && (path[n-1] == '/')) n--;    //** Peel off any trailing /'s
+    if (n == 0) return(1);
+
+    i = n-1;
+    while ((i >= 0) && (path[i] != '/')) i--;
+
+    memcpy(base, path + i + 1, n - i - 1);
+    base[n - i - 1] = 0;
+    if ((strcmp(base, ".") == 0) || (strcmp(base, "..") == 0)) return(1);
+
+    if (i < 0) i = 0;
+    memcpy(dir, path, i);
+    dir[i] = 0;
+
+    return(0);
+}
+
+//***********************************************************************
+// kv_lookup - Resolves the path to an inode.  Symlinks are always followed
+//     for the intermediate components and for the last one if follow=1.
+//     Returns 0 on success with the inode and the type from it's dentry
+//***********************************************************************
+
+int kv_lookup(lio_object_service_fn_t *os, const leveldb_readoptions_t *ropt, const char *path, int follow, uint64_t *ino, int *ftype)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    kv_inode_t inode;
+    uint64_t cur, child;
+    int type, ctype, n, plen, depth;
+    const char *p, *e, *last;
+    char *buf, *nbuf;
+    char cur_path[OS_PATH_MAX];
+
+    cur = KV_ROOT_INO;
+    type = OS_OBJECT_DIR_FLAG;
+    plen = 0;
+    cur_path[0] = 0;
+    depth = KV_MAX_RECURSE;
+    buf = NULL;
+    p = path;
+
+    while (1) {
+        while (*p == '/') p++;
+        if (*p == 0) break;
+        e = p;
+        while ((*e != '/') && (*e != 0)) e++;
+        n = e - p;
+
+        if ((type & OS_OBJECT_DIR_FLAG) == 0) goto fail;  //** Can't descend into a file
+
+        if ((n == 1) && (p[0] == '.')) {
+            p = e;
+            continue;
+        } else if ((n == 2) && (p[0] == '.') && (p[1] == '.')) {
+            if (cur != KV_ROOT_INO) {
+                if (kv_inode_get(kv, ropt, cur, &inode) != 0) goto fail;
+                cur = inode.parent;
+                kv_inode_clear(&inode);
+                while ((plen > 0) && (cur_path[plen-1] != '/')) plen--;  //** Peel off the last component
+                if (plen > 0) plen--;
+                cur_path[plen] = 0;
+            }
+            p = e;
+            continue;
+        }
+
+        if (kv_dentry_get(kv, ropt, cur, p, n, &child, &ctype) != 0) goto fail;
+
+        last = e;
+        while (*last == '/') last++;
+        if ((ctype & OS_OBJECT_SYMLINK_FLAG) && ((*last != 0) || (follow == 1))) {
+            if (depth <= 0) {
+                log_printf(0, "Oops! Hit max recurse depth! path=%s\n", path);
+                goto fail;
+            }
+            depth--;
+
+            if (kv_inode_get(kv, ropt, child, &inode) != 0) goto fail;
+            if (inode.link == NULL) {
+                kv_inode_clear(&inode);
+                goto fail;
+            }
+
+            //** Splice the target into the path and start over
+            tbx_type_malloc(nbuf, char, OS_PATH_MAX);
+            if (inode.link[0] == '/') {
+                snprintf(nbuf, OS_PATH_MAX, "%s%s", inode.link, e);
+            } else {
+                snprintf(nbuf, OS_PATH_MAX, "%s/%s%s", cur_path, inode.link, e);
+            }
+            kv_inode_clear(&inode);
+            if (buf != NULL) free(buf);
+            buf = nbuf;
+            p = buf;
+
+            cur = KV_ROOT_INO;
+            type = OS_OBJECT_DIR_FLAG;
+            plen = 0;
+            cur_path[0] = 0;
+            continue;
+        }
+
+        if (plen + n + 2 >= OS_PATH_MAX) goto fail;
+        cur_path[plen] = '/';
+        memcpy(cur_path + plen + 1, p, n);
+        plen += n + 1;
+        cur_path[plen] = 0;
+
+        cur = child;
+        type = ctype;
+        p = e;
+    }
+
+    if (buf != NULL) free(buf);
+    *ino = cur;
+    *ftype = type;
+    return(0);
+
+fail:
+    if (buf != NULL) free(buf);
+    return(1);
+}
+
+//***********************************************************************
+// kv_entry_type - Returns the full object type for a dentry.  Symlinks are
+//     resolved to get the target type and inode.
+//***********************************************************************
+
+int kv_entry_type(lio_object_service_fn_t *os, const leveldb_readoptions_t *ropt, const char *path, uint64_t ino, int dtype, uint64_t *target)
+{
+    uint64_t tino;
+    int ttype;
+
+    *target = ino;
+    if ((dtype & OS_OBJECT_SYMLINK_FLAG) == 0) return(dtype);
+
+    if (kv_lookup(os, ropt, path, 1, &tino, &ttype) != 0) {
+        return(OS_OBJECT_SYMLINK_FLAG|OS_OBJECT_FILE_FLAG|OS_OBJECT_BROKEN_LINK_FLAG);  //** Broken link so flag it as a file anyhow
+    }
+
+    *target = tino;
+    return(OS_OBJECT_SYMLINK_FLAG | ttype);
+}
+
+//***********************************************************************
+// kv_object_type - Returns the object type or 0 if it doesn't exist.
+//     The returned inode is for the object itself and not a symlink target.
+//***********************************************************************
+
+int kv_object_type(lio_object_service_fn_t *os, const leveldb_readoptions_t *ropt, const char *path, uint64_t *ino)
+{
+    uint64_t i, target;
+    int ftype;
+
+    if (kv_lookup(os, ropt, path, 0, &i, &ftype) != 0) return(0);
+    if (ino != NULL) *ino = i;
+
+    return(kv_entry_type(os, ropt, path, i, ftype, &target));
+}
+
+//***********************************************************************
+// kv_retrieve_lock - Returns the attribute lock for the inode
+//***********************************************************************
+
+int kv_lock_slot(oskv_priv_t *kv, uint64_t ino)
+{
+    ino ^= ino >> 29;      //** Mix the bits since inodes are sequential
+    ino *= 0xbf58476d1ce4e5b9ULL;
+    ino ^= ino >> 32;
+    return(ino % kv->lock_table_size);
+}
+
+//***********************************************************************
+// kv_multi_lock - Acquires the attribute locks for all the inodes.  The
+//     locks are taken in slot order to avoid deadlocks.  Returns the number
+//     of locks stored in the slot table.
+//***********************************************************************
+
+int kv_multi_lock(oskv_priv_t *kv, uint64_t *ino, int n, int *slot)
+{
+    int i, j, k, s, nslots;
+
+    nslots = 0;
+    for (i=0; i<n; i++) {
+        s = kv_lock_slot(kv, ino[i]);
+        for (j=0; j<nslots; j++) {
+            if (slot[j] >= s) break;
+        }
+        if ((j < nslots) && (slot[j] == s)) continue;  //** Already have it
+
+        for (k=nslots; k>j; k--) slot[k] = slot[k-1];  //** Keep them sorted
+        slot[j] = s;
+        nslots++;
+    }
+
+    for (i=0; i<nslots; i++) {
+        apr_thread_mutex_lock(kv->attr_lock[slot[i]]);
+    }
+
+    return(nslots);
+}
+
+//***********************************************************************
+// kv_multi_unlock - Releases the attribute locks
+//***********************************************************************
+
+void kv_multi_unlock(oskv_priv_t *kv, int *slot, int n)
+{
+    int i;
+
+    for (i=n-1; i>=0; i--) {
+        apr_thread_mutex_unlock(kv->attr_lock[slot[i]]);
+    }
+}
+
+//*************************************************************
+// kv_fobj_add_active - Adds the object to the active list
+//*************************************************************
+
+void kv_fobj_add_active(kv_fobj_lock_t *fol, oskv_fd_t *fd)
+{
+    tbx_stack_move_to_bottom(fol->active_stack);
+    tbx_stack_insert_below(fol->active_stack, fd);
+}
+
+//*************************************************************
+// kv_fobj_remove_active - Removes the object to the active list
+//*************************************************************
+
+int kv_fobj_remove_active(kv_fobj_lock_t *fol, oskv_fd_t *myfd)
+{
+    oskv_fd_t *fd;
+    int success = 1;
+
+    tbx_stack_move_to_top(fol->active_stack);
+    while ((fd = (oskv_fd_t *)tbx_stack_get_current_data(fol->active_stack)) != NULL) {
+        if (fd == myfd) {  //** Found a match
+            tbx_stack_delete_current(fol->active_stack, 0, 0);
+            success = 0;
+            break;
+        }
+
+        tbx_stack_move_down(fol->active_stack);
+    }
+
+    return(success);
+}
+
+//*************************************************************
+// kv_fobj_lock_task_new - Creates a new shelf of for object locking
+//*************************************************************
+
+void *kv_fobj_lock_task_new(void *arg, int size)
+{
+    apr_pool_t *mpool = (apr_pool_t *)arg;
+    kv_fobj_lock_task_t *shelf;
+    int i;
+
+    tbx_type_malloc_clear(shelf, kv_fobj_lock_task_t, size);
+
+    for (i=0; i<size; i++) {
+        apr_thread_cond_create(&(shelf[i].cond), mpool);
+    }
+
+    return((void *)shelf);
+}
+
+//*************************************************************
+// kv_fobj_lock_task_free - Destroys a shelf of object locking variables
+//*************************************************************
+
+void kv_fobj_lock_task_free(void *arg, int size, void *data)
+{
+    kv_fobj_lock_task_t *shelf = (kv_fobj_lock_task_t *)data;
+    int i;
+
+    for (i=0; i<size; i++) {
+        apr_thread_cond_destroy(shelf[i].cond);
+    }
+
+    free(shelf);
+    return;
+}
+
+//*************************************************************
+// kv_fobj_lock_new - Creates a new shelf of for object locking
+//*************************************************************
+
+void *kv_fobj_lock_new(void *arg, int size)
+{
+    kv_fobj_lock_t *shelf;
+    int i;
+
+    tbx_type_malloc_clear(shelf, kv_fobj_lock_t, size);
+
+    for (i=0; i<size; i++) {
+        shelf[i].stack = tbx_stack_new();
+        shelf[i].active_stack = tbx_stack_new();
+        shelf[i].read_count = 0;
+        shelf[i].write_count = 0;
+    }
+
+    return((void *)shelf);
+}
+
+//*************************************************************
+// kv_fobj_lock_free - Destroys a shelf of object locking variables
+//*************************************************************
+
+void kv_fobj_lock_free(void *arg, int size, void *data)
+{
+    kv_fobj_lock_t *shelf = (kv_fobj_lock_t *)data;
+    int i;
+
+    for (i=0; i<size; i++) {
+        tbx_stack_free(shelf[i].stack, 0);
+        tbx_stack_free(shelf[i].active_stack, 0);
+    }
+
+    free(shelf);
+    return;
+}
+
+//***********************************************************************
+// kv_fobj_wait - Waits for my turn to access the object
+//    NOTE: On entry I should be holding kv->fobj_lock
+//          The lock is cycled in the routine
+//***********************************************************************
+
+int kv_fobj_wait(lio_object_service_fn_t *os, kv_fobj_lock_t *fol, oskv_fd_t *fd, int max_wait)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    tbx_pch_t task_pch;
+    kv_fobj_lock_task_t *handle;
+    int aborted;
+    apr_time_t timeout = apr_time_make(max_wait, 0);
+
+    //** Get my slot
+    task_pch = tbx_pch_reserve(kv->task_pc);
+    handle = (kv_fobj_lock_task_t *)tbx_pch_data(&task_pch);
+    handle->fd = fd;
+    handle->abort = 1;
+
+    log_printf(15, "SLEEPING id=%s fname=%s mymode=%d read_count=%d write_count=%d handle=%p max_wait=%d\n", fd->id, fd->object_name, fd->mode, fol->read_count, fol->write_count, handle, max_wait);
+
+    tbx_stack_move_to_bottom(fol->stack);
+    tbx_stack_insert_below(fol->stack, handle);
+
+    //** Sleep until it's my turn.  Remember fobj_lock is already set upon entry
+    apr_thread_cond_timedwait(handle->cond, kv->fobj_lock, timeout);
+    aborted = handle->abort;
+
+    log_printf(15, "AWAKE id=%s fname=%s mymode=%d read_count=%d write_count=%d handle=%p abort=%d uuid=" LU "\n", fd->id, fd->object_name, fd->mode, fol->read_count, fol->write_count, handle, aborted, fd->uuid);
+
+    //** I'm popped off the stack so just free my handle and update the counter
+    tbx_pch_release(kv->task_pc, &task_pch);
+
+    if (aborted == 1) { //** Open was aborted so remove myself from the pending and kick out
+        tbx_stack_move_to_top(fol->stack);
+        while ((handle = (kv_fobj_lock_task_t *)tbx_stack_get_current_data(fol->stack)) != NULL) {
+            if (handle->fd->uuid == fd->uuid) {
+                log_printf(15, "id=%s fname=%s uuid=" LU " ABORTED\n", fd->id, fd->object_name, fd->uuid);
+                tbx_stack_delete_current(fol->stack, 1, 0);
+                break;
+            }
+            tbx_stack_move_down(fol->stack);
+        }
+
+        return(1);
+    }
+
+    //** Check if the next person should be woke up as well
+    if (tbx_stack_count(fol->stack) != 0) {
+        tbx_stack_move_to_top(fol->stack);
+        handle = (kv_fobj_lock_task_t *)tbx_stack_get_current_data(fol->stack);
+
+        if ((fd->mode == OS_MODE_READ_BLOCKING) && (handle->fd->mode == OS_MODE_READ_BLOCKING)) {
+            tbx_stack_pop(fol->stack);  //** Clear it from the stack. It's already stored in handle above
+            handle->abort = 0;
+            apr_thread_cond_signal(handle->cond);   //** They will wake up when fobj_lock is released in the calling routine
+        }
+    }
+
+    return(0);
+}
+
+//***********************************************************************
+// kv_full_object_lock -  Locks the object across all systems
+//***********************************************************************
+
+int kv_full_object_lock(oskv_fd_t *fd, int max_wait)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    tbx_pch_t obj_pch;
+    kv_fobj_lock_t *fol;
+    kv_fobj_lock_task_t *handle;
+    int err;
+
+    if (fd->mode == OS_MODE_READ_IMMEDIATE) return(0);
+
+    apr_thread_mutex_lock(kv->fobj_lock);
+
+    fol = tbx_list_search(kv->fobj_table, fd->object_name);
+
+    if (fol == NULL) {  //** No one else is accessing the file
+        obj_pch =  tbx_pch_reserve(kv->fobj_pc);
+        fol = (kv_fobj_lock_t *)tbx_pch_data(&obj_pch);
+        fol->pch = obj_pch;  //** Reverse link my PCH for release later
+        tbx_list_insert(kv->fobj_table, fd->object_name, fol);
+    }
+
+    err = 0;
+    if (fd->mode == OS_MODE_READ_BLOCKING) { //** I'm reading
+        if (fol->write_count == 0) { //** No one currently writing
+            //** Check and make sure the person waiting isn't a writer
+            if (tbx_stack_count(fol->stack) != 0) {
+                tbx_stack_move_to_top(fol->stack);
+                handle = (kv_fobj_lock_task_t *)tbx_stack_get_current_data(fol->stack);
+                if (handle->fd->mode == OS_MODE_WRITE_BLOCKING) {  //** They want to write so sleep until my turn
+                    err = kv_fobj_wait(fd->os, fol, fd, max_wait);  //** The fobj_lock is released/acquired inside
+                }
+            }
+        } else {
+            err = kv_fobj_wait(fd->os, fol, fd, max_wait);
+        }
+
+        if (err == 0) fol->read_count++;
+    } else {   //** I'm writing
+        if ((fol->write_count != 0) || (fol->read_count != 0) || (tbx_stack_count(fol->stack) != 0)) {  //** Make sure no one else is doing anything
+            err = kv_fobj_wait(fd->os, fol, fd, max_wait);
+        }
+        if (err == 0) fol->write_count++;
+    }
+
+    if (err == 0) kv_fobj_add_active(fol, fd);
+
+    log_printf(15, "id=%s fname=%s mymode=%d read_count=%d write_count=%d err=%d\n", fd->id, fd->object_name, fd->mode, fol->read_count, fol->write_count, err);
+
+    apr_thread_mutex_unlock(kv->fobj_lock);
+
+    return(err);
+}
+
+//***********************************************************************
+// kv_full_object_unlock -  Releases the global lock
+//***********************************************************************
+
+void kv_full_object_unlock(oskv_fd_t *fd)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    kv_fobj_lock_t *fol;
+    kv_fobj_lock_task_t *handle;
+
+    if (fd->mode == OS_MODE_READ_IMMEDIATE) return;
+
+    apr_thread_mutex_lock(kv->fobj_lock);
+
+    fol = tbx_list_search(kv->fobj_table, fd->object_name);
+    if ((fol == NULL) || (kv_fobj_remove_active(fol, fd) != 0)) {  //** Exit if it wasn't found
+        apr_thread_mutex_unlock(kv->fobj_lock);
+        return;
+    }
+
+    //** Update the counts
+    if (fd->mode == OS_MODE_READ_BLOCKING) {
+        fol->read_count--;
+    } else {
+        fol->write_count--;
+    }
+
+    if ((tbx_stack_count(fol->stack) == 0) && (fol->read_count == 0) && (fol->write_count == 0)) {  //** No one else is waiting so remove the entry
+        tbx_list_remove(kv->fobj_table, fd->object_name, NULL);
+        tbx_pch_release(kv->fobj_pc, &(fol->pch));
+    } else if (tbx_stack_count(fol->stack) > 0) { //** Wake up the next person
+        tbx_stack_move_to_top(fol->stack);
+        handle = (kv_fobj_lock_task_t *)tbx_stack_get_current_data(fol->stack);
+
+        if (((handle->fd->mode == OS_MODE_READ_BLOCKING) && (fol->write_count == 0)) ||
+                ((handle->fd->mode == OS_MODE_WRITE_BLOCKING) && (fol->write_count == 0) && (fol->read_count == 0))) {
+            tbx_stack_pop(fol->stack);  //** Clear it from the stack. It's already stored in handle above
+            handle->abort = 0;
+            apr_thread_cond_broadcast(handle->cond);   //** They will wake up when fobj_lock is released in the calling routine
+        }
+    }
+
+    apr_thread_mutex_unlock(kv->fobj_lock);
+}
+
+//***********************************************************************
+// kv_attr_resolve - Follows any attribute links and returns the inode and
+//     key holding the actual value.  Any pending changes in the batch, which
+//     can be NULL, are used.  Returns 0 on success and 1 if the link is broken.
+//***********************************************************************
+
+int kv_attr_resolve(lio_object_service_fn_t *os, const leveldb_readoptions_t *ropt, kv_batch_t *b, oskv_fd_t *fd, const char *attr, uint64_t *rino, char *rkey)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    char key[KV_KEY_MAX];
+    char path[OS_PATH_MAX], link[OS_PATH_MAX], dir[OS_PATH_MAX], base[OS_PATH_MAX];
+    char *val;
+    size_t nbytes;
+    uint64_t ino;
+    int klen, depth, n, ftype, from_db;
+
+    ino = fd->ino;
+    ftype = fd->ftype;
+    snprintf(path, OS_PATH_MAX, "%s", fd->object_name);
+    snprintf(rkey, OS_PATH_MAX, "%s", attr);
+
+    for (depth=0; depth<KV_MAX_RECURSE; depth++) {
+        klen = kv_key_make(key, KV_ATTR, ino, rkey, -1);
+        if (klen < 0) return(1);
+        if (kv_batch_get(kv, ropt, b, key, klen, &val, &nbytes, &from_db) != 0) {
+            log_printf(0, "ERROR: fname=%s key=%s\n", fd->object_name, attr);
+            return(1);
+        }
+
+        if ((val == NULL) || (nbytes < 1) || (val[0] != KV_ATTR_LINK)) {  //** Found the end of the chain
+            if (from_db) leveldb_free(val);
+            *rino = ino;
+            return(0);
+        }
+
+        //** It's a link so split it into the object and key
+        n = ((int)nbytes-1 < OS_PATH_MAX) ? nbytes-1 : OS_PATH_MAX-1;
+        memcpy(link, val+1, n);
+        link[n] = 0;
+        if (from_db) leveldb_free(val);
+
+        n = strlen(link);
+        while ((n > 0) && (link[n-1] != '/')) n--;
+        if (n == 0) return(1);
+        snprintf(rkey, OS_PATH_MAX, "%s", link + n);
+        link[n-1] = 0;
+
+        if (link[0] != '/') {  //** Relative links are relative to the parent unless it's a dir
+            if ((ftype & OS_OBJECT_DIR_FLAG) && ((ftype & OS_OBJECT_SYMLINK_FLAG) == 0)) {
+                snprintf(dir, OS_PATH_MAX, "%s", path);
+            } else if (kv_path_split(path, dir, base) != 0) {
+                dir[0] = 0;
+            }
+            snprintf(path, OS_PATH_MAX, "%s/%s", dir, link);
+        } else {
+            snprintf(path, OS_PATH_MAX, "%s", link);
+        }
+
+        if (kv_lookup(os, ropt, path, 0, &ino, &ftype) != 0) {
+            log_printf(0, "Missing object: fname=%s key=%s target=%s\n", fd->object_name, attr, path);
+            return(1);
+        }
+    }
+
+    log_printf(0, "Oops! Hit max recurse depth! fname=%s key=%s\n", fd->object_name, attr);
+    return(1);
+}
+
+//***********************************************************************
+// kv_attr_link_get - Returns the raw link text if the attribute is a link.
+//    Returns 1 if the attribute isn't a link.
+//***********************************************************************
+
+int kv_attr_link_get(oskv_priv_t *kv, uint64_t ino, const char *attr, char *link, int *len)
+{
+    char key[KV_KEY_MAX];
+    char *val, *errstr = NULL;
+    size_t nbytes;
+    int klen;
+
+    klen = kv_key_make(key, KV_ATTR, ino, attr, -1);
+    if (klen < 0) return(1);
+
+    val = leveldb_get(kv->db, kv->ropt, key, klen, &nbytes, &errstr);
+    if (errstr != NULL) leveldb_free(errstr);
+    if (val == NULL) return(1);
+
+    if ((nbytes < 1) || (val[0] != KV_ATTR_LINK) || ((int)nbytes > OS_PATH_MAX)) {
+        leveldb_free(val);
+        return(1);
+    }
+
+    *len = nbytes - 1;
+    memcpy(link, val+1, *len);
+    link[*len] = 0;
+    leveldb_free(val);
+    return(0);
+}
+
+//***********************************************************************
+// kv_get_real_attr - Loads the actual attribute value.  The batch can be
+//     NULL, otherwise it's pending changes are included.
+//***********************************************************************
+
+int kv_get_real_attr(lio_object_service_fn_t *os, const leveldb_readoptions_t *ropt, kv_batch_t *b, oskv_fd_t *fd, char *attr, void **val, int *v_size, int *atype)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    char key[KV_KEY_MAX];
+    char rkey[OS_PATH_MAX];
+    char *data, *ca;
+    size_t nbytes;
+    uint64_t ino;
+    int klen, n, bsize, from_db;
+
+    *atype = 0;
+    data = NULL;
+    from_db = 0;
+    if (kv_attr_resolve(os, ropt, b, fd, attr, &ino, rkey) == 0) {
+        klen = kv_key_make(key, KV_ATTR, ino, rkey, -1);
+        if (kv_batch_get(kv, ropt, b, key, klen, &data, &nbytes, &from_db) != 0) {
+            log_printf(0, "ERROR: fname=%s key=%s\n", fd->object_name, attr);
+        }
+    }
+
+    if (data == NULL) {
+        if (*v_size < 0) *val = NULL;
+        *v_size = -1;
+        return(1);
+    }
+
+    *atype = OS_OBJECT_FILE_FLAG;
+    n = nbytes - 1;  //** Skip the kind byte
+
+    if (*v_size < 0) { //** Need to determine the size
+        if (n < 1) {
+            *v_size = 0;
+            *val = NULL;
+            if (from_db) leveldb_free(data);
+            return(0);
+        }
+        *v_size = (n > (-*v_size)) ? -*v_size : n;
+        bsize = *v_size + 1;
+        *val = malloc(bsize);
+    } else {
+        bsize = *v_size;
+        if (*v_size > n) *v_size = n;
+    }
+
+    if (*v_size > 0) memcpy(*val, data+1, *v_size);
+    if (bsize > *v_size) {
+        ca = (char *)(*val);    //** Add a NULL terminator in case it may be a string
+        ca[*v_size] = 0;
+    }
+
+    if (from_db) leveldb_free(data);
+    return(0);
+}
+
+//***********************************************************************
+// kv_get_attr_ro - Gets the attribute using the given read options.  If b
+//     isn't NULL the batch's pending changes are included.
+//***********************************************************************
+
+int kv_get_attr_ro(lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *attr, void **val, int *v_size, int *atype, const leveldb_readoptions_t *ropt, kv_batch_t *b)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    lio_os_virtual_attr_t *va;
+    tbx_list_iter_t it;
+    char *ca;
+    int n;
+
+    if (osaz_attr_access(kv->osaz, creds, fd->object_name, attr, OS_MODE_READ_BLOCKING) == 0) {
+        *atype = 0;
+        return(1);
+    }
+
+    //** Do a Virtual Attr check
+    //** Check the prefix VA's first
+    it = tbx_list_iter_search(kv->vattr_prefix, attr, -1);
+    tbx_list_next(&it, (tbx_list_key_t **)&ca, (tbx_list_data_t **)&va);
+
+    if (va != NULL) {
+        n = (int)(long)va->priv;  //*** HACKERY **** to get the attribute length
+        if (strncmp(attr, va->attribute, n) == 0) {  //** Prefix matches
+            return(va->get(va, os, creds, (os_fd_t *)fd, attr, val, v_size, atype));
+        }
+    }
+
+    //** Now check the normal VA's
+    va = apr_hash_get(kv->vattr_hash, attr, APR_HASH_KEY_STRING);
+    if (va != NULL) {
+        return(va->get(va, os, creds, (os_fd_t *)fd, attr, val, v_size, atype));
+    }
+
+    //** Lastly look at the actual attributes
+    return(kv_get_real_attr(os, ropt, b, fd, attr, val, v_size, atype));
+}
+
+//***********************************************************************
+// kv_get_attr - Gets the attribute
+//***********************************************************************
+
+int kv_get_attr(lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *attr, void **val, int *v_size, int *atype)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+
+    return(kv_get_attr_ro(os, creds, fd, attr, val, v_size, atype, kv->ropt, NULL));
+}
+
+//***********************************************************************
+// kv_set_real_attr - Adds the attribute change to the batch
+//***********************************************************************
+
+int kv_set_real_attr(lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *attr, void *val, int v_size, int *atype, int append_val, kv_batch_t *b)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    char key[KV_KEY_MAX];
+    char rkey[OS_PATH_MAX];
+    char *old, *buf;
+    size_t nbytes;
+    uint64_t ino;
+    int klen, n, from_db;
+
+    if (v_size < 0) { //** Want to remove the attribute.  If it's a link only the link is removed
+        if (osaz_attr_remove(kv->osaz, creds, fd->object_name, attr) == 0) return(1);
+        klen = kv_key_make(key, KV_ATTR, fd->ino, attr, -1);
+        if (klen < 0) return(1);
+        kv_batch_del(b, key, klen);
+        return(0);
+    }
+
+    if (kv_attr_resolve(os, kv->ropt, b, fd, attr, &ino, rkey) != 0) {
+        log_printf(15, "ERROR resolving attr: fname=%s attr=%s\n", fd->object_name, attr);
+        return(1);
+    }
+
+    klen = kv_key_make(key, KV_ATTR, ino, rkey, -1);
+    if (klen < 0) return(1);
+
+    //** See if it already exists including any earlier changes in the batch
+    if (kv_batch_get(kv, kv->ropt, b, key, klen, &old, &nbytes, &from_db) != 0) return(1);
+
+    if (old == NULL) {
+        if (osaz_attr_create(kv->osaz, creds, fd->object_name, attr) == 0) return(1);
+        nbytes = 1;
+    } else if (append_val == 0) {
+        nbytes = 1;
+    }
+
+    n = nbytes + ((v_size > 0) ? v_size : 0);
+    tbx_type_malloc(buf, char, n);
+    if (nbytes > 1) memcpy(buf+1, old+1, nbytes-1);
+    buf[0] = KV_ATTR_VALUE;
+    if (v_size > 0) memcpy(buf + nbytes, val, v_size);
+    if (from_db) leveldb_free(old);
+
+    kv_batch_put(b, key, klen, buf, n);
+    free(buf);
+
+    *atype = OS_OBJECT_FILE_FLAG;
+    return(0);
+}
+
+//***********************************************************************
+// kv_set_attr - Sets the attribute.  If b is NULL the change is written
+//     immediately otherwise it's added to the batch.
+//***********************************************************************
+
+int kv_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *attr, void *val, int v_size, int *atype, int append_val, kv_batch_t *b)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    tbx_list_iter_t it;
+    lio_os_virtual_attr_t *va;
+    kv_batch_t local;
+    int n;
+    char *ca;
+
+    if (osaz_attr_access(kv->osaz, creds, fd->object_name, attr, OS_MODE_READ_BLOCKING) == 0) {
+        *atype = 0;
+        return(1);
+    }
+
+    //** Do a Virtual Attr check
+    //** Check the prefix VA's first
+    it = tbx_list_iter_search(kv->vattr_prefix, attr, -1);
+    tbx_list_next(&it, (tbx_list_key_t **)&ca, (tbx_list_data_t **)&va);
+    if (va != NULL) {
+        n = (int)(long)va->priv;  //*** HACKERY **** to get the attribute length
+        if (strncmp(attr, va->attribute, n) != 0) va = NULL;
+    }
+
+    //** Now check the normal VA's
+    if (va == NULL) va = apr_hash_get(kv->vattr_hash, attr, APR_HASH_KEY_STRING);
+
+    if (va != NULL) {  //** Only the timestamp and append VA's write and they use the caller's batch
+        if (va == &(kv->timestamp_pva)) return(kv_va_timestamp_set(va, os, creds, fd, attr, val, v_size, atype, b));
+        if (va == &(kv->append_pva)) return(kv_va_append_set(va, os, creds, fd, attr, val, v_size, atype, b));
+        return(va->set(va, os, creds, (os_fd_t *)fd, attr, val, v_size, atype));
+    }
+
+    if (b != NULL) return(kv_set_real_attr(os, creds, fd, attr, val, v_size, atype, append_val, b));
+
+    kv_batch_init(&local);
+    n = kv_set_real_attr(os, creds, fd, attr, val, v_size, atype, append_val, &local);
+    if (kv_batch_destroy(kv, &local) != 0) n = 1;
+
+    return(n);
+}
+
+//***********************************************************************
+// kv_va_create_get_attr - Returns the object creation time in secs since epoch
+//***********************************************************************
+
+int kv_va_create_get_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *key, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    kv_inode_t inode;
+    int bufsize;
+    char buffer[32];
+
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    if (kv_inode_get(kv, kv->ropt, fd->ino, &inode) != 0) {
+        *v_size = -1;
+        return(1);
+    }
+
+    snprintf(buffer, sizeof(buffer), I64T, inode.ctime);
+    bufsize = strlen(buffer);
+    kv_inode_clear(&inode);
+
+    return(osf_store_val(buffer, bufsize, val, v_size));
+}
+
+//***********************************************************************
+// kv_va_link_get_attr - Returns the object link information
+//***********************************************************************
+
+int kv_va_link_get_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *key, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    kv_inode_t inode;
+    int err;
+
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    if (kv_inode_get(kv, kv->ropt, fd->ino, &inode) != 0) {
+        *v_size = 0;
+        return(0);
+    }
+
+    if (inode.link == NULL) {
+        *v_size = 0;
+        *val = NULL;
+        return(0);
+    }
+
+    err = osf_store_val(inode.link, strlen(inode.link), val, v_size);
+    kv_inode_clear(&inode);
+
+    return(err);
+}
+
+//***********************************************************************
+// kv_va_link_count_get_attr - Returns the object link count information
+//***********************************************************************
+
+int kv_va_link_count_get_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *key, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    kv_inode_t inode;
+    char buffer[32];
+    int n;
+
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    n = 1;
+    if (kv_inode_get(kv, kv->ropt, fd->ino, &inode) == 0) {
+        n = inode.nlink;
+        kv_inode_clear(&inode);
+    }
+
+    n = snprintf(buffer, 32, "%d", n);
+    return(osf_store_val(buffer, n, val, v_size));
+}
+
+//***********************************************************************
+// kv_va_type_get_attr - Returns the object type information
+//***********************************************************************
+
+int kv_va_type_get_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *key, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    int ftype, bufsize;
+    char buffer[32];
+
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    ftype = kv_object_type(fd->os, kv->ropt, fd->object_name, NULL);
+
+    snprintf(buffer, sizeof(buffer), "%d", ftype);
+    bufsize = strlen(buffer);
+
+    log_printf(15, "fname=%s type=%s v_size=%d\n", fd->object_name, buffer, *v_size);
+
+    return(osf_store_val(buffer, bufsize, val, v_size));
+}
+
+//***********************************************************************
+// kv_va_lock_get_attr - Returns the file lock information
+//***********************************************************************
+
+int kv_va_lock_get_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *key, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    oskv_fd_t *pfd;
+    kv_fobj_lock_t *fol;
+    kv_fobj_lock_task_t *handle;
+    int used;
+    int bufsize = 10*1024;
+    char result[bufsize];
+    char *buf;
+
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    apr_thread_mutex_lock(kv->fobj_lock);
+
+    fol = tbx_list_search(kv->fobj_table, fd->object_name);
+    if (fol == NULL) {
+        *val = NULL;
+        *v_size = 0;
+        apr_thread_mutex_unlock(kv->fobj_lock);
+        return(0);
+    }
+
+    //** Figure out the buffer
+    buf = result;
+    if (*v_size > 0) {
+        buf = (char *)(*val);
+        bufsize = *v_size;
+    }
+
+    used = 0;
+    tbx_append_printf(buf, &used, bufsize, "[os.lock]\n");
+
+    //** Print the active info
+    if (fol->read_count > 0) {
+        tbx_append_printf(buf, &used, bufsize, "active_mode=READ\n");
+        tbx_append_printf(buf, &used, bufsize, "active_count=%d\n", fol->read_count);
+    } else {
+        tbx_append_printf(buf, &used, bufsize, "active_mode=WRITE\n");
+        tbx_append_printf(buf, &used, bufsize, "active_count=%d\n", fol->write_count);
+    }
+
+    tbx_stack_move_to_top(fol->active_stack);
+    while ((pfd = (oskv_fd_t *)tbx_stack_get_current_data(fol->active_stack)) != NULL) {
+        tbx_append_printf(buf, &used, bufsize, "active_id=%s:" LU ":%s\n", pfd->id, pfd->uuid, (pfd->mode == OS_MODE_READ_BLOCKING) ? "READ" : "WRITE");
+        tbx_stack_move_down(fol->active_stack);
+    }
+
+    tbx_append_printf(buf, &used, bufsize, "\n");
+    tbx_append_printf(buf, &used, bufsize, "pending_count=%d\n", tbx_stack_count(fol->stack));
+    tbx_stack_move_to_top(fol->stack);
+    while ((handle = (kv_fobj_lock_task_t *)tbx_stack_get_current_data(fol->stack)) != NULL) {
+        tbx_append_printf(buf, &used, bufsize, "pending_id=%s:" LU ":%s\n", handle->fd->id, handle->fd->uuid, (handle->fd->mode == OS_MODE_READ_BLOCKING) ? "READ" : "WRITE");
+        tbx_stack_move_down(fol->stack);
+    }
+
+    apr_thread_mutex_unlock(kv->fobj_lock);
+
+    if (*v_size < 0) *val = strdup(buf);
+    *v_size = strlen(buf);
+
+    return(0);
+}
+
+//***********************************************************************
+// kv_va_attr_type_get_attr - Returns the attribute type information
+//***********************************************************************
+
+int kv_va_attr_type_get_attr(lio_os_virtual_attr_t *myva, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *fullkey, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    lio_os_virtual_attr_t *va;
+    char key[KV_KEY_MAX];
+    char *data, *errstr = NULL;
+    size_t nbytes;
+    int ftype, bufsize, n;
+    char *attr;
+    char buffer[32];
+
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    n = (int)(long)myva->priv;  //** HACKERY ** to get the attribute prefix length
+    attr = &(fullkey[n+1]);
+
+    //** See if we have a VA first
+    ftype = 0;
+    va = apr_hash_get(kv->vattr_hash, attr, APR_HASH_KEY_STRING);
+    if (va != NULL) {
+        ftype = OS_OBJECT_VIRTUAL_FLAG;
+    } else {
+        n = kv_key_make(key, KV_ATTR, fd->ino, attr, -1);
+        data = (n < 0) ? NULL : leveldb_get(kv->db, kv->ropt, key, n, &nbytes, &errstr);
+        if (errstr != NULL) leveldb_free(errstr);
+        if (data != NULL) {
+            ftype = ((nbytes > 0) && (data[0] == KV_ATTR_LINK)) ? OS_OBJECT_SYMLINK_FLAG|OS_OBJECT_FILE_FLAG : OS_OBJECT_FILE_FLAG;
+            leveldb_free(data);
+        }
+    }
+
+    snprintf(buffer, sizeof(buffer), "%d", ftype);
+    bufsize = strlen(buffer);
+
+    return(osf_store_val(buffer, bufsize, val, v_size));
+}
+
+//***********************************************************************
+// kv_va_attr_link_get_attr - Returns the attribute link information
+//***********************************************************************
+
+int kv_va_attr_link_get_attr(lio_os_virtual_attr_t *myva, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *fullkey, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    lio_os_virtual_attr_t *va;
+    tbx_list_iter_t it;
+    char buffer[OS_PATH_MAX];
+    char *key, *ca;
+    int n;
+
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    n = (int)(long)myva->priv;  //** HACKERY ** to get the attribute prefix length
+    key = &(fullkey[n+1]);
+
+    //** Do a Virtual Attr check
+    //** Check the prefix VA's first
+    it = tbx_list_iter_search(kv->vattr_prefix, key, -1);
+    tbx_list_next(&it, (tbx_list_key_t **)&ca, (tbx_list_data_t **)&va);
+    if (va != NULL) {
+        n = (int)(long)va->priv;  //*** HACKERY **** to get the attribute length
+        if (strncmp(key, va->attribute, n) == 0) {  //** Prefix matches
+            return(va->get_link(va, os, creds, ofd, key, val, v_size, atype));
+        }
+    }
+
+    //** Now check the normal VA's
+    va = apr_hash_get(kv->vattr_hash, key, APR_HASH_KEY_STRING);
+    if (va != NULL) {
+        return(va->get_link(va, os, creds, ofd, key, val, v_size, atype));
+    }
+
+    //** Now check the normal attributes
+    if (kv_attr_link_get(kv, fd->ino, key, buffer, &n) == 0) {
+        return(osf_store_val(buffer, n, val, v_size));
+    }
+
+    *v_size = 0;
+
+    return(0);
+}
+
+//***********************************************************************
+// kv_va_timestamp_set - Sets the requested timestamp.  If b is NULL the
+//     change is written immediately otherwise it's added to the batch.
+//***********************************************************************
+
+int kv_va_timestamp_set(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *fullkey, void *val, int v_size, int *atype, kv_batch_t *b)
+{
+    char buffer[512];
+    char *key;
+    int64_t curr_time;
+    int n;
+
+    n = (int)(long)va->priv;  //** HACKERY ** to get the attribute prefix length
+    key = &(fullkey[n+1]);
+
+    if ((int)strlen(fullkey) <= n) {  //** Nothing to do so return;
+        *atype = OS_OBJECT_VIRTUAL_FLAG;
+        return(1);
+    }
+
+    curr_time = apr_time_sec(apr_time_now());
+    if (v_size > 0) {
+        n = snprintf(buffer, sizeof(buffer), I64T "|%.*s", curr_time, v_size, (char *)val);
+    } else {
+        n = snprintf(buffer, sizeof(buffer), I64T, curr_time);
+    }
+    if (n >= (int)sizeof(buffer)) n = sizeof(buffer)-1;
+
+    n = kv_set_attr(os, creds, fd, key, (void *)buffer, n, atype, 0, b);
+    *atype |= OS_OBJECT_VIRTUAL_FLAG;
+
+    return(n);
+}
+
+//***********************************************************************
+// kv_va_timestamp_set_attr - Sets the requested timestamp
+//***********************************************************************
+
+int kv_va_timestamp_set_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *fullkey, void *val, int v_size, int *atype)
+{
+    return(kv_va_timestamp_set(va, os, creds, (oskv_fd_t *)ofd, fullkey, val, v_size, atype, NULL));
+}
+
+//***********************************************************************
+// kv_va_timestamp_get_attr - Returns the requested timestamp or current time
+//    if no timestamp is specified
+//***********************************************************************
+
+int kv_va_timestamp_get_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *fullkey, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    char buffer[32];
+    int64_t curr_time;
+    int n;
+
+    n = (int)(long)va->priv;  //** HACKERY ** to get the attribute prefix length
+
+    if ((int)strlen(fullkey) > n) {  //** Normal attribute timestamp
+        n = kv_get_attr(os, creds, fd, &(fullkey[n+1]), val, v_size, atype);
+        *atype |= OS_OBJECT_VIRTUAL_FLAG;
+    } else {  //** No attribute specified so just return my time
+        curr_time = apr_time_sec(apr_time_now());
+        n = snprintf(buffer, sizeof(buffer), I64T, curr_time);
+        *atype = OS_OBJECT_VIRTUAL_FLAG;
+        n = osf_store_val(buffer, n, val, v_size);
+    }
+
+    return(n);
+}
+
+//***********************************************************************
+// kv_va_timestamp_get_link_attr - Returns the requested timestamp's link if available
+//***********************************************************************
+
+int kv_va_timestamp_get_link_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *fullkey, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    char link[OS_PATH_MAX];
+    int n;
+
+    n = (int)(long)va->priv;  //** HACKERY ** to get the attribute prefix length
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+
+    if (((int)strlen(fullkey) > n) && (kv_attr_link_get(kv, fd->ino, &(fullkey[n+1]), link, &n) == 0)) {
+        return(osf_store_val(link, n, val, v_size));
+    }
+
+    *v_size = 0;
+    return(0);
+}
+
+//***********************************************************************
+// kv_va_append_set - Appends the data to the attribute.  If b is NULL the
+//     change is written immediately otherwise it's added to the batch.
+//***********************************************************************
+
+int kv_va_append_set(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, oskv_fd_t *fd, char *fullkey, void *val, int v_size, int *atype, kv_batch_t *b)
+{
+    int n;
+
+    n = (int)(long)va->priv;  //** HACKERY ** to get the attribute prefix length
+
+    if ((int)strlen(fullkey) <= n) {  //** Nothing to do so return;
+        *atype = OS_OBJECT_VIRTUAL_FLAG;
+        return(1);
+    }
+
+    n = kv_set_attr(os, creds, fd, &(fullkey[n+1]), val, v_size, atype, 1, b);
+    *atype |= OS_OBJECT_VIRTUAL_FLAG;
+
+    return(n);
+}
+
+//***********************************************************************
+// kv_va_append_set_attr - Appends the data to the attribute
+//***********************************************************************
+
+int kv_va_append_set_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *fullkey, void *val, int v_size, int *atype)
+{
+    return(kv_va_append_set(va, os, creds, (oskv_fd_t *)ofd, fullkey, val, v_size, atype, NULL));
+}
+
+//***********************************************************************
+// kv_va_append_get_attr - Just returns the attr after peeling off the PVA
+//***********************************************************************
+
+int kv_va_append_get_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *fullkey, void **val, int *v_size, int *atype)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    int n;
+
+    n = (int)(long)va->priv;  //** HACKERY ** to get the attribute prefix length
+
+    if ((int)strlen(fullkey) > n) {  //** Normal attribute
+        n = kv_get_attr(os, creds, fd, &(fullkey[n+1]), val, v_size, atype);
+        *atype |= OS_OBJECT_VIRTUAL_FLAG;
+    } else {  //** No attribute specified so nothing to do
+        *atype = OS_OBJECT_VIRTUAL_FLAG;
+        *v_size = 0;
+        n = 0;
+    }
+
+    return(n);
+}
+
+//***********************************************************************
+// kv_va_null_set_attr - Dummy routine since it can't be set
+//***********************************************************************
+
+int kv_va_null_set_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *fd, char *key, void *val, int v_size, int *atype)
+{
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+    return(-1);
+}
+
+//***********************************************************************
+// kv_va_null_get_link_attr - Routine for key's without links
+//***********************************************************************
+
+int kv_va_null_get_link_attr(lio_os_virtual_attr_t *va, lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *fd, char *key, void **val, int *v_size, int *atype)
+{
+    *atype = OS_OBJECT_VIRTUAL_FLAG;
+    *v_size = 0;
+    return(0);
+}
+
+//***********************************************************************
+// kv_attr_lock - Locks the object and the targets of any attribute links
+//     being changed.  Returns the number of locks held.
+//***********************************************************************
+
+int kv_attr_lock(lio_object_service_fn_t *os, oskv_fd_t *fd, char **key, int n, int *slot)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    uint64_t ino[n+1];
+    char rkey[OS_PATH_MAX];
+    int i, m;
+
+    m = 0;
+    ino[m++] = fd->ino;
+    for (i=0; i<n; i++) {
+        if (kv_attr_resolve(os, kv->ropt, NULL, fd, key[i], &(ino[m]), rkey) == 0) {
+            if (ino[m] != fd->ino) m++;
+        }
+    }
+
+    return(kv_multi_lock(kv, ino, m, slot));
+}
+
+//***********************************************************************
+// kv_get_multiple_attr_fn - Does the actual attribute retreival.  All the
+//     keys are read from the same snapshot so no locking is needed.
+//***********************************************************************
+
+gop_op_status_t kv_get_multiple_attr_fn(void *arg, int id)
+{
+    oskv_attr_op_t *op = (oskv_attr_op_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    const leveldb_snapshot_t *snap;
+    leveldb_readoptions_t *ropt;
+    int err, i, atype;
+
+    if (op->n > 1) {
+        snap = leveldb_create_snapshot(kv->db);
+        ropt = leveldb_readoptions_create();
+        leveldb_readoptions_set_snapshot(ropt, snap);
+    } else {
+        snap = NULL;
+        ropt = kv->ropt;
+    }
+
+    err = 0;
+    for (i=0; i<op->n; i++) {
+        err += kv_get_attr_ro(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype, ropt, NULL);
+        log_printf(15, "i=%d key=%s v_size=%d atype=%d err=%d\n", i, op->key[i], op->v_size[i], atype, err);
+    }
+
+    if (snap != NULL) {
+        leveldb_readoptions_destroy(ropt);
+        leveldb_release_snapshot(kv->db, snap);
+    }
+
+    return((err == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// oskv_get_attr - Retreives a single object attribute
+//   If *v_size < 0 then space is allocated up to a max of abs(v_size)
+//   and upon return *v_size contains the bytes loaded
+//***********************************************************************
+
+gop_op_generic_t *oskv_get_attr(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *key, void **val, int *v_size)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_attr_op_t *op;
+
+    tbx_type_malloc(op, oskv_attr_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd = (oskv_fd_t *)ofd;
+    op->key = &(op->key_tmp);
+    op->key_tmp = key;
+    op->val = val;
+    op->v_size = v_size;
+    op->n = 1;
+
+    return(gop_tp_op_new(kv->tpc, NULL, kv_get_multiple_attr_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_get_multiple_attrs - Retreives multiple object attribute
+//   If *v_size < 0 then space is allocated up to a max of abs(v_size)
+//   and upon return *v_size contains the bytes loaded
+//***********************************************************************
+
+gop_op_generic_t *oskv_get_multiple_attrs(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char **key, void **val, int *v_size, int n)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_attr_op_t *op;
+
+    tbx_type_malloc(op, oskv_attr_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd = (oskv_fd_t *)ofd;
+    op->key = key;
+    op->val = val;
+    op->v_size = v_size;
+    op->n = n;
+
+    return(gop_tp_op_new(kv->tpc, NULL, kv_get_multiple_attr_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// kv_set_multiple_attr_fn - Does the actual attribute setting.  All the
+//     changes are applied with a single write.
+//***********************************************************************
+
+gop_op_status_t kv_set_multiple_attr_fn(void *arg, int id)
+{
+    oskv_attr_op_t *op = (oskv_attr_op_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    kv_inode_t inode;
+    kv_batch_t b;
+    int err, i, atype, n_locks;
+    int slot[op->n+1];
+
+    n_locks = kv_attr_lock(op->os, op->fd, op->key, op->n, slot);
+
+    //** Make sure the object wasn't removed out from under us so we don't orphan the attrs
+    if (kv_inode_get(kv, kv->ropt, op->fd->ino, &inode) != 0) {
+        kv_multi_unlock(kv, slot, n_locks);
+        log_printf(15, "Missing object! fname=%s\n", op->fd->object_name);
+        return(gop_failure_status);
+    }
+    kv_inode_clear(&inode);
+
+    kv_batch_init(&b);
+    err = 0;
+    for (i=0; i<op->n; i++) {
+        err += kv_set_attr(op->os, op->creds, op->fd, op->key[i], op->val[i], op->v_size[i], &atype, 0, &b);
+    }
+    if (kv_batch_destroy(kv, &b) != 0) err++;
+
+    kv_multi_unlock(kv, slot, n_locks);
+
+    return((err == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// oskv_set_attr - Sets a single object attribute
+//   If val == NULL the attribute is deleted
+//***********************************************************************
+
+gop_op_generic_t *oskv_set_attr(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char *key, void *val, int v_size)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_attr_op_t *op;
+
+    tbx_type_malloc(op, oskv_attr_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd = (oskv_fd_t *)ofd;
+    op->key = &(op->key_tmp);
+    op->key_tmp = key;
+    op->val = &(op->val_tmp);
+    op->val_tmp = val;
+    op->v_size = &(op->v_tmp);
+    op->v_tmp = v_size;
+    op->n = 1;
+
+    return(gop_tp_op_new(kv->tpc, NULL, kv_set_multiple_attr_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_set_multiple_attrs - Sets multiple object attributes
+//   If val[i] == NULL for the attribute is deleted
+//***********************************************************************
+
+gop_op_generic_t *oskv_set_multiple_attrs(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, char **key, void **val, int *v_size, int n)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_attr_op_t *op;
+
+    tbx_type_malloc(op, oskv_attr_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd = (oskv_fd_t *)ofd;
+    op->key = key;
+    op->val = val;
+    op->v_size = v_size;
+    op->n = n;
+
+    return(gop_tp_op_new(kv->tpc, NULL, kv_set_multiple_attr_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_copy_multiple_attrs_fn - Actually copies the attributes
+//***********************************************************************
+
+gop_op_status_t oskv_copy_multiple_attrs_fn(void *arg, int id)
+{
+    oskv_copy_attr_t *op = (oskv_copy_attr_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    gop_op_status_t status;
+    kv_batch_t b;
+    uint64_t ino[2];
+    int slot[2];
+    void *val;
+    int v_size;
+    int i, err, atype, n_locks;
+
+    ino[0] = op->fd_src->ino;
+    ino[1] = op->fd_dest->ino;
+    n_locks = kv_multi_lock(kv, ino, 2, slot);
+
+    kv_batch_init(&b);
+    status = gop_success_status;
+    for (i=0; i<op->n; i++) {
+        if ((osaz_attr_access(kv->osaz, op->creds, op->fd_src->object_name, op->key_src[i], OS_MODE_READ_IMMEDIATE) == 1) &&
+                (osaz_attr_create(kv->osaz, op->creds, op->fd_dest->object_name, op->key_dest[i]) == 1)) {
+
+            v_size = -kv->max_copy;
+            val = NULL;
+            err = kv_get_attr_ro(op->os, op->creds, op->fd_src, op->key_src[i], &val, &v_size, &atype, kv->ropt, &b);  //** Sees our own changes
+            if (err == 0) {
+                err = kv_set_attr(op->os, op->creds, op->fd_dest, op->key_dest[i], val, v_size, &atype, 0, &b);
+                if (val != NULL) free(val);
+            }
+        } else {
+            err = 1;
+        }
+
+        if (err != 0) {
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code++;
+        }
+    }
+
+    if (kv_batch_destroy(kv, &b) != 0) {
+        status.op_status = OP_STATE_FAILURE;
+        status.error_code++;
+    }
+
+    kv_multi_unlock(kv, slot, n_locks);
+
+    log_printf(15, "fsrc=%s fdest=%s err=%d\n", op->fd_src->object_name, op->fd_dest->object_name, status.error_code);
+
+    return(status);
+}
+
+//***********************************************************************
+// oskv_copy_multiple_attrs - Generates a copy object multiple attribute operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_copy_multiple_attrs(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *fd_src, char **key_src, os_fd_t *fd_dest, char **key_dest, int n)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_copy_attr_t *op;
+
+    tbx_type_malloc_clear(op, oskv_copy_attr_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd_src = (oskv_fd_t *)fd_src;
+    op->fd_dest = (oskv_fd_t *)fd_dest;
+    op->key_src = key_src;
+    op->key_dest = key_dest;
+    op->n = n;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_copy_multiple_attrs_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_copy_attr - Generates a copy object attribute operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_copy_attr(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *fd_src, char *key_src, os_fd_t *fd_dest, char *key_dest)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_copy_attr_t *op;
+
+    tbx_type_malloc_clear(op, oskv_copy_attr_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd_src = (oskv_fd_t *)fd_src;
+    op->fd_dest = (oskv_fd_t *)fd_dest;
+    op->key_src = &(op->single_src);
+    op->single_src = key_src;
+    op->key_dest = &(op->single_dest);
+    op->single_dest = key_dest;
+    op->n = 1;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_copy_multiple_attrs_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_symlink_multiple_attrs_fn - Actually links the multiple attrs
+//***********************************************************************
+
+gop_op_status_t oskv_symlink_multiple_attrs_fn(void *arg, int id)
+{
+    oskv_copy_attr_t *op = (oskv_copy_attr_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    gop_op_status_t status;
+    kv_batch_t b;
+    char key[KV_KEY_MAX];
+    char *link, *val;
+    size_t nbytes;
+    int slot[1];
+    int i, n, klen, n_locks, from_db;
+
+    n_locks = kv_multi_lock(kv, &(op->fd_dest->ino), 1, slot);
+
+    kv_batch_init(&b);
+    status = gop_success_status;
+    for (i=0; i<op->n; i++) {
+        klen = kv_key_make(key, KV_ATTR, op->fd_dest->ino, op->key_dest[i], -1);
+        if ((klen < 0) || (osaz_attr_create(kv->osaz, op->creds, op->fd_dest->object_name, op->key_dest[i]) == 0)) {
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code++;
+            continue;
+        }
+
+        //** Like a symlink it can't replace an existing attribute
+        if (kv_batch_get(kv, kv->ropt, &b, key, klen, &val, &nbytes, &from_db) != 0) val = NULL;
+        if (val != NULL) {
+            if (from_db) leveldb_free(val);
+            log_printf(15, "Attribute exists! fname=%s key=%s\n", op->fd_dest->object_name, op->key_dest[i]);
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code++;
+            continue;
+        }
+
+        n = strlen(op->src_path[i]) + strlen(op->key_src[i]) + 3;
+        tbx_type_malloc(link, char, n);
+        n = snprintf(link, n, "%c%s/%s", KV_ATTR_LINK, op->src_path[i], op->key_src[i]);
+        kv_batch_put(&b, key, klen, link, n);
+        free(link);
+    }
+
+    if (kv_batch_destroy(kv, &b) != 0) {
+        status.op_status = OP_STATE_FAILURE;
+        status.error_code++;
+    }
+    kv_multi_unlock(kv, slot, n_locks);
+
+    return(status);
+}
+
+//***********************************************************************
+// oskv_symlink_multiple_attrs - Generates a link multiple attribute operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_symlink_multiple_attrs(lio_object_service_fn_t *os, lio_creds_t *creds, char **src_path, char **key_src, os_fd_t *fd_dest, char **key_dest, int n)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_copy_attr_t *op;
+
+    tbx_type_malloc_clear(op, oskv_copy_attr_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = src_path;
+    op->fd_dest = (oskv_fd_t *)fd_dest;
+    op->key_src = key_src;
+    op->key_dest = key_dest;
+    op->n = n;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_symlink_multiple_attrs_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_symlink_attr - Generates a link attribute operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_symlink_attr(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *key_src, os_fd_t *fd_dest, char *key_dest)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_copy_attr_t *op;
+
+    tbx_type_malloc_clear(op, oskv_copy_attr_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = &(op->single_path);
+    op->single_path = src_path;
+    op->fd_dest = (oskv_fd_t *)fd_dest;
+    op->key_src = &(op->single_src);
+    op->single_src = key_src;
+    op->key_dest = &(op->single_dest);
+    op->single_dest = key_dest;
+    op->n = 1;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_symlink_multiple_attrs_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_move_multiple_attrs_fn - Actually Moves the object attrs
+//***********************************************************************
+
+gop_op_status_t oskv_move_multiple_attrs_fn(void *arg, int id)
+{
+    oskv_move_attr_t *op = (oskv_move_attr_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    lio_os_virtual_attr_t *va1, *va2;
+    gop_op_status_t status;
+    kv_batch_t b;
+    char skey[KV_KEY_MAX], dkey[KV_KEY_MAX];
+    char *val;
+    size_t nbytes;
+    int slot[1];
+    int i, err, slen, dlen, n_locks, from_db;
+
+    n_locks = kv_multi_lock(kv, &(op->fd->ino), 1, slot);
+
+    kv_batch_init(&b);
+    status = gop_success_status;
+    for (i=0; i<op->n; i++) {
+        err = 1;
+        if ((osaz_attr_create(kv->osaz, op->creds, op->fd->object_name, op->key_new[i]) == 1) &&
+                (osaz_attr_remove(kv->osaz, op->creds, op->fd->object_name, op->key_old[i]) == 1)) {
+
+            //** Do a Virtual Attr check
+            va1 = apr_hash_get(kv->vattr_hash, op->key_old[i], APR_HASH_KEY_STRING);
+            va2 = apr_hash_get(kv->vattr_hash, op->key_new[i], APR_HASH_KEY_STRING);
+            slen = kv_key_make(skey, KV_ATTR, op->fd->ino, op->key_old[i], -1);
+            dlen = kv_key_make(dkey, KV_ATTR, op->fd->ino, op->key_new[i], -1);
+            if ((va1 == NULL) && (va2 == NULL) && (slen > 0) && (dlen > 0)) {
+                if (kv_batch_get(kv, kv->ropt, &b, skey, slen, &val, &nbytes, &from_db) != 0) val = NULL;
+                if (val != NULL) {  //** Links are moved as is
+                    kv_batch_put(&b, dkey, dlen, val, nbytes);
+                    kv_batch_del(&b, skey, slen);
+                    if (from_db) leveldb_free(val);
+                    err = 0;
+                }
+            }
+        }
+
+        if (err != 0) {
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code++;
+        }
+    }
+
+    if (kv_batch_destroy(kv, &b) != 0) {
+        status.op_status = OP_STATE_FAILURE;
+        status.error_code++;
+    }
+    kv_multi_unlock(kv, slot, n_locks);
+
+    return(status);
+}
+
+//***********************************************************************
+// oskv_move_multiple_attrs - Generates a move object attributes operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_move_multiple_attrs(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *fd, char **key_old, char **key_new, int n)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_move_attr_t *op;
+
+    tbx_type_malloc_clear(op, oskv_move_attr_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd = (oskv_fd_t *)fd;
+    op->key_old = key_old;
+    op->key_new = key_new;
+    op->n = n;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_move_multiple_attrs_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_move_attr - Generates a move object attribute operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_move_attr(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *fd, char *key_old, char *key_new)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_move_attr_t *op;
+
+    tbx_type_malloc_clear(op, oskv_move_attr_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->fd = (oskv_fd_t *)fd;
+    op->key_old = &(op->single_old);
+    op->single_old = key_old;
+    op->key_new = &(op->single_new);
+    op->single_new = key_new;
+    op->n = 1;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_move_multiple_attrs_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// kv_regex_match - Returns 0 if the string matches any of the expressions
+//***********************************************************************
+
+int kv_regex_match(lio_os_regex_table_t *rex, const char *str)
+{
+    int i;
+
+    for (i=0; i<rex->n; i++) {
+        if (rex->regex_entry[i].fixed == 1) {
+            if (strcmp(rex->regex_entry[i].expression, str) == 0) return(0);
+        } else if (regexec(&(rex->regex_entry[i].compiled), str, 0, NULL, 0) == 0) {
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+//***********************************************************************
+// oskv_next_attr - Returns the next matching attribute
+//***********************************************************************
+
+int oskv_next_attr(os_attr_iter_t *oit, char **key, void **val, int *v_size)
+{
+    oskv_attr_iter_t *it = (oskv_attr_iter_t *)oit;
+    oskv_priv_t *kv = (oskv_priv_t *)it->os->priv;
+    apr_ssize_t klen;
+    lio_os_virtual_attr_t *va;
+    const char *k;
+    size_t n;
+    int atype;
+    char attr[OS_PATH_MAX];
+
+    //** Check the VA's 1st
+    while (it->va_index != NULL) {
+        apr_hash_this(it->va_index, (const void **)key, &klen, (void **)&va);
+        it->va_index = apr_hash_next(it->va_index);
+        if (kv_regex_match(it->regex, va->attribute) == 0) { //** got a match
+            if (osaz_attr_access(kv->osaz, it->creds, it->fd->object_name, va->attribute, OS_MODE_READ_BLOCKING) == 1) {
+                *v_size = it->v_max;
+                kv_get_attr(it->fd->os, it->creds, it->fd, va->attribute, val, v_size, &atype);
+                *key = strdup(va->attribute);
+                return(0);
+            }
+        }
+    }
+
+    //** Now scan the object's attributes.  They come back sorted
+    while (kv_has_prefix(it->it, it->prefix, KV_PREFIX_LEN) == 1) {
+        k = leveldb_iter_key(it->it, &n);
+        n -= KV_PREFIX_LEN;
+        if (n >= OS_PATH_MAX) n = OS_PATH_MAX-1;
+        memcpy(attr, k + KV_PREFIX_LEN, n);
+        attr[n] = 0;
+        leveldb_iter_next(it->it);
+
+        if (kv_regex_match(it->regex, attr) == 0) { //** got a match
+            if (osaz_attr_access(kv->osaz, it->creds, it->fd->object_name, attr, OS_MODE_READ_BLOCKING) == 1) {
+                *v_size = it->v_max;
+                kv_get_attr(it->fd->os, it->creds, it->fd, attr, val, v_size, &atype);
+                *key = strdup(attr);
+                return(0);
+            }
+        }
+    }
+
+    return(-1);
+}
+
+//***********************************************************************
+// oskv_create_attr_iter - Creates an attribute iterator
+//   Each entry in the attr table corresponds to a different regex
+//   for selecting attributes
+//***********************************************************************
+
+os_attr_iter_t *oskv_create_attr_iter(lio_object_service_fn_t *os, lio_creds_t *creds, os_fd_t *ofd, lio_os_regex_table_t *attr, int v_max)
+{
+    oskv_fd_t *fd = (oskv_fd_t *)ofd;
+    oskv_priv_t *kv = (oskv_priv_t *)fd->os->priv;
+    oskv_attr_iter_t *it;
+
+    tbx_type_malloc_clear(it, oskv_attr_iter_t, 1);
+
+    it->os = os;
+
+    //** APR doesn't have a hash iterator destroy so use a pool just for it
+    assert_result(apr_pool_create(&(it->mpool), NULL), APR_SUCCESS);
+    it->va_index = apr_hash_first(it->mpool, kv->vattr_hash);
+
+    kv_key_make(it->prefix, KV_ATTR, fd->ino, NULL, 0);
+    it->it = leveldb_create_iterator(kv->db, kv->ropt);
+    leveldb_iter_seek(it->it, it->prefix, KV_PREFIX_LEN);
+
+    it->regex = attr;
+    it->fd = fd;
+    it->creds = creds;
+    it->v_max = v_max;
+
+    return((os_attr_iter_t *)it);
+}
+
+//***********************************************************************
+// oskv_destroy_attr_iter - Destroys an attribute iterator
+//***********************************************************************
+
+void oskv_destroy_attr_iter(os_attr_iter_t *oit)
+{
+    oskv_attr_iter_t *it = (oskv_attr_iter_t *)oit;
+
+    leveldb_iter_destroy(it->it);
+    apr_pool_destroy(it->mpool);
+    free(it);
+}
+
+//***********************************************************************
+// kv_level_init - Sets up a directory level for scanning
+//***********************************************************************
+
+void kv_level_init(kv_obj_level_t *itl, const char *path, uint64_t ino)
+{
+    snprintf(itl->path, OS_PATH_MAX, "%s", path);
+    itl->ino = ino;
+    itl->frag_done = 0;
+    itl->pending = NULL;
+    kv_key_make(itl->prefix, KV_DENTRY, ino, NULL, 0);
+}
+
+//***********************************************************************
+// kv_level_close - Releases the level's directory scan
+//***********************************************************************
+
+void kv_level_close(kv_obj_level_t *itl)
+{
+    if (itl->it != NULL) leveldb_iter_destroy(itl->it);
+    itl->it = NULL;
+    if (itl->pending != NULL) free(itl->pending);
+    itl->pending = NULL;
+}
+
+//***********************************************************************
+// kv_level_next - Returns the next entry in the directory.  Fixed levels
+//     just do a single lookup.  Returns 0 when there are no more entries.
+//***********************************************************************
+
+int kv_level_next(oskv_priv_t *kv, kv_obj_level_t *itl, char *name, uint64_t *ino, int *dtype)
+{
+    const char *key, *val;
+    size_t klen, vlen;
+    int n;
+
+    if (itl->fragment != NULL) {
+        if (itl->frag_done == 1) return(0);
+        itl->frag_done = 1;
+        if (kv_dentry_get(kv, kv->ropt, itl->ino, itl->fragment, -1, ino, dtype) != 0) return(0);
+        snprintf(name, OS_PATH_MAX, "%s", itl->fragment);
+        return(1);
+    }
+
+    if (itl->it == NULL) {
+        itl->it = leveldb_create_iterator(kv->db, kv->ropt);
+        leveldb_iter_seek(itl->it, itl->prefix, KV_PREFIX_LEN);
+    }
+
+    while (kv_has_prefix(itl->it, itl->prefix, KV_PREFIX_LEN) == 1) {
+        key = leveldb_iter_key(itl->it, &klen);
+        val = leveldb_iter_value(itl->it, &vlen);
+        n = klen - KV_PREFIX_LEN;
+        if ((vlen != 9) || (n >= OS_PATH_MAX)) {  //** Skip anything corrupt
+            leveldb_iter_next(itl->it);
+            continue;
+        }
+
+        memcpy(name, key + KV_PREFIX_LEN, n);
+        name[n] = 0;
+        *ino = kv_ino_decode(val);
+        *dtype = (unsigned char)val[8];
+        leveldb_iter_next(itl->it);
+        return(1);
+    }
+
+    return(0);
+}
+
+//***********************************************************************
+// kv_object_match - Returns 0 if the object name matches the object regex
+//***********************************************************************
+
+int kv_object_match(oskv_object_iter_t *it, const char *name)
+{
+    if (it->object_regex == NULL) return(0);
+    if (it->obj_fixed != NULL) return(strcmp(name, it->obj_fixed));
+    return(regexec(it->object_preg, name, 0, NULL, 0));
+}
+
+//***********************************************************************
+// kv_next_object - Returns the next matching object.  The directories
+//     are scanned with a prefix iteration so the results come back in
+//     sorted order.  Like os_file directories are returned after their
+//     contents.
+//***********************************************************************
+
+int kv_next_object(oskv_object_iter_t *it, char **myfname, int *prefix_len)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)it->os->priv;
+    kv_obj_level_t *itl, *child;
+    uint64_t ino, target;
+    int n, dtype, ftype, do_recurse, match;
+    char entry[OS_PATH_MAX];
+    char fname[OS_PATH_MAX];
+
+    *prefix_len = 0;
+    *myfname = NULL;
+    if (it->finished == 1) return(0);
+
+    n = it->table->n;
+    if (n == 0) *prefix_len = 1;
+
+    while (it->curr_level >= 0) {
+        itl = (it->curr_level < n) ? &(it->level_info[it->curr_level]) : (kv_obj_level_t *)tbx_stack_top_first(it->recurse_stack);
+
+        //** Finished with a directory's contents so return it
+        if (itl->pending != NULL) {
+            snprintf(fname, OS_PATH_MAX, "%s/%s", itl->path, itl->pending);
+            ftype = itl->pending_type;
+            match = kv_object_match(it, itl->pending);
+            free(itl->pending);
+            itl->pending = NULL;
+            if (((ftype & it->object_types) > 0) && (match == 0)) goto matched;
+            continue;
+        }
+
+        if (kv_level_next(kv, itl, entry, &ino, &dtype) == 0) {  //** Drop back a level
+            kv_level_close(itl);
+            if (it->curr_level >= n) free(tbx_stack_pop(it->recurse_stack));
+            it->curr_level--;
+            continue;
+        }
+
+        if ((it->curr_level < n) && (itl->fragment == NULL)) {
+            if (regexec(itl->preg, entry, 0, NULL, 0) != 0) continue;
+        }
+
+        snprintf(fname, OS_PATH_MAX, "%s/%s", itl->path, entry);
+        if (osaz_object_access(kv->osaz, it->creds, fname, OS_MODE_READ_IMMEDIATE) == 0) continue;
+        if (it->curr_level >= it->max_level) continue;  //** Cap the recurse depth
+
+        ftype = kv_entry_type(it->os, kv->ropt, fname, ino, dtype, &target);
+
+        if (it->curr_level < n-1) { //** Still on the static table so only descend into dirs
+            if (ftype & OS_OBJECT_DIR_FLAG) {
+                it->curr_level++;
+                kv_level_init(&(it->level_info[it->curr_level]), fname, target);
+            }
+            continue;
+        }
+
+        //** Off the static table or on the last level.  From here on all hits are matches. Just have to check ftype
+        do_recurse = 1;
+        if (ftype & OS_OBJECT_SYMLINK_FLAG) {  //** Check if we follow symlinks
+            if ((it->object_types & OS_OBJECT_FOLLOW_SYMLINK_FLAG) == 0) {
+                do_recurse = 0;
+            } else if (apr_hash_get(it->symlink_loop, &ino, sizeof(uint64_t)) != NULL) {
+                log_printf(15, "Already been here via symlink so pruning fname=%s\n", fname);
+                continue;
+            } else {  //** First time so add it for tracking
+                apr_hash_set(it->symlink_loop, apr_pmemdup(it->mpool, &ino, sizeof(uint64_t)), sizeof(uint64_t), "dummy");
+            }
+        }
+
+        if ((ftype & OS_OBJECT_DIR_FLAG) && (do_recurse == 1) && (it->curr_level+1 < it->max_level)) {  //** Recurse and return it afterwards
+            itl->pending = strdup(entry);
+            itl->pending_type = ftype;
+            tbx_type_malloc_clear(child, kv_obj_level_t, 1);
+            kv_level_init(child, fname, target);
+            tbx_stack_push(it->recurse_stack, child);
+            it->curr_level++;
+            continue;
+        }
+
+        if (((ftype & it->object_types) > 0) && (kv_object_match(it, entry) == 0)) goto matched;
+    }
+
+    it->finished = 1;
+    return(0);
+
+matched:
+    *myfname = strdup(fname);
+    if (*prefix_len == 0) {
+        *prefix_len = (it->table->n > 0) ? strlen(it->level_info[it->table->n-1].path) : 0;
+        if (*prefix_len == 0) *prefix_len = it->tweak;
+    }
+    log_printf(15, "MATCH=%s prefix=%d\n", fname, *prefix_len);
+    return(ftype);
+}
+
+//***********************************************************************
+// oskv_next_object - Returns the iterators next matching object
+//***********************************************************************
+
+int oskv_next_object(os_object_iter_t *oit, char **fname, int *prefix_len)
+{
+    oskv_object_iter_t *it = (oskv_object_iter_t *)oit;
+    oskv_open_op_t op;
+    oskv_attr_op_t aop;
+    gop_op_status_t status;
+    int ftype;
+
+    ftype = kv_next_object(it, fname, prefix_len);
+    if (*fname == NULL) return(0);
+
+    if ((it->n_list < 0) && (it->it_attr != NULL)) {  //** Attr regex mode
+        if (*(it->it_attr) != NULL) oskv_destroy_attr_iter(*(it->it_attr));
+        *(it->it_attr) = NULL;
+        if (it->fd != NULL) {
+            op.os = it->os;
+            op.cfd = (oskv_fd_t *)it->fd;
+            oskv_close_object_fn((void *)&op, 0);
+            it->fd = NULL;
+        }
+
+        op.os = it->os;
+        op.creds = it->creds;
+        op.path = strdup(*fname);
+        op.fd = (oskv_fd_t **)&(it->fd);
+        op.mode = OS_MODE_READ_IMMEDIATE;
+        op.id = NULL;
+        op.max_wait = 0;
+        op.uuid = 0;
+        tbx_random_get_bytes(&(op.uuid), sizeof(op.uuid));
+        status = oskv_open_object_fn(&op, 0);
+        free(op.path);
+        if (status.op_status != OP_STATE_SUCCESS) return(-1);
+
+        *(it->it_attr) = oskv_create_attr_iter(it->os, it->creds, it->fd, it->attr, it->v_max);
+    } else if (it->n_list > 0) {  //** Fixed list mode
+        op.os = it->os;
+        op.creds = it->creds;
+        op.path = strdup(*fname);
+        op.fd = (oskv_fd_t **)&(it->fd);
+        op.mode = OS_MODE_READ_IMMEDIATE;
+        op.id = NULL;
+        op.max_wait = 0;
+        op.uuid = 0;
+        tbx_random_get_bytes(&(op.uuid), sizeof(op.uuid));
+        status = oskv_open_object_fn(&op, 0);
+        free(op.path);
+        if (status.op_status != OP_STATE_SUCCESS) return(-1);
+
+        aop.os = it->os;
+        aop.creds = it->creds;
+        aop.fd = (oskv_fd_t *)it->fd;
+        aop.key = it->key;
+        aop.val = it->val;
+        aop.v_size = it->v_size;
+        memcpy(it->v_size, it->v_size_user, sizeof(int)*it->n_list);
+        aop.n = it->n_list;
+        kv_get_multiple_attr_fn(&aop, 0);
+
+        op.cfd = (oskv_fd_t *)it->fd;
+        oskv_close_object_fn((void *)&op, 0);
+        it->fd = NULL;
+    }
+
+    return(ftype);
+}
+
+//***********************************************************************
+// oskv_create_object_iter - Creates an object iterator to selectively
+//  retreive object/attribute combinations
+//***********************************************************************
+
+os_object_iter_t *oskv_create_object_iter(lio_object_service_fn_t *os, lio_creds_t *creds, lio_os_regex_table_t *path, lio_os_regex_table_t *object_regex, int object_types,
+        lio_os_regex_table_t *attr, int recurse_depth, os_attr_iter_t **it_attr, int v_max)
+{
+    oskv_object_iter_t *it;
+    kv_obj_level_t *itl;
+    int i, n;
+
+    tbx_type_malloc_clear(it, oskv_object_iter_t, 1);
+
+    n = path->n;
+    it->os = os;
+    it->table = path;
+    it->object_regex = object_regex;
+    it->recurse_depth = recurse_depth;
+    it->max_level = n + recurse_depth;
+    it->creds = creds;
+    it->v_max = v_max;
+    it->attr = attr;
+    it->it_attr = it_attr;
+    if (it_attr != NULL) *it_attr = NULL;
+    it->n_list = (it_attr == NULL) ? 0 : -1;  //**  Using the attr iter if -1
+    it->recurse_stack = tbx_stack_new();
+    it->object_types = object_types;
+    if (object_types & OS_OBJECT_FOLLOW_SYMLINK_FLAG) { //** Following symlinks so setup the hash
+        apr_pool_create(&it->mpool, NULL);
+        it->symlink_loop = apr_hash_make(it->mpool);
+    }
+
+    if (object_regex != NULL) {
+        it->object_preg = &(object_regex->regex_entry[0].compiled);
+        if (object_regex->regex_entry[0].fixed == 1) it->obj_fixed = object_regex->regex_entry[0].expression;
+    }
+
+    tbx_type_malloc_clear(it->level_info, kv_obj_level_t, (n > 0) ? n : 1);
+    for (i=0; i<n; i++) {
+        itl = &(it->level_info[i]);
+        itl->preg = &(path->regex_entry[i].compiled);
+        if (path->regex_entry[i].fixed == 1) itl->fragment = path->regex_entry[i].expression;
+    }
+
+    //** Single level fixed path so tweak the prefix length
+    if ((n == 1) && (it->level_info[0].fragment != NULL)) {
+        it->tweak = path->regex_entry[0].fixed_prefix;
+        if (it->tweak > 0) it->tweak--;
+        if (it->tweak > 0) it->tweak += 2;
+    }
+
+    //** The first level is always the root.  With no path it's scanned as "/"
+    if (n > 0) {
+        kv_level_init(&(it->level_info[0]), "", KV_ROOT_INO);
+    } else {
+        tbx_type_malloc_clear(itl, kv_obj_level_t, 1);
+        kv_level_init(itl, "/", KV_ROOT_INO);
+        tbx_stack_push(it->recurse_stack, itl);
+    }
+
+    return((os_object_iter_t *)it);
+}
+
+//***********************************************************************
+// oskv_create_object_iter_alist - Creates an object iterator to selectively
+//  retreive object/attribute from a fixed attr list
+//***********************************************************************
+
+os_object_iter_t *oskv_create_object_iter_alist(lio_object_service_fn_t *os, lio_creds_t *creds, lio_os_regex_table_t *path, lio_os_regex_table_t *object_regex, int object_types,
+        int recurse_depth, char **key, void **val, int *v_size, int n_keys)
+{
+    oskv_object_iter_t *it;
+    int i;
+
+    //** Use the regex attr version to make the base struct
+    it = (oskv_object_iter_t *)oskv_create_object_iter(os, creds, path, object_regex, object_types, NULL, recurse_depth, NULL, 0);
+    if (it == NULL) return(NULL);
+
+    if (n_keys < 1) return(it);
+
+    //** Tweak things for the fixed key list
+    it->n_list = n_keys;
+    it->key = key;
+    it->val = val;
+    it->v_size = v_size;
+    tbx_type_malloc(it->v_size_user, int, it->n_list);
+    memcpy(it->v_size_user, v_size, sizeof(int)*it->n_list);
+
+    it->v_fixed = 1;
+    for (i=0; i < n_keys; i++) {
+        if (v_size[i] < 0) {
+            it->v_fixed = 0;
+            break;
+        }
+    }
+
+    return(it);
+}
+
+//***********************************************************************
+// oskv_destroy_object_iter - Destroy the object iterator
+//***********************************************************************
+
+void oskv_destroy_object_iter(os_object_iter_t *oit)
+{
+    oskv_object_iter_t *it = (oskv_object_iter_t *)oit;
+    kv_obj_level_t *itl;
+    oskv_open_op_t open_op;
+    int i;
+
+    for (i=0; i<it->table->n; i++) {
+        kv_level_close(&(it->level_info[i]));
+    }
+
+    while ((itl = (kv_obj_level_t *)tbx_stack_pop(it->recurse_stack)) != NULL) {
+        kv_level_close(itl);
+        free(itl);
+    }
+
+    if (it->it_attr != NULL) {
+        if (*it->it_attr != NULL) oskv_destroy_attr_iter(*(it->it_attr));
+    }
+
+    if (it->fd != NULL) {
+        open_op.cfd = (oskv_fd_t *)it->fd;
+        open_op.os = it->os;
+        oskv_close_object_fn(&open_op, 0);
+    }
+
+    if (it->v_size_user != NULL) free(it->v_size_user);
+    if (it->mpool != NULL) apr_pool_destroy(it->mpool);  //** This also destroys the symlink hash
+
+    tbx_stack_free(it->recurse_stack, 1);
+    free(it->level_info);
+    free(it);
+}
+
+//***********************************************************************
+// kv_parent_lookup - Splits the path and resolves the parent directory
+//***********************************************************************
+
+int kv_parent_lookup(lio_object_service_fn_t *os, const char *path, uint64_t *pino, char *base)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    char dir[OS_PATH_MAX];
+    int ftype;
+
+    if (kv_path_split(path, dir, base) != 0) return(1);
+    if (kv_lookup(os, kv->ropt, dir, 1, pino, &ftype) != 0) return(1);
+    return(((ftype & OS_OBJECT_DIR_FLAG) == 0) ? 1 : 0);
+}
+
+//***********************************************************************
+// kv_nlink_adjust - Adds the link count change for the inode to the batch
+//***********************************************************************
+
+int kv_nlink_adjust(oskv_priv_t *kv, kv_batch_t *b, uint64_t ino, int delta)
+{
+    kv_inode_t inode;
+
+    if (delta == 0) return(0);
+    if (kv_inode_get(kv, kv->ropt, ino, &inode) != 0) return(1);
+    inode.nlink += delta;
+    kv_inode_put(b, ino, &inode);
+    kv_inode_clear(&inode);
+    return(0);
+}
+
+//***********************************************************************
+// kv_unlink - Adds the removal of the directory entry to the batch.  If it
+//     was the last link the inode and attributes are also removed and the
+//     batch holds the inode's attribute lock until it's written.  Returns
+//     the change in the parent's link count.
+//     NOTE: Should be holding ns_lock
+//***********************************************************************
+
+int kv_unlink(oskv_priv_t *kv, kv_batch_t *b, uint64_t pino, const char *name, uint64_t ino, int dtype, int *pdelta)
+{
+    kv_inode_t inode;
+    char key[KV_PREFIX_LEN];
+
+    if (kv_inode_get(kv, kv->ropt, ino, &inode) != 0) {  //** Dangling entry so just remove it
+        kv_dentry_del(b, pino, name);
+        return(0);
+    }
+
+    kv_dentry_del(b, pino, name);
+
+    if (dtype & OS_OBJECT_DIR_FLAG) {
+        *pdelta -= 1;
+        inode.nlink = 0;
+    } else {
+        inode.nlink--;
+    }
+
+    if (inode.nlink <= 0) {  //** Last link so remove everything
+        kv_batch_hold_lock(kv, b, ino);  //** Keeps new attrs from sneaking in until the batch is written
+        kv_key_make(key, KV_INODE, ino, NULL, 0);
+        kv_batch_del(b, key, KV_PREFIX_LEN);
+        kv_purge_attrs(kv, b, ino);
+    } else {
+        kv_inode_put(b, ino, &inode);
+    }
+
+    kv_inode_clear(&inode);
+    return(0);
+}
+
+//***********************************************************************
+// oskv_free_mk_mv_rm
+//***********************************************************************
+
+void oskv_free_mk_mv_rm(void *arg)
+{
+    oskv_mk_mv_rm_t *op = (oskv_mk_mv_rm_t *)arg;
+
+    if (op->src_path != NULL) free(op->src_path);
+    if (op->dest_path != NULL) free(op->dest_path);
+    if (op->id != NULL) free(op->id);
+
+    free(op);
+}
+
+//***********************************************************************
+// oskv_remove_object_fn - Removes an object.  Directories have to be empty.
+//***********************************************************************
+
+gop_op_status_t oskv_remove_object_fn(void *arg, int id)
+{
+    oskv_mk_mv_rm_t *op = (oskv_mk_mv_rm_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    kv_batch_t b;
+    uint64_t pino, ino;
+    int dtype, pdelta, err;
+    char base[OS_PATH_MAX];
+
+    if (osaz_object_remove(kv->osaz, op->creds, op->src_path) == 0)  return(gop_failure_status);
+
+    apr_thread_mutex_lock(kv->ns_lock);
+
+    if ((kv_parent_lookup(op->os, op->src_path, &pino, base) != 0) ||
+            (kv_dentry_get(kv, kv->ropt, pino, base, -1, &ino, &dtype) != 0)) {
+        apr_thread_mutex_unlock(kv->ns_lock);
+        return(gop_failure_status);
+    }
+
+    if ((dtype & OS_OBJECT_DIR_FLAG) && (kv_dir_is_empty(kv, ino) == 0)) {
+        apr_thread_mutex_unlock(kv->ns_lock);
+        log_printf(15, "Oops! trying to remove a non-empty dir: fname=%s\n", op->src_path);
+        return(gop_failure_status);
+    }
+
+    kv_batch_init(&b);
+    pdelta = 0;
+    err = kv_unlink(kv, &b, pino, base, ino, dtype, &pdelta);
+    err += kv_nlink_adjust(kv, &b, pino, pdelta);
+    err += kv_batch_destroy(kv, &b);
+
+    apr_thread_mutex_unlock(kv->ns_lock);
+
+    return((err == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// oskv_remove_object - Makes a remove object operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_remove_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *path)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_mk_mv_rm_t *op;
+
+    tbx_type_malloc_clear(op, oskv_mk_mv_rm_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = strdup(path);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_remove_object_fn, (void *)op, oskv_free_mk_mv_rm, 1));
+}
+
+//***********************************************************************
+// oskv_remove_regex_fn - Does the actual bulk object removal
+//***********************************************************************
+
+gop_op_status_t oskv_remove_regex_fn(void *arg, int id)
+{
+    oskv_remove_regex_op_t *op = (oskv_remove_regex_op_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    oskv_mk_mv_rm_t rm_op;
+    os_object_iter_t *it;
+    int prefix_len, count;
+    char *fname;
+    gop_op_status_t status, op_status;
+
+    memset(&rm_op, 0, sizeof(rm_op));
+    rm_op.os = op->os;
+    rm_op.creds = op->creds;
+
+    status = gop_success_status;
+
+    it = oskv_create_object_iter(op->os, op->creds, op->rpath, op->object_regex, op->obj_types, NULL, op->recurse_depth, NULL, 0);
+
+    count = 0;
+    while (oskv_next_object(it, &fname, &prefix_len) > 0) {
+        if (osaz_object_remove(kv->osaz, op->creds, fname) == 0) {
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code++;
+        } else {
+            rm_op.src_path = fname;
+            op_status = oskv_remove_object_fn(&rm_op, 0);
+            if (op_status.op_status != OP_STATE_SUCCESS) {
+                status.op_status = OP_STATE_FAILURE;
+                status.error_code++;
+            }
+        }
+
+        free(fname);
+
+        count++;  //** Check for an abort
+        if (count == 20) {
+            count = 0;
+            if (tbx_atomic_get(op->abort) != 0) {
+                status.op_status = OP_STATE_FAILURE;
+                break;
+            }
+        }
+    }
+
+    oskv_destroy_object_iter(it);
+
+    return(status);
+}
+
+//***********************************************************************
+// oskv_remove_regex_object - Does a bulk regex remove.
+//     Each matching object is removed.  If the object is a directory
+//     then the system will recursively remove it's contents up to the
+//     recursion depth.  Setting recurse_depth=0 will only remove the dir
+//     if it is empty.
+//***********************************************************************
+
+gop_op_generic_t *oskv_remove_regex_object(lio_object_service_fn_t *os, lio_creds_t *creds, lio_os_regex_table_t *path, lio_os_regex_table_t *object_regex, int obj_types, int recurse_depth)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_remove_regex_op_t *op;
+
+    tbx_type_malloc_clear(op, oskv_remove_regex_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->rpath = path;
+    op->object_regex = object_regex;
+    op->recurse_depth = recurse_depth;
+    op->obj_types = obj_types;
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_remove_regex_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_abort_remove_regex_object_fn - Performs the actual abort operation
+//***********************************************************************
+
+gop_op_status_t oskv_abort_remove_regex_object_fn(void *arg, int id)
+{
+    oskv_remove_regex_op_t *op = (oskv_remove_regex_op_t *)arg;
+
+    tbx_atomic_set(op->abort, 1);
+
+    return(gop_success_status);
+}
+
+//***********************************************************************
+//  oskv_abort_remove_regex_object - Aborts an ongoing remove operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_abort_remove_regex_object(lio_object_service_fn_t *os, gop_op_generic_t *gop)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    gop_thread_pool_op_t *tpop = gop_get_tp(gop);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_abort_remove_regex_object_fn, tpop->arg, NULL, 1));
+}
+
+//***********************************************************************
+// oskv_regex_object_set_multiple_attrs_fn - Recursivley sets the fixed attibutes
+//***********************************************************************
+
+gop_op_status_t oskv_regex_object_set_multiple_attrs_fn(void *arg, int id)
+{
+    oskv_regex_object_attr_op_t *op = (oskv_regex_object_attr_op_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    os_object_iter_t *it;
+    char *fname;
+    gop_op_status_t status, op_status;
+    oskv_attr_op_t op_attr;
+    oskv_fd_t *fd;
+    oskv_open_op_t op_open;
+    int prefix_len, count;
+
+    op_attr.os = op->os;
+    op_attr.creds = op->creds;
+    op_attr.fd = NULL; //** filled in for each object
+    op_attr.key = op->key;
+    op_attr.val = op->val;
+    op_attr.v_size = op->v_size;
+    op_attr.n = op->n_keys;
+
+    op_open.os = op->os;
+    op_open.creds = op->creds;
+    op_open.path = NULL;  //** Filled in for each open
+    op_open.fd = &fd;
+    op_open.mode = OS_MODE_READ_IMMEDIATE;
+    op_open.id = NULL;
+    op_open.uuid = 0;
+    tbx_random_get_bytes(&(op_open.uuid), sizeof(op_open.uuid));
+    op_open.max_wait = 0;
+
+    status = gop_success_status;
+
+    it = oskv_create_object_iter(op->os, op->creds, op->rpath, op->object_regex, op->object_types, NULL, op->recurse_depth, NULL, 0);
+    count = 0;
+    while (oskv_next_object(it, &fname, &prefix_len) > 0) {
+        if (osaz_object_access(kv->osaz, op->creds, fname, OS_MODE_WRITE_IMMEDIATE) == 0) {
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code += op->n_keys;
+        } else {
+            op_open.path = fname;
+            op_status = oskv_open_object_fn(&op_open, 0);
+            if (op_status.op_status != OP_STATE_SUCCESS) {
+                status.op_status = OP_STATE_FAILURE;
+                status.error_code += op->n_keys;
+            } else {
+                op_attr.fd = fd;
+                op_status = kv_set_multiple_attr_fn(&op_attr, 0);
+                if (op_status.op_status != OP_STATE_SUCCESS) {
+                    status.op_status = OP_STATE_FAILURE;
+                    status.error_code++;
+                }
+
+                op_open.cfd = fd;
+                oskv_close_object_fn((void *)&op_open, 0);  //** Got to close it as well
+            }
+        }
+
+        free(fname);
+
+        count++;  //** Check for an abort
+        if (count == 20) {
+            count = 0;
+            if (tbx_atomic_get(op->abort) != 0) {
+                status.op_status = OP_STATE_FAILURE;
+                break;
+            }
+        }
+    }
+
+    oskv_destroy_object_iter(it);
+
+    return(status);
+}
+
+//***********************************************************************
+// oskv_regex_object_set_multiple_attrs - Does a bulk regex change attr.
+//     Each matching object's attr are changed.  If the object is a directory
+//     then the system will recursively change it's contents up to the
+//     recursion depth.
+//***********************************************************************
+
+gop_op_generic_t *oskv_regex_object_set_multiple_attrs(lio_object_service_fn_t *os, lio_creds_t *creds, char *id, lio_os_regex_table_t *path, lio_os_regex_table_t *object_regex, int object_types, int recurse_depth, char **key, void **val, int *v_size, int n_attrs)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_regex_object_attr_op_t *op;
+
+    tbx_type_malloc_clear(op, oskv_regex_object_attr_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->id = id;
+    op->rpath = path;
+    op->object_regex = object_regex;
+    op->recurse_depth = recurse_depth;
+    op->key = key;
+    op->val = val;
+    op->v_size = v_size;
+    op->n_keys = n_attrs;
+    op->object_types = object_types;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_regex_object_set_multiple_attrs_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_abort_regex_object_set_multiple_attrs_fn - Performs the actual abort operation
+//***********************************************************************
+
+gop_op_status_t oskv_abort_regex_object_set_multiple_attrs_fn(void *arg, int id)
+{
+    oskv_regex_object_attr_op_t *op = (oskv_regex_object_attr_op_t *)arg;
+
+    tbx_atomic_set(op->abort, 1);
+
+    return(gop_success_status);
+}
+
+//***********************************************************************
+//  oskv_abort_regex_object_set_multiple_attrs - Aborts an ongoing set operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_abort_regex_object_set_multiple_attrs(lio_object_service_fn_t *os, gop_op_generic_t *gop)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    gop_thread_pool_op_t *tpop = gop_get_tp(gop);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_abort_regex_object_set_multiple_attrs_fn, tpop->arg, NULL, 1));
+}
+
+//***********************************************************************
+// oskv_exists_fn - Check for file type and if it exists
+//***********************************************************************
+
+gop_op_status_t oskv_exists_fn(void *arg, int id)
+{
+    oskv_mk_mv_rm_t *op = (oskv_mk_mv_rm_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    gop_op_status_t status = gop_success_status;
+
+    if (osaz_object_access(kv->osaz, op->creds, op->src_path, OS_MODE_READ_IMMEDIATE) == 0)  return(gop_failure_status);
+
+    status.error_code = kv_object_type(op->os, kv->ropt, op->src_path, NULL);
+    log_printf(15, "fname=%s  ftype=%d\n", op->src_path, status.error_code);
+    if (status.error_code == 0) status.op_status = OP_STATE_FAILURE;
+
+    return(status);
+}
+
+//***********************************************************************
+//  oskv_exists - Returns the object type  and 0 if it doesn't exist
+//***********************************************************************
+
+gop_op_generic_t *oskv_exists(lio_object_service_fn_t *os, lio_creds_t *creds, char *path)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_mk_mv_rm_t *op;
+
+    if (path == NULL) return(gop_dummy(gop_failure_status));
+
+    tbx_type_malloc_clear(op, oskv_mk_mv_rm_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = strdup(path);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_exists_fn, (void *)op, oskv_free_mk_mv_rm, 1));
+}
+
+//***********************************************************************
+// kv_create_entry - Creates a new inode and links it into the namespace
+//     NOTE: Should be holding ns_lock
+//***********************************************************************
+
+int kv_create_entry(lio_object_service_fn_t *os, const char *path, int type, const char *link)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    kv_inode_t inode;
+    kv_batch_t b;
+    uint64_t pino, ino;
+    int dtype, err;
+    char base[OS_PATH_MAX];
+
+    if (kv_parent_lookup(os, path, &pino, base) != 0) {
+        log_printf(15, "Missing parent directory! path=%s\n", path);
+        return(1);
+    }
+
+    if (kv_dentry_get(kv, kv->ropt, pino, base, -1, &ino, &dtype) == 0) {
+        log_printf(15, "Object already exists! path=%s\n", path);
+        return(1);
+    }
+
+    memset(&inode, 0, sizeof(inode));
+    inode.type = type;
+    inode.ctime = apr_time_sec(apr_time_now());
+    inode.link = (char *)link;
+    if (type & OS_OBJECT_DIR_FLAG) {
+        inode.nlink = 2;
+        inode.parent = pino;
+    } else {
+        inode.nlink = 1;
+    }
+
+    ino = tbx_atomic_inc(kv->next_ino);
+
+    kv_batch_init(&b);
+    kv_inode_put(&b, ino, &inode);
+    kv_dentry_put(&b, pino, base, ino, type);
+    err = (type & OS_OBJECT_DIR_FLAG) ? kv_nlink_adjust(kv, &b, pino, 1) : 0;
+    if (err == 0) {
+        err = kv_batch_destroy(kv, &b);
+    } else {
+        kv_batch_abort(kv, &b);
+    }
+
+    return(err);
+}
+
+//***********************************************************************
+// oskv_create_object_fn - Does the actual object creation
+//***********************************************************************
+
+gop_op_status_t oskv_create_object_fn(void *arg, int id)
+{
+    oskv_mk_mv_rm_t *op = (oskv_mk_mv_rm_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    int err;
+
+    if (osaz_object_create(kv->osaz, op->creds, op->src_path) == 0)  return(gop_failure_status);
+
+    apr_thread_mutex_lock(kv->ns_lock);
+    err = kv_create_entry(op->os, op->src_path, ((op->type & OS_OBJECT_DIR_FLAG) ? OS_OBJECT_DIR_FLAG : OS_OBJECT_FILE_FLAG), NULL);
+    apr_thread_mutex_unlock(kv->ns_lock);
+
+    return((err == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// oskv_create_object - Creates an object
+//***********************************************************************
+
+gop_op_generic_t *oskv_create_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *path, int type, char *id)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_mk_mv_rm_t *op;
+
+    tbx_type_malloc_clear(op, oskv_mk_mv_rm_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = strdup(path);
+    op->type = type;
+    op->id = (id == NULL) ? NULL : strdup(id);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_create_object_fn, (void *)op, oskv_free_mk_mv_rm, 1));
+}
+
+//***********************************************************************
+// oskv_symlink_object_fn - Makes a symbolic link.  The target is stored as
+//     given so it can be relative.
+//***********************************************************************
+
+gop_op_status_t oskv_symlink_object_fn(void *arg, int id)
+{
+    oskv_mk_mv_rm_t *op = (oskv_mk_mv_rm_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    int err;
+
+    if (osaz_object_create(kv->osaz, op->creds, op->dest_path) == 0) return(gop_failure_status);
+
+    apr_thread_mutex_lock(kv->ns_lock);
+    err = kv_create_entry(op->os, op->dest_path, OS_OBJECT_SYMLINK_FLAG, op->src_path);
+    apr_thread_mutex_unlock(kv->ns_lock);
+
+    if (err != 0) log_printf(15, "Failed making symlink %s -> %s\n", op->src_path, op->dest_path);
+
+    return((err == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// oskv_symlink_object - Generates a symbolic link object operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_symlink_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *dest_path, char *id)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_mk_mv_rm_t *op;
+
+    //** Make sure the files are different
+    if (strcmp(src_path, dest_path) == 0) {
+        return(gop_dummy(gop_failure_status));
+    }
+
+    tbx_type_malloc_clear(op, oskv_mk_mv_rm_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = strdup(src_path);
+    op->dest_path = strdup(dest_path);
+    op->id = (id == NULL) ? NULL : strdup(id);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_symlink_object_fn, (void *)op, oskv_free_mk_mv_rm, 1));
+}
+
+//***********************************************************************
+// oskv_hardlink_object_fn - Adds another name for the source object.  Both
+//     names share the inode and so the attributes.
+//***********************************************************************
+
+gop_op_status_t oskv_hardlink_object_fn(void *arg, int id)
+{
+    oskv_mk_mv_rm_t *op = (oskv_mk_mv_rm_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    kv_batch_t b;
+    uint64_t spino, dpino, ino, dino;
+    int stype, dtype, err;
+    char sbase[OS_PATH_MAX];
+    char dbase[OS_PATH_MAX];
+
+    if ((osaz_object_access(kv->osaz, op->creds, op->src_path, OS_MODE_READ_IMMEDIATE) == 0) ||
+            (osaz_object_create(kv->osaz, op->creds, op->dest_path) == 0)) return(gop_failure_status);
+
+    apr_thread_mutex_lock(kv->ns_lock);
+
+    err = 1;
+    if ((kv_parent_lookup(op->os, op->src_path, &spino, sbase) != 0) ||
+            (kv_dentry_get(kv, kv->ropt, spino, sbase, -1, &ino, &stype) != 0)) {
+        log_printf(15, "ERROR source file missing sfname=%s dfname=%s\n", op->src_path, op->dest_path);
+        goto finished;
+    }
+
+    if (stype & OS_OBJECT_DIR_FLAG) {
+        log_printf(15, "ERROR Can't hardlink a directory sfname=%s\n", op->src_path);
+        goto finished;
+    }
+
+    if ((kv_parent_lookup(op->os, op->dest_path, &dpino, dbase) != 0) ||
+            (kv_dentry_get(kv, kv->ropt, dpino, dbase, -1, &dino, &dtype) == 0)) {
+        log_printf(15, "ERROR Missing parent or dest exists dfname=%s\n", op->dest_path);
+        goto finished;
+    }
+
+    stype |= OS_OBJECT_HARDLINK_FLAG;
+    kv_batch_init(&b);
+    kv_dentry_put(&b, spino, sbase, ino, stype);
+    kv_dentry_put(&b, dpino, dbase, ino, stype);
+    err = kv_nlink_adjust(kv, &b, ino, 1);
+    if (err == 0) {
+        err = kv_batch_destroy(kv, &b);
+    } else {
+        kv_batch_abort(kv, &b);
+    }
+
+finished:
+    apr_thread_mutex_unlock(kv->ns_lock);
+
+    return((err == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// oskv_hardlink_object - Generates a hard link object operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_hardlink_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *dest_path, char *id)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_mk_mv_rm_t *op;
+
+    //** Make sure the files are different
+    if (strcmp(src_path, dest_path) == 0) {
+        return(gop_dummy(gop_failure_status));
+    }
+
+    tbx_type_malloc_clear(op, oskv_mk_mv_rm_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = strdup(src_path);
+    op->dest_path = strdup(dest_path);
+    op->id = (id == NULL) ? NULL : strdup(id);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_hardlink_object_fn, (void *)op, oskv_free_mk_mv_rm, 1));
+}
+
+//***********************************************************************
+// oskv_move_object_fn - Actually Moves an object.  Only the directory
+//     entries change so the attributes come along for free.  An existing
+//     destination is replaced unless it's a non-empty directory.
+//***********************************************************************
+
+gop_op_status_t oskv_move_object_fn(void *arg, int id)
+{
+    oskv_mk_mv_rm_t *op = (oskv_mk_mv_rm_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    kv_inode_t inode;
+    kv_batch_t b;
+    uint64_t spino, dpino, ino, dino, p;
+    int stype, dtype, err, sdelta, ddelta;
+    char sbase[OS_PATH_MAX];
+    char dbase[OS_PATH_MAX];
+
+    if ((osaz_object_remove(kv->osaz, op->creds, op->src_path) == 0) ||
+            (osaz_object_create(kv->osaz, op->creds, op->dest_path) == 0)) return(gop_failure_status);
+
+    apr_thread_mutex_lock(kv->ns_lock);
+
+    err = 1;
+    if ((kv_parent_lookup(op->os, op->src_path, &spino, sbase) != 0) ||
+            (kv_dentry_get(kv, kv->ropt, spino, sbase, -1, &ino, &stype) != 0) ||
+            (kv_parent_lookup(op->os, op->dest_path, &dpino, dbase) != 0)) goto finished;
+
+    if ((spino == dpino) && (strcmp(sbase, dbase) == 0)) {  //** Nothing to do
+        err = 0;
+        goto finished;
+    }
+
+    //** Make sure we aren't moving a directory into itself
+    if (stype & OS_OBJECT_DIR_FLAG) {
+        for (p = dpino; p != KV_ROOT_INO; p = inode.parent) {
+            if ((p == ino) || (kv_inode_get(kv, kv->ropt, p, &inode) != 0)) {
+                log_printf(15, "ERROR: Moving a directory into itself src=%s dest=%s\n", op->src_path, op->dest_path);
+                goto finished;
+            }
+            kv_inode_clear(&inode);
+        }
+    }
+
+    kv_batch_init(&b);
+    sdelta = ddelta = 0;
+
+    //** Replace the destination if it exists
+    if (kv_dentry_get(kv, kv->ropt, dpino, dbase, -1, &dino, &dtype) == 0) {
+        if ((dtype & OS_OBJECT_DIR_FLAG) && (kv_dir_is_empty(kv, dino) == 0)) {
+            log_printf(15, "ERROR: Destination is a non-empty dir: dest=%s\n", op->dest_path);
+            kv_batch_abort(kv, &b);
+            goto finished;
+        }
+        kv_unlink(kv, &b, dpino, dbase, dino, dtype, &ddelta);
+    }
+
+    kv_dentry_del(&b, spino, sbase);
+    kv_dentry_put(&b, dpino, dbase, ino, stype);
+
+    if (stype & OS_OBJECT_DIR_FLAG) {  //** Update the parent and the link counts
+        if (kv_inode_get(kv, kv->ropt, ino, &inode) == 0) {
+            inode.parent = dpino;
+            kv_inode_put(&b, ino, &inode);
+            kv_inode_clear(&inode);
+        }
+        sdelta--;
+        ddelta++;
+    }
+
+    err = 0;
+    if (spino == dpino) {
+        err += kv_nlink_adjust(kv, &b, spino, sdelta + ddelta);
+    } else {
+        err += kv_nlink_adjust(kv, &b, spino, sdelta);
+        err += kv_nlink_adjust(kv, &b, dpino, ddelta);
+    }
+    err += kv_batch_destroy(kv, &b);
+
+finished:
+    apr_thread_mutex_unlock(kv->ns_lock);
+
+    log_printf(15, "src=%s dest=%s err=%d\n", op->src_path, op->dest_path, err);
+
+    return((err == 0) ? gop_success_status : gop_failure_status);
+}
+
+//***********************************************************************
+// oskv_move_object - Generates a move object operation
+//***********************************************************************
+
+gop_op_generic_t *oskv_move_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *dest_path)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_mk_mv_rm_t *op;
+
+    tbx_type_malloc_clear(op, oskv_mk_mv_rm_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->src_path = strdup(src_path);
+    op->dest_path = strdup(dest_path);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_move_object_fn, (void *)op, oskv_free_mk_mv_rm, 1));
+}
+
+//***********************************************************************
+// oskv_free_open - Frees an open object
+//***********************************************************************
+
+void oskv_free_open(void *arg)
+{
+    oskv_open_op_t *op = (oskv_open_op_t *)arg;
+
+    if (op->path != NULL) free(op->path);
+    if (op->id != NULL) free(op->id);
+
+    free(op);
+}
+
+//***********************************************************************
+// oskv_open_object_fn - Opens an object
+//***********************************************************************
+
+gop_op_status_t oskv_open_object_fn(void *arg, int id)
+{
+    oskv_open_op_t *op = (oskv_open_op_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    oskv_fd_t *fd;
+    uint64_t ino;
+    int ftype, err;
+    gop_op_status_t status;
+
+    log_printf(15, "Attempting to open object=%s\n", op->path);
+
+    *op->fd = NULL;
+    ftype = kv_object_type(op->os, kv->ropt, op->path, &ino);
+    if (ftype <= 0) {
+        return(gop_failure_status);
+    }
+
+    if (osaz_object_access(kv->osaz, op->creds, op->path, op->mode) == 0)  {
+        return(gop_failure_status);
+    }
+
+    tbx_type_malloc(fd, oskv_fd_t, 1);
+
+    fd->os = op->os;
+    fd->ino = ino;
+    fd->ftype = ftype;
+    fd->mode = op->mode;
+    fd->object_name = op->path;
+    fd->id = op->id;
+    fd->uuid = op->uuid;
+
+    err = kv_full_object_lock(fd, op->max_wait);  //** Do a full lock if needed
+    log_printf(15, "kv_full_object_lock=%d fname=%s uuid=" LU " max_wait=%d\n", err, fd->object_name, fd->uuid, op->max_wait);
+    if (err != 0) {  //** Either a timeout or abort occured
+        *(op->fd) = NULL;
+        free(fd);
+        status = gop_failure_status;
+    } else {
+        *(op->fd) = fd;
+        op->path = NULL;  //** This is now used by the fd
+        op->id = NULL;
+        status = gop_success_status;
+    }
+
+    return(status);
+}
+
+//***********************************************************************
+//  oskv_open_object - Makes the open file op
+//***********************************************************************
+
+gop_op_generic_t *oskv_open_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *path, int mode, char *id, os_fd_t **pfd, int max_wait)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_open_op_t *op;
+
+    tbx_type_malloc(op, oskv_open_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->path = strdup(path);
+    op->fd = (oskv_fd_t **)pfd;
+    op->max_wait = max_wait;
+    op->mode = mode;
+    op->id = (id == NULL) ? strdup(kv->host_id) : strdup(id);
+    op->uuid = 0;
+    tbx_random_get_bytes(&(op->uuid), sizeof(op->uuid));
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_open_object_fn, (void *)op, oskv_free_open, 1));
+}
+
+//***********************************************************************
+// oskv_abort_open_object_fn - Performs the actual open abort operation
+//***********************************************************************
+
+gop_op_status_t oskv_abort_open_object_fn(void *arg, int id)
+{
+    oskv_open_op_t *op = (oskv_open_op_t *)arg;
+    oskv_priv_t *kv = (oskv_priv_t *)op->os->priv;
+    gop_op_status_t status;
+    kv_fobj_lock_t *fol;
+    kv_fobj_lock_task_t *handle;
+
+    if (op->mode == OS_MODE_READ_IMMEDIATE) return(gop_success_status);
+
+    apr_thread_mutex_lock(kv->fobj_lock);
+
+    fol = tbx_list_search(kv->fobj_table, op->path);
+    if (fol == NULL) {
+        apr_thread_mutex_unlock(kv->fobj_lock);
+        return(gop_failure_status);
+    }
+
+    //** Find the task in the pending list and remove it
+    status = gop_failure_status;
+    tbx_stack_move_to_top(fol->stack);
+    while ((handle = (kv_fobj_lock_task_t *)tbx_stack_get_current_data(fol->stack)) != NULL) {
+        if (handle->fd->uuid == op->uuid) {
+            tbx_stack_delete_current(fol->stack, 1, 0);
+            status = gop_success_status;
+            handle->abort = 1;
+            apr_thread_cond_signal(handle->cond);   //** They will wake up when fobj_lock is released
+            break;
+        }
+        tbx_stack_move_down(fol->stack);
+    }
+
+    apr_thread_mutex_unlock(kv->fobj_lock);
+
+    return(status);
+}
+
+//***********************************************************************
+//  oskv_abort_open_object - Aborts an ongoing open file op
+//***********************************************************************
+
+gop_op_generic_t *oskv_abort_open_object(lio_object_service_fn_t *os, gop_op_generic_t *gop)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    gop_thread_pool_op_t *tpop = gop_get_tp(gop);
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_abort_open_object_fn, tpop->arg, NULL, 1));
+}
+
+//***********************************************************************
+// oskv_close_object_fn - Closes an object
+//***********************************************************************
+
+gop_op_status_t oskv_close_object_fn(void *arg, int id)
+{
+    oskv_open_op_t *op = (oskv_open_op_t *)arg;
+
+    if (op->cfd == NULL) return(gop_success_status);
+
+    kv_full_object_unlock(op->cfd);
+
+    free(op->cfd->object_name);
+    if (op->cfd->id != NULL) free(op->cfd->id);
+    free(op->cfd);
+
+    return(gop_success_status);
+}
+
+//***********************************************************************
+//  oskv_close_object - Makes the close file op
+//***********************************************************************
+
+gop_op_generic_t *oskv_close_object(lio_object_service_fn_t *os, os_fd_t *ofd)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_open_op_t *op;
+
+    tbx_type_malloc(op, oskv_open_op_t, 1);
+
+    op->os = os;
+    op->cfd = (oskv_fd_t *)ofd;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_close_object_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_cred_init - Intialize a set of credentials
+//***********************************************************************
+
+lio_creds_t *oskv_cred_init(lio_object_service_fn_t *os, int type, void **args)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    lio_creds_t *creds;
+
+    creds = authn_cred_init(kv->authn, type, args);
+
+    //** Right now this is filled with dummy routines until we get an official authn/authz implementation
+    an_cred_set_id(creds, args[1]);
+
+    return(creds);
+}
+
+//***********************************************************************
+// oskv_cred_destroy - Destroys a set ot credentials
+//***********************************************************************
+
+void oskv_cred_destroy(lio_object_service_fn_t *os, lio_creds_t *creds)
+{
+    an_cred_destroy(creds);
+}
+
+//***********************************************************************
+// kv_fsck_check - Checks that the entry's inode exists.  The attributes
+//     hang off the inode so there's nothing else to go missing.
+//***********************************************************************
+
+int kv_fsck_check(lio_object_service_fn_t *os, lio_creds_t *creds, char *fname, int dofix)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    kv_inode_t inode;
+    kv_batch_t b;
+    uint64_t pino, ino;
+    int dtype, err;
+    char base[OS_PATH_MAX];
+
+    if (fname == NULL) return(OS_FSCK_ERROR);
+    if (osaz_object_access(kv->osaz, creds, fname, OS_MODE_READ_IMMEDIATE) == 0) return(OS_FSCK_ERROR);
+
+    apr_thread_mutex_lock(kv->ns_lock);
+
+    if ((kv_parent_lookup(os, fname, &pino, base) != 0) ||
+            (kv_dentry_get(kv, kv->ropt, pino, base, -1, &ino, &dtype) != 0)) {
+        apr_thread_mutex_unlock(kv->ns_lock);
+        return(OS_FSCK_GOOD);  //** It's already gone
+    }
+
+    if (kv_inode_get(kv, kv->ropt, ino, &inode) == 0) {
+        kv_inode_clear(&inode);
+        apr_thread_mutex_unlock(kv->ns_lock);
+        return(OS_FSCK_GOOD);
+    }
+
+    err = OS_FSCK_MISSING_OBJECT;
+    if ((dofix == OS_FSCK_REMOVE) || (dofix == OS_FSCK_REPAIR)) {  //** Can't rebuild the inode so drop the entry
+        kv_batch_init(&b);
+        kv_dentry_del(&b, pino, base);
+        if (dtype & OS_OBJECT_DIR_FLAG) kv_nlink_adjust(kv, &b, pino, -1);
+        err = (kv_batch_destroy(kv, &b) == 0) ? OS_FSCK_GOOD : OS_FSCK_ERROR;
+    }
+
+    apr_thread_mutex_unlock(kv->ns_lock);
+
+    return(err);
+}
+
+//***********************************************************************
+//  oskv_fsck_object_fn - Does the actual object checking
+//***********************************************************************
+
+gop_op_status_t oskv_fsck_object_fn(void *arg, int id)
+{
+    oskv_open_op_t *op = (oskv_open_op_t *)arg;
+    gop_op_status_t status;
+
+    status = gop_success_status;
+
+    status.error_code = kv_fsck_check(op->os, op->creds, op->path, op->mode);
+
+    return(status);
+}
+
+//***********************************************************************
+//  oskv_fsck_object - Allocates space for the object check
+//***********************************************************************
+
+gop_op_generic_t *oskv_fsck_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *fname, int ftype, int resolution)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    oskv_open_op_t *op;
+
+    tbx_type_malloc_clear(op, oskv_open_op_t, 1);
+
+    op->os = os;
+    op->creds = creds;
+    op->path = fname;
+    op->mode = resolution;
+
+    return(gop_tp_op_new(kv->tpc, NULL, oskv_fsck_object_fn, (void *)op, free, 1));
+}
+
+//***********************************************************************
+// oskv_next_fsck - Returns the next problem object
+//***********************************************************************
+
+int oskv_next_fsck(lio_object_service_fn_t *os, os_fsck_iter_t *oit, char **bad_fname, int *bad_atype)
+{
+    oskv_fsck_iter_t *it = (oskv_fsck_iter_t *)oit;
+    char *fname;
+    int atype, prefix_len;
+    int err;
+
+    while ((atype = oskv_next_object(it->it, &fname, &prefix_len)) > 0) {
+        err = kv_fsck_check(it->os, it->creds, fname, OS_FSCK_MANUAL);
+        if (err != OS_FSCK_GOOD) {
+            *bad_atype = atype;
+            *bad_fname = fname;
+            return(err);
+        }
+
+        free(fname);
+    }
+
+    *bad_atype = 0;
+    *bad_fname = NULL;
+    return(OS_FSCK_FINISHED);
+}
+
+//***********************************************************************
+// oskv_create_fsck_iter - Creates an fsck iterator
+//***********************************************************************
+
+os_fsck_iter_t *oskv_create_fsck_iter(lio_object_service_fn_t *os, lio_creds_t *creds, char *path, int mode)
+{
+    oskv_fsck_iter_t *it;
+
+    tbx_type_malloc_clear(it, oskv_fsck_iter_t, 1);
+
+    it->os = os;
+    it->creds = creds;
+    it->path = strdup(path);
+    it->mode = mode;
+
+    it->regex = lio_os_path_glob2regex(it->path);
+    it->it = oskv_create_object_iter(os, creds, it->regex, NULL, OS_OBJECT_ANY_FLAG, NULL, 10000, NULL, 0);
+    if (it->it == NULL) {
+        log_printf(0, "ERROR: Failed with object_iter creation %s\n", path);
+        lio_os_regex_table_destroy(it->regex);
+        free(it->path);
+        free(it);
+        return(NULL);
+    }
+
+    return((os_fsck_iter_t *)it);
+}
+
+//***********************************************************************
+// oskv_destroy_fsck_iter - Destroys an fsck iterator
+//***********************************************************************
+
+void oskv_destroy_fsck_iter(lio_object_service_fn_t *os, os_fsck_iter_t *oit)
+{
+    oskv_fsck_iter_t *it = (oskv_fsck_iter_t *)oit;
+
+    oskv_destroy_object_iter(it->it);
+    lio_os_regex_table_destroy(it->regex);
+    free(it->path);
+    free(it);
+}
+
+//***********************************************************************
+// oskv_print_running_config - Prints the running config
+//***********************************************************************
+
+void oskv_print_running_config(lio_object_service_fn_t *os, FILE *fd, int print_section_heading)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    char text[1024];
+
+    if (print_section_heading) fprintf(fd, "[%s]\n", kv->section);
+    fprintf(fd, "type = %s\n", OS_TYPE_KV);
+    fprintf(fd, "base_path = %s\n", kv->base_path);
+    fprintf(fd, "lock_table_size = %d\n", kv->lock_table_size);
+    fprintf(fd, "max_copy = %d\n", kv->max_copy);
+    fprintf(fd, "sync_writes = %d\n", kv->sync_writes);
+    fprintf(fd, "bloom_bits = %d\n", kv->bloom_bits);
+    fprintf(fd, "cache_size = %s\n", tbx_stk_pretty_print_int_with_scale(kv->cache_size, text));
+    fprintf(fd, "write_buffer_size = %s\n", tbx_stk_pretty_print_int_with_scale(kv->write_buffer_size, text));
+    fprintf(fd, "authz = %s\n", kv->authz_section);
+    fprintf(fd, "authn = %s\n", kv->authn_section);
+    fprintf(fd, "\n");
+}
+
+//***********************************************************************
+// oskv_destroy
+//***********************************************************************
+
+void oskv_destroy(lio_object_service_fn_t *os)
+{
+    oskv_priv_t *kv = (oskv_priv_t *)os->priv;
+    int i;
+
+    if (kv->db != NULL) leveldb_close(kv->db);
+    if (kv->opts != NULL) leveldb_options_destroy(kv->opts);
+    if (kv->cache != NULL) leveldb_cache_destroy(kv->cache);
+    if (kv->filter != NULL) leveldb_filterpolicy_destroy(kv->filter);
+    if (kv->ropt != NULL) leveldb_readoptions_destroy(kv->ropt);
+    if (kv->wopt != NULL) leveldb_writeoptions_destroy(kv->wopt);
+
+    for (i=0; i<kv->lock_table_size; i++) {
+        apr_thread_mutex_destroy(kv->attr_lock[i]);
+    }
+    free(kv->attr_lock);
+    apr_thread_mutex_destroy(kv->ns_lock);
+
+    apr_thread_mutex_destroy(kv->fobj_lock);
+    tbx_list_destroy(kv->fobj_table);
+    tbx_list_destroy(kv->vattr_prefix);
+    tbx_pc_destroy(kv->fobj_pc);
+    tbx_pc_destroy(kv->task_pc);
+
+    osaz_destroy(kv->osaz);
+    authn_destroy(kv->authn);
+
+    apr_pool_destroy(kv->mpool);
+
+    if (kv->authn_section) free(kv->authn_section);
+    if (kv->authz_section) free(kv->authz_section);
+    if (kv->section) free(kv->section);
+    free(kv->host_id);
+    free(kv->base_path);
+    free(kv);
+    free(os);
+}
+
+//***********************************************************************
+// kv_db_open - Opens the database and makes sure the root exists
+//***********************************************************************
+
+int kv_db_open(oskv_priv_t *kv)
+{
+    kv_inode_t inode;
+    kv_batch_t b;
+    leveldb_iterator_t *it;
+    const char *key;
+    size_t klen;
+    char *errstr = NULL;
+    uint64_t last;
+
+    kv->opts = leveldb_options_create();
+    leveldb_options_set_create_if_missing(kv->opts, 1);
+    kv->cache = leveldb_cache_create_lru(kv->cache_size);
+    leveldb_options_set_cache(kv->opts, kv->cache);
+    if (kv->bloom_bits > 0) {
+        kv->filter = leveldb_filterpolicy_create_bloom(kv->bloom_bits);
+        leveldb_options_set_filter_policy(kv->opts, kv->filter);
+    }
+    leveldb_options_set_write_buffer_size(kv->opts, kv->write_buffer_size);
+
+    kv->ropt = leveldb_readoptions_create();
+    kv->wopt = leveldb_writeoptions_create();
+    leveldb_writeoptions_set_sync(kv->wopt, kv->sync_writes);
+
+    kv->db = leveldb_open(kv->opts, kv->base_path, &errstr);
+    if (errstr != NULL) {
+        log_printf(0, "ERROR: Unable to open the DB! base_path=%s error=%s\n", kv->base_path, errstr);
+        leveldb_free(errstr);
+        kv->db = NULL;
+        return(1);
+    }
+
+    //** Make the root if needed
+    if (kv_inode_get(kv, kv->ropt, KV_ROOT_INO, &inode) == 0) {
+        kv_inode_clear(&inode);
+    } else {
+        memset(&inode, 0, sizeof(inode));
+        inode.type = OS_OBJECT_DIR_FLAG;
+        inode.nlink = 2;
+        inode.parent = KV_ROOT_INO;
+        inode.ctime = apr_time_sec(apr_time_now());
+        kv_batch_init(&b);
+        kv_inode_put(&b, KV_ROOT_INO, &inode);
+        if (kv_batch_destroy(kv, &b) != 0) return(1);
+    }
+
+    //** The inode table sorts last so the final key has the largest inode
+    last = KV_ROOT_INO;
+    it = leveldb_create_iterator(kv->db, kv->ropt);
+    leveldb_iter_seek_to_last(it);
+    if (leveldb_iter_valid(it)) {
+        key = leveldb_iter_key(it, &klen);
+        if ((klen == KV_PREFIX_LEN) && (key[0] == KV_INODE)) last = kv_ino_decode(key + 1);
+    }
+    leveldb_iter_destroy(it);
+    tbx_atomic_set(kv->next_ino, last + 1);
+
+    log_printf(5, "base_path=%s next_ino=" LU "\n", kv->base_path, last + 1);
+    return(0);
+}
+
+//***********************************************************************
+//  object_service_kv_create - Creates a LevelDB backed OS
+//***********************************************************************
+
+lio_object_service_fn_t *object_service_kv_create(lio_service_manager_t *ess, tbx_inip_file_t *fd, char *section)
+{
+    lio_object_service_fn_t *os;
+    oskv_priv_t *kv;
+    osaz_create_t *osaz_create;
+    authn_create_t *authn_create;
+    char *atype, *asection;
+    char hostname[1024];
+    int i;
+
+    if (section == NULL) section = oskv_default_options.section;
+
+    tbx_type_malloc_clear(os, lio_object_service_fn_t, 1);
+    tbx_type_malloc_clear(kv, oskv_priv_t, 1);
+    os->priv = (void *)kv;
+
+    kv->section = strdup(section);
+
+    kv->tpc = lio_lookup_service(ess, ESS_RUNNING, ESS_TPC_UNLIMITED);
+    if (fd == NULL) {
+        kv->base_path = strdup("./oskv");
+        osaz_create = lio_lookup_service(ess, OSAZ_AVAILABLE, OSAZ_TYPE_FAKE);
+        kv->osaz = (*osaz_create)(ess, NULL, NULL, os);
+        authn_create = lio_lookup_service(ess, AUTHN_AVAILABLE, AUTHN_TYPE_FAKE);
+        kv->authn = (*authn_create)(ess, NULL, NULL);
+        kv->lock_table_size = oskv_default_options.lock_table_size;
+        kv->max_copy = oskv_default_options.max_copy;
+        kv->sync_writes = oskv_default_options.sync_writes;
+        kv->bloom_bits = oskv_default_options.bloom_bits;
+        kv->cache_size = oskv_default_options.cache_size;
+        kv->write_buffer_size = oskv_default_options.write_buffer_size;
+    } else {
+        kv->base_path = tbx_inip_get_string(fd, section, "base_path", oskv_default_options.base_path);
+        kv->lock_table_size = tbx_inip_get_integer(fd, section, "lock_table_size", oskv_default_options.lock_table_size);
+        kv->max_copy = tbx_inip_get_integer(fd, section, "max_copy", oskv_default_options.max_copy);
+        kv->sync_writes = tbx_inip_get_integer(fd, section, "sync_writes", oskv_default_options.sync_writes);
+        kv->bloom_bits = tbx_inip_get_integer(fd, section, "bloom_bits", oskv_default_options.bloom_bits);
+        kv->cache_size = tbx_inip_get_integer(fd, section, "cache_size", oskv_default_options.cache_size);
+        kv->write_buffer_size = tbx_inip_get_integer(fd, section, "write_buffer_size", oskv_default_options.write_buffer_size);
+        asection = tbx_inip_get_string(fd, section, "authz", oskv_default_options.authz_section);
+        kv->authz_section = asection;
+        atype = (asection == NULL) ? strdup(OSAZ_TYPE_FAKE) : tbx_inip_get_string(fd, asection, "type", OSAZ_TYPE_FAKE);
+        osaz_create = lio_lookup_service(ess, OSAZ_AVAILABLE, atype);
+        kv->osaz = (*osaz_create)(ess, fd, asection, os);
+        free(atype);
+        if (kv->osaz == NULL) {
+            free(kv->base_path);
+            free(kv->section);
+            free(kv);
+            free(os);
+            return(NULL);
+        }
+
+        asection = tbx_inip_get_string(fd, section, "authn", oskv_default_options.authn_section);
+        kv->authn_section = asection;
+        atype = (asection == NULL) ? strdup(AUTHN_TYPE_FAKE) : tbx_inip_get_string(fd, asection, "type", AUTHN_TYPE_FAKE);
+        authn_create = lio_lookup_service(ess, AUTHN_AVAILABLE, atype);
+        kv->authn = (*authn_create)(ess, fd, asection);
+        free(atype);
+        if (kv->authn == NULL) {
+            free(kv->base_path);
+            free(kv->section);
+            osaz_destroy(kv->osaz);
+            free(kv);
+            free(os);
+            return(NULL);
+        }
+    }
+
+    if (kv->lock_table_size < 1) kv->lock_table_size = 1;
+
+    apr_pool_create(&kv->mpool, NULL);
+    apr_thread_mutex_create(&(kv->ns_lock), APR_THREAD_MUTEX_DEFAULT, kv->mpool);
+    tbx_type_malloc_clear(kv->attr_lock, apr_thread_mutex_t *, kv->lock_table_size);
+    for (i=0; i<kv->lock_table_size; i++) {
+        apr_thread_mutex_create(&(kv->attr_lock[i]), APR_THREAD_MUTEX_NESTED, kv->mpool);  //** VA's can re-enter
+    }
+
+    apr_thread_mutex_create(&(kv->fobj_lock), APR_THREAD_MUTEX_DEFAULT, kv->mpool);
+    kv->fobj_table = tbx_list_create(0, &tbx_list_string_compare, tbx_list_string_dup, tbx_list_simple_free, tbx_list_no_data_free);
+    kv->fobj_pc = tbx_pc_new("kv_fobj_pc", 50, sizeof(kv_fobj_lock_t), kv->mpool, kv_fobj_lock_new, kv_fobj_lock_free);
+    kv->task_pc = tbx_pc_new("kv_fobj_task_pc", 50, sizeof(kv_fobj_lock_task_t), kv->mpool, kv_fobj_lock_task_new, kv_fobj_lock_task_free);
+
+    //** Get the default host ID for opens
+    apr_gethostname(hostname, sizeof(hostname), kv->mpool);
+    kv->host_id = strdup(hostname);
+
+    //** Make and install the virtual attributes
+    kv->vattr_hash = apr_hash_make(kv->mpool);
+    kv->vattr_prefix = tbx_list_create(0, &tbx_list_string_compare, tbx_list_string_dup, tbx_list_simple_free, tbx_list_no_data_free);
+
+    kv->lock_va.attribute = "os.lock";
+    kv->lock_va.priv = os;
+    kv->lock_va.get = kv_va_lock_get_attr;
+    kv->lock_va.set = kv_va_null_set_attr;
+    kv->lock_va.get_link = kv_va_null_get_link_attr;
+
+    kv->link_va.attribute = "os.link";
+    kv->link_va.priv = os;
+    kv->link_va.get = kv_va_link_get_attr;
+    kv->link_va.set = kv_va_null_set_attr;
+    kv->link_va.get_link = kv_va_null_get_link_attr;
+
+    kv->link_count_va.attribute = "os.link_count";
+    kv->link_count_va.priv = os;
+    kv->link_count_va.get = kv_va_link_count_get_attr;
+    kv->link_count_va.set = kv_va_null_set_attr;
+    kv->link_count_va.get_link = kv_va_null_get_link_attr;
+
+    kv->type_va.attribute = "os.type";
+    kv->type_va.priv = os;
+    kv->type_va.get = kv_va_type_get_attr;
+    kv->type_va.set = kv_va_null_set_attr;
+    kv->type_va.get_link = kv_va_null_get_link_attr;
+
+    kv->create_va.attribute = "os.create";
+    kv->create_va.priv = os;
+    kv->create_va.get = kv_va_create_get_attr;
+    kv->create_va.set = kv_va_null_set_attr;
+    kv->create_va.get_link = kv_va_null_get_link_attr;
+
+    apr_hash_set(kv->vattr_hash, kv->lock_va.attribute, APR_HASH_KEY_STRING, &(kv->lock_va));
+    apr_hash_set(kv->vattr_hash, kv->link_va.attribute, APR_HASH_KEY_STRING, &(kv->link_va));
+    apr_hash_set(kv->vattr_hash, kv->link_count_va.attribute, APR_HASH_KEY_STRING, &(kv->link_count_va));
+    apr_hash_set(kv->vattr_hash, kv->type_va.attribute, APR_HASH_KEY_STRING, &(kv->type_va));
+    apr_hash_set(kv->vattr_hash, kv->create_va.attribute, APR_HASH_KEY_STRING, &(kv->create_va));
+
+    kv->attr_link_pva.attribute = "os.attr_link";
+    kv->attr_link_pva.priv = (void *)(long)strlen(kv->attr_link_pva.attribute);
+    kv->attr_link_pva.get = kv_va_attr_link_get_attr;
+    kv->attr_link_pva.set = kv_va_null_set_attr;
+    kv->attr_link_pva.get_link = kv_va_attr_link_get_attr;
+
+    kv->attr_type_pva.attribute = "os.attr_type";
+    kv->attr_type_pva.priv = (void *)(long)(strlen(kv->attr_type_pva.attribute));
+    kv->attr_type_pva.get = kv_va_attr_type_get_attr;
+    kv->attr_type_pva.set = kv_va_null_set_attr;
+    kv->attr_type_pva.get_link = kv_va_null_get_link_attr;
+
+    kv->timestamp_pva.attribute = "os.timestamp";
+    kv->timestamp_pva.priv = (void *)(long)(strlen(kv->timestamp_pva.attribute));
+    kv->timestamp_pva.get = kv_va_timestamp_get_attr;
+    kv->timestamp_pva.set = kv_va_timestamp_set_attr;
+    kv->timestamp_pva.get_link = kv_va_timestamp_get_link_attr;
+
+    kv->append_pva.attribute = "os.append";
+    kv->append_pva.priv = (void *)(long)(strlen(kv->append_pva.attribute));
+    kv->append_pva.get = kv_va_append_get_attr;
+    kv->append_pva.set = kv_va_append_set_attr;
+    kv->append_pva.get_link = kv_va_timestamp_get_link_attr;  //** The timestamp routine just peels off the PVA so can reuse it
+
+    tbx_list_insert(kv->vattr_prefix, kv->attr_link_pva.attribute, &(kv->attr_link_pva));
+    tbx_list_insert(kv->vattr_prefix, kv->attr_type_pva.attribute, &(kv->attr_type_pva));
+    tbx_list_insert(kv->vattr_prefix, kv->timestamp_pva.attribute, &(kv->timestamp_pva));
+    tbx_list_insert(kv->vattr_prefix, kv->append_pva.attribute, &(kv->append_pva));
+
+    os->type = OS_TYPE_KV;
+
+    os->print_running_config = oskv_print_running_config;
+    os->destroy_service = oskv_destroy;
+    os->cred_init = oskv_cred_init;
+    os->cred_destroy = oskv_cred_destroy;
+    os->exists = oskv_exists;
+    os->create_object = oskv_create_object;
+    os->remove_object = oskv_remove_object;
+    os->remove_regex_object = oskv_remove_regex_object;
+    os->abort_remove_regex_object = oskv_abort_remove_regex_object;
+    os->move_object = oskv_move_object;
+    os->symlink_object = oskv_symlink_object;
+    os->hardlink_object = oskv_hardlink_object;
+    os->create_object_iter = oskv_create_object_iter;
+    os->create_object_iter_alist = oskv_create_object_iter_alist;
+    os->next_object = oskv_next_object;
+    os->destroy_object_iter = oskv_destroy_object_iter;
+    os->open_object = oskv_open_object;
+    os->close_object = oskv_close_object;
+    os->abort_open_object = oskv_abort_open_object;
+    os->get_attr = oskv_get_attr;
+    os->set_attr = oskv_set_attr;
+    os->symlink_attr = oskv_symlink_attr;
+    os->copy_attr = oskv_copy_attr;
+    os->get_multiple_attrs = oskv_get_multiple_attrs;
+    os->set_multiple_attrs = oskv_set_multiple_attrs;
+    os->copy_multiple_attrs = oskv_copy_multiple_attrs;
+    os->symlink_multiple_attrs = oskv_symlink_multiple_attrs;
+    os->move_attr = oskv_move_attr;
+    os->move_multiple_attrs = oskv_move_multiple_attrs;
+    os->regex_object_set_multiple_attrs = oskv_regex_object_set_multiple_attrs;
+    os->abort_regex_object_set_multiple_attrs = oskv_abort_regex_object_set_multiple_attrs;
+    os->create_attr_iter = oskv_create_attr_iter;
+    os->next_attr = oskv_next_attr;
+    os->destroy_attr_iter = oskv_destroy_attr_iter;
+
+    os->create_fsck_iter = oskv_create_fsck_iter;
+    os->destroy_fsck_iter = oskv_destroy_fsck_iter;
+    os->next_fsck = oskv_next_fsck;
+    os->fsck_object = oskv_fsck_object;
+
+    if (kv_db_open(kv) != 0) {
+        os_destroy(os);
+        return(NULL);
+    }
+
+    return(os);
+}
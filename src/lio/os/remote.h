@@ -21,8 +21,12 @@
 #ifndef _OS_REMOTE_H_
 #define _OS_REMOTE_H_
 
+#include <apr_thread_proc.h>
+#include <apr_time.h>
 #include <gop/mq_ongoing.h>
 #include <gop/mq.h>
+#include <stdint.h>
+#include <tbx/stack.h>
 
 #include "authn.h"
 #include "os.h"
@@ -86,6 +90,14 @@ lio_object_service_fn_t *object_service_remote_client_create(lio_service_manager
 #define OSR_FSCK_OBJECT_SIZE        14
 #define OSR_SPIN_HB_KEY             "os_spin_hb"
 #define OSR_SPIN_HB_SIZE            10
+#define OSR_WATCH_KEY               "os_watch"
+#define OSR_WATCH_SIZE              8
+
+//** Invalidation types returned by a watch
+#define OSR_INVAL_OBJECT  0   //** The object was created/removed/replaced
+#define OSR_INVAL_ATTR    1   //** Only the object's attributes changed
+#define OSR_INVAL_TREE    2   //** The object and everything below it
+#define OSR_INVAL_ALL     3   //** Flush everything.  Sent on overflow or server restart
 
 //** Types of ongoing objects stored
 #define OSR_ONGOING_FD_TYPE    0
@@ -93,6 +105,22 @@ lio_object_service_fn_t *object_service_remote_client_create(lio_service_manager
 #define OSR_ONGOING_ATTR_ITER   2
 #define OSR_ONGOING_FSCK_ITER   3
 
+typedef struct {     //** Single invalidation event
+    int64_t seq;
+    int type;
+    char *path;
+} lio_osr_inval_t;
+
+typedef struct lio_osr_watch_s lio_osr_watch_t;
+struct lio_osr_watch_s {    //** Pending watch waiting on an invalidation
+    mq_msg_t *response;     //** Response core already addressed to the client
+    char **prefix;          //** Prefixes being watched
+    int n_prefix;
+    int64_t seq;            //** Last sequence number the client has seen
+    apr_time_t end;         //** When to give up and send an empty reply
+    lio_osr_watch_t *next;
+};
+
 struct lio_osrs_priv_t {
     char *section;
     char *os_local_section;
@@ -118,6 +146,17 @@ struct lio_osrs_priv_t {
     lio_creds_t *dummy_creds;       //** Dummy creds. Should be replaced when proper AuthN/AuthZ is added
     char *fname_active;         //** Filename for logging ACTIVE operations.
     char *fname_activity;       //** Filename for logging create/remove/move operations.
+    apr_thread_mutex_t *inval_lock;
+    apr_thread_cond_t *inval_cond;
+    lio_osr_inval_t *inval;     //** Ring of recent invalidations
+    int inval_size;             //** Size of the invalidation ring
+    int64_t inval_seq;          //** Sequence number of the last invalidation
+    int64_t epoch;              //** Changes on every restart so watchers know to flush
+    int watch_max_wait;         //** Max time a watch is held waiting for events
+    int watch_max_events;       //** Max events returned before falling back to a flush
+    lio_osr_watch_t *watch_list;  //** Pending watches.  Protected by inval_lock
+    apr_thread_t *watch_thread; //** Replies to pending watches on invalidation or timeout
+    apr_hash_t *fd_path;        //** Maps open FDs to their path for attribute invalidations
 };
 
 struct lio_osrc_priv_t {
@@ -148,7 +187,7 @@ struct lio_osrc_priv_t {
     int max_stream;
 };
 
-
+gop_op_generic_t *osrc_watch(lio_object_service_fn_t *os, lio_creds_t *creds, char **prefix, int n_prefix, int wait, int64_t *epoch, int64_t *seq, tbx_stack_t *events);
 
 #ifdef __cplusplus
 }
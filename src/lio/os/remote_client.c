@@ -121,6 +121,13 @@ typedef struct {
     lio_object_service_fn_t *os;
 } osrc_open_t;
 
+typedef struct {
+    lio_object_service_fn_t *os;
+    int64_t *epoch;
+    int64_t *seq;
+    tbx_stack_t *events;
+} osrc_watch_t;
+
 typedef struct {
     lio_object_service_fn_t *os;
     os_fd_t *fd;
@@ -707,6 +714,133 @@ gop_op_generic_t *osrc_exists(lio_object_service_fn_t *os, lio_creds_t *creds, c
     return(gop);
 }
 
+//***********************************************************************
+// osrc_response_watch - Parses the invalidations returned by a watch
+//***********************************************************************
+
+gop_op_status_t osrc_response_watch(void *task_arg, int tid)
+{
+    gop_mq_task_t *task = (gop_mq_task_t *)task_arg;
+    osrc_watch_t *arg = (osrc_watch_t *)task->arg;
+    gop_op_status_t status;
+    lio_osr_inval_t *e;
+    unsigned char *data;
+    int fsize, bpos, n, i;
+    int64_t epoch, seq, type, len;
+    int64_t n_events = 0;
+
+    log_printf(5, "START\n");
+
+    //** Parse the response
+    gop_mq_remove_header(task->response, 1);
+
+    status = gop_mq_read_status_frame(gop_mq_msg_first(task->response), 0);
+    if (status.op_status != OP_STATE_SUCCESS) goto finished;
+
+    i = 0;
+    //** Header has the epoch, sequence number and the number of events
+    gop_mq_get_frame(gop_mq_msg_next(task->response), (void **)&data, &fsize);
+    bpos = 0;
+    n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &epoch);
+    if (n < 0) goto fail;
+    bpos += n;
+    n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &seq);
+    if (n < 0) goto fail;
+    bpos += n;
+    n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &n_events);
+    if (n < 0) goto fail;
+
+    //** And the events themselves
+    gop_mq_get_frame(gop_mq_msg_next(task->response), (void **)&data, &fsize);
+    bpos = 0;
+    for (i=0; i<n_events; i++) {
+        n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &type);
+        if (n < 0) goto fail;
+        bpos += n;
+        n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &len);
+        if ((n < 0) || (len < 0)) goto fail;
+        bpos += n;
+        if ((bpos + len) > fsize) goto fail;
+
+        tbx_type_malloc(e, lio_osr_inval_t, 1);
+        e->seq = seq;
+        e->type = type;
+        tbx_type_malloc(e->path, char, len+1);
+        memcpy(e->path, &(data[bpos]), len);
+        e->path[len] = 0;
+        bpos += len;
+        tbx_stack_move_to_bottom(arg->events);
+        tbx_stack_insert_below(arg->events, e);
+    }
+
+    *(arg->epoch) = epoch;
+    *(arg->seq) = seq;
+    goto finished;
+
+fail:
+    log_printf(0, "ERROR: Corrupt watch response! i=%d n_events=%" PRId64 "\n", i, n_events);
+    status = gop_failure_status;
+
+finished:
+    log_printf(5, "END status=%d %d\n", status.op_status, status.error_code);
+
+    return(status);
+}
+
+//***********************************************************************
+// osrc_watch - Waits up to wait seconds for invalidations under any of the
+//    given prefixes.  On success epoch and seq are updated and the events
+//    are appended to the stack as lio_osr_inval_t entries which the caller
+//    frees.  An OSR_INVAL_ALL event means everything cached should be dropped.
+//***********************************************************************
+
+gop_op_generic_t *osrc_watch(lio_object_service_fn_t *os, lio_creds_t *creds, char **prefix, int n_prefix, int wait, int64_t *epoch, int64_t *seq, tbx_stack_t *events)
+{
+    lio_osrc_priv_t *osrc = (lio_osrc_priv_t *)os->priv;
+    osrc_watch_t *arg;
+    mq_msg_t *msg;
+    unsigned char *buffer;
+    int i, n, bpos, len;
+    gop_op_generic_t *gop;
+
+    log_printf(5, "START n_prefix=%d\n", n_prefix);
+
+    //** Pack the request
+    n = 4*10;
+    for (i=0; i<n_prefix; i++) n += strlen(prefix[i]) + 10;
+    tbx_type_malloc(buffer, unsigned char, n);
+    bpos = tbx_zigzag_encode(*epoch, buffer);
+    bpos += tbx_zigzag_encode(*seq, &(buffer[bpos]));
+    bpos += tbx_zigzag_encode(wait, &(buffer[bpos]));
+    bpos += tbx_zigzag_encode(n_prefix, &(buffer[bpos]));
+    for (i=0; i<n_prefix; i++) {
+        len = strlen(prefix[i]);
+        bpos += tbx_zigzag_encode(len, &(buffer[bpos]));
+        memcpy(&(buffer[bpos]), prefix[i], len);
+        bpos += len;
+    }
+
+    tbx_type_malloc(arg, osrc_watch_t, 1);
+    arg->os = os;
+    arg->epoch = epoch;
+    arg->seq = seq;
+    arg->events = events;
+
+    //** Form the message
+    msg = gop_mq_make_exec_core_msg(osrc->remote_host, 1);
+    gop_mq_msg_append_mem(msg, OSR_WATCH_KEY, OSR_WATCH_SIZE, MQF_MSG_KEEP_DATA);
+    osrc_add_creds(os, creds, msg);
+    gop_mq_msg_append_mem(msg, buffer, bpos, MQF_MSG_AUTO_FREE);
+    gop_mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
+
+    //** Make the gop.  The server holds the request so pad the timeout
+    gop = gop_mq_op_new(osrc->mqc, msg, osrc_response_watch, arg, free, osrc->timeout + wait);
+
+    log_printf(5, "END\n");
+
+    return(gop);
+}
+
 //***********************************************************************
 // osrc_create_object - Creates an object
 //***********************************************************************
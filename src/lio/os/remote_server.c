@@ -43,6 +43,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <string.h>
+#include <tbx/apr_wrapper.h>
 #include <tbx/assert_result.h>
 #include <tbx/fmttypes.h>
 #include <tbx/iniparse.h>
@@ -71,7 +72,10 @@ static lio_osrs_priv_t osrs_default_options = {
     .max_stream = 10*1024*1024,
     .os_local_section = "rs_simple",
     .fname_active = "/lio/log/os_active.log",
-    .max_active = 1024
+    .max_active = 1024,
+    .inval_size = 65536,
+    .watch_max_wait = 60,
+    .watch_max_events = 1000
 };
 
 typedef struct {
@@ -101,6 +105,11 @@ typedef struct {
     gop_op_generic_t *gop;
 } spin_hb_t;
 
+typedef struct {
+    os_fd_t *fd;
+    char *path;
+} osrs_fd_path_t;
+
 
 lio_object_service_fn_t *_os_global = NULL;  //** This is used for the signal
 
@@ -333,6 +342,143 @@ gop_op_status_t osrs_perform_abort_handle(lio_object_service_fn_t *os, char *han
     return(status);
 }
 
+//***********************************************************************
+// osrs_invalidate - Adds an invalidation event to the ring and wakes up
+//    any pending watches
+//***********************************************************************
+
+void osrs_invalidate(lio_object_service_fn_t *os, int type, const char *path)
+{
+    lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)os->priv;
+    lio_osr_inval_t *e;
+
+    if (path == NULL) path = "/";
+
+    apr_thread_mutex_lock(osrs->inval_lock);
+    osrs->inval_seq++;
+    e = osrs->inval + (osrs->inval_seq % osrs->inval_size);
+    if (e->path != NULL) free(e->path);
+    e->seq = osrs->inval_seq;
+    e->type = type;
+    e->path = strdup(path);
+    apr_thread_cond_broadcast(osrs->inval_cond);
+    apr_thread_mutex_unlock(osrs->inval_lock);
+}
+
+//***********************************************************************
+// osrs_inval_match - Returns 1 if the invalidation falls under one of the
+//    prefixes being watched
+//***********************************************************************
+
+int osrs_inval_match(lio_osr_inval_t *e, char **prefix, int n_prefix)
+{
+    int i, plen, elen;
+
+    if (e->type == OSR_INVAL_ALL) return(1);
+
+    //** Changes in the root directory change the root listing which every
+    //** client could have cached
+    if (strchr(e->path + 1, '/') == NULL) return(1);
+
+    elen = strlen(e->path);
+    for (i=0; i<n_prefix; i++) {
+        plen = strlen(prefix[i]);
+        if ((plen == 1) && (prefix[i][0] == '/')) return(1);
+
+        //** Event is at or below the prefix
+        if ((strncmp(e->path, prefix[i], plen) == 0) && ((e->path[plen] == 0) || (e->path[plen] == '/'))) return(1);
+
+        //** Tree event above the prefix
+        if ((e->type == OSR_INVAL_TREE) && (elen < plen) && (strncmp(e->path, prefix[i], elen) == 0) && (prefix[i][elen] == '/')) return(1);
+    }
+
+    return(0);
+}
+
+//***********************************************************************
+// osrs_fd_path_set - Records the path associated with an open FD so
+//    attribute changes can be published
+//***********************************************************************
+
+void osrs_fd_path_set(lio_object_service_fn_t *os, os_fd_t *fd, const char *path)
+{
+    lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+
+    tbx_type_malloc(fp, osrs_fd_path_t, 1);
+    fp->fd = fd;
+    fp->path = strdup(path);
+
+    apr_thread_mutex_lock(osrs->lock);
+    apr_hash_set(osrs->fd_path, &(fp->fd), sizeof(os_fd_t *), fp);
+    apr_thread_mutex_unlock(osrs->lock);
+}
+
+//***********************************************************************
+// osrs_fd_path_get - Returns a copy of the path for the FD or NULL
+//***********************************************************************
+
+char *osrs_fd_path_get(lio_object_service_fn_t *os, os_fd_t *fd)
+{
+    lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+    char *path;
+
+    apr_thread_mutex_lock(osrs->lock);
+    fp = apr_hash_get(osrs->fd_path, &fd, sizeof(os_fd_t *));
+    path = (fp) ? strdup(fp->path) : NULL;
+    apr_thread_mutex_unlock(osrs->lock);
+
+    return(path);
+}
+
+//***********************************************************************
+// osrs_fd_path_remove - Removes the FD from the path table
+//***********************************************************************
+
+void osrs_fd_path_remove(lio_object_service_fn_t *os, os_fd_t *fd)
+{
+    lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+
+    apr_thread_mutex_lock(osrs->lock);
+    fp = apr_hash_get(osrs->fd_path, &fd, sizeof(os_fd_t *));
+    if (fp) apr_hash_set(osrs->fd_path, &fd, sizeof(os_fd_t *), NULL);
+    apr_thread_mutex_unlock(osrs->lock);
+
+    if (fp) {
+        free(fp->path);
+        free(fp);
+    }
+}
+
+//***********************************************************************
+// osrs_invalidate_fd - Publishes an attribute invalidation for the FD
+//***********************************************************************
+
+void osrs_invalidate_fd(lio_object_service_fn_t *os, os_fd_t *fd)
+{
+    char *path;
+
+    path = osrs_fd_path_get(os, fd);
+    if (path == NULL) return;
+    osrs_invalidate(os, OSR_INVAL_ATTR, path);
+    free(path);
+}
+
+//***********************************************************************
+// osrs_ongoing_close_fn - Closes an FD whose client went away
+//***********************************************************************
+
+gop_op_generic_t *osrs_ongoing_close_fn(void *arg, void *handle)
+{
+    lio_object_service_fn_t *os = (lio_object_service_fn_t *)arg;
+    lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)os->priv;
+
+    osrs_fd_path_remove(os, handle);
+    return(os_close_object(osrs->os_child, handle));
+}
+
 //***********************************************************************
 // osrs_exists_cb - Processes the object exists command
 //***********************************************************************
@@ -488,6 +634,7 @@ void osrs_create_object_cb(void *arg, gop_mq_task_t *task)
         if (data != NULL) free(data);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_invalidate(os, OSR_INVAL_OBJECT, name);
     } else {
         status = gop_failure_status;
     }
@@ -547,6 +694,7 @@ void osrs_remove_object_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_invalidate(os, OSR_INVAL_TREE, name);
     } else {
         status = gop_failure_status;
     }
@@ -685,6 +833,9 @@ void osrs_remove_regex_object_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+
+        //** Even a partial failure could have removed objects
+        osrs_invalidate(os, OSR_INVAL_ALL, NULL);
     } else {
         status = gop_failure_status;
     }
@@ -823,6 +974,7 @@ void osrs_symlink_object_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_invalidate(os, OSR_INVAL_OBJECT, dest_name);
         if (userid != NULL) free(userid);
     } else {
         status = gop_failure_status;
@@ -887,6 +1039,10 @@ void osrs_hardlink_object_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) {
+            osrs_invalidate(os, OSR_INVAL_ATTR, src_name);  //** The link count changed
+            osrs_invalidate(os, OSR_INVAL_OBJECT, dest_name);
+        }
         if (userid != NULL) free(userid);
     } else {
         status = gop_failure_status;
@@ -948,6 +1104,10 @@ void osrs_move_object_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) {
+            osrs_invalidate(os, OSR_INVAL_TREE, src_name);
+            osrs_invalidate(os, OSR_INVAL_TREE, dest_name);
+        }
     } else {
         status = gop_failure_status;
     }
@@ -1041,7 +1201,8 @@ void osrs_open_object_cb(void *arg, gop_mq_task_t *task)
         gop_mq_get_frame(fhb, (void **)&handle, &handle_len);
         log_printf(5, "handle=%s\n", handle);
         log_printf(5, "handle_len=%d\n", handle_len);
-        oo = gop_mq_ongoing_add(osrs->ongoing, 1, handle, handle_len, (void *)fd, (gop_mq_ongoing_fail_fn_t)osrs->os_child->close_object, osrs->os_child);
+        osrs_fd_path_set(os, fd, src_name);
+        oo = gop_mq_ongoing_add(osrs->ongoing, 1, handle, handle_len, (void *)fd, osrs_ongoing_close_fn, os);
 
         n=sizeof(intptr_t);
         log_printf(5, "PTR key=%" PRIdPTR " len=%d\n", oo->key, n);
@@ -1104,6 +1265,7 @@ void osrs_close_object_cb(void *arg, gop_mq_task_t *task)
     if ((handle = gop_mq_ongoing_remove(osrs->ongoing, id, fsize, key)) != NULL) {
         log_printf(6, "Found handle\n");
 
+        osrs_fd_path_remove(os, handle);
         gop = os_close_object(osrs->os_child, handle);
         gop_waitall(gop);
         status = gop_get_status(gop);
@@ -1470,6 +1632,7 @@ void osrs_set_mult_attr_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_invalidate_fd(os, fd);
     } else {
         status = gop_failure_status;
     }
@@ -1744,6 +1907,9 @@ void osrs_regex_set_mult_attr_cb(void *arg, gop_mq_task_t *task)
 
         gop_waitall(spin.gop);
         status = gop_get_status(spin.gop);
+
+        //** Even a partial failure could have changed attributes
+        osrs_invalidate(os, OSR_INVAL_ALL, NULL);
     } else {
         status = gop_failure_status;
     }
@@ -1912,6 +2078,7 @@ void osrs_copy_mult_attr_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_invalidate_fd(os, fd_dest);
     } else {
         status = gop_failure_status;
     }
@@ -2067,6 +2234,7 @@ void osrs_move_mult_attr_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_invalidate_fd(os, fd_src);
     } else {
         status = gop_failure_status;
     }
@@ -2235,6 +2403,7 @@ void osrs_symlink_mult_attr_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_invalidate_fd(os, fd_dest);
     } else {
         status = gop_failure_status;
     }
@@ -3005,6 +3174,7 @@ void osrs_fsck_object_cb(void *arg, gop_mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if ((status.op_status == OP_STATE_SUCCESS) && (resolution != OS_FSCK_MANUAL)) osrs_invalidate(os, OSR_INVAL_TREE, path);
     }
 
     //** Form the response
@@ -3022,6 +3192,306 @@ void osrs_fsck_object_cb(void *arg, gop_mq_task_t *task)
     if (path != NULL) free(path);
 }
 
+//***********************************************************************
+// osrs_watch_encode - Appends an invalidation to the response buffer
+//***********************************************************************
+
+void osrs_watch_encode(unsigned char **buffer, int *bmax, int *blen, int type, const char *path)
+{
+    int len;
+
+    len = strlen(path);
+    if ((*blen + len + 20) > *bmax) {
+        *bmax = 2*(*bmax) + len + 20;
+        tbx_type_realloc(*buffer, unsigned char, *bmax);
+    }
+
+    *blen += tbx_zigzag_encode(type, *buffer + *blen);
+    *blen += tbx_zigzag_encode(len, *buffer + *blen);
+    memcpy(*buffer + *blen, path, len);
+    *blen += len;
+}
+
+//***********************************************************************
+// osrs_watch_collect - Encodes all the events after seq matching the
+//    prefixes.  Returns 1 if the client should flush everything instead.
+//    NOTE: inval_lock must be held.
+//***********************************************************************
+
+int osrs_watch_collect(lio_osrs_priv_t *osrs, char **prefix, int n_prefix, int64_t *seq, unsigned char **buffer, int *bmax, int *blen, int *n_events)
+{
+    lio_osr_inval_t *e;
+    int64_t s;
+
+    if (*seq < (osrs->inval_seq - osrs->inval_size)) return(1);  //** Fell off the ring
+
+    for (s=*seq+1; s<=osrs->inval_seq; s++) {
+        e = osrs->inval + (s % osrs->inval_size);
+        if (osrs_inval_match(e, prefix, n_prefix) == 0) continue;
+        if (*n_events >= osrs->watch_max_events) return(1);
+        osrs_watch_encode(buffer, bmax, blen, e->type, e->path);
+        (*n_events)++;
+    }
+    *seq = osrs->inval_seq;
+
+    return(0);
+}
+
+//***********************************************************************
+// osrs_watch_reply - Finishes the response and sends it.  The buffer is
+//    consumed.
+//***********************************************************************
+
+void osrs_watch_reply(lio_osrs_priv_t *osrs, mq_msg_t *response, gop_op_status_t status, int64_t epoch, int64_t seq, int n_events, unsigned char *buffer, int blen)
+{
+    unsigned char *hdr;
+    int n;
+
+    gop_mq_msg_append_frame(response, gop_mq_make_status_frame(status));
+    if (status.op_status == OP_STATE_SUCCESS) {
+        tbx_type_malloc(hdr, unsigned char, 32);
+        n = tbx_zigzag_encode(epoch, hdr);
+        n += tbx_zigzag_encode(seq, hdr + n);
+        n += tbx_zigzag_encode(n_events, hdr + n);
+        gop_mq_msg_append_frame(response, gop_mq_frame_new(hdr, n, MQF_MSG_AUTO_FREE));
+        gop_mq_msg_append_frame(response, gop_mq_frame_new(buffer, blen, MQF_MSG_AUTO_FREE));
+    } else if (buffer != NULL) {
+        free(buffer);
+    }
+    gop_mq_msg_append_mem(response, NULL, 0, MQF_MSG_KEEP_DATA);  //** Empty frame
+
+    gop_mq_submit(osrs->server_portal, gop_mq_task_new(osrs->mqc, response, NULL, NULL, 30));
+}
+
+//***********************************************************************
+// osrs_watch_finish - Sends the reply for a pending watch and frees it.
+//    Called without inval_lock held.
+//***********************************************************************
+
+void osrs_watch_finish(lio_osrs_priv_t *osrs, lio_osr_watch_t *w, int flush, int64_t epoch, int n_events, unsigned char *buffer, int bmax, int blen)
+{
+    int i;
+
+    if (flush == 1) {  //** Just tell them to drop everything
+        blen = 0;
+        n_events = 1;
+        osrs_watch_encode(&buffer, &bmax, &blen, OSR_INVAL_ALL, "/");
+    }
+
+    log_printf(5, "n_prefix=%d n_events=%d flush=%d seq=%" PRId64 "\n", w->n_prefix, n_events, flush, w->seq);
+    osrs_watch_reply(osrs, w->response, gop_success_status, epoch, w->seq, n_events, buffer, blen);
+
+    for (i=0; i<w->n_prefix; i++) free(w->prefix[i]);
+    free(w->prefix);
+    free(w);
+}
+
+//***********************************************************************
+// osrs_watch_thread - Replies to pending watches when a matching
+//    invalidation arrives or the wait expires.  This keeps the MQ worker
+//    threads free while clients long poll.
+//***********************************************************************
+
+void *osrs_watch_thread(apr_thread_t *th, void *data)
+{
+    lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)data;
+    lio_osr_watch_t *w, *prev, *next, *done;
+    unsigned char *buffer;
+    int n_events, bmax, blen, flush;
+    int64_t epoch, seq;
+    apr_time_t now, end;
+
+    apr_thread_mutex_lock(osrs->inval_lock);
+    do {
+        //** Pull out all the watches that are ready to go
+        done = NULL;
+        seq = osrs->inval_seq;
+        epoch = osrs->epoch;
+        now = apr_time_now();
+        end = now + apr_time_from_sec(1);
+        prev = NULL;
+        for (w = osrs->watch_list; w != NULL; w = next) {
+            next = w->next;
+            if ((w->seq < seq) || (w->end <= now) || (osrs->shutdown == 1)) {
+                if (prev == NULL) {
+                    osrs->watch_list = next;
+                } else {
+                    prev->next = next;
+                }
+                w->next = done;
+                done = w;
+            } else {
+                if (w->end < end) end = w->end;
+                prev = w;
+            }
+        }
+
+        //** Reply to them.  The collection has to be done under the lock
+        //** but the sends happen outside of it.
+        for (w = done; w != NULL; w = next) {
+            next = w->next;
+            bmax = 1024;
+            blen = 0;
+            n_events = 0;
+            tbx_type_malloc(buffer, unsigned char, bmax);
+            flush = osrs_watch_collect(osrs, w->prefix, w->n_prefix, &(w->seq), &buffer, &bmax, &blen, &n_events);
+            if ((flush == 0) && (n_events == 0) && (w->end > now) && (osrs->shutdown == 0)) {
+                //** Nothing we care about so put it back
+                free(buffer);
+                w->next = osrs->watch_list;
+                osrs->watch_list = w;
+                if (w->end < end) end = w->end;
+                continue;
+            }
+            w->seq = osrs->inval_seq;
+            apr_thread_mutex_unlock(osrs->inval_lock);
+            osrs_watch_finish(osrs, w, flush, epoch, n_events, buffer, bmax, blen);
+            apr_thread_mutex_lock(osrs->inval_lock);
+        }
+
+        if ((osrs->shutdown == 0) && (osrs->inval_seq == seq)) {
+            now = apr_time_now();
+            if (end > now) apr_thread_cond_timedwait(osrs->inval_cond, osrs->inval_lock, end - now);
+        }
+    } while ((osrs->shutdown == 0) || (osrs->watch_list != NULL));
+    apr_thread_mutex_unlock(osrs->inval_lock);
+
+    return(NULL);
+}
+
+//***********************************************************************
+// osrs_watch_cb - Long poll for invalidations under a set of prefixes.
+//    If nothing is pending the request is parked on the watch list and
+//    answered by the watch thread when a matching invalidation arrives
+//    or the wait expires.  If the client is too far behind or the server
+//    restarted a single OSR_INVAL_ALL is returned.
+//***********************************************************************
+
+void osrs_watch_cb(void *arg, gop_mq_task_t *task)
+{
+    lio_object_service_fn_t *os = (lio_object_service_fn_t *)arg;
+    lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)os->priv;
+    gop_mq_frame_t *fid, *fcred, *fdata;
+    lio_creds_t *creds;
+    lio_osr_watch_t *w;
+    unsigned char *data, *buffer;
+    char **prefix;
+    int fsize, bpos, n, i, blen, bmax, n_events, n_prefix, flush;
+    int64_t epoch, seq, wait, np, len;
+    mq_msg_t *msg, *response;
+    gop_op_status_t status;
+
+    log_printf(5, "Processing incoming request\n");
+
+    //** Parse the command.
+    msg = task->msg;
+    gop_mq_remove_header(msg, 0);
+
+    fid = mq_msg_pop(msg);  //** This is the ID
+    gop_mq_frame_destroy(mq_msg_pop(msg));  //** Drop the application command frame
+
+    fcred = mq_msg_pop(msg);  //** This has the creds
+    creds = osrs_get_creds(os, fcred);
+
+    fdata = mq_msg_pop(msg);  //** This has the epoch, seq, wait, and prefixes
+    gop_mq_get_frame(fdata, (void **)&data, &fsize);
+
+    //** Form the response core now so it can outlive the task if we park it
+    response = gop_mq_make_response_core_msg(msg, fid);
+
+    prefix = NULL;
+    n_prefix = 0;
+    buffer = NULL;
+    blen = 0;
+    n_events = 0;
+    epoch = seq = 0;
+    status = gop_failure_status;
+    if (creds == NULL) goto fail;
+
+    bpos = 0;
+    n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &epoch);
+    if (n < 0) goto fail;
+    bpos += n;
+    n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &seq);
+    if (n < 0) goto fail;
+    bpos += n;
+    n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &wait);
+    if (n < 0) goto fail;
+    bpos += n;
+    n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &np);
+    if ((n < 0) || (np < 0) || (np > fsize)) goto fail;
+    bpos += n;
+
+    tbx_type_malloc_clear(prefix, char *, np+1);
+    for (i=0; i<np; i++) {
+        n = tbx_zigzag_decode(&(data[bpos]), fsize-bpos, &len);
+        if ((n < 0) || (len < 0)) goto fail;
+        bpos += n;
+        if ((bpos+len) > fsize) goto fail;
+        tbx_type_malloc(prefix[i], char, len+1);
+        memcpy(prefix[i], &(data[bpos]), len);
+        prefix[i][len] = 0;
+        bpos += len;
+        n_prefix++;
+    }
+
+    if (wait < 0) wait = 0;
+    if (wait > osrs->watch_max_wait) wait = osrs->watch_max_wait;
+
+    bmax = 1024;
+    tbx_type_malloc(buffer, unsigned char, bmax);
+
+    apr_thread_mutex_lock(osrs->inval_lock);
+    flush = ((epoch != osrs->epoch) || (seq > osrs->inval_seq)) ? 1 : 0;
+    if (flush == 0) flush = osrs_watch_collect(osrs, prefix, n_prefix, &seq, &buffer, &bmax, &blen, &n_events);
+
+    if ((flush == 0) && (n_events == 0) && (wait > 0) && (osrs->shutdown == 0)) {
+        //** Nothing yet so park it for the watch thread
+        tbx_type_malloc_clear(w, lio_osr_watch_t, 1);
+        w->response = response;
+        w->prefix = prefix;
+        w->n_prefix = n_prefix;
+        w->seq = seq;
+        w->end = apr_time_now() + apr_time_from_sec(wait);
+        w->next = osrs->watch_list;
+        osrs->watch_list = w;
+        apr_thread_cond_broadcast(osrs->inval_cond);  //** So the deadline is picked up
+        apr_thread_mutex_unlock(osrs->inval_lock);
+
+        log_printf(5, "Parked watch n_prefix=%d seq=%" PRId64 " wait=%" PRId64 "\n", n_prefix, seq, wait);
+        free(buffer);
+        osrs_release_creds(os, creds);
+        gop_mq_frame_destroy(fcred);
+        gop_mq_frame_destroy(fdata);
+        return;
+    }
+
+    if (flush == 1) {  //** Just tell them to drop everything
+        blen = 0;
+        n_events = 1;
+        osrs_watch_encode(&buffer, &bmax, &blen, OSR_INVAL_ALL, "/");
+    }
+    seq = osrs->inval_seq;
+    epoch = osrs->epoch;
+    apr_thread_mutex_unlock(osrs->inval_lock);
+
+    log_printf(5, "n_prefix=%d n_events=%d flush=%d seq=%" PRId64 "\n", n_prefix, n_events, flush, seq);
+    status = gop_success_status;
+
+fail:
+    osrs_release_creds(os, creds);
+    gop_mq_frame_destroy(fcred);
+    gop_mq_frame_destroy(fdata);
+
+    if (prefix != NULL) {
+        for (i=0; i<n_prefix; i++) free(prefix[i]);
+        free(prefix);
+    }
+
+    //** Lastly send it
+    osrs_watch_reply(osrs, response, status, epoch, seq, n_events, buffer, blen);
+}
+
 //***********************************************************************
 // osrs_print_running_config - Prints the running config
 //***********************************************************************
@@ -3039,6 +3509,9 @@ void osrs_print_running_config(lio_object_service_fn_t *os, FILE *fd, int print_
     fprintf(fd, "os_local = %s\n", osrs->os_local_section);
     fprintf(fd, "active_output = %s\n", osrs->fname_active);
     fprintf(fd, "max_active = %d\n", osrs->max_active);
+    fprintf(fd, "invalidate_ring = %d\n", osrs->inval_size);
+    fprintf(fd, "watch_max_wait = %d #seconds\n", osrs->watch_max_wait);
+    fprintf(fd, "watch_max_events = %d\n", osrs->watch_max_events);
     fprintf(fd, "\n");
 
      if (osrs->os_child) os_print_running_config(osrs->os_child, fd, 1);
@@ -3052,6 +3525,17 @@ void os_remote_server_destroy(lio_object_service_fn_t *os)
 {
     lio_osrs_priv_t *osrs = (lio_osrs_priv_t *)os->priv;
     osrs_active_t *a;
+    osrs_fd_path_t *fp;
+    apr_hash_index_t *hi;
+    apr_status_t value;
+    int i;
+
+    //** Release any pending watches.  The watch thread replies to them before exiting.
+    apr_thread_mutex_lock(osrs->inval_lock);
+    osrs->shutdown = 1;
+    apr_thread_cond_broadcast(osrs->inval_cond);
+    apr_thread_mutex_unlock(osrs->inval_lock);
+    apr_thread_join(&value, osrs->watch_thread);
 
     //** Remove the server portal
     gop_mq_portal_remove(osrs->mqc, osrs->server_portal);
@@ -3082,6 +3566,17 @@ void os_remote_server_destroy(lio_object_service_fn_t *os)
     tbx_stack_free(osrs->active_lru, 0);
     //** The active_table hash gets destroyed when the pool is destroyed.
 
+    //** Cleanup the invalidation ring and FD paths
+    for (i=0; i<osrs->inval_size; i++) {
+        if (osrs->inval[i].path) free(osrs->inval[i].path);
+    }
+    free(osrs->inval);
+    for (hi = apr_hash_first(NULL, osrs->fd_path); hi != NULL; hi = apr_hash_next(hi)) {
+        apr_hash_this(hi, NULL, NULL, (void **)&fp);
+        free(fp->path);
+        free(fp);
+    }
+
     //** Shutdown the child OS
     os_destroy_service(osrs->os_child);
 
@@ -3133,6 +3628,17 @@ lio_object_service_fn_t *object_service_remote_server_create(lio_service_manager
     osrs->abort = apr_hash_make(osrs->mpool);
    FATAL_UNLESS(osrs->abort != NULL);
 
+    //** Invalidation ring used by watches
+    apr_thread_mutex_create(&(osrs->inval_lock), APR_THREAD_MUTEX_DEFAULT, osrs->mpool);
+    apr_thread_cond_create(&(osrs->inval_cond), osrs->mpool);
+    osrs->inval_size = tbx_inip_get_integer(fd, section, "invalidate_ring", osrs_default_options.inval_size);
+    if (osrs->inval_size < 16) osrs->inval_size = 16;
+    tbx_type_malloc_clear(osrs->inval, lio_osr_inval_t, osrs->inval_size);
+    osrs->watch_max_wait = tbx_inip_get_integer(fd, section, "watch_max_wait", osrs_default_options.watch_max_wait);
+    osrs->watch_max_events = tbx_inip_get_integer(fd, section, "watch_max_events", osrs_default_options.watch_max_events);
+    osrs->epoch = apr_time_now();
+    osrs->fd_path = apr_hash_make(osrs->mpool);
+
     osrs->spin = apr_hash_make(osrs->mpool);
    FATAL_UNLESS(osrs->spin != NULL);
 
@@ -3209,6 +3715,8 @@ lio_object_service_fn_t *object_service_remote_server_create(lio_service_manager
     gop_mq_command_set(ctable, OSR_ATTR_ITER_KEY, OSR_ATTR_ITER_SIZE, os, osrs_attr_iter_cb);
     gop_mq_command_set(ctable, OSR_FSCK_ITER_KEY, OSR_FSCK_ITER_SIZE, os, osrs_fsck_iter_cb);
     gop_mq_command_set(ctable, OSR_FSCK_OBJECT_KEY, OSR_FSCK_OBJECT_SIZE, os, osrs_fsck_object_cb);
+    gop_mq_command_set(ctable, OSR_WATCH_KEY, OSR_WATCH_SIZE, os, osrs_watch_cb);
+    tbx_thread_create_assert(&(osrs->watch_thread), NULL, osrs_watch_thread, (void *)osrs, osrs->mpool);
 
     //** Make the ongoing checker
     osrs->ongoing = gop_mq_ongoing_create(osrs->mqc, osrs->server_portal, osrs->ongoing_interval, ONGOING_SERVER);
@@ -23,14 +23,17 @@
 #include <apr_errno.h>
 #include <apr_hash.h>
 #include <apr_pools.h>
+#include <apr_portable.h>
 #include <apr_thread_cond.h>
 #include <apr_thread_mutex.h>
 #include <apr_thread_proc.h>
+#include <apr_thread_rwlock.h>
 #include <apr_time.h>
 #include <assert.h>
 #include <gop/gop.h>
 #include <gop/tp.h>
 #include <gop/types.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -50,13 +53,19 @@
 #include "os/remote.h"
 #include "os/timecache.h"
 
-#define OSTC_LOCK(ostc); log_printf(5, "LOCK\n"); apr_thread_mutex_lock(ostc->lock)
-#define OSTC_UNLOCK(ostc) log_printf(5, "UNLOCK\n"); apr_thread_mutex_unlock(ostc->lock)
+//** The cache tree is protected by a set of reader/writer lock shards.  Readers only take
+//** the shard their thread hashes to so cache hits don't bounce a single lock between cores.
+//** Anything modifying the tree has to take all the shards.
+#define OSTC_LOCK(ostc) _ostc_wlock(ostc)
+#define OSTC_UNLOCK(ostc) _ostc_wunlock(ostc)
+#define OSTC_RLOCK(ostc) _ostc_rlock(ostc)
+#define OSTC_RUNLOCK(ostc, slot) apr_thread_rwlock_unlock((ostc)->shard[slot].lock)
 
 #define OSTC_ITER_ALIST  0
 #define OSTC_ITER_AREGEX 1
 
 #define OSTC_MAX_RECURSE 500
+#define OSTC_GEN_SLOTS 1024   //** Number of directory generation slots
 
 #define OS_ATTR_LINK "os.attr_link"
 #define OS_ATTR_LINK_LEN 12
@@ -71,6 +80,14 @@ typedef struct {
     apr_time_t expire;
 } ostcdb_attr_t;
 
+typedef struct {
+    int n;
+    int max;
+    char **name;
+    int *ftype;
+    apr_time_t expire;
+} ostc_listing_t;
+
 typedef struct {
     char *fname;
     int ftype;
@@ -78,9 +95,15 @@ typedef struct {
     apr_pool_t *mpool;
     apr_hash_t *objects;
     apr_hash_t *attrs;
+    ostc_listing_t *listing;    //** Full directory listing if we have one
     apr_time_t expire;
 } ostcdb_object_t;
 
+typedef struct {
+    char *path;
+    apr_time_t expire;
+} ostc_negative_t;
+
 typedef struct {
     char *fname;
     int mode;
@@ -124,6 +147,13 @@ typedef struct {
     int v_max;
     ostc_cacheprep_t cp;
     int iter_type;
+    char *ldir;                 //** Directory being listed if the listing can be cached
+    ostc_listing_t *listing;    //** Listing being served from cache or collected from the child
+    int lslot;
+    int from_cache;
+    int object_types;
+    ex_off_t ns_gen;
+    ex_off_t inval_gen;         //** n_invalidations when the iterator was created
 } ostc_object_iter_t;
 
 typedef struct {
@@ -148,27 +178,63 @@ typedef struct {
     lio_creds_t *creds;
     char *src_path;
     char *dest_path;
+    char *id;
+    int type;
 } ostc_move_op_t;
 
+typedef struct {
+    apr_pool_t *mpool;          //** Each shard has its own pool so the locks don't share cache lines
+    apr_thread_rwlock_t *lock;
+} ostc_lock_shard_t;
+
+typedef struct {
+    char *path;
+    char *key;                  //** If NULL the whole object is removed
+    int listing;                //** Only drop the object's listing
+} ostc_expired_t;
+
+typedef struct {
+    ostc_expired_t *entry;
+    int n;
+    int max;
+} ostc_expired_list_t;
+
 typedef struct {
     char *section;
     char *os_child_section;
     lio_object_service_fn_t *os_child;//** child OS which does the heavy lifting
-    apr_thread_mutex_t *lock;
+    apr_thread_mutex_t *lock;   //** Only protects the shutdown flag and cond
+    ostc_lock_shard_t *shard;
+    int n_shards;
+    int compact_batch;          //** Max number of expired entries removed per write lock
     apr_thread_mutex_t *delayed_lock;
     apr_thread_cond_t *cond;
     apr_pool_t *mpool;
     gop_thread_pool_context_t *tpc;
     ostcdb_object_t *cache_root;
+    apr_hash_t *negative;       //** Paths known not to exist
     apr_time_t entry_timeout;
+    apr_time_t negative_timeout;
+    apr_time_t listing_timeout;
     apr_time_t cleanup_interval;
+    int listing_max_entries;
+    ex_off_t ns_gen;            //** Bumped on purges, moves, and tree invalidations.  Protected by the write lock
+    ex_off_t *dir_gen;          //** Per directory generations hashed into OSTC_GEN_SLOTS.  Protected by the write lock
     apr_thread_t *cleanup_thread;
+    apr_thread_t *watch_thread;
+    lio_creds_t *watch_creds;   //** Creds used for the invalidation watch
+    int watch_enable;           //** Watch the remote server for invalidations
+    int watch_wait;             //** How long the server holds each watch
+    int watch_max_prefixes;     //** Watch everything if more top level entries than this are cached
     ex_off_t n_objects_created;
     ex_off_t n_objects_removed;
     ex_off_t n_attrs_created;
     ex_off_t n_attrs_removed;
     ex_off_t n_attrs_hit;
     ex_off_t n_attrs_miss;
+    ex_off_t n_negative_hit;
+    ex_off_t n_listing_hit;
+    ex_off_t n_invalidations;
     int shutdown;
 } ostc_priv_t;
 
@@ -189,15 +255,109 @@ static ostc_priv_t ostc_default_options = {
     .section = "os_timecache",
     .os_child_section = "os_remote_client",
     .entry_timeout = 60,
-    .cleanup_interval = 120
+    .negative_timeout = 10,
+    .listing_timeout = 60,
+    .listing_max_entries = 10000,
+    .cleanup_interval = 120,
+    .n_shards = 16,
+    .compact_batch = 1000,
+    .watch_enable = 1,
+    .watch_wait = 10,
+    .watch_max_prefixes = 64
 };
 
 gop_op_status_t ostc_close_object_fn(void *arg, int tid);
 gop_op_status_t ostc_delayed_open_object(lio_object_service_fn_t *os, ostc_fd_t *fd);
 
+//***********************************************************************
+// _ostc_rlock - Read locks the cache tree using the calling thread's
+//     shard and returns the shard to use for unlocking.
+//***********************************************************************
+
+int _ostc_rlock(ostc_priv_t *ostc)
+{
+    uint64_t h = (uint64_t)apr_os_thread_current();
+    int slot;
+
+    //** Thread IDs are usually aligned pointers so mix the bits
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    slot = h % ostc->n_shards;
+
+    apr_thread_rwlock_rdlock(ostc->shard[slot].lock);
+    return(slot);
+}
+
+//***********************************************************************
+// _ostc_wlock - Write locks the cache tree.  All the shards are acquired
+//     in order to avoid deadlocks between writers.
+//***********************************************************************
+
+void _ostc_wlock(ostc_priv_t *ostc)
+{
+    int i;
+
+    for (i=0; i<ostc->n_shards; i++) {
+        apr_thread_rwlock_wrlock(ostc->shard[i].lock);
+    }
+}
+
+//***********************************************************************
+// _ostc_wunlock - Releases the cache tree write lock
+//***********************************************************************
+
+void _ostc_wunlock(ostc_priv_t *ostc)
+{
+    int i;
+
+    for (i=ostc->n_shards-1; i>=0; i--) {
+        apr_thread_rwlock_unlock(ostc->shard[i].lock);
+    }
+}
+
+//***********************************************************************
+// _ostc_gen_slot - Returns the generation slot for the path or its
+//     parent directory if parent=1
+//***********************************************************************
+
+int _ostc_gen_slot(char *path, int parent)
+{
+    uint64_t h;
+    int i, n;
+
+    n = strlen(path);
+    while ((n > 1) && (path[n-1] == '/')) n--;
+    if (parent) {
+        while ((n > 0) && (path[n-1] != '/')) n--;
+        while ((n > 1) && (path[n-1] == '/')) n--;
+    }
+
+    h = 14695981039346656037ULL;  //** FNV-1a
+    for (i=0; i<n; i++) {
+        h ^= (unsigned char)path[i];
+        h *= 1099511628211ULL;
+    }
+
+    return(h % OSTC_GEN_SLOTS);
+}
+
+//***********************************************************************
+// ostc_cache_gen - Returns the generation for the directory.  It changes
+//     whenever an entry in the directory is created or removed or a purge,
+//     move, or tree invalidation happens.  Both counters only grow so
+//     their sum does too.
+//***********************************************************************
+
+ex_off_t ostc_cache_gen(ostc_priv_t *ostc, char *path, int parent)
+{
+    return(__atomic_load_n(&(ostc->ns_gen), __ATOMIC_RELAXED) +
+           __atomic_load_n(&(ostc->dir_gen[_ostc_gen_slot(path, parent)]), __ATOMIC_RELAXED));
+}
+
 //***********************************************************************
 // _ostc_count - Counts the objects and attributes
-//     NOTE: ostc->lock must be held by the calling process
+//     NOTE: The cache write lock must be held by the calling process
 //***********************************************************************
 
 void _ostc_count(ostcdb_object_t *obj, ex_off_t *n_objs, ex_off_t *n_attrs)
@@ -254,6 +414,9 @@ void ostc_info_fn(void *arg, FILE *fd)
     no = ostc->n_attrs_hit + ostc->n_attrs_miss;
     if (no > 0) d /= no;
     fprintf(fd, "Attr Cache -- hits: " XOT " miss: " XOT " hit/miss ratio: %lf\n", ostc->n_attrs_hit, ostc->n_attrs_miss, d);
+    fprintf(fd, "Negative   -- n_entries: %u hits: " XOT "\n", apr_hash_count(ostc->negative), ostc->n_negative_hit);
+    fprintf(fd, "Listings   -- hits: " XOT "\n", ostc->n_listing_hit);
+    fprintf(fd, "Watch      -- active: %d n_invalidations: " XOT "\n", (ostc->watch_thread) ? 1 : 0, ostc->n_invalidations);
     fprintf(fd, "\n");
     OSTC_UNLOCK(ostc);
 }
@@ -295,6 +458,57 @@ ostcdb_attr_t *new_ostcdb_attr(char *key, void *val, int v_size, apr_time_t expi
     return(attr);
 }
 
+//***********************************************************************
+// free_ostc_listing - Destroys a directory listing
+//***********************************************************************
+
+void free_ostc_listing(ostc_listing_t *l)
+{
+    int i;
+
+    for (i=0; i<l->n; i++) {
+        free(l->name[i]);
+    }
+    if (l->name) free(l->name);
+    if (l->ftype) free(l->ftype);
+    free(l);
+}
+
+//***********************************************************************
+// ostc_listing_add - Appends an entry to the directory listing
+//***********************************************************************
+
+void ostc_listing_add(ostc_listing_t *l, char *name, int ftype)
+{
+    if (l->n == l->max) {
+        l->max = (l->max == 0) ? 64 : 2*l->max;
+        tbx_type_realloc(l->name, char *, l->max);
+        tbx_type_realloc(l->ftype, int, l->max);
+    }
+
+    l->name[l->n] = name;
+    l->ftype[l->n] = ftype;
+    l->n++;
+}
+
+//***********************************************************************
+// ostc_listing_dup - Makes a copy of the listing
+//***********************************************************************
+
+ostc_listing_t *ostc_listing_dup(ostc_listing_t *l)
+{
+    ostc_listing_t *d;
+    int i;
+
+    tbx_type_malloc_clear(d, ostc_listing_t, 1);
+    for (i=0; i<l->n; i++) {
+        ostc_listing_add(d, strdup(l->name[i]), l->ftype[i]);
+    }
+    d->expire = l->expire;
+
+    return(d);
+}
+
 //***********************************************************************
 // free_ostcdb_object - Destroys a cache object
 //    Accumulates the number of objects and attrs removed in the
@@ -325,6 +539,7 @@ void free_ostcdb_object(ostcdb_object_t *obj, ex_off_t *n_objs, ex_off_t *n_attr
 
     if (obj->fname != NULL) free(obj->fname);
     if (obj->link != NULL) free(obj->link);
+    if (obj->listing != NULL) free_ostc_listing(obj->listing);
     apr_pool_destroy(obj->mpool);
     free(obj);
     (*n_objs)++;
@@ -344,6 +559,7 @@ ostcdb_object_t *new_ostcdb_object(char *entry, int ftype, apr_time_t expire, ap
     obj->expire = expire;
     obj->ftype = ftype;
     obj->link = NULL;
+    obj->listing = NULL;
     apr_pool_create(&(obj->mpool), NULL);
     obj->objects = (ftype & OS_OBJECT_DIR_FLAG) ? apr_hash_make(obj->mpool) : NULL;
     obj->attrs = apr_hash_make(obj->mpool);
@@ -353,7 +569,7 @@ ostcdb_object_t *new_ostcdb_object(char *entry, int ftype, apr_time_t expire, ap
 
 //***********************************************************************
 // _ostc_cleanup - Clean's out the cache of expired objects/attributes
-//     NOTE: ostc->lock must be held by the calling process
+//     NOTE: The cache write lock must be held by the calling process
 //***********************************************************************
 
 int _ostc_cleanup(lio_object_service_fn_t *os, ostcdb_object_t *obj, apr_time_t expired)
@@ -366,8 +582,17 @@ int _ostc_cleanup(lio_object_service_fn_t *os, ostcdb_object_t *obj, apr_time_t
 
     if (obj == NULL) return(0);  //** Nothing to do so return
 
-    //** Recursively prune the objects
     okept = 0;
+    if (obj->listing != NULL) {
+        if (obj->listing->expire < expired) {
+            free_ostc_listing(obj->listing);
+            obj->listing = NULL;
+        } else {
+            okept++;  //** Keep the object around for the listing
+        }
+    }
+
+    //** Recursively prune the objects
     if (obj->objects) {
         for (hi = apr_hash_first(NULL, obj->objects); hi != NULL; hi = apr_hash_next(hi)) {
             apr_hash_this(hi, NULL, NULL, (void **) &o);
@@ -398,28 +623,6 @@ int _ostc_cleanup(lio_object_service_fn_t *os, ostcdb_object_t *obj, apr_time_t
     return(akept + okept);
 }
 
-//***********************************************************************
-// ostc_cache_compact_thread - Thread for cleaning out the cache
-//***********************************************************************
-
-void *ostc_cache_compact_thread(apr_thread_t *th, void *data)
-{
-    lio_object_service_fn_t *os = (lio_object_service_fn_t *)data;
-    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
-
-    OSTC_LOCK(ostc);
-    while (ostc->shutdown == 0) {
-        apr_thread_cond_timedwait(ostc->cond, ostc->lock, ostc->cleanup_interval);
-
-        log_printf(5, "START: Running an attribute cleanup\n");
-        _ostc_cleanup(os, ostc->cache_root, apr_time_now());
-        log_printf(5, "END: cleanup finished\n");
-    }
-    OSTC_UNLOCK(ostc);
-
-    return(NULL);
-}
-
 //***********************************************************************
 // ostc_attr_cacheprep_setup - Sets up the arrays for storing the attributes
 //    in the time cache.
@@ -669,6 +872,236 @@ finished:
     return(err);
 }
 
+//***********************************************************************
+// _ostc_negative_cleanup - Removes the negative entries expiring before the
+//     given time or all of them if expired is 0.
+//     NOTE: The cache write lock must be held by the calling process
+//***********************************************************************
+
+void _ostc_negative_cleanup(ostc_priv_t *ostc, apr_time_t expired)
+{
+    ostc_negative_t *ne;
+    apr_hash_index_t *hi;
+
+    for (hi = apr_hash_first(NULL, ostc->negative); hi != NULL; hi = apr_hash_next(hi)) {
+        apr_hash_this(hi, NULL, NULL, (void **) &ne);
+        if ((expired == 0) || (ne->expire < expired)) {
+            apr_hash_set(ostc->negative, ne->path, APR_HASH_KEY_STRING, NULL);
+            free(ne->path);
+            free(ne);
+        }
+    }
+}
+
+//***********************************************************************
+// _ostc_expired_add - Adds an entry to the expired list
+//***********************************************************************
+
+void _ostc_expired_add(ostc_expired_list_t *el, char *path, char *key, int listing)
+{
+    if (el->n == el->max) {
+        el->max = (el->max == 0) ? 1024 : 2*el->max;
+        tbx_type_realloc(el->entry, ostc_expired_t, el->max);
+    }
+
+    el->entry[el->n].path = path;
+    el->entry[el->n].key = key;
+    el->entry[el->n].listing = listing;
+    el->n++;
+}
+
+//***********************************************************************
+// _ostc_expired_truncate - Drops all the entries past n
+//***********************************************************************
+
+void _ostc_expired_truncate(ostc_expired_list_t *el, int n)
+{
+    int i;
+
+    for (i=n; i<el->n; i++) {
+        free(el->entry[i].path);
+        if (el->entry[i].key) free(el->entry[i].key);
+    }
+    el->n = n;
+}
+
+//***********************************************************************
+// _ostc_compact_scan - Walks the cache and records the paths of the
+//     expired objects and attributes.  Objects that would be completely
+//     removed are added as a single entry instead of their contents.
+//     An unexpired listing keeps its object around.  Returns the number
+//     of entries kept just like _ostc_cleanup.
+//
+//     NOTE: Only a read lock is needed.  The compaction thread is the
+//           only reader iterating over the hashes.
+//***********************************************************************
+
+int _ostc_compact_scan(ostcdb_object_t *obj, char *path, apr_time_t expired, ostc_expired_list_t *el)
+{
+    ostcdb_object_t *o;
+    ostcdb_attr_t *a;
+    apr_hash_index_t *hi;
+    char *cpath;
+    int okept, akept, result, mark, n;
+
+    okept = 0;
+    if (obj->listing != NULL) {
+        if (obj->listing->expire < expired) {
+            _ostc_expired_add(el, strdup(path), NULL, 1);
+        } else {
+            okept++;
+        }
+    }
+
+    if (obj->objects) {
+        for (hi = apr_hash_first(NULL, obj->objects); hi != NULL; hi = apr_hash_next(hi)) {
+            apr_hash_this(hi, NULL, NULL, (void **) &o);
+            n = strlen(path) + 1 + strlen(o->fname) + 1;
+            tbx_type_malloc(cpath, char, n);
+            snprintf(cpath, n, "%s/%s", (path[1] == 0) ? "" : path, o->fname);
+
+            mark = el->n;
+            result = _ostc_compact_scan(o, cpath, expired, el);
+            okept += result;
+            if (result == 0) {  //** Just remove the whole object
+                _ostc_expired_truncate(el, mark);
+                _ostc_expired_add(el, cpath, NULL, 0);
+            } else {
+                free(cpath);
+            }
+        }
+    }
+
+    akept = 0;
+    for (hi = apr_hash_first(NULL, obj->attrs); hi != NULL; hi = apr_hash_next(hi)) {
+        apr_hash_this(hi, NULL, NULL, (void **) &a);
+        if (a->expire < expired) {
+            _ostc_expired_add(el, strdup(path), strdup(a->key), 0);
+        } else {
+            akept++;
+        }
+    }
+
+    return(akept + okept);
+}
+
+//***********************************************************************
+// _ostc_compact_apply - Removes the expired entries in the range given.
+//     Each entry is looked up again and rechecked since the tree could
+//     have changed after the scan.
+//
+//     NOTE: The cache write lock must be held by the calling process
+//***********************************************************************
+
+void _ostc_compact_apply(lio_object_service_fn_t *os, ostc_expired_list_t *el, int start, int end, apr_time_t expired)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    ostcdb_object_t *obj, *parent;
+    ostcdb_attr_t *a;
+    ostc_expired_t *e;
+    int i;
+
+    tbx_stack_init(&tree);
+    for (i=start; i<end; i++) {
+        e = el->entry + i;
+        tbx_stack_empty(&tree, 0);
+        if (_ostc_lio_cache_tree_walk(os, e->path, &tree, NULL, 0, OSTC_MAX_RECURSE) != 0) continue;
+
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);
+        if (obj == NULL) continue;
+
+        if (e->listing == 1) {
+            if ((obj->listing != NULL) && (obj->listing->expire < expired)) {
+                free_ostc_listing(obj->listing);
+                obj->listing = NULL;
+            }
+        } else if (e->key != NULL) {
+            a = apr_hash_get(obj->attrs, e->key, APR_HASH_KEY_STRING);
+            if ((a != NULL) && (a->expire < expired)) {
+                apr_hash_set(obj->attrs, a->key, APR_HASH_KEY_STRING, NULL);
+                free_ostcdb_attr(a);
+                ostc->n_attrs_removed++;
+            }
+        } else if (obj != ostc->cache_root) {
+            if (_ostc_cleanup(os, obj, expired) != 0) continue;  //** Something new was added
+
+            //** Make sure we got here through the parent and not a link before unhooking it
+            tbx_stack_move_up(&tree);
+            parent = tbx_stack_get_current_data(&tree);
+            if ((parent == NULL) || (parent->objects == NULL)) continue;
+            if (apr_hash_get(parent->objects, obj->fname, APR_HASH_KEY_STRING) != obj) continue;
+
+            apr_hash_set(parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);
+            free_ostcdb_object(obj, &ostc->n_objects_removed, &ostc->n_attrs_removed);
+        }
+    }
+    tbx_stack_empty(&tree, 0);
+}
+
+//***********************************************************************
+// _ostc_compact - Removes expired entries from the cache.  The tree is
+//     scanned with only a read lock and the removals are done in batches
+//     of compact_batch entries so readers are never held off for long.
+//***********************************************************************
+
+void _ostc_compact(lio_object_service_fn_t *os, apr_time_t expired)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_expired_list_t el;
+    int slot, i, n;
+
+    memset(&el, 0, sizeof(el));
+
+    slot = OSTC_RLOCK(ostc);
+    _ostc_compact_scan(ostc->cache_root, "/", expired, &el);
+    OSTC_RUNLOCK(ostc, slot);
+
+    log_printf(5, "n_expired=%d\n", el.n);
+
+    for (i=0; i<el.n; i += n) {
+        n = el.n - i;
+        if (n > ostc->compact_batch) n = ostc->compact_batch;
+        OSTC_LOCK(ostc);
+        _ostc_compact_apply(os, &el, i, i+n, expired);
+        OSTC_UNLOCK(ostc);
+    }
+
+    OSTC_LOCK(ostc);
+    _ostc_negative_cleanup(ostc, expired);
+    OSTC_UNLOCK(ostc);
+
+    _ostc_expired_truncate(&el, 0);
+    if (el.entry) free(el.entry);
+}
+
+//***********************************************************************
+// ostc_cache_compact_thread - Thread for cleaning out the cache
+//***********************************************************************
+
+void *ostc_cache_compact_thread(apr_thread_t *th, void *data)
+{
+    lio_object_service_fn_t *os = (lio_object_service_fn_t *)data;
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    apr_thread_mutex_lock(ostc->lock);
+    while (ostc->shutdown == 0) {
+        apr_thread_cond_timedwait(ostc->cond, ostc->lock, ostc->cleanup_interval);
+        if (ostc->shutdown != 0) break;
+        apr_thread_mutex_unlock(ostc->lock);
+
+        log_printf(5, "START: Running an attribute cleanup\n");
+        _ostc_compact(os, apr_time_now());
+        log_printf(5, "END: cleanup finished\n");
+
+        apr_thread_mutex_lock(ostc->lock);
+    }
+    apr_thread_mutex_unlock(ostc->lock);
+
+    return(NULL);
+}
+
 //***********************************************************************
 // ostcdb_resolve_attr_link - Follows the attribute symlinks and returns
 //   final object and attribute
@@ -678,7 +1111,7 @@ int _ostcdb_resolve_attr_link(lio_object_service_fn_t *os, tbx_stack_t *tree, ch
 {
     tbx_stack_t rtree;
     int i, n;
-    char *aname;
+    char *aname, *path;
     ostcdb_object_t *lo;
     ostcdb_attr_t *la;
 
@@ -687,17 +1120,19 @@ int _ostcdb_resolve_attr_link(lio_object_service_fn_t *os, tbx_stack_t *tree, ch
     lo = NULL;
     la = NULL;
 
-    //** 1st split the link into a path and attribute name
-    n = strlen(alink);
+    //** 1st split the link into a path and attribute name.  The link can be shared
+    //** with other readers so we split a copy.
+    path = strdup(alink);
+    n = strlen(path);
     aname = NULL;
     for (i=n-1; i>=0; i--) {
-        if (alink[i] == '/') {
-            aname = alink + i + 1;
-            alink[i] = 0;
+        if (path[i] == '/') {
+            aname = path + i + 1;
+            path[i] = 0;
             break;
         }
     }
-    log_printf(5, "alink=%s aname=%s i=%d mr=%d\n", alink, aname, i, max_recurse);
+    log_printf(5, "path=%s aname=%s i=%d mr=%d\n", path, aname, i, max_recurse);
 
     //** Copy the stack
     tbx_stack_init(&rtree);
@@ -714,11 +1149,7 @@ int _ostcdb_resolve_attr_link(lio_object_service_fn_t *os, tbx_stack_t *tree, ch
     //** and pop the terminal which is up.  This will pop us up to the directory for the walk
     tbx_stack_move_to_bottom(&rtree);
     tbx_stack_delete_current(&rtree, 1, 0);
-    if (_ostc_lio_cache_tree_walk(os, alink, &rtree, NULL, 0, OSTC_MAX_RECURSE) != 0) {
-        if (i> -1) alink[i] = '/';
-        goto finished;
-    }
-    if (i> -1) alink[i] = '/'; //** Undo our string munge if needed
+    if (_ostc_lio_cache_tree_walk(os, path, &rtree, NULL, 0, OSTC_MAX_RECURSE) != 0) goto finished;
     tbx_stack_move_to_bottom(&rtree);
     lo = tbx_stack_get_current_data(&rtree);  //** This will get placed as the next object on the stack
 
@@ -729,88 +1160,463 @@ int _ostcdb_resolve_attr_link(lio_object_service_fn_t *os, tbx_stack_t *tree, ch
     if (la != NULL) {
         log_printf(5, "alink=%s aname=%s lo=%s la->link=%s\n", alink, aname, lo->fname, la->link);
         if (la->link) {  //** Got to recurse
-            aname = strdup(la->link);
-            _ostcdb_resolve_attr_link(os, &rtree, aname, &lo, &la, max_recurse-1);
-            free(aname);
+            _ostcdb_resolve_attr_link(os, &rtree, la->link, &lo, &la, max_recurse-1);
         }
     }
 
 finished:
+    free(path);
     tbx_stack_empty(&rtree, 0);
     *lattr = la;
     *lobj = lo;
 
-    return(((la != NULL) && (lo != NULL)) ? 0 : 1);
+    return(((la != NULL) && (lo != NULL)) ? 0 : 1);
+}
+
+
+//***********************************************************************
+// _ostc_listing_invalidate - Drops the listing of the directory holding path
+//     NOTE: The cache write lock must be held by the calling process
+//***********************************************************************
+
+void _ostc_listing_invalidate(lio_object_service_fn_t *os, char *path)
+{
+    tbx_stack_t tree;
+    ostcdb_object_t *obj;
+    char *dir;
+    int i;
+
+    //** Peel off the last component
+    dir = strdup(path);
+    i = strlen(dir) - 1;
+    while ((i > 0) && (dir[i] == '/')) i--;
+    while ((i > 0) && (dir[i] != '/')) i--;
+    dir[(i > 0) ? i : 1] = 0;
+
+    tbx_stack_init(&tree);
+    if (_ostc_lio_cache_tree_walk(os, dir, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);
+        if ((obj != NULL) && (obj->listing != NULL)) {
+            free_ostc_listing(obj->listing);
+            obj->listing = NULL;
+        }
+    }
+    tbx_stack_empty(&tree, 0);
+    free(dir);
+}
+
+//***********************************************************************
+// _ostc_ns_changed - Drops any negative entry and the parent's listing
+//     for an object that was just created, moved, or removed.  Only the
+//     generations of the parent and the object itself are bumped so
+//     lookups in unrelated directories can still be stored.
+//     NOTE: The cache write lock must be held by the calling process
+//***********************************************************************
+
+void _ostc_ns_changed(lio_object_service_fn_t *os, char *path)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_negative_t *ne;
+
+    //** Anything looked up before this can't be stored
+    ostc->dir_gen[_ostc_gen_slot(path, 1)]++;
+    ostc->dir_gen[_ostc_gen_slot(path, 0)]++;
+
+    ne = apr_hash_get(ostc->negative, path, APR_HASH_KEY_STRING);
+    if (ne != NULL) {
+        apr_hash_set(ostc->negative, ne->path, APR_HASH_KEY_STRING, NULL);
+        free(ne->path);
+        free(ne);
+    }
+
+    _ostc_listing_invalidate(os, path);
+}
+
+//***********************************************************************
+// ostc_cache_exists - Checks the cache for the object.  Returns the object
+//     type if it's cached, 0 if it's known not to exist, and -1 otherwise.
+//     The parent directory's generation is returned for use when adding
+//     a negative entry.
+//***********************************************************************
+
+int ostc_cache_exists(lio_object_service_fn_t *os, char *path, ex_off_t *gen)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    ostcdb_object_t *obj;
+    ostc_negative_t *ne;
+    int ftype, slot;
+
+    tbx_stack_init(&tree);
+    ftype = -1;
+
+    slot = OSTC_RLOCK(ostc);
+    *gen = ostc->ns_gen + ostc->dir_gen[_ostc_gen_slot(path, 1)];
+    if (_ostc_lio_cache_tree_walk(os, path, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);
+        if ((obj != NULL) && (obj->ftype > 0)) ftype = obj->ftype;
+    } else {
+        ne = apr_hash_get(ostc->negative, path, APR_HASH_KEY_STRING);
+        if ((ne != NULL) && (ne->expire > apr_time_now())) ftype = 0;
+    }
+    OSTC_RUNLOCK(ostc, slot);
+
+    tbx_stack_empty(&tree, 0);
+
+    if (ftype == 0) __atomic_fetch_add(&(ostc->n_negative_hit), 1, __ATOMIC_RELAXED);
+
+    return(ftype);
+}
+
+//***********************************************************************
+// ostc_cache_negative_hit - Returns 1 if the object is known not to exist
+//***********************************************************************
+
+int ostc_cache_negative_hit(lio_object_service_fn_t *os, char *path)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_negative_t *ne;
+    int hit, slot;
+
+    if (ostc->negative_timeout == 0) return(0);
+
+    slot = OSTC_RLOCK(ostc);
+    ne = apr_hash_get(ostc->negative, path, APR_HASH_KEY_STRING);
+    hit = ((ne != NULL) && (ne->expire > apr_time_now())) ? 1 : 0;
+    OSTC_RUNLOCK(ostc, slot);
+
+    if (hit) __atomic_fetch_add(&(ostc->n_negative_hit), 1, __ATOMIC_RELAXED);
+
+    return(hit);
+}
+
+//***********************************************************************
+// ostc_cache_negative_add - Records that the object doesn't exist.  Nothing
+//     is stored if the parent directory changed since gen was sampled.
+//***********************************************************************
+
+void ostc_cache_negative_add(lio_object_service_fn_t *os, char *path, ex_off_t gen)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_negative_t *ne;
+
+    if (ostc->negative_timeout == 0) return;
+
+    OSTC_LOCK(ostc);
+    if (gen == (ostc->ns_gen + ostc->dir_gen[_ostc_gen_slot(path, 1)])) {
+        ne = apr_hash_get(ostc->negative, path, APR_HASH_KEY_STRING);
+        if (ne == NULL) {
+            tbx_type_malloc(ne, ostc_negative_t, 1);
+            ne->path = strdup(path);
+            apr_hash_set(ostc->negative, ne->path, APR_HASH_KEY_STRING, ne);
+        }
+        ne->expire = apr_time_now() + ostc->negative_timeout;
+    }
+    OSTC_UNLOCK(ostc);
+}
+
+//***********************************************************************
+//  ostc_cache_create_object - Invalidates the cache for a newly created object
+//***********************************************************************
+
+void ostc_cache_create_object(lio_object_service_fn_t *os, char *path)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    OSTC_LOCK(ostc);
+    _ostc_ns_changed(os, path);
+    OSTC_UNLOCK(ostc);
+}
+
+//***********************************************************************
+//  ostc_cache_move_object - Moves an existing cache object within the cache
+//***********************************************************************
+
+void ostc_cache_move_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *dest_path)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    ostcdb_object_t *obj, *parent;
+    int i;
+
+    tbx_stack_init(&tree);
+
+    OSTC_LOCK(ostc);
+    ostc->ns_gen++;  //** Everything under both paths changed
+    _ostc_ns_changed(os, src_path);
+    _ostc_ns_changed(os, dest_path);
+    _ostc_negative_cleanup(ostc, 0);  //** Anything under the destination could exist now
+
+    if (_ostc_lio_cache_tree_walk(os, src_path, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);  //** Snag what we want to move
+
+        tbx_stack_move_up(&tree);
+        parent = tbx_stack_get_current_data(&tree);
+        apr_hash_set(parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);  //** Delete it from it's old location
+
+        //** Peel off the new fname
+        for (i = strlen(dest_path); i>0; i--) {
+            if (dest_path[i] == '/') break;
+        }
+        if (dest_path[i] == '/') i++;
+        free(obj->fname);
+        obj->fname = strdup(&(dest_path[i]));
+        log_printf(0, "src=%s dest=%s dname=%s\n", src_path, dest_path, obj->fname);
+
+        //** Do the walk and add it back
+        tbx_stack_empty(&tree, 0);
+        if (_ostc_lio_cache_tree_walk(os, dest_path, &tree, obj, obj->ftype, OSTC_MAX_RECURSE) != 0) {
+            free_ostcdb_object(obj, &ostc->n_objects_removed, &ostc->n_attrs_removed);  //**Failed to walk the destination path
+        }
+    }
+
+    OSTC_UNLOCK(ostc);
+
+    tbx_stack_empty(&tree, 0);
+}
+
+//***********************************************************************
+//  ostc_cache_remove_object - Removes a cache object
+//***********************************************************************
+
+void ostc_cache_remove_object(lio_object_service_fn_t *os, char *path)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    ostcdb_object_t *obj, *parent;
+
+    tbx_stack_init(&tree);
+
+    OSTC_LOCK(ostc);
+    _ostc_ns_changed(os, path);
+    if (_ostc_lio_cache_tree_walk(os, path, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);
+        tbx_stack_move_up(&tree);
+        parent = tbx_stack_get_current_data(&tree);
+        apr_hash_set(parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);
+        free_ostcdb_object(obj, &ostc->n_objects_removed, &ostc->n_attrs_removed);
+    }
+    OSTC_UNLOCK(ostc);
+
+    tbx_stack_empty(&tree, 0);
+}
+
+//***********************************************************************
+//  ostc_cache_purge - Drops everything in the cache
+//***********************************************************************
+
+void ostc_cache_purge(lio_object_service_fn_t *os)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    OSTC_LOCK(ostc);
+    ostc->ns_gen++;
+    _ostc_cleanup(os, ostc->cache_root, INT64_MAX);
+    _ostc_negative_cleanup(ostc, 0);
+    OSTC_UNLOCK(ostc);
+}
+
+//***********************************************************************
+//  ostc_cache_remove_all_attrs - Drops all the cached attributes for the
+//      object but leaves the object and anything below it.  The object's
+//      generation is bumped so attributes fetched before this aren't stored.
+//***********************************************************************
+
+void ostc_cache_remove_all_attrs(lio_object_service_fn_t *os, char *path)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    ostcdb_object_t *obj;
+    ostcdb_attr_t *a;
+    apr_hash_index_t *hi;
+
+    tbx_stack_init(&tree);
+
+    OSTC_LOCK(ostc);
+    ostc->dir_gen[_ostc_gen_slot(path, 0)]++;
+    if (_ostc_lio_cache_tree_walk(os, path, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);
+        for (hi = apr_hash_first(NULL, obj->attrs); hi != NULL; hi = apr_hash_next(hi)) {
+            apr_hash_this(hi, NULL, NULL, (void **)&a);
+            apr_hash_set(obj->attrs, a->key, APR_HASH_KEY_STRING, NULL);
+            free_ostcdb_attr(a);
+            ostc->n_attrs_removed++;
+        }
+    }
+    OSTC_UNLOCK(ostc);
+
+    tbx_stack_empty(&tree, 0);
+}
+
+//***********************************************************************
+//  ostc_cache_invalidate - Applies an invalidation from the server
+//***********************************************************************
+
+void ostc_cache_invalidate(lio_object_service_fn_t *os, lio_osr_inval_t *e)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    log_printf(5, "type=%d path=%s\n", e->type, e->path);
+
+    __atomic_fetch_add(&ostc->n_invalidations, 1, __ATOMIC_RELAXED);
+
+    switch (e->type) {
+    case OSR_INVAL_ALL:
+        ostc_cache_purge(os);
+        break;
+    case OSR_INVAL_ATTR:
+        ostc_cache_remove_all_attrs(os, e->path);
+        break;
+    case OSR_INVAL_TREE:
+        OSTC_LOCK(ostc);
+        ostc->ns_gen++;  //** Anything below it could have changed
+        OSTC_UNLOCK(ostc);
+        ostc_cache_remove_object(os, e->path);
+        break;
+    default:   //** OSR_INVAL_OBJECT
+        ostc_cache_remove_object(os, e->path);
+        break;
+    }
+}
+
+//***********************************************************************
+// _ostc_watch_prefixes - Forms the list of prefixes to watch from the top
+//     level of the cache.  If there are too many we just watch everything.
+//     Other readers can be walking the same hash so a private iterator
+//     is used.
+//***********************************************************************
+
+int _ostc_watch_prefixes(lio_object_service_fn_t *os, char ***prefix)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostcdb_object_t *o;
+    apr_hash_index_t *hi;
+    apr_pool_t *pool;
+    char **p;
+    int n, slot;
+
+    apr_pool_create(&pool, NULL);
+
+    slot = OSTC_RLOCK(ostc);
+    n = apr_hash_count(ostc->cache_root->objects);
+    if (n > ostc->watch_max_prefixes) {
+        tbx_type_malloc(p, char *, 1);
+        p[0] = strdup("/");
+        n = 1;
+    } else {
+        tbx_type_malloc(p, char *, n+1);
+        n = 0;
+        for (hi = apr_hash_first(pool, ostc->cache_root->objects); hi != NULL; hi = apr_hash_next(hi)) {
+            apr_hash_this(hi, NULL, NULL, (void **)&o);
+            tbx_type_malloc(p[n], char, strlen(o->fname) + 2);
+            sprintf(p[n], "/%s", o->fname);
+            n++;
+        }
+    }
+    OSTC_RUNLOCK(ostc, slot);
+
+    apr_pool_destroy(pool);
+
+    *prefix = p;
+    return(n);
 }
 
-
 //***********************************************************************
-//  ostc_cache_move_object - Moves an existing cache object within the cache
+// _ostc_watch_prefix_added - Returns 1 if there are any prefixes in the
+//     new list that aren't in the old one
 //***********************************************************************
 
-void ostc_cache_move_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *dest_path)
+int _ostc_watch_prefix_added(char **old, int n_old, char **prefix, int n)
 {
-    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
-    tbx_stack_t tree;
-    ostcdb_object_t *obj, *parent;
-    int i;
-
-    tbx_stack_init(&tree);
-
-    OSTC_LOCK(ostc);
-    if (_ostc_lio_cache_tree_walk(os, src_path, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
-        tbx_stack_move_to_bottom(&tree);
-        obj = tbx_stack_get_current_data(&tree);  //** Snag what we want to move
-
-        tbx_stack_move_up(&tree);
-        parent = tbx_stack_get_current_data(&tree);
-        apr_hash_set(parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);  //** Delete it from it's old location
-
-        //** Peel off the new fname
-        for (i = strlen(dest_path); i>0; i--) {
-            if (dest_path[i] == '/') break;
-        }
-        if (dest_path[i] == '/') i++;
-        free(obj->fname);
-        obj->fname = strdup(&(dest_path[i]));
-        log_printf(0, "src=%s dest=%s dname=%s\n", src_path, dest_path, obj->fname);
+    int i, j;
 
-        //** Do the walk and add it back
-        tbx_stack_empty(&tree, 0);
-        if (_ostc_lio_cache_tree_walk(os, dest_path, &tree, obj, obj->ftype, OSTC_MAX_RECURSE) != 0) {
-            free_ostcdb_object(obj, &ostc->n_objects_removed, &ostc->n_attrs_removed);  //**Failed to walk the destination path
+    for (i=0; i<n; i++) {
+        for (j=0; j<n_old; j++) {
+            if (strcmp(prefix[i], old[j]) == 0) break;
         }
+        if (j == n_old) return(1);
     }
 
-    OSTC_UNLOCK(ostc);
-
-    tbx_stack_empty(&tree, 0);
+    return(0);
 }
 
 //***********************************************************************
-//  ostc_cache_remove_object - Removes a cache object
+// ostc_watch_thread - Long polls the remote server for invalidations
+//     under the cached prefixes and applies them.
 //***********************************************************************
 
-void ostc_cache_remove_object(lio_object_service_fn_t *os, char *path)
+void *ostc_watch_thread(apr_thread_t *th, void *data)
 {
+    lio_object_service_fn_t *os = (lio_object_service_fn_t *)data;
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
-    tbx_stack_t tree;
-    ostcdb_object_t *obj, *parent;
+    tbx_stack_t *events;
+    lio_osr_inval_t *e;
+    gop_op_generic_t *gop;
+    gop_op_status_t status;
+    char **prefix, **last_prefix;
+    int n_prefix, n_last, i;
+    int64_t epoch, seq, start;
 
-    tbx_stack_init(&tree);
+    epoch = seq = start = 0;
+    last_prefix = NULL;
+    n_last = 0;
+    events = tbx_stack_new();
 
-    OSTC_LOCK(ostc);
-    if (_ostc_lio_cache_tree_walk(os, path, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
-        tbx_stack_move_to_bottom(&tree);
-        obj = tbx_stack_get_current_data(&tree);
-        tbx_stack_move_up(&tree);
-        parent = tbx_stack_get_current_data(&tree);
-        apr_hash_set(parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);
-        free_ostcdb_object(obj, &ostc->n_objects_removed, &ostc->n_attrs_removed);
+    apr_thread_mutex_lock(ostc->lock);
+    while (ostc->shutdown == 0) {
+        n_prefix = _ostc_watch_prefixes(os, &prefix);
+
+        //** Invalidations for a newly cached prefix could have been filtered out
+        //** of the last watch so replay from where it started.
+        if (_ostc_watch_prefix_added(last_prefix, n_last, prefix, n_prefix) == 0) start = seq;
+        seq = start;
+
+        gop = osrc_watch(ostc->os_child, ostc->watch_creds, prefix, n_prefix, ostc->watch_wait, &epoch, &seq, events);
+        gop_start_execution(gop);
+        apr_thread_mutex_unlock(ostc->lock);
+
+        gop_waitall(gop);
+        status = gop_get_status(gop);
+        gop_free(gop, OP_DESTROY);
+
+        if (status.op_status == OP_STATE_SUCCESS) {
+            while ((e = tbx_stack_pop(events)) != NULL) {
+                ostc_cache_invalidate(os, e);
+                free(e->path);
+                free(e);
+            }
+        } else {  //** Lost track of the server so nothing cached can be trusted
+            log_printf(1, "Watch failed.  Purging the cache\n");
+            ostc_cache_purge(os);
+            epoch = seq = start = 0;
+        }
+
+        if (last_prefix) {
+            for (i=0; i<n_last; i++) free(last_prefix[i]);
+            free(last_prefix);
+        }
+        last_prefix = prefix;
+        n_last = n_prefix;
+
+        apr_thread_mutex_lock(ostc->lock);
+        if ((status.op_status != OP_STATE_SUCCESS) && (ostc->shutdown == 0)) {
+            apr_thread_cond_timedwait(ostc->cond, ostc->lock, apr_time_from_sec(1));
+        }
     }
-    OSTC_UNLOCK(ostc);
+    apr_thread_mutex_unlock(ostc->lock);
 
-    tbx_stack_empty(&tree, 0);
+    if (last_prefix) {
+        for (i=0; i<n_last; i++) free(last_prefix[i]);
+        free(last_prefix);
+    }
+    tbx_stack_free(events, 1);
+
+    return(NULL);
 }
 
 //***********************************************************************
@@ -892,10 +1698,11 @@ finished:
 
 
 //***********************************************************************
-//  ostc_cache_process_attrs - Merges the attrs into the cache
+//  ostc_cache_process_attrs - Merges the attrs into the cache.  Nothing is
+//      stored if the object's generation changed since gen was sampled.
 //***********************************************************************
 
-void ostc_cache_process_attrs(lio_object_service_fn_t *os, char *fname, int ftype, char **key_list, void **val, int *v_size, int n)
+void ostc_cache_process_attrs(lio_object_service_fn_t *os, char *fname, int ftype, char **key_list, void **val, int *v_size, int n, ex_off_t gen)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
     tbx_stack_t tree;
@@ -907,6 +1714,7 @@ void ostc_cache_process_attrs(lio_object_service_fn_t *os, char *fname, int ftyp
     tbx_stack_init(&tree);
 
     OSTC_LOCK(ostc);
+    if (gen != (ostc->ns_gen + ostc->dir_gen[_ostc_gen_slot(fname, 0)])) goto finished;  //** Invalidated while fetching
     if (_ostc_lio_cache_tree_walk(os, fname, &tree, NULL, ftype, OSTC_MAX_RECURSE) != 0) goto finished;
 
     log_printf(5, "fname=%s stack_size=%d\n", fname, tbx_stack_count(&tree));
@@ -1003,13 +1811,13 @@ gop_op_status_t ostc_cache_fetch(lio_object_service_fn_t *os, char *fname, char
     gop_op_status_t status = gop_failure_status;
     void *va[n];
     int vs[n];
-    int i, oops;
+    int i, oops, slot;
 
     tbx_stack_init(&tree);
     oops = 0;
 
 //log_printf(5, "fname=%s\n", fname);
-    OSTC_LOCK(ostc);
+    slot = OSTC_RLOCK(ostc);
     if (_ostc_lio_cache_tree_walk(os, fname, &tree, NULL, 0, OSTC_MAX_RECURSE) != 0) goto finished;
 
     tbx_stack_move_to_bottom(&tree);
@@ -1040,12 +1848,12 @@ gop_op_status_t ostc_cache_fetch(lio_object_service_fn_t *os, char *fname, char
 
 finished:
     if (oops == 0) {
-        ostc->n_attrs_hit += n;
+        __atomic_fetch_add(&(ostc->n_attrs_hit), n, __ATOMIC_RELAXED);
     } else {
-        ostc->n_attrs_miss += n;
+        __atomic_fetch_add(&(ostc->n_attrs_miss), n, __ATOMIC_RELAXED);
     }
 
-    OSTC_UNLOCK(ostc);
+    OSTC_RUNLOCK(ostc, slot);
 
     if (oops == 1) { //** Got to unroll the values stored
         oops = i;
@@ -1131,17 +1939,18 @@ int ostc_cache_populate_prefix(lio_object_service_fn_t *os, lio_creds_t *creds,
     char *key_array[1], *val_array[1];
     char *fname, *key, *val;
     int v_size[1];
-    int err, start, end, len, ftype;
+    int err, start, end, len, ftype, slot;
     int max_wait = 10;
+    ex_off_t gen;
     gop_op_status_t status;
 
     len = strlen(path);
     if (len == 1) return(0);  //** Nothing to do.  Just a '/'
 
     tbx_stack_init(&tree);
-    OSTC_LOCK(ostc);
+    slot = OSTC_RLOCK(ostc);
     err = _ostc_lio_cache_tree_walk(os, path, &tree, NULL, 0, OSTC_MAX_RECURSE);
-    OSTC_UNLOCK(ostc);
+    OSTC_RUNLOCK(ostc, slot);
     tbx_stack_empty(&tree, 0);
     if (err <= 0)  return(err);
 
@@ -1167,6 +1976,7 @@ int ostc_cache_populate_prefix(lio_object_service_fn_t *os, lio_creds_t *creds,
     v_size[0] = -100;
     ostc_attr_cacheprep_setup(&cp, 1, key_array, (void **)val_array, v_size, 1);
 
+    gen = ostc_cache_gen(ostc, fname, 0);
     err = gop_sync_exec(os_open_object(ostc->os_child, creds, fname, OS_MODE_READ_IMMEDIATE, NULL, &fd, max_wait));
     if (err != OP_STATE_SUCCESS) {
         log_printf(1, "ERROR opening object=%s\n", path);
@@ -1186,7 +1996,7 @@ int ostc_cache_populate_prefix(lio_object_service_fn_t *os, lio_creds_t *creds,
     if (status.op_status == OP_STATE_SUCCESS) {
         ftype = ostc_attr_cacheprep_ftype(&cp);
         log_printf(1, "storing=%s ftype=%d end=%d len=%d v_size[0]=%d\n", fname, ftype, end, len, cp.v_size[0]);
-        ostc_cache_process_attrs(os, fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys);
+        ostc_cache_process_attrs(os, fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys, gen);
         ostc_attr_cacheprep_copy(&cp, (void **)val_array, v_size);
         if (end < (len-1)) { //** Recurse and add the next layer
             log_printf(1, "recursing object=%s\n", path);
@@ -1202,6 +2012,77 @@ int ostc_cache_populate_prefix(lio_object_service_fn_t *os, lio_creds_t *creds,
 }
 
 
+//***********************************************************************
+// ostc_cache_listing_get - Returns a copy of the directory listing if it's
+//     cached and hasn't expired.
+//***********************************************************************
+
+ostc_listing_t *ostc_cache_listing_get(lio_object_service_fn_t *os, char *dir)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    ostcdb_object_t *obj;
+    ostc_listing_t *l;
+    int slot;
+
+    tbx_stack_init(&tree);
+    l = NULL;
+
+    slot = OSTC_RLOCK(ostc);
+    if (_ostc_lio_cache_tree_walk(os, dir, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);
+        if ((obj != NULL) && (obj->listing != NULL) && (obj->listing->expire > apr_time_now())) {
+            l = ostc_listing_dup(obj->listing);
+        }
+    }
+    OSTC_RUNLOCK(ostc, slot);
+
+    tbx_stack_empty(&tree, 0);
+
+    if (l) __atomic_fetch_add(&(ostc->n_listing_hit), 1, __ATOMIC_RELAXED);
+
+    return(l);
+}
+
+//***********************************************************************
+// ostc_cache_listing_store - Stores a complete directory listing.  The
+//     directory is added to the cache if needed.  If the directory changed
+//     since gen was sampled the listing is discarded.  Either way the
+//     listing is consumed.
+//***********************************************************************
+
+void ostc_cache_listing_store(lio_object_service_fn_t *os, lio_creds_t *creds, char *dir, ostc_listing_t *l, ex_off_t gen)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    ostcdb_object_t *obj;
+
+    if (ostc_cache_populate_prefix(os, creds, dir, 0) < 0) {
+        free_ostc_listing(l);
+        return;
+    }
+
+    tbx_stack_init(&tree);
+    obj = NULL;
+
+    OSTC_LOCK(ostc);
+    if ((gen == (ostc->ns_gen + ostc->dir_gen[_ostc_gen_slot(dir, 0)])) && (_ostc_lio_cache_tree_walk(os, dir, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0)) {
+        tbx_stack_move_to_bottom(&tree);
+        obj = tbx_stack_get_current_data(&tree);
+        if ((obj != NULL) && (obj->objects != NULL)) {
+            if (obj->listing) free_ostc_listing(obj->listing);
+            l->expire = apr_time_now() + ostc->listing_timeout;
+            obj->listing = l;
+            l = NULL;
+        }
+    }
+    OSTC_UNLOCK(ostc);
+
+    tbx_stack_empty(&tree, 0);
+    if (l) free_ostc_listing(l);
+}
+
 //***********************************************************************
 // ostc_remove_regex_object_fn - Simple passthru with purging of my cache.
 //      This command is rarely used.  Hence the simple purging.
@@ -1218,9 +2099,9 @@ gop_op_status_t ostc_remove_regex_object_fn(void *arg, int tid)
 
     //** Since we don't know what was removed we're going to purge everything to make life easy.
     if (status.op_status == OP_STATE_SUCCESS) {
-        apr_thread_mutex_lock(ostc->lock);
+        OSTC_LOCK(ostc);
         _ostc_cleanup(op->os, ostc->cache_root, apr_time_now() + 4*ostc->entry_timeout);
-        apr_thread_mutex_unlock(ostc->lock);
+        OSTC_UNLOCK(ostc);
     }
 
     return(status);
@@ -1334,6 +2215,35 @@ gop_op_generic_t *ostc_abort_regex_object_set_multiple_attrs(lio_object_service_
 }
 
 
+//***********************************************************************
+// ostc_exists_fn - Checks the cache before asking the child if the object exists
+//***********************************************************************
+
+gop_op_status_t ostc_exists_fn(void *arg, int tid)
+{
+    ostc_move_op_t *op = (ostc_move_op_t *)arg;
+    ostc_priv_t *ostc = (ostc_priv_t *)op->os->priv;
+    gop_op_status_t status;
+    ex_off_t gen;
+    int ftype;
+
+    ftype = ostc_cache_exists(op->os, op->src_path, &gen);
+    if (ftype > 0) {
+        status = gop_success_status;
+        status.error_code = ftype;
+        return(status);
+    } else if (ftype == 0) {
+        return(gop_failure_status);
+    }
+
+    status = gop_sync_exec_status(os_exists(ostc->os_child, op->creds, op->src_path));
+    if ((status.op_status == OP_STATE_FAILURE) && (status.error_code == 0)) {
+        ostc_cache_negative_add(op->os, op->src_path, gen);
+    }
+
+    return(status);
+}
+
 //***********************************************************************
 //  ostc_exists - Returns the object type  and 0 if it doesn't exist
 //***********************************************************************
@@ -1341,8 +2251,32 @@ gop_op_generic_t *ostc_abort_regex_object_set_multiple_attrs(lio_object_service_
 gop_op_generic_t *ostc_exists(lio_object_service_fn_t *os, lio_creds_t *creds, char *path)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_move_op_t *op;
+
+    tbx_type_malloc_clear(op, ostc_move_op_t, 1);
+    op->os = os;
+    op->creds = creds;
+    op->src_path = path;
+
+    return(gop_tp_op_new(ostc->tpc, NULL, ostc_exists_fn, (void *)op, free, 1));
+}
 
-    return(os_exists(ostc->os_child, creds, path));
+//***********************************************************************
+// ostc_create_object_fn - Handles the actual object creation
+//***********************************************************************
+
+gop_op_status_t ostc_create_object_fn(void *arg, int tid)
+{
+    ostc_move_op_t *op = (ostc_move_op_t *)arg;
+    ostc_priv_t *ostc = (ostc_priv_t *)op->os->priv;
+    gop_op_status_t status;
+
+    status = gop_sync_exec_status(os_create_object(ostc->os_child, op->creds, op->src_path, op->type, op->id));
+
+    //** Even a failure could mean somebody else made it so always invalidate
+    ostc_cache_create_object(op->os, op->src_path);
+
+    return(status);
 }
 
 //***********************************************************************
@@ -1352,10 +2286,33 @@ gop_op_generic_t *ostc_exists(lio_object_service_fn_t *os, lio_creds_t *creds, c
 gop_op_generic_t *ostc_create_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *path, int type, char *id)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_move_op_t *op;
+
+    tbx_type_malloc_clear(op, ostc_move_op_t, 1);
+    op->os = os;
+    op->creds = creds;
+    op->src_path = path;
+    op->type = type;
+    op->id = id;
 
-    return(os_create_object(ostc->os_child, creds, path, type, id));
+    return(gop_tp_op_new(ostc->tpc, NULL, ostc_create_object_fn, (void *)op, free, 1));
 }
 
+//***********************************************************************
+// ostc_symlink_object_fn - Handles the actual symlink creation
+//***********************************************************************
+
+gop_op_status_t ostc_symlink_object_fn(void *arg, int tid)
+{
+    ostc_move_op_t *op = (ostc_move_op_t *)arg;
+    ostc_priv_t *ostc = (ostc_priv_t *)op->os->priv;
+    gop_op_status_t status;
+
+    status = gop_sync_exec_status(os_symlink_object(ostc->os_child, op->creds, op->src_path, op->dest_path, op->id));
+    ostc_cache_create_object(op->os, op->dest_path);
+
+    return(status);
+}
 
 //***********************************************************************
 // ostc_symlink_object - Generates a symbolic link object operation
@@ -1364,10 +2321,33 @@ gop_op_generic_t *ostc_create_object(lio_object_service_fn_t *os, lio_creds_t *c
 gop_op_generic_t *ostc_symlink_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *dest_path, char *id)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_move_op_t *op;
+
+    tbx_type_malloc_clear(op, ostc_move_op_t, 1);
+    op->os = os;
+    op->creds = creds;
+    op->src_path = src_path;
+    op->dest_path = dest_path;
+    op->id = id;
 
-    return(os_symlink_object(ostc->os_child, creds, src_path, dest_path, id));
+    return(gop_tp_op_new(ostc->tpc, NULL, ostc_symlink_object_fn, (void *)op, free, 1));
 }
 
+//***********************************************************************
+// ostc_hardlink_object_fn - Handles the actual hard link creation
+//***********************************************************************
+
+gop_op_status_t ostc_hardlink_object_fn(void *arg, int tid)
+{
+    ostc_move_op_t *op = (ostc_move_op_t *)arg;
+    ostc_priv_t *ostc = (ostc_priv_t *)op->os->priv;
+    gop_op_status_t status;
+
+    status = gop_sync_exec_status(os_hardlink_object(ostc->os_child, op->creds, op->src_path, op->dest_path, op->id));
+    ostc_cache_create_object(op->os, op->dest_path);
+
+    return(status);
+}
 
 //***********************************************************************
 // ostc_hardlink_object - Generates a hard link object operation
@@ -1376,8 +2356,16 @@ gop_op_generic_t *ostc_symlink_object(lio_object_service_fn_t *os, lio_creds_t *
 gop_op_generic_t *ostc_hardlink_object(lio_object_service_fn_t *os, lio_creds_t *creds, char *src_path, char *dest_path, char *id)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_move_op_t *op;
+
+    tbx_type_malloc_clear(op, ostc_move_op_t, 1);
+    op->os = os;
+    op->creds = creds;
+    op->src_path = src_path;
+    op->dest_path = dest_path;
+    op->id = id;
 
-    return(os_hardlink_object(ostc->os_child, creds, src_path, dest_path, id));
+    return(gop_tp_op_new(ostc->tpc, NULL, ostc_hardlink_object_fn, (void *)op, free, 1));
 }
 
 //***********************************************************************
@@ -1679,6 +2667,7 @@ gop_op_status_t ostc_get_attrs_fn(void *arg, int tid)
     ostc_priv_t *ostc = (ostc_priv_t *)ma->os->priv;
     gop_op_status_t status;
     int ftype;
+    ex_off_t gen;
     ostc_cacheprep_t cp;
 
 
@@ -1696,6 +2685,7 @@ gop_op_status_t ostc_get_attrs_fn(void *arg, int tid)
 
     ostc_attr_cacheprep_setup(&cp, ma->n, ma->key, ma->val, ma->v_size, 1);
 
+    gen = ostc_cache_gen(ostc, ma->fd->fname, 0);
     if (ma->fd->fd_child == NULL) {
         status = ostc_delayed_open_object(ma->os, ma->fd);
         if (status.op_status == OP_STATE_FAILURE) goto failed;
@@ -1706,7 +2696,7 @@ gop_op_status_t ostc_get_attrs_fn(void *arg, int tid)
     //** Store them in the cache on success
     if (status.op_status == OP_STATE_SUCCESS) {
         ftype = ostc_attr_cacheprep_ftype(&cp);
-        ostc_cache_process_attrs(ma->os, ma->fd->fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys);
+        ostc_cache_process_attrs(ma->os, ma->fd->fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys, gen);
         ostc_attr_cacheprep_copy(&cp, ma->val, ma->v_size);
     }
 
@@ -1905,6 +2895,88 @@ void ostc_destroy_attr_iter(os_attr_iter_t *oit)
     free(it);
 }
 
+//***********************************************************************
+// _ostc_listing_dir - Returns the directory if the iterator is a plain
+//     listing of a single directory, ie "dir/*", which can be cached.
+//     Otherwise NULL is returned.
+//***********************************************************************
+
+char *_ostc_listing_dir(lio_os_regex_table_t *path, lio_os_regex_table_t *object_regex, int recurse_depth)
+{
+    lio_os_regex_entry_t *last;
+    char *dir;
+    int n;
+
+    if ((path == NULL) || (object_regex != NULL) || (recurse_depth != 0)) return(NULL);
+    if ((path->n < 1) || (path->n > 2)) return(NULL);
+
+    last = path->regex_entry + path->n - 1;
+    if ((last->fixed == 1) || (strcmp(last->expression, "^.*$") != 0)) return(NULL);
+
+    if (path->n == 1) return(strdup("/"));
+    if (path->regex_entry[0].fixed != 1) return(NULL);
+
+    n = strlen(path->regex_entry[0].expression) + 2;
+    tbx_type_malloc(dir, char, n);
+    snprintf(dir, n, "/%s", path->regex_entry[0].expression);
+    return(dir);
+}
+
+//***********************************************************************
+// ostc_next_cached_object - Returns the next object from a cached listing
+//***********************************************************************
+
+int ostc_next_cached_object(ostc_object_iter_t *it, char **fname, int *prefix_len)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)it->os->priv;
+    ostc_mult_attr_t ma;
+    ostc_fd_t fd;
+    gop_op_status_t status;
+    char *dir;
+    int i, n, ftype;
+
+    dir = (strcmp(it->ldir, "/") == 0) ? "" : it->ldir;
+
+    while (it->lslot < it->listing->n) {
+        i = it->lslot++;
+        ftype = it->listing->ftype[i];
+        if ((ftype & it->object_types) == 0) continue;
+
+        n = strlen(dir) + 1 + strlen(it->listing->name[i]) + 1;
+        tbx_type_malloc(*fname, char, n);
+        snprintf(*fname, n, "%s/%s", dir, it->listing->name[i]);
+        *prefix_len = strlen(dir);
+
+        //** Get the attributes.  This comes from cache unless they've expired
+        memcpy(it->v_size, it->v_size_initial, it->n_keys*sizeof(int));
+        memset(&fd, 0, sizeof(fd));
+        fd.fname = *fname;
+        fd.mode = OS_MODE_READ_IMMEDIATE;
+        fd.max_wait = it->fd.max_wait;
+        fd.creds = it->creds;
+        memset(&ma, 0, sizeof(ma));
+        ma.os = it->os;
+        ma.creds = it->creds;
+        ma.fd = &fd;
+        ma.key = it->cp.key;
+        ma.val = it->val;
+        ma.v_size = it->v_size;
+        ma.n = it->n_keys;
+        status = ostc_get_attrs_fn(&ma, 0);
+        if (fd.fd_child != NULL) gop_sync_exec(os_close_object(ostc->os_child, fd.fd_child));
+
+        if (status.op_status == OP_STATE_SUCCESS) return(ftype);
+
+        //** It was removed after the listing was made so skip it
+        log_printf(5, "Skipping fname=%s\n", *fname);
+        free(*fname);
+    }
+
+    *fname = NULL;
+    *prefix_len = -1;
+    return(0);
+}
+
 //***********************************************************************
 // ostc_next_object - Returns the iterators next matching object
 //***********************************************************************
@@ -1922,19 +2994,39 @@ int ostc_next_object(os_object_iter_t *oit, char **fname, int *prefix_len)
         return(-2);
     }
 
+    if (it->from_cache) return(ostc_next_cached_object(it, fname, prefix_len));
+
     ftype = os_next_object(ostc->os_child, it->it_child, fname, prefix_len);
     //** Last object so return
     if (ftype <= 0) {
+        if ((ftype == 0) && (it->listing != NULL)) {  //** Got the complete listing so cache it
+            ostc_cache_listing_store(it->os, it->creds, it->ldir, it->listing, it->ns_gen);
+            it->listing = NULL;
+        }
         *fname = NULL;
         *prefix_len = -1;
         log_printf(5, "No more objects\n");
         return(ftype);
     }
 
+    if (it->listing != NULL) {
+        if ((*prefix_len < 0) || ((*fname)[*prefix_len] != '/') || (it->listing->n >= ostc->listing_max_entries)) {
+            free_ostc_listing(it->listing);  //** Too big or not what we expected so don't cache it
+            it->listing = NULL;
+        } else {
+            ostc_listing_add(it->listing, strdup(*fname + *prefix_len + 1), ftype);
+        }
+    }
+
     if (it->iter_type == OSTC_ITER_ALIST) {
         //** Copy any results back
         ostc_attr_cacheprep_copy(&(it->cp), it->val, it->v_size);
-        ostc_cache_process_attrs(it->os, *fname, ftype, it->cp.key, it->cp.val, it->cp.v_size, it->n_keys);
+
+        //** The attrs could have been fetched before any invalidation since the
+        //** iterator was created so only cache them if there haven't been any
+        if (__atomic_load_n(&(ostc->n_invalidations), __ATOMIC_RELAXED) == it->inval_gen) {
+            ostc_cache_process_attrs(it->os, *fname, ftype, it->cp.key, it->cp.val, it->cp.v_size, it->n_keys, ostc_cache_gen(ostc, *fname, 0));
+        }
 
         //** We have to do a manual cleanup and can't call the CP destroy method
         for (i=it->cp.n_keys; i<it->cp.n_keys_total; i++) {
@@ -1966,6 +3058,8 @@ void ostc_destroy_object_iter(os_object_iter_t *oit)
 
     if (it->it_child != NULL) os_destroy_object_iter(ostc->os_child, it->it_child);
     if (it->iter_type == OSTC_ITER_ALIST) ostc_attr_cacheprep_destroy(&(it->cp));
+    if (it->listing != NULL) free_ostc_listing(it->listing);
+    if (it->ldir != NULL) free(it->ldir);
 
     if (it->v_size_initial != NULL) free(it->v_size_initial);
 
@@ -2045,6 +3139,7 @@ os_object_iter_t *ostc_create_object_iter_alist(lio_object_service_fn_t *os, lio
     tbx_type_malloc_clear(it, ostc_object_iter_t, 1);
     it->iter_type = OSTC_ITER_ALIST;
     it->os = os;
+    it->inval_gen = __atomic_load_n(&(ostc->n_invalidations), __ATOMIC_RELAXED);
     it->val = val;
     it->v_size = v_size;
     it->n_keys = n_keys;
@@ -2052,6 +3147,26 @@ os_object_iter_t *ostc_create_object_iter_alist(lio_object_service_fn_t *os, lio
 
     tbx_type_malloc(it->v_size_initial, int, n_keys);
     memcpy(it->v_size_initial, it->v_size, n_keys*sizeof(int));
+    it->creds = creds;
+    it->fd.max_wait = 60;
+    it->object_types = object_types;
+
+    //** See if it's a plain directory listing we already have
+    if (ostc->listing_timeout > 0) it->ldir = _ostc_listing_dir(path, object_regex, recurse_depth);
+    if (it->ldir != NULL) {
+        it->listing = ostc_cache_listing_get(os, it->ldir);
+        if (it->listing != NULL) {
+            log_printf(5, "Using cached listing for dir=%s n=%d\n", it->ldir, it->listing->n);
+            it->from_cache = 1;
+            return(it);
+        }
+
+        //** Nope so collect it as we go if we're getting everything
+        if (object_types == OS_OBJECT_ANY_FLAG) {
+            it->ns_gen = ostc_cache_gen(ostc, it->ldir, 0);
+            tbx_type_malloc_clear(it->listing, ostc_listing_t, 1);
+        }
+    }
 
     //** Make the gop and execute it
     it->it_child = os_create_object_iter_alist(ostc->os_child, creds, path, object_regex, object_types,
@@ -2081,17 +3196,19 @@ gop_op_status_t ostc_open_object_fn(void *arg, int tid)
     gop_op_status_t status;
     ostc_fd_t *fd;
     tbx_stack_t tree;
-    int err;
+    ostc_move_op_t eop;
+    int err, slot;
 
     log_printf(5, "mode=%d OS_MODE_READ_IMMEDIATE=%d fname=%s\n", op->mode, OS_MODE_READ_IMMEDIATE, op->path);
 
     if (op->mode == OS_MODE_READ_IMMEDIATE) { //** Can use a delayed open if the object is in cache
         tbx_stack_init(&tree);
-        OSTC_LOCK(ostc);
+        slot = OSTC_RLOCK(ostc);
         err = _ostc_lio_cache_tree_walk(op->os, op->path, &tree, NULL, 0, OSTC_MAX_RECURSE);
-        OSTC_UNLOCK(ostc);
+        OSTC_RUNLOCK(ostc, slot);
         tbx_stack_empty(&tree, 0);
         if (err == 0) goto finished;
+        if (ostc_cache_negative_hit(op->os, op->path) == 1) return(gop_failure_status);
     }
 
     //** Force an immediate file open
@@ -2100,7 +3217,17 @@ gop_op_status_t ostc_open_object_fn(void *arg, int tid)
     op->gop = NULL;
 
     //** If it failed just return
-    if (status.op_status == OP_STATE_FAILURE) return(status);
+    if (status.op_status == OP_STATE_FAILURE) {
+        //** The open can fail for other reasons so confirm it's missing before remembering it
+        if ((op->mode == OS_MODE_READ_IMMEDIATE) && (ostc->negative_timeout > 0)) {
+            memset(&eop, 0, sizeof(eop));
+            eop.os = op->os;
+            eop.creds = op->creds;
+            eop.src_path = op->path;
+            ostc_exists_fn(&eop, tid);
+        }
+        return(status);
+    }
 
 finished:
     //** Make my version of the FD
@@ -2286,7 +3413,15 @@ void ostc_print_running_config(lio_object_service_fn_t *os, FILE *fd, int print_
     fprintf(fd, "type = %s\n", OS_TYPE_TIMECACHE);
     fprintf(fd, "os_child = %s\n", ostc->os_child_section);
     fprintf(fd, "entry_timeout = %ld #seconds\n", apr_time_sec(ostc->entry_timeout));
+    fprintf(fd, "negative_timeout = %ld #seconds\n", apr_time_sec(ostc->negative_timeout));
+    fprintf(fd, "listing_timeout = %ld #seconds\n", apr_time_sec(ostc->listing_timeout));
+    fprintf(fd, "listing_max_entries = %d\n", ostc->listing_max_entries);
     fprintf(fd, "cleanup_interval = %ld #seconds\n", apr_time_sec(ostc->cleanup_interval));
+    fprintf(fd, "lock_shards = %d\n", ostc->n_shards);
+    fprintf(fd, "compact_batch = %d\n", ostc->compact_batch);
+    fprintf(fd, "invalidate = %d\n", ostc->watch_enable);
+    fprintf(fd, "watch_wait = %d #seconds\n", ostc->watch_wait);
+    fprintf(fd, "watch_max_prefixes = %d\n", ostc->watch_max_prefixes);
     fprintf(fd, "\n");
 
     os_print_running_config(ostc->os_child, fd, 1);
@@ -2300,26 +3435,41 @@ void ostc_destroy(lio_object_service_fn_t *os)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
     apr_status_t value;
+    int i;
 
     tbx_siginfo_handler_remove(SIGUSR1, ostc_info_fn, os);
 
+    //** Signal we're shutting down
+    apr_thread_mutex_lock(ostc->lock);
+    ostc->shutdown = 1;
+    apr_thread_cond_broadcast(ostc->cond);
+    apr_thread_mutex_unlock(ostc->lock);
+
+    //** The watch uses the child so it has to finish first
+    if (ostc->watch_thread != NULL) {
+        apr_thread_join(&value, ostc->watch_thread);
+        os_cred_destroy(ostc->os_child, ostc->watch_creds);
+    }
+
     //** Shut the child down
     if (ostc->os_child != NULL) {
         os_destroy(ostc->os_child);
     }
 
-    //** Signal we're shutting down
-    OSTC_LOCK(ostc);
-    ostc->shutdown = 1;
-    apr_thread_cond_signal(ostc->cond);
-    OSTC_UNLOCK(ostc);
-
     //** Wait for the cleanup thread to complete
     apr_thread_join(&value, ostc->cleanup_thread);
 
     //** Dump the cache 1 last time just to be safe
     _ostc_cleanup(os, ostc->cache_root, apr_time_now() + 4*ostc->entry_timeout);
     free_ostcdb_object(ostc->cache_root, &ostc->n_objects_removed, &ostc->n_attrs_removed);
+    _ostc_negative_cleanup(ostc, 0);
+
+    for (i=0; i<ostc->n_shards; i++) {
+        apr_thread_rwlock_destroy(ostc->shard[i].lock);
+        apr_pool_destroy(ostc->shard[i].mpool);
+    }
+    free(ostc->shard);
+    free(ostc->dir_gen);
 
     free(ostc->section);
     free(ostc->os_child_section);
@@ -2337,6 +3487,8 @@ lio_object_service_fn_t *object_service_timecache_create(lio_service_manager_t *
     ostc_priv_t *ostc;
     os_create_t *os_create;
     char *str, *ctype;
+    void *cred_args[2];
+    int i;
 
     log_printf(10, "START\n");
     if (section == NULL) section = ostc_default_options.section;
@@ -2365,13 +3517,32 @@ lio_object_service_fn_t *object_service_timecache_create(lio_service_manager_t *
     ostc->os_child_section = str;
 
     ostc->entry_timeout = apr_time_from_sec(tbx_inip_get_integer(fd, section, "entry_timeout", ostc_default_options.entry_timeout));
+    ostc->negative_timeout = apr_time_from_sec(tbx_inip_get_integer(fd, section, "negative_timeout", ostc_default_options.negative_timeout));
+    ostc->listing_timeout = apr_time_from_sec(tbx_inip_get_integer(fd, section, "listing_timeout", ostc_default_options.listing_timeout));
+    ostc->listing_max_entries = tbx_inip_get_integer(fd, section, "listing_max_entries", ostc_default_options.listing_max_entries);
     ostc->cleanup_interval = apr_time_from_sec(tbx_inip_get_integer(fd, section, "cleanup_interval",ostc_default_options.cleanup_interval));
+    ostc->n_shards = tbx_inip_get_integer(fd, section, "lock_shards", ostc_default_options.n_shards);
+    if (ostc->n_shards < 1) ostc->n_shards = 1;
+    ostc->compact_batch = tbx_inip_get_integer(fd, section, "compact_batch", ostc_default_options.compact_batch);
+    if (ostc->compact_batch < 1) ostc->compact_batch = 1;
+    ostc->watch_enable = tbx_inip_get_integer(fd, section, "invalidate", ostc_default_options.watch_enable);
+    ostc->watch_wait = tbx_inip_get_integer(fd, section, "watch_wait", ostc_default_options.watch_wait);
+    ostc->watch_max_prefixes = tbx_inip_get_integer(fd, section, "watch_max_prefixes", ostc_default_options.watch_max_prefixes);
 
     apr_pool_create(&ostc->mpool, NULL);
     apr_thread_mutex_create(&(ostc->lock), APR_THREAD_MUTEX_DEFAULT, ostc->mpool);
     apr_thread_mutex_create(&(ostc->delayed_lock), APR_THREAD_MUTEX_DEFAULT, ostc->mpool);
     apr_thread_cond_create(&(ostc->cond), ostc->mpool);
 
+    tbx_type_malloc_clear(ostc->shard, ostc_lock_shard_t, ostc->n_shards);
+    for (i=0; i<ostc->n_shards; i++) {
+        apr_pool_create(&(ostc->shard[i].mpool), NULL);
+        apr_thread_rwlock_create(&(ostc->shard[i].lock), ostc->shard[i].mpool);
+    }
+
+    ostc->negative = apr_hash_make(ostc->mpool);
+    tbx_type_malloc_clear(ostc->dir_gen, ex_off_t, OSTC_GEN_SLOTS);
+
     //** Make the root node
     ostc->cache_root = new_ostcdb_object(strdup("/"), OS_OBJECT_DIR_FLAG, 0, ostc->mpool);
     ostc->n_objects_created++;
@@ -2425,6 +3596,15 @@ lio_object_service_fn_t *object_service_timecache_create(lio_service_manager_t *
     tbx_siginfo_handler_add(SIGUSR1, ostc_info_fn, os);
     tbx_thread_create_assert(&(ostc->cleanup_thread), NULL, ostc_cache_compact_thread, (void *)os, ostc->mpool);
 
+    //** Invalidations are only published by the remote server
+    if ((ostc->watch_enable == 1) && (strcmp(ostc->os_child->type, OS_TYPE_REMOTE_CLIENT) == 0)) {
+        cred_args[0] = fd;
+        cred_args[1] = section;
+        ostc->watch_creds = os_cred_init(ostc->os_child, OS_CREDS_INI_TYPE, cred_args);
+        an_cred_set_id(ostc->watch_creds, section);
+        tbx_thread_create_assert(&(ostc->watch_thread), NULL, ostc_watch_thread, (void *)os, ostc->mpool);
+    }
+
     log_printf(10, "END\n");
 
     return(os);
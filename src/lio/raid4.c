@@ -15,16 +15,274 @@
 */
 
 //******************************************************************************
-//  xor_block - XOR's a block of data
+//  RAID4 parity routines.  The XOR work is done by a kernel picked at startup
+//  based on the CPU's SIMD support.  Each kernel fuses all the source strips
+//  into a single pass so the parity is only written once per vector.
 //******************************************************************************
 
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#if defined(__x86_64__)
+#  include <immintrin.h>
+#elif defined(__aarch64__)
+#  include <arm_neon.h>
+#endif
 
-void xor_block(char *data, char *parity, int nbytes)
+#include "raid4.h"
+
+#define RAID4_MAX_STACK_STRIPS 32
+
+typedef void (*raid4_xor_fn_t)(int n_src, char **src, char *dst, int nbytes);
+
+typedef struct {
+    const char *name;
+    raid4_xor_fn_t fn;
+    int (*supported)();
+} raid4_xor_kernel_t;
+
+//******************************************************************************
+//  _xor_tail - Handles the bytes left over after the vector loop
+//******************************************************************************
+
+void _xor_tail(int n_src, char **src, char *dst, int start, int nbytes)
+{
+    int i, j;
+    char c;
+
+    for (i=start; i<nbytes; i++) {
+        c = src[0][i];
+        for (j=1; j<n_src; j++) c ^= src[j][i];
+        dst[i] = c;
+    }
+}
+
+//******************************************************************************
+//  _xor_scalar - Portable 64-bit word kernel
+//******************************************************************************
+
+void _xor_scalar(int n_src, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    uint64_t acc, w;
+
+    for (i=0; i+8 <= nbytes; i+=8) {
+        memcpy(&acc, src[0]+i, 8);
+        for (j=1; j<n_src; j++) {
+            memcpy(&w, src[j]+i, 8);
+            acc ^= w;
+        }
+        memcpy(dst+i, &acc, 8);
+    }
+
+    _xor_tail(n_src, src, dst, i, nbytes);
+}
+
+int _xor_scalar_supported() { return(1); }
+
+#if defined(__x86_64__)
+
+//******************************************************************************
+//  _xor_sse2 - SSE2 is part of the x86_64 baseline so this is the fallback
+//******************************************************************************
+
+void _xor_sse2(int n_src, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    __m128i a0, a1;
+
+    for (i=0; i+32 <= nbytes; i+=32) {
+        a0 = _mm_loadu_si128((const __m128i *)(src[0]+i));
+        a1 = _mm_loadu_si128((const __m128i *)(src[0]+i+16));
+        for (j=1; j<n_src; j++) {
+            a0 = _mm_xor_si128(a0, _mm_loadu_si128((const __m128i *)(src[j]+i)));
+            a1 = _mm_xor_si128(a1, _mm_loadu_si128((const __m128i *)(src[j]+i+16)));
+        }
+        _mm_storeu_si128((__m128i *)(dst+i), a0);
+        _mm_storeu_si128((__m128i *)(dst+i+16), a1);
+    }
+
+    _xor_tail(n_src, src, dst, i, nbytes);
+}
+
+int _xor_sse2_supported() { return(1); }
+
+//******************************************************************************
+//  _xor_avx2 - 256-bit kernel
+//******************************************************************************
+
+__attribute__((target("avx2")))
+void _xor_avx2(int n_src, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    __m256i a0, a1;
+
+    for (i=0; i+64 <= nbytes; i+=64) {
+        a0 = _mm256_loadu_si256((const __m256i *)(src[0]+i));
+        a1 = _mm256_loadu_si256((const __m256i *)(src[0]+i+32));
+        for (j=1; j<n_src; j++) {
+            a0 = _mm256_xor_si256(a0, _mm256_loadu_si256((const __m256i *)(src[j]+i)));
+            a1 = _mm256_xor_si256(a1, _mm256_loadu_si256((const __m256i *)(src[j]+i+32)));
+        }
+        _mm256_storeu_si256((__m256i *)(dst+i), a0);
+        _mm256_storeu_si256((__m256i *)(dst+i+32), a1);
+    }
+
+    _xor_tail(n_src, src, dst, i, nbytes);
+}
+
+int _xor_avx2_supported() { return(__builtin_cpu_supports("avx2")); }
+
+//******************************************************************************
+//  _xor_avx512 - 512-bit kernel
+//******************************************************************************
+
+__attribute__((target("avx512f")))
+void _xor_avx512(int n_src, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    __m512i a0, a1;
+
+    for (i=0; i+128 <= nbytes; i+=128) {
+        a0 = _mm512_loadu_si512((const void *)(src[0]+i));
+        a1 = _mm512_loadu_si512((const void *)(src[0]+i+64));
+        for (j=1; j<n_src; j++) {
+            a0 = _mm512_xor_si512(a0, _mm512_loadu_si512((const void *)(src[j]+i)));
+            a1 = _mm512_xor_si512(a1, _mm512_loadu_si512((const void *)(src[j]+i+64)));
+        }
+        _mm512_storeu_si512((void *)(dst+i), a0);
+        _mm512_storeu_si512((void *)(dst+i+64), a1);
+    }
+
+    _xor_tail(n_src, src, dst, i, nbytes);
+}
+
+int _xor_avx512_supported() { return(__builtin_cpu_supports("avx512f")); }
+
+#elif defined(__aarch64__)
+
+//******************************************************************************
+//  _xor_neon - NEON is mandatory on aarch64
+//******************************************************************************
+
+void _xor_neon(int n_src, char **src, char *dst, int nbytes)
+{
+    int i, j;
+    uint8x16_t a0, a1;
+
+    for (i=0; i+32 <= nbytes; i+=32) {
+        a0 = vld1q_u8((const uint8_t *)(src[0]+i));
+        a1 = vld1q_u8((const uint8_t *)(src[0]+i+16));
+        for (j=1; j<n_src; j++) {
+            a0 = veorq_u8(a0, vld1q_u8((const uint8_t *)(src[j]+i)));
+            a1 = veorq_u8(a1, vld1q_u8((const uint8_t *)(src[j]+i+16)));
+        }
+        vst1q_u8((uint8_t *)(dst+i), a0);
+        vst1q_u8((uint8_t *)(dst+i+16), a1);
+    }
+
+    _xor_tail(n_src, src, dst, i, nbytes);
+}
+
+int _xor_neon_supported() { return(1); }
+
+#endif
+
+//** Kernels in order of preference
+raid4_xor_kernel_t _raid4_kernels[] = {
+#if defined(__x86_64__)
+    { "avx512", _xor_avx512, _xor_avx512_supported },
+    { "avx2", _xor_avx2, _xor_avx2_supported },
+    { "sse2", _xor_sse2, _xor_sse2_supported },
+#elif defined(__aarch64__)
+    { "neon", _xor_neon, _xor_neon_supported },
+#endif
+    { "scalar", _xor_scalar, _xor_scalar_supported },
+    { NULL, NULL, NULL }
+};
+
+raid4_xor_kernel_t *_raid4_kernel = NULL;
+pthread_once_t _raid4_once = PTHREAD_ONCE_INIT;
+
+//******************************************************************************
+//  _raid4_kernel_init - Picks the best kernel the CPU supports
+//******************************************************************************
+
+void _raid4_kernel_init()
+{
+    int i;
+
+    for (i=0; _raid4_kernels[i].name != NULL; i++) {
+        if (_raid4_kernels[i].supported()) {
+            _raid4_kernel = &(_raid4_kernels[i]);
+            return;
+        }
+    }
+}
+
+//******************************************************************************
+//  raid4_xor_kernel_name - Returns the name of the kernel in use
+//******************************************************************************
+
+const char *raid4_xor_kernel_name()
+{
+    pthread_once(&_raid4_once, _raid4_kernel_init);
+    return(_raid4_kernel->name);
+}
+
+//******************************************************************************
+//  raid4_xor_kernel_set - Forces a specific kernel.  Returns 0 on success
+//     or -1 if the kernel is unknown or unsupported on this CPU.
+//     Mainly used for benchmarking.
+//******************************************************************************
+
+int raid4_xor_kernel_set(const char *name)
 {
     int i;
 
-    for (i=0; i<nbytes; i++) parity[i] = parity[i] ^ data[i];
+    pthread_once(&_raid4_once, _raid4_kernel_init);
+
+    for (i=0; _raid4_kernels[i].name != NULL; i++) {
+        if (strcmp(name, _raid4_kernels[i].name) == 0) {
+            if (!_raid4_kernels[i].supported()) return(-1);
+            _raid4_kernel = &(_raid4_kernels[i]);
+            return(0);
+        }
+    }
+
+    return(-1);
+}
+
+//******************************************************************************
+//  raid4_xor - Stores the XOR of all the src blocks in dst. dst can be one
+//     of the sources.
+//******************************************************************************
+
+void raid4_xor(int n_src, char **src, char *dst, int nbytes)
+{
+    pthread_once(&_raid4_once, _raid4_kernel_init);
+
+    if (n_src <= 0) return;
+    if (n_src == 1) {
+        if (src[0] != dst) memcpy(dst, src[0], nbytes);
+        return;
+    }
+
+    _raid4_kernel->fn(n_src, src, dst, nbytes);
+}
+
+//******************************************************************************
+//  xor_block - XOR's a block of data
+//******************************************************************************
+
+void xor_block(char *data, char *parity, int nbytes)
+{
+    char *src[2];
+
+    src[0] = parity;
+    src[1] = data;
+    raid4_xor(2, src, parity, nbytes);
 
     return;
 }
@@ -36,11 +294,7 @@ void xor_block(char *data, char *parity, int nbytes)
 
 void raid4_encode(int data_strips, char **data, char **parity, int block_size)
 {
-    int i;
-
-    memcpy(parity[0], data[0], block_size);
-
-    for (i=1; i<data_strips; i++) xor_block(data[i], parity[0], block_size);
+    raid4_xor(data_strips, data, parity[0], block_size);
 
     return;
 }
@@ -51,21 +305,27 @@ void raid4_encode(int data_strips, char **data, char **parity, int block_size)
 
 int raid4_decode(int data_strips, int *erasures, char **data, char **parity, int block_size)
 {
-    int i, k;
+    int i, k, n;
+    char *stack_src[RAID4_MAX_STACK_STRIPS];
+    char **src;
 
     if (erasures[1] != -1) return(-1);  //** Too many missing blocks to recover from
     if (erasures[0] >= data_strips) return(0);  //** Lost parity only so return
 
     k = erasures[0];
-    memcpy(data[k], parity[0], block_size);
 
+    src = (data_strips <= RAID4_MAX_STACK_STRIPS) ? stack_src : (char **)malloc(sizeof(char *)*data_strips);
+    if (src == NULL) return(-1);
+
+    n = 0;
+    src[n++] = parity[0];
     for (i=0; i<data_strips; i++) {
-        if (i != k) {
-            xor_block(data[i], data[k], block_size);
-        }
+        if (i != k) src[n++] = data[i];
     }
 
-    return(0);
-}
+    raid4_xor(n, src, data[k], block_size);
 
+    if (src != stack_src) free(src);
 
+    return(0);
+}
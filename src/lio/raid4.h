@@ -17,12 +17,17 @@
 #ifndef __RAID4_H_
 #define __RAID4_H_
 
+#include <lio/visibility.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-void raid4_encode(int data_strips, char **data, char **parity, int block_size);
-int raid4_decode(int data_strips, int *erasures, char **data, char **parity, int block_size);
+LIO_API void raid4_encode(int data_strips, char **data, char **parity, int block_size);
+LIO_API int raid4_decode(int data_strips, int *erasures, char **data, char **parity, int block_size);
+LIO_API void raid4_xor(int n_src, char **src, char *dst, int nbytes);
+LIO_API const char *raid4_xor_kernel_name();
+LIO_API int raid4_xor_kernel_set(const char *name);
 
 #ifdef __cplusplus
 }
@@ -220,7 +220,10 @@ gop_op_generic_t *rs_simple_request(lio_resource_service_fn_t *arg, data_attr_t
     lio_rss_rid_entry_t *rse;
     lio_rsq_base_ele_t *q;
     int slot, rnd_off, i, j, k, i_unique, i_pickone, found, err_cnt, loop, loop_end, avg_full_skip, full_skip_retry;
-    int state, *a, *b, *op_state, unique_size;
+    int state, *a, *b, *op_state, unique_size, n_bulk;
+    ex_off_t bulk_size;
+    data_cap_set_t **bulk_caps;
+    gop_op_generic_t *gop;
     tbx_stack_t *stack;
 
     log_printf(15, "rs_simple_request: START rss->n_rids=%d n_rid=%d req_size=%d fixed_size=%d ignore=%d\n", rss->n_rids, n_rid, req_size, fixed_size, ignore_fixed_err);
@@ -410,10 +413,38 @@ log_printf(1, "i=%d fixed_size=%d state=%d avg_full_skip=%d\n", i, fixed_size, s
                 found = 1;
                 if ((i<fixed_size) && hints_list) hints_list[i].status = RS_ERROR_OK;
 
+                //** See if all the requests for the RID can go in a single bulk allocation
+                n_bulk = 0;
+                bulk_size = -1;
+                for (k=0; k<req_size; k++) {
+                    if (req[k].rid_index == i) {
+                        if (n_bulk == 0) bulk_size = req[k].size;
+                        if (req[k].size != bulk_size) bulk_size = -1;
+                        n_bulk++;
+                    }
+                }
+                if ((n_bulk < 2) || (bulk_size < 0) || (rss->ds->bulk_allocate == NULL)) n_bulk = 0;
+
+                if (n_bulk > 0) {
+                    tbx_type_malloc(bulk_caps, data_cap_set_t *, n_bulk);
+                    n_bulk = 0;
+                    for (k=0; k<req_size; k++) {
+                        if (req[k].rid_index == i) bulk_caps[n_bulk++] = caps[k];
+                    }
+                    log_printf(15, "rs_simple_request: ADDING i=%d ds_key=%s, rid_key=%s size=" XOT " n_bulk=%d\n", i, rse->ds_key, rse->rid_key, bulk_size, n_bulk);
+                    gop = ds_bulk_allocate(rss->ds, rse->ds_key, da, bulk_size, bulk_caps, n_bulk, timeout);
+                    free(bulk_caps);
+                    gop_opque_add(que, gop);
+                }
+
                 for (k=0; k<req_size; k++) {
                     if (req[k].rid_index == i) {
-                        log_printf(15, "rs_simple_request: ADDING i=%d ds_key=%s, rid_key=%s size=" XOT "\n", i, rse->ds_key, rse->rid_key, req[k].size);
                         req[k].rid_key = strdup(rse->rid_key);
+                        if (n_bulk > 0) {  //** All the requests share the bulk op
+                            req[k].gop = gop;
+                            continue;
+                        }
+                        log_printf(15, "rs_simple_request: ADDING i=%d ds_key=%s, rid_key=%s size=" XOT "\n", i, rse->ds_key, rse->rid_key, req[k].size);
                         req[k].gop = ds_allocate(rss->ds, rse->ds_key, da, req[k].size, caps[k], timeout);
                         gop_opque_add(que, req[k].gop);
                     }
@@ -1066,7 +1066,7 @@ int cache_rw_pages(lio_segment_t *seg, lio_segment_rw_hints_t *rw_hints, lio_pag
             if (rw_mode == CACHE_READ) {
                 for (j=0; j<cio->n_iov; j++) {
                     log_printf(15, "error with read nullifying data p->offset=" XOT "\n", cio->page[j].p->offset);
-                    free(cio->page[j].data->ptr);  //** Errors are signified by data=NULL;
+                    page_arena_free(s->c->arena, cio->page[j].data->ptr);  //** Errors are signified by data=NULL;
                     error_count++;
                     cio->page[j].data->ptr = NULL;
                 }
@@ -1953,7 +1953,7 @@ int cache_write_pages_get(lio_segment_t *seg, lio_segment_rw_hints_t *rw_hints,
                         i = (p->current_index+1) % 2;
                         if (p->data[i].ptr == NULL) {  //** We can use the COW space
                             s->c->write_temp_overflow_used += s->page_size;
-                            tbx_type_malloc(p->data[i].ptr, char, s->page_size);
+                            p->data[i].ptr = page_arena_alloc(s->c->arena, s->page_size);
                             memcpy(p->data[i].ptr, p->data[p->current_index].ptr, s->page_size);
                             p->current_index = i;
                             p->curr_data = &(p->data[i]);
@@ -2131,7 +2131,7 @@ int cache_release_pages(int n_pages, lio_page_handle_t *page_list, int rw_mode)
         if (page_list[i].data != page->curr_data) {
             cow_hit = 1;
             if (page_list[i].data->usage_count <= 0) {  //** Clean up a COW
-                free(page_list[i].data->ptr);
+                page_arena_free(s->c->arena, page_list[i].data->ptr);
                 page_list[i].data->ptr = NULL;
                 s->c->write_temp_overflow_used -= s->page_size;
                 log_printf(15, "seg=" XIDT " p->offset=" XOT " COP cleanup used=" XOT " rw_mode=%d usage=%d\n", segment_id(seg), page->offset, s->c->write_temp_overflow_used, rw_mode, page_list[i].data->usage_count);
@@ -3470,6 +3470,11 @@ int lio_cache_stats_get_print(lio_cache_stats_get_t *cs, char *buffer, int *used
     d3 = cs->miss_bytes * 1.0 / (1024.0*1024.0*1024.0);
     n += tbx_append_printf(buffer, used, nmax, "Misses: " XOT " bytes (%lf GiB) (%lf%% total) (%lf sec %lf MB/s)\n", cs->miss_bytes, d3, d2, dt, drate);
 
+    if (cs->ghost_hit_bytes > 0) {
+        d3 = cs->ghost_hit_bytes * 1.0 / (1024.0*1024.0*1024.0);
+        n += tbx_append_printf(buffer, used, nmax, "Ghost hits: " XOT " bytes (%lf GiB)\n", cs->ghost_hit_bytes, d3);
+    }
+
     d3 = cs->dirty_bytes * 1.0 / (1024.0*1024.0*1024.0);
     n += tbx_append_printf(buffer, used, nmax, "Dirty: " XOT " bytes (%lf GiB)\n", cs->dirty_bytes, d3);
 
@@ -4060,7 +4065,7 @@ lio_segment_t *segment_cache_create(void *arg)
 
     s->c = lio_lookup_service(es, ESS_RUNNING, ESS_CACHE);
     if (s->c != NULL) {
-        s->c = cache_get_handle(s->c);
+        s->c = cache_get_handle(s->c, seg);
         if (strcmp(s->c->type, CACHE_TYPE_DIRECT) == 0) s->direct_io = 1;
     }
 
@@ -741,6 +741,7 @@ gop_op_generic_t *seglin_remove(lio_segment_t *seg, data_attr_t *da, int timeout
     gop_opque_t *q;
     seglin_slot_t *b;
     tbx_isl_iter_t it;
+    data_cap_t **mcap;
     int i, n;
 
     q = gop_opque_new();
@@ -748,10 +749,20 @@ gop_op_generic_t *seglin_remove(lio_segment_t *seg, data_attr_t *da, int timeout
     segment_lock(seg);
     n = tbx_isl_count(s->isl);
     it = tbx_isl_iter_search(s->isl, (tbx_sl_key_t *)NULL, (tbx_sl_key_t *)NULL);
-    for (i=0; i<n; i++) {
-        b = (seglin_slot_t *)tbx_isl_next(&it);
-        gop = ds_remove(b->data->ds, da, ds_get_cap(b->data->ds, b->data->cap, DS_CAP_MANAGE), timeout);
-        gop_opque_add(q, gop);
+    if ((s->ds->bulk_remove != NULL) && (n > 0)) {  //** Let the DS batch them by depot
+        tbx_type_malloc(mcap, data_cap_t *, n);
+        for (i=0; i<n; i++) {
+            b = (seglin_slot_t *)tbx_isl_next(&it);
+            mcap[i] = ds_get_cap(b->data->ds, b->data->cap, DS_CAP_MANAGE);
+        }
+        gop_opque_add(q, ds_bulk_remove(s->ds, da, mcap, NULL, n, timeout));
+        free(mcap);
+    } else {
+        for (i=0; i<n; i++) {
+            b = (seglin_slot_t *)tbx_isl_next(&it);
+            gop = ds_remove(b->data->ds, da, ds_get_cap(b->data->ds, b->data->cap, DS_CAP_MANAGE), timeout);
+            gop_opque_add(q, gop);
+        }
     }
     segment_unlock(seg);
 
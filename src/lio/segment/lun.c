@@ -140,9 +140,39 @@ typedef struct {
     int c_ex;
     int n_iov;
     int c_iov;
+    int hedge_state;
     ex_off_t len;
+    struct lun_hedge_io_t *hio;
 } lun_rw_row_t;
 
+//** Hedged read states
+#define LUN_HEDGE_NONE      0    //** No op issued yet
+#define LUN_HEDGE_PENDING   1
+#define LUN_HEDGE_DONE      2
+#define LUN_HEDGE_ABANDONED 3
+
+#define LUN_GROW_BATCH_ROWS 64   //** Max new rows allocated with a single RS request when growing
+
+typedef struct lun_hedge_io_t {  //** Bounce buffer for a hedged read so it can be abandoned
+    gop_op_generic_t *gop;
+    ex_tbx_iovec_t *ex_iov;
+    char *cap;       //** Private copy of the read cap since the segment can be closed before an abandoned read finishes
+    char *buffer;
+    tbx_tbuf_t tbuf;
+} lun_hedge_io_t;
+
+typedef struct {
+    int need;
+    int ok;
+    int pending;
+    int deferred;
+} lun_hedge_row_t;
+
+typedef struct {
+    gop_opque_t *q;
+    tbx_stack_t *stack;
+} lun_hedge_reap_t;
+
 //***********************************************************************
 // _slun_perform_remap - Does a cap remap
 //   **NOTE: Assumes the segment is locked
@@ -788,13 +818,128 @@ oops:
     return(err);
 }
 
+//***********************************************************************
+// slun_rows_bulk_fix - Allocates the blocks for a batch of new rows using a
+//    single RS request.  Device i of every row goes on the same RID so each
+//    RID gets a single bulk allocation.  Blocks that fail are left for
+//    slun_row_replace_fix() to handle a row at a time.  Returns the number
+//    of rows with errors.
+//***********************************************************************
+
+int slun_rows_bulk_fix(lio_segment_t *seg, data_attr_t *da, seglun_row_t **rows, int n_rows, lio_inspect_args_t *args, int timeout)
+{
+    lio_seglun_priv_t *s = (lio_seglun_priv_t *)seg->priv;
+    int n_devices = s->n_devices;
+    int m = n_rows * n_devices;
+    lio_rs_request_t *req_list;
+    data_cap_set_t **cap_list;
+    lio_data_block_t **db_list;
+    lio_rs_hints_t hints_list[n_devices];
+    int block_status[n_devices];
+    int *bstat;
+    gop_op_generic_t *gop;
+    gop_opque_t *q;
+    tbx_tbuf_t tbuf;
+    seglun_row_t *b;
+    lio_data_block_t *db;
+    int i, j, k, r, err;
+    char c;
+
+    tbx_type_malloc_clear(req_list, lio_rs_request_t, m);
+    tbx_type_malloc_clear(cap_list, data_cap_set_t *, m);
+    tbx_type_malloc_clear(db_list, lio_data_block_t *, m);
+    tbx_type_malloc(bstat, int, m);
+    memset(hints_list, 0, sizeof(hints_list));
+
+    for (r=0; r<n_rows; r++) {
+        for (i=0; i<n_devices; i++) {
+            k = r*n_devices + i;
+            db = data_block_create(s->ds);
+            db->rid_key = NULL;
+            db->max_size = rows[r]->block_len;
+            db->size = rows[r]->block_len;
+            db_list[k] = db;
+            cap_list[k] = db->cap;
+            req_list[k].rid_index = i;
+            req_list[k].size = rows[r]->block_len;
+            bstat[k] = 1;
+        }
+    }
+
+    //** Execute the Query
+    gop = rs_data_request(s->rs, da, args->query, cap_list, req_list, m, hints_list, 0, n_devices, 1, timeout);
+    err = gop_waitall(gop);
+    log_printf(5, "seg=" XIDT " n_rows=%d m=%d rs_data_request=%d\n", segment_id(seg), n_rows, m, err);
+    gop_free(gop, OP_DESTROY);
+
+    //** Attach the good allocations and pad them
+    q = gop_opque_new();
+    c = 0;
+    tbx_tbuf_single(&tbuf, 1, &c);
+    for (k=0; k<m; k++) {
+        r = k / n_devices;
+        i = k % n_devices;
+        db = db_list[k];
+        if (ds_get_cap(db->ds, db->cap, DS_CAP_READ) != NULL) {
+            data_block_auto_warm(db);  //** Add it to be auto-warmed
+            rows[r]->block[i].data = db;
+            db->rid_key = req_list[k].rid_key;
+            tbx_atomic_inc(db->ref_count);
+            rows[r]->block[i].read_err_count = 0;
+            rows[r]->block[i].write_err_count = 0;
+            bstat[k] = 2;
+
+            gop = ds_write(db->ds, da, ds_get_cap(db->ds, db->cap, DS_CAP_WRITE), db->max_size-1, &tbuf, 0, 1, timeout);
+            gop_set_myid(gop, k);
+            gop_opque_add(q, gop);
+        } else {
+            if (req_list[k].rid_key) free(req_list[k].rid_key);
+            data_block_destroy(db);
+        }
+    }
+
+    while ((gop = opque_waitany(q)) != NULL) {
+        k = gop_get_myid(gop);
+        if (gop_completed_successfully(gop) == OP_STATE_SUCCESS) {
+            bstat[k] = 0;
+            db_list[k]->size = db_list[k]->max_size;
+        } else {
+            bstat[k] = 3;
+        }
+        gop_free(gop, OP_DESTROY);
+    }
+    gop_opque_free(q, OP_DESTROY);
+
+    //** Now fix any stragglers a row at a time
+    err = 0;
+    for (r=0; r<n_rows; r++) {
+        b = rows[r];
+        j = 0;
+        for (i=0; i<n_devices; i++) {
+            block_status[i] = bstat[r*n_devices + i];
+            if (block_status[i] != 0) j++;
+        }
+        if (j == 0) continue;
+
+        log_printf(5, "seg=" XIDT " seg_offset=" XOT " bulk allocation missed %d blocks\n", segment_id(seg), b->seg_offset, j);
+        if (slun_row_replace_fix(seg, da, b, block_status, n_devices, args, timeout) != 0) err++;
+    }
+
+    free(bstat);
+    free(db_list);
+    free(cap_list);
+    free(req_list);
+
+    return(err);
+}
+
 //***********************************************************************
 // seglun_grow - Expands a linear segment
 //***********************************************************************
 
 gop_op_status_t _seglun_grow(lio_segment_t *seg, data_attr_t *da, ex_off_t new_size_arg, int timeout)
 {
-    int i, err, cnt;
+    int i, r, err, cnt, n_rows;
     ex_off_t off, dsize, old_len;
     lio_seglun_priv_t *s = (lio_seglun_priv_t *)seg->priv;
     seglun_row_t *b;
@@ -803,6 +948,7 @@ gop_op_status_t _seglun_grow(lio_segment_t *seg, data_attr_t *da, ex_off_t new_s
     ex_off_t lo, hi, berr, new_size;
     gop_op_status_t status;
     int block_status[s->n_devices];
+    seglun_row_t *rows[LUN_GROW_BATCH_ROWS];
     apr_time_t now;
     double gsecs, tsecs;
     lio_inspect_args_t args;
@@ -884,8 +1030,9 @@ gop_op_status_t _seglun_grow(lio_segment_t *seg, data_attr_t *da, ex_off_t new_s
         }
     }
 
-    //** Create the additional caps and commands
+    //** Create the additional caps and commands.  Rows of the same size are allocated in batches
     err = 0;
+    n_rows = 0;
     for (off=lo; off<new_size; off = off + s->max_row_size) {
         tbx_type_malloc_clear(b, seglun_row_t, 1);
         tbx_type_malloc_clear(block, seglun_block_t, s->n_devices);
@@ -908,27 +1055,41 @@ gop_op_status_t _seglun_grow(lio_segment_t *seg, data_attr_t *da, ex_off_t new_s
             b->block[i].cap_offset = 0;
         }
 
-        //** Flag them all as missing so they can be replaced
-        for (i=0; i < s->n_devices; i++) block_status[i] = 1;
-        err = err + slun_row_replace_fix(seg, da, b, block_status, s->n_devices, &args, timeout);
+        rows[n_rows] = b;
+        n_rows++;
 
-        if (err == 0) {
-            tbx_isl_insert(s->isl, (tbx_sl_key_t *)&(b->seg_offset), (tbx_sl_key_t *)&(b->seg_end), (tbx_sl_data_t *)b);
-        } else {  //** Got an error so clean up and kick out
-            for (i=0; i<s->n_devices; i++) {
-                if (block[i].data != NULL) {
-                    cnt = tbx_atomic_get(block[i].data->ref_count);
-                    if ( cnt > 0) tbx_atomic_dec(block[i].data->ref_count);
-                    data_block_destroy(block[i].data);
+        //** Flush the batch if it's full, this is the last row, or the next row is a different size
+        dsize = off + 2*s->max_row_size;
+        if ((n_rows < LUN_GROW_BATCH_ROWS) && (dsize <= new_size)) continue;
+
+        if (n_rows == 1) {  //** Flag them all as missing so they can be replaced
+            for (i=0; i < s->n_devices; i++) block_status[i] = 1;
+            err = err + slun_row_replace_fix(seg, da, b, block_status, s->n_devices, &args, timeout);
+        } else {
+            err = err + slun_rows_bulk_fix(seg, da, rows, n_rows, &args, timeout);
+        }
+
+        for (r=0; r<n_rows; r++) {
+            b = rows[r];
+            block = b->block;
+            log_printf(15, "sid=" XIDT " off=" XOT " b->row_len=" XOT " err=%d\n", segment_id(seg), b->seg_offset, b->row_len, err);
+            if (err == 0) {
+                tbx_isl_insert(s->isl, (tbx_sl_key_t *)&(b->seg_offset), (tbx_sl_key_t *)&(b->seg_end), (tbx_sl_data_t *)b);
+            } else {  //** Got an error so clean up and kick out
+                for (i=0; i<s->n_devices; i++) {
+                    if (block[i].data != NULL) {
+                        cnt = tbx_atomic_get(block[i].data->ref_count);
+                        if ( cnt > 0) tbx_atomic_dec(block[i].data->ref_count);
+                        data_block_destroy(block[i].data);
+                    }
                 }
+                free(block);
+                free(b);
             }
-            free(block);
-            free(b);
-            goto oops;
         }
+        n_rows = 0;
 
-        log_printf(15, "sid=" XIDT " off=" XOT " b->row_len=" XOT " err=%d\n", segment_id(seg), b->seg_offset, b->row_len, err);
-
+        if (err != 0) goto oops;
     }
 
 oops:
@@ -1450,6 +1611,515 @@ int seglun_row_decompose_test()
     return(cerr);
 }
 
+//***********************************************************************
+// lun_read_estimates - Gets the data service's read estimate for each device
+//    in the row.  Devices without anything to read get -1.  This can take
+//    the data service's locks so it's done before grabbing bl->lock.
+//***********************************************************************
+
+void lun_read_estimates(lio_seglun_priv_t *s, seglun_row_t *b, lun_rw_row_t *rw_buf, apr_time_t *est)
+{
+    lio_data_block_t *d;
+    int i;
+
+    for (i=0; i < s->n_devices; i++) {
+        est[i] = -1;
+        if (rw_buf[i].n_ex <= 0) continue;
+
+        d = b->block[i].data;
+        est[i] = ds_read_estimate(d->ds, ds_get_cap(d->ds, d->cap, DS_CAP_READ), rw_buf[i].len);
+    }
+}
+
+//***********************************************************************
+// lun_slow_devices - Flags the slowest devices in the row so the read can
+//    skip them just like a blacklisted RID.  A device is only flagged if its
+//    estimate from row_est is over bl->slow_ratio times the row's median
+//    and over bl->min_io_time.  Dead hosts report INT64_MAX and are left out
+//    of the median.  Blacklisted RIDs come first so only what's left of
+//    n_max is used.
+//    NOTE: Should be holding bl->lock
+//***********************************************************************
+
+void lun_slow_devices(lio_seglun_priv_t *s, lio_blacklist_t *bl, seglun_row_t *b, apr_time_t *row_est, int n_max, int *slow)
+{
+    lio_data_block_t *d;
+    apr_time_t est[s->n_devices], sorted[s->n_devices];
+    apr_time_t cutoff, t;
+    double c;
+    int i, j, n, n_live, worst;
+
+    n = 0;
+    n_live = 0;
+    for (i=0; i < s->n_devices; i++) {
+        slow[i] = 0;
+        est[i] = -1;
+        if (row_est[i] < 0) continue;
+
+        d = b->block[i].data;
+        if (blacklist_check(bl, d->rid_key, 0) == 1) {
+            n_max--;
+            continue;
+        }
+
+        est[i] = row_est[i];
+        n++;
+        if (est[i] == INT64_MAX) continue;  //** Dead host
+
+        //** Keep the live estimates sorted for the median
+        for (j=n_live; (j > 0) && (sorted[j-1] > est[i]); j--) sorted[j] = sorted[j-1];
+        sorted[j] = est[i];
+        n_live++;
+    }
+
+    if ((n_max <= 0) || (n < 2) || (n_live == 0)) return;
+
+    c = bl->slow_ratio * sorted[n_live/2];
+    cutoff = (c >= (double)INT64_MAX) ? INT64_MAX : c;
+    if (cutoff < bl->min_io_time) cutoff = bl->min_io_time;
+
+    //** Flag the worst offenders
+    while (n_max > 0) {
+        worst = -1;
+        t = cutoff;
+        for (i=0; i < s->n_devices; i++) {
+            if ((slow[i] == 0) && (est[i] > t)) {
+                t = est[i];
+                worst = i;
+            }
+        }
+        if (worst == -1) break;
+
+        log_printf(5, "Skipping slow device=%d rid=%s estimate=" TT " cutoff=" TT "\n", worst, b->block[worst].data->rid_key, est[worst], cutoff);
+        slow[worst] = 1;
+        n_max--;
+    }
+}
+
+//***********************************************************************
+// lun_hedge_defer - Picks the devices in the row to hold back on a hedged
+//    read.  These are the ones with the worst estimates with ties going to
+//    the highest index since that's normally where parity lives.  Only what's
+//    left of n_max after removing the blacklisted and slow devices is used.
+//    Returns the number of devices held back.
+//    NOTE: Should be holding bl->lock
+//***********************************************************************
+
+int lun_hedge_defer(lio_seglun_priv_t *s, lio_blacklist_t *bl, seglun_row_t *b, apr_time_t *row_est, int n_max, int *slow, int *defer)
+{
+    lio_data_block_t *d;
+    apr_time_t est[s->n_devices];
+    int i, n, worst;
+
+    for (i=0; i < s->n_devices; i++) {
+        defer[i] = 0;
+        est[i] = -1;
+        if (row_est[i] < 0) continue;
+
+        d = b->block[i].data;
+        if ((blacklist_check(bl, d->rid_key, 0) == 1) || ((slow != NULL) && (slow[i] == 1))) {
+            n_max--;
+            continue;
+        }
+
+        est[i] = row_est[i];
+    }
+
+    if (n_max > bl->hedge_defer) n_max = bl->hedge_defer;
+
+    for (n=0; n < n_max; n++) {
+        worst = -1;
+        for (i=0; i < s->n_devices; i++) {
+            if ((est[i] >= 0) && (defer[i] == 0) && ((worst == -1) || (est[i] >= est[worst]))) worst = i;
+        }
+        if (worst == -1) break;
+
+        defer[worst] = 1;
+    }
+
+    return(n);
+}
+
+//***********************************************************************
+// lun_hedge_deadline - Returns how long to wait before hedging.  This is the
+//    median of the bl->hedge_percentile latencies for the row's depots but
+//    never less than bl->hedge_min_time.
+//***********************************************************************
+
+apr_time_t lun_hedge_deadline(lio_seglun_priv_t *s, lio_blacklist_t *bl, lun_rw_row_t *rw_buf)
+{
+    lio_data_block_t *d;
+    apr_time_t sorted[s->n_devices];
+    apr_time_t t;
+    int i, j, n;
+
+    n = 0;
+    for (i=0; i < s->n_devices; i++) {
+        if ((rw_buf[i].n_ex <= 0) || (rw_buf[i].block == NULL)) continue;
+
+        d = rw_buf[i].block->data;
+        t = ds_read_latency(d->ds, ds_get_cap(d->ds, d->cap, DS_CAP_READ), bl->hedge_percentile);
+        if (t <= 0) continue;  //** No history for the depot
+
+        for (j=n; (j > 0) && (sorted[j-1] > t); j--) sorted[j] = sorted[j-1];
+        sorted[j] = t;
+        n++;
+    }
+
+    t = (n > 0) ? sorted[n/2] : 0;
+    if (t < bl->hedge_min_time) t = bl->hedge_min_time;
+
+    return(t);
+}
+
+//***********************************************************************
+// lun_hedge_issue - Issues a hedged read for the device.  The data lands in
+//    a bounce buffer and is only copied to the caller's buffer on completion
+//    so the op can be abandoned if the row is decoded without it.
+//***********************************************************************
+
+void lun_hedge_issue(lun_rw_row_t *rwb, int id, data_attr_t *da, gop_opque_t *q, int timeout)
+{
+    lio_data_block_t *d = rwb->block->data;
+    lun_hedge_io_t *hio;
+
+    tbx_type_malloc_clear(hio, lun_hedge_io_t, 1);
+    tbx_type_malloc(hio->buffer, char, rwb->len);
+    tbx_tbuf_single(&(hio->tbuf), rwb->len, hio->buffer);
+    hio->cap = strdup((char *)ds_get_cap(d->ds, d->cap, DS_CAP_READ));
+
+    if (rwb->n_iov == 1) {
+        hio->gop = ds_read(d->ds, da, hio->cap, rwb->ex_iov[0].offset, &(hio->tbuf), 0, rwb->len, timeout);
+    } else {
+        hio->gop = ds_readv(d->ds, da, hio->cap, rwb->n_ex, rwb->ex_iov, &(hio->tbuf), 0, rwb->len, timeout);
+    }
+
+    rwb->hio = hio;
+    rwb->gop = hio->gop;
+    rwb->hedge_state = LUN_HEDGE_PENDING;
+    gop_set_myid(hio->gop, id);
+    gop_set_private(hio->gop, d->rid_key);
+    gop_opque_add(q, hio->gop);  //** If the que is already running this submits it
+}
+
+//***********************************************************************
+// lun_hedge_deferred - Issues up to n of the row's held back reads
+//***********************************************************************
+
+int lun_hedge_deferred(lio_seglun_priv_t *s, lun_hedge_row_t *hr, lun_rw_row_t *rwb_table, int slot, int n, data_attr_t *da, gop_opque_t *q, int timeout)
+{
+    lun_rw_row_t *rw_buf = &(rwb_table[slot*s->n_devices]);
+    int i, k;
+
+    k = 0;
+    for (i=0; (i < s->n_devices) && (k < n); i++) {
+        if ((rw_buf[i].n_ex > 0) && (rw_buf[i].hedge_state == LUN_HEDGE_NONE)) {
+            log_printf(5, "Hedging slot=%d device=%d rid=%s\n", slot, i, rw_buf[i].block->data->rid_key);
+            lun_hedge_issue(&(rw_buf[i]), slot*s->n_devices + i, da, q, timeout);
+            k++;
+        }
+    }
+
+    hr->deferred -= k;
+    hr->pending += k;
+
+    return(k);
+}
+
+//***********************************************************************
+// lun_hedge_stragglers - Called when a hedged read runs past its deadline.
+//    Issues held back reads for every row that can't be decoded yet as long
+//    as there is hedge credit left.
+//***********************************************************************
+
+void lun_hedge_stragglers(lio_seglun_priv_t *s, lio_blacklist_t *bl, lun_hedge_row_t *hrow, int n_bslots, lun_rw_row_t *rwb_table, data_attr_t *da, gop_opque_t *q, int timeout)
+{
+    lun_hedge_row_t *hr;
+    int slot, n, n_total;
+
+    n_total = 0;
+    apr_thread_mutex_lock(bl->lock);
+    for (slot=0; slot < n_bslots; slot++) {
+        hr = &(hrow[slot]);
+        if ((hr->ok >= hr->need) || (hr->deferred == 0)) continue;
+
+        n = hr->need - hr->ok;  //** Worst case all the outstanding reads are stragglers
+        if (n > hr->deferred) n = hr->deferred;
+        if (n > (int)bl->hedge_credit) n = bl->hedge_credit;
+        if (n <= 0) break;  //** Out of budget
+
+        bl->hedge_credit -= n;
+        n_total += lun_hedge_deferred(s, hr, rwb_table, slot, n, da, q, timeout);
+    }
+    log_printf(5, "Hedged reads=%d credit=%lf\n", n_total, bl->hedge_credit);
+    apr_thread_mutex_unlock(bl->lock);
+}
+
+//***********************************************************************
+// lun_hedge_done - Handles a completed hedged read.  Returns 1 if this was
+//    the read that made the row decodable and 0 otherwise.
+//***********************************************************************
+
+int lun_hedge_done(lio_seglun_priv_t *s, lun_hedge_row_t *hrow, lun_rw_row_t *rwb_table, gop_op_generic_t *gop, data_attr_t *da, gop_opque_t *q, int timeout)
+{
+    int slot = gop_get_myid(gop) / s->n_devices;
+    lun_rw_row_t *rwb = &(rwb_table[gop_get_myid(gop)]);
+    lun_hedge_row_t *hr = &(hrow[slot]);
+    int n;
+
+    rwb->hedge_state = LUN_HEDGE_DONE;
+    hr->pending--;
+
+    if (gop_completed_successfully(gop) == OP_STATE_SUCCESS) {
+        if (rwb->hio != NULL) tbx_tbuf_copy(&(rwb->hio->tbuf), 0, &(rwb->buffer), 0, rwb->len, 1);
+        hr->ok++;
+        return((hr->ok == hr->need) ? 1 : 0);
+    }
+
+    //** Got an error so pull in the held back devices if the row needs them
+    n = hr->need - hr->ok - hr->pending;
+    if ((n > 0) && (hr->deferred > 0)) {
+        if (n > hr->deferred) n = hr->deferred;
+        lun_hedge_deferred(s, hr, rwb_table, slot, n, da, q, timeout);
+    }
+
+    return(0);
+}
+
+//***********************************************************************
+// lun_hedge_reap_fn - Waits for the abandoned reads to finish and cleans
+//    up after them
+//***********************************************************************
+
+gop_op_status_t lun_hedge_reap_fn(void *arg, int id)
+{
+    lun_hedge_reap_t *reap = (lun_hedge_reap_t *)arg;
+    lun_hedge_io_t *hio;
+    gop_op_generic_t *gop;
+
+    //** Everything left in the que was abandoned
+    while ((gop = opque_waitany(reap->q)) != NULL) {
+        gop_free(gop, OP_DESTROY);
+    }
+
+    while ((hio = tbx_stack_pop(reap->stack)) != NULL) {
+        free(hio->ex_iov);
+        free(hio->cap);
+        free(hio->buffer);
+        free(hio);
+    }
+
+    tbx_stack_free(reap->stack, 0);
+    gop_opque_free(reap->q, OP_DESTROY);
+
+    return(gop_success_status);
+}
+
+//***********************************************************************
+// lun_hedge_abandon - Hands any outstanding reads off to a background task
+//    so the caller can return without them.  Returns NULL if the que was
+//    handed off and q otherwise.
+//***********************************************************************
+
+gop_opque_t *lun_hedge_abandon(lio_seglun_priv_t *s, lun_rw_row_t *rwb_table, int n, gop_opque_t *q)
+{
+    lun_hedge_reap_t *reap;
+    gop_op_generic_t *gop;
+    int i, n_abandoned;
+
+    reap = NULL;
+    n_abandoned = 0;
+    for (i=0; i<n; i++) {
+        if (rwb_table[i].hedge_state != LUN_HEDGE_PENDING) continue;
+
+        if (reap == NULL) {
+            tbx_type_malloc(reap, lun_hedge_reap_t, 1);
+            reap->q = q;
+            reap->stack = tbx_stack_new();
+        }
+
+        rwb_table[i].hedge_state = LUN_HEDGE_ABANDONED;
+        n_abandoned++;
+        gop_set_private(rwb_table[i].gop, NULL);  //** The rid_key goes away with the segment
+        if (rwb_table[i].hio == NULL) continue;  //** Blacklisted so only the gop needs cleaning up
+
+        rwb_table[i].hio->ex_iov = rwb_table[i].ex_iov;  //** The op still references these
+        rwb_table[i].ex_iov = NULL;
+        tbx_stack_push(reap->stack, rwb_table[i].hio);
+    }
+
+    if (reap == NULL) return(q);
+
+    log_printf(5, "Abandoning %d reads\n", n_abandoned);
+    gop = gop_tp_op_new(s->tpc, NULL, lun_hedge_reap_fn, (void *)reap, free, 1);
+    gop_set_auto_destroy(gop, 1);
+    gop_start_execution(gop);
+
+    return(NULL);
+}
+
+//***********************************************************************
+//  seglun_hedge_test - Tests the slow device and hedged read helpers using
+//     a fake data service.  An abandoned read must still see its cap after
+//     the data block it came from is destroyed.
+//***********************************************************************
+
+typedef struct {
+    char *cap;
+    tbx_tbuf_t *buf;
+    ex_off_t len;
+    apr_time_t delay;
+} lun_hedge_test_read_t;
+
+static apr_time_t _hedge_test_est[4];
+static tbx_atomic_int_t _hedge_test_reads = 0;
+static tbx_atomic_int_t _hedge_test_bad = 0;
+
+static data_cap_t *_hedge_test_get_cap(lio_data_service_fn_t *ds, data_cap_set_t *cs, int key)
+{
+    return(cs);  //** The cap set is just the cap string
+}
+
+static apr_time_t _hedge_test_estimate(lio_data_service_fn_t *ds, data_cap_t *rcap, ex_off_t len)
+{
+    return(_hedge_test_est[((char *)rcap)[4] - '0']);  //** caps are "cap-N"
+}
+
+static gop_op_status_t _hedge_test_read_fn(void *arg, int id)
+{
+    lun_hedge_test_read_t *r = (lun_hedge_test_read_t *)arg;
+
+    apr_sleep(r->delay);
+    if (strncmp(r->cap, "cap-", 4) != 0) tbx_atomic_inc(_hedge_test_bad);
+    tbx_tbuf_memset(r->buf, 0, 'A', r->len);
+    tbx_atomic_inc(_hedge_test_reads);
+
+    return(gop_success_status);
+}
+
+static gop_op_generic_t *_hedge_test_read(lio_data_service_fn_t *ds, data_attr_t *da, data_cap_t *rcap, ds_int_t off, tbx_tbuf_t *read, ex_off_t boff, ex_off_t len, int timeout)
+{
+    lun_hedge_test_read_t *r;
+
+    tbx_type_malloc_clear(r, lun_hedge_test_read_t, 1);
+    r->cap = rcap;
+    r->buf = read;
+    r->len = len;
+    r->delay = apr_time_from_msec(200);
+    return(gop_tp_op_new((gop_thread_pool_context_t *)ds->priv, NULL, _hedge_test_read_fn, (void *)r, free, 1));
+}
+
+int seglun_hedge_test()
+{
+    lio_seglun_priv_t s;
+    lio_blacklist_t bl;
+    lio_data_service_fn_t ds;
+    lio_data_block_t *d[4];
+    seglun_block_t block[4];
+    seglun_row_t row;
+    lun_rw_row_t rwb[4];
+    apr_time_t est[4];
+    gop_opque_t *q;
+    apr_time_t end;
+    char cap[16];
+    int slow[4], defer[4];
+    int i, err;
+
+    err = 0;
+    memset(&s, 0, sizeof(s));
+    memset(&bl, 0, sizeof(bl));
+    memset(&ds, 0, sizeof(ds));
+    memset(rwb, 0, sizeof(rwb));
+
+    s.n_devices = 4;
+    s.tpc = gop_tp_context_create("HEDGE_TEST", 1, 4, 1);
+    ds.priv = s.tpc;
+    ds.get_cap = _hedge_test_get_cap;
+    ds.read_estimate = _hedge_test_estimate;
+    ds.read = _hedge_test_read;
+
+    apr_pool_create(&(bl.mpool), NULL);
+    apr_thread_mutex_create(&(bl.lock), APR_THREAD_MUTEX_DEFAULT, bl.mpool);
+    bl.table = apr_hash_make(bl.mpool);
+    bl.slow_ratio = 2;
+    bl.min_io_time = 1;
+    bl.hedge_defer = 1;
+
+    row.block = block;
+    for (i=0; i<4; i++) {
+        tbx_type_malloc_clear(d[i], lio_data_block_t, 1);
+        d[i]->ds = &ds;
+        snprintf(cap, sizeof(cap), "cap-%d", i);
+        d[i]->cap = (data_block_cap_t *)strdup(cap);  //** The fake data service uses the string as the cap set
+        d[i]->rid_key = strdup(cap);
+        block[i].data = d[i];
+        rwb[i].block = &(block[i]);
+        rwb[i].n_ex = 1;
+        rwb[i].n_iov = 1;
+        rwb[i].len = 16;
+        tbx_type_malloc_clear(rwb[i].ex_iov, ex_tbx_iovec_t, 1);
+        rwb[i].ex_iov[0].len = 16;
+    }
+
+    //** Dead hosts report INT64_MAX and shouldn't be used for the median
+    _hedge_test_est[0] = 10;
+    _hedge_test_est[1] = INT64_MAX;
+    _hedge_test_est[2] = 12;
+    _hedge_test_est[3] = INT64_MAX;
+    lun_read_estimates(&s, &row, rwb, est);
+    if (est[1] != INT64_MAX) err++;
+    lun_slow_devices(&s, &bl, &row, est, 2, slow);
+    if ((slow[0] != 0) || (slow[1] != 1) || (slow[2] != 0) || (slow[3] != 1)) {
+        log_printf(0, "ERROR: slow=%d %d %d %d\n", slow[0], slow[1], slow[2], slow[3]);
+        err++;
+    }
+
+    //** Nothing is flagged if everyone is close to the median
+    _hedge_test_est[1] = 11;
+    _hedge_test_est[3] = 15;
+    lun_read_estimates(&s, &row, rwb, est);
+    lun_slow_devices(&s, &bl, &row, est, 2, slow);
+    if (slow[0] + slow[1] + slow[2] + slow[3] != 0) err++;
+
+    //** The worst estimate is held back
+    _hedge_test_est[2] = 50;
+    lun_read_estimates(&s, &row, rwb, est);
+    if ((lun_hedge_defer(&s, &bl, &row, est, 2, NULL, defer) != 1) || (defer[2] != 1)) err++;
+
+    //** Abandon a read and destroy the data block it came from while it's still running
+    q = gop_opque_new();
+    opque_start_execution(q);
+    lun_hedge_issue(&(rwb[0]), 0, NULL, q, 10);
+    rwb[0].ex_iov = NULL;  //** Now owned by the reaper
+    if (lun_hedge_abandon(&s, rwb, 4, q) != NULL) err++;
+    if (rwb[0].hedge_state != LUN_HEDGE_ABANDONED) err++;
+    memset((char *)d[0]->cap, 'X', 5);
+    free(d[0]->cap);
+    free(d[0]->rid_key);
+    free(d[0]);
+    d[0] = NULL;
+
+    end = apr_time_now() + apr_time_from_sec(10);
+    while ((tbx_atomic_get(_hedge_test_reads) == 0) && (apr_time_now() < end)) apr_sleep(apr_time_from_msec(10));
+    if (tbx_atomic_get(_hedge_test_reads) != 1) err++;
+    if (tbx_atomic_get(_hedge_test_bad) != 0) {
+        log_printf(0, "ERROR: Abandoned read used a freed cap\n");
+        err++;
+    }
+
+    gop_tp_context_destroy(s.tpc);  //** Waits for the reaper
+    for (i=0; i<4; i++) {
+        if (rwb[i].ex_iov) free(rwb[i].ex_iov);
+        if (d[i] == NULL) continue;
+        free(d[i]->cap);
+        free(d[i]->rid_key);
+        free(d[i]);
+    }
+    apr_pool_destroy(bl.mpool);
+
+    return(err);
+}
+
 //***********************************************************************
 // seglun_rw_op - Reads/Writes to a LUN segment
 //***********************************************************************
@@ -1472,13 +2142,19 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
     seglun_row_t *b;
     tbx_isl_iter_t it;
     ex_off_t lo, hi, start, end, blen, bpos;
-    int i, j, maxerr, nerr, slot, n_bslots, bl_count, dev, bl_rid;
+    int i, j, maxerr, nerr, slot, n_bslots, bl_count, dev, bl_rid, check_slow;
     tbx_stack_t *stack;
     lun_rw_row_t *rw_buf;
     double dt;
     apr_time_t exec_time;
     apr_time_t tstart, tstart2;
     gop_op_generic_t *gop;
+    int slow[s->n_devices];
+    int defer[s->n_devices];
+    int hedge, n_deferred, n_unsatisfied;
+    lun_hedge_row_t *hrow;
+    apr_time_t deadline;
+    apr_time_t *est_table;
 
     tstart = apr_time_now();
 
@@ -1490,6 +2166,8 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
         log_printf(5, "max_blacklist=%d\n", rw_hints->lun_max_blacklist);
         if (rw_hints->lun_max_blacklist <= 0) bl = NULL;
     }
+    check_slow = ((bl != NULL) && (rw_mode == 0) && (bl->slow_ratio > 0)) ? 1 : 0;
+    hedge = ((bl != NULL) && (rw_mode == 0) && (bl->hedge_percentile > 0)) ? 1 : 0;
 
     segment_lock(seg);
 
@@ -1574,6 +2252,21 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
 
     log_printf(15, " n_bslots=%d\n", n_bslots);
 
+    hrow = NULL;
+    n_deferred = 0;
+    n_unsatisfied = n_bslots;
+    if ((hedge == 1) && (n_bslots > 0)) tbx_type_malloc_clear(hrow, lun_hedge_row_t, n_bslots);
+
+    //** Snapshot the estimates before taking the blacklist lock
+    est_table = NULL;
+    if (((check_slow == 1) || (hedge == 1)) && (n_bslots > 0)) {
+        tbx_type_malloc(est_table, apr_time_t, n_bslots * s->n_devices);
+        for (slot=0; slot < n_bslots; slot++) {
+            j = slot * s->n_devices;
+            lun_read_estimates(s, bused[slot], &(rwb_table[j]), &(est_table[j]));
+        }
+    }
+
     //** Acquire the blacklist lock if using it
     if (bl) apr_thread_mutex_lock(bl->lock);
 
@@ -1583,6 +2276,15 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
         bl_count = 0;
         b->rwop_index = -1;
         j = slot * s->n_devices;
+        if (check_slow == 1) lun_slow_devices(s, bl, b, &(est_table[j]), rw_hints->lun_max_blacklist, slow);
+        if (hedge == 1) {
+            hrow[slot].deferred = lun_hedge_defer(s, bl, b, &(est_table[j]), rw_hints->lun_max_blacklist, ((check_slow == 1) ? slow : NULL), defer);
+            n_deferred += hrow[slot].deferred;
+
+            //** Each row earns a little hedge credit
+            bl->hedge_credit += bl->hedge_budget;
+            if (bl->hedge_credit > bl->hedge_burst) bl->hedge_credit = bl->hedge_burst;
+        }
 
         for (i=0; i < s->n_devices; i++) {
             bl_rid = 0;
@@ -1591,6 +2293,7 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
                 //** Check on blacklisting the RID
                 if (bl != NULL) {
                     bl_rid = blacklist_check(bl, b->block[i].data->rid_key, 0);
+                    if ((bl_rid == 0) && (check_slow == 1)) bl_rid = slow[i];  //** Skip slow depots the same way
                     if (bl_rid == 1) {
                         if (bl_count >= rw_hints->lun_max_blacklist) {  //** Already blacklisted enough RIDS
                             bl_rid = 0;
@@ -1602,6 +2305,17 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
 
                 //** Form the op
                 tbx_tbuf_vec(&(rwb_table[j + i].buffer), rwb_table[j + i].len, rwb_table[j+i].n_iov, rwb_table[j+i].iov);
+                rwb_table[j+i].block = &(b->block[i]);
+                if (hedge == 1) {
+                    hrow[slot].need++;
+                    if (defer[i] == 0) hrow[slot].pending++;
+                    if (bl_rid == 0) {  //** Hedged reads go through a bounce buffer
+                        if (defer[i] == 0) lun_hedge_issue(&(rwb_table[j+i]), j+i, da, q, timeout);
+                        continue;
+                    }
+                    rwb_table[j+i].hedge_state = LUN_HEDGE_PENDING;
+                }
+
                 if (rw_mode== 0) {
                     if (rwb_table[j+i].n_iov == 1) {
                         gop = (bl_rid == 0) ? ds_read(b->block[i].data->ds, da, ds_get_cap(b->block[i].data->ds, b->block[i].data->cap, DS_CAP_READ),
@@ -1625,15 +2339,21 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
                 }
 
                 rwb_table[j+i].gop = gop;
-                rwb_table[j+i].block = &(b->block[i]);
                 gop_opque_add(q, rwb_table[j+i].gop);
                 gop_set_myid(rwb_table[j+i].gop, j+i);
                 gop_set_private(gop, b->block[i].data->rid_key);
             }
         }
+
+        //** Rows only need enough devices to be decoded
+        if (hedge == 1) {
+            hrow[slot].need -= rw_hints->lun_max_blacklist;
+            if (hrow[slot].need < 1) hrow[slot].need = 1;
+        }
     }
 
     if (bl) apr_thread_mutex_unlock(bl->lock);
+    if (est_table) free(est_table);
 
     segment_unlock(seg);
 
@@ -1644,7 +2364,22 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
         tstart2 = apr_time_now();
         gop_op_status_t dt_status;
         int bad_count = 0;
-        while ((gop = opque_waitany(q)) != NULL) {
+        deadline = (n_deferred > 0) ? tstart2 + lun_hedge_deadline(s, bl, rwb_table) : 0;
+        while (1) {
+            if (hedge == 1) {
+                if (n_unsatisfied == 0) break;  //** Every row can be decoded so skip the stragglers
+
+                gop = (deadline > 0) ? opque_waitany_until(q, deadline) : opque_waitany(q);
+                if ((gop == NULL) && (deadline > 0) && (gop_opque_tasks_left(q) > 0)) {  //** Running long so hedge
+                    lun_hedge_stragglers(s, bl, hrow, n_bslots, rwb_table, da, q, timeout);
+                    deadline = 0;
+                    continue;
+                }
+            } else {
+                gop = opque_waitany(q);
+            }
+            if (gop == NULL) break;
+
             dt = apr_time_now() - tstart2;
             dt /= (APR_USEC_PER_SEC*1.0);
             dt_status = gop_get_status(gop);
@@ -1665,7 +2400,10 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
                     }
                 }
             }
+
+            if (hedge == 1) n_unsatisfied -= lun_hedge_done(s, hrow, rwb_table, gop, da, q, timeout);
         }
+        if (hedge == 1) q = lun_hedge_abandon(s, rwb_table, n_bslots*s->n_devices, q);
         dt = apr_time_now() - tstart2;
         dt /= (APR_USEC_PER_SEC*1.0);
         log_printf(1, "IBP time: %lf errors=%d\n", dt, bad_count);
@@ -1676,22 +2414,35 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
             j = slot * s->n_devices;
             for (i=0; i < s->n_devices; i++) {
                 if (rwb_table[j+i].n_ex > 0) {
-                    if (gop_completed_successfully(rwb_table[j+i].gop) != OP_STATE_SUCCESS) {  //** Error
-                        nerr++;  //** Increment the error count
-                        if (rw_mode == 0) {
-                            tbx_tbuf_memset(&(rwb_table[j+i].buffer), 0, 0, rwb_table[j+i].len); //** Blank the data on READs
-                            rwb_table[j+i].block->read_err_count++;
-                        } else {
-                            rwb_table[j+i].block->write_err_count++;
+                    if ((rwb_table[j+i].gop == NULL) || (rwb_table[j+i].hedge_state == LUN_HEDGE_ABANDONED)) {  //** Skipped hedged read
+                        nerr++;
+                        tbx_tbuf_memset(&(rwb_table[j+i].buffer), 0, 0, rwb_table[j+i].len);
+                        log_printf(15, "end stage i=%d skipped hedge_state=%d nerr=%d\n", i, rwb_table[j+i].hedge_state, nerr);
+                    } else {
+                        if (gop_completed_successfully(rwb_table[j+i].gop) != OP_STATE_SUCCESS) {  //** Error
+                            nerr++;  //** Increment the error count
+                            if (rw_mode == 0) {
+                                tbx_tbuf_memset(&(rwb_table[j+i].buffer), 0, 0, rwb_table[j+i].len); //** Blank the data on READs
+                                rwb_table[j+i].block->read_err_count++;
+                            } else {
+                                rwb_table[j+i].block->write_err_count++;
+                            }
                         }
+                        log_printf(15, "end stage i=%d gid=%d gop_completed_successfully=%d nerr=%d\n", i, gop_id(rwb_table[j+i].gop), gop_completed_successfully(rwb_table[j+i].gop), nerr);
                     }
 
-                    free(rwb_table[j+i].ex_iov);
-                    log_printf(15, "end stage i=%d gid=%d gop_completed_successfully=%d nerr=%d\n", i, gop_id(rwb_table[j+i].gop), gop_completed_successfully(rwb_table[j+i].gop), nerr);
+                    if (rwb_table[j+i].ex_iov != NULL) free(rwb_table[j+i].ex_iov);
                 }
 
                 if (rwb_table[j+i].iov != NULL) free(rwb_table[j+i].iov);
-                if (rwb_table[j+i].gop != NULL) gop_free(rwb_table[j+i].gop, OP_DESTROY);
+                if (rwb_table[j+i].hedge_state != LUN_HEDGE_ABANDONED) {  //** Abandoned ops are cleaned up by the reaper
+                    if (rwb_table[j+i].gop != NULL) gop_free(rwb_table[j+i].gop, OP_DESTROY);
+                    if (rwb_table[j+i].hio != NULL) {
+                        free(rwb_table[j+i].hio->cap);
+                        free(rwb_table[j+i].hio->buffer);
+                        free(rwb_table[j+i].hio);
+                    }
+                }
             }
 
             if (nerr > maxerr) maxerr = nerr;
@@ -1720,7 +2471,8 @@ gop_op_status_t seglun_rw_op(lio_segment_t *seg, data_attr_t *da, lio_segment_rw
         free(bused);
     }
     tbx_stack_free(stack, 0);
-    gop_opque_free(q, OP_DESTROY);
+    if (hrow != NULL) free(hrow);
+    if (q != NULL) gop_opque_free(q, OP_DESTROY);
 
     dt = apr_time_now() - tstart;
     dt /= (APR_USEC_PER_SEC*1.0);
@@ -1890,18 +2642,33 @@ gop_op_generic_t *seglun_remove(lio_segment_t *seg, data_attr_t *da, int timeout
     gop_opque_t *q;
     seglun_row_t *b;
     tbx_isl_iter_t it;
-    int i, j, n;
+    data_cap_t **mcap;
+    int i, j, n, m;
 
     q = gop_opque_new();
 
     segment_lock(seg);
     n = tbx_isl_count(s->isl);
     it = tbx_isl_iter_search(s->isl, (tbx_sl_key_t *)NULL, (tbx_sl_key_t *)NULL);
-    for (i=0; i<n; i++) {
-        b = (seglun_row_t *)tbx_isl_next(&it);
-        for (j=0; j < s->n_devices; j++) {
-            gop = ds_remove(b->block[j].data->ds, da, ds_get_cap(b->block[j].data->ds, b->block[j].data->cap, DS_CAP_MANAGE), timeout);
-            gop_opque_add(q, gop);
+    if ((s->ds->bulk_remove != NULL) && (n > 0)) {  //** Let the DS batch them by depot
+        tbx_type_malloc(mcap, data_cap_t *, n*s->n_devices);
+        m = 0;
+        for (i=0; i<n; i++) {
+            b = (seglun_row_t *)tbx_isl_next(&it);
+            for (j=0; j < s->n_devices; j++) {
+                mcap[m] = ds_get_cap(b->block[j].data->ds, b->block[j].data->cap, DS_CAP_MANAGE);
+                m++;
+            }
+        }
+        gop_opque_add(q, ds_bulk_remove(s->ds, da, mcap, NULL, m, timeout));
+        free(mcap);
+    } else {
+        for (i=0; i<n; i++) {
+            b = (seglun_row_t *)tbx_isl_next(&it);
+            for (j=0; j < s->n_devices; j++) {
+                gop = ds_remove(b->block[j].data->ds, da, ds_get_cap(b->block[j].data->ds, b->block[j].data->cap, DS_CAP_MANAGE), timeout);
+                gop_opque_add(q, gop);
+            }
         }
     }
     segment_unlock(seg);
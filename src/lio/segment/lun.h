@@ -23,6 +23,7 @@
 
 #include <gop/opque.h>
 #include <lio/blacklist.h>
+#include <lio/visibility.h>
 #include <tbx/fmttypes.h>
 
 #include "ex3.h"
@@ -37,6 +38,7 @@ extern "C" {
 lio_segment_t *segment_lun_load(void *arg, ex_id_t id, lio_exnode_exchange_t *ex);
 lio_segment_t *segment_lun_create(void *arg);
 int seglun_row_decompose_test();
+LIO_API int seglun_hedge_test();
 
 struct lio_seglun_priv_t {
     ex_off_t used_size;
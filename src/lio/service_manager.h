@@ -40,7 +40,7 @@ struct lio_service_manager_t {
 lio_service_manager_t *clone_service_manager(lio_service_manager_t *sm);
 lio_service_manager_t *create_service_manager();
 void destroy_service_manager(lio_service_manager_t *sm);
-int add_service(lio_service_manager_t *sm, char *service_section, char *service_name, void *service);
+LIO_API int add_service(lio_service_manager_t *sm, char *service_section, char *service_name, void *service);
 int remove_service(lio_service_manager_t *sm, char *service_section, char *service_name);
 
 #ifdef __cplusplus
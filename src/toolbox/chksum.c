@@ -20,6 +20,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
+#include <stdint.h>
+#include <pthread.h>
+#if defined(__x86_64__)
+#  include <nmmintrin.h>
+#elif defined(__aarch64__)
+#  include <arm_acle.h>
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+#endif
 
 #include "chksum.h"
 #include "tbx/transfer_buffer.h"
@@ -44,6 +53,10 @@ int tbx_blank_chksum_set(tbx_chksum_t *cs);
 #define CHKSUM_SHA256_LEN (2*SHA256_DIGEST_LENGTH)
 #define CHKSUM_SHA512_LEN (2*SHA512_DIGEST_LENGTH)
 #define CHKSUM_MD5_LEN    (2*MD5_DIGEST_LENGTH)
+#define CRC32C_DIGEST_LENGTH 4
+#define CHKSUM_CRC32C_LEN (2*CRC32C_DIGEST_LENGTH)
+#define XXH64_DIGEST_LENGTH 8
+#define CHKSUM_XXH64_LEN  (2*XXH64_DIGEST_LENGTH)
 
 #if defined(__APPLE__) && defined(__MACH__)
 #  define COMMON_DIGEST_FOR_OPENSSL
@@ -70,7 +83,7 @@ char *_bin2hex =  "00" "01" "02" "03" "04" "05" "06" "07" "08" "09" "0a" "0b" "0
                   "e0" "e1" "e2" "e3" "e4" "e5" "e6" "e7" "e8" "e9" "ea" "eb" "ec" "ed" "ee" "ef"
                   "f0" "f1" "f2" "f3" "f4" "f5" "f6" "f7" "f8" "f9" "fa" "fb" "fc" "fd" "fe" "ff";
 
-char *_chksum_name[] = { "NONE", "SHA256", "SHA512", "SHA1", "MD5" };
+char *_chksum_name[] = { "NONE", "SHA256", "SHA512", "SHA1", "MD5", "CRC32C", "XXH64" };
 char *_chksum_name_default = "DEFAULT";
 
 //**********************************************************************
@@ -253,6 +266,401 @@ _openssl_chksum(SHA256, sha256)
 _openssl_chksum(SHA512, sha512)
 _openssl_chksum(MD5, md5)
 
+//*************************************************************************
+// _chksum_tbuf_add - Walks the tbuf and feeds each block to the update routine.
+//     Used by the non-OpenSSL chksums.
+//*************************************************************************
+
+typedef void (*_chksum_update_fn_t)(void *state, const unsigned char *buf, size_t len);
+
+int _chksum_tbuf_add(void *state, int nbytes, tbx_tbuf_t *data, int boff, _chksum_update_fn_t update)
+{
+    int i, n_iov;
+    size_t nleft, len;
+    tbx_iovec_t *iov;
+    tbx_tbuf_var_t *tbv;
+
+    tbv = (tbx_tbuf_var_t*) malloc(tbx_tbuf_var_size());
+    if (!tbv) return(-1);
+    tbx_tbuf_var_init(tbv);
+
+    nleft = nbytes;
+    while (nleft > 0) {
+        tbx_tbuf_var_nbytes_set(tbv, nleft);
+        if (tbx_tbuf_next_block(data, boff, tbv) != TBUFFER_OK) {
+            free(tbv);
+            return(0);
+        }
+        iov = tbx_tbuf_var_buffer_get(tbv);
+        n_iov = tbx_tbuf_var_n_iov_get(tbv);
+        for (i=0; (i<n_iov) && (nleft > 0); i++) {
+            len = (iov[i].iov_len > nleft) ? nleft : iov[i].iov_len;
+            update(state, (const unsigned char *)iov[i].iov_base, len);
+            nleft -= len;
+            boff += len;
+        }
+    }
+
+    free(tbv);
+    return(1);
+}
+
+//*************************************************************************
+// _chksum_be_get - Returns a 32 or 64-bit chksum value in big endian
+//     binary or hex form
+//*************************************************************************
+
+int _chksum_be_get(uint64_t value, int nbytes, tbx_chksum_digest_output_t type, char *data)
+{
+    unsigned char md[8];
+    int i;
+
+    for (i=nbytes-1; i>=0; i--) {
+        md[i] = value & 0xFF;
+        value >>= 8;
+    }
+
+    switch (type) {
+    case CHKSUM_DIGEST_BIN:
+        memcpy(data, md, nbytes);
+        return(1);
+    case CHKSUM_DIGEST_HEX:
+        return(tbx_chksum_bin2hex(nbytes, md, data));
+    }
+
+    return(-1);
+}
+
+//*************************************************************************
+// CRC32C (Castagnoli) - Uses the SSE4.2 or ARMv8 CRC instructions if the
+//     CPU has them.  Otherwise a slicing-by-8 table is used.
+//*************************************************************************
+
+typedef uint32_t (*_crc32c_fn_t)(uint32_t crc, const unsigned char *buf, size_t len);
+
+uint32_t _crc32c_table[8][256];
+_crc32c_fn_t _crc32c_update = NULL;
+pthread_once_t _crc32c_once = PTHREAD_ONCE_INIT;
+
+uint32_t _crc32c_sw(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    uint64_t w;
+
+    while ((len > 0) && (((uintptr_t)buf & 7) != 0)) {
+        crc = _crc32c_table[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    while (len >= 8) {
+        memcpy(&w, buf, 8);
+        w ^= crc;   //** Assumes little endian like the rest of the on disk formats
+        crc = _crc32c_table[7][w & 0xFF] ^ _crc32c_table[6][(w >> 8) & 0xFF] ^
+              _crc32c_table[5][(w >> 16) & 0xFF] ^ _crc32c_table[4][(w >> 24) & 0xFF] ^
+              _crc32c_table[3][(w >> 32) & 0xFF] ^ _crc32c_table[2][(w >> 40) & 0xFF] ^
+              _crc32c_table[1][(w >> 48) & 0xFF] ^ _crc32c_table[0][w >> 56];
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len > 0) {
+        crc = _crc32c_table[0][(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    return(crc);
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t _crc32c_hw(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    uint64_t c = crc;
+    uint64_t w;
+
+    while ((len > 0) && (((uintptr_t)buf & 7) != 0)) {
+        c = _mm_crc32_u8((uint32_t)c, *buf++);
+        len--;
+    }
+
+    while (len >= 8) {
+        memcpy(&w, buf, 8);
+        c = _mm_crc32_u64(c, w);
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len > 0) {
+        c = _mm_crc32_u8((uint32_t)c, *buf++);
+        len--;
+    }
+
+    return((uint32_t)c);
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+uint32_t _crc32c_hw(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    uint64_t w;
+
+    while ((len > 0) && (((uintptr_t)buf & 7) != 0)) {
+        crc = __crc32cb(crc, *buf++);
+        len--;
+    }
+
+    while (len >= 8) {
+        memcpy(&w, buf, 8);
+        crc = __crc32cd(crc, w);
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len > 0) {
+        crc = __crc32cb(crc, *buf++);
+        len--;
+    }
+
+    return(crc);
+}
+#endif
+
+void _crc32c_init()
+{
+    uint32_t crc;
+    int i, j;
+
+    for (i=0; i<256; i++) {
+        crc = i;
+        for (j=0; j<8; j++) crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : (crc >> 1);
+        _crc32c_table[0][i] = crc;
+    }
+    for (i=0; i<256; i++) {
+        crc = _crc32c_table[0][i];
+        for (j=1; j<8; j++) {
+            crc = _crc32c_table[0][crc & 0xFF] ^ (crc >> 8);
+            _crc32c_table[j][i] = crc;
+        }
+    }
+
+    _crc32c_update = _crc32c_sw;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) _crc32c_update = _crc32c_hw;
+#elif defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) _crc32c_update = _crc32c_hw;
+#endif
+}
+
+void crc32c_update(void *state, const unsigned char *buf, size_t len)
+{
+    uint32_t *crc = (uint32_t *)state;
+
+    *crc = _crc32c_update(*crc, buf, len);
+}
+
+int crc32c_reset(void *state)
+{
+    *(uint32_t *)state = 0xFFFFFFFF;
+    return(1);
+}
+
+int crc32c_size(void *state, tbx_chksum_digest_output_t type)
+{
+    return((type == CHKSUM_DIGEST_BIN) ? CRC32C_DIGEST_LENGTH : CHKSUM_CRC32C_LEN);
+}
+
+int crc32c_add(void *state, int nbytes, tbx_tbuf_t *data, int boff)
+{
+    return(_chksum_tbuf_add(state, nbytes, data, boff, crc32c_update));
+}
+
+int crc32c_get(void *state, tbx_chksum_digest_output_t type, char *data)
+{
+    return(_chksum_be_get(*(uint32_t *)state ^ 0xFFFFFFFF, CRC32C_DIGEST_LENGTH, type, data));
+}
+
+int crc32c_set(tbx_chksum_t *cs)
+{
+    pthread_once(&_crc32c_once, _crc32c_init);
+
+    cs->reset = crc32c_reset;
+    cs->size = crc32c_size;
+    cs->add = crc32c_add;
+    cs->get = crc32c_get;
+    cs->type = CHKSUM_CRC32C;
+
+    memset(cs->state, 0, CHKSUM_STATE_SIZE);
+    cs->reset(cs->state);
+    return(0);
+}
+
+//*************************************************************************
+// XXH64 - Non-cryptographic 64-bit hash.  Streaming version of the
+//     reference algorithm with a seed of 0.
+//*************************************************************************
+
+#define XXH_P1 0x9E3779B185EBCA87ULL
+#define XXH_P2 0xC2B2AE3D27D4EB4FULL
+#define XXH_P3 0x165667B19E3779F9ULL
+#define XXH_P4 0x85EBCA77C2B2AE63ULL
+#define XXH_P5 0x27D4EB2F165667C5ULL
+
+typedef struct {
+    uint64_t v[4];
+    uint64_t total_len;
+    unsigned char mem[32];
+    uint32_t memsize;
+} xxh64_state_t;
+
+#define _xxh_rotl(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t _xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_P2;
+    acc = _xxh_rotl(acc, 31);
+    return(acc * XXH_P1);
+}
+
+static inline uint64_t _xxh_merge(uint64_t acc, uint64_t val)
+{
+    acc ^= _xxh_round(0, val);
+    return(acc * XXH_P1 + XXH_P4);
+}
+
+static inline uint64_t _xxh_read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return(v);
+}
+
+static inline uint32_t _xxh_read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return(v);
+}
+
+void xxh64_update(void *state, const unsigned char *buf, size_t len)
+{
+    xxh64_state_t *s = (xxh64_state_t *)state;
+    const unsigned char *end = buf + len;
+    size_t n;
+
+    s->total_len += len;
+
+    if (s->memsize + len < 32) {  //** Not enough for a stripe so just buffer it
+        memcpy(s->mem + s->memsize, buf, len);
+        s->memsize += len;
+        return;
+    }
+
+    if (s->memsize > 0) {  //** Finish the partial stripe
+        n = 32 - s->memsize;
+        memcpy(s->mem + s->memsize, buf, n);
+        s->v[0] = _xxh_round(s->v[0], _xxh_read64(s->mem));
+        s->v[1] = _xxh_round(s->v[1], _xxh_read64(s->mem+8));
+        s->v[2] = _xxh_round(s->v[2], _xxh_read64(s->mem+16));
+        s->v[3] = _xxh_round(s->v[3], _xxh_read64(s->mem+24));
+        buf += n;
+        s->memsize = 0;
+    }
+
+    while (buf + 32 <= end) {
+        s->v[0] = _xxh_round(s->v[0], _xxh_read64(buf));
+        s->v[1] = _xxh_round(s->v[1], _xxh_read64(buf+8));
+        s->v[2] = _xxh_round(s->v[2], _xxh_read64(buf+16));
+        s->v[3] = _xxh_round(s->v[3], _xxh_read64(buf+24));
+        buf += 32;
+    }
+
+    if (buf < end) {
+        s->memsize = end - buf;
+        memcpy(s->mem, buf, s->memsize);
+    }
+}
+
+uint64_t xxh64_digest(xxh64_state_t *s)
+{
+    const unsigned char *p = s->mem;
+    const unsigned char *end = s->mem + s->memsize;
+    uint64_t h;
+
+    if (s->total_len >= 32) {
+        h = _xxh_rotl(s->v[0], 1) + _xxh_rotl(s->v[1], 7) + _xxh_rotl(s->v[2], 12) + _xxh_rotl(s->v[3], 18);
+        h = _xxh_merge(h, s->v[0]);
+        h = _xxh_merge(h, s->v[1]);
+        h = _xxh_merge(h, s->v[2]);
+        h = _xxh_merge(h, s->v[3]);
+    } else {
+        h = s->v[2] + XXH_P5;  //** v[2] is the seed
+    }
+
+    h += s->total_len;
+
+    while (p + 8 <= end) {
+        h ^= _xxh_round(0, _xxh_read64(p));
+        h = _xxh_rotl(h, 27) * XXH_P1 + XXH_P4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)_xxh_read32(p) * XXH_P1;
+        h = _xxh_rotl(h, 23) * XXH_P2 + XXH_P3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * XXH_P5;
+        h = _xxh_rotl(h, 11) * XXH_P1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    h ^= h >> 32;
+
+    return(h);
+}
+
+int xxh64_reset(void *state)
+{
+    xxh64_state_t *s = (xxh64_state_t *)state;
+
+    memset(s, 0, sizeof(xxh64_state_t));
+    s->v[0] = XXH_P1 + XXH_P2;
+    s->v[1] = XXH_P2;
+    s->v[2] = 0;
+    s->v[3] = -XXH_P1;
+    return(1);
+}
+
+int xxh64_size(void *state, tbx_chksum_digest_output_t type)
+{
+    return((type == CHKSUM_DIGEST_BIN) ? XXH64_DIGEST_LENGTH : CHKSUM_XXH64_LEN);
+}
+
+int xxh64_add(void *state, int nbytes, tbx_tbuf_t *data, int boff)
+{
+    return(_chksum_tbuf_add(state, nbytes, data, boff, xxh64_update));
+}
+
+int xxh64_get(void *state, tbx_chksum_digest_output_t type, char *data)
+{
+    return(_chksum_be_get(xxh64_digest((xxh64_state_t *)state), XXH64_DIGEST_LENGTH, type, data));
+}
+
+int xxh64_set(tbx_chksum_t *cs)
+{
+    cs->reset = xxh64_reset;
+    cs->size = xxh64_size;
+    cs->add = xxh64_add;
+    cs->get = xxh64_get;
+    cs->type = CHKSUM_XXH64;
+
+    memset(cs->state, 0, CHKSUM_STATE_SIZE);
+    cs->reset(cs->state);
+    return(0);
+}
+
 //*************************************************************************
 // blank chksum dummy routines
 //*************************************************************************
@@ -316,6 +724,12 @@ int tbx_chksum_set(tbx_chksum_t *cs, tbx_chksum_type_t tbx_chksum_type)
     case CHKSUM_MD5:
         i = md5_set(cs);
         break;
+    case CHKSUM_CRC32C:
+        i = crc32c_set(cs);
+        break;
+    case CHKSUM_XXH64:
+        i = xxh64_set(cs);
+        break;
     case CHKSUM_MAX_TYPE:
     case CHKSUM_DEFAULT:
     case CHKSUM_NONE:
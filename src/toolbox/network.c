@@ -56,6 +56,30 @@ char *tbx_ns_peer_address_get(tbx_ns_t *ns)
     return(ns->peer_address);
 }
 
+int tbx_ns_native_fd_get(tbx_ns_t *ns)
+{
+    if ((ns->sock == NULL) || (ns->sock_type != NS_TYPE_SOCK)) return(-1);
+    return(ns->native_fd(ns->sock));
+}
+
+int tbx_ns_read_pending(tbx_ns_t *ns)
+{
+    return((ns->end >= ns->start) ? ns->end - ns->start + 1 : 0);
+}
+
+void *tbx_ns_app_data_get(tbx_ns_t *ns)
+{
+    return(ns->app_data);
+}
+
+//** Any existing app data is released first.  The data is released with data_free when the connection closes
+void tbx_ns_app_data_set(tbx_ns_t *ns, void *data, void (*data_free)(void *data))
+{
+    if ((ns->app_data != NULL) && (ns->app_data_free != NULL)) ns->app_data_free(ns->app_data);
+    ns->app_data = data;
+    ns->app_data_free = data_free;
+}
+
 void tbx_ns_chksum_write_set(tbx_ns_t *ns, tbx_ns_chksum_t ncs) {
     ns->write_chksum = ncs;
 }
@@ -716,6 +740,11 @@ void _close_ns(tbx_ns_t *ns)
     tbx_log_flush();
 
     ns->cuid = -1;
+    if (ns->app_data != NULL) {
+        if (ns->app_data_free != NULL) ns->app_data_free(ns->app_data);
+        ns->app_data = NULL;
+    }
+
     if (ns->sock == NULL) return;
 
     if (ns->sock_status(ns->sock) != 1) return;
@@ -777,6 +806,8 @@ tbx_ns_t *tbx_ns_new()
     apr_thread_mutex_create(&(ns->read_lock), APR_THREAD_MUTEX_DEFAULT,ns->mpool);
     apr_thread_mutex_create(&(ns->write_lock), APR_THREAD_MUTEX_DEFAULT,ns->mpool);
 
+    ns->app_data = NULL;
+    ns->app_data_free = NULL;
     _ns_init(ns, 0);
     ns->id = ns->cuid = -1;
 
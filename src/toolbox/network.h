@@ -66,6 +66,8 @@ struct tbx_ns_t {
     tbx_ns_monitor_t *nm;      //This is only used for an accept call to tell which bind was accepted
     tbx_ns_chksum_t read_chksum;      //Read chksum
     tbx_ns_chksum_t write_chksum;     //Write chksum
+    void *app_data;          //** Application state tied to the connection.  Released when the connection is closed
+    void (*app_data_free)(void *data);  //** Routine used to release app_data
     ns_native_fd_t (*native_fd)(net_sock_t *sock);  //** Native socket if supported
     int (*close)(net_sock_t *sock);  //** Close socket
     long int (*write)(net_sock_t *sock, tbx_tbuf_t *buf, size_t boff, size_t count, tbx_ns_timeout_t tm);
@@ -130,7 +130,9 @@ enum tbx_chksum_type_t {
     CHKSUM_SHA512  = 2,  /*!< SHA512 */
     CHKSUM_SHA1    = 3,    /*!< SHA1 */
     CHKSUM_MD5     = 4,     /*!< MD5 */
-    CHKSUM_MAX_TYPE= 5/*!< Number of checksums */
+    CHKSUM_CRC32C  = 5,  /*!< CRC32C. Hardware accelerated if available */
+    CHKSUM_XXH64   = 6,   /*!< XXH64 */
+    CHKSUM_MAX_TYPE= 7/*!< Number of checksums */
 };
 
 // TEMPORARY
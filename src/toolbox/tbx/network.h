@@ -62,6 +62,10 @@ enum tbx_net_type_t {
 // Functions
 TBX_API void  tbx_ns_setid(tbx_ns_t *ns, int id);
 TBX_API char *tbx_ns_peer_address_get(tbx_ns_t *ns);
+TBX_API int tbx_ns_native_fd_get(tbx_ns_t *ns);
+TBX_API int tbx_ns_read_pending(tbx_ns_t *ns);
+TBX_API void *tbx_ns_app_data_get(tbx_ns_t *ns);
+TBX_API void tbx_ns_app_data_set(tbx_ns_t *ns, void *data, void (*data_free)(void *data));
 TBX_API char *tbx_nm_host_get(tbx_ns_monitor_t *nm);
 TBX_API int tbx_nm_port_get(tbx_ns_monitor_t *nm);
 TBX_API tbx_ns_monitor_t *tbx_ns_monitor_get(tbx_ns_t *ns);
@@ -0,0 +1,94 @@
+#include "task.h"
+#include <erasure_gf8.h>
+#include <erasure_tools.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ERASURE_BENCH_DATA   6
+#define ERASURE_BENCH_PARITY 3
+#define ERASURE_BENCH_CHUNKS 64
+#define ERASURE_BENCH_LOOPS  100
+
+static const char *erasure_bench_kernels[] = { "scalar", "ssse3", "avx2", "avx512", "neon", NULL };
+
+static double erasure_bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double erasure_bench_encode(lio_erasure_plan_t *plan, char **ptr, int bsize) {
+  double dt;
+  int k;
+
+  dt = erasure_bench_now();
+  for (k=0; k<ERASURE_BENCH_LOOPS; k++) plan->encode_block(plan, ptr, bsize);
+  dt = erasure_bench_now() - dt;
+
+  return (double)ERASURE_BENCH_DATA * bsize * ERASURE_BENCH_LOOPS / dt / 1e9;
+}
+
+static int erasure_bench_method(int method, const char *mname) {
+  lio_erasure_plan_t *plan;
+  char *ref[ERASURE_BENCH_DATA+ERASURE_BENCH_PARITY];
+  char *ptr[ERASURE_BENCH_DATA+ERASURE_BENCH_PARITY];
+  const char *best;
+  int erasures[ERASURE_BENCH_PARITY+1];
+  int i, k, n, bsize;
+
+  n = ERASURE_BENCH_DATA + ERASURE_BENCH_PARITY;
+  plan = et_generate_plan(64*1024*1024, method, ERASURE_BENCH_DATA, ERASURE_BENCH_PARITY, -1, -1, -1);
+  ASSERT(plan != NULL);
+  plan->form_encoding_matrix(plan);
+  plan->form_decoding_matrix(plan);
+  bsize = plan->w * plan->packet_size * plan->base_unit * ERASURE_BENCH_CHUNKS;
+
+  for (i=0; i<n; i++) {
+    ref[i] = malloc(bsize);
+    ptr[i] = malloc(bsize);
+    ASSERT((ref[i] != NULL) && (ptr[i] != NULL));
+    if (i < ERASURE_BENCH_DATA) {
+      for (k=0; k<bsize; k++) ref[i][k] = rand();
+      memcpy(ptr[i], ref[i], bsize);
+    }
+  }
+
+  //** jerasure is the reference layout
+  et_plan_set_engine(plan, ET_ENGINE_JERASURE);
+  plan->encode_block(plan, ref, bsize);
+  fprintf(stderr, "%s encode %-8s: %.2f GB/s\n", mname, "jerasure", erasure_bench_encode(plan, ref, bsize));
+
+  best = gf8_kernel_name();
+  ASSERT(et_plan_set_engine(plan, ET_ENGINE_GF8) == ET_ENGINE_GF8);
+  for (i=0; erasure_bench_kernels[i] != NULL; i++) {
+    if (gf8_kernel_set(erasure_bench_kernels[i]) != 0) continue;
+
+    //** Parity must match jerasure and a degraded decode must restore everything
+    plan->encode_block(plan, ptr, bsize);
+    for (k=0; k<n; k++) ASSERT(memcmp(ref[k], ptr[k], bsize) == 0);
+    erasures[0] = 0;  erasures[1] = 2;  erasures[2] = ERASURE_BENCH_DATA;  erasures[3] = -1;
+    for (k=0; erasures[k] != -1; k++) memset(ptr[erasures[k]], 0, bsize);
+    ASSERT(plan->decode_block(plan, ptr, bsize, erasures) == 0);
+    for (k=0; k<n; k++) ASSERT(memcmp(ref[k], ptr[k], bsize) == 0);
+
+    fprintf(stderr, "%s encode %-8s: %.2f GB/s\n", mname, erasure_bench_kernels[i], erasure_bench_encode(plan, ptr, bsize));
+  }
+  fflush(stderr);
+
+  gf8_kernel_set(best);
+
+  for (i=0; i<n; i++) {
+    free(ref[i]);
+    free(ptr[i]);
+  }
+  et_destroy_plan(plan);
+  return 0;
+}
+
+BENCHMARK_IMPL(erasure_gf8) {
+  fprintf(stderr, "gf8 default kernel: %s  %d+%d strips\n", gf8_kernel_name(), ERASURE_BENCH_DATA, ERASURE_BENCH_PARITY);
+  erasure_bench_method(REED_SOL_VAN, "reed_sol_van");
+  erasure_bench_method(CAUCHY_GOOD, "cauchy_good");
+  return 0;
+}
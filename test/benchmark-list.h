@@ -20,7 +20,11 @@
  */
 
 BENCHMARK_DECLARE (sizes)
+BENCHMARK_DECLARE (raid4_xor)
+BENCHMARK_DECLARE (erasure_gf8)
 
 TASK_LIST_START
   BENCHMARK_ENTRY  (sizes)
+  BENCHMARK_ENTRY  (raid4_xor)
+  BENCHMARK_ENTRY  (erasure_gf8)
 TASK_LIST_END
@@ -0,0 +1,66 @@
+#include "task.h"
+#include <raid4.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RAID4_BENCH_STRIPS 6
+#define RAID4_BENCH_BLOCK  (1024*1024)
+#define RAID4_BENCH_LOOPS  200
+
+static const char *raid4_bench_kernels[] = { "scalar", "sse2", "avx2", "avx512", "neon", NULL };
+
+static double raid4_bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+BENCHMARK_IMPL(raid4_xor) {
+  char *data[RAID4_BENCH_STRIPS];
+  char *parity[1], *check;
+  const char *best;
+  int erasures[2];
+  double dt;
+  int i, k;
+
+  for (i=0; i<RAID4_BENCH_STRIPS; i++) {
+    data[i] = malloc(RAID4_BENCH_BLOCK);
+    ASSERT(data[i] != NULL);
+    for (k=0; k<RAID4_BENCH_BLOCK; k++) data[i][k] = rand();
+  }
+  parity[0] = malloc(RAID4_BENCH_BLOCK);
+  check = malloc(RAID4_BENCH_BLOCK);
+  ASSERT((parity[0] != NULL) && (check != NULL));
+
+  best = raid4_xor_kernel_name();
+  fprintf(stderr, "raid4 default kernel: %s\n", best);
+
+  for (i=0; raid4_bench_kernels[i] != NULL; i++) {
+    if (raid4_xor_kernel_set(raid4_bench_kernels[i]) != 0) continue;
+
+    //** Make sure a lost strip is rebuilt correctly before timing
+    raid4_encode(RAID4_BENCH_STRIPS, data, parity, RAID4_BENCH_BLOCK);
+    memcpy(check, data[1], RAID4_BENCH_BLOCK);
+    memset(data[1], 0, RAID4_BENCH_BLOCK);
+    erasures[0] = 1;  erasures[1] = -1;
+    ASSERT(raid4_decode(RAID4_BENCH_STRIPS, erasures, data, parity, RAID4_BENCH_BLOCK) == 0);
+    ASSERT(memcmp(check, data[1], RAID4_BENCH_BLOCK) == 0);
+
+    dt = raid4_bench_now();
+    for (k=0; k<RAID4_BENCH_LOOPS; k++) raid4_encode(RAID4_BENCH_STRIPS, data, parity, RAID4_BENCH_BLOCK);
+    dt = raid4_bench_now() - dt;
+
+    fprintf(stderr, "raid4 encode %-6s: %d+1 strips x %d bytes: %.2f GB/s\n", raid4_bench_kernels[i],
+            RAID4_BENCH_STRIPS, RAID4_BENCH_BLOCK,
+            (double)RAID4_BENCH_STRIPS * RAID4_BENCH_BLOCK * RAID4_BENCH_LOOPS / dt / 1e9);
+  }
+  fflush(stderr);
+
+  raid4_xor_kernel_set(best);
+
+  for (i=0; i<RAID4_BENCH_STRIPS; i++) free(data[i]);
+  free(parity[0]);
+  free(check);
+  return 0;
+}
@@ -1315,6 +1315,130 @@ void perform_pushpull_tests(ibp_depot_t *depot1, ibp_depot_t *depot2)
     }
 }
 
+//*************************************************************************
+// perform_bulk_tests - Checks IBP_BULK_ALLOCATE and the IBP_BULK_MANAGE
+//     probe, duration change, and remove sub-commands
+//*************************************************************************
+
+#define BULK_N 16
+
+void perform_bulk_tests(ibp_depot_t *depot)
+{
+    ibp_attributes_t attr;
+    ibp_capset_t *caps[BULK_N];
+    ibp_cap_t *mcap[BULK_N+1];
+    ibp_capstatus_t astat[BULK_N];
+    ibp_capstatus_t *probe[BULK_N];
+    int status[BULK_N+1];
+    char *bad_cap, *key;
+    int err, i, start_nfailed;
+    time_t duration;
+
+    start_nfailed = failed_tests;
+
+    printf("perform_bulk_tests: Starting tests!\n");
+    fflush(stdout);
+
+    for (i=0; i<BULK_N; i++) {
+        caps[i] = ibp_capset_new();
+        probe[i] = &(astat[i]);
+    }
+
+    //** Create the allocations
+    ibp_attributes_set(&attr, time(NULL) + A_DURATION, IBP_HARD, IBP_BYTEARRAY);
+    err = ibp_sync_command(ibp_bulk_alloc_gop(ic, caps, BULK_N, 1024, depot, &attr, disk_cs_type, disk_blocksize, ibp_timeout));
+    if (err != IBP_OK) {
+        failed_tests++;
+        printf("perform_bulk_tests: FAILED ibp_bulk_alloc error! ibp_errno=%d\n", err);
+        for (i=0; i<BULK_N; i++) ibp_capset_destroy(caps[i]);
+        return;
+    }
+
+    for (i=0; i<BULK_N; i++) mcap[i] = ibp_cap_get(caps[i], IBP_MANAGECAP);
+
+    //** Probe them all and make sure they look like what we asked for
+    memset(astat, 0, sizeof(astat));
+    err = ibp_sync_command(ibp_bulk_probe_gop(ic, mcap, BULK_N, probe, status, ibp_timeout));
+    if (err != IBP_OK) {
+        failed_tests++;
+        printf("perform_bulk_tests: FAILED ibp_bulk_probe error! ibp_errno=%d\n", err);
+    } else {
+        for (i=0; i<BULK_N; i++) {
+            if ((status[i] != IBP_OK) || (astat[i].maxSize != 1024) || (astat[i].readRefCount != 1)) {
+                failed_tests++;
+                printf("perform_bulk_tests: FAILED probe mismatch i=%d status=%d max_size=" I64T " read_count=%d\n", i, status[i], astat[i].maxSize, astat[i].readRefCount);
+            }
+        }
+    }
+
+    //** Shorten the duration on all of them
+    duration = time(NULL) + A_DURATION/2;
+    err = ibp_sync_command(ibp_bulk_modify_duration_gop(ic, mcap, BULK_N, duration, status, ibp_timeout));
+    if (err != IBP_OK) {
+        failed_tests++;
+        printf("perform_bulk_tests: FAILED ibp_bulk_modify_duration error! ibp_errno=%d\n", err);
+    }
+
+    memset(astat, 0, sizeof(astat));
+    err = ibp_sync_command(ibp_bulk_probe_gop(ic, mcap, BULK_N, probe, status, ibp_timeout));
+    if (err != IBP_OK) {
+        failed_tests++;
+        printf("perform_bulk_tests: FAILED ibp_bulk_probe after duration change error! ibp_errno=%d\n", err);
+    } else {
+        for (i=0; i<BULK_N; i++) {
+            if (labs((long)(astat[i].attrib.duration - duration)) > 5) {
+                failed_tests++;
+                printf("perform_bulk_tests: FAILED duration mismatch i=%d got=%ld should be %ld\n", i, (long)astat[i].attrib.duration, (long)duration);
+            }
+        }
+    }
+
+    //** Remove them along with a bogus key.  Only the bogus one should fail.
+    bad_cap = strdup(mcap[0]);
+    key = strchr(bad_cap, '#');
+    if (key != NULL) key[1] = (key[1] == 'x') ? 'y' : 'x';
+    mcap[BULK_N] = bad_cap;
+    err = ibp_sync_command(ibp_bulk_remove_gop(ic, mcap, BULK_N+1, status, ibp_timeout));
+    if (err == IBP_OK) {
+        failed_tests++;
+        printf("perform_bulk_tests: FAILED ibp_bulk_remove succeeded with a bad cap!\n");
+    } else {
+        for (i=0; i<BULK_N; i++) {
+            if (status[i] != IBP_OK) {
+                failed_tests++;
+                printf("perform_bulk_tests: FAILED ibp_bulk_remove i=%d status=%d\n", i, status[i]);
+            }
+        }
+        if (status[BULK_N] == IBP_OK) {
+            failed_tests++;
+            printf("perform_bulk_tests: FAILED ibp_bulk_remove accepted the bad cap!\n");
+        }
+    }
+    free(bad_cap);
+
+    //** They should all be gone now
+    err = ibp_sync_command(ibp_bulk_probe_gop(ic, mcap, BULK_N, probe, status, ibp_timeout));
+    if (err == IBP_OK) {
+        failed_tests++;
+        printf("perform_bulk_tests: FAILED Was able to probe the removed allocations!\n");
+    } else {
+        for (i=0; i<BULK_N; i++) {
+            if (status[i] == IBP_OK) {
+                failed_tests++;
+                printf("perform_bulk_tests: FAILED allocation i=%d still exists after the remove!\n", i);
+            }
+        }
+    }
+
+    for (i=0; i<BULK_N; i++) ibp_capset_destroy(caps[i]);
+
+    if (start_nfailed == failed_tests) {
+        printf("perform_bulk_tests: Passed!\n");
+    } else {
+        printf("perform_bulk_tests: Oops! FAILED!\n");
+    }
+}
+
 //*********************************************************************************
 // perform_transfer_buffer_tests - Testst the transfer buffer next an copy routines
 //*********************************************************************************
@@ -2067,6 +2191,7 @@ log_printf(0, "AFTER ibp_rename_gop\n"); tbx_log_flush();
     perform_pushpull_tests(&depot1, &depot2);
     perform_big_alloc_tests(&depot1);
     perform_manage_truncate_tests(&depot1);
+    perform_bulk_tests(&depot1);
     perform_transfer_buffer_tests();
 
 
@@ -0,0 +1,439 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// ibps_depot_stub - Stands in for the parts of the depot used by
+//    proto_v2.c so the real framing, dispatch and reply code can be
+//    run against a loopback connection.  See ibps_depot_stub.h.
+//*****************************************************************
+
+#include <apr_time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <tbx/network.h>
+#include <tbx/net_sock.h>
+#include <tbx/string_token.h>
+#include <tbx/transfer_buffer.h>
+#include "ibp_server.h"
+#include "ibp_task.h"
+#include "ibp_protocol.h"
+#include "allocation.h"
+#include "resource.h"
+#include "lock_alloc.h"
+#include "activity_log.h"
+#include "ibps_depot_stub.h"
+
+#define PVD_MAX_CONN  32
+#define PVD_N_ALLOC   3
+
+typedef struct {
+    char *cap;
+    osd_id_t id;
+    uint64_t size;
+    char *data;
+} pvd_alloc_t;
+
+typedef struct {
+    tbx_network_t *net;
+    pthread_t listen_thread;
+    pthread_t conn_thread[PVD_MAX_CONN];
+    pthread_mutex_t lock;
+    int port;
+    int shutdown;
+    int n_conn;
+    int n_v2;
+    int n_closed;
+} pvd_depot_t;
+
+static pvd_alloc_t pvd_alloc[PVD_N_ALLOC] = { { "fast", 1, 0, NULL }, { "slow", 2, 0, NULL }, { "badw", 3, 0, NULL } };
+static pvd_depot_t pvd;
+static Resource_t pvd_res;
+static Config_t pvd_cfg;
+
+Config_t *global_config = NULL;
+
+//*****************************************************************
+// Network helpers.  Same as the depot's.
+//*****************************************************************
+
+int server_ns_read(tbx_ns_t *ns, char *buffer, int bsize, tbx_ns_timeout_t dt)
+{
+    tbx_tbuf_t tbuf;
+
+    tbx_tbuf_single(&tbuf, bsize, buffer);
+    return(tbx_ns_read(ns, &tbuf, 0, bsize, dt));
+}
+
+int server_ns_write_block(tbx_ns_t *ns, apr_time_t end_time, char *buffer, int bsize)
+{
+    tbx_tbuf_t tbuf;
+
+    tbx_tbuf_single(&tbuf, bsize, buffer);
+    return(tbx_ns_write_block(ns, end_time, &tbuf, 0, bsize));
+}
+
+int server_ns_read_block(tbx_ns_t *ns, apr_time_t end_time, char *buffer, int bsize)
+{
+    tbx_tbuf_t tbuf;
+
+    tbx_tbuf_single(&tbuf, bsize, buffer);
+    return(tbx_ns_read_block(ns, end_time, &tbuf, 0, bsize));
+}
+
+int send_cmd_result(ibp_task_t *task, int status)
+{
+    char result[100];
+
+    snprintf(result, sizeof(result), "%d \n", status);
+    return(server_ns_write_block(task->ns, apr_time_now() + apr_time_from_sec(5), result, strlen(result)));
+}
+
+int get_command_timeout(ibp_task_t *task, char **bstate)
+{
+    int fin, t;
+
+    t = 0;
+    sscanf(tbx_stk_string_token(NULL, " ", bstate, &fin), "%d", &t);
+    task->cmd_timeout = apr_time_now() + apr_time_from_sec((t > 0) ? t : 2);
+    return(1);
+}
+
+int shutdown_request()
+{
+    int n;
+
+    pthread_mutex_lock(&(pvd.lock));
+    n = pvd.shutdown;
+    pthread_mutex_unlock(&(pvd.lock));
+
+    return(n);
+}
+
+int request_task_close() { return(0); }
+
+//*****************************************************************
+// Bookkeeping the protocol doesn't care about
+//*****************************************************************
+
+void clear_stat(Transfer_stat_t *s) { memset(s, 0, sizeof(Transfer_stat_t)); }
+void add_stat(Transfer_stat_t *s) { }
+void lock_osd_id(osd_id_t id) { }
+void unlock_osd_id(osd_id_t id) { }
+int alog_append_read(int tid, int ri, osd_id_t pid, osd_id_t id, uint64_t offset, uint64_t size) { return(0); }
+int alog_append_write(int tid, int cmd, int ri, osd_id_t pid, osd_id_t id, uint64_t offset, uint64_t size) { return(0); }
+int alog_append_cmd_result(int tid, int status) { return(0); }
+void update_read_history(Resource_t *r, osd_id_t id, int is_alias, Allocation_address_t *add, uint64_t offset, uint64_t size, osd_id_t pid) { }
+void update_write_history(Resource_t *r, osd_id_t id, int is_alias, Allocation_address_t *add, uint64_t offset, uint64_t size, osd_id_t pid) { }
+
+char *ibp_rid2str(rid_t rid, char *buffer)
+{
+    strncpy(buffer, rid.name, RID_LEN);
+    return(buffer);
+}
+
+int ibp_str2rid(char *rid_str, rid_t *rid)
+{
+    memset(rid, 0, sizeof(rid_t));
+    strncpy(rid->name, rid_str, RID_LEN-1);
+    return(0);
+}
+
+//*****************************************************************
+// In memory resource
+//*****************************************************************
+
+Resource_t *resource_lookup(Resource_list_t *rl, char *rid)
+{
+    return((strcmp(rid, PVD_RID) == 0) ? &pvd_res : NULL);
+}
+
+int resource_get_mode(Resource_t *r) { return(RES_MODE_READ|RES_MODE_WRITE); }
+
+static pvd_alloc_t *pvd_alloc_get(osd_id_t id)
+{
+    int i;
+
+    for (i=0; i<PVD_N_ALLOC; i++) {
+        if (pvd_alloc[i].id == id) return(&(pvd_alloc[i]));
+    }
+
+    return(NULL);
+}
+
+static void pvd_alloc_fill(pvd_alloc_t *pa, Allocation_t *a)
+{
+    memset(a, 0, sizeof(Allocation_t));
+    a->id = pa->id;
+    a->type = IBP_BYTEARRAY;
+    a->max_size = PVD_SIZE;
+    pthread_mutex_lock(&(pvd.lock));
+    a->size = pa->size;
+    pthread_mutex_unlock(&(pvd.lock));
+}
+
+int get_allocation_by_cap_resource(Resource_t *r, int cap_type, Cap_t *cap, Allocation_t *a)
+{
+    int i;
+
+    for (i=0; i<PVD_N_ALLOC; i++) {
+        if (strcmp(pvd_alloc[i].cap, cap->v) == 0) {
+            pvd_alloc_fill(&(pvd_alloc[i]), a);
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+int get_allocation_resource(Resource_t *r, osd_id_t id, Allocation_t *a)
+{
+    pvd_alloc_t *pa = pvd_alloc_get(id);
+
+    if (pa == NULL) return(1);
+    pvd_alloc_fill(pa, a);
+    return(0);
+}
+
+int modify_allocation_resource(Resource_t *r, osd_id_t id, Allocation_t *a)
+{
+    pvd_alloc_t *pa = pvd_alloc_get(id);
+
+    if (pa == NULL) return(1);
+    pthread_mutex_lock(&(pvd.lock));
+    pa->size = a->size;
+    pthread_mutex_unlock(&(pvd.lock));
+    return(0);
+}
+
+osd_fd_t *open_allocation(Resource_t *r, osd_id_t id, int mode) { return((osd_fd_t *)pvd_alloc_get(id)); }
+int close_allocation(Resource_t *r, osd_fd_t *fd) { return(0); }
+int get_allocation_state(Resource_t *r, osd_fd_t *fd) { return(OSD_STATE_GOOD); }
+
+ibp_off_t read_allocation(Resource_t *r, osd_fd_t *fd, ibp_off_t offset, ibp_off_t len, void *buffer)
+{
+    pvd_alloc_t *pa = (pvd_alloc_t *)fd;
+
+    if (strcmp(pa->cap, "slow") == 0) apr_sleep(apr_time_from_msec(PVD_SLOW_MS));
+    memcpy(buffer, pa->data + offset, len);
+    return(0);
+}
+
+ibp_off_t write_allocation(Resource_t *r, osd_fd_t *fd, ibp_off_t offset, ibp_off_t len, void *buffer)
+{
+    pvd_alloc_t *pa = (pvd_alloc_t *)fd;
+
+    if (strcmp(pa->cap, "badw") == 0) return(-1);
+    memcpy(pa->data + offset, buffer, len);
+    return(0);
+}
+
+//*****************************************************************
+// pvd_conn_thread - Handles a connection like the depot's task does
+//    up to the point the protocol takes over
+//*****************************************************************
+
+static void *pvd_conn_thread(void *arg)
+{
+    tbx_ns_t *ns = (tbx_ns_t *)arg;
+    ibp_task_t task;
+    tbx_tbuf_t tbuf;
+    tbx_ns_timeout_t dt;
+    apr_time_t end_time;
+    char line[256];
+    char *bstate;
+    int pos, err, fin, command;
+
+    memset(&task, 0, sizeof(task));
+    task.ns = ns;
+    task.net = pvd.net;
+    task.myid = tbx_ns_getid(ns);
+    task.command_acl[IBP_LOAD] = 1;
+    task.command_acl[IBP_WRITE] = 1;
+    task.command_acl[IBP_PROTOCOL] = 1;
+
+    tbx_tbuf_single(&tbuf, sizeof(line), line);
+    tbx_ns_timeout_set(&dt, 1, 0);
+    end_time = apr_time_now() + apr_time_from_sec(5);
+    pos = err = 0;
+    while ((err == 0) && (apr_time_now() < end_time)) {
+        pos += tbx_ns_readline_raw(ns, &tbuf, pos, sizeof(line)-pos, dt, &err);
+    }
+
+    if (err > 0) {
+        command = -1;
+        tbx_stk_string_token(line, " ", &bstate, &fin);  //** Version
+        sscanf(tbx_stk_string_token(NULL, " ", &bstate, &fin), "%d", &command);
+        if (command != IBP_PROTOCOL) {
+            send_cmd_result(&task, IBP_E_UNKNOWN_FUNCTION);
+        } else if (read_protocol(&task, &bstate) == 0) {
+            handle_protocol(&task);
+            if (proto_v2_active(ns) == 1) {
+                pthread_mutex_lock(&(pvd.lock));
+                pvd.n_v2++;
+                pthread_mutex_unlock(&(pvd.lock));
+            }
+        }
+    }
+
+    tbx_ns_destroy(ns);  //** This also tears down the session
+
+    pthread_mutex_lock(&(pvd.lock));
+    pvd.n_closed++;
+    pthread_mutex_unlock(&(pvd.lock));
+
+    return(NULL);
+}
+
+//*****************************************************************
+// pvd_listen_thread - Accepts the connections
+//*****************************************************************
+
+static void *pvd_listen_thread(void *arg)
+{
+    tbx_ns_t *ns;
+
+    while (shutdown_request() == 0) {
+        if (tbx_network_wait_for_connection(pvd.net, 1) <= 0) continue;
+
+        ns = tbx_ns_new();
+        if (tbx_network_accept_pending_connection(pvd.net, ns) != 0) {
+            tbx_ns_destroy(ns);
+            continue;
+        }
+
+        pthread_mutex_lock(&(pvd.lock));
+        if (pvd.n_conn == PVD_MAX_CONN) {
+            pthread_mutex_unlock(&(pvd.lock));
+            tbx_ns_destroy(ns);
+            continue;
+        }
+        pthread_create(&(pvd.conn_thread[pvd.n_conn]), NULL, pvd_conn_thread, ns);
+        pvd.n_conn++;
+        pthread_mutex_unlock(&(pvd.lock));
+    }
+
+    return(NULL);
+}
+
+//*****************************************************************
+// pvd_start - Starts the depot on an ephemeral loopback port.
+//    Returns the port or -1 on failure.  The DNS cache must already
+//    be running.
+//*****************************************************************
+
+int pvd_start()
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    tbx_ns_t *bns;
+    int i, j;
+
+    memset(&pvd, 0, sizeof(pvd));
+    pthread_mutex_init(&(pvd.lock), NULL);
+
+    for (i=0; i<PVD_N_ALLOC; i++) {
+        pvd_alloc[i].size = PVD_SIZE;
+        if (pvd_alloc[i].data == NULL) pvd_alloc[i].data = malloc(PVD_SIZE);
+        for (j=0; j<PVD_SIZE; j++) pvd_alloc[i].data[j] = PVD_BYTE(j);
+    }
+
+    memset(&pvd_cfg, 0, sizeof(pvd_cfg));
+    pvd_cfg.server.timeout_secs = 5;
+    pvd_cfg.server.timeout = apr_time_from_sec(5);
+    pvd_cfg.server.min_idle = apr_time_from_sec(2);
+    pvd_cfg.server.epoll_enable = 0;  //** The session runs on the connection's thread
+    global_config = &pvd_cfg;
+
+    proto_v2_init();
+
+    pvd.net = tbx_network_new();
+    bns = tbx_ns_new();
+    tbx_ns_sock_config(bns, 0);
+    if (tbx_network_bind(pvd.net, bns, "127.0.0.1", 0, 16) != 0) return(-1);
+    if (getsockname(tbx_ns_native_fd_get(bns), (struct sockaddr *)&addr, &len) != 0) return(-1);
+    pvd.port = ntohs(addr.sin_port);
+
+    if (pthread_create(&(pvd.listen_thread), NULL, pvd_listen_thread, NULL) != 0) return(-1);
+
+    return(pvd.port);
+}
+
+//*****************************************************************
+// pvd_stop - Closes everything down
+//*****************************************************************
+
+void pvd_stop()
+{
+    int i;
+
+    pthread_mutex_lock(&(pvd.lock));
+    pvd.shutdown = 1;
+    pthread_mutex_unlock(&(pvd.lock));
+
+    pthread_join(pvd.listen_thread, NULL);
+    tbx_network_close(pvd.net);
+
+    for (i=0; i<pvd.n_conn; i++) {
+        pthread_join(pvd.conn_thread[i], NULL);
+    }
+
+    tbx_network_destroy(pvd.net);
+    proto_v2_destroy();
+    global_config = NULL;
+
+    for (i=0; i<PVD_N_ALLOC; i++) {
+        free(pvd_alloc[i].data);
+        pvd_alloc[i].data = NULL;
+    }
+    pthread_mutex_destroy(&(pvd.lock));
+}
+
+//*****************************************************************
+// pvd_counts - Returns the connections accepted, the ones switched to
+//    the binary protocol and the ones that have been torn down
+//*****************************************************************
+
+void pvd_counts(int *n_conn, int *n_v2, int *n_closed)
+{
+    pthread_mutex_lock(&(pvd.lock));
+    *n_conn = pvd.n_conn;
+    *n_v2 = pvd.n_v2;
+    *n_closed = pvd.n_closed;
+    pthread_mutex_unlock(&(pvd.lock));
+}
+
+//*****************************************************************
+// pvd_wait_closed - Waits for at least n connections to be torn down.
+//    Returns 0 if they were and 1 on a timeout.
+//*****************************************************************
+
+int pvd_wait_closed(int n, int max_ms)
+{
+    int i, n_conn, n_v2, n_closed;
+
+    for (i=0; i<max_ms; i += 10) {
+        pvd_counts(&n_conn, &n_v2, &n_closed);
+        if (n_closed >= n) return(0);
+        apr_sleep(apr_time_from_msec(10));
+    }
+
+    return(1);
+}
@@ -0,0 +1,45 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*****************************************************************
+// ibps_depot_stub - Minimal loopback depot for driving the binary
+//    protocol in ibp-server/proto_v2.c.  Only IBP_PROTOCOL is accepted
+//    and the allocations live in memory.  Every allocation is on RID
+//    PVD_RID and uses its name for both the read and write cap:
+//
+//        fast - Plain allocation
+//        slow - Reads take PVD_SLOW_MS
+//        badw - Writes fail
+//
+//    All allocations are PVD_SIZE bytes and start out holding
+//    PVD_BYTE(offset).  The client side only sees plain types so it
+//    doesn't have to pull in the depot headers.
+//*****************************************************************
+
+#ifndef __IBPS_DEPOT_STUB_H_
+#define __IBPS_DEPOT_STUB_H_
+
+#define PVD_RID      "0"
+#define PVD_SIZE     65536
+#define PVD_SLOW_MS  500
+#define PVD_BYTE(off) ((char)((off) % 251))
+
+int pvd_start();
+void pvd_stop();
+void pvd_counts(int *n_conn, int *n_v2, int *n_closed);
+int pvd_wait_closed(int n, int max_ms);
+
+#endif
@@ -0,0 +1,382 @@
+#include "task.h"
+#include <apr_time.h>
+#include <arpa/inet.h>
+#include <gop/gop.h>
+#include <gop/opque.h>
+#include <gop/portal.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <tbx/iniparse.h>
+#include <tbx/net_sock.h>
+#include <tbx/network.h>
+#include <tbx/transfer_buffer.h>
+#include <unistd.h>
+
+#define HPT_MAX_CONN 32
+
+typedef struct hpt_server_s hpt_server_t;
+
+typedef struct {
+    hpt_server_t *s;
+    int slot;
+} hpt_conn_t;
+
+//** Line echo server.  A "hang" request is never answered and a "stall"
+//** request only gets part of its response.
+struct hpt_server_s {
+    int lfd;
+    int port;
+    int n_conn;
+    int conn_fd[HPT_MAX_CONN];
+    hpt_conn_t conn[HPT_MAX_CONN];
+    pthread_t conn_thread[HPT_MAX_CONN];
+    pthread_t listen_thread;
+    pthread_mutex_t lock;
+};
+
+typedef struct {
+    gop_op_generic_t gop;
+    gop_op_data_t dop;
+    int id;
+} hpt_op_t;
+
+static void *hpt_conn_thread(void *arg) {
+    hpt_conn_t *hc = (hpt_conn_t *)arg;
+    hpt_server_t *s = hc->s;
+    int fd = s->conn_fd[hc->slot];
+    char line[128];
+    int n, used = 0;
+    char c;
+
+    while ((n = read(fd, &c, 1)) == 1) {
+        if (c != '\n') {
+            if (used < (int)sizeof(line) - 2) line[used++] = c;
+            continue;
+        }
+        line[used] = '\0';
+        if (strcmp(line, "hang") == 0) {  //** Sit on it until the client gives up
+            while (read(fd, &c, 1) == 1) {}
+            break;
+        } else if (strcmp(line, "stall") == 0) {  //** Start the response and never finish it
+            if (write(fd, "1", 1) == 1) {
+                while (read(fd, &c, 1) == 1) {}
+            }
+            break;
+        }
+        line[used++] = '\n';
+        if (write(fd, line, used) != used) break;
+        used = 0;
+    }
+
+    pthread_mutex_lock(&(s->lock));
+    close(fd);
+    s->conn_fd[hc->slot] = -1;
+    pthread_mutex_unlock(&(s->lock));
+    return(NULL);
+}
+
+static void *hpt_listen_thread(void *arg) {
+    hpt_server_t *s = (hpt_server_t *)arg;
+    int fd;
+
+    while ((fd = accept(s->lfd, NULL, NULL)) >= 0) {
+        pthread_mutex_lock(&(s->lock));
+        if (s->n_conn == HPT_MAX_CONN) {
+            close(fd);
+        } else {
+            s->conn_fd[s->n_conn] = fd;
+            s->conn[s->n_conn].s = s;
+            s->conn[s->n_conn].slot = s->n_conn;
+            pthread_create(&(s->conn_thread[s->n_conn]), NULL, hpt_conn_thread, &(s->conn[s->n_conn]));
+            s->n_conn++;
+        }
+        pthread_mutex_unlock(&(s->lock));
+    }
+
+    return(NULL);
+}
+
+static int hpt_server_start(hpt_server_t *s) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&(s->lock), NULL);
+    s->lfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (s->lfd < 0) return(1);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(s->lfd, (struct sockaddr *)&addr, sizeof(addr)) != 0) return(1);
+    if (listen(s->lfd, 64) != 0) return(1);
+    if (getsockname(s->lfd, (struct sockaddr *)&addr, &len) != 0) return(1);
+    s->port = ntohs(addr.sin_port);
+
+    return(pthread_create(&(s->listen_thread), NULL, hpt_listen_thread, s));
+}
+
+static void hpt_server_stop(hpt_server_t *s) {
+    int i;
+
+    shutdown(s->lfd, SHUT_RDWR);
+    close(s->lfd);
+    pthread_join(s->listen_thread, NULL);
+
+    pthread_mutex_lock(&(s->lock));
+    for (i=0; i<s->n_conn; i++) {
+        if (s->conn_fd[i] != -1) shutdown(s->conn_fd[i], SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&(s->lock));
+
+    for (i=0; i<s->n_conn; i++) {
+        pthread_join(s->conn_thread[i], NULL);
+    }
+    pthread_mutex_destroy(&(s->lock));
+}
+
+//** Portal callbacks
+static void *hpt_dup_connect_context(void *cc) { return(NULL); }
+static void hpt_destroy_connect_context(void *cc) { }
+
+static int hpt_connect(tbx_ns_t *ns, void *cc, char *host, int port, tbx_ns_timeout_t timeout) {
+    tbx_ns_sock_config(ns, 0);
+    return(tbx_ns_connect(ns, host, port, timeout));
+}
+
+static void hpt_submit(void *arg, gop_op_generic_t *gop) {
+    gop_hp_que_op_submit(gop->base.pc, gop);
+}
+
+static gop_portal_fn_t hpt_portal = {
+    .dup_connect_context = hpt_dup_connect_context,
+    .destroy_connect_context = hpt_destroy_connect_context,
+    .connect = hpt_connect,
+    .close_connection = tbx_ns_close,
+    .sort_tasks = gop_default_sort_ops,
+    .submit = hpt_submit,
+    .sync_exec = NULL
+};
+
+static gop_op_status_t hpt_send(gop_op_generic_t *gop, tbx_ns_t *ns) {
+    hpt_op_t *op = (hpt_op_t *)gop->free_ptr;
+    gop_op_status_t status = { OP_STATE_RETRY, 0 };
+    char line[64];
+    tbx_tbuf_t buf;
+    int n;
+
+    if (op->id == -2) {
+        n = snprintf(line, sizeof(line), "stall\n");
+    } else if (op->id < 0) {
+        n = snprintf(line, sizeof(line), "hang\n");
+    } else {
+        n = snprintf(line, sizeof(line), "%d\n", op->id);
+    }
+    tbx_tbuf_single(&buf, n, line);
+    if (tbx_ns_write(ns, &buf, 0, n, apr_time_from_sec(1)) != n) return(status);
+
+    return(gop_success_status);
+}
+
+static gop_op_status_t hpt_recv(gop_op_generic_t *gop, tbx_ns_t *ns) {
+    hpt_op_t *op = (hpt_op_t *)gop->free_ptr;
+    gop_op_status_t status = { OP_STATE_TIMEOUT, 0 };
+    apr_time_t end_time = gop->op->cmd.start_time + gop->op->cmd.timeout;
+    char line[64];
+    tbx_tbuf_t buf;
+    int n, pos, err;
+
+    tbx_tbuf_single(&buf, sizeof(line), line);
+    pos = 0;
+    err = 0;
+    while ((err == 0) && (apr_time_now() < end_time)) {
+        n = tbx_ns_readline_raw(ns, &buf, pos, sizeof(line) - pos, apr_time_from_msec(100), &err);
+        pos += n;
+    }
+
+    if (err <= 0) {
+        if (err < 0) status.op_status = OP_STATE_FAILURE;
+        return(status);
+    }
+
+    return((atoi(line) == op->id) ? gop_success_status : gop_failure_status);
+}
+
+static void hpt_op_free(gop_op_generic_t *gop, int mode) {
+    if (gop->op->cmd.hostport != NULL) {
+        free(gop->op->cmd.hostport);
+        gop->op->cmd.hostport = NULL;
+    }
+    gop_generic_free(gop, OP_FINALIZE);
+    if (mode == OP_DESTROY) free(gop->free_ptr);
+}
+
+static gop_op_generic_t *hpt_op_new(gop_portal_context_t *hpc, int port, int id, int timeout) {
+    hpt_op_t *op;
+    gop_op_generic_t *gop;
+    char hostport[128];
+
+    op = calloc(1, sizeof(hpt_op_t));
+    op->id = id;
+
+    gop = &(op->gop);
+    gop_init(gop);
+    gop->op = &(op->dop);
+    gop->op->priv = op;
+    gop->type = Q_TYPE_OPERATION;
+    gop->free_ptr = op;
+    gop->base.free = hpt_op_free;
+    gop->base.pc = hpc;
+    gop->base.status = gop_error_status;
+    op->dop.pc = hpc;
+
+    snprintf(hostport, sizeof(hostport), "127.0.0.1" HP_HOSTPORT_SEPARATOR "%d" HP_HOSTPORT_SEPARATOR "0" HP_HOSTPORT_SEPARATOR "0", port);
+    op->dop.cmd.hostport = strdup(hostport);
+    op->dop.cmd.timeout = apr_time_from_sec(timeout);
+    op->dop.cmd.workload = 1;
+    op->dop.cmd.retry_count = 0;
+    op->dop.cmd.send_command = hpt_send;
+    op->dop.cmd.recv_phase = hpt_recv;
+
+    return(gop);
+}
+
+static gop_portal_context_t *hpt_context_load(char *text) {
+    gop_portal_context_t *hpc;
+    tbx_inip_file_t *ifd;
+
+    ifd = tbx_inip_string_read(text);
+    hpc = gop_hp_context_create(&hpt_portal, "TEST_HP");
+    gop_hpc_load(hpc, ifd, "hp");
+    tbx_inip_destroy(ifd);
+
+    return(hpc);
+}
+
+static gop_portal_context_t *hpt_context_create(int loops) {
+    char text[512];
+
+    snprintf(text, sizeof(text), "[hp]\nevent_loops=%d\nevent_send_threads=2\nevent_recv_threads=2\n"
+             "min_host_conn=1\nmax_host_conn=4\nmax_idle=1s\n", loops);
+    return(hpt_context_load(text));
+}
+
+static int hpt_run_batch(gop_portal_context_t *hpc, int port, int n) {
+    gop_opque_t *q;
+    int i, err;
+
+    q = gop_opque_new();
+    for (i=0; i<n; i++) {
+        gop_opque_add(q, hpt_op_new(hpc, port, i, 10));
+    }
+    err = opque_waitall(q);
+    gop_opque_free(q, OP_DESTROY);
+
+    return(err);
+}
+
+// Pipelined requests all get their own response through the event loops
+TEST_IMPL(gop_hportal_event) {
+    hpt_server_t s;
+    gop_portal_context_t *hpc;
+
+    gop_init_opque_system();
+    ASSERT(hpt_server_start(&s) == 0);
+
+    hpc = hpt_context_create(1);
+    ASSERT(hpt_run_batch(hpc, s.port, 200) == OP_STATE_SUCCESS);
+
+    //** Let the connections go idle and get closed then make sure new ones are made
+    sleep(3);
+    ASSERT(hpt_run_batch(hpc, s.port, 50) == OP_STATE_SUCCESS);
+
+    gop_hp_context_destroy(hpc);
+    hpt_server_stop(&s);
+    gop_shutdown();
+    return 0;
+}
+
+// An unanswered request times out without stalling the rest
+TEST_IMPL(gop_hportal_event_timeout) {
+    hpt_server_t s;
+    gop_portal_context_t *hpc;
+    gop_op_generic_t *gop;
+    apr_time_t start;
+
+    gop_init_opque_system();
+    ASSERT(hpt_server_start(&s) == 0);
+
+    hpc = hpt_context_create(1);
+
+    start = apr_time_now();
+    gop = hpt_op_new(hpc, s.port, -1, 1);
+    ASSERT(gop_sync_exec(gop) != OP_STATE_SUCCESS);
+    ASSERT((apr_time_now() - start) < apr_time_from_sec(10));
+    gop_free(gop, OP_DESTROY);
+
+    ASSERT(hpt_run_batch(hpc, s.port, 20) == OP_STATE_SUCCESS);
+
+    gop_hp_context_destroy(hpc);
+    hpt_server_stop(&s);
+    gop_shutdown();
+    return 0;
+}
+
+// A depot that stalls mid response can only tie up its own share of the
+// workers so the healthy depot next to it keeps going
+TEST_IMPL(gop_hportal_event_stall) {
+    hpt_server_t good, bad;
+    gop_portal_context_t *hpc;
+    gop_opque_t *q;
+    apr_time_t start;
+
+    gop_init_opque_system();
+    ASSERT(hpt_server_start(&good) == 0);
+    ASSERT(hpt_server_start(&bad) == 0);
+
+    //** One command per connection so each stalled request gets its own
+    hpc = hpt_context_load("[hp]\nevent_loops=1\nevent_send_threads=2\nevent_recv_threads=2\nevent_hp_workers=1\n"
+                           "min_host_conn=1\nmax_host_conn=4\nmax_workload_conn=1\nmax_inflight_conn=1\n"
+                           "latency_target=0\nmax_idle=30s\n");
+
+    q = gop_opque_new();
+    gop_opque_add(q, hpt_op_new(hpc, bad.port, -2, 5));
+    gop_opque_add(q, hpt_op_new(hpc, bad.port, -2, 5));
+    opque_start_execution(q);
+    sleep(1);  //** Give the partial responses time to land in the recv workers
+
+    start = apr_time_now();
+    ASSERT(hpt_run_batch(hpc, good.port, 50) == OP_STATE_SUCCESS);
+    ASSERT((apr_time_now() - start) < apr_time_from_sec(3));
+
+    ASSERT(opque_waitall(q) != OP_STATE_SUCCESS);
+    gop_opque_free(q, OP_DESTROY);
+
+    gop_hp_context_destroy(hpc);
+    hpt_server_stop(&bad);
+    hpt_server_stop(&good);
+    gop_shutdown();
+    return 0;
+}
+
+// The thread per connection mode gives the same results
+TEST_IMPL(gop_hportal_threads) {
+    hpt_server_t s;
+    gop_portal_context_t *hpc;
+
+    gop_init_opque_system();
+    ASSERT(hpt_server_start(&s) == 0);
+
+    hpc = hpt_context_create(0);
+    ASSERT(hpt_run_batch(hpc, s.port, 200) == OP_STATE_SUCCESS);
+
+    gop_hp_context_destroy(hpc);
+    hpt_server_stop(&s);
+    gop_shutdown();
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "task.h"
+#include "expire_wheel.h"
+#include <stdio.h>
+
+static void ew_add(expire_wheel_t *w, osd_id_t id, ibp_time_t when, int kind) {
+    expire_wheel_entry_t e;
+
+    e.id = id;
+    e.when = when;
+    e.stamp = (kind == EW_ALLOC) ? 0 : when - 10;
+    e.kind = kind;
+    expire_wheel_add(w, &e);
+}
+
+// Entries come due at the right time across every level of the wheel
+TEST_IMPL(ibps_expire_wheel) {
+    expire_wheel_entry_t e[16];
+    ibp_time_t lag, now = 1000;
+    int n;
+
+    expire_wheel_t *w = expire_wheel_create(now);
+    ASSERT(w != NULL);
+    ASSERT(expire_wheel_count(w) == 0);
+    ASSERT(expire_wheel_due(w, now, e, 16, &lag) == 0);
+    ASSERT(lag == 0);
+
+    ew_add(w, 1, now - 5, EW_ALLOC);           // Already due
+    ew_add(w, 2, now + 10, EW_TRASH_DELETE);   // Level 0
+    ew_add(w, 3, now + 1000, EW_TRASH_EXPIRE); // Level 1
+    ew_add(w, 4, now + 100000, EW_ALLOC);      // Level 2
+    ASSERT(expire_wheel_count(w) == 4);
+
+    n = expire_wheel_due(w, now, e, 16, &lag);
+    ASSERT(n == 1);
+    ASSERT(e[0].id == 1);
+    ASSERT(e[0].kind == EW_ALLOC);
+
+    ASSERT(expire_wheel_due(w, now + 9, e, 16, NULL) == 0);
+    n = expire_wheel_due(w, now + 10, e, 16, NULL);
+    ASSERT(n == 1);
+    ASSERT(e[0].id == 2);
+    ASSERT(e[0].kind == EW_TRASH_DELETE);
+    ASSERT(e[0].stamp == now);
+
+    ASSERT(expire_wheel_due(w, now + 999, e, 16, NULL) == 0);
+    n = expire_wheel_due(w, now + 1000, e, 16, NULL);
+    ASSERT(n == 1);
+    ASSERT(e[0].id == 3);
+
+    // Jumping well past the due time still returns it
+    n = expire_wheel_due(w, now + 200000, e, 16, NULL);
+    ASSERT(n == 1);
+    ASSERT(e[0].id == 4);
+    ASSERT(expire_wheel_count(w) == 0);
+
+    expire_wheel_destroy(w);
+    return 0;
+}
+
+// The due list is handed out in batches and reports how far behind it is
+TEST_IMPL(ibps_expire_wheel_batch) {
+    expire_wheel_entry_t e[4];
+    ibp_time_t lag, now = 5000;
+    int i, n, total;
+
+    expire_wheel_t *w = expire_wheel_create(now);
+    for (i=0; i<10; i++) {
+        ew_add(w, i, now + 1 + i, EW_ALLOC);
+    }
+    ASSERT(expire_wheel_count(w) == 10);
+
+    n = expire_wheel_due(w, now + 20, e, 4, &lag);
+    ASSERT(n == 4);
+    ASSERT(e[0].id == 0);
+    ASSERT(lag == 20 - 5);  // Oldest left is id 4 due at now+5
+    total = n;
+
+    while ((n = expire_wheel_due(w, now + 20, e, 4, &lag)) > 0) {
+        ASSERT(e[0].id == (osd_id_t)total);
+        total += n;
+    }
+    ASSERT(total == 10);
+    ASSERT(lag == 0);
+    ASSERT(expire_wheel_count(w) == 0);
+
+    expire_wheel_destroy(w);
+    return 0;
+}
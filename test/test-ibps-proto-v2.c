@@ -0,0 +1,472 @@
+#include "task.h"
+#include "proto_v2_exec.h"
+#include "ibps_depot_stub.h"
+#include <apr_general.h>
+#include <apr_time.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <gop/gop.h>
+#include <gop/opque.h>
+#include <ibp/ibp.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <tbx/dns_cache.h>
+#include <tbx/iniparse.h>
+#include <tbx/transfer_buffer.h>
+#include <unistd.h>
+
+#define PV_KEYS  3
+#define PV_TASKS 50
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next[PV_KEYS];      // Next sequence number expected for each key
+    int running[PV_KEYS];   // Tasks running for each key
+    int errors;
+    int done;
+} pv_state_t;
+
+typedef struct {
+    pv_state_t *st;
+    int key;
+    int seq;
+    int delay_us;
+} pv_task_t;
+
+static pv_task_t pv_task[PV_KEYS*PV_TASKS];
+
+static void pv_run(void *arg) {
+    pv_task_t *t = (pv_task_t *)arg;
+    pv_state_t *st = t->st;
+
+    pthread_mutex_lock(&(st->lock));
+    if ((st->running[t->key] != 0) || (st->next[t->key] != t->seq)) st->errors++;
+    st->running[t->key]++;
+    pthread_mutex_unlock(&(st->lock));
+
+    apr_sleep(t->delay_us);
+
+    pthread_mutex_lock(&(st->lock));
+    st->running[t->key]--;
+    st->next[t->key]++;
+    st->done++;
+    pthread_mutex_unlock(&(st->lock));
+}
+
+// Tasks for the same key run one at a time in the order submitted
+TEST_IMPL(ibps_proto_v2_order) {
+    v2_exec_t *ex;
+    v2_exec_group_t *g;
+    pv_state_t st;
+    char key[32];
+    int i, k;
+
+    apr_initialize();
+    memset(&st, 0, sizeof(st));
+    pthread_mutex_init(&(st.lock), NULL);
+
+    ex = v2_exec_create(4);
+    g = v2_exec_group_create(ex, 8);
+    for (i=0; i<PV_TASKS; i++) {
+        for (k=0; k<PV_KEYS; k++) {
+            pv_task[i*PV_KEYS + k].st = &st;
+            pv_task[i*PV_KEYS + k].key = k;
+            pv_task[i*PV_KEYS + k].seq = i;
+            pv_task[i*PV_KEYS + k].delay_us = ((i + k) % 5) * 200;
+            snprintf(key, sizeof(key), "rid#cap-%d", k);
+            v2_exec_submit(g, key, pv_run, &(pv_task[i*PV_KEYS + k]));
+            ASSERT(v2_exec_pending(g) <= 8);
+        }
+    }
+    v2_exec_drain(g);
+    ASSERT(v2_exec_pending(g) == 0);
+    ASSERT(st.done == PV_KEYS*PV_TASKS);
+    ASSERT(st.errors == 0);
+    for (k=0; k<PV_KEYS; k++) ASSERT(st.next[k] == PV_TASKS);
+
+    v2_exec_group_destroy(g);
+    v2_exec_destroy(ex);
+    pthread_mutex_destroy(&(st.lock));
+    apr_terminate();
+    return 0;
+}
+
+// Groups share the executors and waiting on a key only waits for that key
+TEST_IMPL(ibps_proto_v2_groups) {
+    v2_exec_t *ex;
+    v2_exec_group_t *g[2];
+    pv_state_t st;
+
+    apr_initialize();
+    memset(&st, 0, sizeof(st));
+    pthread_mutex_init(&(st.lock), NULL);
+
+    ex = v2_exec_create(2);
+    g[0] = v2_exec_group_create(ex, 4);
+    g[1] = v2_exec_group_create(ex, 4);
+
+    // The same cap in different groups is tracked separately
+    pv_task[0] = (pv_task_t){ &st, 0, 0, 200000 };
+    pv_task[1] = (pv_task_t){ &st, 1, 0, 1000 };
+    pv_task[2] = (pv_task_t){ &st, 1, 1, 1000 };
+    v2_exec_submit(g[0], "rid#a", pv_run, &(pv_task[0]));
+    v2_exec_submit(g[1], "rid#a", pv_run, &(pv_task[1]));
+    v2_exec_submit(g[1], "rid#a", pv_run, &(pv_task[2]));
+
+    v2_exec_wait_key(g[1], "rid#a");
+    pthread_mutex_lock(&(st.lock));
+    ASSERT(st.next[1] == 2);
+    ASSERT(st.next[0] == 0);  // Still sleeping
+    pthread_mutex_unlock(&(st.lock));
+    ASSERT(v2_exec_pending(g[1]) == 0);
+    ASSERT(v2_exec_pending(g[0]) == 1);
+
+    v2_exec_group_destroy(g[0]);  // Waits for the slow one
+    ASSERT(st.next[0] == 1);
+    ASSERT(st.errors == 0);
+
+    v2_exec_group_destroy(g[1]);
+    v2_exec_destroy(ex);
+    pthread_mutex_destroy(&(st.lock));
+    apr_terminate();
+    return 0;
+}
+
+// Ranges from the wire are checked without computing off+len
+TEST_IMPL(ibps_proto_v2_range) {
+    ASSERT(v2_range_check(0, 10, 10) == 0);
+    ASSERT(v2_range_check(5, 5, 10) == 0);
+    ASSERT(v2_range_check(10, 0, 10) == 0);
+    ASSERT(v2_range_check(6, 5, 10) != 0);
+    ASSERT(v2_range_check(11, 0, 10) != 0);
+    ASSERT(v2_range_check(-1, 5, 10) != 0);
+    ASSERT(v2_range_check(0, -1, 10) != 0);
+    ASSERT(v2_range_check(0, 1, -1) != 0);
+    ASSERT(v2_range_check(INT64_MAX, 1, INT64_MAX) != 0);
+    ASSERT(v2_range_check(1, INT64_MAX, INT64_MAX) != 0);
+    ASSERT(v2_range_check(INT64_MAX - 5, 5, INT64_MAX) == 0);
+    ASSERT(v2_range_check(INT64_MAX - 4, INT64_MAX - 4, 10) != 0);
+    return 0;
+}
+
+//** Raw binary protocol client used to drive the depot side directly
+typedef struct {
+    uint32_t id;
+    int status;
+    uint64_t nbytes;
+    int pos;      // Order the reply arrived in
+} pv_reply_t;
+
+static void pv_put16(unsigned char *b, uint16_t n) { b[0] = n; b[1] = n>>8; }
+static void pv_put32(unsigned char *b, uint32_t n) { b[0] = n; b[1] = n>>8; b[2] = n>>16; b[3] = n>>24; }
+static void pv_put64(unsigned char *b, uint64_t n) { pv_put32(b, n); pv_put32(b+4, n>>32); }
+static uint32_t pv_get32(const unsigned char *b) { return(b[0] | (b[1]<<8) | (b[2]<<16) | ((uint32_t)b[3]<<24)); }
+static uint64_t pv_get64(const unsigned char *b) { return(pv_get32(b) | ((uint64_t)pv_get32(b+4) << 32)); }
+
+static int pv_write_all(int fd, const void *buf, int n) {
+    return((write(fd, buf, n) == n) ? 0 : -1);
+}
+
+static int pv_read_all(int fd, void *buf, int n) {
+    int pos, err;
+
+    for (pos=0; pos<n; pos += err) {
+        err = read(fd, (char *)buf + pos, n - pos);
+        if (err <= 0) return(-1);
+    }
+
+    return(0);
+}
+
+// Returns 1 if the depot closed the connection.  Unread data on its side turns the close into a reset.
+static int pv_closed(int fd) {
+    char c;
+    int n;
+
+    n = read(fd, &c, 1);
+    if (n == 0) return(1);
+    return(((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK)) ? 1 : 0);
+}
+
+static int pv_connect(int port) {
+    struct sockaddr_in addr;
+    struct timeval tv;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return(-1);
+
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return(-1);
+    }
+
+    return(fd);
+}
+
+// Asks for the binary protocol and returns the version the depot picked
+static int pv_negotiate(int fd) {
+    char line[128];
+    int n, status, version;
+
+    n = snprintf(line, sizeof(line), "%d %d %d %d\n", IBPv040, IBP_PROTOCOL, IBP_PROTO_V2, 10);
+    if (pv_write_all(fd, line, n) != 0) return(-1);
+
+    for (n=0; n<(int)sizeof(line)-1; n++) {
+        if (pv_read_all(fd, line + n, 1) != 0) return(-1);
+        if (line[n] == '\n') break;
+    }
+    line[n] = '\0';
+
+    status = version = -1;
+    sscanf(line, "%d %d", &status, &version);
+    return((status == IBP_OK) ? version : -1);
+}
+
+// Sends a request frame.  key_len and total are taken as is so broken frames can be made
+static int pv_send(int fd, uint32_t id, int command, const char *key, int key_len, int n_iov, ibp_off_t *iov, uint64_t total, const char *data) {
+    unsigned char frame[IBP_V2_REQ_HEADER + 256 + 16*4];
+    int i, n;
+
+    pv_put32(frame, id);
+    pv_put16(frame+4, command);
+    pv_put16(frame+6, key_len);
+    pv_put32(frame+8, n_iov);
+    pv_put32(frame+12, 10);
+    pv_put64(frame+16, total);
+    n = IBP_V2_REQ_HEADER;
+    if (pv_write_all(fd, frame, n) != 0) return(-1);
+    if (key_len > 256) return(0);  // The depot should bail on the header alone
+
+    memcpy(frame, key, key_len);
+    n = key_len;
+    for (i=0; i<n_iov; i++) {
+        pv_put64(frame + n, iov[2*i]);
+        pv_put64(frame + n + 8, iov[2*i+1]);
+        n += 16;
+    }
+    if (pv_write_all(fd, frame, n) != 0) return(-1);
+
+    if (data != NULL) return(pv_write_all(fd, data, total));
+    return(0);
+}
+
+static int pv_send_rw(int fd, uint32_t id, int command, const char *key, ibp_off_t off, ibp_off_t len, const char *data) {
+    ibp_off_t iov[2];
+
+    iov[0] = off;
+    iov[1] = len;
+    return(pv_send(fd, id, command, key, strlen(key), 1, iov, len, data));
+}
+
+// Reads a reply header
+static int pv_recv(int fd, pv_reply_t *r) {
+    unsigned char hdr[IBP_V2_RESP_HEADER];
+
+    if (pv_read_all(fd, hdr, IBP_V2_RESP_HEADER) != 0) return(-1);
+    r->id = pv_get32(hdr);
+    r->status = (int32_t)pv_get32(hdr+4);
+    r->nbytes = pv_get64(hdr+8);
+    return(0);
+}
+
+// Checks the data matches what the depot started with
+static int pv_check_pattern(const char *buf, ibp_off_t off, ibp_off_t len) {
+    ibp_off_t i;
+
+    for (i=0; i<len; i++) {
+        if (buf[i] != PVD_BYTE(off + i)) return(1);
+    }
+    return(0);
+}
+
+// Connects, negotiates and sends a broken frame.  Returns 0 if the depot hung up without replying.
+static int pv_bad_frame(int port, int key_len, int n_iov, uint64_t total) {
+    ibp_off_t iov[2] = { 0, 10 };
+    int fd, err;
+
+    fd = pv_connect(port);
+    if (fd < 0) return(1);
+    err = 1;
+    if ((pv_negotiate(fd) == IBP_PROTO_V2) && (pv_send(fd, 1, IBP_LOAD, PVD_RID "#fast", key_len, n_iov, iov, total, NULL) == 0)) {
+        err = (pv_closed(fd) == 1) ? 0 : 1;
+    }
+    close(fd);
+
+    return(err);
+}
+
+// Requests are answered by ID as they finish, bad ones get an error reply and broken frames end the session
+TEST_IMPL(ibps_proto_v2_session) {
+    pv_reply_t r, got[6];
+    char wdata[32], buf[64];
+    int port, fd, i, n, n_conn, n_v2, n_closed;
+
+    apr_initialize();
+    tbx_dnsc_startup();
+    port = pvd_start();
+    ASSERT(port > 0);
+
+    fd = pv_connect(port);
+    ASSERT(fd >= 0);
+    ASSERT(pv_negotiate(fd) == IBP_PROTO_V2);
+
+    for (i=0; i<(int)sizeof(wdata); i++) wdata[i] = 'A' + i;
+
+    // The slow read goes 1st but the rest aren't stuck behind it
+    ASSERT(pv_send_rw(fd, 7, IBP_LOAD, PVD_RID "#slow", 100, 50, NULL) == 0);
+    ASSERT(pv_send_rw(fd, 3, IBP_LOAD, PVD_RID "#fast", 0, 64, NULL) == 0);
+    ASSERT(pv_send_rw(fd, 9, IBP_WRITE, PVD_RID "#fast", 1000, sizeof(wdata), wdata) == 0);
+    ASSERT(pv_send_rw(fd, 5, IBP_WRITE, PVD_RID "#badw", 0, sizeof(wdata), wdata) == 0);
+    ASSERT(pv_send_rw(fd, 11, IBP_LOAD, PVD_RID "#nope", 0, 16, NULL) == 0);
+
+    memset(got, 0, sizeof(got));
+    for (n=0; n<5; n++) {
+        ASSERT(pv_recv(fd, &r) == 0);
+        r.pos = n;
+        switch (r.id) {
+            case 3:
+                ASSERT((r.status == IBP_OK) && (r.nbytes == 64));
+                ASSERT(pv_read_all(fd, buf, 64) == 0);
+                ASSERT(pv_check_pattern(buf, 0, 64) == 0);
+                got[0] = r;
+                break;
+            case 9:
+                ASSERT((r.status == IBP_OK) && (r.nbytes == sizeof(wdata)));
+                got[1] = r;
+                break;
+            case 5:  // Nothing made it to disk so nothing is reported
+                ASSERT((r.status == IBP_E_FILE_WRITE) && (r.nbytes == 0));
+                got[2] = r;
+                break;
+            case 11:
+                ASSERT((r.status == IBP_E_CAP_NOT_FOUND) && (r.nbytes == 0));
+                got[3] = r;
+                break;
+            case 7:
+                ASSERT((r.status == IBP_OK) && (r.nbytes == 50));
+                ASSERT(pv_read_all(fd, buf, 50) == 0);
+                ASSERT(pv_check_pattern(buf, 100, 50) == 0);
+                got[4] = r;
+                break;
+            default:
+                ASSERT(0);
+        }
+    }
+    ASSERT((got[0].id == 3) && (got[1].id == 9) && (got[2].id == 5) && (got[3].id == 11) && (got[4].id == 7));
+    ASSERT(got[0].pos < got[1].pos);  // Same cap so they stay in order
+    ASSERT(got[4].pos == 4);          // The slow one comes back last
+
+    // The write landed
+    ASSERT(pv_send_rw(fd, 12, IBP_LOAD, PVD_RID "#fast", 1000, sizeof(wdata), NULL) == 0);
+    ASSERT(pv_recv(fd, &r) == 0);
+    ASSERT((r.id == 12) && (r.status == IBP_OK) && (r.nbytes == sizeof(wdata)));
+    ASSERT(pv_read_all(fd, buf, sizeof(wdata)) == 0);
+    ASSERT(memcmp(buf, wdata, sizeof(wdata)) == 0);
+
+    // A request already queued is still answered before a broken frame ends the session
+    ASSERT(pv_send_rw(fd, 13, IBP_LOAD, PVD_RID "#slow", 0, 16, NULL) == 0);
+    ASSERT(pv_send(fd, 14, IBP_LOAD, PVD_RID "#fast", strlen(PVD_RID "#fast"), 1, (ibp_off_t[]){ 0, 10 }, 20, NULL) == 0);
+    ASSERT(pv_recv(fd, &r) == 0);
+    ASSERT((r.id == 13) && (r.status == IBP_OK) && (r.nbytes == 16));
+    ASSERT(pv_read_all(fd, buf, 16) == 0);
+    ASSERT(pv_closed(fd) == 1);
+    close(fd);
+    ASSERT(pvd_wait_closed(1, 5000) == 0);
+
+    ASSERT(pv_bad_frame(port, 2000, 1, 10) == 0);  // key_len too big
+    ASSERT(pvd_wait_closed(2, 5000) == 0);
+    ASSERT(pv_bad_frame(port, strlen(PVD_RID "#fast"), 0, 10) == 0);  // No I/O vec
+    ASSERT(pvd_wait_closed(3, 5000) == 0);
+    ASSERT(pv_bad_frame(port, strlen(PVD_RID "#fast"), 1, 11) == 0);  // Total doesn't match the I/O vec
+    ASSERT(pvd_wait_closed(4, 5000) == 0);
+
+    pvd_counts(&n_conn, &n_v2, &n_closed);
+    ASSERT((n_conn == 4) && (n_v2 == 4) && (n_closed == 4));
+
+    pvd_stop();
+    tbx_dnsc_shutdown();
+    apr_terminate();
+    return 0;
+}
+
+// The client negotiates the binary protocol and matches the replies to its ops as they arrive
+TEST_IMPL(ibps_proto_v2_client) {
+    ibp_context_t *ic;
+    tbx_inip_file_t *ifd;
+    gop_opque_t *q;
+    gop_op_generic_t *gop[4];
+    tbx_tbuf_t tbuf[4];
+    char cap[4][256];
+    char *buf[4];
+    int port, i, n_conn, n_v2, n_closed;
+
+    gop_init_opque_system();
+    ic = ibp_context_create();
+    ifd = tbx_inip_string_read("[ibp]\nprotocol_version=2\nmin_host_conn=1\nmax_host_conn=1\n");
+    ibp_config_load(ic, ifd, "ibp");
+    tbx_inip_destroy(ifd);
+
+    port = pvd_start();
+    ASSERT(port > 0);
+
+    snprintf(cap[0], sizeof(cap[0]), "ibp://127.0.0.1:%d/" PVD_RID "#slow/0/READ", port);
+    snprintf(cap[1], sizeof(cap[1]), "ibp://127.0.0.1:%d/" PVD_RID "#fast/0/READ", port);
+    snprintf(cap[2], sizeof(cap[2]), "ibp://127.0.0.1:%d/" PVD_RID "#fast/0/WRITE", port);
+    snprintf(cap[3], sizeof(cap[3]), "ibp://127.0.0.1:%d/" PVD_RID "#nope/0/READ", port);
+    for (i=0; i<4; i++) {
+        buf[i] = malloc(4096);
+        tbx_tbuf_single(&(tbuf[i]), 4096, buf[i]);
+    }
+    memset(buf[2], 'w', 4096);
+
+    //** All on one connection so the fast replies show up while the slow read waits
+    q = gop_opque_new();
+    gop[0] = ibp_read_gop(ic, cap[0], 0, &(tbuf[0]), 0, 4096, 10);
+    gop[1] = ibp_read_gop(ic, cap[1], 4096, &(tbuf[1]), 0, 4096, 10);
+    gop[2] = ibp_write_gop(ic, cap[2], 16384, &(tbuf[2]), 0, 4096, 10);
+    gop[3] = ibp_read_gop(ic, cap[3], 0, &(tbuf[3]), 0, 4096, 10);
+    for (i=0; i<4; i++) gop_opque_add(q, gop[i]);
+    ASSERT(opque_waitall(q) != OP_STATE_SUCCESS);
+    ASSERT(gop_get_status(gop[0]).op_status == OP_STATE_SUCCESS);
+    ASSERT(gop_get_status(gop[1]).op_status == OP_STATE_SUCCESS);
+    ASSERT(gop_get_status(gop[2]).op_status == OP_STATE_SUCCESS);
+    ASSERT(gop_get_status(gop[3]).op_status != OP_STATE_SUCCESS);
+    ASSERT(pv_check_pattern(buf[0], 0, 4096) == 0);
+    ASSERT(pv_check_pattern(buf[1], 4096, 4096) == 0);
+    gop_opque_free(q, OP_DESTROY);
+
+    //** Read back the write
+    memset(buf[3], 0, 4096);
+    snprintf(cap[3], sizeof(cap[3]), "ibp://127.0.0.1:%d/" PVD_RID "#fast/0/READ", port);
+    gop[3] = ibp_read_gop(ic, cap[3], 16384, &(tbuf[3]), 0, 4096, 10);
+    ASSERT(gop_sync_exec(gop[3]) == OP_STATE_SUCCESS);
+    gop_free(gop[3], OP_DESTROY);
+    ASSERT(memcmp(buf[2], buf[3], 4096) == 0);
+
+    ibp_context_destroy(ic);  //** Closes the connections
+
+    pvd_counts(&n_conn, &n_v2, &n_closed);
+    ASSERT(n_conn > 0);
+    ASSERT(pvd_wait_closed(n_conn, 10000) == 0);
+    pvd_counts(&n_conn, &n_v2, &n_closed);
+    ASSERT(n_v2 == n_conn);
+
+    pvd_stop();
+    for (i=0; i<4; i++) free(buf[i]);
+    gop_shutdown();
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include "task.h"
+#include <gop/gop.h>
+#include <tbx/interval_skiplist.h>
+
+#include "segment/lun.h"
+
+// Hedged reads pick the right devices and an abandoned read outlives its segment
+TEST_IMPL(lio_lun_hedge) {
+    gop_init_opque_system();
+    ASSERT(seglun_hedge_test() == 0);
+    gop_shutdown();
+    return 0;
+}
@@ -5,6 +5,21 @@ TEST_DECLARE(tb_ref)
 TEST_DECLARE(tb_stack)
 TEST_DECLARE(tb_stk_escape_text)
 TEST_DECLARE(tb_iniparse)
+TEST_DECLARE(tb_chksum)
+TEST_DECLARE(ibps_expire_wheel)
+TEST_DECLARE(ibps_expire_wheel_batch)
+TEST_DECLARE(ibps_proto_v2_order)
+TEST_DECLARE(ibps_proto_v2_groups)
+TEST_DECLARE(ibps_proto_v2_range)
+TEST_DECLARE(ibps_proto_v2_session)
+TEST_DECLARE(ibps_proto_v2_client)
+TEST_DECLARE(os_kv_namespace)
+TEST_DECLARE(os_kv_attrs)
+TEST_DECLARE(lio_lun_hedge)
+TEST_DECLARE(gop_hportal_event)
+TEST_DECLARE(gop_hportal_event_timeout)
+TEST_DECLARE(gop_hportal_event_stall)
+TEST_DECLARE(gop_hportal_threads)
 
 TASK_LIST_START
     TEST_ENTRY(always_win)
@@ -14,4 +29,19 @@ TASK_LIST_START
     TEST_ENTRY(tb_stack)
     TEST_ENTRY(tb_stk_escape_text)
     TEST_ENTRY(tb_iniparse)
+    TEST_ENTRY(tb_chksum)
+    TEST_ENTRY(ibps_expire_wheel)
+    TEST_ENTRY(ibps_expire_wheel_batch)
+    TEST_ENTRY(ibps_proto_v2_order)
+    TEST_ENTRY(ibps_proto_v2_groups)
+    TEST_ENTRY(ibps_proto_v2_range)
+    TEST_ENTRY_CUSTOM(ibps_proto_v2_session, 0, 0, 60000)
+    TEST_ENTRY_CUSTOM(ibps_proto_v2_client, 0, 0, 60000)
+    TEST_ENTRY(os_kv_namespace)
+    TEST_ENTRY(os_kv_attrs)
+    TEST_ENTRY_CUSTOM(lio_lun_hedge, 0, 0, 30000)
+    TEST_ENTRY_CUSTOM(gop_hportal_event, 0, 0, 30000)
+    TEST_ENTRY_CUSTOM(gop_hportal_event_timeout, 0, 0, 30000)
+    TEST_ENTRY_CUSTOM(gop_hportal_event_stall, 0, 0, 60000)
+    TEST_ENTRY_CUSTOM(gop_hportal_threads, 0, 0, 30000)
 TASK_LIST_END
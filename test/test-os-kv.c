@@ -0,0 +1,166 @@
+#include "task.h"
+#include <gop/gop.h>
+#include <gop/opque.h>
+#include <gop/tp.h>
+#include <lio/ex3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/iniparse.h>
+
+#include "ex3/system.h"
+#include "os.h"
+#include "os/kv.h"
+#include "service_manager.h"
+
+typedef struct {
+    lio_service_manager_t *ess;
+    gop_thread_pool_context_t *tpc;
+    lio_object_service_fn_t *os;
+    lio_creds_t *creds;
+    char base[256];
+} kv_test_t;
+
+static int kv_test_start(kv_test_t *t) {
+    os_create_t *os_create;
+    tbx_inip_file_t *ifd;
+    char text[512];
+
+    snprintf(t->base, sizeof(t->base), "/tmp/test-os-kv-XXXXXX");
+    if (mkdtemp(t->base) == NULL) return(1);
+
+    gop_init_opque_system();
+    t->ess = lio_exnode_service_set_create();
+    t->tpc = gop_tp_context_create("TEST_KV", 1, 4, 10);
+    add_service(t->ess, ESS_RUNNING, ESS_TPC_UNLIMITED, t->tpc);
+
+    snprintf(text, sizeof(text), "[os_kv]\nbase_path=%s/db\n", t->base);
+    ifd = tbx_inip_string_read(text);
+    os_create = lio_lookup_service(t->ess, OS_AVAILABLE, OS_TYPE_KV);
+    t->os = (*os_create)(t->ess, ifd, "os_kv");
+    tbx_inip_destroy(ifd);
+    if (t->os == NULL) return(1);
+
+    t->creds = os_cred_init(t->os, OS_CREDS_INI_TYPE, NULL);
+    return(0);
+}
+
+static void kv_test_stop(kv_test_t *t) {
+    char cmd[512];
+
+    os_cred_destroy(t->os, t->creds);
+    os_destroy_service(t->os);
+    gop_tp_context_destroy(t->tpc);
+    lio_exnode_service_set_destroy(t->ess);
+    gop_shutdown();
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", t->base);
+    if (system(cmd) != 0) fprintf(stderr, "Unable to remove %s\n", t->base);
+}
+
+//** Returns 0 if the attribute matches the string, or is missing when expected is NULL
+static int kv_attr_check(kv_test_t *t, char *path, char *key, char *expected) {
+    os_fd_t *fd = NULL;
+    void *val = NULL;
+    int v_size = -1024;
+    int err;
+
+    if (gop_sync_exec(os_open_object(t->os, t->creds, path, OS_MODE_READ_IMMEDIATE, "test", &fd, 10)) != OP_STATE_SUCCESS) return(1);
+    gop_sync_exec(os_get_attr(t->os, t->creds, fd, key, &val, &v_size));
+    gop_sync_exec(os_close_object(t->os, fd));
+
+    if (expected == NULL) {
+        err = (v_size < 0) ? 0 : 1;
+    } else {
+        err = ((v_size == (int)strlen(expected)) && (memcmp(val, expected, v_size) == 0)) ? 0 : 1;
+    }
+    if (val) free(val);
+    return(err);
+}
+
+static int kv_attr_set(kv_test_t *t, char *path, char *key, char *val) {
+    os_fd_t *fd = NULL;
+    int err;
+
+    if (gop_sync_exec(os_open_object(t->os, t->creds, path, OS_MODE_WRITE_IMMEDIATE, "test", &fd, 10)) != OP_STATE_SUCCESS) return(1);
+    err = gop_sync_exec(os_set_attr(t->os, t->creds, fd, key, val, (val) ? (int)strlen(val) : -1));
+    gop_sync_exec(os_close_object(t->os, fd));
+    return((err == OP_STATE_SUCCESS) ? 0 : 1);
+}
+
+// Objects can be created, hard linked, moved and removed
+TEST_IMPL(os_kv_namespace) {
+    kv_test_t t;
+
+    ASSERT(kv_test_start(&t) == 0);
+
+    ASSERT(gop_sync_exec(os_create_object(t.os, t.creds, "/d", OS_OBJECT_DIR_FLAG, "test")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_create_object(t.os, t.creds, "/d/f", OS_OBJECT_FILE_FLAG, "test")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_create_object(t.os, t.creds, "/d/g", OS_OBJECT_FILE_FLAG, "test")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_exists(t.os, t.creds, "/d/f")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_create_object(t.os, t.creds, "/d/f", OS_OBJECT_FILE_FLAG, "test")) != OP_STATE_SUCCESS);
+
+    //** The hard link keeps the attributes after the original is gone
+    ASSERT(kv_attr_set(&t, "/d/f", "user.a", "hello") == 0);
+    ASSERT(gop_sync_exec(os_hardlink_object(t.os, t.creds, "/d/f", "/d/h", "test")) == OP_STATE_SUCCESS);
+    ASSERT(kv_attr_check(&t, "/d/h", "os.link_count", "2") == 0);
+    ASSERT(gop_sync_exec(os_remove_object(t.os, t.creds, "/d/f")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_exists(t.os, t.creds, "/d/f")) != OP_STATE_SUCCESS);
+    ASSERT(kv_attr_check(&t, "/d/h", "user.a", "hello") == 0);
+    ASSERT(kv_attr_check(&t, "/d/h", "os.link_count", "1") == 0);
+
+    //** Moving onto an existing file replaces it
+    ASSERT(gop_sync_exec(os_move_object(t.os, t.creds, "/d/h", "/d/g")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_exists(t.os, t.creds, "/d/h")) != OP_STATE_SUCCESS);
+    ASSERT(kv_attr_check(&t, "/d/g", "user.a", "hello") == 0);
+
+    ASSERT(gop_sync_exec(os_remove_object(t.os, t.creds, "/d/g")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_remove_object(t.os, t.creds, "/d")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_exists(t.os, t.creds, "/d")) != OP_STATE_SUCCESS);
+
+    kv_test_stop(&t);
+    return 0;
+}
+
+// Attribute writes in one call see each other and links resolve
+TEST_IMPL(os_kv_attrs) {
+    kv_test_t t;
+    os_fd_t *fd = NULL;
+    char *keys[2] = { "user.b", "os.append.user.b" };
+    void *vals[2] = { "x", "y" };
+    int v_sizes[2] = { 1, 1 };
+
+    ASSERT(kv_test_start(&t) == 0);
+
+    ASSERT(gop_sync_exec(os_create_object(t.os, t.creds, "/f", OS_OBJECT_FILE_FLAG, "test")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_create_object(t.os, t.creds, "/g", OS_OBJECT_FILE_FLAG, "test")) == OP_STATE_SUCCESS);
+
+    //** The append has to see the value set earlier in the same batch
+    ASSERT(gop_sync_exec(os_open_object(t.os, t.creds, "/f", OS_MODE_WRITE_IMMEDIATE, "test", &fd, 10)) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_set_multiple_attrs(t.os, t.creds, fd, keys, vals, v_sizes, 2)) == OP_STATE_SUCCESS);
+    gop_sync_exec(os_close_object(t.os, fd));
+    ASSERT(kv_attr_check(&t, "/f", "user.b", "xy") == 0);
+
+    //** Round trip a symlinked attribute
+    ASSERT(gop_sync_exec(os_open_object(t.os, t.creds, "/g", OS_MODE_WRITE_IMMEDIATE, "test", &fd, 10)) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_symlink_attr(t.os, t.creds, "/f", "user.b", fd, "user.l")) == OP_STATE_SUCCESS);
+    gop_sync_exec(os_close_object(t.os, fd));
+    ASSERT(kv_attr_check(&t, "/g", "user.l", "xy") == 0);
+    ASSERT(kv_attr_set(&t, "/f", "user.b", "z") == 0);
+    ASSERT(kv_attr_check(&t, "/g", "user.l", "z") == 0);
+
+    //** Rename it and remove it
+    ASSERT(gop_sync_exec(os_open_object(t.os, t.creds, "/f", OS_MODE_WRITE_IMMEDIATE, "test", &fd, 10)) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_move_attr(t.os, t.creds, fd, "user.b", "user.c")) == OP_STATE_SUCCESS);
+    gop_sync_exec(os_close_object(t.os, fd));
+    ASSERT(kv_attr_check(&t, "/f", "user.b", NULL) == 0);
+    ASSERT(kv_attr_check(&t, "/f", "user.c", "z") == 0);
+    ASSERT(kv_attr_set(&t, "/f", "user.c", NULL) == 0);
+    ASSERT(kv_attr_check(&t, "/f", "user.c", NULL) == 0);
+
+    ASSERT(gop_sync_exec(os_remove_object(t.os, t.creds, "/g")) == OP_STATE_SUCCESS);
+    ASSERT(gop_sync_exec(os_remove_object(t.os, t.creds, "/f")) == OP_STATE_SUCCESS);
+
+    kv_test_stop(&t);
+    return 0;
+}
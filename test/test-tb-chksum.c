@@ -0,0 +1,57 @@
+#include "task.h"
+#include <tbx/chksum.h>
+#include <tbx/transfer_buffer.h>
+#include <string.h>
+
+static int chksum_hex(int type, const char *str, int split, char *out) {
+    tbx_chksum_t cs;
+    tbx_tbuf_t tbuf;
+    int len = strlen(str);
+
+    if (tbx_chksum_set(&cs, type) != 0) return -1;
+    tbx_tbuf_single(&tbuf, len, (char *)str);
+    if (split > 0) {
+        tbx_chksum_add(&cs, split, &tbuf, 0);
+        tbx_chksum_add(&cs, len - split, &tbuf, split);
+    } else if (len > 0) {
+        tbx_chksum_add(&cs, len, &tbuf, 0);
+    }
+    tbx_chksum_get(&cs, CHKSUM_DIGEST_HEX, out);
+    return 0;
+}
+
+TEST_IMPL(tb_chksum) {
+    char hex[CHKSUM_MAX_SIZE];
+    char hex2[CHKSUM_MAX_SIZE];
+    const char *long_str = "The quick brown fox jumps over the lazy dog, and then some more text to cross the stripe size";
+    int i;
+
+    ASSERT(tbx_chksum_type_name("CRC32C") == CHKSUM_CRC32C);
+    ASSERT(tbx_chksum_type_name("xxh64") == CHKSUM_XXH64);
+    ASSERT(tbx_chksum_type_valid(CHKSUM_CRC32C));
+    ASSERT(tbx_chksum_type_valid(CHKSUM_XXH64));
+
+    // Standard check values
+    ASSERT(chksum_hex(CHKSUM_CRC32C, "123456789", 0, hex) == 0);
+    ASSERT(strcmp(hex, "e3069283") == 0);
+    ASSERT(chksum_hex(CHKSUM_XXH64, "", 0, hex) == 0);
+    ASSERT(strcmp(hex, "ef46db3751d8e999") == 0);
+    ASSERT(chksum_hex(CHKSUM_XXH64, "a", 0, hex) == 0);
+    ASSERT(strcmp(hex, "d24ec4f1a98c6e5b") == 0);
+    ASSERT(chksum_hex(CHKSUM_XXH64, "abc", 0, hex) == 0);
+    ASSERT(strcmp(hex, "44bc2cf5ad770999") == 0);
+
+    // Incremental adds should match a single add
+    ASSERT(chksum_hex(CHKSUM_CRC32C, long_str, 0, hex) == 0);
+    for (i=1; i<(int)strlen(long_str); i+=7) {
+        ASSERT(chksum_hex(CHKSUM_CRC32C, long_str, i, hex2) == 0);
+        ASSERT(strcmp(hex, hex2) == 0);
+    }
+    ASSERT(chksum_hex(CHKSUM_XXH64, long_str, 0, hex) == 0);
+    for (i=1; i<(int)strlen(long_str); i+=7) {
+        ASSERT(chksum_hex(CHKSUM_XXH64, long_str, i, hex2) == 0);
+        ASSERT(strcmp(hex, hex2) == 0);
+    }
+
+    return 0;
+}